@@ -6,6 +6,8 @@
 
 #include "diff_ext.h"
 
+#include "../src/QuickCompare.h"
+
 #include <KLocalizedString>
 
 #include <QString>
@@ -274,12 +276,14 @@ DIFF_EXT::InvokeCommand(LPCMINVOKECOMMANDINFO ici)
       if(id == m_id_Diff)
       {
          LOG();
-         diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\"") );
+         if(!report_identical({toQString(_file_name1), toQString(_file_name2)}))
+            diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\"") );
       }
       else if(id == m_id_Diff3)
       {
          LOG();
-         diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\" \"") + _file_name3 + TEXT("\"") );
+         if(!report_identical({toQString(_file_name1), toQString(_file_name2), toQString(_file_name3)}))
+            diff( TEXT("\"") + _file_name1 + TEXT("\" \"") + _file_name2 + TEXT("\" \"") + _file_name3 + TEXT("\"") );
       }
       else if(id == m_id_Merge3)
       {
@@ -439,9 +443,26 @@ DIFF_EXT::diff_with(unsigned int num, bool bMerge)
    if ( i!=m_recentFiles.end() )
       _file_name2 = *i;
 
+   if(!bMerge && report_identical({toQString(_file_name2), toQString(_file_name1)}))
+      return;
+
    diff( (bMerge ? TEXT("-m \"") : TEXT("\"") ) + _file_name2 + TEXT("\" \"") + _file_name1 + TEXT("\"") );
 }
 
+// Only if "QuickCheckIdentical" is set to 1 in the registry, see the README.
+bool
+DIFF_EXT::report_identical(const QStringList& fileNames)
+{
+   if(SERVER::instance()->getRegistryKeyString( TEXT(""), TEXT("QuickCheckIdentical") ) != TEXT("1"))
+      return false;
+
+   if(!QuickCompare::identicalFiles(fileNames))
+      return false;
+
+   MESSAGELOG(TEXT("Identical files: ")+fromQString(fileNames.join(QStringLiteral(", "))));
+   MessageBox(_hwnd, fromQString(i18n("The selected files are identical.")).c_str(), fromQString(i18n("Diff-Ext For KDiff3")).c_str(), MB_OK);
+   return true;
+}
 
 tstring
 DIFF_EXT::cut_to_length(const tstring& in, size_t max_len)
@@ -17,6 +17,8 @@
 
 #include "server.h"
 
+#include <QStringList>
+
 
 // this is the actual OLE Shell context menu handler
 class DIFF_EXT : public IContextMenu, IShellExtInit {
@@ -40,6 +42,8 @@ class DIFF_EXT : public IContextMenu, IShellExtInit {
   private:
     void diff( const tstring& arguments );
     void diff_with(unsigned int num, bool bMerge);
+    // Tells the user instead of starting KDiff3 when the files are identical.
+    bool report_identical(const QStringList& fileNames);
     tstring cut_to_length(const tstring&, size_t length = 64);
 
   private:
@@ -10,6 +10,7 @@
 
 #include "kdiff3fileitemaction.h"
 
+#include "../src/QuickCompare.h"
 #include "../src/Utils.h"
 #include "../src/TypeUtils.h"
 
@@ -29,6 +30,8 @@
 #include <KProcess>
 
 std::unique_ptr<QStringList> s_pHistory;
+// Whether comparing identical files just says so instead of starting KDiff3.
+bool s_bReportIdentical = false;
 
 class KDiff3PluginHistory
 {
@@ -46,6 +49,7 @@ class KDiff3PluginHistory
             m_pConfig = std::make_unique<KConfig>("kdiff3fileitemactionrc", KConfig::SimpleConfig);
             m_pConfigGroup = std::make_unique<KConfigGroup>(m_pConfig.get(), "KDiff3Plugin");
             *s_pHistory = m_pConfigGroup->readEntry("HistoryStack", QStringList());
+            s_bReportIdentical = m_pConfigGroup->readEntry("ReportIdenticalFiles", false);
         }
     }
 
@@ -53,7 +57,10 @@ class KDiff3PluginHistory
     {
         //std::cout << "Delete History" << std::endl;
         if(s_pHistory && m_pConfigGroup)
+        {
             m_pConfigGroup->writeEntry("HistoryStack", *s_pHistory);
+            m_pConfigGroup->writeEntry("ReportIdenticalFiles", s_bReportIdentical);
+        }
 
         s_pHistory = nullptr;
     }
@@ -160,6 +167,12 @@ QList<QAction*> KDiff3FileItemAction::actions(const KFileItemListProperties& fil
         connect(pAction, &QAction::triggered, this, &KDiff3FileItemAction::slotCompareThreeFiles);
         pActionMenu->addAction(pAction);
     }
+    pAction = new QAction(i18n("Report Identical Files Without Starting KDiff3"), this);
+    pAction->setCheckable(true);
+    pAction->setChecked(s_bReportIdentical);
+    connect(pAction, &QAction::toggled, this, [](const bool bChecked) { s_bReportIdentical = bChecked; });
+    pActionMenu->addAction(pAction);
+
     pAction = new QAction(i18n("About KDiff3 menu plugin..."), this);
     connect(pAction, &QAction::triggered, this, &KDiff3FileItemAction::slotAbout);
     pActionMenu->addAction(pAction);
@@ -173,6 +186,16 @@ QList<QAction*> KDiff3FileItemAction::actions(const KFileItemListProperties& fil
 
 KDiff3FileItemAction::~KDiff3FileItemAction() = default;
 
+void KDiff3FileItemAction::compare(const QStringList& args)
+{
+    if(s_bReportIdentical && QuickCompare::identicalFiles(args))
+    {
+        KMessageBox::information(m_pParentWidget, i18n("The selected files are identical."), i18n("KDiff3"));
+        return;
+    }
+    KProcess::startDetached("kdiff3", args);
+}
+
 void KDiff3FileItemAction::slotCompareWith()
 {
     if(m_list.count() > 0 && s_pHistory && !s_pHistory->empty())
@@ -181,7 +204,7 @@ void KDiff3FileItemAction::slotCompareWith()
             s_pHistory->first(),
             Utils::urlToString(m_list.first())
         };
-        KProcess::startDetached("kdiff3", args);
+        compare(args);
     }
 }
 
@@ -194,7 +217,7 @@ void KDiff3FileItemAction::slotCompareWithHistoryItem()
             pAction->data().toString(),
             Utils::urlToString(m_list.first())
         };
-        KProcess::startDetached("kdiff3", args);
+        compare(args);
     }
 }
 
@@ -206,7 +229,7 @@ void KDiff3FileItemAction::slotCompareTwoFiles()
             Utils::urlToString(m_list.first()),
             Utils::urlToString(m_list.last())
         };
-        KProcess::startDetached("kdiff3", args);
+        compare(args);
     }
 }
 
@@ -219,7 +242,7 @@ void KDiff3FileItemAction::slotCompareThreeFiles()
             Utils::urlToString(m_list.at(1)),
             Utils::urlToString(m_list.at(2))
         };
-        KProcess::startDetached("kdiff3", args);
+        compare(args);
     }
 }
 
@@ -35,6 +35,9 @@ class KDiff3FileItemAction: public KAbstractFileItemActionPlugin
     void slotAbout();
 
   private:
+    // Starts KDiff3 for the files, unless it is enough to report that they are identical.
+    void compare(const QStringList& args);
+
     QList<QUrl> m_list;
     QWidget* m_pParentWidget = nullptr;
     //KFileItemListProperties m_fileItemInfos;
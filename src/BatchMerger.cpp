@@ -0,0 +1,316 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "BatchMerger.h"
+
+#include "diff.h"
+#include "fileaccess.h"
+#include "FileAnalysis.h"
+#include "MergeEditLine.h"
+#include "MergeResultWriter.h"
+#include "options.h"
+#include "PatchWriter.h"
+#include "SourceData.h"
+
+#include <algorithm>
+
+#include <KLocalizedString>
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QTextCodec>
+#include <QTextStream>
+
+namespace {
+
+// Same choice as WindowTitleWidget::setLineEndStyles makes when set to auto detect.
+e_LineEndStyle chooseLineEndStyle(const QSharedPointer<Options>& pOptions, const e_LineEndStyle styleA, const e_LineEndStyle styleB, const e_LineEndStyle styleC)
+{
+    if(pOptions->m_lineEndStyle != eLineEndStyleAutoDetect)
+        return pOptions->m_lineEndStyle;
+
+    std::vector<e_LineEndStyle> styles;
+    for(const e_LineEndStyle style: {styleA, styleB, styleC})
+    {
+        if(style != eLineEndStyleUndefined)
+            styles.push_back(style);
+    }
+
+    if(styles.empty())
+        return eLineEndStyleUnix;
+    if(styles.size() == 3)
+        return styleA == styleB ? styleC : styleA == styleC ? styleB : eLineEndStyleConflict;
+
+    return std::all_of(styles.cbegin(), styles.cend(), [&styles](const e_LineEndStyle style) { return style == styles.front(); }) ? styles.front() : eLineEndStyleConflict;
+}
+
+QString conflictKindName(const e_ConflictKind kind)
+{
+    switch(kind)
+    {
+        case e_ConflictKind::none:
+        case e_ConflictKind::text:
+            break;
+        case e_ConflictKind::whiteSpace:
+            return QStringLiteral("whiteSpace");
+        case e_ConflictKind::comment:
+            return QStringLiteral("comment");
+        case e_ConflictKind::numbers:
+            return QStringLiteral("numbers");
+    }
+    return QStringLiteral("text");
+}
+
+QJsonObject lineRange(const LineRef first, const LineType count)
+{
+    QJsonObject range;
+    range["line"] = first.isValid() ? (LineType)first + 1 : 0;
+    range["count"] = count;
+    return range;
+}
+
+// The lines each input contributes to a conflict, line numbers start at 1.
+QJsonObject conflictRanges(const MergeBlock& mb, const bool bThreeWay)
+{
+    LineRef first[3];
+    LineType count[3] = {0, 0, 0};
+
+    Diff3LineList::const_iterator it = mb.id3l();
+    for(LineType i = 0; i < mb.sourceRangeLength(); ++i, ++it)
+    {
+        const LineRef lines[3] = {it->getLineA(), it->getLineB(), it->getLineC()};
+        for(int j = 0; j < 3; ++j)
+        {
+            if(!lines[j].isValid())
+                continue;
+            if(!first[j].isValid())
+                first[j] = lines[j];
+            ++count[j];
+        }
+    }
+
+    QJsonObject conflict;
+    conflict["A"] = lineRange(first[0], count[0]);
+    conflict["B"] = lineRange(first[1], count[1]);
+    if(bThreeWay)
+        conflict["C"] = lineRange(first[2], count[2]);
+    conflict["whiteSpaceOnly"] = mb.isWhiteSpaceConflict();
+    conflict["kind"] = conflictKindName(mb.conflictKind());
+    return conflict;
+}
+
+// Writes the merge result the same way MergeResultWindow::saveDocument does.
+bool saveMergeResult(const MergeBlockList& mergeBlockList, const QString& fileName, QTextCodec* pEncoding, const e_LineEndStyle eLineEndStyle,
+                     const bool bCreateBackup, const std::shared_ptr<LineDataVector>& pldA, const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC)
+{
+    FileAccess file(fileName, true /*bWantToWrite*/);
+    MergeResultWriter writer(mergeBlockList, pEncoding, eLineEndStyle, pldA, pldB, pldC);
+    return writer.write(file, bCreateBackup ? QStringLiteral(".orig") : QString());
+}
+
+QTextCodec* outputEncoding(const QSharedPointer<Options>& pOptions, const QSharedPointer<SourceData>& sdOut)
+{
+    QTextCodec* pEncoding = pOptions->m_bAutoSelectOutEncoding || pOptions->m_pEncodingOut == nullptr ? sdOut->getEncoding() : pOptions->m_pEncodingOut;
+    return pEncoding != nullptr ? pEncoding : QTextCodec::codecForName("UTF-8");
+}
+
+// Streams the patch of the job to its file or stdout, without a backup.
+bool writePatch(const FileAnalysis& analysis, const BatchMerger::Job& job, const QSharedPointer<Options>& pOptions)
+{
+    const bool bThreeWay = analysis.isThreeWay();
+    const QSharedPointer<SourceData>& sdA = analysis.sdA();
+    const QSharedPointer<SourceData>& sdB = analysis.sdB();
+    const QSharedPointer<SourceData>& sdC = analysis.sdC();
+    QTextCodec* pEncoding = outputEncoding(pOptions, bThreeWay ? sdC : sdB);
+    e_LineEndStyle eLineEndStyle = chooseLineEndStyle(pOptions, sdA->getLineEndStyle(), sdB->getLineEndStyle(), bThreeWay ? sdC->getLineEndStyle() : eLineEndStyleUndefined);
+    if(eLineEndStyle == eLineEndStyleConflict)
+        eLineEndStyle = eLineEndStyleUnix;
+
+    const auto write = [&job](auto& writer) {
+        if(job.patch != u8"-")
+        {
+            FileAccess file(job.patch, true /*bWantToWrite*/);
+            return writer.write(file);
+        }
+        QFile out;
+        return out.open(stdout, QIODevice::WriteOnly) && writer.write(out);
+    };
+
+    if(!bThreeWay)
+    {
+        PatchWriter writer(analysis.diffList12(), sdA->getLineDataForDisplay(), sdA->getSizeLines(), sdB->getLineDataForDisplay(), sdB->getSizeLines(),
+                           job.fileA, job.fileB, pOptions->m_patchContextLines, pEncoding, eLineEndStyle);
+        return write(writer);
+    }
+
+    MergeResultWriter writer(analysis.mergeBlockList(), pEncoding, eLineEndStyle, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), sdC->getLineDataForDisplay());
+    writer.setConflictMarkers(job.fileA, job.fileB, job.fileC);
+    return write(writer);
+}
+} // namespace
+
+BatchMerger::BatchMerger(const QSharedPointer<Options>& pOptions):
+    mOptions(pOptions)
+{
+}
+
+bool BatchMerger::readJobs(QIODevice& device, std::vector<Job>& jobs, QString& error)
+{
+    QTextStream in(&device);
+    in.setCodec("UTF-8");
+
+    int lineNumber = 0;
+    while(!in.atEnd())
+    {
+        const QString line = in.readLine();
+        ++lineNumber;
+        if(line.trimmed().isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QStringList fields = line.split('\t');
+        if(fields.size() < 2 || fields.size() > 5 || fields[0].isEmpty() || fields[1].isEmpty())
+        {
+            error = i18n("Job list line %1: expected A, B, C, output and patch separated by tabs.", lineNumber);
+            return false;
+        }
+
+        jobs.push_back({fields[0], fields[1], fields.value(2), fields.value(3), fields.value(4)});
+    }
+
+    return true;
+}
+
+int BatchMerger::run(const std::vector<Job>& jobs)
+{
+    // FileAnalysis takes the fine diff algorithm from there.
+    Diff3Line::m_pDiffBufferInfo->setFineDiffAlgorithm((FineDiffAlgorithm)mOptions->m_fineDiffAlgorithm);
+    for(const Job& job: jobs)
+    {
+        const QJsonObject result = merge(job, mOptions);
+        const QString status = result["status"].toString();
+        if(status == u8"error")
+            mExitCode = 2;
+        else if(status == u8"conflicts")
+            mExitCode = std::max(mExitCode, 1);
+        mReport.append(result);
+    }
+
+    return mExitCode;
+}
+
+QByteArray BatchMerger::report() const
+{
+    return QJsonDocument(mReport).toJson();
+}
+
+QJsonObject BatchMerger::merge(const Job& job, const QSharedPointer<Options>& pOptions)
+{
+    const bool bThreeWay = !job.fileC.isEmpty();
+    QJsonObject result;
+    QJsonArray errors;
+
+    result["A"] = job.fileA;
+    result["B"] = job.fileB;
+    if(bThreeWay)
+        result["C"] = job.fileC;
+    if(!job.output.isEmpty())
+        result["output"] = job.output;
+    if(!job.patch.isEmpty())
+        result["patch"] = job.patch;
+
+    const auto fail = [&result, &errors]() {
+        result["status"] = QStringLiteral("error");
+        result["errors"] = errors;
+        return result;
+    };
+
+    FileAnalysis analysis(pOptions);
+    QStringList loadErrors;
+    analysis.load(job.fileA, job.fileB, job.fileC, loadErrors);
+    for(const QString& error: loadErrors)
+        errors.append(error);
+
+    const auto checkText = [&errors](const QSharedPointer<SourceData>& sd, const QString& fileName) {
+        if(!fileName.isEmpty() && sd->isValid() && !sd->isText())
+            errors.append(i18n("%1 is not a text file.", fileName));
+    };
+
+    checkText(analysis.sdA(), job.fileA);
+    checkText(analysis.sdB(), job.fileB);
+    checkText(analysis.sdC(), job.fileC);
+    if(!errors.isEmpty())
+        return fail();
+
+    analysis.run();
+
+    const QSharedPointer<SourceData>& sdA = analysis.sdA();
+    const QSharedPointer<SourceData>& sdB = analysis.sdB();
+    const QSharedPointer<SourceData>& sdC = analysis.sdC();
+    const MergeBlockList& mergeBlockList = analysis.mergeBlockList();
+
+    int nrOfSolvedConflicts = 0;
+    int nrOfUnsolvedConflicts = 0;
+    int nrOfWhiteSpaceConflicts = 0;
+    QJsonArray conflicts;
+    for(const MergeBlock& mb: mergeBlockList.list())
+    {
+        if(mb.isConflict())
+        {
+            ++nrOfUnsolvedConflicts;
+            conflicts.append(conflictRanges(mb, bThreeWay));
+        }
+        else if(mb.isDelta())
+            ++nrOfSolvedConflicts;
+
+        if(mb.isWhiteSpaceConflict())
+            ++nrOfWhiteSpaceConflicts;
+    }
+
+    result["solvedConflicts"] = nrOfSolvedConflicts;
+    result["unsolvedConflicts"] = nrOfUnsolvedConflicts;
+    result["whiteSpaceConflicts"] = nrOfWhiteSpaceConflicts;
+    result["conflicts"] = conflicts;
+
+    if(!job.patch.isEmpty() && !writePatch(analysis, job, pOptions))
+    {
+        errors.append(i18n("Error while writing %1.", job.patch));
+        return fail();
+    }
+
+    if(nrOfUnsolvedConflicts > 0)
+    {
+        result["status"] = QStringLiteral("conflicts");
+        return result;
+    }
+
+    if(!job.output.isEmpty())
+    {
+        const e_LineEndStyle eLineEndStyle = chooseLineEndStyle(pOptions, sdA->getLineEndStyle(), sdB->getLineEndStyle(), bThreeWay ? sdC->getLineEndStyle() : eLineEndStyleUndefined);
+        if(eLineEndStyle == eLineEndStyleConflict)
+        {
+            errors.append(i18n("There is a line end style conflict. File not saved."));
+            return fail();
+        }
+
+        QTextCodec* pEncoding = outputEncoding(pOptions, bThreeWay ? sdC : sdB);
+
+        if(!saveMergeResult(mergeBlockList, job.output, pEncoding, eLineEndStyle, pOptions->m_bDmCreateBakFiles,
+                            sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), sdC->getLineDataForDisplay()))
+        {
+            errors.append(i18n("Error while writing %1.", job.output));
+            return fail();
+        }
+    }
+
+    result["status"] = QStringLiteral("merged");
+    return result;
+}
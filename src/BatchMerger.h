@@ -0,0 +1,69 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef BATCHMERGER_H
+#define BATCHMERGER_H
+
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+class Options;
+class QIODevice;
+
+/*
+    Merges files without any widgets, for scripts that call kdiff3 many times.
+
+    A job is two or three inputs and optional output and patch files. The inputs go through the
+    same SourceData, line diff and merge block steps as the interactive merge. The output is only
+    written when nothing is left to solve. The patch is written anyway: a unified diff of two
+    inputs, the merge with conflict markers for three. Every job adds an entry to a JSON report describing
+    the remaining conflicts, so the caller doesn't have to parse messages.
+*/
+class BatchMerger
+{
+  public:
+    struct Job
+    {
+        QString fileA; // Base if fileC is set.
+        QString fileB;
+        QString fileC;
+        QString output;
+        QString patch; // - for stdout.
+    };
+
+    explicit BatchMerger(const QSharedPointer<Options>& pOptions);
+
+    // Reads one job per line: A, B, C, output and patch separated by tabs. Only A and B are needed.
+    static bool readJobs(QIODevice& device, std::vector<Job>& jobs, QString& error);
+
+    // Returns 0 if every job was merged, 1 if conflicts are left and 2 if a job failed.
+    int run(const std::vector<Job>& jobs);
+
+    [[nodiscard]] QByteArray report() const;
+
+    /*
+        The report entry of one job, its status is "merged", "conflicts" or "error". Uses no
+        state besides the options, so jobs can run on several threads at once.
+    */
+    [[nodiscard]] static QJsonObject merge(const Job& job, const QSharedPointer<Options>& pOptions);
+
+  private:
+
+    QSharedPointer<Options> mOptions;
+    QJsonArray mReport;
+    int mExitCode = 0;
+};
+
+#endif
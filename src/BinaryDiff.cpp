@@ -0,0 +1,199 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "BinaryDiff.h"
+
+#include "ProgressProxy.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Bounds the index to a few tens of MB however large the first input is.
+constexpr qint64 maxIndexEntries = 1 << 21;
+// Blocks with the same hash are checked in order of their offset, a run of equal blocks needs only the first.
+constexpr int maxCandidates = 8;
+// Bytes of the second input between progress updates.
+constexpr qint64 progressInterval = 1 << 20;
+
+// Number of equal bytes at the start of both, compared a page at a time.
+qint64 commonPrefix(const char* p1, const char* p2, const qint64 size)
+{
+    constexpr qint64 chunkSize = 4096;
+    qint64 equal = 0;
+    while(equal + chunkSize <= size && memcmp(p1 + equal, p2 + equal, chunkSize) == 0)
+        equal += chunkSize;
+    while(equal < size && p1[equal] == p2[equal])
+        ++equal;
+    return equal;
+}
+
+// Number of equal bytes at the end of both, size is the length both have at least.
+qint64 commonSuffix(const char* pEnd1, const char* pEnd2, const qint64 size)
+{
+    constexpr qint64 chunkSize = 4096;
+    qint64 equal = 0;
+    while(equal + chunkSize <= size && memcmp(pEnd1 - equal - chunkSize, pEnd2 - equal - chunkSize, chunkSize) == 0)
+        equal += chunkSize;
+    while(equal < size && pEnd1[-equal - 1] == pEnd2[-equal - 1])
+        ++equal;
+    return equal;
+}
+
+/*
+    The weak checksum of rsync. Both sums are taken modulo 2^16, so the unsigned wrap around of
+    the updates doesn't matter once they are masked.
+*/
+class RollingHash
+{
+  public:
+    RollingHash(const unsigned char* p, const qint64 size):
+        mSize((quint32)size)
+    {
+        for(qint64 i = 0; i < size; ++i)
+        {
+            mA += p[i];
+            mB += (quint32)(size - i) * p[i];
+        }
+        mA &= 0xffff;
+        mB &= 0xffff;
+    }
+
+    // Moves the window one byte on, out leaves it at the front and in enters at the back.
+    void roll(const unsigned char out, const unsigned char in)
+    {
+        mA = (mA - out + in) & 0xffff;
+        mB = (mB - mSize * out + mA) & 0xffff;
+    }
+
+    [[nodiscard]] quint32 value() const { return (mB << 16) | mA; }
+
+  private:
+    quint32 mSize;
+    quint32 mA = 0;
+    quint32 mB = 0;
+};
+} // namespace
+
+BinaryDiff::BinaryDiff(const qint64 blockSize):
+    mMinBlockSize(std::max<qint64>(blockSize, 4))
+{
+}
+
+void BinaryDiff::addBlock(const qint64 offset1, const qint64 size1, const qint64 offset2, const qint64 size2, const bool bEqual)
+{
+    if(size1 == 0 && size2 == 0)
+        return;
+
+    if(!bEqual)
+    {
+        mDifferingBytes1 += size1;
+        mDifferingBytes2 += size2;
+    }
+
+    if(!mBlocks.empty() && mBlocks.back().bEqual == bEqual)
+    {
+        mBlocks.back().size1 += size1;
+        mBlocks.back().size2 += size2;
+        return;
+    }
+
+    mBlocks.push_back({offset1, size1, offset2, size2, bEqual});
+}
+
+bool BinaryDiff::run(const char* p1, const qint64 size1, const char* p2, const qint64 size2)
+{
+    mBlocks.clear();
+    mDifferingBytes1 = 0;
+    mDifferingBytes2 = 0;
+
+    const qint64 prefix = commonPrefix(p1, p2, std::min(size1, size2));
+    const qint64 suffix = commonSuffix(p1 + size1, p2 + size2, std::min(size1, size2) - prefix);
+    addBlock(0, prefix, 0, prefix, true);
+
+    // Only the part between the equal ends is searched, offsets below are relative to it.
+    const char* const a = p1 + prefix;
+    const char* const b = p2 + prefix;
+    const qint64 n1 = size1 - prefix - suffix;
+    const qint64 n2 = size2 - prefix - suffix;
+    const qint64 blockSize = std::max(mMinBlockSize, n1 / maxIndexEntries + 1);
+    qint64 pos1 = 0; // Start of the bytes not matched yet.
+    qint64 pos2 = 0;
+
+    if(n1 >= blockSize && n2 >= blockSize)
+    {
+        ProgressProxy pp;
+        pp.setMaxNofSteps((quint64)n2);
+
+        std::vector<IndexEntry> index;
+        index.reserve((size_t)(n1 / blockSize));
+        for(qint64 offset = 0; offset + blockSize <= n1; offset += blockSize)
+            index.push_back({RollingHash((const unsigned char*)a + offset, blockSize).value(), offset});
+        std::sort(index.begin(), index.end());
+
+        qint64 j = 0; // Start of the window in b.
+        qint64 nextProgress = progressInterval;
+        RollingHash hash((const unsigned char*)b, blockSize);
+        while(j + blockSize <= n2)
+        {
+            const quint32 value = hash.value();
+            bool bMatched = false;
+            int candidates = 0;
+            for(auto it = std::lower_bound(index.cbegin(), index.cend(), IndexEntry{value, pos1});
+                it != index.cend() && it->hash == value && candidates < maxCandidates; ++it, ++candidates)
+            {
+                if(memcmp(a + it->offset, b + j, (size_t)blockSize) != 0)
+                    continue;
+
+                qint64 begin1 = it->offset;
+                qint64 begin2 = j;
+                while(begin1 > pos1 && begin2 > pos2 && a[begin1 - 1] == b[begin2 - 1])
+                    --begin1, --begin2;
+                qint64 end1 = it->offset + blockSize;
+                qint64 end2 = j + blockSize;
+                const qint64 grown = commonPrefix(a + end1, b + end2, std::min(n1 - end1, n2 - end2));
+                end1 += grown;
+                end2 += grown;
+
+                addBlock(prefix + pos1, begin1 - pos1, prefix + pos2, begin2 - pos2, false);
+                addBlock(prefix + begin1, end1 - begin1, prefix + begin2, end2 - begin2, true);
+                pos1 = end1;
+                pos2 = end2;
+                j = end2;
+                bMatched = true;
+                break;
+            }
+
+            if(j >= nextProgress)
+            {
+                nextProgress = j + progressInterval;
+                pp.setCurrent((quint64)j);
+                if(pp.wasCancelled())
+                    return false;
+            }
+
+            if(bMatched)
+            {
+                if(j + blockSize <= n2)
+                    hash = RollingHash((const unsigned char*)b + j, blockSize);
+                continue;
+            }
+
+            if(j + blockSize == n2)
+                break;
+            hash.roll((unsigned char)b[j], (unsigned char)b[j + blockSize]);
+            ++j;
+        }
+        pp.clear();
+    }
+
+    addBlock(prefix + pos1, n1 - pos1, prefix + pos2, n2 - pos2, false);
+    addBlock(size1 - suffix, suffix, size2 - suffix, suffix, true);
+    return true;
+}
@@ -0,0 +1,72 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef BINARYDIFF_H
+#define BINARYDIFF_H
+
+#include <vector>
+
+#include <QtGlobal>
+
+/*
+    Byte level comparison of two inputs that aren't text.
+
+    The first input is cut into blocks whose hashes are kept in a sorted index. A rolling hash of
+    the same width is moved over the second input byte by byte, like rsync does, and every
+    position whose hash is in the index is checked against the block. A match is grown in both
+    directions as far as the bytes agree. Matches are only taken in order, so moved data shows up
+    as removed in one place and inserted in another. Memory use is a fraction of the first input.
+*/
+class BinaryDiff
+{
+  public:
+    // Equal blocks have the same size on both sides, the others are the bytes in between.
+    struct Block
+    {
+        qint64 offset1 = 0;
+        qint64 size1 = 0;
+        qint64 offset2 = 0;
+        qint64 size2 = 0;
+        bool bEqual = false;
+
+        [[nodiscard]] bool operator==(const Block& other) const
+        {
+            return offset1 == other.offset1 && size1 == other.size1 && offset2 == other.offset2 && size2 == other.size2 && bEqual == other.bEqual;
+        }
+    };
+
+    // blockSize is the smallest match looked for, larger inputs use larger blocks to bound the index.
+    explicit BinaryDiff(const qint64 blockSize = 32);
+
+    // Returns false if the user cancelled.
+    bool run(const char* p1, const qint64 size1, const char* p2, const qint64 size2);
+
+    [[nodiscard]] inline const std::vector<Block>& blocks() const { return mBlocks; }
+    [[nodiscard]] inline qint64 differingBytes1() const { return mDifferingBytes1; }
+    [[nodiscard]] inline qint64 differingBytes2() const { return mDifferingBytes2; }
+    [[nodiscard]] inline bool isEqual() const { return mDifferingBytes1 == 0 && mDifferingBytes2 == 0; }
+
+  private:
+    struct IndexEntry
+    {
+        quint32 hash;
+        qint64 offset;
+
+        [[nodiscard]] bool operator<(const IndexEntry& other) const { return hash < other.hash || (hash == other.hash && offset < other.offset); }
+    };
+
+    void addBlock(const qint64 offset1, const qint64 size1, const qint64 offset2, const qint64 size2, const bool bEqual);
+
+    qint64 mMinBlockSize;
+    std::vector<Block> mBlocks;
+    qint64 mDifferingBytes1 = 0;
+    qint64 mDifferingBytes2 = 0;
+};
+
+#endif
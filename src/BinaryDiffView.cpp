@@ -0,0 +1,184 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "BinaryDiffView.h"
+
+#include "options.h"
+#include "SourceData.h"
+#include "TypeUtils.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScrollBar>
+
+namespace {
+// Characters of one side: the offset, two spaces, 16 bytes in two groups of eight, two spaces and the characters.
+constexpr int hexColumn(const int offsetDigits, const int i) { return offsetDigits + 2 + i * 3 + (i >= 8 ? 1 : 0); }
+constexpr int charColumn(const int offsetDigits, const int i) { return offsetDigits + 52 + i; }
+constexpr int sideColumns(const int offsetDigits) { return charColumn(offsetDigits, 16); }
+// Between the two sides.
+constexpr int gapColumns = 3;
+
+QString hexByte(const unsigned char c)
+{
+    return QString::number(c, 16).rightJustified(2, QLatin1Char('0'));
+}
+} // namespace
+
+BinaryDiffView::BinaryDiffView(const QSharedPointer<Options>& pOptions, QWidget* pParent):
+    QAbstractScrollArea(pParent), m_pOptions(pOptions)
+{
+    setFont(m_pOptions->defaultFont());
+    viewport()->setAutoFillBackground(false);
+    setFocusPolicy(Qt::StrongFocus);
+}
+
+void BinaryDiffView::init(const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, const std::vector<BinaryDiff::Block>& blocks)
+{
+    mSd1 = sd1;
+    mSd2 = sd2;
+    mSize1 = mSd1->getSizeBytes();
+    mSize2 = mSd2->getSizeBytes();
+    mBlocks = blocks;
+
+    mFirstRows.clear();
+    mFirstRows.reserve(mBlocks.size() + 1);
+    qint64 rows = 0;
+    for(const BinaryDiff::Block& block: mBlocks)
+    {
+        mFirstRows.push_back(rows);
+        rows += (std::max(block.size1, block.size2) + bytesPerRow - 1) / bytesPerRow;
+    }
+    mFirstRows.push_back(rows);
+
+    const qint64 maxOffset = std::max(mSize1, mSize2);
+    mOffsetDigits = std::max(8, (int)QString::number(maxOffset, 16).length());
+
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    updateScrollBars();
+    viewport()->update();
+}
+
+size_t BinaryDiffView::blockOfRow(const qint64 row) const
+{
+    return (size_t)(std::upper_bound(mFirstRows.cbegin(), mFirstRows.cend() - 1, row) - mFirstRows.cbegin()) - 1;
+}
+
+int BinaryDiffView::sideWidth() const
+{
+    return sideColumns(mOffsetDigits) * Utils::getHorizontalAdvance(fontMetrics(), QChar('0'));
+}
+
+void BinaryDiffView::updateScrollBars()
+{
+    const int lineSpacing = fontMetrics().lineSpacing();
+    const int visibleRows = std::max(1, viewport()->height() / lineSpacing);
+    // Past 2^31 rows, above 32 GB, the end can't be scrolled to.
+    const qint64 rows = mFirstRows.empty() ? 0 : mFirstRows.back();
+    verticalScrollBar()->setRange(0, (int)std::min<qint64>(std::max<qint64>(0, rows - visibleRows + 1), limits<int>::max()));
+    verticalScrollBar()->setPageStep(visibleRows);
+
+    const int width = 2 * sideWidth() + gapColumns * Utils::getHorizontalAdvance(fontMetrics(), QChar('0'));
+    horizontalScrollBar()->setRange(0, std::max(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void BinaryDiffView::resizeEvent(QResizeEvent* pEvent)
+{
+    QAbstractScrollArea::resizeEvent(pEvent);
+    updateScrollBars();
+}
+
+void BinaryDiffView::slotGoNextDifference()
+{
+    const qint64 top = verticalScrollBar()->value();
+    for(size_t i = 0; i < mBlocks.size(); ++i)
+    {
+        if(!mBlocks[i].bEqual && mFirstRows[i] > top)
+        {
+            verticalScrollBar()->setValue((int)std::min<qint64>(mFirstRows[i], limits<int>::max()));
+            return;
+        }
+    }
+}
+
+void BinaryDiffView::slotGoPrevDifference()
+{
+    const qint64 top = verticalScrollBar()->value();
+    for(size_t i = mBlocks.size(); i-- > 0;)
+    {
+        if(!mBlocks[i].bEqual && mFirstRows[i] < top)
+        {
+            verticalScrollBar()->setValue((int)mFirstRows[i]);
+            return;
+        }
+    }
+}
+
+void BinaryDiffView::paintEvent(QPaintEvent* pEvent)
+{
+    QPainter painter(viewport());
+    painter.setFont(font());
+    painter.fillRect(pEvent->rect(), m_pOptions->backgroundColor());
+    if(mBlocks.empty() || mSd1->getSizeBytes() != mSize1 || mSd2->getSizeBytes() != mSize2 ||
+       (mSize1 > 0 && mSd1->getBuf() == nullptr) || (mSize2 > 0 && mSd2->getBuf() == nullptr))
+        return;
+
+    const int lineSpacing = fontMetrics().lineSpacing();
+    const qint64 firstRow = verticalScrollBar()->value() + pEvent->rect().top() / lineSpacing;
+    const qint64 lastRow = std::min(mFirstRows.back() - 1, verticalScrollBar()->value() + (qint64)(pEvent->rect().bottom() / lineSpacing));
+    for(qint64 row = firstRow; row <= lastRow; ++row)
+        paintRow(painter, row, (int)(row - verticalScrollBar()->value()) * lineSpacing);
+}
+
+void BinaryDiffView::paintRow(QPainter& painter, const qint64 row, const int y)
+{
+    const size_t blockIdx = blockOfRow(row);
+    const BinaryDiff::Block& block = mBlocks[blockIdx];
+    const qint64 start = (row - mFirstRows[blockIdx]) * bytesPerRow;
+    const qint64 count1 = std::clamp<qint64>(block.size1 - start, 0, bytesPerRow);
+    const qint64 count2 = std::clamp<qint64>(block.size2 - start, 0, bytesPerRow);
+    const char* pData1 = mSd1->getBuf() + block.offset1 + start;
+    const char* pData2 = mSd2->getBuf() + block.offset2 + start;
+
+    if(!block.bEqual)
+        painter.fillRect(0, y, viewport()->width(), fontMetrics().lineSpacing(), m_pOptions->diffBackgroundColor());
+
+    const int x1 = -horizontalScrollBar()->value();
+    const int x2 = x1 + sideWidth() + gapColumns * Utils::getHorizontalAdvance(fontMetrics(), QChar('0'));
+    paintSide(painter, x1, y, pData1, block.offset1 + start, count1, pData2, count2, block.bEqual, m_pOptions->aColor());
+    paintSide(painter, x2, y, pData2, block.offset2 + start, count2, pData1, count1, block.bEqual, m_pOptions->bColor());
+}
+
+void BinaryDiffView::paintSide(QPainter& painter, const int x, const int y, const char* pData, const qint64 offset, const qint64 count,
+                               const char* pOtherData, const qint64 otherCount, const bool bEqual, const QColor& diffColor)
+{
+    if(count == 0)
+        return;
+
+    const int charWidth = Utils::getHorizontalAdvance(fontMetrics(), QChar('0'));
+    const int baseLine = y + fontMetrics().ascent();
+
+    painter.setPen(m_pOptions->foregroundColor());
+    painter.drawText(x, baseLine, QString::number(offset, 16).rightJustified(mOffsetDigits, QLatin1Char('0')));
+
+    for(int i = 0; i < count; ++i)
+    {
+        const unsigned char c = (unsigned char)pData[i];
+        // Within a changed block the bytes are compared by position, so a single replaced byte stands out.
+        const bool bDiffers = !bEqual && (i >= otherCount || pData[i] != pOtherData[i]);
+        painter.setPen(bDiffers ? diffColor : m_pOptions->foregroundColor());
+        painter.drawText(x + hexColumn(mOffsetDigits, i) * charWidth, baseLine, hexByte(c));
+        painter.drawText(x + charColumn(mOffsetDigits, i) * charWidth, baseLine, QString(QLatin1Char(c >= 0x20 && c < 0x7f ? (char)c : '.')));
+    }
+}
@@ -0,0 +1,69 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef BINARYDIFFVIEW_H
+#define BINARYDIFFVIEW_H
+
+#include "BinaryDiff.h"
+
+#include <vector>
+
+#include <QAbstractScrollArea>
+#include <QSharedPointer>
+
+class Options;
+class QColor;
+class QPainter;
+class SourceData;
+
+/*
+    Hex dump of two inputs side by side, aligned by the blocks of a BinaryDiff. Every block takes
+    as many rows of 16 bytes as its larger side needs. Only the rows in view are formatted when
+    painting, so the size of the inputs only matters for the row index, and a mapped file is only
+    read where it is shown.
+*/
+class BinaryDiffView: public QAbstractScrollArea
+{
+    Q_OBJECT
+  public:
+    BinaryDiffView(const QSharedPointer<Options>& pOptions, QWidget* pParent);
+
+    // Nothing is painted once an input was reloaded with another size.
+    void init(const QSharedPointer<SourceData>& sd1, const QSharedPointer<SourceData>& sd2, const std::vector<BinaryDiff::Block>& blocks);
+
+  public Q_SLOTS:
+    void slotGoNextDifference();
+    void slotGoPrevDifference();
+
+  protected:
+    void paintEvent(QPaintEvent* pEvent) override;
+    void resizeEvent(QResizeEvent* pEvent) override;
+
+  private:
+    static constexpr qint64 bytesPerRow = 16;
+
+    void updateScrollBars();
+    // Index of the block the row belongs to.
+    [[nodiscard]] size_t blockOfRow(const qint64 row) const;
+    [[nodiscard]] int sideWidth() const;
+    void paintRow(QPainter& painter, const qint64 row, const int y);
+    void paintSide(QPainter& painter, const int x, const int y, const char* pData, const qint64 offset, const qint64 count,
+                   const char* pOtherData, const qint64 otherCount, const bool bEqual, const QColor& diffColor);
+
+    QSharedPointer<Options> m_pOptions;
+    QSharedPointer<SourceData> mSd1;
+    QSharedPointer<SourceData> mSd2;
+    qint64 mSize1 = 0;
+    qint64 mSize2 = 0;
+    std::vector<BinaryDiff::Block> mBlocks;
+    std::vector<qint64> mFirstRows; // First row of each block, one more entry for the total.
+    int mOffsetDigits = 8;
+};
+
+#endif
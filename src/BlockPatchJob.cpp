@@ -0,0 +1,220 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "BlockPatchJob.h"
+
+#include "defmac.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QFileInfo>
+#include <QTimer>
+
+#include <KIO/FileCopyJob>
+#include <KIO/FileJob>
+#include <KIO/Job>
+#include <KIO/SimpleJob>
+
+BlockPatchJob::BlockPatchJob(const QString& source, const QUrl& destination, QObject* pParent):
+    KJob(pParent), mSource(source), mDestination(destination), mSourceFile(source)
+{
+}
+
+void BlockPatchJob::start()
+{
+    QTimer::singleShot(0, this, &BlockPatchJob::openDestination);
+}
+
+std::vector<BlockPatchJob::Range> BlockPatchJob::differingBlocks(const char* pSource, const char* pDest, const qint64 size)
+{
+    std::vector<Range> ranges;
+    for(qint64 offset = 0; offset < size; offset += blockSize)
+    {
+        const qint64 length = std::min(blockSize, size - offset);
+        if(memcmp(pSource + offset, pDest + offset, (size_t)length) == 0)
+            continue;
+
+        if(!ranges.empty() && ranges.back().offset + ranges.back().size == offset)
+            ranges.back().size += length;
+        else
+            ranges.push_back({offset, length});
+    }
+    return ranges;
+}
+
+void BlockPatchJob::openDestination()
+{
+    if(!mSourceFile.open(QIODevice::ReadOnly))
+    {
+        setError(KIO::ERR_CANNOT_OPEN_FOR_READING);
+        setErrorText(mSource);
+        emitResult();
+        return;
+    }
+    mSourceSize = mSourceFile.size();
+
+    mpFileJob = KIO::open(mDestination, QIODevice::ReadWrite);
+    chk_connect_a(mpFileJob, &KIO::FileJob::open, this, [this]() {
+        mDestSize = (qint64)mpFileJob->size();
+        next();
+    });
+    chk_connect_a(mpFileJob, &KIO::FileJob::data, this, [this](KIO::Job*, const QByteArray& data) { destinationData(data); });
+    chk_connect_a(mpFileJob, &KIO::FileJob::position, this, [this](KIO::Job*, KIO::filesize_t position) {
+        mPosition = (qint64)position;
+        next();
+    });
+    chk_connect_a(mpFileJob, &KIO::FileJob::written, this, [this](KIO::Job*, KIO::filesize_t written) {
+        mPosition += (qint64)written;
+        mBytesSent += (qint64)written;
+        mWrites.pop_front();
+        next();
+    });
+    chk_connect_a(mpFileJob, &KIO::FileJob::truncated, this, [this]() { next(); });
+    chk_connect_a(mpFileJob, &KJob::result, this, &BlockPatchJob::destinationDone);
+}
+
+// Each step asks the file job for one thing, its signal calls this again.
+void BlockPatchJob::next()
+{
+    // The changes found in the last chunk go first.
+    if(!mWrites.empty())
+    {
+        if(mPosition != mWrites.front().offset)
+            mpFileJob->seek((KIO::filesize_t)mWrites.front().offset);
+        else
+            mpFileJob->write(mWrites.front().data);
+        return;
+    }
+
+    const qint64 compareSize = std::min(mSourceSize, mDestSize);
+    if(mOffset < compareSize)
+    {
+        if(mPosition != mOffset)
+        {
+            mpFileJob->seek((KIO::filesize_t)mOffset);
+            return;
+        }
+
+        mDestChunk.clear();
+        mRequested = std::min(chunkSize, compareSize - mOffset);
+        mbReading = true;
+        mpFileJob->read((KIO::filesize_t)mRequested);
+        return;
+    }
+
+    // What the destination lacks is appended.
+    if(mOffset < mSourceSize)
+    {
+        Write write;
+        write.offset = mOffset;
+        if(!mSourceFile.seek(mOffset) || (write.data = mSourceFile.read(std::min(chunkSize, mSourceSize - mOffset))).isEmpty())
+        {
+            fullCopy();
+            return;
+        }
+        mOffset += write.data.size();
+        mWrites.push_back(write);
+        next();
+        return;
+    }
+
+    if(mDestSize > mSourceSize && !mbTruncated)
+    {
+        mbTruncated = true;
+        mpFileJob->truncate((KIO::filesize_t)mSourceSize);
+        return;
+    }
+
+    mbClosing = true;
+    mpFileJob->close();
+}
+
+void BlockPatchJob::destinationData(const QByteArray& data)
+{
+    if(!mbReading)
+        return;
+
+    mDestChunk += data;
+    // An empty block marks the end of the file.
+    if(!data.isEmpty() && mDestChunk.size() < mRequested)
+        return;
+
+    mbReading = false;
+    mPosition += mDestChunk.size();
+    if(mDestChunk.size() < mRequested)
+        mDestSize = mOffset + mDestChunk.size();
+
+    compareChunk();
+}
+
+void BlockPatchJob::compareChunk()
+{
+    QByteArray source;
+    if(!mSourceFile.seek(mOffset) || (source = mSourceFile.read(mDestChunk.size())).size() != mDestChunk.size())
+    {
+        fullCopy();
+        return;
+    }
+
+    for(const Range& range: differingBlocks(source.constData(), mDestChunk.constData(), source.size()))
+        mWrites.push_back({mOffset + range.offset, source.mid((int)range.offset, (int)range.size)});
+
+    mOffset += source.size();
+    next();
+}
+
+void BlockPatchJob::destinationDone(KJob* pJob)
+{
+    // Anything going wrong before the file was put right is mended by a plain copy.
+    if(pJob->error() != KJob::NoError || !mbClosing)
+    {
+        qCInfo(kdiffFileAccess) << "Patching" << mDestination << "in place failed, copying instead:" << pJob->errorString();
+        fullCopy();
+        return;
+    }
+
+    qCInfo(kdiffFileAccess) << "Patched" << mDestination << "sending" << mBytesSent << "of" << mSourceSize << "bytes";
+    setModificationTime();
+}
+
+// Like a copy would, so the next comparison doesn't find the destination newer.
+void BlockPatchJob::setModificationTime()
+{
+    KIO::SimpleJob* pJob = KIO::setModificationTime(mDestination, QFileInfo(mSource).lastModified());
+    // The content is right either way.
+    chk_connect_a(pJob, &KJob::result, this, [this]() { emitResult(); });
+}
+
+void BlockPatchJob::fullCopy()
+{
+    if(mbFullCopy)
+        return;
+
+    mbFullCopy = true;
+    mWrites.clear();
+    if(mpFileJob != nullptr)
+    {
+        disconnect(mpFileJob, nullptr, this, nullptr);
+        mpFileJob->kill(KJob::Quietly);
+    }
+
+    KIO::FileCopyJob* pJob = KIO::file_copy(QUrl::fromLocalFile(mSource), mDestination, -1, KIO::HideProgressInfo | KIO::Overwrite);
+    chk_connect_a(pJob, &KJob::result, this, [this](KJob* pCopyJob) {
+        if(pCopyJob->error() != KJob::NoError)
+        {
+            setError(pCopyJob->error());
+            setErrorText(pCopyJob->errorText());
+        }
+        else
+            mBytesSent = mSourceSize;
+        emitResult();
+    });
+}
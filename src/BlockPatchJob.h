@@ -0,0 +1,97 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef BLOCKPATCHJOB_H
+#define BLOCKPATCHJOB_H
+
+#include <deque>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QPointer>
+#include <QUrl>
+
+#include <KJob>
+
+namespace KIO {
+class FileJob;
+class Job;
+} // namespace KIO
+
+/*
+    Brings a remote file up to date with a local one by writing only the blocks that differ.
+
+    Without a helper on the remote host the checksums of its blocks can't be calculated there, so
+    the destination is read in large chunks and compared here block by block. Only the changed
+    blocks travel back, which is what counts on links that upload far slower than they download.
+    Blocks are compared at the same offset, data shifted by an insertion counts as changed.
+
+    When the protocol can't open files for writing at an offset, the destination doesn't exist
+    yet or anything fails on the way, the whole file is copied with KIO::file_copy instead.
+*/
+class BlockPatchJob: public KJob
+{
+    Q_OBJECT
+  public:
+    static constexpr qint64 blockSize = 64 * 1024;
+    static constexpr qint64 chunkSize = 16 * blockSize;
+
+    struct Range
+    {
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    BlockPatchJob(const QString& source, const QUrl& destination, QObject* pParent = nullptr);
+
+    void start() override;
+
+    // Runs of differing blocks within the first size bytes of both, adjacent blocks are merged.
+    [[nodiscard]] static std::vector<Range> differingBlocks(const char* pSource, const char* pDest, const qint64 size);
+
+    // Bytes sent to the destination, the whole file after a fallback.
+    [[nodiscard]] qint64 bytesSent() const { return mBytesSent; }
+    [[nodiscard]] bool usedFullCopy() const { return mbFullCopy; }
+
+  private:
+    struct Write
+    {
+        qint64 offset = 0;
+        QByteArray data;
+    };
+
+    void openDestination();
+    void next();
+    void destinationData(const QByteArray& data);
+    void compareChunk();
+    void destinationDone(KJob* pJob);
+    void setModificationTime();
+    void fullCopy();
+
+    QString mSource;
+    QUrl mDestination;
+    QFile mSourceFile;
+    QPointer<KIO::FileJob> mpFileJob;
+
+    qint64 mSourceSize = 0;
+    qint64 mDestSize = 0;
+    qint64 mOffset = 0;   // Everything before is up to date.
+    qint64 mPosition = 0; // Of the destination file job.
+    qint64 mRequested = 0;
+    QByteArray mDestChunk;
+    std::deque<Write> mWrites;
+    bool mbReading = false;
+    bool mbTruncated = false;
+    bool mbClosing = false;
+    bool mbFullCopy = false;
+    qint64 mBytesSent = 0;
+};
+
+#endif
@@ -13,7 +13,6 @@
 #include <algorithm>
 
 #include <QChar>
-#include <QRegularExpression>
 #include <QString>
 
 void DefaultCommentParser::processChar(const QString &line, const QChar &inChar)
@@ -124,36 +123,79 @@ void DefaultCommentParser::processChar(const QString &line, const QChar &inChar)
     ++offset;
 };
 
+namespace {
+// Only these characters can start or end a comment or a string.
+bool hasSyntaxChars(const QString &line)
+{
+    for(const QChar &c : line)
+    {
+        switch(c.unicode())
+        {
+            case '\\':
+            case '\'':
+            case '"':
+            case '/':
+            case '*':
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+} // namespace
+
 /*
     Find comments if any and set its pure comment flag if it has nothing but whitespace and comments.
 */
 void DefaultCommentParser::processLine(const QString &line)
 {
-    static const QRegularExpression nonWhiteRegexp = QRegularExpression("[\\S]", QRegularExpression::UseUnicodePropertiesOption);
-    static const QRegularExpression tailRegexp = QRegularExpression("\\s+$", QRegularExpression::UseUnicodePropertiesOption);
-    offset = line.indexOf(nonWhiteRegexp);
-    const QtNumberType trailIndex = line.lastIndexOf(tailRegexp);
+    QtSizeType start = 0;
+    while(start < line.length() && line[start].isSpace())
+        ++start;
+    QtSizeType end = line.length();
+    while(end > start && line[end - 1].isSpace())
+        --end;
+
+    offset = start < line.length() ? start : -1;
 
     lastComment.startOffset = lastComment.endOffset = 0; //reset these for each line
     comments.clear();
 
-    //remove trailing and ending spaces.
-    const QString trimmedLine = line.trimmed();
-
-    for(const QChar &c : trimmedLine)
+    if(!hasSyntaxChars(line))
     {
-        processChar(trimmedLine, c);
+        /*
+            Without any of these characters processChar only takes its default branch.
+            Skip the per character work and keep just its effect on the flags.
+        */
+        if(start < end)
+        {
+            if(!inComment())
+                mIsPureComment = mIsCommentOrWhite = false;
+            mLastChar = line[end - 1];
+            offset += end - start;
+        }
+    }
+    else
+    {
+        //remove trailing and ending spaces.
+        const QString trimmedLine = line.mid(start, end - start);
+
+        for(const QChar &c : trimmedLine)
+        {
+            processChar(trimmedLine, c);
+        }
     }
     /*
         Line has trailing space after multi-line comment ended.
     */
-    if(trailIndex != -1 && !inComment())
+    if(!line.isEmpty() && line.back().isSpace() && !inComment())
     {
         mIsPureComment = false;
     }
 
     //mIsPureComment = mIsPureComment && offset == 0;
-    processChar(trimmedLine, '\n');
+    processChar(line, '\n');
 }
 
 /*
@@ -0,0 +1,176 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "CompressedInput.h"
+
+#include "TypeUtils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QBuffer>
+#include <QFile>
+
+#include <KLocalizedString>
+
+namespace {
+constexpr qint64 pieceSize = 1024 * 1024;
+
+bool hasMagic(const KCompressionDevice::CompressionType type, const char* data, const qint64 size)
+{
+    const auto startsWith = [data, size](const char* magic, const qint64 magicSize) {
+        return size >= magicSize && memcmp(data, magic, magicSize) == 0;
+    };
+
+    switch(type)
+    {
+        case KCompressionDevice::GZip:
+            return startsWith("\x1F\x8B", 2);
+        case KCompressionDevice::BZip2:
+            return startsWith("BZh", 3);
+        case KCompressionDevice::Xz:
+            return startsWith("\xFD" "7zXZ\x00", 6);
+        case KCompressionDevice::Zstd:
+            return startsWith("\x28\xB5\x2F\xFD", 4);
+        default:
+            return false;
+    }
+}
+
+QString readError(const QIODevice& device)
+{
+    return device.errorString().isEmpty() ? i18n("The compressed data is damaged.") : device.errorString();
+}
+} // namespace
+
+KCompressionDevice::CompressionType CompressedInput::typeForName(const QString& fileName)
+{
+    if(fileName.endsWith(QLatin1String(".gz"), Qt::CaseInsensitive))
+        return KCompressionDevice::GZip;
+    if(fileName.endsWith(QLatin1String(".bz2"), Qt::CaseInsensitive))
+        return KCompressionDevice::BZip2;
+    if(fileName.endsWith(QLatin1String(".xz"), Qt::CaseInsensitive))
+        return KCompressionDevice::Xz;
+    if(fileName.endsWith(QLatin1String(".zst"), Qt::CaseInsensitive))
+        return KCompressionDevice::Zstd;
+    return KCompressionDevice::None;
+}
+
+KCompressionDevice::CompressionType CompressedInput::type(const QString& fileName, const char* data, const qint64 size)
+{
+    const KCompressionDevice::CompressionType nameType = typeForName(fileName);
+    return data != nullptr && hasMagic(nameType, data, size) ? nameType : KCompressionDevice::None;
+}
+
+bool CompressedInput::decompress(const char* data, const qint64 size, const KCompressionDevice::CompressionType type, QByteArray& out, QString& errorString)
+{
+    out.clear();
+    if(size > limits<QtSizeType>::max())
+    {
+        errorString = i18n("The compressed data is too large.");
+        return false;
+    }
+
+    QBuffer* pBuffer = new QBuffer();
+    pBuffer->setData(QByteArray::fromRawData(data, (QtSizeType)size));
+    KCompressionDevice device(pBuffer, true, type);
+    if(!device.open(QIODevice::ReadOnly))
+    {
+        errorString = readError(device);
+        return false;
+    }
+
+    for(;;)
+    {
+        const QtSizeType oldSize = out.size();
+        if(oldSize > limits<QtSizeType>::max() - pieceSize)
+        {
+            errorString = i18n("The decompressed data is too large.");
+            return false;
+        }
+        out.resize(oldSize + (QtSizeType)pieceSize);
+        const qint64 bytesRead = device.read(out.data() + oldSize, pieceSize);
+        if(bytesRead < 0)
+        {
+            errorString = readError(device);
+            out.clear();
+            return false;
+        }
+        out.resize(oldSize + (QtSizeType)bytesRead);
+        if(bytesRead == 0)
+            break;
+    }
+    return true;
+}
+
+std::unique_ptr<KCompressionDevice> CompressedInput::open(const QString& fileName)
+{
+    const KCompressionDevice::CompressionType nameType = typeForName(fileName);
+    if(nameType == KCompressionDevice::None)
+        return nullptr;
+
+    // Only the magic bytes are read here.
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return nullptr;
+    const QByteArray start = file.read(8);
+    if(!hasMagic(nameType, start.constData(), start.size()))
+        return nullptr;
+    file.close();
+
+    std::unique_ptr<KCompressionDevice> pDevice = std::make_unique<KCompressionDevice>(fileName, nameType);
+    if(!pDevice->open(QIODevice::ReadOnly))
+        return nullptr;
+    return pDevice;
+}
+
+bool CompressedInput::isEqual(const QString& fileName1, const QString& fileName2, bool& bEqual, QString& errorString)
+{
+    bEqual = false;
+    const std::unique_ptr<KCompressionDevice> pDevice1 = open(fileName1);
+    const std::unique_ptr<KCompressionDevice> pDevice2 = open(fileName2);
+    if(pDevice1 == nullptr || pDevice2 == nullptr)
+    {
+        errorString = i18n("Opening %1 failed.", pDevice1 == nullptr ? fileName1 : fileName2);
+        return false;
+    }
+
+    QByteArray piece1((QtSizeType)pieceSize, '\0'), piece2((QtSizeType)pieceSize, '\0');
+    for(;;)
+    {
+        // The decompressors may return less than asked for, so both are filled completely.
+        qint64 size1 = 0, size2 = 0;
+        for(qint64 n = 1; size1 < pieceSize && n > 0; size1 += std::max<qint64>(n, 0))
+        {
+            n = pDevice1->read(piece1.data() + size1, pieceSize - size1);
+            if(n < 0)
+            {
+                errorString = readError(*pDevice1);
+                return false;
+            }
+        }
+        for(qint64 n = 1; size2 < pieceSize && n > 0; size2 += std::max<qint64>(n, 0))
+        {
+            n = pDevice2->read(piece2.data() + size2, pieceSize - size2);
+            if(n < 0)
+            {
+                errorString = readError(*pDevice2);
+                return false;
+            }
+        }
+
+        if(size1 != size2 || memcmp(piece1.constData(), piece2.constData(), size1) != 0)
+            return true;
+        if(size1 < pieceSize)
+            break;
+    }
+
+    bEqual = true;
+    return true;
+}
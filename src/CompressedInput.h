@@ -0,0 +1,42 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef COMPRESSEDINPUT_H
+#define COMPRESSEDINPUT_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QString>
+
+#include <KCompressionDevice>
+
+/*
+    Inputs compressed with gzip, xz, zstd or bzip2 are compared by their content. A file counts as
+    compressed if its name has the usual suffix and its data starts with the matching magic bytes,
+    a text file that happens to start with "BZh" stays what it is. KCompressionDevice decompresses
+    from memory or straight from a local file, piece by piece.
+*/
+class CompressedInput
+{
+  public:
+    // By the suffix of fileName, KCompressionDevice::None if it has none of them.
+    [[nodiscard]] static KCompressionDevice::CompressionType typeForName(const QString& fileName);
+    // Also checks the magic bytes at the start of data.
+    [[nodiscard]] static KCompressionDevice::CompressionType type(const QString& fileName, const char* data, const qint64 size);
+
+    static bool decompress(const char* data, const qint64 size, const KCompressionDevice::CompressionType type, QByteArray& out, QString& errorString);
+
+    // Reads the content of the local compressed file fileName, nullptr if it isn't one.
+    [[nodiscard]] static std::unique_ptr<KCompressionDevice> open(const QString& fileName);
+    // Compares the content of two local compressed files without keeping either in memory.
+    static bool isEqual(const QString& fileName1, const QString& fileName2, bool& bEqual, QString& errorString);
+};
+
+#endif
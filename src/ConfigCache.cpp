@@ -0,0 +1,112 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "ConfigCache.h"
+
+#include "Logging.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+constexpr quint32 fileMagic = 0x4B444343; // "KDCC"
+constexpr qint32 fileVersion = 1;
+} // namespace
+
+ConfigCache::ConfigCache(const KSharedConfigPtr& config, const QString& group, const QString& fileName):
+    mConfig(config), mGroup(config->group(group)), mFileName(fileName)
+{
+}
+
+ConfigCache::ConfigCache(const KSharedConfigPtr& config, const QString& group):
+    ConfigCache(config, group, QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/config-") + QFileInfo(config->name()).fileName())
+{
+}
+
+ConfigCache::~ConfigCache() = default;
+
+QByteArray ConfigCache::configStamp() const
+{
+    const QString name = mConfig->name();
+    const QStringList files = QFileInfo(name).isAbsolute() ? QStringList(name) : QStandardPaths::locateAll(mConfig->locationType(), name);
+
+    QByteArray stamp;
+    QDataStream out(&stamp, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << mGroup.name();
+    for(const QString& file: files)
+    {
+        const QFileInfo fileInfo(file);
+        out << file << fileInfo.size() << (fileInfo.exists() ? fileInfo.lastModified().toMSecsSinceEpoch() : (qint64)0);
+    }
+    return stamp;
+}
+
+void ConfigCache::insert(const QString& key, const QVariant& value)
+{
+    mValues.insert(key, value);
+    mbDirty = true;
+}
+
+void ConfigCache::load()
+{
+    if(mbLoaded)
+        return;
+    mbLoaded = true;
+
+    QFile file(mFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    qint32 version = 0;
+    QByteArray stamp;
+    in >> magic >> version >> stamp;
+    // Changed config files are simply read again.
+    if(magic != fileMagic || version != fileVersion || stamp != configStamp())
+        return;
+
+    QHash<QString, QVariant> values;
+    in >> values;
+    if(in.status() != QDataStream::Ok)
+    {
+        qCWarning(kdiffMain) << "Ignoring damaged config cache" << mFileName;
+        return;
+    }
+    mValues = values;
+}
+
+bool ConfigCache::save()
+{
+    if(!mbDirty)
+        return true;
+
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    QSaveFile file(mFileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << fileMagic << fileVersion << configStamp() << mValues;
+
+    if(!file.commit())
+        return false;
+
+    mbDirty = false;
+    return true;
+}
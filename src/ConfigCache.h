@@ -0,0 +1,95 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include "common.h"
+
+#include <QByteArray>
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+/*
+    Typed values of a config group as they were read or written last time, stored in the user's
+    cache folder.
+
+    KConfig keeps the text of the config files and converts it again every time a font, color or
+    list is read. The cache is used only while the config files are unchanged. Names it doesn't
+    know yet are read from the config and added, so a cache written by batch mode, which knows
+    fewer settings, still works for the GUI.
+*/
+class ConfigCache: public ValueMap
+{
+  public:
+    ConfigCache(const KSharedConfigPtr& config, const QString& group, const QString& fileName);
+    // Stored in the cache folder, next to the other caches.
+    ConfigCache(const KSharedConfigPtr& config, const QString& group);
+    ~ConfigCache() override;
+
+    // Writes the values if any were added. Call after the config was synced.
+    bool save();
+
+    void writeEntry(const QString& k, const QFont& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const QColor& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const QSize& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const QPoint& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, int v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, bool v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const QStringList& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const QString& v) override { insert(k, QVariant::fromValue(v)); }
+    void writeEntry(const QString& k, const char* v) override { insert(k, QVariant(QString(QLatin1String(v)))); }
+
+  private:
+    QFont readFontEntry(const QString& k, const QFont* defaultVal) override { return value(k, *defaultVal); }
+    QColor readColorEntry(const QString& k, const QColor* defaultVal) override { return value(k, *defaultVal); }
+    QSize readSizeEntry(const QString& k, const QSize* defaultVal) override { return value(k, *defaultVal); }
+    QPoint readPointEntry(const QString& k, const QPoint* defaultVal) override { return value(k, *defaultVal); }
+    bool readBoolEntry(const QString& k, bool bDefault) override { return value(k, bDefault); }
+    int readNumEntry(const QString& k, int iDefault) override { return value(k, iDefault); }
+    QStringList readListEntry(const QString& k, const QStringList& defaultVal) override { return value(k, defaultVal); }
+    QString readStringEntry(const QString& k, const QString& defaultVal) override { return value(k, defaultVal); }
+
+    template <class T>
+    T value(const QString& key, const T& defaultVal)
+    {
+        load();
+        const QHash<QString, QVariant>::const_iterator it = mValues.constFind(key);
+        if(it != mValues.constEnd())
+            return it->isValid() ? it->value<T>() : defaultVal;
+
+        const T result = mGroup.readEntry(key, defaultVal);
+        // Names missing in the config are remembered too, their defaults apply.
+        insert(key, mGroup.hasKey(key) ? QVariant::fromValue(result) : QVariant());
+        return result;
+    }
+
+    void insert(const QString& key, const QVariant& value);
+    void load();
+    // Names, sizes and modification times of the files the config was read from.
+    [[nodiscard]] QByteArray configStamp() const;
+
+    KSharedConfigPtr mConfig;
+    KConfigGroup mGroup;
+    QString mFileName;
+    QHash<QString, QVariant> mValues;
+    bool mbLoaded = false;
+    bool mbDirty = false;
+};
+
+#endif
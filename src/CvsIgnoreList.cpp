@@ -21,7 +21,6 @@
 #include <QByteArray>
 #include <QDir>
 #include <QFile>
-#include <QRegularExpression>
 #include <QStringList>
 #include <QTextStream>
 
@@ -34,13 +33,28 @@ void CvsIgnoreList::enterDir(const QString& dir, const DirectoryList& directoryL
     static const QString ignorestr = QString::fromLatin1(". .. core RCSLOG tags TAGS RCS SCCS .make.state "
                                    ".nse_depinfo #* .#* cvslog.* ,* CVS CVS.adm .del-* *.a *.olb *.o *.obj "
                                    "*.so *.Z *~ *.old *.elc *.ln *.bak *.BAK *.orig *.rej *.exe _$* *$");
-    addEntriesFromString(dir, ignorestr);
-    addEntriesFromFile(dir, QDir::homePath() + '/' + getGlobalIgnoreName());
-    const char* varname = getVarName();
-    if(qEnvironmentVariableIsSet(varname) && !qEnvironmentVariableIsEmpty(varname))
+    // The defaults are the same for every folder, they are read and compiled only once.
+    if(!m_bDefaultsRead)
     {
-        addEntriesFromString(dir, QString::fromLocal8Bit(qgetenv(varname)));
+        addEntriesFromString(dir, ignorestr);
+        addEntriesFromFile(dir, QDir::homePath() + '/' + getGlobalIgnoreName());
+        const char* varname = getVarName();
+        if(qEnvironmentVariableIsSet(varname) && !qEnvironmentVariableIsEmpty(varname))
+        {
+            addEntriesFromString(dir, QString::fromLocal8Bit(qgetenv(varname)));
+        }
+
+        const auto ignorePatternsIt = m_ignorePatterns.find(dir);
+        if(ignorePatternsIt != m_ignorePatterns.end())
+            m_defaultPatterns = ignorePatternsIt->second;
+        m_bDefaultsRead = true;
+    }
+    else if(m_defaultPatterns.has_value())
+    {
+        // Implicitly shared, a folder without its own .cvsignore costs no copy.
+        m_ignorePatterns[dir] = m_defaultPatterns.value();
     }
+
     const bool bUseLocalCvsIgnore = ignoreExists(directoryList);
     if(bUseLocalCvsIgnore)
     {
@@ -65,6 +79,7 @@ void CvsIgnoreList::addEntriesFromString(const QString& dir, const QString& str)
     {
         addEntry(dir, pattern);
     }
+    compile(dir);
 }
 
 /*
@@ -85,6 +100,7 @@ void CvsIgnoreList::addEntriesFromFile(const QString& dir, const QString& name)
         {
             addEntry(dir, stream.readLine());
         }
+        compile(dir);
     }
 #endif
 }
@@ -112,28 +128,34 @@ void CvsIgnoreList::addEntry(const QString& dir, const QString& pattern)
             ++pos;
         }
 
+        CvsIgnorePatterns& patterns = m_ignorePatterns[dir];
         if(nofMetaCharacters == 0)
         {
-            m_ignorePatterns[dir].m_exactPatterns.append(pattern);
+            patterns.m_exactPatterns.append(pattern);
+            patterns.m_matcher.addExact(pattern);
         }
         else if(nofMetaCharacters == 1)
         {
             if(pattern.at(0) == QChar('*'))
             {
-                m_ignorePatterns[dir].m_endPatterns.append(pattern.right(pattern.length() - 1));
+                patterns.m_endPatterns.append(pattern.right(pattern.length() - 1));
+                patterns.m_matcher.addSuffix(pattern.right(pattern.length() - 1));
             }
             else if(pattern.at(pattern.length() - 1) == QChar('*'))
             {
-                m_ignorePatterns[dir].m_startPatterns.append(pattern.left(pattern.length() - 1));
+                patterns.m_startPatterns.append(pattern.left(pattern.length() - 1));
+                patterns.m_matcher.addPrefix(pattern.left(pattern.length() - 1));
             }
             else
             {
-                m_ignorePatterns[dir].m_generalPatterns.append(pattern);
+                patterns.m_generalPatterns.append(pattern);
+                patterns.m_matcher.addGlob(pattern);
             }
         }
         else
         {
-            m_ignorePatterns[dir].m_generalPatterns.append(pattern);
+            patterns.m_generalPatterns.append(pattern);
+            patterns.m_matcher.addGlob(pattern);
         }
     }
     else
@@ -142,6 +164,13 @@ void CvsIgnoreList::addEntry(const QString& dir, const QString& pattern)
     }
 }
 
+void CvsIgnoreList::compile(const QString& dir)
+{
+    const auto ignorePatternsIt = m_ignorePatterns.find(dir);
+    if(ignorePatternsIt != m_ignorePatterns.end())
+        ignorePatternsIt->second.m_matcher.compile();
+}
+
 bool CvsIgnoreList::matches(const QString& dir, const QString& text, bool bCaseSensitive) const
 {
     const auto ignorePatternsIt = m_ignorePatterns.find(dir);
@@ -149,36 +178,8 @@ bool CvsIgnoreList::matches(const QString& dir, const QString& text, bool bCaseS
     {
         return false;
     }
-    //Do not use QStringList::indexof here it has no case flag
-    if(ignorePatternsIt->second.m_exactPatterns.contains(text, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive))
-    {
-        return true;
-    }
 
-    for(const QString& startPattern: ignorePatternsIt->second.m_startPatterns)
-    {
-        if(text.startsWith(startPattern, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive))
-        {
-            return true;
-        }
-    }
-
-    for(const QString& endPattern: ignorePatternsIt->second.m_endPatterns)
-    {
-        if(text.endsWith(endPattern, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive))
-        {
-            return true;
-        }
-    }
-
-    for(const QString& globStr: ignorePatternsIt->second.m_generalPatterns)
-    {
-        QRegularExpression pattern(QRegularExpression::wildcardToRegularExpression(globStr), bCaseSensitive ? QRegularExpression::UseUnicodePropertiesOption : QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
-        if(pattern.match(text).hasMatch())
-            return true;
-    }
-
-    return false;
+    return ignorePatternsIt->second.m_matcher.matches(text, bCaseSensitive);
 }
 
 bool CvsIgnoreList::ignoreExists(const DirectoryList& pDirList)
@@ -14,12 +14,14 @@
 //#include "fileaccess.h"
 
 #include "DirectoryList.h"
+#include "GlobMatcher.h"
 #include "IgnoreList.h"
 
 #include <QString>
 #include <QStringList>
 
 #include <map>
+#include <optional>
 
 struct CvsIgnorePatterns
 {
@@ -27,6 +29,8 @@ struct CvsIgnorePatterns
     QStringList m_startPatterns;
     QStringList m_endPatterns;
     QStringList m_generalPatterns;
+    // All of the above, matches() only asks this.
+    GlobMatcher m_matcher;
 };
 
 class CvsIgnoreList : public IgnoreList
@@ -43,9 +47,13 @@ protected:
     void addEntriesFromString(const QString& dir, const QString& str);
     void addEntriesFromFile(const QString& dir, const QString& name);
     void addEntry(const QString& dir, const QString& pattern);
+    void compile(const QString& dir);
 
     std::map<QString, CvsIgnorePatterns> m_ignorePatterns;
 private:
+    bool m_bDefaultsRead = false;
+    std::optional<CvsIgnorePatterns> m_defaultPatterns;
+
     friend class CvsIgnoreListTest;
     /*
         The name of the users global ignore can be changed separately in some cases in the future
@@ -11,11 +11,14 @@
 #include "DefaultFileAccessJobHandler.h"
 
 #include "defmac.h"
+#include "DirectoryScanner.h"
 #include "fileaccess.h"
 #include "IgnoreList.h"
+#include "LocalFileCopy.h"
 #include "Logging.h"
 #include "progress.h"
 #include "ProgressProxyExtender.h"
+#include "RemoteDirectoryLister.h"
 #include "TypeUtils.h"
 
 #include <algorithm>
@@ -115,7 +118,7 @@ void DefaultFileAccessJobHandler::slotGetData(KJob* pJob, const QByteArray& newD
     else
     {
         qint64 length = std::min(qint64(newData.size()), m_maxLength - m_transferredBytes);
-        ::memcpy(m_pTransferBuffer + m_transferredBytes, newData.data(), newData.size());
+        ::memcpy(m_pTransferBuffer + m_transferredBytes, newData.data(), length);
         m_transferredBytes += length;
     }
 }
@@ -324,6 +327,18 @@ bool DefaultFileAccessJobHandler::copyFile(const QString& inDest)
     mFileAccess->setStatusText(QString());
     if(!mFileAccess->isNormal() || !dest.isNormal()) return false;
 
+    // Lets the kernel or the file system do the work, KIO would read and write every byte.
+    if(mFileAccess->isLocal() && dest.isLocal())
+    {
+        QString errorString;
+        if(!LocalFileCopy::copy(mFileAccess->absoluteFilePath(), dest.absoluteFilePath(), errorString))
+        {
+            mFileAccess->setStatusText(i18n("Error: copy( %1 -> %2 ) failed: %3", mFileAccess->prettyAbsPath(), dest.prettyAbsPath(), errorString));
+            return false;
+        }
+        return true;
+    }
+
     int permissions = (mFileAccess->isExecutable() ? 0111 : 0) + (mFileAccess->isWritable() ? 0222 : 0) + (mFileAccess->isReadable() ? 0444 : 0);
     m_bSuccess = false;
     KIO::FileCopyJob* pJob = KIO::file_copy(mFileAccess->url(), dest.url(), permissions, KIO::HideProgressInfo|KIO::Overwrite);
@@ -359,104 +374,18 @@ bool DefaultFileAccessJobHandler::listDir(DirectoryList* pDirList, bool bRecursi
 
     if(mFileAccess->isLocal())
     {
-        m_bSuccess = true;
-        QDir dir(mFileAccess->absoluteFilePath());
-
-        dir.setSorting(QDir::Name | QDir::DirsFirst);
-        if(bFindHidden)
-            dir.setFilter(QDir::Files | QDir::Dirs | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
-        else
-            dir.setFilter(QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
-
-        const QFileInfoList fiList = dir.entryInfoList();
-        if(fiList.isEmpty())
-        {
-            /*
-                Sadly Qt provides no error information making this case ambiguous.
-                A readability check is the best we can do.
-            */
-            m_bSuccess = dir.isReadable();
-        }
-        else
-        {
-            for(const QFileInfo& fi: fiList) // for each file...
-            {
-                if(pp.wasCancelled())
-                    break;
-
-                assert(fi.fileName() != "." && fi.fileName() != "..");
-
-                FileAccess fa;
-
-                fa.setFile(mFileAccess, fi);
-                pDirList->push_back(fa);
-            }
-        }
-    }
-    else
-    {
-        KIO::ListJob* pListJob = nullptr;
-        pListJob = KIO::listDir(mFileAccess->url(), KIO::HideProgressInfo, true /*bFindHidden*/);
+        DirectoryScanner scanner(bRecursive, bFindHidden, filePattern, fileAntiPattern, dirAntiPattern, bFollowDirLinks);
+        scanner.addRoot(*mFileAccess, *pDirList, ignoreList);
 
-        m_bSuccess = false;
-        if(pListJob != nullptr)
-        {
-            chk_connect(pListJob, &KIO::ListJob::entries, this, &DefaultFileAccessJobHandler::slotListDirProcessNewEntries);
-            chk_connect(pListJob, &KIO::ListJob::result, this, &DefaultFileAccessJobHandler::slotSimpleJobResult);
-            chk_connect(pListJob, &KIO::ListJob::finished, this, &DefaultFileAccessJobHandler::slotJobEnded);
-            chk_connect(pListJob, &KIO::ListJob::infoMessage, &pp, &ProgressProxyExtender::slotListDirInfoMessage);
-
-            // This line makes the transfer via fish unreliable.:-(
-            /*if(mFileAccess->url().scheme() != u8"fish"){
-                chk_connect( pListJob, static_cast<void (KIO::ListJob::*)(KJob*,qint64)>(&KIO::ListJob::percent), &pp, &ProgressProxyExtender::slotPercent);
-            }*/
-
-            ProgressProxy::enterEventLoop(pListJob,
-                                          i18n("Listing directory: %1", mFileAccess->prettyAbsPath()));
-        }
-    }
-
-    ignoreList.enterDir(mFileAccess->absoluteFilePath(), *pDirList);
-    mFileAccess->filterList(mFileAccess->absoluteFilePath(), pDirList, filePattern, fileAntiPattern, dirAntiPattern, ignoreList);
-
-    if(bRecursive)
-    {
-        DirectoryList::iterator i;
-        DirectoryList subDirsList;
-
-        for(i = m_pDirList->begin(); i != m_pDirList->end(); ++i)
-        {
-            assert(i->isValid());
-            if(i->isDir() && (!i->isSymLink() || m_bFollowDirLinks))
-            {
-                DirectoryList dirList;
-                i->listDir(&dirList, bRecursive, bFindHidden,
-                           filePattern, fileAntiPattern, dirAntiPattern, bFollowDirLinks, ignoreList);
+        if(!scanner.scan())
+            return true; // Cancelled is not an error.
 
-                // append data onto the main list
-                subDirsList.splice(subDirsList.end(), dirList);
-            }
-        }
-
-        m_pDirList->splice(m_pDirList->end(), subDirsList);
+        m_bSuccess = scanner.succeeded(0);
+        return m_bSuccess;
     }
 
+    // Remote folders are listed with several jobs at once, a round trip per folder adds up.
+    RemoteDirectoryLister lister(bRecursive, filePattern, fileAntiPattern, dirAntiPattern, bFollowDirLinks);
+    m_bSuccess = lister.list(*mFileAccess, *pDirList, ignoreList);
     return m_bSuccess;
 }
-
-void DefaultFileAccessJobHandler::slotListDirProcessNewEntries(KIO::Job*, const KIO::UDSEntryList& l)
-{
-    //This function is called for non-local urls. Don't use QUrl::fromLocalFile here as it does not handle these.
-    for(const KIO::UDSEntry& e: l)
-    {
-        FileAccess fa;
-
-        fa.setFromUdsEntry(e, mFileAccess);
-
-        //must be manually filtered KDE does not supply API for ignoring these.
-        if(fa.fileName() != "." && fa.fileName() != ".." && fa.isValid())
-        {
-            m_pDirList->push_back(std::move(fa));
-        }
-    }
-}
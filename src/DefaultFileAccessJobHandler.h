@@ -63,8 +63,6 @@ class DefaultFileAccessJobHandler: public FileAccessJobHandler
 
     void slotGetData(KJob*, const QByteArray&);
     void slotPutData(KIO::Job*, QByteArray&);
-
-    void slotListDirProcessNewEntries(KIO::Job*, const KIO::UDSEntryList& l);
 };
 
 
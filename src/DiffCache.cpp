@@ -0,0 +1,156 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "DiffCache.h"
+
+#include "Logging.h"
+#include "Trace.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+constexpr quint32 fileMagic = 0x4B444443; // "KDDC"
+// Part of the key, changing it makes all earlier results unused.
+constexpr qint32 fileVersion = 1;
+constexpr int maxEntries = 1000;
+constexpr int insertsPerCleanup = 50;
+
+void addToHash(QCryptographicHash& hash, const qint64 value)
+{
+    hash.addData(reinterpret_cast<const char*>(&value), (int)sizeof(value));
+}
+
+void addLinesToHash(QCryptographicHash& hash, const LineDataVector& v, const LineType size)
+{
+    addToHash(hash, size);
+    for(LineType i = 0; i < size && (size_t)i < v.size(); ++i)
+    {
+        const QString line = v[i].getLine();
+        // The length first, so lines can't run into each other.
+        addToHash(hash, line.size());
+        hash.addData(reinterpret_cast<const char*>(line.constData()), (int)(line.size() * sizeof(QChar)));
+    }
+}
+} // namespace
+
+DiffCache::DiffCache(const QString& dirName): mDirName(dirName)
+{
+}
+
+DiffCache& DiffCache::instance()
+{
+    static DiffCache cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/diffs"));
+    return cache;
+}
+
+QByteArray DiffCache::key(const LineDataVector& v1, const LineType size1, const LineDataVector& v2, const LineType size2, const DiffSettings& settings)
+{
+    TraceScope traceScope(TraceStage::hash);
+    traceScope.setItems(size1 + size2);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addToHash(hash, fileVersion);
+    addToHash(hash, (qint64)settings.lineDiffAlgorithm());
+    addToHash(hash, settings.tryHard() ? 1 : 0);
+    addToHash(hash, settings.ignoreNumbers() ? 1 : 0);
+    addLinesToHash(hash, v1, size1);
+    addLinesToHash(hash, v2, size2);
+    return hash.result();
+}
+
+QString DiffCache::entryFileName(const QByteArray& key) const
+{
+    return mDirName + '/' + QString::fromLatin1(key.toHex());
+}
+
+bool DiffCache::find(const QByteArray& key, const LineType size1, const LineType size2, DiffList& diffList)
+{
+    QFile file(entryFileName(key));
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    qint32 version = 0;
+    QByteArray storedKey;
+    qint64 count = 0;
+    in >> magic >> version >> storedKey >> count;
+    if(magic != fileMagic || version != fileVersion || storedKey != key || count < 0)
+        return false;
+
+    // A damaged entry must not produce a result that doesn't fit the inputs.
+    DiffList result;
+    qint64 lines1 = 0, lines2 = 0;
+    for(qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        qint32 nofEquals = 0;
+        quint64 diff1 = 0, diff2 = 0;
+        in >> nofEquals >> diff1 >> diff2;
+        if(nofEquals < 0 || diff1 > (quint64)size1 || diff2 > (quint64)size2)
+            break;
+
+        lines1 += nofEquals + (qint64)diff1;
+        lines2 += nofEquals + (qint64)diff2;
+        if(lines1 > size1 || lines2 > size2)
+            break;
+        result.push_back(Diff(nofEquals, diff1, diff2));
+    }
+
+    if(in.status() != QDataStream::Ok || (qint64)result.size() != count || lines1 != size1 || lines2 != size2)
+    {
+        qCWarning(kdiffMain) << "Ignoring damaged diff cache entry" << file.fileName();
+        return false;
+    }
+
+    // The modification time tells which entries were used last.
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+
+    diffList = std::move(result);
+    return true;
+}
+
+void DiffCache::insert(const QByteArray& key, const DiffList& diffList)
+{
+    QDir().mkpath(mDirName);
+    QSaveFile file(entryFileName(key));
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << fileMagic << fileVersion << key << (qint64)diffList.size();
+    for(const Diff& diff: diffList)
+        out << (qint32)diff.numberOfEquals() << diff.diff1() << diff.diff2();
+
+    if(!file.commit())
+        return;
+
+    QMutexLocker locker(&mMutex);
+    // Once per session early on, as short sessions may never get to many inserts.
+    if(mInsertsSinceCleanup++ % insertsPerCleanup == 0)
+        removeOldEntries();
+}
+
+// Keeps the most recently used entries.
+void DiffCache::removeOldEntries()
+{
+    const QFileInfoList entries = QDir(mDirName).entryInfoList(QDir::Files, QDir::Time);
+    for(QtSizeType i = maxEntries; i < entries.size(); ++i)
+        QFile::remove(entries[i].absoluteFilePath());
+}
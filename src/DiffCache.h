@@ -0,0 +1,49 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef DIFFCACHE_H
+#define DIFFCACHE_H
+
+#include "diff.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+
+/*
+    Line matching results from earlier comparisons, stored on disk.
+
+    The key is a hash of the lines as line matching sees them together with the options the
+    line diff depends on. Opening the same pair of inputs again then doesn't need to run the diff.
+    Only the line matching is stored, differences within lines are still calculated.
+*/
+class DiffCache
+{
+  public:
+    explicit DiffCache(const QString& dirName);
+
+    // Shared cache in the user's cache folder.
+    static DiffCache& instance();
+
+    [[nodiscard]] static QByteArray key(const LineDataVector& v1, const LineType size1, const LineDataVector& v2, const LineType size2, const DiffSettings& settings);
+
+    // These may be called from several threads.
+    bool find(const QByteArray& key, const LineType size1, const LineType size2, DiffList& diffList);
+    void insert(const QByteArray& key, const DiffList& diffList);
+
+  private:
+    [[nodiscard]] QString entryFileName(const QByteArray& key) const;
+    void removeOldEntries();
+
+    QString mDirName;
+    QMutex mMutex; // Serializes cleaning up the folder.
+    int mInsertsSinceCleanup = 0;
+};
+
+#endif
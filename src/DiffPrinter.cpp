@@ -0,0 +1,339 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "DiffPrinter.h"
+
+#include "MonospaceText.h"
+#include "options.h"
+#include "RLPainter.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+#include <QFontInfo>
+#include <QPen>
+#include <QPrinter>
+#include <QTextCharFormat>
+#include <QVector>
+
+#include <KLocalizedString>
+
+namespace {
+QString expandTabs(const QString& s, const int tabSize)
+{
+    if(!s.contains('\t'))
+        return s;
+
+    QString result;
+    result.reserve(s.length());
+    for(const QChar c: s)
+    {
+        if(c == '\t')
+            result.append(QString(tabSize - result.length() % tabSize, ' '));
+        else
+            result.append(c);
+    }
+    return result;
+}
+} // namespace
+
+DiffPrinter::DiffPrinter(const QSharedPointer<Options>& pOptions, const Diff3LineVector& diff3LineVector, const bool bTripleDiff, const std::vector<Input>& inputs):
+    mDiff3LineVector(diff3LineVector), mbTripleDiff(bTripleDiff), mInputs(inputs)
+{
+    mFont = pOptions->defaultFont();
+    mFont.setPointSizeF(mFont.pointSizeF() - 1); // Print with slightly smaller font.
+    mbFixedPitch = QFontInfo(mFont).fixedPitch();
+    mTabSize = pOptions->m_tabSize;
+    mbShowLineNumbers = pOptions->m_bShowLineNumbers;
+    mbShowWhiteSpace = pOptions->m_bShowWhiteSpace;
+    mbWordWrap = pOptions->wordWrapOn();
+    mbRightToLeft = pOptions->m_bRightToLeftLanguage;
+    mForeground = pOptions->foregroundColor();
+    mDiffBackground = pOptions->diffBackgroundColor();
+    mConflictColor = pOptions->conflictColor();
+    mSourceColors = {pOptions->aColor(), pOptions->bColor(), pOptions->cColor()};
+}
+
+DiffPrinter::PageLayout DiffPrinter::pageLayout(const QPrinter& printer, const QFontMetrics& fm) const
+{
+    PageLayout layout;
+    layout.pageWidth = printer.width();
+    layout.columnDistance = qRound((0.5 / 2.54) * printer.logicalDpiY()); // 0.5 cm between the columns
+    const int nofColumns = (int)std::max<size_t>(1, mInputs.size());
+    layout.columnWidth = (layout.pageWidth - (nofColumns - 1) * layout.columnDistance) / nofColumns;
+    layout.fontWidth = std::max(1, Utils::getHorizontalAdvance(fm, QChar('0')));
+    layout.lineSpacing = std::max(1, fm.lineSpacing());
+    layout.ascent = fm.ascent();
+
+    int headerWidth = 0;
+    qint64 maxLines = 0;
+    for(const Input& input: mInputs)
+    {
+        headerWidth = std::max(headerWidth, Utils::getHorizontalAdvance(fm, input.aliasName + ", " + i18n("Top line") + ": 01234567"));
+        if(input.pLineData != nullptr)
+            maxLines = std::max(maxLines, (qint64)input.pLineData->size());
+    }
+    const int headerLines = headerWidth / std::max(1, layout.columnWidth) + 1;
+    const int headerMargin = headerLines * fm.height() + 3; // Text + one horizontal line
+    const int footerMargin = fm.height() + 3;
+    layout.view = QRect(0, headerMargin, layout.pageWidth, printer.height() - (headerMargin + footerMargin));
+
+    layout.lineNumberWidth = mbShowLineNumbers ? (int)QString::number(maxLines).length() : 0;
+    // The line numbers, the change bar and the separator take the first columns, like in the diff windows.
+    layout.charsPerRow = std::max(1, layout.columnWidth / layout.fontWidth - (layout.lineNumberWidth + 4));
+    layout.rowsPerPage = std::max(1, layout.view.height() / layout.lineSpacing);
+    return layout;
+}
+
+qint32 DiffPrinter::rowsNeeded(const Diff3Line& d3l, const PageLayout& layout) const
+{
+    if(!mbWordWrap)
+        return 1;
+
+    qint32 rows = 1;
+    for(const Input& input: mInputs)
+    {
+        const LineRef lineIdx = d3l.getLineIndex(input.src);
+        if(!lineIdx.isValid() || input.pLineData == nullptr)
+            continue;
+        const int width = (*input.pLineData)[lineIdx].width(mTabSize);
+        rows = std::max(rows, (width + layout.charsPerRow - 1) / layout.charsPerRow);
+    }
+    return rows;
+}
+
+QColor DiffPrinter::changeColor(const e_SrcSelector src, const ChangeFlags changed) const
+{
+    // The colors of the other two inputs, see DiffTextWindowData::draw().
+    const size_t srcIdx = src == e_SrcSelector::A ? 0 : src == e_SrcSelector::B ? 1 : 2;
+    if(changed == AChanged)
+        return mSourceColors[(srcIdx + 1) % 3];
+    if(changed == BChanged)
+        return mSourceColors[(srcIdx + 2) % 3];
+    if(changed == Both)
+        return mConflictColor;
+    return mForeground;
+}
+
+QRect DiffPrinter::mirrored(const PageLayout& layout, const QRect& r) const
+{
+    if(!mbRightToLeft)
+        return r;
+
+    QRect result = r;
+    result.moveLeft(layout.pageWidth - r.left() - r.width());
+    return result;
+}
+
+void DiffPrinter::drawRow(RLPainter& p, const QFontMetrics& fm, const PageLayout& layout, const Diff3Line& d3l, const qint32 row, const int y, std::vector<LineRef>& topLines) const
+{
+    const bool bMonospace = mbFixedPitch && !mbRightToLeft;
+    const int fontWidth = layout.fontWidth;
+
+    for(size_t column = 0; column < mInputs.size(); ++column)
+    {
+        const Input& input = mInputs[column];
+        const int x = (int)column * (layout.columnWidth + layout.columnDistance);
+        p.setClipRect(mirrored(layout, QRect(x, layout.view.top(), layout.columnWidth, layout.view.height())));
+
+        LineRef lineIdx;
+        ChangeFlags changed = NoChange;
+        ChangeFlags changed2 = NoChange;
+        d3l.getChangeFlags(input.src, mbTripleDiff, lineIdx, changed, changed2);
+        if(!lineIdx.isValid() || input.pLineData == nullptr)
+            continue;
+        if(!topLines[column].isValid())
+            topLines[column] = lineIdx;
+
+        // Without fine diffs the whole line is shown as changed.
+        const QColor penColor = changeColor(input.src, changed | changed2);
+        const QColor textColor = changed2 == NoChange && !mbShowWhiteSpace ? mForeground : penColor;
+
+        const QString text = expandTabs((*input.pLineData)[lineIdx].getLine(), mTabSize);
+        // A clipped line gets one character more, the clip rect cuts it.
+        const QString part = mbWordWrap ? text.mid((QtSizeType)row * layout.charsPerRow, layout.charsPerRow) : text.left(layout.charsPerRow + 1);
+        const int xText = x + (layout.lineNumberWidth + 4) * fontWidth;
+        if(!part.isEmpty())
+        {
+            if(bMonospace && MonospaceText::isSimple(part))
+            {
+                QVector<QTextLayout::FormatRange> formats;
+                if(textColor != mForeground)
+                {
+                    QTextLayout::FormatRange range;
+                    range.start = 0;
+                    range.length = (int)part.length();
+                    range.format.setForeground(textColor);
+                    range.format.setBackground(mDiffBackground);
+                    formats.push_back(range);
+                }
+                MonospaceText(part, formats, mForeground, mTabSize, fm).draw(p, xText, y);
+            }
+            else
+            {
+                if(textColor != mForeground)
+                    p.fillRect(xText, y, Utils::getHorizontalAdvance(fm, part), layout.lineSpacing, mDiffBackground);
+                p.setPen(textColor);
+                p.drawText(xText, y + layout.ascent, part, true);
+            }
+        }
+
+        p.setPen(mForeground);
+        if(mbShowLineNumbers && row == 0)
+            p.drawText(x, y + layout.ascent, QString::number(lineIdx + 1));
+
+        if(row == 0 || !part.isEmpty())
+        {
+            const int xSeparator = x + (layout.lineNumberWidth + 2) * fontWidth;
+            p.setPen(QPen(mForeground, 0, row > 0 ? Qt::DotLine : Qt::SolidLine));
+            p.drawLine(xSeparator + 1, y, xSeparator + 1, y + layout.lineSpacing - 1);
+            p.setPen(QPen(mForeground, 0, Qt::SolidLine));
+        }
+
+        const int xBar = x + layout.lineNumberWidth * fontWidth;
+        if(penColor != mForeground && changed2 == NoChange)
+        {
+            if(mbShowWhiteSpace)
+            {
+                p.setBrushOrigin(0, 0);
+                p.fillRect(xBar, y, fontWidth * 2 - 1, layout.lineSpacing, QBrush(penColor, Qt::Dense5Pattern));
+            }
+        }
+        else if(penColor != mForeground)
+        {
+            p.fillRect(xBar, y, fontWidth * 2 - 1, layout.lineSpacing, penColor);
+        }
+    }
+}
+
+void DiffPrinter::drawHeaderAndFooter(RLPainter& p, const PageLayout& layout, const std::vector<LineRef>& topLines, const int page, const Range& range) const
+{
+    p.setClipping(false);
+    for(size_t column = 0; column < mInputs.size(); ++column)
+    {
+        const Input& input = mInputs[column];
+        const int x = (int)column * (layout.columnWidth + layout.columnDistance);
+
+        QString headerText = input.aliasName;
+        if(topLines[column].isValid())
+            headerText += ", " + i18n("Top line") + ": " + QString::number(topLines[column] + 1);
+
+        const size_t srcIdx = input.src == e_SrcSelector::A ? 0 : input.src == e_SrcSelector::B ? 1 : 2;
+        p.setPen(mSourceColors[srcIdx]);
+        static_cast<QPainter&>(p).drawText(mirrored(layout, QRect(x, 0, layout.columnWidth, layout.view.top() - 3)), Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, headerText);
+
+        p.setPen(mForeground);
+        p.drawLine(x, layout.view.top() - 2, x + layout.columnWidth, layout.view.top() - 2);
+    }
+
+    p.setPen(mForeground);
+    p.drawLine(0, layout.view.bottom() + 3, layout.view.width(), layout.view.bottom() + 3);
+
+    QString s = range.bCurrentPage ? QString("") : QString::number(page) + '/' + QString::number(mNofPages);
+    if(range.bSelection) s += i18n(" (Selection)");
+    static_cast<QPainter&>(p).drawText((layout.view.right() - Utils::getHorizontalAdvance(p.fontMetrics(), s)) / 2,
+                                       layout.view.bottom() + p.fontMetrics().ascent() + 5, s);
+}
+
+bool DiffPrinter::print(QPrinter& printer, const Range& range, const std::atomic<bool>& bCancel)
+{
+    const QFontMetrics fm(mFont, &printer);
+    const PageLayout layout = pageLayout(printer, fm);
+
+    RLPainter p(&printer, mbRightToLeft, layout.pageWidth, layout.fontWidth);
+    if(!p.isActive())
+        return false;
+    p.setFont(mFont);
+
+    const LineType firstD3L = std::max<LineType>(0, range.firstD3L);
+    const LineType endD3L = std::min(range.endD3L, (LineType)mDiff3LineVector.size());
+
+    // The rows are counted first, for the page numbers. Cheap, only the widths of the lines are needed.
+    qint64 nofRows = std::max<LineType>(0, endD3L - firstD3L);
+    if(mbWordWrap)
+    {
+        nofRows = 0;
+        for(LineType d3lIdx = firstD3L; d3lIdx < endD3L; ++d3lIdx)
+            nofRows += rowsNeeded(*mDiff3LineVector[d3lIdx], layout);
+    }
+
+    int totalNofPages = std::max<int>(1, (int)((nofRows + layout.rowsPerPage - 1) / layout.rowsPerPage));
+    /*
+        Per Qt docs QPrinter::fromPage and QPrinter::toPage return 0 to indicate they are not set.
+        Account for this and other invalid settings the user may try.
+    */
+    int fromPage = std::clamp(range.fromPage, 1, totalNofPages);
+    int toPage = range.toPage <= 0 ? totalNofPages : std::min(range.toPage, totalNofPages);
+    if(fromPage > toPage) toPage = fromPage;
+    if(range.bCurrentPage)
+    {
+        totalNofPages = 1;
+        fromPage = toPage = 1;
+    }
+    mNofPages = totalNofPages;
+
+    qint64 row = 0; // Counted from firstD3L.
+    LineType d3lIdx = firstD3L;
+    if(!mbWordWrap)
+    {
+        // Every Diff3Line is one row, the pages before fromPage are skipped at once.
+        row = (qint64)(fromPage - 1) * layout.rowsPerPage;
+        d3lIdx = (LineType)std::min<qint64>(firstD3L + row, endD3L);
+    }
+
+    int page = 0; // The one being drawn.
+    std::vector<LineRef> topLines(mInputs.size());
+    for(; d3lIdx < endD3L; ++d3lIdx)
+    {
+        mLinesDone = d3lIdx - firstD3L;
+        const Diff3Line& d3l = *mDiff3LineVector[d3lIdx];
+        const qint32 rows = rowsNeeded(d3l, layout);
+        bool bDone = false;
+        for(qint32 r = 0; r < rows; ++r, ++row)
+        {
+            const int rowPage = (int)(row / layout.rowsPerPage) + 1;
+            if(rowPage < fromPage)
+                continue;
+            if(rowPage > toPage)
+            {
+                bDone = true;
+                break;
+            }
+
+            if(rowPage != page)
+            {
+                if(page != 0)
+                {
+                    drawHeaderAndFooter(p, layout, topLines, page, range);
+                    if(bCancel)
+                    {
+                        printer.abort();
+                        return false;
+                    }
+                    printer.newPage();
+                }
+                page = rowPage;
+                mCurrentPage = page;
+                topLines.assign(mInputs.size(), LineRef());
+            }
+            drawRow(p, fm, layout, d3l, r, layout.view.top() + (int)(row % layout.rowsPerPage) * layout.lineSpacing, topLines);
+        }
+        if(bDone)
+            break;
+    }
+
+    if(bCancel)
+    {
+        printer.abort();
+        return false;
+    }
+    drawHeaderAndFooter(p, layout, topLines, page != 0 ? page : fromPage, range);
+    mLinesDone = endD3L - firstD3L;
+    return p.end();
+}
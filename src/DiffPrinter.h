@@ -0,0 +1,120 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef DIFFPRINTER_H
+#define DIFFPRINTER_H
+
+#include "diff.h"
+#include "LineRef.h"
+#include "TypeUtils.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QColor>
+#include <QFont>
+#include <QFontMetrics>
+#include <QRect>
+#include <QSharedPointer>
+#include <QString>
+
+class Options;
+class QPrinter;
+class RLPainter;
+
+/*
+    Prints the compared files side by side or writes them to a PDF file, one page after the other.
+
+    Meant to run on a worker thread: the constructor copies what is needed of the options and the
+    lines are taken from the Diff3LineVector while each page is drawn, nothing is laid out for the
+    whole document up front. Lines are colored by the line level differences. The character level
+    ones are calculated lazily for the diff windows and must not be touched off the GUI thread.
+    With word wrap lines are wrapped at the width of a print column, otherwise they are clipped.
+*/
+class DiffPrinter
+{
+  public:
+    struct Input
+    {
+        e_SrcSelector src = e_SrcSelector::None;
+        QString aliasName;
+        std::shared_ptr<LineDataVector> pLineData; // The display data, as shown in the diff windows.
+    };
+
+    struct Range
+    {
+        LineType firstD3L = 0;
+        LineType endD3L = 0; // One past the last Diff3Line printed.
+        // Of the pages the lines above fill, starting with 1. 0 prints up to the last page.
+        int fromPage = 1;
+        int toPage = 0;
+        bool bSelection = false;
+        bool bCurrentPage = false; // Only the first page, without a page number.
+    };
+
+    // The Diff3LineVector must not change until print() returns.
+    DiffPrinter(const QSharedPointer<Options>& pOptions, const Diff3LineVector& diff3LineVector, const bool bTripleDiff, const std::vector<Input>& inputs);
+
+    // False if the printer couldn't be started or bCancel was set, the printer is aborted then.
+    bool print(QPrinter& printer, const Range& range, const std::atomic<bool>& bCancel);
+
+    // For the progress shown while print() runs on another thread.
+    [[nodiscard]] LineType linesDone() const { return mLinesDone; }
+    [[nodiscard]] int currentPage() const { return mCurrentPage; }
+    [[nodiscard]] int nofPages() const { return mNofPages; }
+
+  private:
+    struct PageLayout
+    {
+        int pageWidth = 0;
+        QRect view; // Where the lines go, below the headers and above the footer.
+        int columnWidth = 0;
+        int columnDistance = 0;
+        int fontWidth = 0;
+        int lineSpacing = 0;
+        int ascent = 0;
+        int lineNumberWidth = 0; // In characters, like the widths below.
+        int charsPerRow = 0;
+        LineType rowsPerPage = 0;
+    };
+
+    [[nodiscard]] PageLayout pageLayout(const QPrinter& printer, const QFontMetrics& fm) const;
+    // 1 without word wrap, else the rows of the longest text in the line.
+    [[nodiscard]] qint32 rowsNeeded(const Diff3Line& d3l, const PageLayout& layout) const;
+    // Draws one row of every column, topLines collects the first line of each input on the page.
+    void drawRow(RLPainter& p, const QFontMetrics& fm, const PageLayout& layout, const Diff3Line& d3l, const qint32 row, const int y, std::vector<LineRef>& topLines) const;
+    void drawHeaderAndFooter(RLPainter& p, const PageLayout& layout, const std::vector<LineRef>& topLines, const int page, const Range& range) const;
+    // Like the pen color of DiffTextWindowData::writeLine().
+    [[nodiscard]] QColor changeColor(const e_SrcSelector src, const ChangeFlags changed) const;
+    [[nodiscard]] QRect mirrored(const PageLayout& layout, const QRect& r) const;
+
+    const Diff3LineVector& mDiff3LineVector;
+    const bool mbTripleDiff;
+    const std::vector<Input> mInputs;
+
+    QFont mFont;
+    bool mbFixedPitch = false;
+    int mTabSize = 8;
+    bool mbShowLineNumbers = true;
+    bool mbShowWhiteSpace = true;
+    bool mbWordWrap = false;
+    bool mbRightToLeft = false;
+    QColor mForeground;
+    QColor mDiffBackground;
+    QColor mConflictColor;
+    std::array<QColor, 3> mSourceColors; // Of A, B and C.
+
+    std::atomic<LineType> mLinesDone{0};
+    std::atomic<int> mCurrentPage{0};
+    std::atomic<int> mNofPages{0};
+};
+
+#endif
@@ -11,9 +11,14 @@
 
 #include "CompositeIgnoreList.h"
 #include "CvsIgnoreList.h"
+#include "DirectoryScanner.h"
 #include "GitIgnoreList.h"
+#include "RemoteDirectoryLister.h"
+#include "Trace.h"
 
+#include <iterator>
 #include <memory>
+#include <vector>
 
 //Intialize with a dummy default DirectoryInfo so we don't crash on first run.
 QSharedPointer<DirectoryInfo>  gDirInfo = QSharedPointer<DirectoryInfo>::create();
@@ -33,17 +38,75 @@ bool DirectoryInfo::listDirC(const QSharedPointer<const Options>& options)
     return listDir(m_dirC, m_dirListC, options);
 }
 
-bool DirectoryInfo::listDir(FileAccess& fileAccess, DirectoryList& dirList, const QSharedPointer<const Options>& options)
+bool DirectoryInfo::listDirsConcurrently(const QSharedPointer<const Options>& options, bool& bSuccessA, bool& bSuccessB, bool& bSuccessC)
+{
+    const std::unique_ptr<DirectoryScanner> scanner = createScanner(options);
+    if(scanner == nullptr)
+        return false;
+
+    // Cancelled is not an error.
+    bSuccessA = bSuccessB = bSuccessC = true;
+    if(scanner->scan())
+        getScanResults(*scanner, bSuccessA, bSuccessB, bSuccessC);
+    return true;
+}
+
+std::unique_ptr<DirectoryScanner> DirectoryInfo::createScanner(const QSharedPointer<const Options>& options)
 {
-    CompositeIgnoreList ignoreList;
-    if (options->m_bDmUseCvsIgnore)
+    FileAccess* dirs[] = {&m_dirA, &m_dirB, &m_dirC};
+    DirectoryList* dirLists[] = {&m_dirListA, &m_dirListB, &m_dirListC};
+
+    for(const FileAccess* pDir: dirs)
     {
-        ignoreList.addIgnoreList(std::make_unique<CvsIgnoreList>());
-        ignoreList.addIgnoreList(std::make_unique<GitIgnoreList>());
+        if(pDir->isValid() && !pDir->isLocal())
+            return nullptr;
     }
-    return fileAccess.listDir(&dirList,
-                              options->m_bDmRecursiveDirs, options->m_bDmFindHidden,
-                              options->m_DmFilePattern, options->m_DmFileAntiPattern,
-                              options->m_DmDirAntiPattern, options->m_bDmFollowDirLinks,
-                              ignoreList);
+
+    std::unique_ptr<DirectoryScanner> scanner = std::make_unique<DirectoryScanner>(
+        options->m_bDmRecursiveDirs, options->m_bDmFindHidden,
+        options->m_DmFilePattern, options->m_DmFileAntiPattern,
+        options->m_DmDirAntiPattern, options->m_bDmFollowDirLinks);
+
+    // Each tree gets its own ignore list, those remember the rules of every folder entered.
+    for(size_t i = 0; i < std::size(dirs); ++i)
+    {
+        if(dirs[i]->isValid())
+            scanner->addRoot(*dirs[i], *dirLists[i], createIgnoreList(options));
+    }
+    return scanner;
+}
+
+void DirectoryInfo::getScanResults(const DirectoryScanner& scanner, bool& bSuccessA, bool& bSuccessB, bool& bSuccessC) const
+{
+    const FileAccess* dirs[] = {&m_dirA, &m_dirB, &m_dirC};
+    bool* successes[] = {&bSuccessA, &bSuccessB, &bSuccessC};
+
+    size_t root = 0;
+    for(size_t i = 0; i < std::size(dirs); ++i)
+        *successes[i] = !dirs[i]->isValid() || scanner.succeeded(root++);
+}
+
+std::unique_ptr<IgnoreList> DirectoryInfo::createIgnoreList(const QSharedPointer<const Options>& options)
+{
+    std::unique_ptr<CompositeIgnoreList> ignoreList = std::make_unique<CompositeIgnoreList>();
+    if(options->m_bDmUseCvsIgnore)
+    {
+        ignoreList->addIgnoreList(std::make_unique<CvsIgnoreList>());
+        ignoreList->addIgnoreList(std::make_unique<GitIgnoreList>());
+    }
+    return ignoreList;
+}
+
+bool DirectoryInfo::listDir(FileAccess& fileAccess, DirectoryList& dirList, const QSharedPointer<const Options>& options)
+{
+    const std::unique_ptr<IgnoreList> ignoreList = createIgnoreList(options);
+    RemoteDirectoryLister::setMaxJobs(options->m_dmMaxRemoteJobs);
+    TraceScope traceScope(TraceStage::directoryList);
+    const bool bSuccess = fileAccess.listDir(&dirList,
+                                             options->m_bDmRecursiveDirs, options->m_bDmFindHidden,
+                                             options->m_DmFilePattern, options->m_DmFileAntiPattern,
+                                             options->m_DmDirAntiPattern, options->m_bDmFollowDirLinks,
+                                             *ignoreList);
+    traceScope.setItems((qint64)dirList.size());
+    return bSuccess;
 }
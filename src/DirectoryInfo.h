@@ -12,6 +12,11 @@
 #include "fileaccess.h"
 #include "options.h"
 
+#include <memory>
+
+class DirectoryScanner;
+class IgnoreList;
+
 class DirectoryInfo
 {
   public:
@@ -45,11 +50,20 @@ class DirectoryInfo
     bool listDirA(const QSharedPointer<const Options>& options);
     bool listDirB(const QSharedPointer<const Options>& options);
     bool listDirC(const QSharedPointer<const Options>& options);
+    /*
+        Reads A, B and C at the same time. Returns false without doing anything unless all of
+        them are local, remote folders are read one after another by listDirA/B/C.
+    */
+    bool listDirsConcurrently(const QSharedPointer<const Options>& options, bool& bSuccessA, bool& bSuccessB, bool& bSuccessC);
+    // A scanner for A, B and C to be run in the background, nullptr unless all of them are local.
+    std::unique_ptr<DirectoryScanner> createScanner(const QSharedPointer<const Options>& options);
+    void getScanResults(const DirectoryScanner& scanner, bool& bSuccessA, bool& bSuccessB, bool& bSuccessC) const;
     DirectoryList& getDirListA() { return m_dirListA; }
     DirectoryList& getDirListB() { return m_dirListB; }
     DirectoryList& getDirListC() { return m_dirListC; }
 
   private:
+    static std::unique_ptr<IgnoreList> createIgnoreList(const QSharedPointer<const Options>& options);
     bool listDir(FileAccess& fileAccess, DirectoryList& dirList, const QSharedPointer<const Options>& options);
 
     FileAccess m_dirA, m_dirB, m_dirC;
@@ -0,0 +1,391 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "DirectoryScanner.h"
+
+#include "fileaccess.h"
+#include "IgnoreList.h"
+#include "Logging.h"
+#include "ProgressProxy.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFileInfoList>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QThread>
+
+namespace {
+// The ignore lists of a root are shared by its threads.
+QMutex s_filterMutex;
+
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+#define KDIFF3_STATX_LISTING
+
+constexpr unsigned int statxMask = STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID | STATX_SIZE | STATX_MTIME | STATX_INO;
+
+quint64 device(const struct statx& st)
+{
+    return ((quint64)st.stx_dev_major << 32) | st.stx_dev_minor;
+}
+
+bool inGroup(const gid_t gid)
+{
+    static const std::vector<gid_t> groups = []() {
+        std::vector<gid_t> result(1, getegid());
+        const int count = getgroups(0, nullptr);
+        if(count > 0)
+        {
+            result.resize(1 + (size_t)count);
+            result.resize(1 + (size_t)std::max(getgroups(count, result.data() + 1), 0));
+        }
+        return result;
+    }();
+    return std::find(groups.begin(), groups.end(), gid) != groups.end();
+}
+
+// From the mode bits like access() would decide, ACLs and read-only mounts aside.
+bool permitted(const struct statx& st, const unsigned int userBit)
+{
+    static const uid_t euid = geteuid();
+    const unsigned int mode = st.stx_mode;
+    if(euid == 0)
+        return userBit != S_IXUSR || (mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0 || S_ISDIR(mode);
+    if(st.stx_uid == euid)
+        return (mode & userBit) != 0;
+    if(inGroup(st.stx_gid))
+        return (mode & (userBit >> 3)) != 0;
+    return (mode & (userBit >> 6)) != 0;
+}
+
+QDateTime modificationTime(const struct statx& st)
+{
+    return QDateTime::fromMSecsSinceEpoch(st.stx_mtime.tv_sec * 1000 + st.stx_mtime.tv_nsec / 1000000);
+}
+
+/*
+    Reads a folder with one statx per entry, relative to the open folder so the path isn't looked
+    up again. Links take a second one for their target and a readlinkat. QDir would stat each
+    entry twice and ask access() for every permission on top.
+*/
+bool readLocalDir(const QString& path, const bool bFindHidden, std::vector<FileAccess::EntryInfo>& entries)
+{
+    const int dirFd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirFd < 0)
+        return false;
+    DIR* pDir = fdopendir(dirFd);
+    if(pDir == nullptr)
+    {
+        close(dirFd);
+        return false;
+    }
+
+    std::vector<char> linkBuffer(PATH_MAX + 1);
+    while(const dirent* pEntry = readdir(pDir))
+    {
+        const char* pName = pEntry->d_name;
+        if(strcmp(pName, ".") == 0 || strcmp(pName, "..") == 0 || (!bFindHidden && pName[0] == '.'))
+            continue;
+
+        struct statx st;
+        if(statx(dirFd, pName, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, statxMask, &st) != 0)
+            continue; // Gone since it was listed.
+
+        FileAccess::EntryInfo info;
+        info.name = QFile::decodeName(pName);
+        info.bSymLink = S_ISLNK(st.stx_mode);
+        if(info.bSymLink)
+        {
+            const ssize_t length = readlinkat(dirFd, pName, linkBuffer.data(), PATH_MAX);
+            if(length > 0)
+                info.linkTarget = QFile::decodeName(QByteArray(linkBuffer.data(), (int)length));
+
+            // The rest describes the target, as QFileInfo does.
+            struct statx target;
+            info.bBrokenLink = statx(dirFd, pName, AT_NO_AUTOMOUNT, statxMask, &target) != 0;
+            if(!info.bBrokenLink)
+                st = target;
+        }
+
+        if(!info.bBrokenLink)
+        {
+            info.bFile = S_ISREG(st.stx_mode);
+            info.bDir = S_ISDIR(st.stx_mode);
+            info.size = (qint64)st.stx_size;
+            info.modificationTime = modificationTime(st);
+            info.bReadable = permitted(st, S_IRUSR);
+            info.bWritable = permitted(st, S_IWUSR);
+            info.bExecutable = permitted(st, S_IXUSR);
+            info.device = device(st);
+            info.inode = st.stx_ino;
+        }
+        entries.push_back(std::move(info));
+    }
+    closedir(pDir);
+
+    // Same order as QDir::Name | QDir::DirsFirst.
+    std::sort(entries.begin(), entries.end(), [](const FileAccess::EntryInfo& a, const FileAccess::EntryInfo& b) {
+        if(a.bDir != b.bDir)
+            return a.bDir;
+        return a.name.compare(b.name) < 0;
+    });
+    return true;
+}
+#endif
+} // namespace
+
+struct DirectoryScanner::Listing
+{
+    bool bSuccess = false;
+    std::vector<FileAccess::EntryInfo> entries;
+};
+
+DirectoryScanner::DirectoryScanner(const bool bRecursive, const bool bFindHidden, const QString& filePattern,
+                                   const QString& fileAntiPattern, const QString& dirAntiPattern, const bool bFollowDirLinks):
+    mRecursive(bRecursive),
+    mFindHidden(bFindHidden),
+    mNameFilter(filePattern, fileAntiPattern, dirAntiPattern),
+    mFollowDirLinks(bFollowDirLinks)
+{
+    // Reading folders mostly waits for the disk, more threads than cores still pay off.
+    mPool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 2) * 2);
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+    mCancelled = true;
+    mPool.waitForDone();
+}
+
+void DirectoryScanner::addRoot(FileAccess& dir, DirectoryList& dirList, IgnoreList& ignoreList)
+{
+    std::unique_ptr<Root> root = std::make_unique<Root>();
+    root->dirList = &dirList;
+    root->ignoreList = &ignoreList;
+    root->node = std::make_unique<Node>(&dir);
+    mRoots.push_back(std::move(root));
+}
+
+void DirectoryScanner::addRoot(FileAccess& dir, DirectoryList& dirList, std::unique_ptr<IgnoreList>&& pIgnoreList)
+{
+    addRoot(dir, dirList, *pIgnoreList);
+    mOwnedIgnoreLists.push_back(std::move(pIgnoreList));
+}
+
+bool DirectoryScanner::scan()
+{
+    ProgressProxy pp;
+
+    start(nullptr, {});
+    while(!mPool.waitForDone(100))
+    {
+        pp.setInformation(i18nc("Status message", "Reading folders: %1 read", mDirsRead.load()), false);
+        if(pp.wasCancelled())
+            mCancelled = true;
+    }
+
+    return collectResults();
+}
+
+void DirectoryScanner::start(QObject* pContext, const std::function<void()>& finished)
+{
+    mContext = pContext;
+    mFinished = finished;
+
+    for(const std::unique_ptr<Root>& root: mRoots)
+    {
+        root->dirList->clear();
+        startTask(root.get(), root->node.get());
+    }
+}
+
+bool DirectoryScanner::collectResults()
+{
+    mPool.waitForDone();
+    for(const std::unique_ptr<Root>& root: mRoots)
+        collect(*root->node, *root->dirList);
+
+    return !mCancelled;
+}
+
+void DirectoryScanner::startTask(Root* pRoot, Node* pNode)
+{
+    // A folder queues its subfolders before its own task ends, so zero means everything is read.
+    ++mPendingTasks;
+    mPool.start([this, pRoot, pNode]() {
+        scanDir(pRoot, pNode);
+        if(--mPendingTasks == 0 && mContext != nullptr)
+            QMetaObject::invokeMethod(mContext, mFinished, Qt::QueuedConnection);
+    });
+}
+
+void DirectoryScanner::scanDir(Root* pRoot, Node* pNode)
+{
+    if(mCancelled)
+        return;
+
+    const QString path = pNode->dir->absoluteFilePath();
+
+#ifdef KDIFF3_STATX_LISTING
+    const std::shared_ptr<const Listing> pListing = listing(pNode, path);
+    std::map<QString, FolderId> folderIds;
+    if(pListing->bSuccess)
+    {
+        for(const FileAccess::EntryInfo& info: pListing->entries)
+        {
+            if(mCancelled)
+                return;
+
+            if(info.bDir && info.inode != 0)
+                folderIds[info.name] = {info.device, info.inode};
+
+            FileAccess fa;
+            fa.setFile(pNode->dir, info);
+            pNode->entries.push_back(std::move(fa));
+        }
+    }
+    else if(pNode == pRoot->node.get())
+        pRoot->bSuccess = false;
+#else
+    QDir dir(path);
+
+    dir.setSorting(QDir::Name | QDir::DirsFirst);
+    if(mFindHidden)
+        dir.setFilter(QDir::Files | QDir::Dirs | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    else
+        dir.setFilter(QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
+
+    const QFileInfoList fiList = dir.entryInfoList();
+    /*
+        Sadly Qt provides no error information making an empty list ambiguous.
+        A readability check is the best we can do. As before only the root folder counts.
+    */
+    if(fiList.isEmpty() && pNode == pRoot->node.get())
+        pRoot->bSuccess = dir.isReadable();
+
+    for(const QFileInfo& fi: fiList)
+    {
+        if(mCancelled)
+            return;
+
+        assert(fi.fileName() != "." && fi.fileName() != "..");
+
+        FileAccess fa;
+        fa.setFile(pNode->dir, fi);
+        pNode->entries.push_back(std::move(fa));
+    }
+#endif
+
+    {
+        QMutexLocker locker(&s_filterMutex);
+        pRoot->ignoreList->enterDir(path, pNode->entries);
+        pNode->dir->filterList(path, &pNode->entries, mNameFilter, *pRoot->ignoreList);
+    }
+    ++mDirsRead;
+
+    if(!mRecursive)
+        return;
+
+    // Entries are list nodes, their addresses stay valid as parents of the next level.
+    for(FileAccess& entry: pNode->entries)
+    {
+        assert(entry.isValid());
+        if(!entry.isDir() || (entry.isSymLink() && !mFollowDirLinks))
+            continue;
+
+        std::unique_ptr<Node> pChild = std::make_unique<Node>(&entry, pNode);
+#ifdef KDIFF3_STATX_LISTING
+        const auto it = folderIds.find(entry.fileName());
+        if(it != folderIds.end())
+        {
+            pChild->id = it->second;
+            pChild->bHasId = true;
+        }
+        if(isCycle(pChild.get()))
+        {
+            qCInfo(kdiffFileAccess) << "Not entering" << entry.absoluteFilePath() << "it leads back to a parent folder.";
+            continue;
+        }
+#endif
+        pNode->children.push_back(std::move(pChild));
+    }
+
+    for(const std::unique_ptr<Node>& child: pNode->children)
+        startTask(pRoot, child.get());
+}
+
+#ifdef KDIFF3_STATX_LISTING
+std::shared_ptr<const DirectoryScanner::Listing> DirectoryScanner::listing(Node* pNode, const QString& path)
+{
+    // Only followed links lead to a folder more than once.
+    const bool bShare = mRecursive && mFollowDirLinks;
+    if(bShare && !pNode->bHasId)
+    {
+        struct statx st;
+        pNode->bHasId = statx(AT_FDCWD, QFile::encodeName(path).constData(), AT_NO_AUTOMOUNT, STATX_INO, &st) == 0;
+        if(pNode->bHasId)
+            pNode->id = {device(st), st.stx_ino};
+    }
+
+    if(bShare && pNode->bHasId)
+    {
+        QMutexLocker locker(&mListingsMutex);
+        const auto it = mListings.find(pNode->id);
+        if(it != mListings.end())
+            return it->second;
+    }
+
+    std::shared_ptr<Listing> pListing = std::make_shared<Listing>();
+    pListing->bSuccess = readLocalDir(path, mFindHidden, pListing->entries);
+    if(bShare && pNode->bHasId && pListing->bSuccess)
+    {
+        // Another path to the same folder may have been read meanwhile, the first one is kept.
+        QMutexLocker locker(&mListingsMutex);
+        return mListings.emplace(pNode->id, pListing).first->second;
+    }
+    return pListing;
+}
+
+bool DirectoryScanner::isCycle(const Node* pNode)
+{
+    if(!pNode->bHasId)
+        return false;
+
+    for(const Node* pAncestor = pNode->parent; pAncestor != nullptr; pAncestor = pAncestor->parent)
+    {
+        if(pAncestor->bHasId && pAncestor->id == pNode->id)
+            return true;
+    }
+    return false;
+}
+#endif
+
+void DirectoryScanner::collect(Node& node, DirectoryList& dirList)
+{
+    dirList.splice(dirList.end(), node.entries);
+    for(const std::unique_ptr<Node>& child: node.children)
+        collect(*child, dirList);
+}
@@ -0,0 +1,131 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include "DirectoryList.h"
+#include "FileNameFilter.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+class FileAccess;
+class IgnoreList;
+class QObject;
+
+/*
+    Lists local folders on a thread pool.
+
+    Every folder is read by its own task and the tasks for its subfolders are queued as soon as it
+    has been filtered, so deep and wide trees keep all threads busy. Several roots can be added and
+    are read at the same time. The result has the same order as a sequential depth first listing.
+
+    Ignore lists and the wildcard cache of the filters are not thread safe. Entering a folder and
+    filtering its entries is therefore done under a lock, only reading the folder runs in parallel.
+    That is where the time goes anyway.
+
+    Remote folders must be listed by KIO in the gui thread and are not handled here.
+
+    When folder links are followed, the listing of each physical folder is kept for the lifetime
+    of the scanner. Reaching it again by another link, also from another root, reuses it instead
+    of reading the folder again. A link back into one of its own parents isn't entered.
+*/
+class DirectoryScanner
+{
+  public:
+    DirectoryScanner(const bool bRecursive, const bool bFindHidden, const QString& filePattern,
+                     const QString& fileAntiPattern, const QString& dirAntiPattern, const bool bFollowDirLinks);
+    ~DirectoryScanner();
+
+    // dir, dirList and ignoreList must stay alive until scan() returns or the scanner is destroyed.
+    void addRoot(FileAccess& dir, DirectoryList& dirList, IgnoreList& ignoreList);
+    void addRoot(FileAccess& dir, DirectoryList& dirList, std::unique_ptr<IgnoreList>&& pIgnoreList);
+
+    // Returns false if it was cancelled. Keeps the progress dialog responsive while waiting.
+    bool scan();
+
+    /*
+        Starts reading and returns at once. finished is queued to the thread of pContext when the
+        last folder is done, also after cancel(). Call collectResults() from there.
+    */
+    void start(QObject* pContext, const std::function<void()>& finished);
+    void cancel() { mCancelled = true; }
+    // Fills the folder lists. Returns false if it was cancelled.
+    bool collectResults();
+
+    [[nodiscard]] qint64 dirsRead() const { return mDirsRead; }
+
+    [[nodiscard]] bool succeeded(const size_t root) const { return mRoots[root]->bSuccess; }
+
+  private:
+    // Device and inode, where links to a folder lead to the same.
+    struct FolderId
+    {
+        quint64 device = 0;
+        quint64 inode = 0;
+
+        bool operator==(const FolderId& other) const { return device == other.device && inode == other.inode; }
+        bool operator<(const FolderId& other) const { return device != other.device ? device < other.device : inode < other.inode; }
+    };
+
+    struct Listing;
+
+    struct Node
+    {
+        explicit Node(FileAccess* pDir, Node* pParent = nullptr): dir(pDir), parent(pParent) {}
+
+        FileAccess* dir;
+        Node* parent;
+        FolderId id;
+        bool bHasId = false;
+        DirectoryList entries;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+
+    struct Root
+    {
+        DirectoryList* dirList = nullptr;
+        IgnoreList* ignoreList = nullptr;
+        std::unique_ptr<Node> node;
+        std::atomic<bool> bSuccess = true;
+    };
+
+    void startTask(Root* pRoot, Node* pNode);
+    void scanDir(Root* pRoot, Node* pNode);
+    std::shared_ptr<const Listing> listing(Node* pNode, const QString& path);
+    [[nodiscard]] static bool isCycle(const Node* pNode);
+    static void collect(Node& node, DirectoryList& dirList);
+
+    bool mRecursive;
+    bool mFindHidden;
+    FileNameFilter mNameFilter;
+    bool mFollowDirLinks;
+
+    std::vector<std::unique_ptr<Root>> mRoots;
+    std::vector<std::unique_ptr<IgnoreList>> mOwnedIgnoreLists;
+    QThreadPool mPool;
+    std::atomic<bool> mCancelled = false;
+    std::atomic<qint64> mDirsRead = 0;
+    std::atomic<qint64> mPendingTasks = 0;
+    QObject* mContext = nullptr;
+    std::function<void()> mFinished;
+
+    QMutex mListingsMutex;
+    std::map<FolderId, std::shared_ptr<const Listing>> mListings;
+};
+
+#endif
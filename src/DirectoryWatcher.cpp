@@ -0,0 +1,59 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "DirectoryWatcher.h"
+
+#include "defmac.h"
+
+#include <KDirWatch>
+
+DirectoryWatcher::DirectoryWatcher(QObject* pParent):
+    QObject(pParent)
+{
+    mTimer.setSingleShot(true);
+    mTimer.setInterval(500);
+    chk_connect_a(&mTimer, &QTimer::timeout, this, &DirectoryWatcher::slotReport);
+}
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+
+void DirectoryWatcher::watch(const QStringList& dirs)
+{
+    stop();
+
+    mDirWatch = std::make_unique<KDirWatch>();
+    chk_connect_a(mDirWatch.get(), &KDirWatch::dirty, this, &DirectoryWatcher::slotPathChanged);
+    chk_connect_a(mDirWatch.get(), &KDirWatch::created, this, &DirectoryWatcher::slotPathChanged);
+    chk_connect_a(mDirWatch.get(), &KDirWatch::deleted, this, &DirectoryWatcher::slotPathChanged);
+
+    for(const QString& dir: dirs)
+        mDirWatch->addDir(dir, KDirWatch::WatchFiles | KDirWatch::WatchSubDirs);
+}
+
+void DirectoryWatcher::stop()
+{
+    mDirWatch.reset();
+    mTimer.stop();
+    mPending.clear();
+}
+
+void DirectoryWatcher::slotPathChanged(const QString& path)
+{
+    mPending.insert(path);
+    // Not restarted on every change, a steady stream of changes would never be reported.
+    if(!mTimer.isActive())
+        mTimer.start();
+}
+
+void DirectoryWatcher::slotReport()
+{
+    const QStringList paths(mPending.cbegin(), mPending.cend());
+    mPending.clear();
+    Q_EMIT changed(paths);
+}
@@ -0,0 +1,52 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <memory>
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+class KDirWatch;
+
+/*
+    Watches compared folder trees and reports changed paths in batches.
+
+    Editors and builds touch many files at once, so changes are collected for a moment and
+    then reported together by changed().
+*/
+class DirectoryWatcher: public QObject
+{
+    Q_OBJECT
+  public:
+    explicit DirectoryWatcher(QObject* pParent = nullptr);
+    ~DirectoryWatcher() override;
+
+    // Replaces the watched folders, each one including all subfolders.
+    void watch(const QStringList& dirs);
+    void stop();
+
+  Q_SIGNALS:
+    void changed(const QStringList& paths);
+
+  private:
+    void slotPathChanged(const QString& path);
+    void slotReport();
+
+    std::unique_ptr<KDirWatch> mDirWatch;
+    QTimer mTimer;
+    QSet<QString> mPending;
+};
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "fileaccess.h"
 
+#include <QCoreApplication>
 #include <QObject>
 #include <QString>
 
@@ -32,6 +33,10 @@ class FileAccessJobHandler: public QObject
     FileAccessJobHandler(FileAccess* pFileAccess)
     {
         mFileAccess = pFileAccess;
+        // DirectoryScanner creates FileAccess objects on worker threads. KIO jobs report to this object later.
+        const QCoreApplication* pApp = QCoreApplication::instance();
+        if(pApp != nullptr && thread() != pApp->thread())
+            moveToThread(pApp->thread());
     }
 
     virtual FileAccessJobHandler* copy(FileAccess* fileAccess) = 0;
@@ -0,0 +1,177 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "FileAnalysis.h"
+
+#include "options.h"
+
+#include <KLocalizedString>
+
+#include <QTextCodec>
+
+FileAnalysis::FileAnalysis(const QSharedPointer<Options>& pOptions):
+    mOptions(pOptions),
+    mSdA(QSharedPointer<SourceData>::create()),
+    mSdB(QSharedPointer<SourceData>::create()),
+    mSdC(QSharedPointer<SourceData>::create())
+{
+    mSdA->setOptions(mOptions);
+    mSdB->setOptions(mOptions);
+    mSdC->setOptions(mOptions);
+}
+
+bool FileAnalysis::load(const QString& fileA, const QString& fileB, const QString& fileC, QStringList& errors)
+{
+    const QtSizeType nofErrors = errors.size();
+    const auto load = [&errors](const QSharedPointer<SourceData>& sd, const QString& fileName, QTextCodec* pEncoding, const bool bAutoDetectUnicode) {
+        if(fileName.isEmpty())
+            return;
+
+        sd->setFilename(fileName);
+        sd->readAndPreprocess(pEncoding != nullptr ? pEncoding : QTextCodec::codecForLocale(), bAutoDetectUnicode);
+        errors.append(sd->getErrors());
+
+        if(!sd->isValid())
+            errors.append(i18nc("Read error message. %1 = filepath", "Failed to read file: %1", fileName));
+    };
+
+    load(mSdA, fileA, mOptions->m_pEncodingA, mOptions->m_bAutoDetectUnicodeA);
+    load(mSdB, fileB, mOptions->m_pEncodingB, mOptions->m_bAutoDetectUnicodeB);
+    load(mSdC, fileC, mOptions->m_pEncodingC, mOptions->m_bAutoDetectUnicodeC);
+    return errors.size() == nofErrors;
+}
+
+bool FileAnalysis::isText() const
+{
+    return mSdA->isText() && mSdB->isText() && (!isThreeWay() || mSdC->isText());
+}
+
+void FileAnalysis::run()
+{
+    if(!isText())
+        return;
+
+    IgnoreFlags eIgnoreFlags = IgnoreFlag::none;
+    if(mOptions->ignoreComments())
+        eIgnoreFlags |= IgnoreFlag::ignoreComments;
+    if(mOptions->whiteSpaceIsEqual())
+        eIgnoreFlags |= IgnoreFlag::ignoreWhiteSpace;
+
+    ManualDiffHelpList manualDiffHelpList;
+    DiffList diffList13, diffList23;
+    DiffContext context(DiffSettings(*mOptions));
+
+    manualDiffHelpList.runDiff(mSdA->getLineDataForDiff(), mSdA->getSizeLines(), mSdB->getLineDataForDiff(), mSdB->getSizeLines(), mDiffList12, e_SrcSelector::A, e_SrcSelector::B, context);
+    if(!isThreeWay())
+    {
+        mDiff3LineList.calcDiff3LineListUsingAB(&mDiffList12);
+
+        // Identical text has no fine differences, every line is already marked equal.
+        mTextEqualAB = mSdA->isTextEqualWith(mSdB) || mDiff3LineList.fineDiff(e_SrcSelector::A, mSdA->getLineDataForDisplay(), mSdB->getLineDataForDisplay(), eIgnoreFlags);
+    }
+    else
+    {
+        manualDiffHelpList.runDiff(mSdA->getLineDataForDiff(), mSdA->getSizeLines(), mSdC->getLineDataForDiff(), mSdC->getSizeLines(), diffList13, e_SrcSelector::A, e_SrcSelector::C, context);
+        mDiff3LineList.calcDiff3LineListUsingABAndAC(&mDiffList12, &diffList13);
+        mDiff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+        mDiff3LineList.calcDiff3LineListTrim(mSdA->getLineDataForDiff(), mSdB->getLineDataForDiff(), mSdC->getLineDataForDiff(), &manualDiffHelpList);
+
+        if(mOptions->m_bDiff3AlignBC)
+        {
+            manualDiffHelpList.runDiff(mSdB->getLineDataForDiff(), mSdB->getSizeLines(), mSdC->getLineDataForDiff(), mSdC->getSizeLines(), diffList23, e_SrcSelector::B, e_SrcSelector::C, context);
+            mDiff3LineList.calcDiff3LineListUsingBC(&diffList23);
+            mDiff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+            mDiff3LineList.calcDiff3LineListTrim(mSdA->getLineDataForDiff(), mSdB->getLineDataForDiff(), mSdC->getLineDataForDiff(), &manualDiffHelpList);
+        }
+
+        // B and C are only aligned through A, see KDiff3App::mainInit.
+        if(mSdA->isTextEqualWith(mSdB) && mSdA->isTextEqualWith(mSdC))
+            mTextEqualAB = mTextEqualBC = mTextEqualAC = true;
+        else
+        {
+            mTextEqualAB = mDiff3LineList.fineDiff(e_SrcSelector::A, mSdA->getLineDataForDisplay(), mSdB->getLineDataForDisplay(), eIgnoreFlags);
+            mTextEqualBC = mDiff3LineList.fineDiff(e_SrcSelector::B, mSdB->getLineDataForDisplay(), mSdC->getLineDataForDisplay(), eIgnoreFlags);
+            mTextEqualAC = mDiff3LineList.fineDiff(e_SrcSelector::C, mSdC->getLineDataForDisplay(), mSdA->getLineDataForDisplay(), eIgnoreFlags);
+        }
+    }
+
+    mDiff3LineList.calcWhiteDiff3Lines(mSdA->getLineDataForDiff(), mSdB->getLineDataForDiff(), mSdC->getLineDataForDiff(), mOptions->ignoreComments());
+
+    // Same defaults as an automatic MergeResultWindow::merge.
+    mMergeBlockList.buildFromDiff3(mDiff3LineList, isThreeWay(), mSdA->getLineDataForDisplay(), mSdB->getLineDataForDisplay(), mSdC->getLineDataForDisplay());
+
+    const int whiteSpaceDefault = isThreeWay() ? mOptions->m_whiteSpace3FileMergeDefault : mOptions->m_whiteSpace2FileMergeDefault;
+    if(whiteSpaceDefault > (int)e_SrcSelector::None && whiteSpaceDefault <= (int)e_SrcSelector::Max)
+        mMergeBlockList.updateDefaults((e_SrcSelector)whiteSpaceDefault, false, true);
+
+    for(MergeBlock& mb: mMergeBlockList.list())
+        mb.removeEmptySource();
+}
+
+TotalDiffStatus FileAnalysis::diffStatus() const
+{
+    TotalDiffStatus status;
+    status.reset();
+    status.setBinaryEqualAB(mSdA->isBinaryEqualWith(mSdB));
+    if(isThreeWay())
+    {
+        status.setBinaryEqualAC(mSdA->isBinaryEqualWith(mSdC));
+        status.setBinaryEqualBC(mSdC->isBinaryEqualWith(mSdB));
+    }
+
+    if(!isText())
+    {
+        // Binary files can't be merged line by line, any difference counts as one conflict.
+        const bool bEqual = status.isBinaryEqualAB() && (!isThreeWay() || status.isBinaryEqualAC());
+        status.setUnsolvedConflicts(bEqual ? 0 : 1);
+        return status;
+    }
+
+    status.setTextEqualAB(mTextEqualAB && mSdA->getSizeBytes() != 0 && mSdB->getSizeBytes() != 0);
+    if(isThreeWay())
+    {
+        status.setTextEqualAC(mTextEqualAC && mSdA->getSizeBytes() != 0);
+        status.setTextEqualBC(mTextEqualBC && mSdB->getSizeBytes() != 0);
+    }
+
+    int nrOfSolvedConflicts = 0;
+    int nrOfUnsolvedConflicts = 0;
+    int nrOfWhiteSpaceConflicts = 0;
+    for(const MergeBlock& mb: mMergeBlockList.list())
+    {
+        if(mb.isConflict())
+            ++nrOfUnsolvedConflicts;
+        else if(mb.isDelta())
+            ++nrOfSolvedConflicts;
+
+        if(mb.isWhiteSpaceConflict())
+            ++nrOfWhiteSpaceConflicts;
+    }
+
+    status.setUnsolvedConflicts(nrOfUnsolvedConflicts);
+    status.setSolvedConflicts(nrOfSolvedConflicts);
+    status.setWhitespaceConflicts(nrOfWhiteSpaceConflicts);
+    return status;
+}
+
+bool FileAnalysis::analyse(const QString& fileA, const QString& fileB, const QString& fileC, const QSharedPointer<Options>& pOptions, TotalDiffStatus& diffStatus, QStringList& errors)
+{
+    FileAnalysis analysis(pOptions);
+    if(!analysis.load(fileA, fileB, fileC, errors))
+        return false;
+
+    // Most files of a folder are usually unchanged, they need neither line matching nor merge blocks.
+    if(analysis.isText() && analysis.mSdA->isTextEqualWith(analysis.mSdB) && (!analysis.isThreeWay() || analysis.mSdA->isTextEqualWith(analysis.mSdC)))
+        analysis.mTextEqualAB = analysis.mTextEqualAC = analysis.mTextEqualBC = true;
+    else
+        analysis.run();
+
+    diffStatus = analysis.diffStatus();
+    return true;
+}
@@ -0,0 +1,74 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef FILEANALYSIS_H
+#define FILEANALYSIS_H
+
+#include "diff.h"
+#include "MergeEditLine.h"
+#include "SourceData.h"
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+class Options;
+
+/*
+    Compares two or three files line by line without any window.
+
+    Runs the same steps as KDiff3App::mainInit followed by an automatic MergeResultWindow::merge,
+    without manual alignment and without the history and regular expression auto merge. Nothing
+    here uses Diff3Line::m_pDiffBufferInfo apart from reading the fine diff algorithm, so local
+    files can be analysed on worker threads while the gui shows a different diff.
+*/
+class FileAnalysis
+{
+  public:
+    explicit FileAnalysis(const QSharedPointer<Options>& pOptions);
+    // The merge blocks point into the own Diff3LineList.
+    FileAnalysis(const FileAnalysis&) = delete;
+    FileAnalysis& operator=(const FileAnalysis&) = delete;
+
+    // Reads the inputs, fileC may be empty. Returns false if an input could not be read.
+    bool load(const QString& fileA, const QString& fileB, const QString& fileC, QStringList& errors);
+    // Aligns the lines and builds the merge blocks. Only has an effect when all inputs are text.
+    void run();
+
+    [[nodiscard]] bool isThreeWay() const { return !mSdC->isEmpty(); }
+    [[nodiscard]] bool isText() const;
+
+    [[nodiscard]] const QSharedPointer<SourceData>& sdA() const { return mSdA; }
+    [[nodiscard]] const QSharedPointer<SourceData>& sdB() const { return mSdB; }
+    [[nodiscard]] const QSharedPointer<SourceData>& sdC() const { return mSdC; }
+    [[nodiscard]] const MergeBlockList& mergeBlockList() const { return mMergeBlockList; }
+    // The line matching of A and B, kept for PatchWriter.
+    [[nodiscard]] const DiffList& diffList12() const { return mDiffList12; }
+
+    // Equality and conflict counts as the directory merge shows them, call after run().
+    [[nodiscard]] TotalDiffStatus diffStatus() const;
+
+    // Loads and analyses the files in one go, skipping the line matching for identical texts.
+    static bool analyse(const QString& fileA, const QString& fileB, const QString& fileC, const QSharedPointer<Options>& pOptions, TotalDiffStatus& diffStatus, QStringList& errors);
+
+  private:
+    QSharedPointer<Options> mOptions;
+    QSharedPointer<SourceData> mSdA;
+    QSharedPointer<SourceData> mSdB;
+    QSharedPointer<SourceData> mSdC;
+
+    DiffList mDiffList12;
+    Diff3LineList mDiff3LineList;
+    MergeBlockList mMergeBlockList;
+    bool mTextEqualAB = false;
+    bool mTextEqualAC = false;
+    bool mTextEqualBC = false;
+};
+
+#endif
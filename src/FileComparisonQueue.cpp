@@ -0,0 +1,98 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "FileComparisonQueue.h"
+
+#include "fileaccess.h"
+#include "options.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QMutexLocker>
+#include <QThread>
+
+FileComparisonQueue::FileComparisonQueue(const QSharedPointer<const Options>& pOptions):
+    mOptions(pOptions)
+{
+    // Reading local files mostly waits for the disk, more threads than cores still pay off.
+    // The full analysis is mostly computing, there more threads would only keep more files in memory.
+    if(mOptions->m_bDmFullAnalysis)
+        mPool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 1));
+    else
+        mPool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 2) * 2);
+}
+
+FileComparisonQueue::~FileComparisonQueue()
+{
+    mCancelled = true;
+    mPool.waitForDone();
+}
+
+void FileComparisonQueue::start(std::vector<MergeFileInfos*>&& items)
+{
+    // Both keep the order of the tree.
+    for(MergeFileInfos* pMFI: items)
+        (largestSize(pMFI) >= largeFileSize ? mLargeFiles : mSmallFiles).items.push_back(pMFI);
+
+    const int threads = mPool.maxThreadCount();
+    int largeWorkers = 0;
+    if(!mLargeFiles.items.empty())
+        largeWorkers = mSmallFiles.items.empty() ? threads : std::max(threads / 4, 1);
+
+    startWorkers(mLargeFiles, largeWorkers);
+    startWorkers(mSmallFiles, std::max(threads - largeWorkers, 1));
+}
+
+void FileComparisonQueue::startWorkers(Lane& lane, const int count)
+{
+    for(int i = 0; i < count && (size_t)i < lane.items.size(); ++i)
+    {
+        mPool.start([this, &lane]() {
+            for(size_t idx = lane.nextItem++; idx < lane.items.size() && !mCancelled; idx = lane.nextItem++)
+            {
+                Result result = compare(lane.items[idx], mOptions);
+
+                QMutexLocker locker(&mResultMutex);
+                mResults.push_back(std::move(result));
+            }
+        });
+    }
+}
+
+qint64 FileComparisonQueue::largestSize(const MergeFileInfos* pMFI)
+{
+    qint64 size = 0;
+    for(const FileAccess* pFileInfo: {pMFI->getFileInfoA(), pMFI->getFileInfoB(), pMFI->getFileInfoC()})
+    {
+        if(pFileInfo != nullptr)
+            size = std::max(size, pFileInfo->size());
+    }
+    return size;
+}
+
+FileComparisonQueue::Result FileComparisonQueue::compare(MergeFileInfos* pMFI, const QSharedPointer<const Options>& pOptions)
+{
+    Result result;
+    result.pMFI = pMFI;
+    if(pOptions->m_bDmFullAnalysis)
+        result.equality = pMFI->analyseFiles(result.diffStatus, result.bError, result.status, pOptions);
+    else
+        result.equality = pMFI->compareFiles(result.bError, result.status, pOptions);
+    return result;
+}
+
+std::vector<FileComparisonQueue::Result> FileComparisonQueue::takeResults()
+{
+    std::vector<Result> results;
+
+    QMutexLocker locker(&mResultMutex);
+    results.swap(mResults);
+    return results;
+}
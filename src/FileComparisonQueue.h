@@ -0,0 +1,87 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef FILECOMPARISONQUEUE_H
+#define FILECOMPARISONQUEUE_H
+
+#include "MergeFileInfos.h"
+
+#include <atomic>
+#include <vector>
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+
+class Options;
+
+/*
+    Compares the files of local merge items on a thread pool, including the full analysis.
+
+    Workers only read the items. The results are collected and applied by the caller in the gui
+    thread, so the view never sees an item while it changes.
+
+    Items with a file of largeFileSize or more go to a lane of their own with a quarter of the
+    threads. A few huge files then keep the disk busy with long sequential reads while the
+    remaining threads get through the small ones, instead of all threads waiting on the huge ones.
+*/
+class FileComparisonQueue
+{
+  public:
+    static constexpr qint64 largeFileSize = 64 * 1024 * 1024;
+
+    struct Result
+    {
+        MergeFileInfos* pMFI = nullptr;
+        MergeFileInfos::Equality equality;
+        bool bError = false;
+        QString status;
+        TotalDiffStatus diffStatus; // Only filled by the full analysis.
+    };
+
+    // Compares or, with the full analysis, analyses the files of one item.
+    [[nodiscard]] static Result compare(MergeFileInfos* pMFI, const QSharedPointer<const Options>& pOptions);
+
+    explicit FileComparisonQueue(const QSharedPointer<const Options>& pOptions);
+    ~FileComparisonQueue();
+
+    // The items must stay alive until the queue is done or destroyed.
+    void start(std::vector<MergeFileInfos*>&& items);
+    void cancel() { mCancelled = true; }
+    [[nodiscard]] bool isCancelled() const { return mCancelled; }
+
+    // Returns true once no worker is left, waiting at most msecs.
+    bool waitForDone(const int msecs) { return mPool.waitForDone(msecs); }
+    // Hands out the results that arrived since the last call.
+    [[nodiscard]] std::vector<Result> takeResults();
+
+    // The size of the largest file of an item.
+    [[nodiscard]] static qint64 largestSize(const MergeFileInfos* pMFI);
+
+  private:
+    struct Lane
+    {
+        std::vector<MergeFileInfos*> items;
+        std::atomic<size_t> nextItem = 0;
+    };
+
+    void startWorkers(Lane& lane, const int count);
+
+    QSharedPointer<const Options> mOptions;
+    Lane mSmallFiles;
+    Lane mLargeFiles;
+
+    QThreadPool mPool;
+    QMutex mResultMutex;
+    std::vector<Result> mResults;
+    std::atomic<bool> mCancelled = false;
+};
+
+#endif
@@ -0,0 +1,191 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "FileHashCache.h"
+
+#include "Logging.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+constexpr quint32 fileMagic = 0x4B444843; // "KDHC"
+constexpr qint32 fileVersion = 1;
+// Entries not used for this long are dropped when saving.
+constexpr qint64 maxAge = 90LL * 24 * 60 * 60;
+constexpr size_t maxEntries = 1000000;
+} // namespace
+
+FileHashCache::FileHashCache(const QString& fileName):
+    mFileName(fileName), mNow(QDateTime::currentSecsSinceEpoch())
+{
+}
+
+FileHashCache::~FileHashCache() = default;
+
+FileHashCache& FileHashCache::instance()
+{
+    static FileHashCache cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/filehashes"));
+    return cache;
+}
+
+QByteArray FileHashCache::hashAlgorithmName()
+{
+    return QByteArrayLiteral("sha256");
+}
+
+bool FileHashCache::stamp(const QString& filePath, Stamp& result)
+{
+    const QFileInfo fileInfo(filePath);
+    if(!fileInfo.isFile())
+        return false;
+
+    result.size = fileInfo.size();
+    result.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+    result.changed = fileInfo.metadataChangeTime().toMSecsSinceEpoch();
+    result.inode = 0;
+    result.device = 0;
+
+#ifndef Q_OS_WIN
+    struct stat statBuf;
+    if(::stat(QFile::encodeName(filePath).constData(), &statBuf) != 0)
+        return false;
+    result.inode = (quint64)statBuf.st_ino;
+    result.device = (quint64)statBuf.st_dev;
+#endif
+    return true;
+}
+
+bool FileHashCache::find(const QString& filePath, const Stamp& fileStamp, QByteArray& hash)
+{
+    QMutexLocker locker(&mMutex);
+    load();
+
+    const QHash<QString, Entry>::iterator it = mEntries.find(filePath);
+    if(it == mEntries.end())
+        return false;
+
+    if(!(it->stamp == fileStamp))
+    {
+        mEntries.erase(it);
+        mDirty = true;
+        return false;
+    }
+
+    hash = it->hash;
+    if(it->lastUsed != mNow)
+    {
+        it->lastUsed = mNow;
+        mDirty = true;
+    }
+    return true;
+}
+
+void FileHashCache::insert(const QString& filePath, const Stamp& fileStamp, const QByteArray& hash)
+{
+    QMutexLocker locker(&mMutex);
+    load();
+
+    mEntries.insert(filePath, {fileStamp, hash, mNow});
+    mDirty = true;
+}
+
+void FileHashCache::load()
+{
+    if(mLoaded)
+        return;
+    mLoaded = true;
+
+    QFile file(mFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    qint32 version = 0;
+    QByteArray algorithm;
+    in >> magic >> version >> algorithm;
+    // Anything unexpected just means everything gets compared again.
+    if(magic != fileMagic || version != fileVersion || algorithm != hashAlgorithmName())
+        return;
+
+    qint64 count = 0;
+    in >> count;
+    for(qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Entry entry;
+        in >> path >> entry.stamp.size >> entry.stamp.modified >> entry.stamp.changed >> entry.stamp.inode >> entry.stamp.device >> entry.hash >> entry.lastUsed;
+        if(in.status() == QDataStream::Ok)
+            mEntries.insert(path, entry);
+    }
+
+    if(in.status() != QDataStream::Ok)
+    {
+        qCWarning(kdiffMergeFileInfo) << "Ignoring damaged hash cache" << mFileName;
+        mEntries.clear();
+    }
+}
+
+bool FileHashCache::save()
+{
+    QMutexLocker locker(&mMutex);
+    if(!mDirty)
+        return true;
+
+    std::vector<QHash<QString, Entry>::const_iterator> entries;
+    entries.reserve(mEntries.size());
+    for(QHash<QString, Entry>::const_iterator it = mEntries.cbegin(); it != mEntries.cend(); ++it)
+    {
+        if(mNow - it->lastUsed <= maxAge)
+            entries.push_back(it);
+    }
+    if(entries.size() > maxEntries)
+    {
+        // Keep the most recently used ones.
+        std::nth_element(entries.begin(), entries.begin() + maxEntries, entries.end(),
+                         [](const auto& a, const auto& b) { return a->lastUsed > b->lastUsed; });
+        entries.resize(maxEntries);
+    }
+
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    QSaveFile file(mFileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << fileMagic << fileVersion << hashAlgorithmName() << (qint64)entries.size();
+    for(const QHash<QString, Entry>::const_iterator& it: entries)
+    {
+        out << it.key() << it->stamp.size << it->stamp.modified << it->stamp.changed << it->stamp.inode << it->stamp.device << it->hash << it->lastUsed;
+    }
+
+    if(!file.commit())
+        return false;
+
+    mDirty = false;
+    return true;
+}
@@ -0,0 +1,77 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef FILEHASHCACHE_H
+#define FILEHASHCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/*
+    Content hashes of local files from earlier folder comparisons, stored on disk.
+
+    A hash is only recorded after a binary comparison read the whole file and found it equal to
+    its counterpart. It is used again only while size, modification time, status change time and
+    inode are unchanged. Two files with valid entries are then equal exactly if their hashes are.
+*/
+class FileHashCache
+{
+  public:
+    struct Stamp
+    {
+        qint64 size = 0;
+        qint64 modified = 0;
+        qint64 changed = 0;
+        quint64 inode = 0;
+        quint64 device = 0;
+
+        [[nodiscard]] bool operator==(const Stamp& other) const
+        {
+            return size == other.size && modified == other.modified && changed == other.changed &&
+                   inode == other.inode && device == other.device;
+        }
+    };
+
+    explicit FileHashCache(const QString& fileName);
+    ~FileHashCache();
+
+    // Shared cache in the user's cache folder, loaded on first use.
+    static FileHashCache& instance();
+
+    // Reads the current stamp of a local file. Returns false if the file can't be examined.
+    static bool stamp(const QString& filePath, Stamp& result);
+    [[nodiscard]] static QByteArray hashAlgorithmName();
+
+    // These may be called from several threads.
+    bool find(const QString& filePath, const Stamp& fileStamp, QByteArray& hash);
+    void insert(const QString& filePath, const Stamp& fileStamp, const QByteArray& hash);
+
+    bool save();
+
+  private:
+    struct Entry
+    {
+        Stamp stamp;
+        QByteArray hash;
+        qint64 lastUsed = 0;
+    };
+
+    void load();
+
+    QString mFileName;
+    QMutex mMutex;
+    QHash<QString, Entry> mEntries;
+    qint64 mNow;
+    bool mLoaded = false;
+    bool mDirty = false;
+};
+
+#endif
@@ -0,0 +1,37 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "FileNameFilter.h"
+
+#include <QStringList>
+
+FileNameFilter::FileNameFilter(const QString& filePattern, const QString& fileAntiPattern, const QString& dirAntiPattern)
+{
+    addPatterns(mFilePattern, filePattern);
+    addPatterns(mFileAntiPattern, fileAntiPattern);
+    addPatterns(mDirAntiPattern, dirAntiPattern);
+}
+
+void FileNameFilter::addPatterns(GlobMatcher& matcher, const QString& patterns)
+{
+    const QStringList patternList = patterns.split(QChar(';'));
+    for(const QString& pattern: patternList)
+        matcher.addPattern(pattern);
+    matcher.compile();
+}
+
+bool FileNameFilter::isFileShown(const QString& fileName, bool bCaseSensitive) const
+{
+    return mFilePattern.matches(fileName, bCaseSensitive) && !mFileAntiPattern.matches(fileName, bCaseSensitive);
+}
+
+bool FileNameFilter::isDirShown(const QString& dirName, bool bCaseSensitive) const
+{
+    return !mDirAntiPattern.matches(dirName, bCaseSensitive);
+}
@@ -0,0 +1,40 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef FILENAMEFILTER_H
+#define FILENAMEFILTER_H
+
+#include "GlobMatcher.h"
+
+#include <QString>
+
+/*
+    The file pattern, file anti-pattern and folder anti-pattern of a folder comparison, each a
+    semicolon separated list of wildcards. They are compiled once per comparison, so checking a
+    name costs a few hash lookups and at most one expression per list. May be used from several
+    threads.
+*/
+class FileNameFilter
+{
+  public:
+    FileNameFilter() = default;
+    FileNameFilter(const QString& filePattern, const QString& fileAntiPattern, const QString& dirAntiPattern);
+
+    [[nodiscard]] bool isFileShown(const QString& fileName, bool bCaseSensitive) const;
+    [[nodiscard]] bool isDirShown(const QString& dirName, bool bCaseSensitive) const;
+
+  private:
+    static void addPatterns(GlobMatcher& matcher, const QString& patterns);
+
+    GlobMatcher mFilePattern;
+    GlobMatcher mFileAntiPattern;
+    GlobMatcher mDirAntiPattern;
+};
+
+#endif
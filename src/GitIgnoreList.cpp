@@ -17,6 +17,7 @@
 #include <utility>
 
 #include <QFile>
+#include <QRegularExpression>
 #include <QStringList>
 #include <QTextStream>
 
@@ -35,44 +36,50 @@ GitIgnoreList::~GitIgnoreList() = default;
 
 void GitIgnoreList::enterDir(const QString& dir, const DirectoryList& directoryList)
 {
+    std::shared_ptr<const GlobMatcher> scope = findScope(dir);
+
     const auto directoryListIt = std::find_if(directoryList.begin(), directoryList.end(), [](const FileAccess& file) {
         return file.fileName() == ".gitignore";
     });
     if(directoryListIt != directoryList.end())
     {
-        addEntries(dir, readFile(directoryListIt->absoluteFilePath()));
+        std::shared_ptr<GlobMatcher> matcher = scope != nullptr ? std::make_shared<GlobMatcher>(*scope) : std::make_shared<GlobMatcher>();
+        addEntries(*matcher, dir, readFile(directoryListIt->absoluteFilePath()));
+        matcher->compile();
+        scope = std::move(matcher);
     }
+
+    m_scopes[dir] = std::move(scope);
 }
 
 bool GitIgnoreList::matches(const QString& dir, const QString& text, bool bCaseSensitive) const
 {
-    for(auto& dirPattern: m_patterns)
+    const std::shared_ptr<const GlobMatcher>& scope = findScope(dir);
+    if(scope != nullptr && scope->matches(text, bCaseSensitive))
     {
-        if(!dir.startsWith(dirPattern.first))
-        {
-            continue;
-        }
-        for(QRegularExpression& pattern: dirPattern.second)
-        {
-            if(!bCaseSensitive)
-            {
-                pattern.setPatternOptions(QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
-            }
-            else
-            {
-                pattern.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption);
-            }
-            const QRegularExpressionMatch match = pattern.match(text);
-            if(match.hasMatch())
-            {
-                qCDebug(kdiffGitIgnoreList) << "Matched entry" << text;
-                return true;
-            }
-        }
+        qCDebug(kdiffGitIgnoreList) << "Matched entry" << text;
+        return true;
     }
     return false;
 }
 
+const std::shared_ptr<const GlobMatcher>& GitIgnoreList::findScope(QString dir) const
+{
+    static const std::shared_ptr<const GlobMatcher> noScope;
+
+    for(;;)
+    {
+        const auto scopeIt = m_scopes.find(dir);
+        if(scopeIt != m_scopes.end())
+            return scopeIt->second;
+
+        const QtSizeType slash = dir.lastIndexOf(QChar('/'));
+        if(slash < 0 || dir.length() == 1)
+            return noScope;
+        dir = slash == 0 ? QStringLiteral("/") : dir.left(slash);
+    }
+}
+
 QString GitIgnoreList::readFile(const QString& fileName) const
 {
     QFile file(fileName);
@@ -84,7 +91,7 @@ QString GitIgnoreList::readFile(const QString& fileName) const
     return stream.readAll();
 }
 
-void GitIgnoreList::addEntries(const QString& dir, const QString& lines)
+void GitIgnoreList::addEntries(GlobMatcher& matcher, const QString& dir, const QString& lines)
 {
     static const QRegularExpression newLineReg = QRegularExpression("[\r\n]");
     const QStringList lineList = lines.split(newLineReg, Qt::SkipEmptyParts);
@@ -94,13 +101,11 @@ void GitIgnoreList::addEntries(const QString& dir, const QString& lines)
         {
             continue;
         }
-        QRegularExpression expression(QRegularExpression::wildcardToRegularExpression(line));
-        if(!expression.isValid())
+        if(!matcher.addPattern(line))
         {
             qCDebug(kdiffGitIgnoreList) << "Expression" << line << "is not valid - skipping ...";
             continue;
         }
         qCDebug(kdiffGitIgnoreList) << "Adding entry [" << dir << "]" << line;
-        m_patterns[dir].push_back(expression);
     }
 }
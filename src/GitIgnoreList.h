@@ -11,13 +11,13 @@
 #ifndef GIT_IGNORE_LIST_H
 #define GIT_IGNORE_LIST_H
 
+#include "GlobMatcher.h"
 #include "IgnoreList.h"
 
-#include <QRegularExpression>
 #include <QString>
 
 #include <map>
-#include <vector>
+#include <memory>
 
 class GitIgnoreList : public IgnoreList
 {
@@ -29,10 +29,17 @@ class GitIgnoreList : public IgnoreList
 
   private:
     [[nodiscard]] virtual QString readFile(const QString& fileName) const;
-    void addEntries(const QString& dir, const QString& lines);
+    void addEntries(GlobMatcher& matcher, const QString& dir, const QString& lines);
+    // The scope of dir or of the closest folder above it that was entered.
+    [[nodiscard]] const std::shared_ptr<const GlobMatcher>& findScope(QString dir) const;
 
   private:
-    mutable std::map<QString, std::vector<QRegularExpression>> m_patterns;
+    /*
+        Every entered folder maps to all patterns that apply in it, its own .gitignore merged with
+        those of the folders above. Folders without a .gitignore share their parent's matcher, so a
+        match is one lookup no matter how many .gitignore files were read.
+    */
+    std::map<QString, std::shared_ptr<const GlobMatcher>> m_scopes;
 };
 
 #endif
@@ -0,0 +1,344 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "GitIndex.h"
+
+#include "Logging.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include <sys/stat.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+namespace {
+constexpr quint32 assumeValidFlag = 0x8000;
+constexpr quint32 extendedFlag = 0x4000;
+constexpr quint32 stageMask = 0x3000;
+constexpr quint32 nameLengthMask = 0x0FFF;
+constexpr quint32 skipWorktreeFlag = 0x4000;
+constexpr quint32 intentToAddFlag = 0x2000;
+constexpr quint32 regularFileMode = 0100000;
+constexpr quint32 fileTypeMask = 0170000;
+// Both times, dev, ino, mode, uid, gid and size.
+constexpr qint64 statDataSize = 40;
+
+class Reader
+{
+  public:
+    explicit Reader(const QByteArray& data): mData(data) {}
+
+    bool read32(quint32& value)
+    {
+        if(mPosition + 4 > mData.size())
+            return false;
+        const uchar* p = (const uchar*)mData.constData() + mPosition;
+        value = ((quint32)p[0] << 24) | ((quint32)p[1] << 16) | ((quint32)p[2] << 8) | p[3];
+        mPosition += 4;
+        return true;
+    }
+
+    bool read16(quint32& value)
+    {
+        if(mPosition + 2 > mData.size())
+            return false;
+        const uchar* p = (const uchar*)mData.constData() + mPosition;
+        value = ((quint32)p[0] << 8) | p[1];
+        mPosition += 2;
+        return true;
+    }
+
+    bool readBytes(const qint64 length, QByteArray& value)
+    {
+        if(length < 0 || mPosition + length > mData.size())
+            return false;
+        value = mData.mid((int)mPosition, (int)length);
+        mPosition += length;
+        return true;
+    }
+
+    // Up to the next NUL, which is consumed.
+    bool readString(QByteArray& value)
+    {
+        const int end = mData.indexOf('\0', (int)mPosition);
+        if(end < 0)
+            return false;
+        value = mData.mid((int)mPosition, end - (int)mPosition);
+        mPosition = end + 1;
+        return true;
+    }
+
+    // The offset encoding of version 4 path prefixes.
+    bool readVarint(quint64& value)
+    {
+        if(mPosition >= mData.size())
+            return false;
+        uchar c = (uchar)mData[(int)mPosition++];
+        value = c & 0x7F;
+        while(c & 0x80)
+        {
+            if(mPosition >= mData.size() || value > (std::numeric_limits<quint64>::max() >> 8))
+                return false;
+            c = (uchar)mData[(int)mPosition++];
+            value = ((value + 1) << 7) | (c & 0x7F);
+        }
+        return true;
+    }
+
+    [[nodiscard]] qint64 position() const { return mPosition; }
+    void setPosition(const qint64 position) { mPosition = position; }
+
+  private:
+    const QByteArray& mData;
+    qint64 mPosition = 0;
+};
+
+struct LoadedIndex
+{
+    qint64 size = -1;
+    qint64 seconds = -1;
+    qint64 nanoseconds = -1;
+    std::shared_ptr<const GitIndex> index;
+};
+
+QMutex gMutex;
+// Folder to the root of its work tree, empty for folders outside of one.
+QHash<QString, QString> gWorkTrees;
+QHash<QString, LoadedIndex> gIndexes;
+
+#ifndef Q_OS_WIN
+#ifdef Q_OS_DARWIN
+const timespec& modificationTime(const struct stat& st) { return st.st_mtimespec; }
+const timespec& changeTime(const struct stat& st) { return st.st_ctimespec; }
+#else
+const timespec& modificationTime(const struct stat& st) { return st.st_mtim; }
+const timespec& changeTime(const struct stat& st) { return st.st_ctim; }
+#endif
+#endif
+
+QString workTreeOf(const QString& dirPath)
+{
+    QStringList visited;
+    QString dir = dirPath;
+    QString root;
+    for(;;)
+    {
+        const QHash<QString, QString>::const_iterator it = gWorkTrees.constFind(dir);
+        if(it != gWorkTrees.constEnd())
+        {
+            root = *it;
+            break;
+        }
+        visited.append(dir);
+        // A folder in work trees, a file in linked work trees and submodules.
+        if(QFileInfo::exists(dir + QStringLiteral("/.git")))
+        {
+            root = dir;
+            break;
+        }
+        const QString parent = QFileInfo(dir).path();
+        if(parent == dir)
+            break;
+        dir = parent;
+    }
+
+    for(const QString& path: visited)
+        gWorkTrees.insert(path, root);
+    return root;
+}
+
+QString gitDirOf(const QString& workTree)
+{
+    const QString dotGit = workTree + QStringLiteral("/.git");
+    if(QFileInfo(dotGit).isDir())
+        return dotGit;
+
+    QFile file(dotGit);
+    if(!file.open(QIODevice::ReadOnly))
+        return QString();
+    const QByteArray line = file.readLine().trimmed();
+    if(!line.startsWith("gitdir:"))
+        return QString();
+    return QDir(workTree).absoluteFilePath(QFile::decodeName(line.mid(7).trimmed()));
+}
+
+// Repositories using SHA-256 say so in their shared config.
+int hashSizeOf(const QString& gitDir)
+{
+    QString commonDir = gitDir;
+    QFile commonDirFile(gitDir + QStringLiteral("/commondir"));
+    if(commonDirFile.open(QIODevice::ReadOnly))
+        commonDir = QDir(gitDir).absoluteFilePath(QFile::decodeName(commonDirFile.readLine().trimmed()));
+
+    QFile config(commonDir + QStringLiteral("/config"));
+    if(!config.open(QIODevice::ReadOnly))
+        return 20;
+    static const QRegularExpression sha256(QStringLiteral("^\\s*objectformat\\s*=\\s*sha256\\s*$"),
+                                           QRegularExpression::CaseInsensitiveOption | QRegularExpression::MultilineOption);
+    return sha256.match(QString::fromUtf8(config.readAll())).hasMatch() ? 32 : 20;
+}
+} // namespace
+
+bool GitIndex::load(const QByteArray& data, const int hashSize, const quint32 indexSeconds, const quint32 indexNanoseconds)
+{
+    mEntries.clear();
+
+    Reader reader(data);
+    quint32 version = 0, count = 0;
+    if(!data.startsWith("DIRC"))
+        return false;
+    reader.setPosition(4);
+    if(!reader.read32(version) || version < 2 || version > 4 || !reader.read32(count))
+        return false;
+
+    mEntries.reserve((int)std::min<quint32>(count, (quint32)(data.size() / (statDataSize + hashSize))));
+    QByteArray previousName;
+    for(quint32 i = 0; i < count; ++i)
+    {
+        const qint64 start = reader.position();
+        Entry entry;
+        quint32 unused = 0, flags = 0, extendedFlags = 0;
+        if(!reader.read32(entry.ctimeSeconds) || !reader.read32(entry.ctimeNanoseconds) ||
+           !reader.read32(entry.mtimeSeconds) || !reader.read32(entry.mtimeNanoseconds) ||
+           !reader.read32(unused) || !reader.read32(entry.inode) || !reader.read32(entry.mode) ||
+           !reader.read32(unused) || !reader.read32(unused) || !reader.read32(entry.size) ||
+           !reader.readBytes(hashSize, entry.id) || !reader.read16(flags))
+            return false;
+        if(version >= 3 && (flags & extendedFlag) != 0 && !reader.read16(extendedFlags))
+            return false;
+
+        QByteArray name;
+        if(version == 4)
+        {
+            quint64 strip = 0;
+            QByteArray suffix;
+            if(!reader.readVarint(strip) || strip > (quint64)previousName.size() || !reader.readString(suffix))
+                return false;
+            name = previousName.left(previousName.size() - (int)strip) + suffix;
+        }
+        else
+        {
+            const qint64 nameStart = reader.position();
+            const quint32 length = flags & nameLengthMask;
+            if(length < nameLengthMask)
+            {
+                if(!reader.readBytes(length, name))
+                    return false;
+            }
+            else if(!reader.readString(name))
+                return false;
+
+            // Entries are padded with one to eight NULs to a multiple of eight bytes.
+            const qint64 nameLength = name.size();
+            reader.setPosition(start + ((nameStart - start + nameLength + 8) & ~(qint64)7));
+            if(reader.position() > data.size())
+                return false;
+        }
+        previousName = name;
+
+        // Conflicts have no single object yet.
+        if((flags & stageMask) != 0)
+        {
+            mEntries.remove(name);
+            continue;
+        }
+
+        const bool bRacy = entry.mtimeSeconds > indexSeconds ||
+                           (entry.mtimeSeconds == indexSeconds && entry.mtimeNanoseconds >= indexNanoseconds);
+        entry.bTrusted = indexSeconds != 0 && !bRacy && (entry.mode & fileTypeMask) == regularFileMode &&
+                         (flags & assumeValidFlag) == 0 && (extendedFlags & (skipWorktreeFlag | intentToAddFlag)) == 0;
+        mEntries.insert(name, entry);
+    }
+    return true;
+}
+
+const GitIndex::Entry* GitIndex::find(const QByteArray& path) const
+{
+    const QHash<QByteArray, Entry>::const_iterator it = mEntries.constFind(path);
+    return it != mEntries.constEnd() ? &*it : nullptr;
+}
+
+bool GitIndex::objectId(const QString& filePath, QByteArray& id)
+{
+#ifdef Q_OS_WIN
+    // The index holds no inodes there and times are stored differently.
+    Q_UNUSED(filePath);
+    Q_UNUSED(id);
+    return false;
+#else
+    QString path = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+    struct stat st;
+    if(::lstat(QFile::encodeName(path).constData(), &st) != 0)
+        return false;
+    // "git difftool --dir-diff" links to the files of the work tree.
+    if(S_ISLNK(st.st_mode))
+    {
+        path = QFileInfo(path).canonicalFilePath();
+        if(path.isEmpty() || ::lstat(QFile::encodeName(path).constData(), &st) != 0)
+            return false;
+    }
+    if(!S_ISREG(st.st_mode))
+        return false;
+
+    std::shared_ptr<const GitIndex> pIndex;
+    QString workTree;
+    {
+        QMutexLocker locker(&gMutex);
+        workTree = workTreeOf(QFileInfo(path).path());
+        if(workTree.isEmpty())
+            return false;
+
+        LoadedIndex& loaded = gIndexes[workTree];
+        const QString gitDir = gitDirOf(workTree);
+        struct stat indexStat;
+        if(gitDir.isEmpty() || ::stat(QFile::encodeName(gitDir + QStringLiteral("/index")).constData(), &indexStat) != 0)
+            return false;
+
+        if(loaded.size != (qint64)indexStat.st_size || loaded.seconds != (qint64)modificationTime(indexStat).tv_sec ||
+           loaded.nanoseconds != (qint64)modificationTime(indexStat).tv_nsec)
+        {
+            QFile indexFile(gitDir + QStringLiteral("/index"));
+            std::shared_ptr<GitIndex> pNewIndex = std::make_shared<GitIndex>();
+            if(!indexFile.open(QIODevice::ReadOnly) ||
+               !pNewIndex->load(indexFile.readAll(), hashSizeOf(gitDir), (quint32)modificationTime(indexStat).tv_sec, (quint32)modificationTime(indexStat).tv_nsec))
+            {
+                qCInfo(kdiffFileAccess) << "Unable to read git index of" << workTree;
+                pNewIndex.reset();
+            }
+            else
+                qCInfo(kdiffFileAccess) << "Read git index of" << workTree << "with" << pNewIndex->count() << "entries";
+
+            loaded.size = (qint64)indexStat.st_size;
+            loaded.seconds = (qint64)modificationTime(indexStat).tv_sec;
+            loaded.nanoseconds = (qint64)modificationTime(indexStat).tv_nsec;
+            loaded.index = pNewIndex;
+        }
+        pIndex = loaded.index;
+    }
+    if(pIndex == nullptr)
+        return false;
+
+    const Entry* pEntry = pIndex->find(QFile::encodeName(path.mid(workTree.size() + 1)));
+    // Git keeps the low 32 bits of each value.
+    if(pEntry == nullptr || !pEntry->bTrusted || pEntry->size != (quint32)st.st_size || pEntry->inode != (quint32)st.st_ino ||
+       pEntry->mtimeSeconds != (quint32)modificationTime(st).tv_sec || pEntry->mtimeNanoseconds != (quint32)modificationTime(st).tv_nsec ||
+       pEntry->ctimeSeconds != (quint32)changeTime(st).tv_sec || pEntry->ctimeNanoseconds != (quint32)changeTime(st).tv_nsec)
+        return false;
+
+    id = pEntry->id;
+    return true;
+#endif
+}
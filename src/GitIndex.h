@@ -0,0 +1,65 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef GITINDEX_H
+#define GITINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/*
+    Object IDs of tracked files, read from the index of their git work tree.
+
+    Git records size, times and inode of every file it has hashed. While these still match, the
+    file holds the blob the index names, which is what git status relies on as well. Two such
+    files are equal exactly if their IDs are, neither has to be read. Entries changed within the
+    same time stamp as the index was written can't be told apart from unchanged ones and are not
+    used, git hashes those again too.
+
+    Index versions 2 to 4 are read, extensions are skipped. Only the file stat cache is used,
+    nothing reads the object database.
+*/
+class GitIndex
+{
+  public:
+    struct Entry
+    {
+        quint32 ctimeSeconds = 0;
+        quint32 ctimeNanoseconds = 0;
+        quint32 mtimeSeconds = 0;
+        quint32 mtimeNanoseconds = 0;
+        quint32 inode = 0;
+        quint32 mode = 0;
+        quint32 size = 0;
+        QByteArray id;
+        bool bTrusted = false; // Regular file, not racy, not marked assume-unchanged or skip-worktree.
+    };
+
+    /*
+        Parses the content of an index file. indexSeconds and indexNanoseconds are the
+        modification time of the index file, hashSize is 20 for SHA-1 and 32 for SHA-256.
+    */
+    bool load(const QByteArray& data, const int hashSize, const quint32 indexSeconds, const quint32 indexNanoseconds);
+
+    // path is relative to the work tree, with '/' as separator and encoded like on disk.
+    [[nodiscard]] const Entry* find(const QByteArray& path) const;
+    [[nodiscard]] qint64 count() const { return mEntries.size(); }
+
+    /*
+        The object ID of a local file, if it is tracked in its work tree and unchanged since git
+        last hashed it. May be called from several threads, indexes are cached until they change.
+    */
+    static bool objectId(const QString& filePath, QByteArray& id);
+
+  private:
+    QHash<QByteArray, Entry> mEntries;
+};
+
+#endif
@@ -0,0 +1,134 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "GitObjectReader.h"
+
+#include "Logging.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+
+#include <KLocalizedString>
+
+namespace {
+constexpr qint64 maxCacheSize = 256 * 1024 * 1024;
+
+QMutex gCacheMutex;
+// Keyed by repository folder and object name.
+QHash<QString, QByteArray> gCache;
+qint64 gCacheSize = 0;
+
+QString cacheKey(const QString& objectName)
+{
+    return QDir::currentPath() + '\n' + objectName;
+}
+
+bool runGit(const QStringList& arguments, QByteArray& output, QString& errorString)
+{
+    QProcess git;
+    git.start(QStringLiteral("git"), arguments);
+    if(!git.waitForStarted())
+    {
+        errorString = git.errorString();
+        return false;
+    }
+    git.closeWriteChannel();
+    git.waitForFinished(-1);
+    if(git.exitStatus() != QProcess::NormalExit || git.exitCode() != 0)
+    {
+        errorString = QString::fromLocal8Bit(git.readAllStandardError()).trimmed();
+        return false;
+    }
+    output = git.readAllStandardOutput();
+    return true;
+}
+} // namespace
+
+bool GitObjectReader::looksLikeObjectName(const QString& name)
+{
+    const int colon = name.indexOf(':');
+    // Urls and drive letters have their own meaning.
+    return colon > 0 && !name.contains(QLatin1String("://")) && !(colon == 1 && name[0].isLetter()) &&
+           !name.startsWith('/') && !name.startsWith(QLatin1String(scheme) + ':');
+}
+
+bool GitObjectReader::isObjectName(const QString& name)
+{
+    if(!looksLikeObjectName(name) || QFileInfo::exists(name))
+        return false;
+
+    {
+        QMutexLocker locker(&gCacheMutex);
+        if(gCache.contains(cacheKey(name)))
+            return true;
+    }
+
+    QByteArray type;
+    QString errorString;
+    return runGit({QStringLiteral("cat-file"), QStringLiteral("-t"), QStringLiteral("--"), name}, type, errorString) &&
+           type.trimmed() == "blob";
+}
+
+QUrl GitObjectReader::toUrl(const QString& objectName)
+{
+    QUrl url;
+    url.setScheme(QLatin1String(scheme));
+    url.setPath(objectName);
+    return url;
+}
+
+QString GitObjectReader::objectName(const QUrl& url)
+{
+    return url.path();
+}
+
+bool GitObjectReader::readBlob(const QString& objectName, QByteArray& data, QString& errorString)
+{
+    const QString key = cacheKey(objectName);
+    {
+        QMutexLocker locker(&gCacheMutex);
+        const QHash<QString, QByteArray>::const_iterator it = gCache.constFind(key);
+        if(it != gCache.constEnd())
+        {
+            data = *it;
+            return true;
+        }
+    }
+
+    if(!runGit({QStringLiteral("cat-file"), QStringLiteral("blob"), QStringLiteral("--"), objectName}, data, errorString))
+    {
+        errorString = i18n("Reading %1 from git failed: %2", objectName, errorString);
+        qCInfo(kdiffFileAccess) << errorString;
+        return false;
+    }
+
+    QMutexLocker locker(&gCacheMutex);
+    if(gCacheSize + data.size() > maxCacheSize)
+    {
+        gCache.clear();
+        gCacheSize = 0;
+    }
+    if(data.size() <= maxCacheSize)
+    {
+        gCache.insert(key, data);
+        gCacheSize += data.size();
+    }
+    return true;
+}
+
+void GitObjectReader::clearCache()
+{
+    QMutexLocker locker(&gCacheMutex);
+    gCache.clear();
+    gCacheSize = 0;
+}
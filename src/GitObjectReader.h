@@ -0,0 +1,44 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef GITOBJECTREADER_H
+#define GITOBJECTREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+
+/*
+    Files of git revisions given as "rev:path", the way git show names them.
+
+    The blob is read from the repository of the current folder straight into memory. git itself
+    unpacks loose and packed objects and applies deltas, nothing is written to temp files. Inputs
+    are kept as "git:rev:path" urls, FileAccess serves them from memory. Blobs stay cached until
+    a limit is reached, the same name is usually opened several times while loading.
+*/
+class GitObjectReader
+{
+  public:
+    static constexpr char scheme[] = "git";
+
+    // True for a "rev:path" that isn't a local file and names a blob in the current repository.
+    [[nodiscard]] static bool isObjectName(const QString& name);
+    [[nodiscard]] static QUrl toUrl(const QString& objectName);
+    [[nodiscard]] static QString objectName(const QUrl& url);
+
+    static bool readBlob(const QString& objectName, QByteArray& data, QString& errorString);
+
+    static void clearCache();
+
+  private:
+    // Only names that look like it are passed to git.
+    [[nodiscard]] static bool looksLikeObjectName(const QString& name);
+};
+
+#endif
@@ -0,0 +1,159 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "GlobMatcher.h"
+
+#include <algorithm>
+
+void GlobMatcher::StringSet::insert(const QString& s)
+{
+    strings.insert(s);
+    foldedStrings.insert(s.toCaseFolded());
+
+    const auto it = std::lower_bound(lengths.begin(), lengths.end(), s.length());
+    if(it == lengths.end() || *it != s.length())
+        lengths.insert(it, s.length());
+}
+
+void GlobMatcher::StringSet::clear()
+{
+    strings.clear();
+    foldedStrings.clear();
+    lengths.clear();
+}
+
+bool GlobMatcher::addPattern(const QString& pattern)
+{
+    if(pattern.isEmpty())
+        return true;
+
+    const QtSizeType firstStar = pattern.indexOf(QChar('*'));
+    const bool bOtherMeta = pattern.contains(QChar('?')) || pattern.contains(QChar('[')) ||
+                            pattern.contains(QChar('\\')) || pattern.contains(QChar('/'));
+
+    if(firstStar < 0 && !bOtherMeta)
+    {
+        addExact(pattern);
+        return true;
+    }
+
+    // A '*' doesn't match a '/', patterns with one are left to the expression.
+    if(!bOtherMeta && pattern.lastIndexOf(QChar('*')) == firstStar)
+    {
+        // A lone "*", the default file pattern, is the empty suffix and matches every name.
+        if(firstStar == 0)
+        {
+            addSuffix(pattern.mid(1));
+            return true;
+        }
+        if(firstStar == pattern.length() - 1)
+        {
+            addPrefix(pattern.left(firstStar));
+            return true;
+        }
+    }
+
+    return addGlob(pattern);
+}
+
+void GlobMatcher::addExact(const QString& text)
+{
+    mExact.insert(text);
+}
+
+void GlobMatcher::addPrefix(const QString& prefix)
+{
+    mPrefixes.insert(prefix);
+}
+
+void GlobMatcher::addSuffix(const QString& suffix)
+{
+    mSuffixes.insert(suffix);
+}
+
+bool GlobMatcher::addGlob(const QString& pattern)
+{
+    const QString regExp = QRegularExpression::wildcardToRegularExpression(pattern);
+    // An invalid part would make the combined expression fail for all patterns.
+    if(!QRegularExpression(regExp).isValid())
+        return false;
+
+    mGlobs.append("(?:" + regExp + ')');
+    mHasGlobExpression = false;
+    return true;
+}
+
+void GlobMatcher::compile()
+{
+    if(mHasGlobExpression || mGlobs.isEmpty())
+        return;
+
+    const QString combined = mGlobs.join('|');
+    mGlobExpression = QRegularExpression(combined, QRegularExpression::UseUnicodePropertiesOption);
+    mCaseInsensitiveGlobExpression = QRegularExpression(combined, QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
+    mHasGlobExpression = true;
+}
+
+void GlobMatcher::clear()
+{
+    mExact.clear();
+    mPrefixes.clear();
+    mSuffixes.clear();
+    mGlobs.clear();
+    mGlobExpression = QRegularExpression();
+    mCaseInsensitiveGlobExpression = QRegularExpression();
+    mHasGlobExpression = false;
+}
+
+bool GlobMatcher::isEmpty() const
+{
+    return mExact.isEmpty() && mPrefixes.isEmpty() && mSuffixes.isEmpty() && mGlobs.isEmpty();
+}
+
+bool GlobMatcher::containsPrefix(const StringSet& set, const QString& text, bool bCaseSensitive)
+{
+    const QSet<QString>& strings = bCaseSensitive ? set.strings : set.foldedStrings;
+    for(const QtSizeType length: set.lengths)
+    {
+        if(length > text.length())
+            break;
+        if(strings.contains(text.left(length)))
+            return true;
+    }
+    return false;
+}
+
+bool GlobMatcher::containsSuffix(const StringSet& set, const QString& text, bool bCaseSensitive)
+{
+    const QSet<QString>& strings = bCaseSensitive ? set.strings : set.foldedStrings;
+    for(const QtSizeType length: set.lengths)
+    {
+        if(length > text.length())
+            break;
+        if(strings.contains(text.right(length)))
+            return true;
+    }
+    return false;
+}
+
+bool GlobMatcher::matches(const QString& text, bool bCaseSensitive) const
+{
+    assert(mHasGlobExpression || mGlobs.isEmpty());
+
+    const QString key = bCaseSensitive ? text : text.toCaseFolded();
+    if((bCaseSensitive ? mExact.strings : mExact.foldedStrings).contains(key) ||
+       containsPrefix(mPrefixes, key, bCaseSensitive) || containsSuffix(mSuffixes, key, bCaseSensitive))
+        return true;
+
+    if(!mHasGlobExpression)
+        return false;
+
+    return (bCaseSensitive ? mGlobExpression : mCaseInsensitiveGlobExpression).match(text).hasMatch();
+}
@@ -0,0 +1,76 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#ifndef GLOBMATCHER_H
+#define GLOBMATCHER_H
+
+#include "TypeUtils.h"
+
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+/*
+    Matches file names against a set of wildcard patterns.
+
+    Most ignore patterns are plain names, "*.ext" or "name*". These are kept in hash sets, a lookup
+    costs one hash per distinct pattern length instead of a compare per pattern. Everything else is
+    joined into one regular expression, so a name is matched by a single expression no matter how
+    many such patterns there are.
+
+    compile() must be called after adding patterns and before matches(). matches() may then be used
+    from several threads.
+*/
+class GlobMatcher
+{
+  public:
+    // Sorts the pattern into one of the groups below. Returns false for an invalid pattern.
+    bool addPattern(const QString& pattern);
+
+    void addExact(const QString& text);
+    void addPrefix(const QString& prefix);
+    void addSuffix(const QString& suffix);
+    bool addGlob(const QString& pattern);
+
+    void compile();
+    void clear();
+
+    [[nodiscard]] bool isEmpty() const;
+    [[nodiscard]] bool matches(const QString& text, bool bCaseSensitive) const;
+
+  private:
+    struct StringSet
+    {
+        QSet<QString> strings;
+        QSet<QString> foldedStrings;
+        std::vector<QtSizeType> lengths; // Distinct lengths of the strings, sorted.
+
+        void insert(const QString& s);
+        void clear();
+        [[nodiscard]] bool isEmpty() const { return strings.isEmpty(); }
+    };
+
+    [[nodiscard]] static bool containsPrefix(const StringSet& set, const QString& text, bool bCaseSensitive);
+    [[nodiscard]] static bool containsSuffix(const StringSet& set, const QString& text, bool bCaseSensitive);
+
+    StringSet mExact;
+    StringSet mPrefixes;
+    StringSet mSuffixes;
+
+    QStringList mGlobs;
+    QRegularExpression mGlobExpression;
+    QRegularExpression mCaseInsensitiveGlobExpression;
+    bool mHasGlobExpression = false;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "HistorySortKey.h"
+
+#include <list>
+
+bool findParenthesesGroups(const QString& s, QStringList& sl)
+{
+    sl.clear();
+    int i = 0;
+    std::list<int> startPosStack;
+    int length = s.length();
+    for(i = 0; i < length; ++i)
+    {
+        if(s[i] == '\\' && i + 1 < length && (s[i + 1] == '\\' || s[i + 1] == '(' || s[i + 1] == ')'))
+        {
+            ++i;
+            continue;
+        }
+        if(s[i] == '(')
+        {
+            startPosStack.push_back(i);
+        }
+        else if(s[i] == ')')
+        {
+            if(startPosStack.empty())
+                return false; // Parentheses don't match
+            int startPos = startPosStack.back();
+            startPosStack.pop_back();
+            sl.push_back(s.mid(startPos + 1, i - startPos - 1));
+        }
+    }
+    return startPosStack.empty(); // false if parentheses don't match
+}
+
+HistorySortKey::HistorySortKey(const QString& keyOrder, const QStringList& parenthesesGroupList)
+{
+    const QStringList keyOrderList = keyOrder.split(',');
+
+    for(const QString& keyIt: keyOrderList)
+    {
+        if(keyIt.isEmpty())
+            continue;
+        bool bOk = false;
+        int groupIdx = keyIt.toInt(&bOk);
+        if(!bOk || groupIdx < 0 || groupIdx > parenthesesGroupList.size())
+            continue;
+
+        Group group{groupIdx, QStringList()};
+        if(groupIdx > 0)
+        {
+            const QString& groupRegExp = parenthesesGroupList[groupIdx - 1];
+            // Assume that the groupRegExp consists of something like "Jan|Feb|Mar|Apr"
+            if(groupRegExp.indexOf('|') >= 0 && groupRegExp.indexOf('(') < 0)
+                group.alternatives = groupRegExp.split('|');
+        }
+        mGroups.push_back(group);
+    }
+}
+
+QString HistorySortKey::calc(const QRegularExpressionMatch& regExprMatch) const
+{
+    QString key;
+
+    for(const Group& group: mGroups)
+    {
+        QString s = regExprMatch.captured(group.idx);
+        if(group.idx == 0)
+        {
+            key += s + ' ';
+            continue;
+        }
+
+        if(group.alternatives.isEmpty())
+        {
+            bool bOk = false;
+            int i = s.toInt(&bOk);
+            if(bOk && i >= 0 && i < 10000)
+            {
+                s += QString(4 - s.size(), '0'); // This should help for correct sorting of numbers.
+            }
+            key += s + ' ';
+        }
+        else
+        {
+            // s is the string that managed to match.
+            // Now we want to know at which position it occurred. e.g. Jan=0, Feb=1, Mar=2, etc.
+            int idx = group.alternatives.indexOf(s);
+            if(idx >= 0)
+            {
+                QString sIdx;
+                sIdx.setNum(idx);
+                assert(sIdx.size() <= 2);
+                sIdx += QString(2 - sIdx.size(), '0'); // Up to 99 words in the groupRegExp (more than 12 aren't expected)
+                key += sIdx + ' ';
+            }
+        }
+    }
+    return key;
+}
@@ -0,0 +1,47 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef HISTORYSORTKEY_H
+#define HISTORYSORTKEY_H
+
+#include <vector>
+
+#include <QRegularExpressionMatch>
+#include <QString>
+#include <QStringList>
+
+bool findParenthesesGroups(const QString& s, QStringList& sl);
+
+/*
+    Builds the sort key of a history entry from the groups captured by the entry start expression.
+
+    The key order and the groups of the expression are parsed once, a history section may have
+    thousands of entries that all need a key.
+*/
+class HistorySortKey
+{
+  public:
+    // parenthesesGroupList is the result of findParenthesesGroups for the entry start expression.
+    HistorySortKey(const QString& keyOrder, const QStringList& parenthesesGroupList);
+
+    [[nodiscard]] QString calc(const QRegularExpressionMatch& regExprMatch) const;
+
+  private:
+    struct Group
+    {
+        int idx;
+        // Set if the group is a plain list like "Jan|Feb|Mar", the key then is the position of the match.
+        QStringList alternatives;
+    };
+
+    std::vector<Group> mGroups;
+};
+
+#endif
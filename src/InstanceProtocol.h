@@ -0,0 +1,35 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef INSTANCEPROTOCOL_H
+#define INSTANCEPROTOCOL_H
+
+#include <QDataStream>
+#include <QString>
+#include <QtGlobal>
+
+/*
+    What kdiff3-client and a kdiff3 started with --server exchange over a local socket.
+    The client sends its working folder and command line, the server answers with the
+    exit code of the window it opened once that is closed.
+*/
+namespace InstanceProtocol {
+
+constexpr quint32 magic = 0x4B443301; // "KD3" and the protocol version.
+constexpr QDataStream::Version streamVersion = QDataStream::Qt_5_12;
+
+[[nodiscard]] inline QString socketName()
+{
+    // One server per user, local sockets are not separated by user on every platform.
+    return QStringLiteral("kdiff3-") + qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+}
+} // namespace InstanceProtocol
+
+#endif
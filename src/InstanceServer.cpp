@@ -0,0 +1,129 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "InstanceServer.h"
+
+#include "defmac.h"
+#include "InstanceProtocol.h"
+#include "kdiff3_shell.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QLocalSocket>
+
+InstanceServer::InstanceServer(QObject* pParent):
+    QObject(pParent)
+{
+    mServer.setSocketOptions(QLocalServer::UserAccessOption);
+    chk_connect(&mServer, &QLocalServer::newConnection, this, &InstanceServer::slotNewConnection);
+}
+
+bool InstanceServer::listen()
+{
+    const QString name = InstanceProtocol::socketName();
+    if(mServer.listen(name))
+        return true;
+
+    // A crashed server leaves its socket file behind on unix.
+    if(mServer.serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if(probe.waitForConnected(500))
+        return false;
+
+    QLocalServer::removeServer(name);
+    return mServer.listen(name);
+}
+
+void InstanceServer::slotNewConnection()
+{
+    while(QLocalSocket* pSocket = mServer.nextPendingConnection())
+    {
+        chk_connect(pSocket, &QLocalSocket::readyRead, this, &InstanceServer::slotReadRequest);
+        chk_connect(pSocket, &QLocalSocket::disconnected, pSocket, &QObject::deleteLater);
+    }
+}
+
+void InstanceServer::slotReadRequest()
+{
+    QLocalSocket* pSocket = qobject_cast<QLocalSocket*>(sender());
+    if(pSocket == nullptr)
+        return;
+
+    QDataStream in(pSocket);
+    in.setVersion(InstanceProtocol::streamVersion);
+
+    in.startTransaction();
+    quint32 magic = 0;
+    Request request;
+    in >> magic >> request.workingDir >> request.arguments;
+    if(!in.commitTransaction())
+        return; // Wait for the rest.
+
+    disconnect(pSocket, &QLocalSocket::readyRead, this, &InstanceServer::slotReadRequest);
+    if(magic != InstanceProtocol::magic || request.arguments.isEmpty())
+    {
+        reply(pSocket, 1);
+        return;
+    }
+
+    request.socket = pSocket;
+    mQueue.push_back(std::move(request));
+    if(mCurrentShell == nullptr)
+        startNext();
+}
+
+void InstanceServer::startNext()
+{
+    while(!mQueue.empty())
+    {
+        const Request request = mQueue.front();
+        mQueue.pop_front();
+        // The client may have given up waiting.
+        if(request.socket == nullptr)
+            continue;
+
+        QDir::setCurrent(request.workingDir);
+
+        QCommandLineParser* pParser = KDiff3Shell::getParser().get();
+        if(!pParser->parse(request.arguments))
+        {
+            reply(request.socket, 1);
+            continue;
+        }
+
+        mCurrentSocket = request.socket;
+        mCurrentShell = new KDiff3Shell();
+        mCurrentShell->setServed(true);
+        chk_connect(mCurrentShell.data(), &KDiff3Shell::finished, this, &InstanceServer::slotFinished);
+        return;
+    }
+}
+
+void InstanceServer::slotFinished(int exitCode)
+{
+    if(mCurrentSocket != nullptr)
+        reply(mCurrentSocket, exitCode);
+
+    mCurrentSocket = nullptr;
+    mCurrentShell = nullptr;
+    startNext();
+}
+
+void InstanceServer::reply(QLocalSocket* pSocket, const int exitCode)
+{
+    QDataStream out(pSocket);
+    out.setVersion(InstanceProtocol::streamVersion);
+    out << (qint32)exitCode;
+    pSocket->flush();
+    pSocket->disconnectFromServer();
+}
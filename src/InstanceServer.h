@@ -0,0 +1,63 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef INSTANCESERVER_H
+#define INSTANCESERVER_H
+
+#include <deque>
+
+#include <QLocalServer>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+
+class KDiff3Shell;
+class QLocalSocket;
+
+/*
+    Keeps kdiff3 resident so kdiff3-client can skip the startup cost. Every request is run as if
+    kdiff3 had been started with its command line and gets its own main window.
+
+    Requests are served one at a time. Several main windows would share global state like
+    Diff3Line::m_pDiffBufferInfo, so the next request waits until the current window is closed.
+*/
+class InstanceServer: public QObject
+{
+    Q_OBJECT
+  public:
+    explicit InstanceServer(QObject* pParent = nullptr);
+
+    bool listen();
+    [[nodiscard]] QString errorString() const { return mServer.errorString(); }
+
+  private Q_SLOTS:
+    void slotNewConnection();
+    void slotReadRequest();
+    void slotFinished(int exitCode);
+
+  private:
+    struct Request
+    {
+        QPointer<QLocalSocket> socket;
+        QString workingDir;
+        QStringList arguments;
+    };
+
+    void startNext();
+    static void reply(QLocalSocket* pSocket, const int exitCode);
+
+    QLocalServer mServer;
+    std::deque<Request> mQueue;
+    QPointer<QLocalSocket> mCurrentSocket;
+    QPointer<KDiff3Shell> mCurrentShell;
+};
+
+#endif
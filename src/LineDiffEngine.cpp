@@ -0,0 +1,453 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "LineDiffEngine.h"
+
+#include "diff.h"
+#include "gnudiff_diff.h"
+#include "options.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+namespace {
+
+class GnuDiffEngine: public LineDiffEngine
+{
+  public:
+    explicit GnuDiffEngine(const DiffSettings& settings):
+        mSettings(settings) {}
+
+    void diff(const LineDataVector& v1, const size_t index1, const LineType size1,
+              const LineDataVector& v2, const size_t index2, const LineType size2, DiffList& diffList) override
+    {
+        // GnuDiff splits the lines itself from one buffer. Very large inputs have several.
+        if(v1[index1].getBuffer() != v1[index1 + size1 - 1].getBuffer() || v2[index2].getBuffer() != v2[index2 + size2 - 1].getBuffer())
+        {
+            if(mpSplitBufferEngine == nullptr)
+                mpSplitBufferEngine = LineDiffEngine::create(mSettings.withLineDiffAlgorithm(LineDiffAlgorithm::histogram));
+            mpSplitBufferEngine->diff(v1, index1, size1, v2, index2, size2, diffList);
+            mbUsedSplitBufferEngine = true;
+            return;
+        }
+        mbUsedSplitBufferEngine = false;
+
+        GnuDiff::comparison comparisonInput;
+        memset(&comparisonInput, 0, sizeof(comparisonInput));
+        comparisonInput.parent = nullptr;
+        comparisonInput.file[0].buffer = v1[index1].getBuffer()->unicode() + v1[index1].getOffset();                                     //ptr to buffer
+        comparisonInput.file[0].buffered = (v1[index1 + size1 - 1].getOffset() + v1[index1 + size1 - 1].size() - v1[index1].getOffset()); // size of buffer
+        comparisonInput.file[1].buffer = v2[index2].getBuffer()->unicode() + v2[index2].getOffset();                                     //ptr to buffer
+        comparisonInput.file[1].buffered = (v2[index2 + size2 - 1].getOffset() + v2[index2 + size2 - 1].size() - v2[index2].getOffset()); // size of buffer
+        // Hashed by their line matching fingerprints, see LineData::lineMatchFingerprint().
+        comparisonInput.file[0].lines = &v1[index1];
+        comparisonInput.file[0].line_count = size1;
+        comparisonInput.file[1].lines = &v2[index2];
+        comparisonInput.file[1].line_count = size2;
+
+        mGnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
+        mGnuDiff.bIgnoreWhiteSpace = true;
+        mGnuDiff.bIgnoreNumbers = mSettings.ignoreNumbers();
+        mGnuDiff.minimal = mSettings.tryHard();
+        mGnuDiff.parallel = mSettings.parallelDiff();
+        mGnuDiff.deadline = mSettings.deadline();
+        mGnuDiff.ignore_case = false;
+        mGnuDiff.diff_2_files(&comparisonInput, mScript);
+
+        LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
+        LineRef currentLine1 = 0;
+        LineRef currentLine2 = 0;
+        for(const GnuDiff::change& e: mScript)
+        {
+            Diff d((LineType)(e.line0 - currentLine1), e.deleted, e.inserted);
+            assert(d.numberOfEquals() == e.line1 - currentLine2);
+
+            currentLine1 += LineRef((quint64)d.numberOfEquals() + d.diff1());
+            currentLine2 += LineRef((quint64)d.numberOfEquals() + d.diff2());
+            assert(currentLine1 <= size1 && currentLine2 <= size2);
+            diffList.push_back(d);
+        }
+
+        if(diffList.empty())
+        {
+            qint32 numofEquals = std::min(size1, size2);
+            Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
+
+            diffList.push_back(d);
+        }
+        else
+        {
+            diffList.front().adjustNumberOfEquals(equalLinesAtStart);
+            currentLine1 += equalLinesAtStart;
+            currentLine2 += equalLinesAtStart;
+
+            LineType nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
+            if(nofEquals == 0)
+            {
+                diffList.back().adjustDiff1(size1 - currentLine1);
+                diffList.back().adjustDiff2(size2 - currentLine2);
+            }
+            else
+            {
+                Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
+                diffList.push_back(d);
+            }
+        }
+    }
+
+    [[nodiscard]] bool isApproximate() const override { return !mbUsedSplitBufferEngine && mGnuDiff.deadlinePassed(); }
+
+  private:
+    const DiffSettings mSettings;
+    GnuDiff mGnuDiff;
+    // For ranges spanning two buffers.
+    std::unique_ptr<LineDiffEngine> mpSplitBufferEngine;
+    bool mbUsedSplitBufferEngine = false;
+    // Kept between calls, so its capacity is reused.
+    std::vector<GnuDiff::change> mScript;
+};
+
+/*
+    Base for engines working on whole lines. Every line is mapped to an id so that lines which are
+    equal apart from white space (and numbers if ignored) share an id, the same rule GnuDiff uses.
+    Subclasses split ranges around matching lines until no range is left.
+*/
+class SequenceDiffEngine: public LineDiffEngine
+{
+  public:
+    explicit SequenceDiffEngine(const DiffSettings& settings):
+        mSettings(settings) {}
+
+    void diff(const LineDataVector& v1, const size_t index1, const LineType size1,
+              const LineDataVector& v2, const size_t index2, const LineType size2, DiffList& diffList) override
+    {
+        IdTable ids;
+        ids.byFingerprint.reserve(size1 + size2);
+        mA = toIds(v1, index1, size1, ids);
+        mB = toIds(v2, index2, size2, ids);
+        mMatches.clear();
+
+        std::vector<Range> work = {{0, size1, 0, size2}};
+        while(!work.empty())
+        {
+            Range range = work.back();
+            work.pop_back();
+
+            trim(range);
+            if(range.aBegin < range.aEnd && range.bBegin < range.bEnd)
+                split(range, work);
+        }
+
+        // Ranges were processed out of order, the matches are increasing in both files once sorted.
+        std::sort(mMatches.begin(), mMatches.end());
+        toDiffList(size1, size2, diffList);
+    }
+
+  protected:
+    struct Range
+    {
+        LineType aBegin;
+        LineType aEnd;
+        LineType bBegin;
+        LineType bEnd;
+    };
+
+    // Records matching lines of range and pushes what remains to work.
+    virtual void split(const Range& range, std::vector<Range>& work) = 0;
+
+    // Histogram step, also used as fall back by the patience engine.
+    void histogramSplit(const Range& range, std::vector<Range>& work)
+    {
+        constexpr qint32 maxChainLength = 64;
+
+        QHash<qint32, std::vector<LineType>> occurrences;
+        for(LineType i = range.aBegin; i < range.aEnd; ++i)
+            occurrences[mA[i]].push_back(i);
+
+        LineType bestA = 0, bestB = 0, bestLength = 0;
+        size_t bestCount = 0;
+
+        // Lines that are too common are skipped unless nothing else matches.
+        for(const size_t chainLimit: {(size_t)maxChainLength, (size_t)limits<qint32>::max()})
+        {
+            bool bSkipped = false;
+            for(LineType j = range.bBegin; j < range.bEnd;)
+            {
+                const auto it = occurrences.constFind(mB[j]);
+                if(it == occurrences.constEnd() || it->size() > chainLimit)
+                {
+                    bSkipped = bSkipped || it != occurrences.constEnd();
+                    ++j;
+                    continue;
+                }
+
+                LineType nextJ = j + 1;
+                for(const LineType i: *it)
+                {
+                    LineType aStart = i, bStart = j;
+                    while(aStart > range.aBegin && bStart > range.bBegin && mA[aStart - 1] == mB[bStart - 1])
+                    {
+                        --aStart;
+                        --bStart;
+                    }
+
+                    LineType aStop = i + 1, bStop = j + 1;
+                    while(aStop < range.aEnd && bStop < range.bEnd && mA[aStop] == mB[bStop])
+                    {
+                        ++aStop;
+                        ++bStop;
+                    }
+
+                    size_t count = it->size();
+                    for(LineType k = aStart; k < aStop; ++k)
+                        count = std::min(count, occurrences.constFind(mA[k])->size());
+
+                    if(bestLength == 0 || count < bestCount || (count == bestCount && aStop - aStart > bestLength))
+                    {
+                        bestA = aStart;
+                        bestB = bStart;
+                        bestLength = aStop - aStart;
+                        bestCount = count;
+                    }
+                    nextJ = std::max(nextJ, bStop);
+                }
+                j = nextJ;
+            }
+
+            if(bestLength > 0 || !bSkipped)
+                break;
+        }
+
+        // Nothing in common, the whole range is one change.
+        if(bestLength == 0)
+            return;
+
+        for(LineType k = 0; k < bestLength; ++k)
+            mMatches.emplace_back(bestA + k, bestB + k);
+
+        work.push_back({range.aBegin, bestA, range.bBegin, bestB});
+        work.push_back({bestA + bestLength, range.aEnd, bestB + bestLength, range.bEnd});
+    }
+
+    std::vector<qint32> mA;
+    std::vector<qint32> mB;
+    std::vector<std::pair<LineType, LineType>> mMatches;
+
+  private:
+    // Lines sharing an id, found by their line matching fingerprint.
+    struct IdTable
+    {
+        QMultiHash<quint32, qint32> byFingerprint;
+        std::vector<const LineData*> firstLines; // Indexed by id.
+    };
+
+    std::vector<qint32> toIds(const LineDataVector& v, const size_t index, const LineType size, IdTable& ids) const
+    {
+        const bool bIgnoreNumbers = mSettings.ignoreNumbers();
+        std::vector<qint32> result;
+        result.reserve(size);
+
+        for(LineType i = 0; i < size; ++i)
+        {
+            const LineData& line = v[index + i];
+            const quint32 fingerprint = line.lineMatchFingerprint(bIgnoreNumbers);
+
+            qint32 id = -1;
+            for(auto it = ids.byFingerprint.constFind(fingerprint); it != ids.byFingerprint.constEnd() && it.key() == fingerprint; ++it)
+            {
+                if(LineData::lineMatchEqual(*ids.firstLines[*it], line, bIgnoreNumbers))
+                {
+                    id = *it;
+                    break;
+                }
+            }
+
+            if(id < 0)
+            {
+                id = (qint32)ids.firstLines.size();
+                ids.byFingerprint.insert(fingerprint, id);
+                ids.firstLines.push_back(&line);
+            }
+            result.push_back(id);
+        }
+
+        return result;
+    }
+
+    // Matches the common start and end of range.
+    void trim(Range& range)
+    {
+        while(range.aBegin < range.aEnd && range.bBegin < range.bEnd && mA[range.aBegin] == mB[range.bBegin])
+        {
+            mMatches.emplace_back(range.aBegin, range.bBegin);
+            ++range.aBegin;
+            ++range.bBegin;
+        }
+
+        while(range.aBegin < range.aEnd && range.bBegin < range.bEnd && mA[range.aEnd - 1] == mB[range.bEnd - 1])
+        {
+            --range.aEnd;
+            --range.bEnd;
+            mMatches.emplace_back(range.aEnd, range.bEnd);
+        }
+    }
+
+    void toDiffList(const LineType size1, const LineType size2, DiffList& diffList) const
+    {
+        LineType pos1 = 0, pos2 = 0;
+        Diff current(0, 0, 0);
+
+        for(const auto& match: mMatches)
+        {
+            if(match.first > pos1 || match.second > pos2)
+            {
+                current.adjustDiff1(match.first - pos1);
+                current.adjustDiff2(match.second - pos2);
+                diffList.push_back(current);
+                current = Diff(0, 0, 0);
+            }
+            current.adjustNumberOfEquals(1);
+            pos1 = match.first + 1;
+            pos2 = match.second + 1;
+        }
+
+        current.adjustDiff1(size1 - pos1);
+        current.adjustDiff2(size2 - pos2);
+        if(!current.isEmpty() || diffList.empty())
+            diffList.push_back(current);
+    }
+
+    const DiffSettings mSettings;
+};
+
+/*
+    Histogram diff as known from JGit and git: split at the longest common run of the least
+    frequent lines. Fast on big files with many unique lines.
+*/
+class HistogramDiffEngine: public SequenceDiffEngine
+{
+  public:
+    using SequenceDiffEngine::SequenceDiffEngine;
+
+  protected:
+    void split(const Range& range, std::vector<Range>& work) override { histogramSplit(range, work); }
+};
+
+/*
+    Patience diff: anchor on the longest increasing sequence of lines that occur exactly once in
+    both ranges. Falls back to the histogram step where there are no such lines.
+*/
+class PatienceDiffEngine: public SequenceDiffEngine
+{
+  public:
+    using SequenceDiffEngine::SequenceDiffEngine;
+
+  protected:
+    void split(const Range& range, std::vector<Range>& work) override
+    {
+        struct Slot
+        {
+            qint32 countA = 0;
+            qint32 countB = 0;
+            LineType posB = 0;
+        };
+
+        QHash<qint32, Slot> slots;
+        for(LineType i = range.aBegin; i < range.aEnd; ++i)
+            ++slots[mA[i]].countA;
+        for(LineType j = range.bBegin; j < range.bEnd; ++j)
+        {
+            const auto it = slots.find(mB[j]);
+            if(it != slots.end())
+            {
+                ++it->countB;
+                it->posB = j;
+            }
+        }
+
+        std::vector<std::pair<LineType, LineType>> unique;
+        for(LineType i = range.aBegin; i < range.aEnd; ++i)
+        {
+            const Slot& slot = slots[mA[i]];
+            if(slot.countA == 1 && slot.countB == 1)
+                unique.emplace_back(i, slot.posB);
+        }
+
+        // Longest increasing subsequence of the B positions, by patience sorting.
+        std::vector<size_t> tails;
+        std::vector<size_t> previous(unique.size());
+        for(size_t k = 0; k < unique.size(); ++k)
+        {
+            const auto pile = std::lower_bound(tails.begin(), tails.end(), unique[k].second,
+                                               [&unique](const size_t t, const LineType posB) { return unique[t].second < posB; });
+            previous[k] = pile == tails.begin() ? k : *(pile - 1);
+            if(pile == tails.end())
+                tails.push_back(k);
+            else
+                *pile = k;
+        }
+
+        if(tails.empty())
+        {
+            histogramSplit(range, work);
+            return;
+        }
+
+        std::vector<std::pair<LineType, LineType>> anchors;
+        for(size_t k = tails.back();; k = previous[k])
+        {
+            anchors.push_back(unique[k]);
+            if(previous[k] == k)
+                break;
+        }
+        std::reverse(anchors.begin(), anchors.end());
+
+        LineType a = range.aBegin, b = range.bBegin;
+        for(const auto& anchor: anchors)
+        {
+            mMatches.push_back(anchor);
+            work.push_back({a, anchor.first, b, anchor.second});
+            a = anchor.first + 1;
+            b = anchor.second + 1;
+        }
+        work.push_back({a, range.aEnd, b, range.bEnd});
+    }
+};
+
+} // namespace
+
+DiffSettings::DiffSettings(const Options& options):
+    mLineDiffAlgorithm((LineDiffAlgorithm)options.m_lineDiffAlgorithm),
+    mbTryHard(options.m_bTryHard),
+    mbIgnoreNumbers(options.m_bIgnoreNumbers),
+    mbCacheDiffResults(options.m_bCacheDiffResults)
+{
+}
+
+std::unique_ptr<LineDiffEngine> LineDiffEngine::create(const DiffSettings& settings)
+{
+    switch(settings.lineDiffAlgorithm())
+    {
+        case LineDiffAlgorithm::histogram:
+            return std::make_unique<HistogramDiffEngine>(settings);
+        case LineDiffAlgorithm::patience:
+            return std::make_unique<PatienceDiffEngine>(settings);
+        case LineDiffAlgorithm::gnuDiff:
+        default:
+            return std::make_unique<GnuDiffEngine>(settings);
+    }
+}
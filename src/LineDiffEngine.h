@@ -0,0 +1,101 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef LINEDIFFENGINE_H
+#define LINEDIFFENGINE_H
+
+#include "LineRef.h"
+
+#include <memory>
+
+#include <QDeadlineTimer>
+
+class DiffList;
+class LineDataVector;
+class Options;
+
+enum class LineDiffAlgorithm
+{
+    gnuDiff = 0,
+    histogram = 1,
+    patience = 2,
+};
+
+/*
+    The options line matching depends on, copied from Options when a comparison starts. Being a
+    plain value it can be passed to worker threads while the options change in the meantime.
+*/
+class DiffSettings
+{
+  public:
+    DiffSettings() = default;
+    explicit DiffSettings(const Options& options);
+
+    [[nodiscard]] LineDiffAlgorithm lineDiffAlgorithm() const { return mLineDiffAlgorithm; }
+    [[nodiscard]] bool tryHard() const { return mbTryHard; }
+    [[nodiscard]] bool ignoreNumbers() const { return mbIgnoreNumbers; }
+    [[nodiscard]] bool cacheDiffResults() const { return mbCacheDiffResults; }
+    // Large inputs are split over the global thread pool, the result is the same either way.
+    [[nodiscard]] bool parallelDiff() const { return mbParallelDiff; }
+    // GnuDiff settles for a longer result once this expired. Never expires unless set.
+    [[nodiscard]] QDeadlineTimer deadline() const { return mDeadline; }
+
+    // The same settings for another algorithm.
+    [[nodiscard]] DiffSettings withLineDiffAlgorithm(const LineDiffAlgorithm algorithm) const
+    {
+        DiffSettings settings = *this;
+        settings.mLineDiffAlgorithm = algorithm;
+        return settings;
+    }
+
+    [[nodiscard]] DiffSettings withParallelDiff(const bool bParallel) const
+    {
+        DiffSettings settings = *this;
+        settings.mbParallelDiff = bParallel;
+        return settings;
+    }
+
+    [[nodiscard]] DiffSettings withDeadline(const QDeadlineTimer deadline) const
+    {
+        DiffSettings settings = *this;
+        settings.mDeadline = deadline;
+        return settings;
+    }
+
+  private:
+    LineDiffAlgorithm mLineDiffAlgorithm = LineDiffAlgorithm::gnuDiff;
+    bool mbTryHard = false;
+    bool mbIgnoreNumbers = false;
+    bool mbCacheDiffResults = false;
+    bool mbParallelDiff = true;
+    QDeadlineTimer mDeadline{QDeadlineTimer::Forever};
+};
+
+/*
+    Line matching step of DiffList::runDiff. An engine builds a DiffList covering exactly size1 lines of
+    v1 starting at index1 and size2 lines of v2 starting at index2. Both ranges are non-empty.
+    Lines are compared ignoring white space, and numbers if the options say so.
+*/
+class LineDiffEngine
+{
+  public:
+    virtual ~LineDiffEngine() = default;
+
+    virtual void diff(const LineDataVector& v1, const size_t index1, const LineType size1,
+                      const LineDataVector& v2, const size_t index2, const LineType size2, DiffList& diffList) = 0;
+
+    // Whether the last diff() was cut short by the deadline of the settings.
+    [[nodiscard]] virtual bool isApproximate() const { return false; }
+
+    // Uses the algorithm the settings select.
+    [[nodiscard]] static std::unique_ptr<LineDiffEngine> create(const DiffSettings& settings);
+};
+
+#endif
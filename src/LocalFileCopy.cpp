@@ -0,0 +1,172 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "LocalFileCopy.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <cerrno>
+#include <memory>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX)
+namespace {
+class FileDescriptor
+{
+  public:
+    explicit FileDescriptor(int fd): mFd(fd) {}
+    ~FileDescriptor()
+    {
+        if(mFd >= 0)
+            ::close(mFd);
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    [[nodiscard]] int get() const { return mFd; }
+    [[nodiscard]] bool isValid() const { return mFd >= 0; }
+
+    // Errors of delayed writes, e.g. on NFS, only show up here.
+    bool close()
+    {
+        const int fd = mFd;
+        mFd = -1;
+        return ::close(fd) == 0;
+    }
+
+  private:
+    int mFd;
+};
+
+bool copyData(int srcFd, int destFd, bool bSameFileSystem)
+{
+    if(bSameFileSystem)
+    {
+#ifdef FICLONE
+        if(::ioctl(destFd, FICLONE, srcFd) == 0)
+            return true;
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+        // Both offsets move along, so whatever fails here is continued below.
+        for(;;)
+        {
+            const ssize_t copied = ::copy_file_range(srcFd, nullptr, destFd, nullptr, 1 << 30, 0);
+            if(copied == 0)
+                return true;
+            if(copied < 0)
+                break;
+        }
+#endif
+    }
+
+    constexpr size_t bufferSize = 1024 * 1024;
+    const std::unique_ptr<char[]> buffer = std::make_unique<char[]>(bufferSize);
+    for(;;)
+    {
+        const ssize_t bytesRead = ::read(srcFd, buffer.get(), bufferSize);
+        if(bytesRead == 0)
+            return true;
+        if(bytesRead < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+
+        for(ssize_t written = 0; written < bytesRead;)
+        {
+            const ssize_t n = ::write(destFd, buffer.get() + written, bytesRead - written);
+            if(n < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            written += n;
+        }
+    }
+}
+} // namespace
+#endif
+
+bool LocalFileCopy::copy(const QString& srcName, const QString& destName, QString& errorString)
+{
+#if defined(Q_OS_WIN)
+    const QString nativeSrc = QDir::toNativeSeparators(srcName);
+    const QString nativeDest = QDir::toNativeSeparators(destName);
+    if(!CopyFileExW(reinterpret_cast<const wchar_t*>(nativeSrc.utf16()), reinterpret_cast<const wchar_t*>(nativeDest.utf16()),
+                    nullptr, nullptr, nullptr, 0))
+    {
+        errorString = qt_error_string((int)GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_LINUX)
+    const QByteArray destPath = QFile::encodeName(destName);
+
+    FileDescriptor srcFd(::open(QFile::encodeName(srcName).constData(), O_RDONLY | O_CLOEXEC));
+    struct stat srcStat;
+    if(!srcFd.isValid() || ::fstat(srcFd.get(), &srcStat) != 0)
+    {
+        errorString = qt_error_string(errno);
+        return false;
+    }
+
+    FileDescriptor destFd(::open(destPath.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, srcStat.st_mode & 07777));
+    struct stat destStat;
+    if(!destFd.isValid() || ::fstat(destFd.get(), &destStat) != 0)
+    {
+        errorString = qt_error_string(errno);
+        return false;
+    }
+
+    const struct timespec times[2] = {srcStat.st_atim, srcStat.st_mtim};
+    if(!copyData(srcFd.get(), destFd.get(), srcStat.st_dev == destStat.st_dev) ||
+       ::fchmod(destFd.get(), srcStat.st_mode & 07777) != 0 || ::futimens(destFd.get(), times) != 0 ||
+       !destFd.close())
+    {
+        errorString = qt_error_string(errno);
+        ::unlink(destPath.constData());
+        return false;
+    }
+    return true;
+#else
+    if(QFileInfo::exists(destName) && !QFile::remove(destName))
+    {
+        errorString = QFile(destName).errorString();
+        return false;
+    }
+
+    // Qt uses clonefile() on macOS where it can.
+    QFile srcFile(srcName);
+    if(!srcFile.copy(destName))
+    {
+        errorString = srcFile.errorString();
+        return false;
+    }
+
+    QFile destFile(destName);
+    if(destFile.open(QIODevice::ReadWrite))
+        destFile.setFileTime(QFileInfo(srcName).lastModified(), QFileDevice::FileModificationTime);
+    return true;
+#endif
+}
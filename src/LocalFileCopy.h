@@ -0,0 +1,32 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef LOCALFILECOPY_H
+#define LOCALFILECOPY_H
+
+#include <QString>
+
+/*
+    Copies a local file without moving the data through this process where possible.
+
+    On Linux the copy is first tried as a reflink (FICLONE), which shares the blocks on file
+    systems like btrfs or XFS. Otherwise copy_file_range() lets the kernel copy, which a network
+    file system may turn into a copy on the server. Both need source and destination on the same
+    file system, anything else is copied by reading and writing. On Windows CopyFileEx() does the
+    same for NTFS and SMB shares.
+
+    The destination is replaced. Permissions and the modification time are kept like KIO does.
+*/
+class LocalFileCopy
+{
+  public:
+    static bool copy(const QString& srcName, const QString& destName, QString& errorString);
+};
+
+#endif
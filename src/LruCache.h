@@ -0,0 +1,76 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/*
+    Keeps the most recently used values up to a fixed count.
+    Unlike QCache values are stored by value and may be move only.
+*/
+template <class Key, class Value, class Hash = std::hash<Key>>
+class LruCache
+{
+  public:
+    explicit LruCache(size_t capacity): mCapacity(capacity) {}
+
+    // Returns nullptr if key isn't cached. A hit becomes the most recently used entry.
+    Value* find(const Key& key)
+    {
+        const auto indexIt = mIndex.find(key);
+        if(indexIt == mIndex.end())
+            return nullptr;
+
+        mEntries.splice(mEntries.begin(), mEntries, indexIt->second);
+        return &indexIt->second->second;
+    }
+
+    Value& insert(const Key& key, Value&& value)
+    {
+        const auto indexIt = mIndex.find(key);
+        if(indexIt != mIndex.end())
+        {
+            mEntries.splice(mEntries.begin(), mEntries, indexIt->second);
+            indexIt->second->second = std::move(value);
+            return indexIt->second->second;
+        }
+
+        if(mEntries.size() >= mCapacity && !mEntries.empty())
+        {
+            mIndex.erase(mEntries.back().first);
+            mEntries.pop_back();
+        }
+
+        mEntries.emplace_front(key, std::move(value));
+        mIndex.emplace(key, mEntries.begin());
+        return mEntries.front().second;
+    }
+
+    void clear()
+    {
+        mIndex.clear();
+        mEntries.clear();
+    }
+
+    [[nodiscard]] size_t size() const { return mEntries.size(); }
+
+  private:
+    using Entry = std::pair<Key, Value>;
+
+    std::list<Entry> mEntries; // Most recently used first.
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> mIndex;
+    size_t mCapacity;
+};
+
+#endif
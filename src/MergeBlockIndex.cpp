@@ -0,0 +1,121 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "MergeBlockIndex.h"
+
+#include <algorithm>
+
+void MergeBlockIndex::build(const MergeBlockListImp& blocks, const std::function<bool(const MergeBlockListImp::const_iterator)>& skipDelta,
+                            const bool bSkipWhiteSpaceConflicts)
+{
+    mBlocks.clear();
+    mFirstLines.clear();
+    mDeltas.clear();
+    mConflicts.clear();
+    mUnsolvedConflicts.clear();
+    mUnsolvedConflictKinds.fill(0);
+    mBlocks.reserve(blocks.size());
+    mFirstLines.reserve(blocks.size() + 1);
+
+    LineType line = 0;
+    for(MergeBlockListImp::const_iterator i = blocks.cbegin(); i != blocks.cend(); ++i)
+    {
+        const size_t ordinal = mBlocks.size();
+        mBlocks.push_back(i);
+        mFirstLines.push_back(line);
+        line += i->lineCount();
+
+        const bool bSkipped = bSkipWhiteSpaceConflicts && i->isWhiteSpaceConflict();
+        if(i->isDelta() && !bSkipped && !skipDelta(i))
+            mDeltas.push_back(ordinal);
+        if(i->isConflict() && !bSkipped)
+            mConflicts.push_back(ordinal);
+        if(i->list().cbegin()->isConflict())
+        {
+            mUnsolvedConflicts.push_back(ordinal);
+            ++mUnsolvedConflictKinds[(size_t)i->conflictKind()];
+        }
+    }
+    mFirstLines.push_back(line);
+    mEnd = blocks.cend();
+
+    mbSkipWhiteSpaceConflicts = bSkipWhiteSpaceConflicts;
+    mbValid = true;
+}
+
+void MergeBlockIndex::insertLines(const size_t ordinal, const LineType nofLines)
+{
+    for(size_t i = ordinal + 1; i < mFirstLines.size(); ++i)
+        mFirstLines[i] += nofLines;
+    mbValid = true;
+}
+
+size_t MergeBlockIndex::ordinal(const MergeBlockListImp::const_iterator it) const
+{
+    // An empty list may leave the caller with an iterator into a list that is gone.
+    if(mBlocks.empty() || it == mEnd)
+        return mBlocks.size();
+
+    // Blocks follow each other in the Diff3LineList, so their indexes are sorted.
+    const LineType d3lIdx = it->getIndex();
+    auto candidate = std::lower_bound(mBlocks.cbegin(), mBlocks.cend(), d3lIdx,
+                                      [](const MergeBlockListImp::const_iterator& block, const LineType idx) { return block->getIndex() < idx; });
+    for(; candidate != mBlocks.cend() && (*candidate)->getIndex() == d3lIdx; ++candidate)
+    {
+        if(*candidate == it)
+            return (size_t)(candidate - mBlocks.cbegin());
+    }
+    return mBlocks.size();
+}
+
+size_t MergeBlockIndex::ordinalOfLine(const LineType line) const
+{
+    if(line < 0 || line >= mFirstLines.back())
+        return mBlocks.size();
+    return (size_t)(std::upper_bound(mFirstLines.cbegin(), mFirstLines.cend() - 1, line) - mFirstLines.cbegin()) - 1;
+}
+
+size_t MergeBlockIndex::ordinalOfDiff3Line(const LineType d3lIdx) const
+{
+    const auto it = std::upper_bound(mBlocks.cbegin(), mBlocks.cend(), d3lIdx,
+                                     [](const LineType idx, const MergeBlockListImp::const_iterator& block) { return idx < block->getIndex(); });
+    if(it == mBlocks.cbegin())
+        return mBlocks.size();
+
+    const MergeBlockListImp::const_iterator& block = *(it - 1);
+    return d3lIdx < block->getIndex() + block->sourceRangeLength() ? (size_t)(it - 1 - mBlocks.cbegin()) : mBlocks.size();
+}
+
+size_t MergeBlockIndex::next(const Kind kind, const size_t ordinal) const
+{
+    const std::vector<size_t>& found = ordinals(kind);
+    const auto it = std::upper_bound(found.cbegin(), found.cend(), ordinal);
+    return it == found.cend() ? mBlocks.size() : *it;
+}
+
+size_t MergeBlockIndex::previous(const Kind kind, const size_t ordinal) const
+{
+    const std::vector<size_t>& found = ordinals(kind);
+    const auto it = std::lower_bound(found.cbegin(), found.cend(), ordinal);
+    return it == found.cbegin() ? mBlocks.size() : *(it - 1);
+}
+
+const std::vector<size_t>& MergeBlockIndex::ordinals(const Kind kind) const
+{
+    switch(kind)
+    {
+        case Kind::delta:
+            return mDeltas;
+        case Kind::conflict:
+            return mConflicts;
+        case Kind::unsolvedConflict:
+            break;
+    }
+    return mUnsolvedConflicts;
+}
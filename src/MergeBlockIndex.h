@@ -0,0 +1,82 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef MERGEBLOCKINDEX_H
+#define MERGEBLOCKINDEX_H
+
+#include "LineRef.h"
+#include "MergeEditLine.h"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+/*
+    Positions of the blocks of a MergeBlockList that navigation stops at, in sorted arrays.
+
+    Finding the next or previous delta or conflict from any block and counting the unsolved
+    conflicts takes O(log n) instead of a walk over the list. The index only holds iterators, so
+    any change to the blocks must invalidate it, it is then built again in O(n) when next used.
+*/
+class MergeBlockIndex
+{
+  public:
+    enum class Kind
+    {
+        delta,
+        conflict,
+        unsolvedConflict
+    };
+
+    // skipDelta decides about the deltas that aren't navigated to, bSkipWhiteSpaceConflicts also leaves out white space conflicts.
+    void build(const MergeBlockListImp& blocks, const std::function<bool(const MergeBlockListImp::const_iterator)>& skipDelta,
+               const bool bSkipWhiteSpaceConflicts);
+    void invalidate() { mbValid = false; }
+    /*
+        Lines were added to the block at ordinal and it kept its kind, so only the first lines of the
+        blocks behind it move. The index is valid again afterwards, even if the edit invalidated it.
+    */
+    void insertLines(const size_t ordinal, const LineType nofLines);
+
+    [[nodiscard]] bool isValid() const { return mbValid; }
+    [[nodiscard]] bool skipsWhiteSpaceConflicts() const { return mbSkipWhiteSpaceConflicts; }
+
+    [[nodiscard]] size_t size() const { return mBlocks.size(); }
+    // Position of the block in the list, size() for the end or a block not in the index.
+    [[nodiscard]] size_t ordinal(const MergeBlockListImp::const_iterator it) const;
+    [[nodiscard]] MergeBlockListImp::const_iterator block(const size_t ordinal) const { return mBlocks[ordinal]; }
+    // Line of the merge output the block starts at, the number of lines for size().
+    [[nodiscard]] LineType firstLine(const size_t ordinal) const { return mFirstLines[ordinal]; }
+    // Block containing the line of the merge output or the Diff3Line, size() if none does.
+    [[nodiscard]] size_t ordinalOfLine(const LineType line) const;
+    [[nodiscard]] size_t ordinalOfDiff3Line(const LineType d3lIdx) const;
+
+    // Nearest block of this kind after or before ordinal, size() if there is none.
+    [[nodiscard]] size_t next(const Kind kind, const size_t ordinal) const;
+    [[nodiscard]] size_t previous(const Kind kind, const size_t ordinal) const;
+
+    [[nodiscard]] size_t count(const Kind kind) const { return ordinals(kind).size(); }
+    [[nodiscard]] size_t unsolvedWhiteSpaceConflicts() const { return unsolvedConflicts(e_ConflictKind::whiteSpace); }
+    [[nodiscard]] size_t unsolvedConflicts(const e_ConflictKind kind) const { return mUnsolvedConflictKinds[(size_t)kind]; }
+
+  private:
+    [[nodiscard]] const std::vector<size_t>& ordinals(const Kind kind) const;
+
+    bool mbValid = false;
+    bool mbSkipWhiteSpaceConflicts = false;
+    std::vector<MergeBlockListImp::const_iterator> mBlocks;
+    MergeBlockListImp::const_iterator mEnd;
+    std::vector<LineType> mFirstLines;
+    std::vector<size_t> mDeltas;
+    std::vector<size_t> mConflicts;
+    std::vector<size_t> mUnsolvedConflicts;
+    std::array<size_t, (size_t)e_ConflictKind::text + 1> mUnsolvedConflictKinds = {};
+};
+
+#endif
@@ -13,11 +13,34 @@
 #include "diff.h"
 #include "LineRef.h"
 
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <vector>
 
-QString MergeEditLine::getString(const std::shared_ptr<LineDataVector> &pLineDataA, const std::shared_ptr<LineDataVector> &pLineDataB, const std::shared_ptr<LineDataVector> &pLineDataC) const
+std::optional<LineData> MergeEditLine::getLineData(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB, const std::shared_ptr<LineDataVector>& pLineDataC) const
+{
+    //Triggered by resize event during early init. Ignore these calls.
+    if((mSrc == e_SrcSelector::A && pLineDataA->empty()) || (mSrc == e_SrcSelector::B && pLineDataB->empty()) || (mSrc == e_SrcSelector::C && pLineDataC->empty()))
+        return {};
+
+    if(isRemoved() || isModified() || mSrc == e_SrcSelector::None)
+        return {};
+
+    assert(mSrc == e_SrcSelector::A || mSrc == e_SrcSelector::B || mSrc == e_SrcSelector::C);
+
+    if(mSrc == e_SrcSelector::A && m_id3l->getLineA().isValid())
+        return (*pLineDataA)[m_id3l->getLineA()];
+    else if(mSrc == e_SrcSelector::B && m_id3l->getLineB().isValid())
+        return (*pLineDataB)[m_id3l->getLineB()];
+    else if(mSrc == e_SrcSelector::C && m_id3l->getLineC().isValid())
+        return (*pLineDataC)[m_id3l->getLineC()];
+
+    //Not an error.
+    return {};
+}
+
+QString MergeEditLine::getString(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB, const std::shared_ptr<LineDataVector>& pLineDataC) const
 {
     //Triggered by resize event during early init. Ignore these calls.
     if((mSrc == e_SrcSelector::A && pLineDataA->empty()) || (mSrc == e_SrcSelector::B && pLineDataB->empty()) || (mSrc == e_SrcSelector::C && pLineDataC->empty()))
@@ -30,23 +53,8 @@ QString MergeEditLine::getString(const std::shared_ptr<LineDataVector> &pLineDat
 
     if(!isModified())
     {
-        std::optional<LineData> lineData;
-        assert(mSrc == e_SrcSelector::A || mSrc == e_SrcSelector::B || mSrc == e_SrcSelector::C);
-
-        if(mSrc == e_SrcSelector::A && m_id3l->getLineA().isValid())
-            lineData = (*pLineDataA)[m_id3l->getLineA()];
-        else if(mSrc == e_SrcSelector::B && m_id3l->getLineB().isValid())
-            lineData = (*pLineDataB)[m_id3l->getLineB()];
-        else if(mSrc == e_SrcSelector::C && m_id3l->getLineC().isValid())
-            lineData = (*pLineDataC)[m_id3l->getLineC()];
-
-        //Not an error.
-        if(!lineData.has_value())
-        {
-            return QString();
-        }
-
-        return lineData->getLine();
+        const std::optional<LineData> lineData = getLineData(pLineDataA, pLineDataB, pLineDataC);
+        return lineData.has_value() ? lineData->getLine() : QString();
     }
 
     return mStr;
@@ -194,7 +202,8 @@ void MergeBlock::mergeOneLine(const Diff3Line &diffRec, bool &bLineRemoved, bool
 /*
     Build a new MergeBlockList from scratch using a Diff3LineList.
 */
-void MergeBlockList::buildFromDiff3(const Diff3LineList &diff3List, bool isThreeway)
+void MergeBlockList::buildFromDiff3(const Diff3LineList &diff3List, bool isThreeway, const std::shared_ptr<LineDataVector>& pldA,
+                                    const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC)
 {
     LineType lineIdx = 0;
     for(auto it = diff3List.cbegin(); it != diff3List.cend(); ++it)
@@ -204,7 +213,7 @@ void MergeBlockList::buildFromDiff3(const Diff3LineList &diff3List, bool isThree
         bool bLineRemoved;
 
         mb.mergeOneLine(d, bLineRemoved, !isThreeway);
-        mb.dectectWhiteSpaceConflict(d, isThreeway);
+        mb.classifyConflict(d, isThreeway, pldA.get(), pldB.get(), pldC.get());
 
         mb.d3lLineIdx = lineIdx;
         mb.bDelta = mb.srcSelect != e_SrcSelector::A;
@@ -217,8 +226,7 @@ void MergeBlockList::buildFromDiff3(const Diff3LineList &diff3List, bool isThree
         if(bSame)
         {
             ++lBack->srcRangeLength;
-            if(lBack->isWhiteSpaceConflict() && !mb.isWhiteSpaceConflict())
-                lBack->bWhiteSpaceConflict = false;
+            lBack->mConflictKind = MergeBlock::combinedConflictKind(lBack->mConflictKind, mb.mConflictKind);
         }
         else
         {
@@ -243,11 +251,32 @@ void MergeBlockList::buildFromDiff3(const Diff3LineList &diff3List, bool isThree
         ++lineIdx;
     }
 }
+void MergeBlockList::assignChanged(const MergeBlockList& other)
+{
+    if(mImp.size() != other.mImp.size() ||
+       !std::equal(mImp.cbegin(), mImp.cend(), other.mImp.cbegin(), [](const MergeBlock& mb1, const MergeBlock& mb2) { return mb1.hasSameRange(mb2); }))
+    {
+        // Blocks were split or joined, start over.
+        mImp = other.mImp;
+        return;
+    }
+
+    MergeBlockListImp::const_iterator otherIt = other.mImp.cbegin();
+    for(MergeBlock& mb: mImp)
+    {
+        if(mb != *otherIt)
+            mb = *otherIt;
+        ++otherIt;
+    }
+}
+
 /*
     Changes default merge settings currently used when not in auto mode or if white space is being auto solved.
 */
 void MergeBlockList::updateDefaults(const e_SrcSelector defaultSelector, const bool bConflictsOnly, const bool bWhiteSpaceOnly)
 {
+    MergeEditLineList defaultLines;
+
     // Change all auto selections
     MergeBlockListImp::iterator mbIt;
     for(mbIt = mImp.begin(); mbIt != mImp.end(); ++mbIt)
@@ -256,14 +285,14 @@ void MergeBlockList::updateDefaults(const e_SrcSelector defaultSelector, const b
         bool bConflict = mb.list().empty() || mb.list().begin()->isConflict();
         if(mb.isDelta() && !(mb.hasModfiedText() && (bConflictsOnly || bWhiteSpaceOnly)) && (!bConflictsOnly || bConflict) && (!bWhiteSpaceOnly || mb.isWhiteSpaceConflict()))
         {
-            mb.list().clear();
+            defaultLines.clear();
             if(defaultSelector == e_SrcSelector::Invalid)
             {
                 MergeEditLine mel(mb.id3l());
 
                 mel.setConflict();
                 mb.bConflict = true;
-                mb.list().push_back(mel);
+                defaultLines.push_back(mel);
             }
             else
             {
@@ -280,33 +309,108 @@ void MergeBlockList::updateDefaults(const e_SrcSelector defaultSelector, const b
                                                                                                                                        LineRef();
                     if(srcLine.isValid())
                     {
-                        mb.list().push_back(mel);
+                        defaultLines.push_back(mel);
                     }
 
                     ++d3llit;
                 }
 
-                if(mb.list().empty()) // Make a line nevertheless
+                if(defaultLines.empty()) // Make a line nevertheless
                 {
                     MergeEditLine mel(mb.id3l());
                     mel.setRemoved(defaultSelector);
-                    mb.list().push_back(mel);
+                    defaultLines.push_back(mel);
                 }
             }
+
+            // Blocks that already show the default keep their lines.
+            if(mb.list() != defaultLines)
+                mb.list().swap(defaultLines);
         }
     }
 }
 
-void MergeBlock::dectectWhiteSpaceConflict(const Diff3Line &d, const bool isThreeWay)
+namespace {
+// Equal when the digits and white space are left out.
+bool isEqualApartFromNumbers(const QString& line1, const QString& line2)
+{
+    const auto isIgnored = [](const QChar c) { return c.isDigit() || c.isSpace(); };
+    QtSizeType i1 = 0, i2 = 0;
+    for(;;)
+    {
+        while(i1 < line1.length() && isIgnored(line1[i1]))
+            ++i1;
+        while(i2 < line2.length() && isIgnored(line2[i2]))
+            ++i2;
+        if(i1 == line1.length() || i2 == line2.length())
+            return i1 == line1.length() && i2 == line2.length();
+        if(line1[i1] != line2[i2])
+            return false;
+        ++i1;
+        ++i2;
+    }
+}
+} // namespace
+
+void MergeBlock::classifyConflict(const Diff3Line &d, const bool isThreeWay, const LineDataVector *pldA, const LineDataVector *pldB, const LineDataVector *pldC)
 {
+    if(!isConflict())
+    {
+        mConflictKind = e_ConflictKind::none;
+        return;
+    }
+
     // Automatic solving for only whitespace changes.
-    if(isConflict() &&
-       ((!isThreeWay && (d.isEqualAB() || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B)))) ||
-        (isThreeWay && ((d.isEqualAB() && d.isEqualAC()) || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B) && d.isWhiteLine(e_SrcSelector::C))))))
+    if((!isThreeWay && (d.isEqualAB() || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B)))) ||
+       (isThreeWay && ((d.isEqualAB() && d.isEqualAC()) || (d.isWhiteLine(e_SrcSelector::A) && d.isWhiteLine(e_SrcSelector::B) && d.isWhiteLine(e_SrcSelector::C)))))
+    {
+        mConflictKind = e_ConflictKind::whiteSpace;
+        return;
+    }
+
+    mConflictKind = e_ConflictKind::text;
+    if(pldA == nullptr || pldB == nullptr || (isThreeWay && pldC == nullptr))
+        return;
+
+    std::vector<const LineData*> lines;
+    bool bAllPresent = true;
+    bool bOnlyComments = true;
+    for(const e_SrcSelector src: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
     {
-        bWhiteSpaceConflict = true;
+        if(src == e_SrcSelector::C && !isThreeWay)
+            break;
+
+        const LineRef line = d.getLineIndex(src);
+        const LineDataVector* pld = src == e_SrcSelector::A ? pldA : src == e_SrcSelector::B ? pldB : pldC;
+        if(!line.isValid() || (LineType)line >= (LineType)pld->size())
+        {
+            bAllPresent = false;
+            continue;
+        }
+
+        const LineData& lineData = (*pld)[(LineType)line];
+        // Skipable lines hold nothing but comments or white space.
+        if(!lineData.isSkipable() && !lineData.whiteLine())
+            bOnlyComments = false;
+        lines.push_back(&lineData);
     }
+
+    if(bOnlyComments)
+        mConflictKind = e_ConflictKind::comment;
+    else if(bAllPresent && std::all_of(lines.cbegin() + 1, lines.cend(), [&lines](const LineData* pLine) { return isEqualApartFromNumbers(lines.front()->getLine(), pLine->getLine()); }))
+        mConflictKind = e_ConflictKind::numbers;
+}
+
+e_ConflictKind MergeBlock::combinedConflictKind(const e_ConflictKind kind1, const e_ConflictKind kind2)
+{
+    if(kind1 == kind2 || kind2 == e_ConflictKind::whiteSpace)
+        return kind1;
+    if(kind1 == e_ConflictKind::whiteSpace)
+        return kind2;
+    // Comments and numbers that differ together are neither.
+    return kind1 == e_ConflictKind::none || kind2 == e_ConflictKind::none ? e_ConflictKind::none : e_ConflictKind::text;
 }
+
 // Remove all lines that are empty, because no src lines are there.
 void MergeBlock::removeEmptySource()
 {
@@ -332,6 +436,177 @@ void MergeBlock::removeEmptySource()
     }
 }
 
+namespace {
+class EditSignature
+{
+  public:
+    inline void add(const quint64 value) { mHash = (mHash ^ value) * 0x100000001B3ULL; }
+    void add(const QString& s)
+    {
+        add((quint64)s.length());
+        for(const QChar c: s)
+            add(c.unicode());
+    }
+    [[nodiscard]] inline quint64 value() const { return mHash; }
+
+  private:
+    quint64 mHash = 0xCBF29CE484222325ULL;
+};
+
+// Lines of src referenced by count Diff3Lines starting at d3lIt, these are consecutive in the input.
+bool getSourceRange(Diff3LineList::const_iterator d3lIt, const LineType count, const e_SrcSelector src, LineType& first, LineType& size)
+{
+    LineRef firstLine, lastLine;
+    for(LineType i = 0; i < count; ++i, ++d3lIt)
+    {
+        const LineRef line = d3lIt->getLineInFile(src);
+        if(line.isValid())
+        {
+            if(!firstLine.isValid())
+                firstLine = line;
+            lastLine = line;
+        }
+    }
+
+    if(!firstLine.isValid())
+        return false;
+
+    first = firstLine;
+    size = lastLine - firstLine + 1;
+    return true;
+}
+} // namespace
+
+bool MergeBlock::updateEditMatches(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB,
+                                   const std::shared_ptr<LineDataVector>& pLineDataC, DiffContext& context)
+{
+    EditSignature signature;
+    signature.add((quint64)d3lLineIdx);
+    signature.add((quint64)srcRangeLength);
+    bool bModified = false;
+    for(const MergeEditLine& mel: mMergeEditLineList)
+    {
+        signature.add((quint64)mel.src());
+        signature.add((mel.isRemoved() ? 2 : 0) | (mel.isModified() ? 1 : 0));
+        if(mel.isModified() && !mel.isRemoved())
+        {
+            bModified = true;
+            signature.add(mel.getString(pLineDataA, pLineDataB, pLineDataC));
+        }
+    }
+
+    if(signature.value() == mEditSignature)
+        return false;
+    mEditSignature = signature.value();
+
+    std::vector<e_SrcSelector> matches(mMergeEditLineList.size(), e_SrcSelector::None);
+    if(bModified)
+    {
+        // The text of the block as it is now serves as the first input of the diff.
+        const QSharedPointer<QString> buffer = QSharedPointer<QString>::create();
+        LineDataVector blockLines;
+        blockLines.setBuffer(buffer);
+        std::vector<size_t> melIndexes;
+        for(size_t i = 0; i < mMergeEditLineList.size(); ++i)
+        {
+            const MergeEditLine& mel = mMergeEditLineList[i];
+            if(!mel.isEditableText() || mel.isRemoved())
+                continue;
+
+            const QString line = mel.getString(pLineDataA, pLineDataB, pLineDataC);
+            QtSizeType firstNonWhite = 0;
+            while(firstNonWhite < line.length() && line[firstNonWhite].isSpace())
+                ++firstNonWhite;
+            // Stored as one past the first non-white character, zero if there is none.
+            firstNonWhite = firstNonWhite < line.length() ? firstNonWhite + 1 : 0;
+
+            blockLines.push_back(LineData(buffer, buffer->length(), line.length(), firstNonWhite));
+            buffer->append(line);
+            melIndexes.push_back(i);
+        }
+
+        const LineType blockSize = SafeInt<LineType>(blockLines.size());
+        for(const e_SrcSelector src: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
+        {
+            const std::shared_ptr<LineDataVector>& pLineData = src == e_SrcSelector::A ? pLineDataA : src == e_SrcSelector::B ? pLineDataB : pLineDataC;
+            LineType first = 0, size = 0;
+            if(blockSize == 0 || pLineData == nullptr || pLineData->empty() || !getSourceRange(mId3l, srcRangeLength, src, first, size))
+                continue;
+
+            DiffList diffList;
+            context.engine().diff(blockLines, 0, blockSize, *pLineData, first, size, diffList);
+
+            // Line matching ignores white space, only exact copies count here.
+            LineType line1 = 0, line2 = first;
+            for(const Diff& diff: diffList)
+            {
+                for(LineType k = 0; k < diff.numberOfEquals(); ++k, ++line1, ++line2)
+                {
+                    const size_t melIdx = melIndexes[line1];
+                    if(matches[melIdx] == e_SrcSelector::None && mMergeEditLineList[melIdx].isModified() && blockLines[line1].rawEqual((*pLineData)[line2]))
+                        matches[melIdx] = src;
+                }
+                line1 += (LineType)diff.diff1();
+                line2 += (LineType)diff.diff2();
+            }
+        }
+    }
+
+    bool bChanged = false;
+    for(size_t i = 0; i < mMergeEditLineList.size(); ++i)
+    {
+        if(mMergeEditLineList[i].matchingSource() != matches[i])
+        {
+            mMergeEditLineList[i].setMatchingSource(matches[i]);
+            bChanged = true;
+        }
+    }
+    return bChanged;
+}
+
+LineType MergeBlock::insertText(MergeEditLineList::iterator& melIt, const QString& line, QtSizeType& x, const QString& text)
+{
+    // Line breaks are \n, \r\n or a single \r.
+    std::vector<QString> lines;
+    QtSizeType start = 0;
+    for(QtSizeType i = 0; i < text.length(); ++i)
+    {
+        if(text[i] != '\n' && text[i] != '\r')
+            continue;
+
+        lines.push_back(text.mid(start, i - start));
+        if(text[i] == '\r' && i + 1 < text.length() && text[i + 1] == '\n')
+            ++i;
+        start = i + 1;
+    }
+
+    const QString endOfLine = line.mid(x);
+    if(lines.empty())
+    {
+        melIt->setString(line.left(x) + text + endOfLine);
+        x += text.length();
+        return 0;
+    }
+
+    melIt->setString(line.left(x) + lines.front());
+
+    MergeEditLineList newLines;
+    newLines.reserve(lines.size());
+    for(size_t i = 1; i < lines.size(); ++i)
+    {
+        newLines.emplace_back(mId3l); // Associate every mel with an id3l, even if not really valid.
+        newLines.back().setString(lines[i]);
+    }
+    const QString lastLine = text.mid(start);
+    newLines.emplace_back(mId3l);
+    newLines.back().setString(lastLine + endOfLine);
+    x = lastLine.length();
+
+    const LineType nofNewLines = SafeInt<LineType>(newLines.size());
+    melIt = mMergeEditLineList.insert(melIt + 1, std::make_move_iterator(newLines.begin()), std::make_move_iterator(newLines.end())) + (nofNewLines - 1);
+    return nofNewLines;
+}
+
 // Returns the iterator to the MergeBlock after the split
 MergeBlockListImp::iterator MergeBlockList::splitAtDiff3LineIdx(int d3lLineIdx)
 {
@@ -346,19 +621,16 @@ MergeBlockListImp::iterator MergeBlockList::splitAtDiff3LineIdx(int d3lLineIdx)
         else if(i->getIndex() > d3lLineIdx)
         {
             // The split must be in the previous MergeBlock
-            --i;
-            MergeBlock &mb = *i;
-            MergeBlock newMB;
-            mb.split(newMB, d3lLineIdx);
-            ++i;
-            return mImp.insert(i, newMB);
+            return split(std::prev(i), d3lLineIdx);
         }
     }
     // The split must be in the previous MergeBlock
-    --i;
-    MergeBlock &mb = *i;
+    return split(std::prev(i), d3lLineIdx);
+}
+
+MergeBlockListImp::iterator MergeBlockList::split(MergeBlockListImp::iterator i, int d3lLineIdx)
+{
     MergeBlock newMB;
-    mb.split(newMB, d3lLineIdx);
-    ++i;
-    return mImp.insert(i, newMB);
+    i->split(newMB, d3lLineIdx);
+    return mImp.insert(std::next(i), std::move(newMB));
 }
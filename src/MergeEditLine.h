@@ -9,15 +9,35 @@
 // clang-format on
 
 #ifndef MERGEEDITLINE_H
+#define MERGEEDITLINE_H
 
 #include "diff.h"
 #include "LineRef.h"
 
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include <QString>
 
-using MergeEditLineList = std::list<class MergeEditLine>;
+/*
+    The lines of a MergeBlock. Kept in one array because a merge of a large file has about one
+    MergeEditLine per line. A MergeEditLine is small and only holds a string once the user edited
+    it, so inserting or erasing in the middle is cheap compared with a heap node per line.
+    Unlike with a list, this invalidates iterators behind the changed position.
+*/
+using MergeEditLineList = std::vector<class MergeEditLine>;
+
+// What the inputs of a conflict differ in, worked out once when the blocks are built.
+enum class e_ConflictKind : quint8
+{
+    none, // Not a conflict.
+    whiteSpace,
+    comment, // Only comments or empty lines differ.
+    numbers, // The lines are equal apart from their digits.
+    text
+};
 
 class MergeEditLine
 {
@@ -26,6 +46,7 @@ class MergeEditLine
     {
         m_id3l = i;
         mSrc = src;
+        mMatchingSrc = e_SrcSelector::None;
         mLineRemoved = false;
         mChanged = false;
     }
@@ -55,8 +76,11 @@ class MergeEditLine
         mStr = s;
         mLineRemoved = false;
         mSrc = e_SrcSelector::None;
+        mMatchingSrc = e_SrcSelector::None;
         mChanged = true;
     }
+    // The input line this shows unchanged, if any.
+    [[nodiscard]] std::optional<LineData> getLineData(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB, const std::shared_ptr<LineDataVector>& pLineDataC) const;
     [[nodiscard]] QString getString(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB, const std::shared_ptr<LineDataVector>& pLineDataC) const;
     [[nodiscard]] inline bool isModified() const { return mChanged; }
 
@@ -74,11 +98,21 @@ class MergeEditLine
     }
 
     [[nodiscard]] inline e_SrcSelector src() const { return mSrc; }
+    // An input with a line equal to this modified line, see MergeBlock::updateEditMatches().
+    [[nodiscard]] inline e_SrcSelector matchingSource() const { return mMatchingSrc; }
+    inline void setMatchingSource(e_SrcSelector src) { mMatchingSrc = src; }
     [[nodiscard]] inline Diff3LineList::const_iterator id3l() const { return m_id3l; }
 
+    [[nodiscard]] bool operator==(const MergeEditLine& other) const
+    {
+        return m_id3l == other.m_id3l && mSrc == other.mSrc && mLineRemoved == other.mLineRemoved && mChanged == other.mChanged && mStr == other.mStr;
+    }
+    [[nodiscard]] bool operator!=(const MergeEditLine& other) const { return !(*this == other); }
+
   private:
     Diff3LineList::const_iterator m_id3l;
     e_SrcSelector mSrc; // 1, 2 or 3 for A, B or C respectively, or 0 when line is from neither source.
+    e_SrcSelector mMatchingSrc;
     QString mStr;       // String when modified by user or null-string when orig data is used.
     bool mLineRemoved;
     bool mChanged;
@@ -94,10 +128,11 @@ class MergeBlock
     LineType srcRangeLength = 0; // how many src-lines have these properties
     e_MergeDetails mergeDetails = e_MergeDetails::eDefault;
     bool bConflict = false;
-    bool bWhiteSpaceConflict = false;
+    e_ConflictKind mConflictKind = e_ConflictKind::none;
     bool bDelta = false;
     e_SrcSelector srcSelect = e_SrcSelector::None;
     MergeEditLineList mMergeEditLineList;
+    quint64 mEditSignature = 0; // State of the lines when updateEditMatches() last ran.
 
   public:
     [[nodiscard]] inline const MergeEditLineList& list() const { return mMergeEditLineList; }
@@ -109,7 +144,8 @@ class MergeBlock
     [[nodiscard]] inline LineType sourceRangeLength() const { return srcRangeLength; }
 
     [[nodiscard]] inline bool isConflict() const { return bConflict; }
-    [[nodiscard]] inline bool isWhiteSpaceConflict() const { return bWhiteSpaceConflict; }
+    [[nodiscard]] inline bool isWhiteSpaceConflict() const { return mConflictKind == e_ConflictKind::whiteSpace; }
+    [[nodiscard]] inline e_ConflictKind conflictKind() const { return mConflictKind; }
     [[nodiscard]] inline bool isDelta() const { return bDelta; }
     [[nodiscard]] inline bool hasModfiedText()
     {
@@ -128,7 +164,7 @@ class MergeBlock
             return; //Error
         mb2.mergeDetails = mergeDetails;
         mb2.bConflict = bConflict;
-        mb2.bWhiteSpaceConflict = bWhiteSpaceConflict;
+        mb2.mConflictKind = mConflictKind;
         mb2.bDelta = bDelta;
         mb2.srcSelect = srcSelect;
 
@@ -145,7 +181,8 @@ class MergeBlock
         {
             if(i->id3l() == mb2.mId3l)
             {
-                mb2.mMergeEditLineList.splice(mb2.mMergeEditLineList.begin(), mMergeEditLineList, i, mMergeEditLineList.end());
+                mb2.mMergeEditLineList.assign(std::make_move_iterator(i), std::make_move_iterator(mMergeEditLineList.end()));
+                mMergeEditLineList.erase(i, mMergeEditLineList.end());
                 return;
             }
         }
@@ -159,16 +196,49 @@ class MergeBlock
         mMergeEditLineList.clear();
         mMergeEditLineList.push_back(MergeEditLine(mId3l)); // Create a simple conflict
         if(mb2.bConflict) bConflict = true;
-        if(!mb2.bWhiteSpaceConflict) bWhiteSpaceConflict = false;
+        mConflictKind = combinedConflictKind(mConflictKind, mb2.mConflictKind);
+        if(bConflict && mConflictKind == e_ConflictKind::none) mConflictKind = e_ConflictKind::text;
         if(mb2.bDelta) bDelta = true;
     }
 
     bool isSameKind(const MergeBlock& mb2) const;
 
+    // Covers the same Diff3Lines as mb2, the lines and state may differ.
+    [[nodiscard]] inline bool hasSameRange(const MergeBlock& mb2) const { return d3lLineIdx == mb2.d3lLineIdx && srcRangeLength == mb2.srcRangeLength; }
+
+    [[nodiscard]] bool operator==(const MergeBlock& mb2) const
+    {
+        return hasSameRange(mb2) && mId3l == mb2.mId3l && mergeDetails == mb2.mergeDetails && bConflict == mb2.bConflict &&
+               mConflictKind == mb2.mConflictKind && bDelta == mb2.bDelta && srcSelect == mb2.srcSelect &&
+               mMergeEditLineList == mb2.mMergeEditLineList;
+    }
+    [[nodiscard]] bool operator!=(const MergeBlock& mb2) const { return !(*this == mb2); }
+
     void mergeOneLine(const Diff3Line& diffRec, bool& bLineRemoved, bool bTwoInputs);
-    void dectectWhiteSpaceConflict(const Diff3Line& d, const bool isThreeWay);
+    /*
+        Sets the kind of conflict of a block made from d. Without the lines only white space
+        conflicts are told apart from the others.
+    */
+    void classifyConflict(const Diff3Line& d, const bool isThreeWay, const LineDataVector* pldA, const LineDataVector* pldB, const LineDataVector* pldC);
+    // The kind of a block holding lines of both kinds.
+    [[nodiscard]] static e_ConflictKind combinedConflictKind(const e_ConflictKind kind1, const e_ConflictKind kind2);
 
     void removeEmptySource();
+
+    /*
+        Inserts text that may contain line breaks at column x of melIt, whose text is line. The new
+        lines are built first and go into the block in one insertion. Moves melIt to the line the
+        text ends in and x behind it, returns the number of lines added.
+    */
+    LineType insertText(MergeEditLineList::iterator& melIt, const QString& line, QtSizeType& x, const QString& text);
+
+    /*
+        Diffs the editable lines of this block against the lines of each input in its range and marks
+        the modified lines equal to an input line. The diff only runs if the lines changed since the
+        last call. Returns true if a mark changed.
+    */
+    bool updateEditMatches(const std::shared_ptr<LineDataVector>& pLineDataA, const std::shared_ptr<LineDataVector>& pLineDataB,
+                           const std::shared_ptr<LineDataVector>& pLineDataC, DiffContext& context);
 };
 
 typedef std::list<MergeBlock> MergeBlockListImp;
@@ -182,10 +252,16 @@ class MergeBlockList
     [[nodiscard]] inline const MergeBlockListImp& list() const { return mImp; }
     [[nodiscard]] inline MergeBlockListImp& list() { return mImp; }
 
-    void buildFromDiff3(const Diff3LineList& diff3List, bool isThreeway);
+    // The lines are used to classify the conflicts, see MergeBlock::classifyConflict().
+    void buildFromDiff3(const Diff3LineList& diff3List, bool isThreeway, const std::shared_ptr<LineDataVector>& pldA = nullptr,
+                        const std::shared_ptr<LineDataVector>& pldB = nullptr, const std::shared_ptr<LineDataVector>& pldC = nullptr);
+    // Makes this a copy of other, but leaves blocks alone that already equal their counterpart.
+    void assignChanged(const MergeBlockList& other);
     void updateDefaults(const e_SrcSelector defaultSelector, const bool bConflictsOnly, const bool bWhiteSpaceOnly);
 
     MergeBlockListImp::iterator splitAtDiff3LineIdx(int d3lLineIdx);
+    // Splits the block at i, d3lLineIdx must lie inside it. Returns the new block following i.
+    MergeBlockListImp::iterator split(MergeBlockListImp::iterator i, int d3lLineIdx);
 };
 
 #endif
@@ -10,16 +10,35 @@
 
 #include "MergeFileInfos.h"
 
+#include "CompressedInput.h"
 #include "DirectoryInfo.h"
-#include "directorymergewindow.h"
 #include "fileaccess.h"
+#include "FileAnalysis.h"
+#include "FileHashCache.h"
+#include "GitIndex.h"
 #include "Logging.h"
-#include "progress.h"
-
+#include "ProgressProxy.h"
+#include "RemoteHasher.h"
+#include "TaskExecutor.h"
+#include "Trace.h"
+#include "TypeUtils.h"
+
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <string.h> // for memcmp
 #include <vector>
 
+#ifndef Q_OS_WIN
+#include <fcntl.h> // for posix_fadvise
+#endif
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QSemaphore>
 #include <QString>
+#include <QTextStream>
 
 #include <KLocalizedString>
 
@@ -30,36 +49,6 @@ MergeFileInfos::~MergeFileInfos()
     m_children.clear();
 }
 
-void MergeFileInfos::updateParents()
-{
-    MergeFileInfos* current = parent();
-    while(current != nullptr)
-    {
-        bool bChange = false;
-        if(!isEqualAB() && current->isEqualAB())
-        {
-            current->m_bEqualAB = false;
-            bChange = true;
-        }
-        if(!isEqualAC() && current->isEqualAC())
-        {
-            current->m_bEqualAC = false;
-            bChange = true;
-        }
-        if(!isEqualBC() && current->isEqualBC())
-        {
-            current->m_bEqualBC = false;
-            bChange = true;
-        }
-
-        if(bChange)
-            current->updateAge();
-        else
-            break;
-
-        current = current->parent();
-    }
-}
 /*
     Check for directories or links marked as not equal and mark them equal.
 */
@@ -86,6 +75,51 @@ void MergeFileInfos::updateDirectoryOrLink()
         updateAge();
 }
 
+quint8 MergeFileInfos::visibilityCategories() const
+{
+    const bool bEqual = isEqualAB() && (isEqualAC() || !isThreeWay());
+    quint8 categories = 0;
+    if(existsEveryWhere() && bEqual)
+        categories |= eShowIdentical;
+    if(existsCount() >= 2 && !bEqual)
+        categories |= hasDir() ? eShowAlways : eShowDifferent;
+    if(onlyInA())
+        categories |= eShowOnlyInA;
+    if(onlyInB())
+        categories |= eShowOnlyInB;
+    if(onlyInC())
+        categories |= eShowOnlyInC;
+    return categories;
+}
+
+quint8 MergeFileInfos::dependsOnCategories() const
+{
+    quint8 categories = m_visibilityMasks.own | m_visibilityMasks.below;
+    // Folders are shown for eShowIdentical until an item below makes them differ.
+    if(hasDir())
+        categories |= eShowIdentical | m_visibilityMasks.unequalAB | m_visibilityMasks.unequalAC | m_visibilityMasks.unequalBC;
+    return categories;
+}
+
+void MergeFileInfos::applyShownCategories(const quint8 shown)
+{
+    const bool bEqualAB = m_visibilityMasks.bOwnEqualAB && (m_visibilityMasks.unequalAB & shown) == 0;
+    const bool bEqualAC = m_visibilityMasks.bOwnEqualAC && (m_visibilityMasks.unequalAC & shown) == 0;
+    const bool bEqualBC = m_visibilityMasks.bOwnEqualBC && (m_visibilityMasks.unequalBC & shown) == 0;
+    if(bEqualAB == m_bEqualAB && bEqualAC == m_bEqualAC && bEqualBC == m_bEqualBC)
+        return;
+
+    m_bEqualAB = bEqualAB;
+    m_bEqualAC = bEqualAC;
+    m_bEqualBC = bEqualBC;
+    updateAge();
+}
+
+bool MergeFileInfos::isShownFor(const quint8 shown) const
+{
+    return m_visibilityMasks.bNameShown && (visibilityCategories() & (shown | eShowAlways)) != 0;
+}
+
 QString MergeFileInfos::subPath() const
 {
     if(m_pFileInfoA != nullptr && m_pFileInfoA->exists())
@@ -159,12 +193,99 @@ QString MergeFileInfos::fullNameC() const
     return gDirInfo->dirC().absoluteFilePath() + '/' + subPath();
 }
 
+namespace {
+// Child lists longer than this are sorted in parts on several threads.
+constexpr QtSizeType parallelSortSize = 8192;
+} // namespace
+
+void MergeFileInfos::updateSortKey()
+{
+    m_sortKey = fileName().toCaseFolded();
+    m_bSortAsDir = hasDir();
+}
+
+/*
+    Every item belongs to one child list, so the lists are sorted on the global thread pool without
+    locking. Keys are taken by the thread sorting the item's list: fileName() looks at up to three
+    files and the case folding would otherwise be repeated for every comparison. Lists longer than
+    parallelSortSize are cut into parts sorted like separate lists and merged afterwards. The calling
+    thread sorts as well, so this finishes even if the pool is busy.
+*/
 void MergeFileInfos::sort(Qt::SortOrder order)
 {
-    std::sort(m_children.begin(), m_children.end(), MfiCompare(order));
+    typedef QList<MergeFileInfos*>::iterator ChildIterator;
+    struct Part
+    {
+        ChildIterator begin;
+        ChildIterator end;
+    };
+    struct Batch
+    {
+        std::vector<Part> parts;
+        std::atomic<size_t> next{0};
+        QSemaphore finished;
+        MfiCompare compare{Qt::AscendingOrder};
+    };
+
+    const std::shared_ptr<Batch> pBatch = std::make_shared<Batch>();
+    pBatch->compare = MfiCompare(order);
+    const size_t maxThreads = (size_t)std::max(TaskExecutor::instance().maxThreadCount(), 1);
+
+    // Lists cut into several parts, by their first part and number of parts.
+    std::vector<std::pair<size_t, size_t>> splitLists;
+    std::vector<MergeFileInfos*> folders{this};
+    while(!folders.empty())
+    {
+        MergeFileInfos* pFolder = folders.back();
+        folders.pop_back();
+        QList<MergeFileInfos*>& children = pFolder->m_children;
+        if(children.isEmpty())
+            continue;
+
+        // Taken here, the threads mustn't detach the list.
+        const ChildIterator begin = children.begin();
+        const QtSizeType size = children.size();
+        const QtSizeType nofParts = std::min<QtSizeType>((QtSizeType)maxThreads, (size + parallelSortSize - 1) / parallelSortSize);
+        if(nofParts > 1)
+            splitLists.emplace_back(pBatch->parts.size(), (size_t)nofParts);
+        for(QtSizeType i = 0; i < nofParts; ++i)
+            pBatch->parts.push_back({begin + size * i / nofParts, begin + size * (i + 1) / nofParts});
+
+        for(MergeFileInfos* pChild: children)
+        {
+            if(!pChild->m_children.isEmpty())
+                folders.push_back(pChild);
+        }
+    }
 
-    for(int i = 0; i < m_children.count(); ++i)
-        m_children[i]->sort(order);
+    const auto run = [](Batch& batch) {
+        for(;;)
+        {
+            const size_t idx = batch.next.fetch_add(1);
+            if(idx >= batch.parts.size())
+                return;
+
+            const Part& part = batch.parts[idx];
+            for(ChildIterator it = part.begin; it != part.end; ++it)
+                (*it)->updateSortKey();
+            std::sort(part.begin, part.end, batch.compare);
+            batch.finished.release();
+        }
+    };
+
+    const size_t nofThreads = std::min(maxThreads, pBatch->parts.size());
+    for(size_t i = 1; i < nofThreads; ++i)
+        TaskExecutor::instance().start([pBatch, run]() { run(*pBatch); }, TaskExecutor::Priority::visible);
+    run(*pBatch);
+    pBatch->finished.acquire((int)pBatch->parts.size());
+
+    for(const auto& [firstPart, nofParts]: splitLists)
+    {
+        // Everything before the next part is in order already.
+        const ChildIterator begin = pBatch->parts[firstPart].begin;
+        for(size_t i = firstPart + 1; i < firstPart + nofParts; ++i)
+            std::inplace_merge(begin, pBatch->parts[i].begin, pBatch->parts[i].end, pBatch->compare);
+    }
 }
 
 QString MergeFileInfos::fullNameDest() const
@@ -177,7 +298,135 @@ QString MergeFileInfos::fullNameDest() const
         return gDirInfo->destDir().absoluteFilePath() + '/' + subPath();
 }
 
-bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const &pOptions, DirectoryMergeWindow* pDMW)
+bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const &pOptions)
+{
+    bool bError = false;
+    QString eqStatus;
+    const Equality equality = pOptions->m_bDmFullAnalysis ? analyseFiles(m_totalDiffStatus, bError, eqStatus, pOptions) : compareFiles(bError, eqStatus, pOptions);
+    return setComparisonResult(equality, bError, eqStatus, errors);
+}
+
+qint64 MergeFileInfos::sizeOfFiles() const
+{
+    qint64 size = 0;
+    if(existsInA() && !isDirA())
+        size += getFileInfoA()->size();
+    if(existsInB() && !isDirB())
+        size += getFileInfoB()->size();
+    if(existsInC() && !isDirC())
+        size += getFileInfoC()->size();
+    return size;
+}
+
+MergeFileInfos::Equality MergeFileInfos::analyseFiles(TotalDiffStatus& diffStatus, bool& bError, QString& status, const QSharedPointer<const Options>& pOptions) const
+{
+    TraceScope traceScope(TraceStage::compare);
+    traceScope.setItems(sizeOfFiles());
+    Equality equality;
+
+    bError = false;
+    diffStatus.reset();
+    if((existsInA() && isDirA()) || (existsInB() && isDirB()) || (existsInC() && isDirC()))
+    {
+        // If any input is a directory, don't start any comparison.
+        equality.bEqualAB = existsInA() && existsInB();
+        equality.bEqualAC = existsInA() && existsInC();
+        equality.bEqualBC = existsInB() && existsInC();
+        return equality;
+    }
+
+    // Each analysis gets its own copy of the options, so the workers share nothing but the item.
+    QStringList errors;
+    if(!FileAnalysis::analyse(existsInA() ? getFileInfoA()->absoluteFilePath() : QString(),
+                              existsInB() ? getFileInfoB()->absoluteFilePath() : QString(),
+                              existsInC() ? getFileInfoC()->absoluteFilePath() : QString(),
+                              QSharedPointer<Options>::create(*pOptions), diffStatus, errors))
+    {
+        bError = true;
+        status = errors.join('\n');
+        return equality;
+    }
+
+    if(pOptions->m_bDmWhiteSpaceEqual && diffStatus.getNonWhitespaceConflicts() == 0)
+    {
+        equality.bEqualAB = existsInA() && existsInB();
+        equality.bEqualAC = existsInA() && existsInC();
+        equality.bEqualBC = existsInB() && existsInC();
+    }
+    else
+    {
+        equality.bEqualAB = diffStatus.isBinaryEqualAB();
+        equality.bEqualBC = diffStatus.isBinaryEqualBC();
+        equality.bEqualAC = diffStatus.isBinaryEqualAC();
+    }
+
+    return equality;
+}
+
+MergeFileInfos::Equality MergeFileInfos::compareFiles(bool& bError, QString& status, const QSharedPointer<const Options>& pOptions) const
+{
+    TraceScope traceScope(TraceStage::compare);
+    traceScope.setItems(sizeOfFiles());
+    Equality equality;
+
+    bError = false;
+    if(existsInA() && existsInB())
+    {
+        if(isDirA())
+            equality.bEqualAB = true;
+        else
+            equality.bEqualAB = fastFileComparison(*getFileInfoA(), *getFileInfoB(), bError, status, pOptions);
+    }
+    if(existsInA() && existsInC())
+    {
+        if(isDirA())
+            equality.bEqualAC = true;
+        else
+            equality.bEqualAC = fastFileComparison(*getFileInfoA(), *getFileInfoC(), bError, status, pOptions);
+    }
+    if(existsInB() && existsInC())
+    {
+        if((equality.bEqualAB && equality.bEqualAC) || isDirB())
+            equality.bEqualBC = true;
+        else
+        {
+            equality.bEqualBC = fastFileComparison(*getFileInfoB(), *getFileInfoC(), bError, status, pOptions);
+        }
+    }
+
+    return equality;
+}
+
+bool MergeFileInfos::setComparisonResult(const Equality& equality, const bool bError, const QString& status, QStringList& errors)
+{
+    m_bEqualAB = equality.bEqualAB;
+    m_bEqualAC = equality.bEqualAC;
+    m_bEqualBC = equality.bEqualBC;
+
+    if(bError)
+    {
+        //Limit size of error list in memory.
+        if(errors.size() < 30)
+            errors.append(status);
+        return false;
+    }
+
+    calcAges();
+    return true;
+}
+
+void MergeFileInfos::resetComparison()
+{
+    m_bEqualAB = false;
+    m_bEqualAC = false;
+    m_bEqualBC = false;
+    m_bConflictingAges = false;
+    setAgeA(eNotThere);
+    setAgeB(eNotThere);
+    setAgeC(eNotThere);
+}
+
+void MergeFileInfos::calcAges()
 {
     enum class FileIndex
     {
@@ -201,82 +450,6 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer
         dateMap[getFileInfoC()->lastModified()] = FileIndex::c;
     }
 
-    if(pOptions->m_bDmFullAnalysis)
-    {
-        if((existsInA() && isDirA()) || (existsInB() && isDirB()) || (existsInC() && isDirC()))
-        {
-            // If any input is a directory, don't start any comparison.
-            m_bEqualAB = existsInA() && existsInB();
-            m_bEqualAC = existsInA() && existsInC();
-            m_bEqualBC = existsInB() && existsInC();
-        }
-        else
-        {
-            Q_EMIT pDMW->startDiffMerge(errors,
-                existsInA() ? getFileInfoA()->absoluteFilePath() : QString(""),
-                existsInB() ? getFileInfoB()->absoluteFilePath() : QString(""),
-                existsInC() ? getFileInfoC()->absoluteFilePath() : QString(""),
-                "",
-                "", "", "", &diffStatus());
-            int nofNonwhiteConflicts = diffStatus().getNonWhitespaceConflicts();
-
-            if(pOptions->m_bDmWhiteSpaceEqual && nofNonwhiteConflicts == 0)
-            {
-                m_bEqualAB = existsInA() && existsInB();
-                m_bEqualAC = existsInA() && existsInC();
-                m_bEqualBC = existsInB() && existsInC();
-            }
-            else
-            {
-                m_bEqualAB = diffStatus().isBinaryEqualAB();
-                m_bEqualBC = diffStatus().isBinaryEqualBC();
-                m_bEqualAC = diffStatus().isBinaryEqualAC();
-            }
-
-            //Limit size of error list in memory.
-            if(errors.size() >= 30)
-            {
-                //Bail out something is very wrong.
-                return false;
-            }
-        }
-    }
-    else
-    {
-        bool bError = false;
-        QString eqStatus;
-        if(existsInA() && existsInB())
-        {
-            if(isDirA())
-                m_bEqualAB = true;
-            else
-                m_bEqualAB = fastFileComparison(*getFileInfoA(), *getFileInfoB(), bError, eqStatus, pOptions);
-        }
-        if(existsInA() && existsInC())
-        {
-            if(isDirA())
-                m_bEqualAC = true;
-            else
-                m_bEqualAC = fastFileComparison(*getFileInfoA(), *getFileInfoC(), bError, eqStatus, pOptions);
-        }
-        if(existsInB() && existsInC())
-        {
-            if((m_bEqualAB && m_bEqualAC) || isDirB())
-                m_bEqualBC = true;
-            else
-            {
-                m_bEqualBC = fastFileComparison(*getFileInfoB(), *getFileInfoC(), bError, eqStatus, pOptions);
-            }
-        }
-        if(bError)
-        {
-            //Limit size of error list in memory.
-            if(errors.size() < 30)
-                errors.append(eqStatus);
-            return false;
-        }
-    }
-
     if(isLinkA() != isLinkB()) m_bEqualAB = false;
     if(isLinkA() != isLinkC()) m_bEqualAC = false;
     if(isLinkB() != isLinkC()) m_bEqualBC = false;
@@ -370,7 +543,169 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, QSharedPointer
         if(getAgeB() == eMiddle) setAgeB(eOld);
         if(getAgeC() == eMiddle) setAgeC(eOld);
     }
+}
+
+bool MergeFileInfos::isLocal() const
+{
+    return (!existsInA() || getFileInfoA()->isLocal()) &&
+           (!existsInB() || getFileInfoB()->isLocal()) &&
+           (!existsInC() || getFileInfoC()->isLocal());
+}
+
+namespace {
+
+// Local files are compared through memory maps of this size, so huge files don't need huge address ranges.
+constexpr qint64 mapBlockSize = 64 * 1024 * 1024;
+// Used where mapping fails and for remote files.
+constexpr qint64 readBlockSize = 1024 * 1024;
+// Files from this size on are sampled before they are read completely.
+constexpr qint64 sampleThreshold = 8 * 1024 * 1024;
+constexpr qint64 sampleSize = 4096;
+
+std::vector<char>& readBuffer(const int n)
+{
+    // One pair per thread, folder comparisons call this for every file on several threads.
+    thread_local std::vector<char> buffers[2] = {std::vector<char>(readBlockSize), std::vector<char>(readBlockSize)};
+    return buffers[n];
+}
+
+bool readBlocksEqual(QFile& file1, QFile& file2, const qint64 pos, const qint64 length, bool& bError, QCryptographicHash* pHash)
+{
+    std::vector<char>& buf1 = readBuffer(0);
+    std::vector<char>& buf2 = readBuffer(1);
+
+    if(!file1.seek(pos) || !file2.seek(pos))
+    {
+        bError = true;
+        return false;
+    }
+
+    for(qint64 done = 0; done < length;)
+    {
+        const qint64 len = std::min(length - done, readBlockSize);
+        if(file1.read(buf1.data(), len) != len || file2.read(buf2.data(), len) != len)
+        {
+            bError = true;
+            return false;
+        }
+        if(memcmp(buf1.data(), buf2.data(), len) != 0)
+            return false;
+        if(pHash != nullptr)
+            pHash->addData(buf1.data(), (int)len);
+        done += len;
+    }
+    return true;
+}
+
+/*
+    Big files that differ mostly do so in their headers, time stamps or trailers. Comparing the
+    first and last blocks and three in between costs a few small reads and often saves reading
+    the whole files. Equal samples prove nothing, read errors are left to the full comparison.
+*/
+bool samplesDiffer(QFile& file1, QFile& file2, const qint64 size)
+{
+    const qint64 offsets[] = {0, size - sampleSize, size / 4, size / 2, 3 * (size / 4)};
+    for(const qint64 offset: offsets)
+    {
+        bool bReadError = false;
+        if(!readBlocksEqual(file1, file2, offset, sampleSize, bReadError, nullptr))
+            return !bReadError;
+    }
+    return false;
+}
+
+/*
+    Compares two local files of the given size without going through FileAccess.
+    Both files are mapped block by block and compared with memcmp, which is vectorized by the C library.
+    If pHash is given it receives the contents, it is only complete if the files are equal.
+*/
+bool compareLocalFiles(const QString& fileName1, const QString& fileName2, const qint64 size, bool& bError, QString& status, ProgressProxy& pp, QCryptographicHash* pHash)
+{
+    QFile file1(fileName1);
+    QFile file2(fileName2);
+
+    bError = true;
+    if(!file1.open(QIODevice::ReadOnly))
+    {
+        status = i18n("Opening %1 failed. %2", fileName1, file1.errorString());
+        return false;
+    }
+    if(!file2.open(QIODevice::ReadOnly))
+    {
+        status = i18n("Opening %1 failed. %2", fileName2, file2.errorString());
+        return false;
+    }
+
+    // Before the read ahead is raised, that would only fetch more around each sample.
+    if(size >= sampleThreshold && samplesDiffer(file1, file2, size))
+    {
+        qCInfo(kdiffMergeFileInfo) << "Samples differ.";
+        bError = false;
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Let the kernel read ahead further, both files are read once from start to end.
+    posix_fadvise(file1.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(file2.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    pp.setMaxNofSteps(size / mapBlockSize + 1);
+    for(qint64 pos = 0; pos < size && !pp.wasCancelled(); pos += mapBlockSize)
+    {
+        const qint64 len = std::min(size - pos, mapBlockSize);
+        bool bReadError = false;
+        bool bEqual;
+
+        uchar* p1 = file1.map(pos, len);
+        uchar* p2 = p1 != nullptr ? file2.map(pos, len) : nullptr;
+        if(p1 != nullptr && p2 != nullptr)
+        {
+            bEqual = memcmp(p1, p2, len) == 0;
+            if(bEqual && pHash != nullptr)
+                pHash->addData(reinterpret_cast<const char*>(p1), (int)len);
+        }
+        else
+        {
+            bEqual = readBlocksEqual(file1, file2, pos, len, bReadError, pHash);
+        }
+
+        if(p1 != nullptr)
+            file1.unmap(p1);
+        if(p2 != nullptr)
+            file2.unmap(p2);
+
+        if(bReadError)
+        {
+            status = i18n("Error reading from %1. %2", fileName1, file1.error() != QFileDevice::NoError ? file1.errorString() : file2.errorString());
+            return false;
+        }
+        if(!bEqual)
+        {
+            bError = false;
+            return false;
+        }
+        pp.step();
+    }
+
+    bError = false;
+    return true;
+}
+} // namespace
+
+bool MergeFileInfos::hashFile(const FileAccess& fi, QByteArray& digest, ProgressProxy& pp)
+{
+    if(!fi.isLocal())
+    {
+        QString errorString;
+        return RemoteHasher::hash(fi.url(), digest, errorString, [&pp]() { return pp.wasCancelled(); });
+    }
 
+    QFile file(fi.absoluteFilePath());
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if(!file.open(QIODevice::ReadOnly) || !hash.addData(&file))
+        return false;
+    digest = hash.result();
     return true;
 }
 
@@ -425,6 +760,22 @@ bool MergeFileInfos::fastFileComparison(
         }
     }
 
+    // Compressed differently the sizes may differ while the content is the same.
+    if(pOptions->m_bDmCompareDecompressed && fi1.isLocal() && fi2.isLocal() &&
+       CompressedInput::typeForName(fi1.fileName()) != KCompressionDevice::None && CompressedInput::typeForName(fi2.fileName()) != KCompressionDevice::None)
+    {
+        QString errorString;
+        if(CompressedInput::isEqual(fi1.absoluteFilePath(), fi2.absoluteFilePath(), bEqual, errorString))
+        {
+            qCInfo(kdiffMergeFileInfo) << "Compared decompressed content.";
+            bError = false;
+            status = i18n("Decompressed: ");
+            return bEqual;
+        }
+        // Not really compressed or damaged, the bytes are compared as they are.
+        qCInfo(kdiffMergeFileInfo) << errorString;
+    }
+
     if(fi1.size() != fi2.size())
     {
         qCInfo(kdiffMergeFileInfo) << "Sizes differ.";
@@ -461,8 +812,68 @@ bool MergeFileInfos::fastFileComparison(
         }
     }
 
-    std::vector<char> buf1(100000);
-    std::vector<char> buf2(buf1.size());
+    // Files git has hashed and that are unchanged since are equal exactly if their object IDs are.
+    if(pOptions->m_bDmUseGitIndex && fi1.isLocal() && fi2.isLocal())
+    {
+        QByteArray id1, id2;
+        if(GitIndex::objectId(fi1.absoluteFilePath(), id1) && GitIndex::objectId(fi2.absoluteFilePath(), id2) && id1.size() == id2.size())
+        {
+            qCInfo(kdiffMergeFileInfo) << "Compared object IDs from the git index.";
+            bError = false;
+            status = i18n("Git index: ");
+            return id1 == id2;
+        }
+    }
+
+    if(fi1.isLocal() && fi2.isLocal())
+    {
+        qCInfo(kdiffMergeFileInfo) << "Comparing local files...";
+        pp.setInformation(i18nc("Status message", "Comparing file..."), 0, false);
+        if(!pOptions->m_bDmUseHashCache)
+            return compareLocalFiles(fi1.absoluteFilePath(), fi2.absoluteFilePath(), fi1.size(), bError, status, pp, nullptr);
+
+        FileHashCache& cache = FileHashCache::instance();
+        FileHashCache::Stamp stamp1, stamp2;
+        // Stamps are taken first, a file that changes while it is read won't match them next time.
+        const bool bStamped = FileHashCache::stamp(fi1.absoluteFilePath(), stamp1) && FileHashCache::stamp(fi2.absoluteFilePath(), stamp2);
+
+        QByteArray hash1, hash2;
+        if(bStamped && cache.find(fi1.absoluteFilePath(), stamp1, hash1) && cache.find(fi2.absoluteFilePath(), stamp2, hash2))
+        {
+            qCInfo(kdiffMergeFileInfo) << "Both files unchanged since they were hashed.";
+            bError = false;
+            status = i18n("Cached hash: ");
+            return hash1 == hash2;
+        }
+
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        bEqual = compareLocalFiles(fi1.absoluteFilePath(), fi2.absoluteFilePath(), fi1.size(), bError, status, pp, &hash);
+        if(bEqual && bStamped && !pp.wasCancelled())
+        {
+            cache.insert(fi1.absoluteFilePath(), stamp1, hash.result());
+            cache.insert(fi2.absoluteFilePath(), stamp2, hash.result());
+        }
+        return bEqual;
+    }
+
+    // Hashing on the remote host only moves the digests, reading the files is the fallback.
+    if(pOptions->m_bDmRemoteHashing && (fi1.isLocal() || RemoteHasher::canHash(fi1.url())) && (fi2.isLocal() || RemoteHasher::canHash(fi2.url())))
+    {
+        pp.setInformation(i18nc("Status message", "Comparing file..."), 0, false);
+        QByteArray hash1, hash2;
+        if(hashFile(fi1, hash1, pp) && hashFile(fi2, hash2, pp))
+        {
+            qCInfo(kdiffMergeFileInfo) << "Compared hashes of remote files.";
+            bError = false;
+            status = i18n("Remote hash: ");
+            return hash1 == hash2;
+        }
+        if(pp.wasCancelled())
+            return bEqual;
+    }
+
+    std::vector<char>& buf1 = readBuffer(0);
+    std::vector<char>& buf2 = readBuffer(1);
 
     if(!fi1.open(QIODevice::ReadOnly))
     {
@@ -589,3 +1000,68 @@ QTextStream& operator<<(QTextStream& ts, MergeFileInfos& mfi)
 
     return ts;
 }
+
+namespace {
+typedef std::unordered_map<const FileAccess*, QString> t_mergeKeyCache;
+
+/*
+    Builds the key of a listed file from the key of its folder, so every name is appended only once.
+    The listing's root has no parent and is not part of the key.
+*/
+const QString& mergeKey(const FileAccess& fa, const bool bCaseSensitive, t_mergeKeyCache& keys)
+{
+    const auto it = keys.find(&fa);
+    if(it != keys.end())
+        return it->second;
+
+    const QString name = bCaseSensitive ? fa.fileName() : fa.fileName().toCaseFolded();
+    const FileAccess* pParent = fa.parent();
+    QString key = pParent == nullptr || pParent->parent() == nullptr ? name : mergeKey(*pParent, bCaseSensitive, keys) + '/' + name;
+
+    return keys.emplace(&fa, std::move(key)).first->second;
+}
+} // namespace
+
+void buildMergeMap(DirectoryInfo& dirInfo, const bool bCaseSensitive, t_fileMergeMap& fileMergeMap)
+{
+    size_t maxEntries = 0;
+    for(const DirectoryList* pDirList: {&dirInfo.getDirListA(), &dirInfo.getDirListB(), &dirInfo.getDirListC()})
+        maxEntries = std::max(maxEntries, pDirList->size());
+    fileMergeMap.reserve(maxEntries);
+
+    t_mergeKeyCache keys;
+    if(dirInfo.dirA().isValid())
+    {
+        keys.reserve(dirInfo.getDirListA().size());
+        for(FileAccess& fileRecord: dirInfo.getDirListA())
+        {
+            MergeFileInfos& mfi = fileMergeMap[mergeKey(fileRecord, bCaseSensitive, keys)];
+
+            mfi.setFileInfoA(&fileRecord);
+        }
+    }
+
+    if(dirInfo.dirB().isValid())
+    {
+        keys.clear();
+        keys.reserve(dirInfo.getDirListB().size());
+        for(FileAccess& fileRecord: dirInfo.getDirListB())
+        {
+            MergeFileInfos& mfi = fileMergeMap[mergeKey(fileRecord, bCaseSensitive, keys)];
+
+            mfi.setFileInfoB(&(fileRecord));
+        }
+    }
+
+    if(dirInfo.dirC().isValid())
+    {
+        keys.clear();
+        keys.reserve(dirInfo.getDirListC().size());
+        for(FileAccess& fileRecord: dirInfo.getDirListC())
+        {
+            MergeFileInfos& mfi = fileMergeMap[mergeKey(fileRecord, bCaseSensitive, keys)];
+
+            mfi.setFileInfoC(&(fileRecord));
+        }
+    }
+}
@@ -14,9 +14,14 @@
 #include "diff.h"
 #include "fileaccess.h"
 
+#include <unordered_map>
+
+#include <QByteArray>
 #include <QSharedPointer>
 #include <QString>
 
+class ProgressProxy;
+
 enum e_MergeOperation
 {
     eTitleId,
@@ -60,10 +65,23 @@ enum e_OperationStatus
     eOpStatusSkipped,
     eOpStatusNotSaved,
     eOpStatusInProgress,
-    eOpStatusToDo
+    eOpStatusToDo,
+    eOpStatusConflicts // Merged without widgets, conflicts are left to solve.
 };
 
-class DirectoryMergeWindow;
+/*
+    What the "Show ..." actions of the folder view select items by. Folders found in two or more
+    places that differ are always shown.
+*/
+enum e_VisibilityCategory : quint8
+{
+    eShowIdentical = 0x01,
+    eShowDifferent = 0x02,
+    eShowOnlyInA = 0x04,
+    eShowOnlyInB = 0x08,
+    eShowOnlyInC = 0x10,
+    eShowAlways = 0x20
+};
 
 class MergeFileInfos
 {
@@ -90,7 +108,12 @@ class MergeFileInfos
 
     [[nodiscard]] bool conflictingFileTypes() const;
 
+    // Sorts the children of this item and of all folders below it.
     void sort(Qt::SortOrder order);
+    // Case folded name and folder flag MfiCompare orders by, taken by sort().
+    void updateSortKey();
+    [[nodiscard]] inline const QString& sortKey() const { return m_sortKey; }
+    [[nodiscard]] inline bool sortsAsDir() const { return m_bSortAsDir; }
     [[nodiscard]] inline MergeFileInfos* parent() const { return m_pParent; }
     inline void setParent(MergeFileInfos* inParent) { m_pParent = inParent; }
     [[nodiscard]] inline const QList<MergeFileInfos*>& children() const { return m_children; }
@@ -130,11 +153,28 @@ class MergeFileInfos
     [[nodiscard]] inline bool isEqualAB() const { return m_bEqualAB; }
     [[nodiscard]] inline bool isEqualAC() const { return m_bEqualAC; }
     [[nodiscard]] inline bool isEqualBC() const { return m_bEqualBC; }
-    bool compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const& pOptions, DirectoryMergeWindow* pDMW);
+    bool compareFilesAndCalcAges(QStringList& errors, QSharedPointer<Options> const& pOptions);
 
-    void updateAge();
+    // Outcome of compareFiles(), kept apart from the item so the comparison can run on a worker thread.
+    struct Equality
+    {
+        bool bEqualAB = false;
+        bool bEqualAC = false;
+        bool bEqualBC = false;
+    };
+
+    // Compares the file contents without the full analysis. Only reads this item.
+    [[nodiscard]] Equality compareFiles(bool& bError, QString& status, const QSharedPointer<const Options>& pOptions) const;
+    // Same for the full analysis, which also fills diffStatus. Only reads this item, see FileAnalysis.
+    [[nodiscard]] Equality analyseFiles(TotalDiffStatus& diffStatus, bool& bError, QString& status, const QSharedPointer<const Options>& pOptions) const;
+    // Stores the result of compareFiles() and calculates the ages. Returns false on error.
+    bool setComparisonResult(const Equality& equality, const bool bError, const QString& status, QStringList& errors);
+    // True if every file of this item can be read without KIO.
+    [[nodiscard]] bool isLocal() const;
+    // Forgets the comparison result, before the files are compared again.
+    void resetComparison();
 
-    void updateParents();
+    void updateAge();
 
     void updateDirectoryOrLink();
     inline void startSimOp() { m_bSimOpComplete = false; }
@@ -160,7 +200,47 @@ class MergeFileInfos
 
     [[nodiscard]] bool conflictingAges() const { return m_bConflictingAges; }
 
+    /*
+        Taken for all items by DirectoryMergeWindow::updateFileVisibilities(), so toggling a
+        "Show ..." action needs neither the name patterns nor a walk over the whole tree. A folder
+        differs if it does on its own or if a shown item below it differs, the unequal masks hold
+        the categories of the items below that differ.
+    */
+    struct VisibilityMasks
+    {
+        bool bNameShown = true; // by the file and folder patterns
+        quint8 own = 0;         // Categories with the item's own equality, 0 if the patterns hide it.
+        quint8 below = 0;       // Categories the items below depend on.
+        quint8 unequalAB = 0;
+        quint8 unequalAC = 0;
+        quint8 unequalBC = 0;
+        bool bOwnEqualAB = true;
+        bool bOwnEqualAC = true;
+        bool bOwnEqualBC = true;
+    };
+    [[nodiscard]] inline VisibilityMasks& visibilityMasks() { return m_visibilityMasks; }
+    [[nodiscard]] inline const VisibilityMasks& visibilityMasks() const { return m_visibilityMasks; }
+    // e_VisibilityCategory flags for the current equality.
+    [[nodiscard]] quint8 visibilityCategories() const;
+    // Categories this item and the items below depend on.
+    [[nodiscard]] quint8 dependsOnCategories() const;
+    // Sets the equality of a folder for the shown categories.
+    void applyShownCategories(quint8 shown);
+    [[nodiscard]] bool isShownFor(quint8 shown) const;
+
+    // Last suggested operation, with the key of everything it was suggested for. See DirectoryMergeWindow.
+    [[nodiscard]] inline quint32 suggestionKey() const { return m_suggestionKey; }
+    [[nodiscard]] inline e_MergeOperation suggestedOperation() const { return m_eSuggestedOperation; }
+    inline void setSuggestion(const quint32 key, const e_MergeOperation eMergeOp)
+    {
+        m_suggestionKey = key;
+        m_eSuggestedOperation = eMergeOp;
+    }
+
   private:
+    // Bytes of all files of this item, for the statistics of a folder comparison.
+    [[nodiscard]] qint64 sizeOfFiles() const;
+
     [[nodiscard]] e_Age nextAgeValue(e_Age age)
     {
         switch(age)
@@ -179,7 +259,10 @@ class MergeFileInfos
         return age;
     }
 
-    bool fastFileComparison(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status, const QSharedPointer<const Options>& pOptions);
+    void calcAges();
+    static bool fastFileComparison(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status, const QSharedPointer<const Options>& pOptions);
+    // SHA-256 of a local file or of a remote one calculated on its host, see RemoteHasher.
+    static bool hashFile(const FileAccess& fi, QByteArray& digest, ProgressProxy& pp);
     inline void setAgeA(const e_Age inAge) { m_ageA = inAge; }
     inline void setAgeB(const e_Age inAge) { m_ageB = inAge; }
     inline void setAgeC(const e_Age inAge) { m_ageC = inAge; }
@@ -193,6 +276,14 @@ class MergeFileInfos
 
     TotalDiffStatus m_totalDiffStatus;
 
+    QString m_sortKey;
+    bool m_bSortAsDir = false;
+
+    VisibilityMasks m_visibilityMasks;
+
+    quint32 m_suggestionKey = 0;
+    e_MergeOperation m_eSuggestedOperation = eNoOperation;
+
     e_MergeOperation m_eMergeOperation = eNoOperation;
     e_OperationStatus m_eOpStatus = eOpStatusNone;
     e_Age m_ageA = eNotThere;
@@ -210,6 +301,13 @@ class MergeFileInfos
 
 QTextStream& operator<<(QTextStream& ts, MergeFileInfos& mfi);
 
+// Items by relative path. Nodes of std::unordered_map keep their address, the tree points to them.
+typedef std::unordered_map<QString, MergeFileInfos> t_fileMergeMap;
+
+// Adds an item for every path listed in A, B or C of dirInfo. The items point to the listed files.
+void buildMergeMap(DirectoryInfo& dirInfo, const bool bCaseSensitive, t_fileMergeMap& fileMergeMap);
+
+// Orders by the keys updateSortKey() took, folders first.
 class MfiCompare
 {
     Qt::SortOrder mOrder;
@@ -219,19 +317,19 @@ class MfiCompare
     {
         mOrder = order;
     }
-    bool operator()(MergeFileInfos* pMFI1, MergeFileInfos* pMFI2)
+    bool operator()(const MergeFileInfos* pMFI1, const MergeFileInfos* pMFI2) const
     {
-        bool bDir1 = pMFI1->isDirA() || pMFI1->isDirB() || pMFI1->isDirC();
-        bool bDir2 = pMFI2->isDirA() || pMFI2->isDirB() || pMFI2->isDirC();
+        const bool bDir1 = pMFI1->sortsAsDir();
+        const bool bDir2 = pMFI2->sortsAsDir();
         if(bDir1 == bDir2)
         {
             if(mOrder == Qt::AscendingOrder)
             {
-                return pMFI1->fileName().compare(pMFI2->fileName(), Qt::CaseInsensitive) < 0;
+                return pMFI1->sortKey() < pMFI2->sortKey();
             }
             else
             {
-                return pMFI1->fileName().compare(pMFI2->fileName(), Qt::CaseInsensitive) > 0;
+                return pMFI1->sortKey() > pMFI2->sortKey();
             }
         }
         else
@@ -0,0 +1,452 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "MergeOperationQueue.h"
+
+#include "BlockPatchJob.h"
+#include "defmac.h"
+#include "fileaccess.h"
+#include "LocalFileCopy.h"
+#include "TypeUtils.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+
+#include <KIO/CopyJob>
+#include <KIO/DeleteJob>
+#include <KIO/Job>
+#include <KJob>
+#include <KLocalizedString>
+
+namespace {
+QUrl toUrl(const QString& name)
+{
+    return QUrl::fromUserInput(name, QString(), QUrl::AssumeLocalFile);
+}
+} // namespace
+
+MergeOperationQueue::MergeOperationQueue(bool bCreateBackups, bool bFollowDirLinks, bool bFollowFileLinks, int maxRemoteJobs, bool bDeltaTransfer):
+    mCreateBackups(bCreateBackups), mFollowDirLinks(bFollowDirLinks), mFollowFileLinks(bFollowFileLinks), mMaxRemoteJobs(std::max(maxRemoteJobs, 1)),
+    mDeltaTransfer(bDeltaTransfer)
+{
+    // Mostly waiting for the disk, more threads than cores still pay off.
+    mPool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 2) * 2);
+}
+
+MergeOperationQueue::~MergeOperationQueue()
+{
+    mPool.waitForDone();
+}
+
+size_t MergeOperationQueue::addTask(std::vector<Step>&& steps)
+{
+    std::unique_ptr<Task> pTask = std::make_unique<Task>();
+    pTask->steps = std::move(steps);
+    for(const Step& step: pTask->steps)
+    {
+        if(!FileAccess::isLocal(toUrl(step.source)) || !FileAccess::isLocal(toUrl(step.destination)))
+            pTask->bLocal = false;
+    }
+
+    mTasks.push_back(std::move(pTask));
+    return mTasks.size() - 1;
+}
+
+void MergeOperationQueue::addDependency(size_t first, size_t then)
+{
+    mTasks[first]->dependents.push_back(then);
+    ++mTasks[then]->nofBlockers;
+}
+
+void MergeOperationQueue::run(const std::function<bool(size_t)>& keepGoing)
+{
+    for(size_t idx = 0; idx < mTasks.size(); ++idx)
+    {
+        if(mTasks[idx]->nofBlockers == 0)
+            mReady.push_back(idx);
+    }
+
+    QEventLoop loop;
+    QTimer timer;
+    const auto checkProgress = [this, &keepGoing]() {
+        if(!mStopped && !keepGoing(mNofFinished))
+        {
+            mStopped = true;
+            mReady.clear();
+        }
+    };
+    chk_connect_a(&timer, &QTimer::timeout, this, checkProgress);
+    timer.start(100);
+
+    mLoop = &loop;
+    startReadyTasks();
+    // A task finishing while others are still being started may quit the loop early.
+    while(mRunningLocal + mRunningRemote > 0)
+        loop.exec();
+    mLoop = nullptr;
+}
+
+void MergeOperationQueue::startReadyTasks()
+{
+    // Local tasks wait for a free thread in the pool, so only remote ones have to be held back here.
+    for(auto it = mReady.begin(); it != mReady.end() && !mStopped;)
+    {
+        const size_t idx = *it;
+        Task* pTask = mTasks[idx].get();
+        if(!pTask->bLocal && mRunningRemote >= mMaxRemoteJobs)
+        {
+            ++it;
+            continue;
+        }
+
+        it = mReady.erase(it);
+        pTask->bStarted = true;
+        if(pTask->bLocal)
+        {
+            ++mRunningLocal;
+            mPool.start([this, idx, pTask]() {
+                bool bSuccess = true;
+                for(const Step& step: pTask->steps)
+                {
+                    bSuccess = runLocalStep(step, pTask->result.messages);
+                    if(!bSuccess)
+                        break;
+                }
+
+                QMetaObject::invokeMethod(
+                    this, [this, idx, bSuccess]() { finishTask(idx, bSuccess); }, Qt::QueuedConnection);
+            });
+        }
+        else
+        {
+            ++mRunningRemote;
+            startRemoteTask(idx);
+            // Starting may have finished it already and changed mReady.
+            it = mReady.begin();
+        }
+    }
+}
+
+void MergeOperationQueue::finishTask(size_t idx, bool bSuccess)
+{
+    Task* pTask = mTasks[idx].get();
+    pTask->bFinished = true;
+    pTask->result.bSuccess = bSuccess;
+    ++mNofFinished;
+    if(pTask->bLocal)
+        --mRunningLocal;
+    else
+        --mRunningRemote;
+
+    // Whatever depends on a failed task is left for the caller, who stops at the failure anyway.
+    if(bSuccess && !mStopped)
+    {
+        for(const size_t dependent: pTask->dependents)
+        {
+            if(--mTasks[dependent]->nofBlockers == 0)
+                mReady.push_back(dependent);
+        }
+    }
+
+    startReadyTasks();
+    if(mRunningLocal + mRunningRemote == 0 && mLoop != nullptr)
+        mLoop->quit();
+}
+
+void MergeOperationQueue::startRemoteTask(size_t idx)
+{
+    Task* pTask = mTasks[idx].get();
+    for(const Step& step: pTask->steps)
+    {
+        if(!addRemoteJobs(step, *pTask))
+        {
+            pTask->remoteJobs.clear();
+            finishTask(idx, false);
+            return;
+        }
+    }
+
+    runNextRemoteJob(idx);
+}
+
+void MergeOperationQueue::runNextRemoteJob(size_t idx)
+{
+    Task* pTask = mTasks[idx].get();
+    if(pTask->remoteJobs.empty())
+    {
+        finishTask(idx, true);
+        return;
+    }
+
+    const RemoteJob remoteJob = std::move(pTask->remoteJobs.front());
+    pTask->remoteJobs.pop_front();
+
+    KJob* pJob = remoteJob.create();
+    const int ignoredError = remoteJob.ignoredError;
+    const auto jobDone = [this, idx, ignoredError](KJob* pDoneJob) {
+        if(pDoneJob->error() != KJob::NoError && pDoneJob->error() != ignoredError)
+        {
+            mTasks[idx]->result.messages.append(pDoneJob->errorString());
+            mTasks[idx]->remoteJobs.clear();
+            finishTask(idx, false);
+            return;
+        }
+        runNextRemoteJob(idx);
+    };
+    chk_connect_a(pJob, &KJob::result, this, jobDone);
+}
+
+/*
+    The remote counterparts of what runLocalStep() does. Existing destinations aren't looked up
+    first, that would cost another round trip per file. Instead the jobs overwrite and the errors
+    for missing files are ignored.
+*/
+bool MergeOperationQueue::addRemoteJobs(const Step& step, Task& task) const
+{
+    const QUrl sourceUrl = toUrl(step.source);
+    const QUrl destUrl = toUrl(step.destination);
+    QStringList& messages = task.result.messages;
+
+    switch(step.type)
+    {
+        case Step::copy:
+            if(step.source == step.destination)
+                return true;
+
+            if(step.bSourceIsLink && ((step.bSourceIsDir && !mFollowDirLinks) || (!step.bSourceIsDir && !mFollowFileLinks)))
+            {
+                messages.append(i18n("copyLink( %1 -> %2 )", step.source, step.destination));
+                messages.append(i18n("Error: copyLink failed: Remote links are not yet supported."));
+                return false;
+            }
+
+            if(step.bSourceIsDir)
+            {
+                messages.append(i18n("makeDir( %1 )", step.destination));
+                task.remoteJobs.push_back({[destUrl]() { return KIO::mkdir(destUrl); }, KIO::ERR_DIR_ALREADY_EXIST});
+                return true;
+            }
+
+            if(mCreateBackups)
+            {
+                const QUrl backupUrl = toUrl(step.destination + ".orig");
+                messages.append(i18n("rename( %1 -> %2 )", step.destination, step.destination + ".orig"));
+                task.remoteJobs.push_back({[destUrl, backupUrl]() { return KIO::moveAs(destUrl, backupUrl, KIO::HideProgressInfo | KIO::Overwrite); },
+                                           KIO::ERR_DOES_NOT_EXIST});
+            }
+
+            messages.append(i18n("copy( %1 -> %2 )", step.source, step.destination));
+            // A backup moved the destination away, there is nothing to patch then.
+            if(mDeltaTransfer && !mCreateBackups && FileAccess::isLocal(sourceUrl))
+            {
+                task.remoteJobs.push_back({[sourceUrl, destUrl]() {
+                                               BlockPatchJob* pJob = new BlockPatchJob(sourceUrl.toLocalFile(), destUrl);
+                                               pJob->start();
+                                               return pJob;
+                                           },
+                                           0});
+                return true;
+            }
+            task.remoteJobs.push_back({[sourceUrl, destUrl]() { return KIO::file_copy(sourceUrl, destUrl, -1, KIO::HideProgressInfo | KIO::Overwrite); }, 0});
+            return true;
+
+        case Step::remove:
+            if(mCreateBackups)
+            {
+                const QUrl backupUrl = toUrl(step.destination + ".orig");
+                messages.append(i18n("rename( %1 -> %2 )", step.destination, step.destination + ".orig"));
+                task.remoteJobs.push_back({[destUrl, backupUrl]() { return KIO::moveAs(destUrl, backupUrl, KIO::HideProgressInfo | KIO::Overwrite); },
+                                           KIO::ERR_DOES_NOT_EXIST});
+            }
+            else
+            {
+                messages.append(i18n("delete( %1 )", step.destination));
+                task.remoteJobs.push_back({[destUrl]() { return KIO::del(destUrl, KIO::HideProgressInfo); }, KIO::ERR_DOES_NOT_EXIST});
+            }
+            return true;
+
+        case Step::makeDir:
+            messages.append(i18n("makeDir( %1 )", step.destination));
+            task.remoteJobs.push_back({[destUrl]() { return KIO::mkdir(destUrl); }, KIO::ERR_DIR_ALREADY_EXIST});
+            return true;
+    }
+
+    return false;
+}
+
+// The following run in a worker thread and mirror copyFLD(), deleteFLD(), renameFLD() and makeDir() of the merge window.
+bool MergeOperationQueue::runLocalStep(const Step& step, QStringList& messages) const
+{
+    switch(step.type)
+    {
+        case Step::copy:
+            return copyLocal(step.source, step.destination, messages);
+        case Step::remove:
+            return removeLocal(step.destination, mCreateBackups, messages);
+        case Step::makeDir:
+            return makeDirLocal(step.destination, false, messages);
+    }
+
+    return false;
+}
+
+bool MergeOperationQueue::copyLocal(const QString& srcName, const QString& destName, QStringList& messages) const
+{
+    if(srcName == destName)
+        return true;
+
+    const FileAccess fi(srcName);
+    const FileAccess faDest(destName, true);
+    if(faDest.exists() && !(fi.isDir() && faDest.isDir() && (fi.isSymLink() == faDest.isSymLink())))
+    {
+        if(!removeLocal(destName, mCreateBackups, messages))
+        {
+            messages.append(i18n("Error: copy( %1 -> %2 ) failed."
+                                 "Deleting existing destination failed.",
+                                 srcName, destName));
+            return false;
+        }
+    }
+
+    if(fi.isSymLink() && ((fi.isDir() && !mFollowDirLinks) || (!fi.isDir() && !mFollowFileLinks)))
+    {
+        messages.append(i18n("copyLink( %1 -> %2 )", srcName, destName));
+
+        const QString linkTarget = fi.readLink();
+        if(linkTarget.isEmpty() || !FileAccess::symLink(linkTarget, destName))
+        {
+            messages.append(i18n("Error: copyLink failed."));
+            return false;
+        }
+        return true;
+    }
+
+    if(fi.isDir())
+    {
+        if(faDest.exists())
+            return true;
+
+        return makeDirLocal(destName, false, messages);
+    }
+
+    const QtSizeType pos = destName.lastIndexOf('/');
+    if(pos > 0 && !makeDirLocal(destName.left(pos), true, messages))
+        return false;
+
+    messages.append(i18n("copy( %1 -> %2 )", srcName, destName));
+
+    QString errorString;
+    if(!LocalFileCopy::copy(srcName, destName, errorString))
+    {
+        messages.append(i18n("Error: copy( %1 -> %2 ) failed: %3", srcName, destName, errorString));
+        return false;
+    }
+    return true;
+}
+
+bool MergeOperationQueue::removeLocal(const QString& name, bool bCreateBackup, QStringList& messages) const
+{
+    const FileAccess fi(name, true);
+    if(!fi.exists())
+        return true;
+
+    if(bCreateBackup)
+    {
+        if(!renameLocal(name, name + ".orig", messages))
+        {
+            messages.append(i18n("Error: While deleting %1: Creating backup failed.", name));
+            return false;
+        }
+        return true;
+    }
+
+    if(fi.isDir() && !fi.isSymLink()) // recursive directory delete only for real dirs, not symlinks
+    {
+        messages.append(i18n("delete folder recursively( %1 )", name));
+        if(!QDir(name).removeRecursively())
+        {
+            messages.append(i18n("Error: rmdir( %1 ) operation failed.", name)); // krazy:exclude=syscalls
+            return false;
+        }
+        return true;
+    }
+
+    messages.append(i18n("delete( %1 )", name));
+    if(!QFile::remove(name))
+    {
+        messages.append(i18n("Error: delete operation failed."));
+        return false;
+    }
+    return true;
+}
+
+// Only used for backups, an existing destination is replaced without a backup of the old backup.
+bool MergeOperationQueue::renameLocal(const QString& srcName, const QString& destName, QStringList& messages) const
+{
+    if(srcName == destName)
+        return true;
+
+    if(!removeLocal(destName, false, messages))
+    {
+        messages.append(i18n("Error during rename( %1 -> %2 ): "
+                             "Cannot delete existing destination.",
+                             srcName, destName));
+        return false;
+    }
+
+    messages.append(i18n("rename( %1 -> %2 )", srcName, destName));
+    if(!QDir().rename(srcName, destName))
+    {
+        messages.append(i18n("Error: Rename failed."));
+        return false;
+    }
+    return true;
+}
+
+bool MergeOperationQueue::makeDirLocal(const QString& name, bool bQuiet, QStringList& messages) const
+{
+    const FileAccess fi(name, true);
+    if(fi.exists() && fi.isDir())
+        return true;
+
+    if(fi.exists() && !fi.isDir())
+    {
+        if(!removeLocal(name, true, messages))
+        {
+            messages.append(i18n("Error during makeDir of %1. "
+                                 "Cannot delete existing file.",
+                                 name));
+            return false;
+        }
+    }
+
+    const QtSizeType pos = name.lastIndexOf('/');
+    if(pos > 0 && !makeDirLocal(name.left(pos), true, messages))
+        return false;
+
+    if(!bQuiet)
+        messages.append(i18n("makeDir( %1 )", name));
+
+    // Another task may have created it meanwhile.
+    if(!QDir().mkdir(name) && !QFileInfo(name).isDir())
+    {
+        messages.append(i18n("Error while creating folder."));
+        return false;
+    }
+    return true;
+}
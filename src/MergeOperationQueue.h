@@ -0,0 +1,133 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef MERGEOPERATIONQUEUE_H
+#define MERGEOPERATIONQUEUE_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+class KJob;
+class QEventLoop;
+
+/*
+    Runs the copies and deletes of a folder merge concurrently.
+
+    A task is what one item of the merge list does, a task that depends on another one only
+    starts after that one succeeded. Tasks on local files run on a thread pool with plain file
+    system calls. Tasks touching a KIO url start their jobs from the gui thread and are only
+    waited for, so up to maxRemoteJobs requests to a slow server are in flight at the same time.
+    With bDeltaTransfer a local file replacing a remote one only sends what changed, see
+    BlockPatchJob. That needs the destination to stay in place, so not with backups.
+
+    Messages are collected per task, the caller shows them in item order.
+*/
+class MergeOperationQueue: public QObject
+{
+    Q_OBJECT
+  public:
+    struct Step
+    {
+        enum Type
+        {
+            copy,
+            remove,
+            makeDir
+        };
+
+        Type type = copy;
+        QString source;
+        QString destination;
+        // What the comparison found for the source, a remote one isn't looked at again.
+        bool bSourceIsDir = false;
+        bool bSourceIsLink = false;
+    };
+
+    struct Result
+    {
+        bool bSuccess = false;
+        QStringList messages;
+    };
+
+    MergeOperationQueue(bool bCreateBackups, bool bFollowDirLinks, bool bFollowFileLinks, int maxRemoteJobs, bool bDeltaTransfer);
+    ~MergeOperationQueue() override;
+
+    // Returns the id of the new task.
+    size_t addTask(std::vector<Step>&& steps);
+    // then only starts after first succeeded.
+    void addDependency(size_t first, size_t then);
+
+    /*
+        Runs the tasks and returns when all of them are done or were skipped. keepGoing is called
+        about ten times per second with the number of finished tasks, returning false stops
+        starting new ones.
+    */
+    void run(const std::function<bool(size_t)>& keepGoing);
+
+    // False if the task was never started.
+    [[nodiscard]] bool isFinished(size_t task) const { return mTasks[task]->bFinished; }
+    [[nodiscard]] const Result& result(size_t task) const { return mTasks[task]->result; }
+
+  private:
+    struct RemoteJob
+    {
+        std::function<KJob*()> create;
+        // An error that just means there was nothing to do.
+        int ignoredError = 0;
+    };
+
+    struct Task
+    {
+        std::vector<Step> steps;
+        bool bLocal = true;
+        std::vector<size_t> dependents;
+        int nofBlockers = 0;
+        bool bStarted = false;
+        bool bFinished = false;
+        Result result;
+        std::deque<RemoteJob> remoteJobs;
+    };
+
+    void startReadyTasks();
+    void startRemoteTask(size_t idx);
+    void runNextRemoteJob(size_t idx);
+    void finishTask(size_t idx, bool bSuccess);
+
+    bool runLocalStep(const Step& step, QStringList& messages) const;
+    bool addRemoteJobs(const Step& step, Task& task) const;
+    bool copyLocal(const QString& srcName, const QString& destName, QStringList& messages) const;
+    bool removeLocal(const QString& name, bool bCreateBackup, QStringList& messages) const;
+    bool renameLocal(const QString& srcName, const QString& destName, QStringList& messages) const;
+    bool makeDirLocal(const QString& name, bool bQuiet, QStringList& messages) const;
+
+    bool mCreateBackups;
+    bool mFollowDirLinks;
+    bool mFollowFileLinks;
+    int mMaxRemoteJobs;
+    bool mDeltaTransfer;
+
+    std::vector<std::unique_ptr<Task>> mTasks;
+    std::deque<size_t> mReady;
+    size_t mNofFinished = 0;
+    int mRunningLocal = 0;
+    int mRunningRemote = 0;
+    bool mStopped = false;
+    QEventLoop* mLoop = nullptr;
+
+    QThreadPool mPool;
+};
+
+#endif
@@ -0,0 +1,145 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "MergeResultWriter.h"
+
+#include "fileaccess.h"
+
+#include <algorithm>
+
+#include <QIODevice>
+
+MergeResultWriter::MergeResultWriter(const MergeBlockList& mergeBlockList, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+                                     const std::shared_ptr<LineDataVector>& pldA, const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC):
+    mMergeBlockList(mergeBlockList),
+    mPldA(pldA),
+    mPldB(pldB),
+    mPldC(pldC),
+    mLineFeed(eLineEndStyle == eLineEndStyleDos ? QString("\r\n") : QString("\n")),
+    // Like QTextStream::setGenerateByteOrderMark: no BOM for plain UTF-8, the codec's own for UTF-16.
+    mEncoder(pEncoding->makeEncoder(pEncoding->name() == "UTF-8" ? QTextCodec::IgnoreHeader : QTextCodec::DefaultConversion)),
+    mBlockIt(mergeBlockList.list().cbegin())
+{
+}
+
+void MergeResultWriter::setConflictMarkers(const QString& labelA, const QString& labelB, const QString& labelC)
+{
+    mbConflictMarkers = true;
+    mLabelA = labelA;
+    mLabelB = labelB;
+    mLabelC = labelC;
+}
+
+void MergeResultWriter::addLine(QString& text, const QString& line)
+{
+    if(mLinesWritten > 0)
+        text += mLineFeed;
+    text += line;
+    ++mLinesWritten;
+}
+
+void MergeResultWriter::addConflict(QString& text, const MergeBlock& mb)
+{
+    const bool bThreeWay = !mLabelC.isEmpty();
+    const auto addSource = [this, &text, &mb](const e_SrcSelector src) {
+        Diff3LineList::const_iterator it = mb.id3l();
+        for(LineType i = 0; i < mb.sourceRangeLength(); ++i, ++it)
+        {
+            const LineRef line = it->getLineInFile(src);
+            if(line.isValid())
+                addLine(text, (*(src == e_SrcSelector::A ? mPldA : src == e_SrcSelector::B ? mPldB : mPldC))[line].getLine());
+        }
+    };
+
+    if(bThreeWay)
+    {
+        addLine(text, QLatin1String("<<<<<<< ") + mLabelB);
+        addSource(e_SrcSelector::B);
+        addLine(text, QLatin1String("||||||| ") + mLabelA);
+        addSource(e_SrcSelector::A);
+        addLine(text, QStringLiteral("======="));
+        addSource(e_SrcSelector::C);
+        addLine(text, QLatin1String(">>>>>>> ") + mLabelC);
+    }
+    else
+    {
+        addLine(text, QLatin1String("<<<<<<< ") + mLabelA);
+        addSource(e_SrcSelector::A);
+        addLine(text, QStringLiteral("======="));
+        addSource(e_SrcSelector::B);
+        addLine(text, QLatin1String(">>>>>>> ") + mLabelB);
+    }
+}
+
+QByteArray MergeResultWriter::nextChunk()
+{
+    QString text;
+    text.reserve(s_chunkSize + 1024);
+
+    while(mBlockIt != mMergeBlockList.list().cend())
+    {
+        if(mbAtBlockStart)
+        {
+            mLineIt = mBlockIt->list().cbegin();
+            mbAtBlockStart = false;
+
+            // A conflict the user resolved in part has no conflict line left.
+            if(mbConflictMarkers && std::any_of(mBlockIt->list().cbegin(), mBlockIt->list().cend(), [](const MergeEditLine& mel) { return mel.isConflict(); }))
+            {
+                addConflict(text, *mBlockIt);
+                mLineIt = mBlockIt->list().cend();
+            }
+        }
+
+        if(mLineIt == mBlockIt->list().cend())
+        {
+            ++mBlockIt;
+            mbAtBlockStart = true;
+            continue;
+        }
+
+        const MergeEditLine& mel = *mLineIt;
+        ++mLineIt;
+        if(!mel.isEditableText())
+            continue;
+
+        // Put line feed between lines, but not for the first line or between lines that have
+        // been removed (because there isn't a line there).
+        if(mLinesWritten > 0 && !mel.isRemoved())
+            text += mLineFeed;
+
+        text += mel.getString(mPldA, mPldB, mPldC);
+        ++mLinesWritten;
+
+        if(text.length() >= s_chunkSize)
+        {
+            const QByteArray encoded = mEncoder->fromUnicode(text);
+            if(!encoded.isEmpty())
+                return encoded;
+            text.clear();
+        }
+    }
+
+    return text.isEmpty() ? QByteArray() : mEncoder->fromUnicode(text);
+}
+
+bool MergeResultWriter::write(FileAccess& file, const QString& bakExtension)
+{
+    return file.writeFile([this]() { return nextChunk(); }, bakExtension);
+}
+
+bool MergeResultWriter::write(QIODevice& device)
+{
+    for(QByteArray chunk = nextChunk(); !chunk.isEmpty(); chunk = nextChunk())
+    {
+        if(device.write(chunk) != chunk.size())
+            return false;
+    }
+    return true;
+}
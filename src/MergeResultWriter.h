@@ -0,0 +1,72 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef MERGERESULTWRITER_H
+#define MERGERESULTWRITER_H
+
+#include "MergeEditLine.h"
+#include "options.h"
+
+#include <memory>
+
+#include <QByteArray>
+#include <QString>
+#include <QTextCodec>
+
+class FileAccess;
+class QIODevice;
+class LineDataVector;
+
+/*
+    Encodes a merge result a block at a time. Only one block of text and its encoded bytes exist at
+    any time, instead of the whole document as QString and again as QByteArray.
+
+    Unsolved conflicts are left out, unless conflict markers were asked for. Then they are written
+    like diff3 -m does, with the lines of all inputs.
+*/
+class MergeResultWriter
+{
+  public:
+    MergeResultWriter(const MergeBlockList& mergeBlockList, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle,
+                      const std::shared_ptr<LineDataVector>& pldA, const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC);
+
+    // Labels of the markers, labelC is empty for two inputs. A is the base of three.
+    void setConflictMarkers(const QString& labelA, const QString& labelB, const QString& labelC);
+
+    // Returns the next block of encoded output, an empty one once everything was returned.
+    [[nodiscard]] QByteArray nextChunk();
+
+    // An existing file is kept as a backup if bakExtension isn't empty, see FileAccess::writeFile.
+    bool write(FileAccess& file, const QString& bakExtension = QString());
+    bool write(QIODevice& device);
+
+  private:
+    static constexpr QtSizeType s_chunkSize = 1 << 20; // In characters.
+
+    void addLine(QString& text, const QString& line);
+    void addConflict(QString& text, const MergeBlock& mb);
+
+    const MergeBlockList& mMergeBlockList;
+    std::shared_ptr<LineDataVector> mPldA;
+    std::shared_ptr<LineDataVector> mPldB;
+    std::shared_ptr<LineDataVector> mPldC;
+    const QString mLineFeed;
+    std::unique_ptr<QTextEncoder> mEncoder;
+    bool mbConflictMarkers = false;
+    QString mLabelA;
+    QString mLabelB;
+    QString mLabelC;
+
+    MergeBlockListImp::const_iterator mBlockIt;
+    MergeEditLineList::const_iterator mLineIt;
+    bool mbAtBlockStart = true;
+    LineType mLinesWritten = 0;
+};
+
+#endif
@@ -0,0 +1,311 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "MergeStateFile.h"
+
+#include "TypeUtils.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <KLocalizedString>
+
+namespace {
+constexpr quint32 fileMagic = 0x534D444B;  // "KDMS"
+constexpr quint32 fileVersion = 1;
+constexpr quint32 chunkMagic = 0x4B4E4843; // "CHNK"
+constexpr qint64 chunkHeaderSize = 16;
+constexpr qint64 nameRecordSize = 8;  // Parent node and length.
+constexpr qint64 entryRecordSize = 8; // Node and packed state.
+
+constexpr quint32 flagMask = 0x3FFF;
+constexpr int operationShift = 16;
+constexpr int opStatusShift = 21;
+constexpr int ageShift = 24;
+
+void appendU16(QByteArray& out, quint16 value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendU32(QByteArray& out, quint32 value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+quint32 readU32(const uchar* p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+quint32 pack(const MergeStateFile::Entry& entry)
+{
+    return (entry.flags & flagMask) | ((quint32)entry.operation << operationShift) | ((quint32)entry.opStatus << opStatusShift) |
+           (((quint32)entry.ageA & 3) << ageShift) | (((quint32)entry.ageB & 3) << (ageShift + 2)) | (((quint32)entry.ageC & 3) << (ageShift + 4));
+}
+
+bool unpack(const quint32 packed, MergeStateFile::Entry& entry)
+{
+    const quint32 operation = (packed >> operationShift) & 0x1F;
+    const quint32 opStatus = (packed >> opStatusShift) & 0x7;
+    if(operation > eConflictingAges || opStatus > eOpStatusConflicts)
+        return false;
+
+    entry.flags = packed & flagMask;
+    entry.operation = (e_MergeOperation)operation;
+    entry.opStatus = (e_OperationStatus)opStatus;
+    entry.ageA = (e_Age)((packed >> ageShift) & 3);
+    entry.ageB = (e_Age)((packed >> (ageShift + 2)) & 3);
+    entry.ageC = (e_Age)((packed >> (ageShift + 4)) & 3);
+    return true;
+}
+} // namespace
+
+bool MergeStateFile::Entry::hasSameState(const Entry& other) const
+{
+    return flags == other.flags && operation == other.operation && opStatus == other.opStatus &&
+           ageA == other.ageA && ageB == other.ageB && ageC == other.ageC;
+}
+
+void MergeStateFile::clear()
+{
+    mFileName.clear();
+    mPaths.clear();
+    mNodes.clear();
+    mEntryOfNode.clear();
+    mEntries.clear();
+}
+
+const MergeStateFile::Entry* MergeStateFile::find(const QString& subPath) const
+{
+    const auto it = mNodes.find(subPath);
+    if(it == mNodes.end() || mEntryOfNode[it->second] < 0)
+        return nullptr;
+    return &mEntries[mEntryOfNode[it->second]];
+}
+
+bool MergeStateFile::load(const QString& fileName)
+{
+    clear();
+    mErrorString.clear();
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        mErrorString = file.errorString();
+        return false;
+    }
+
+    // Mapped the parsing reads straight from the page cache, readAll() is the fallback.
+    QByteArray buffer;
+    qint64 size = file.size();
+    const uchar* pData = size > 0 ? file.map(0, size) : nullptr;
+    if(pData == nullptr)
+    {
+        buffer = file.readAll();
+        size = buffer.size();
+        pData = reinterpret_cast<const uchar*>(buffer.constData());
+    }
+
+    if(!parse(pData, size))
+    {
+        clear();
+        return false;
+    }
+
+    mFileName = fileName;
+    return true;
+}
+
+bool MergeStateFile::parse(const uchar* pData, const qint64 size)
+{
+    if(size < 8 || readU32(pData) != fileMagic || readU32(pData + 4) != fileVersion)
+    {
+        mErrorString = i18n("Not a folder merge state file or written by another version.");
+        return false;
+    }
+
+    const auto corrupt = [this]() {
+        mErrorString = i18n("The folder merge state file is damaged.");
+        return false;
+    };
+
+    qint64 pos = 8;
+    while(pos + chunkHeaderSize <= size)
+    {
+        const uchar* pChunk = pData + pos;
+        if(readU32(pChunk) != chunkMagic)
+            return corrupt();
+
+        const quint32 nameCount = readU32(pChunk + 4);
+        const quint32 nameUnits = readU32(pChunk + 8);
+        const quint32 entryCount = readU32(pChunk + 12);
+        const qint64 textSize = ((qint64)nameUnits * 2 + 3) / 4 * 4;
+        const qint64 chunkSize = chunkHeaderSize + nameCount * nameRecordSize + textSize + entryCount * entryRecordSize;
+        // Appending was interrupted, what came before is complete.
+        if(pos + chunkSize > size)
+            break;
+
+        const uchar* pNames = pChunk + chunkHeaderSize;
+        const uchar* pText = pNames + nameCount * nameRecordSize;
+        const uchar* pEntries = pText + textSize;
+
+        qint64 textPos = 0;
+        for(quint32 i = 0; i < nameCount; ++i)
+        {
+            const quint32 parent = readU32(pNames + i * nameRecordSize);
+            const quint32 length = readU32(pNames + i * nameRecordSize + 4);
+            if(textPos + length > nameUnits || (parent != noParent && parent >= mPaths.size()))
+                return corrupt();
+
+            QString name((QtSizeType)length, Qt::Uninitialized);
+            for(quint32 j = 0; j < length; ++j)
+                name[(QtSizeType)j] = QChar(qFromLittleEndian<quint16>(pText + (textPos + j) * 2));
+            textPos += length;
+
+            const QString path = parent == noParent ? name : mPaths[parent] + '/' + name;
+            mNodes.emplace(path, (quint32)mPaths.size());
+            mPaths.push_back(path);
+            mEntryOfNode.push_back(-1);
+        }
+
+        for(quint32 i = 0; i < entryCount; ++i)
+        {
+            const quint32 node = readU32(pEntries + i * entryRecordSize);
+            Entry entry;
+            if(node >= mPaths.size() || !unpack(readU32(pEntries + i * entryRecordSize + 4), entry))
+                return corrupt();
+            store(node, entry);
+        }
+
+        pos += chunkSize;
+    }
+
+    return true;
+}
+
+bool MergeStateFile::save(const QString& fileName, const std::vector<Entry>& entries)
+{
+    clear();
+    mErrorString.clear();
+
+    std::vector<const Entry*> pointers;
+    pointers.reserve(entries.size());
+    for(const Entry& entry: entries)
+        pointers.push_back(&entry);
+
+    QByteArray data;
+    appendU32(data, fileMagic);
+    appendU32(data, fileVersion);
+    data += chunk(pointers);
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        mErrorString = file.errorString();
+        clear();
+        return false;
+    }
+
+    mFileName = fileName;
+    return true;
+}
+
+bool MergeStateFile::update(const std::vector<Entry>& entries)
+{
+    assert(!mFileName.isEmpty());
+    mErrorString.clear();
+
+    std::vector<const Entry*> changed;
+    for(const Entry& entry: entries)
+    {
+        const Entry* pKnown = find(entry.subPath);
+        if(pKnown == nullptr || !pKnown->hasSameState(entry))
+            changed.push_back(&entry);
+    }
+    if(changed.empty())
+        return true;
+
+    const QByteArray data = chunk(changed);
+    QFile file(mFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(data) != data.size())
+    {
+        // What is held no longer matches the file.
+        mErrorString = file.errorString();
+        clear();
+        return false;
+    }
+    return true;
+}
+
+quint32 MergeStateFile::node(const QString& subPath, QByteArray& nameTable, QByteArray& nameText)
+{
+    const auto it = mNodes.find(subPath);
+    if(it != mNodes.end())
+        return it->second;
+
+    const QtSizeType slash = subPath.lastIndexOf('/');
+    const quint32 parent = slash < 0 ? noParent : node(subPath.left(slash), nameTable, nameText);
+    const QString name = slash < 0 ? subPath : subPath.mid(slash + 1);
+
+    appendU32(nameTable, parent);
+    appendU32(nameTable, (quint32)name.size());
+    for(const QChar c: name)
+        appendU16(nameText, c.unicode());
+
+    const quint32 id = (quint32)mPaths.size();
+    mNodes.emplace(subPath, id);
+    mPaths.push_back(subPath);
+    mEntryOfNode.push_back(-1);
+    return id;
+}
+
+QByteArray MergeStateFile::chunk(const std::vector<const Entry*>& entries)
+{
+    QByteArray nameTable, nameText, entryData;
+    entryData.reserve((QtSizeType)(entries.size() * entryRecordSize));
+    for(const Entry* pEntry: entries)
+    {
+        const quint32 id = node(pEntry->subPath, nameTable, nameText);
+        appendU32(entryData, id);
+        appendU32(entryData, pack(*pEntry));
+        store(id, *pEntry);
+    }
+    const quint32 nameUnits = (quint32)(nameText.size() / 2);
+    if(nameText.size() % 4 != 0)
+        appendU16(nameText, 0);
+
+    QByteArray result;
+    result.reserve((QtSizeType)chunkHeaderSize + nameTable.size() + nameText.size() + entryData.size());
+    appendU32(result, chunkMagic);
+    appendU32(result, (quint32)(nameTable.size() / nameRecordSize));
+    appendU32(result, nameUnits);
+    appendU32(result, (quint32)entries.size());
+    result += nameTable;
+    result += nameText;
+    result += entryData;
+    return result;
+}
+
+void MergeStateFile::store(const quint32 node, const Entry& entry)
+{
+    qint64& index = mEntryOfNode[node];
+    if(index < 0)
+    {
+        index = (qint64)mEntries.size();
+        mEntries.push_back(entry);
+    }
+    else
+        mEntries[index] = entry;
+    // Shares the string with mPaths.
+    mEntries[index].subPath = mPaths[node];
+}
@@ -0,0 +1,99 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef MERGESTATEFILE_H
+#define MERGESTATEFILE_H
+
+#include "MergeFileInfos.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+/*
+    Binary file of the merge state of the items of a folder merge.
+
+    After a header the file is a sequence of chunks. A chunk adds the names it needs to a tree of
+    path components shared by the whole file, so each folder name is stored once, and then packs
+    every item into eight bytes: its path by number, flags, operation, status and ages. A chunk can
+    be appended to a file written before to record what changed; a later entry for a path replaces
+    an earlier one. All numbers are little endian and aligned to four bytes, loading maps the file
+    and only builds the path strings. A chunk cut short, by a crash while appending, is ignored.
+*/
+class MergeStateFile
+{
+  public:
+    enum Flag : quint32
+    {
+        existsInA = 1 << 0,
+        existsInB = 1 << 1,
+        existsInC = 1 << 2,
+        equalAB = 1 << 3,
+        equalAC = 1 << 4,
+        equalBC = 1 << 5,
+        dirA = 1 << 6,
+        dirB = 1 << 7,
+        dirC = 1 << 8,
+        linkA = 1 << 9,
+        linkB = 1 << 10,
+        linkC = 1 << 11,
+        operationComplete = 1 << 12,
+        conflictingAges = 1 << 13
+    };
+
+    struct Entry
+    {
+        QString subPath;
+        quint32 flags = 0;
+        e_MergeOperation operation = eNoOperation;
+        e_OperationStatus opStatus = eOpStatusNone;
+        e_Age ageA = eNotThere;
+        e_Age ageB = eNotThere;
+        e_Age ageC = eNotThere;
+
+        // Equal apart from the path.
+        [[nodiscard]] bool hasSameState(const Entry& other) const;
+    };
+
+    // Replaces what is held with the content of the file.
+    bool load(const QString& fileName);
+    // Writes a new file with the entries.
+    bool save(const QString& fileName, const std::vector<Entry>& entries);
+    // Appends the entries that differ from what the file last loaded or saved holds.
+    bool update(const std::vector<Entry>& entries);
+
+    [[nodiscard]] const QString& fileName() const { return mFileName; }
+    [[nodiscard]] QString errorString() const { return mErrorString; }
+
+    [[nodiscard]] size_t size() const { return mEntries.size(); }
+    [[nodiscard]] const std::vector<Entry>& entries() const { return mEntries; }
+    // nullptr if the path has no entry.
+    [[nodiscard]] const Entry* find(const QString& subPath) const;
+
+  private:
+    static constexpr quint32 noParent = 0xFFFFFFFF;
+
+    void clear();
+    // Number of the path. Nodes for it and its folders that aren't known yet are added to the name table and text of a chunk.
+    quint32 node(const QString& subPath, QByteArray& nameTable, QByteArray& nameText);
+    [[nodiscard]] QByteArray chunk(const std::vector<const Entry*>& entries);
+    void store(const quint32 node, const Entry& entry);
+    bool parse(const uchar* pData, const qint64 size);
+
+    QString mFileName;
+    QString mErrorString;
+    std::vector<QString> mPaths; // By node.
+    std::unordered_map<QString, quint32> mNodes;
+    std::vector<qint64> mEntryOfNode; // Index into mEntries, -1 if none.
+    std::vector<Entry> mEntries;
+};
+
+#endif
@@ -0,0 +1,82 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "MonospaceText.h"
+
+#include "Utils.h"
+
+#include <QFontMetrics>
+#include <QPainter>
+
+bool MonospaceText::isSimple(const QString& s)
+{
+    for(const QChar c: s)
+    {
+        const char16_t u = c.unicode();
+        // Latin up to the spacing modifiers, without C0 and C1 controls and the soft hyphen.
+        if(u >= 0x0300 || (u < 0x20 && u != '\t') || (u >= 0x7f && u < 0xa0) || u == 0xad)
+            return false;
+    }
+    return true;
+}
+
+MonospaceText::MonospaceText(const QString& s, const QVector<QTextLayout::FormatRange>& formats, const QColor& foreground, const int tabSize, const QFont& font):
+    MonospaceText(s, formats, foreground, tabSize, QFontMetrics(font))
+{
+}
+
+MonospaceText::MonospaceText(const QString& s, const QVector<QTextLayout::FormatRange>& formats, const QColor& foreground, const int tabSize, const QFontMetrics& fm)
+{
+    mFontWidth = Utils::getHorizontalAdvance(fm, QChar('0'));
+    mLeading = fm.leading();
+    mAscent = fm.ascent();
+    mHeight = fm.height();
+
+    QtSizeType formatIdx = 0;
+    for(QtSizeType i = 0; i < s.length(); ++i)
+    {
+        while(formatIdx < formats.size() && formats[formatIdx].start + formats[formatIdx].length <= i)
+            ++formatIdx;
+
+        QColor runForeground = foreground;
+        QColor runBackground;
+        if(formatIdx < formats.size() && formats[formatIdx].start <= i)
+        {
+            const QTextCharFormat& format = formats[formatIdx].format;
+            if(format.hasProperty(QTextFormat::ForegroundBrush))
+                runForeground = format.foreground().color();
+            if(format.hasProperty(QTextFormat::BackgroundBrush))
+                runBackground = format.background().color();
+        }
+
+        if(mRuns.empty() || mRuns.back().foreground != runForeground || mRuns.back().background != runBackground)
+            mRuns.push_back({mColumns, 0, QString(), runForeground, runBackground});
+
+        Run& run = mRuns.back();
+        const int columns = s[i] == QLatin1Char('\t') ? tabSize - mColumns % tabSize : 1;
+        if(s[i] == QLatin1Char('\t'))
+            run.text.append(QString(columns, QLatin1Char(' ')));
+        else
+            run.text.append(s[i]);
+        run.columns += columns;
+        mColumns += columns;
+    }
+}
+
+void MonospaceText::draw(QPainter& p, const int x, const int y) const
+{
+    for(const Run& run: mRuns)
+    {
+        const int runX = x + run.column * mFontWidth;
+        if(run.background.isValid())
+            p.fillRect(runX, y + mLeading, run.columns * mFontWidth, mHeight, run.background);
+        p.setPen(run.foreground);
+        p.drawText(runX, y + mLeading + mAscent, run.text);
+    }
+}
@@ -0,0 +1,75 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef MONOSPACETEXT_H
+#define MONOSPACETEXT_H
+
+#include "TypeUtils.h"
+
+#include <vector>
+
+#include <QColor>
+#include <QString>
+#include <QTextLayout>
+#include <QVector>
+
+class QFont;
+class QFontMetrics;
+class QPainter;
+
+/*
+    One line of text in a fixed pitch font, cut into runs of the same colors.
+
+    Every character takes the width of '0', so columns map to pixels by a multiplication and each
+    run is a single drawText(). That is a lot cheaper than shaping a QTextLayout and looks the
+    same, as long as isSimple() holds for the text. Tabs are expanded to spaces at the stops of
+    tabSize columns, just like the tab stops the layouts get.
+*/
+class MonospaceText
+{
+  public:
+    struct Run
+    {
+        int column = 0;
+        int columns = 0;
+        QString text;
+        QColor foreground;
+        QColor background; // Invalid if the run has no background.
+    };
+
+    /*
+        False if some character might need shaping or has another width: anything from combining
+        marks on, surrogates and control characters other than tab.
+    */
+    [[nodiscard]] static bool isSimple(const QString& s);
+
+    /*
+        formats must be sorted and must not overlap, like the ones given to QTextLayout::draw().
+        Characters outside of them are drawn in foreground without a background.
+    */
+    MonospaceText(const QString& s, const QVector<QTextLayout::FormatRange>& formats, const QColor& foreground, const int tabSize, const QFont& font);
+    // With the metrics of the device drawn on, a printer has other ones than the screen.
+    MonospaceText(const QString& s, const QVector<QTextLayout::FormatRange>& formats, const QColor& foreground, const int tabSize, const QFontMetrics& fm);
+
+    // x is where column 0 starts, y the top of the line.
+    void draw(QPainter& p, const int x, const int y) const;
+
+    [[nodiscard]] inline const std::vector<Run>& runs() const { return mRuns; }
+    [[nodiscard]] inline int columns() const { return mColumns; }
+
+  private:
+    std::vector<Run> mRuns;
+    int mColumns = 0;
+    int mFontWidth = 0;
+    int mLeading = 0;
+    int mAscent = 0;
+    int mHeight = 0;
+};
+
+#endif
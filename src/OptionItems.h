@@ -164,6 +164,72 @@ typedef Option<QFont> OptionFont;
 typedef Option<QColor> OptionColor;
 typedef Option<QString> OptionString;
 
+/*
+    Saved like OptionLineEdit: the value followed by the last ones entered. Keeps the stored list
+    so that saving without the dialog doesn't lose it.
+*/
+class OptionStringHistory : public OptionString
+{
+  public:
+    using OptionString::Option;
+
+    void write(ValueMap* config) const override
+    {
+        QStringList list = m_list;
+        list.removeAll(*m_pVar);
+        list.push_front(*m_pVar);
+        if(list.size() > 10)
+            list.erase(list.begin() + 10, list.end());
+        config->writeEntry(m_saveName, list);
+    }
+
+    void read(ValueMap* config) override
+    {
+        m_list = config->readEntry(m_saveName, QStringList(m_defaultVal));
+        *m_pVar = m_list.empty() ? m_defaultVal : m_list.front();
+    }
+
+  private:
+    QStringList m_list;
+    Q_DISABLE_COPY(OptionStringHistory)
+};
+
+// Saved like OptionEncodingComboBox, by the name of the codec.
+class OptionEncoding : public OptionItemBase
+{
+  public:
+    OptionEncoding(const QString& saveName, QTextCodec** ppVarCodec)
+        : OptionItemBase(saveName)
+    {
+        m_ppVarCodec = ppVarCodec;
+    }
+
+    void setToDefault() override {};
+    void setToCurrent() override {};
+    void apply() override {};
+
+    void write(ValueMap* config) const override
+    {
+        if(*m_ppVarCodec != nullptr) config->writeEntry(m_saveName, (const char*)(*m_ppVarCodec)->name());
+    }
+
+    void read(ValueMap* config) override
+    {
+        const QString codecName = config->readEntry(m_saveName, (const char*)QTextCodec::codecForLocale()->name());
+        QTextCodec* pCodec = QTextCodec::codecForName(codecName.toLatin1());
+        *m_ppVarCodec = pCodec != nullptr ? pCodec : QTextCodec::codecForLocale();
+    }
+
+  protected:
+    void preserveImp() override { m_pPreservedCodec = *m_ppVarCodec; }
+    void unpreserveImp() override { *m_ppVarCodec = m_pPreservedCodec; }
+
+  private:
+    QTextCodec** m_ppVarCodec;
+    QTextCodec* m_pPreservedCodec = nullptr;
+    Q_DISABLE_COPY(OptionEncoding)
+};
+
 class OptionCodec : public OptionString
 {
   public:
@@ -10,6 +10,7 @@
 #include "options.h"
 
 #include "combiners.h"
+#include "ConfigCache.h"
 #include "ConfigValueMap.h"
 #include "diff.h"
 #include "OptionItems.h"
@@ -17,6 +18,10 @@
 #include <boost/signals2.hpp>
 #include <memory>
 
+#include <QApplication>
+#include <QFontDatabase>
+#include <QPixmap>
+
 #include <KSharedConfig>
 
 boost::signals2::signal<void ()> Options::apply;
@@ -90,6 +95,153 @@ void Options::init()
     addOptionItem(std::make_unique<OptionStringList>(&m_recentEncodings, "RecentEncodings"));
 }
 
+/*
+    Batch mode never creates the options dialog whose widgets normally register these settings.
+    Registers the ones that affect diffing and merging so they can still be read from the config
+    file and set with --cs. The defaults must match those in OptionDialog.
+*/
+void Options::initBatch()
+{
+    addOptionItem(std::make_unique<OptionBool>(false, "IgnoreNumbers", &m_bIgnoreNumbers));
+    addOptionItem(std::make_unique<OptionBool>(false, "IgnoreComments", &m_bIgnoreComments));
+    addOptionItem(std::make_unique<OptionBool>(false, "IgnoreCase", &m_bIgnoreCase));
+    addOptionItem(std::make_unique<OptionStringHistory>("", "PreProcessorCmd", &m_PreProcessorCmd));
+    addOptionItem(std::make_unique<OptionStringHistory>("", "LineMatchingPreProcessorCmd", &m_LineMatchingPreProcessorCmd));
+    addOptionItem(std::make_unique<OptionBool>(true, "TryHard", &m_bTryHard));
+    addOptionItem(std::make_unique<OptionBool>(false, "Diff3AlignBC", &m_bDiff3AlignBC));
+    addOptionItem(std::make_unique<OptionInt>(0, "LineDiffAlgorithm", &m_lineDiffAlgorithm));
+    addOptionItem(std::make_unique<OptionInt>(0, "FineDiffAlgorithm", &m_fineDiffAlgorithm));
+    addOptionItem(std::make_unique<OptionInt>(0, "WhiteSpace2FileMergeDefault", &m_whiteSpace2FileMergeDefault));
+    addOptionItem(std::make_unique<OptionInt>(0, "WhiteSpace3FileMergeDefault", &m_whiteSpace3FileMergeDefault));
+    addOptionItem(std::make_unique<OptionInt>(eLineEndStyleAutoDetect, "LineEndStyle", (int*)&m_lineEndStyle));
+    addOptionItem(std::make_unique<OptionBool>(true, "WhiteSpaceEqual", &m_bDmWhiteSpaceEqual));
+    addOptionItem(std::make_unique<OptionBool>(true, "CreateBakFiles", &m_bDmCreateBakFiles));
+    addOptionItem(std::make_unique<OptionBool>(true, "AutoDetectUnicodeA", &m_bAutoDetectUnicodeA));
+    addOptionItem(std::make_unique<OptionBool>(true, "AutoDetectUnicodeB", &m_bAutoDetectUnicodeB));
+    addOptionItem(std::make_unique<OptionBool>(true, "AutoDetectUnicodeC", &m_bAutoDetectUnicodeC));
+    addOptionItem(std::make_unique<OptionInt>(0, "WorkerThreads", &m_workerThreads));
+    addOptionItem(std::make_unique<OptionInt>(3, "PatchContextLines", &m_patchContextLines));
+}
+
+/*
+    The options dialog is only built when it is first shown. Registers everything else it offers
+    so that all settings are read at startup without creating its widgets. The dialog's widgets
+    register the same names again later, both work on the same variables.
+*/
+void Options::initSettings()
+{
+    initBatch();
+
+    const bool bLowColor = QPixmap::defaultDepth() <= 8;
+#if defined(Q_OS_WIN)
+    const bool bCaseSensitiveFilenameComparison = false;
+#else
+    const bool bCaseSensitiveFilenameComparison = true;
+#endif
+    const QString historyEntryStartDefault =
+        "\\s*\\\\main\\\\(\\S+)\\s+"
+        "([0-9]+) "
+        "(Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) "
+        "([0-9][0-9][0-9][0-9]) "
+        "([0-9][0-9]:[0-9][0-9]:[0-9][0-9])\\s+(.*)";
+
+    addOptionItem(std::make_unique<OptionFont>(defaultAppFont(), "ApplicationFont", &mAppFont));
+    addOptionItem(std::make_unique<OptionFont>(defaultFixedFont(), "Font", &mFont));
+
+    addOptionItem(std::make_unique<OptionColor>(Qt::black, "FgColor", &m_fgColor));
+    addOptionItem(std::make_unique<OptionColor>(Qt::white, "BgColor", &m_bgColor));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? QColor(Qt::lightGray) : qRgb(224, 224, 224), "DiffBgColor", &m_diffBgColor));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? qRgb(0, 0, 255) : qRgb(0, 0, 200), "ColorA", &m_colorA));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? qRgb(0, 128, 0) : qRgb(0, 150, 0), "ColorB", &m_colorB));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? qRgb(128, 0, 128) : qRgb(150, 0, 150), "ColorC", &m_colorC));
+    addOptionItem(std::make_unique<OptionColor>(Qt::red, "ColorForConflict", &m_colorForConflict));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? qRgb(192, 192, 192) : qRgb(220, 220, 100), "CurrentRangeBgColor", &m_currentRangeBgColor));
+    addOptionItem(std::make_unique<OptionColor>(bLowColor ? qRgb(255, 255, 0) : qRgb(255, 255, 150), "CurrentRangeDiffBgColor", &m_currentRangeDiffBgColor));
+    addOptionItem(std::make_unique<OptionColor>(qRgb(0xff, 0xd0, 0x80), "ManualAlignmentRangeColor", &m_manualHelpRangeColor));
+    addOptionItem(std::make_unique<OptionColor>(qRgb(0, 0xd0, 0), "NewestFileColor", &m_newestFileColor));
+    addOptionItem(std::make_unique<OptionColor>(qRgb(0xf0, 0, 0), "OldestFileColor", &m_oldestFileColor));
+    addOptionItem(std::make_unique<OptionColor>(qRgb(0xc0, 0xc0, 0), "MidAgeFileColor", &m_midAgeFileColor));
+    addOptionItem(std::make_unique<OptionColor>(qRgb(0, 0, 0), "MissingFileColor", &m_missingFileColor));
+
+    addOptionItem(std::make_unique<OptionBool>(false, "ReplaceTabs", &m_bReplaceTabs));
+    addOptionItem(std::make_unique<OptionInt>(8, "TabSize", &m_tabSize));
+    addOptionItem(std::make_unique<OptionBool>(true, "AutoIndentation", &m_bAutoIndentation));
+    addOptionItem(std::make_unique<OptionBool>(false, "AutoCopySelection", &m_bAutoCopySelection));
+
+    addOptionItem(std::make_unique<OptionBool>(true, "LazyFineDiff", &m_bLazyFineDiff));
+    addOptionItem(std::make_unique<OptionBool>(true, "StreamLargeFiles", &m_bStreamLargeFiles));
+    addOptionItem(std::make_unique<OptionBool>(true, "DecompressInputs", &m_bDecompressInputs));
+    addOptionItem(std::make_unique<OptionBool>(false, "CacheDiffResults", &m_bCacheDiffResults));
+    addOptionItem(std::make_unique<OptionInt>(200, "DiffTimeBudget", &m_diffTimeBudget));
+    addOptionItem(std::make_unique<OptionInt>(64, "ProgressiveLoadSize", &m_progressiveLoadSize));
+    addOptionItem(std::make_unique<OptionInt>(0, "MemoryBudget", &m_memoryBudget));
+
+    addOptionItem(std::make_unique<OptionInt>(500, "AutoAdvanceDelay", &m_autoAdvanceDelay));
+    addOptionItem(std::make_unique<OptionBool>(true, "ShowInfoDialogs", &m_bShowInfoDialogs));
+    addOptionItem(std::make_unique<OptionStringHistory>(".*\\$(Version|Header|Date|Author).*\\$.*", "AutoMergeRegExp", &m_autoMergeRegExp));
+    addOptionItem(std::make_unique<OptionBool>(false, "RunRegExpAutoMergeOnMergeStart", &m_bRunRegExpAutoMergeOnMergeStart));
+    addOptionItem(std::make_unique<OptionStringHistory>(".*\\$Log.*\\$.*", "HistoryStartRegExp", &m_historyStartRegExp));
+    addOptionItem(std::make_unique<OptionStringHistory>(historyEntryStartDefault, "HistoryEntryStartRegExp", &m_historyEntryStartRegExp));
+    addOptionItem(std::make_unique<OptionBool>(false, "HistoryMergeSorting", &m_bHistoryMergeSorting));
+    addOptionItem(std::make_unique<OptionStringHistory>("4,3,2,5,1,6", "HistoryEntryStartSortKeyOrder", &m_historyEntryStartSortKeyOrder));
+    addOptionItem(std::make_unique<OptionBool>(false, "RunHistoryAutoMergeOnMergeStart", &m_bRunHistoryAutoMergeOnMergeStart));
+    addOptionItem(std::make_unique<OptionInt>(-1, "MaxNofHistoryEntries", &m_maxNofHistoryEntries));
+    addOptionItem(std::make_unique<OptionStringHistory>("", "IrrelevantMergeCmd", &m_IrrelevantMergeCmd));
+    addOptionItem(std::make_unique<OptionBool>(false, "AutoSaveAndQuitOnMergeWithoutConflicts", &m_bAutoSaveAndQuitOnMergeWithoutConflicts));
+
+    addOptionItem(std::make_unique<OptionBool>(true, "RecursiveDirs", &m_bDmRecursiveDirs));
+    addOptionItem(std::make_unique<OptionStringHistory>("*", "FilePattern", &m_DmFilePattern));
+    addOptionItem(std::make_unique<OptionStringHistory>("*.orig;*.o;*.obj;*.rej;*.bak", "FileAntiPattern", &m_DmFileAntiPattern));
+    addOptionItem(std::make_unique<OptionStringHistory>("CVS;.deps;.svn;.hg;.git", "DirAntiPattern", &m_DmDirAntiPattern));
+    addOptionItem(std::make_unique<OptionBool>(false, "UseCvsIgnore", &m_bDmUseCvsIgnore));
+    addOptionItem(std::make_unique<OptionBool>(true, "FindHidden", &m_bDmFindHidden));
+    addOptionItem(std::make_unique<OptionBool>(true, "FollowFileLinks", &m_bDmFollowFileLinks));
+    addOptionItem(std::make_unique<OptionBool>(true, "FollowDirLinks", &m_bDmFollowDirLinks));
+    addOptionItem(std::make_unique<OptionBool>(bCaseSensitiveFilenameComparison, "CaseSensitiveFilenameComparison", &m_bDmCaseSensitiveFilenameComparison));
+    addOptionItem(std::make_unique<OptionBool>(false, "UnfoldSubdirs", &m_bDmUnfoldSubdirs));
+    addOptionItem(std::make_unique<OptionBool>(false, "SkipDirStatus", &m_bDmSkipDirStatus));
+    addOptionItem(std::make_unique<OptionBool>(true, "BinaryComparison", &m_bDmBinaryComparison));
+    addOptionItem(std::make_unique<OptionBool>(false, "FullAnalysis", &m_bDmFullAnalysis));
+    addOptionItem(std::make_unique<OptionBool>(false, "TrustDate", &m_bDmTrustDate));
+    addOptionItem(std::make_unique<OptionBool>(false, "TrustDateFallbackToBinary", &m_bDmTrustDateFallbackToBinary));
+    addOptionItem(std::make_unique<OptionBool>(false, "TrustSize", &m_bDmTrustSize));
+    addOptionItem(std::make_unique<OptionBool>(false, "UseHashCache", &m_bDmUseHashCache));
+    addOptionItem(std::make_unique<OptionBool>(false, "WatchFolders", &m_bDmWatchFolders));
+    addOptionItem(std::make_unique<OptionInt>(8, "MaxRemoteJobs", &m_dmMaxRemoteJobs));
+    addOptionItem(std::make_unique<OptionBool>(false, "DeltaTransfer", &m_bDmDeltaTransfer));
+    addOptionItem(std::make_unique<OptionBool>(false, "RemoteHashing", &m_bDmRemoteHashing));
+    addOptionItem(std::make_unique<OptionBool>(false, "UseGitIndex", &m_bDmUseGitIndex));
+    addOptionItem(std::make_unique<OptionBool>(false, "CompareDecompressed", &m_bDmCompareDecompressed));
+    addOptionItem(std::make_unique<OptionBool>(false, "CompressPrefetched", &m_bCompressPrefetched));
+    addOptionItem(std::make_unique<OptionBool>(false, "SyncMode", &m_bDmSyncMode));
+    addOptionItem(std::make_unique<OptionBool>(false, "CopyNewer", &m_bDmCopyNewer));
+
+    addOptionItem(std::make_unique<OptionBool>(true, "SameEncoding", &m_bSameEncoding));
+    addOptionItem(std::make_unique<OptionEncoding>("EncodingForA", &m_pEncodingA));
+    addOptionItem(std::make_unique<OptionEncoding>("EncodingForB", &m_pEncodingB));
+    addOptionItem(std::make_unique<OptionEncoding>("EncodingForC", &m_pEncodingC));
+    addOptionItem(std::make_unique<OptionEncoding>("EncodingForOutput", &m_pEncodingOut));
+    addOptionItem(std::make_unique<OptionBool>(true, "AutoSelectOutEncoding", &m_bAutoSelectOutEncoding));
+    addOptionItem(std::make_unique<OptionEncoding>("EncodingForPP", &m_pEncodingPP));
+    addOptionItem(std::make_unique<OptionBool>(false, "RightToLeftLanguage", &m_bRightToLeftLanguage));
+
+    addOptionItem(std::make_unique<OptionStringHistory>("-u;-query;-html;-abort", "IgnorableCmdLineOptions", &m_ignorableCmdLineOptions));
+    addOptionItem(std::make_unique<OptionBool>(false, "EscapeKeyQuits", &m_bEscapeKeyQuits));
+}
+
+// Taken once, the application font changes when the configured one is applied.
+const QFont& Options::defaultAppFont()
+{
+    static const QFont font = QApplication::font();
+    return font;
+}
+
+const QFont& Options::defaultFixedFont()
+{
+    static const QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    return font;
+}
+
 void Options::saveOptions(const KSharedConfigPtr config)
 {
     // No i18n()-Translations here!
@@ -98,15 +250,22 @@ void Options::saveOptions(const KSharedConfigPtr config)
 
     unpreserve();
     write(&cvm);
+
+    // The cache is only valid for the config files as they are written now.
+    ConfigCache cache(config, KDIFF3_CONFIG_GROUP);
+    write(&cache);
+    config->sync();
+    cache.save();
 }
 
 void Options::readOptions(const KSharedConfigPtr config)
 {
     // No i18n()-Translations here!
 
-    ConfigValueMap cvm(config->group(KDIFF3_CONFIG_GROUP));
+    ConfigCache cache(config, KDIFF3_CONFIG_GROUP);
 
-    read(&cvm);
+    read(&cache);
+    cache.save();
 
     if(m_whiteSpace2FileMergeDefault <= (int)e_SrcSelector::Min)
         m_whiteSpace2FileMergeDefault = (int)e_SrcSelector::None;
@@ -13,8 +13,10 @@
 #include "kdiff3.h"
 #include "MergeEditLine.h"
 #include "options.h"
+#include "Trace.h"
 
 #include <algorithm> // for max
+#include <vector>
 
 #include <QColor>
 #include <QMouseEvent>
@@ -40,6 +42,7 @@ Overview::Overview(const QSharedPointer<Options>& pOptions)
 void Overview::init(Diff3LineList* pDiff3LineList)
 {
     m_pDiff3LineList = pDiff3LineList;
+    classifyLines();
     m_pixmap = QPixmap(QSize(0, 0)); // make sure that a redraw happens
     update();
 }
@@ -47,6 +50,36 @@ void Overview::init(Diff3LineList* pDiff3LineList)
 void Overview::reset()
 {
     m_pDiff3LineList = nullptr;
+    m_lineInfos.clear();
+}
+
+/*
+    Merging each line only to pick its color is costly. Do it once per diff, so redrawing after a
+    resize or a mode change only has to look up the stored result.
+*/
+void Overview::classifyLines()
+{
+    m_lineInfos.clear();
+    if(m_pDiff3LineList == nullptr)
+        return;
+
+    m_lineInfos.reserve(m_pDiff3LineList->size());
+    for(const Diff3Line& d3l: *m_pDiff3LineList)
+    {
+        MergeBlock lMergeBlock;
+        bool bLineRemoved;
+        lMergeBlock.mergeOneLine(d3l, bLineRemoved, !KDiff3App::isTripleDiff());
+
+        LineInfo info;
+        info.details = lMergeBlock.details();
+        info.bConflict = lMergeBlock.isConflict();
+        info.bLineAValid = d3l.getLineA().isValid();
+        info.bLineBValid = d3l.getLineB().isValid();
+        info.bWhiteSpaceAB = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
+        info.bWhiteSpaceAC = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
+        info.bWhiteSpaceBC = d3l.isEqualBC() || (d3l.isWhiteLine(e_SrcSelector::B) && d3l.isWhiteLine(e_SrcSelector::C));
+        m_lineInfos.push_back(info);
+    }
 }
 
 void Overview::slotRedraw()
@@ -76,6 +109,9 @@ void Overview::setFirstLine(QtNumberType firstLine)
 
 void Overview::setOverviewMode(e_OverviewMode eOverviewMode)
 {
+    if(eOverviewMode == mOverviewMode)
+        return;
+
     mOverviewMode = eOverviewMode;
     slotRedraw();
 }
@@ -118,24 +154,22 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
 
     if(nofLines == 0) return;
 
+    assert(m_lineInfos.size() == m_pDiff3LineList->size());
+
     int line = 0;
     int oldY = 0;
     int oldConflictY = -1;
     int wrapLineIdx = 0;
     Diff3LineList::const_iterator i;
+    std::vector<LineInfo>::const_iterator infoIt = m_lineInfos.cbegin();
 
     for(i = m_pDiff3LineList->begin(); i != m_pDiff3LineList->end();)
     {
         const Diff3Line& d3l = *i;
+        const LineInfo& info = *infoIt;
         int y = h * (line + 1) / nofLines;
-        MergeBlock lMergeBlock;
-        e_MergeDetails md;
-        bool bConflict;
-        bool bLineRemoved;
-
-        lMergeBlock.mergeOneLine(d3l, bLineRemoved, !KDiff3App::isTripleDiff());
-        md = lMergeBlock.details();
-        bConflict = lMergeBlock.isConflict();
+        const e_MergeDetails md = info.details;
+        const bool bConflict = info.bConflict;
 
         QColor c = m_pOptions->backgroundColor();
         bool bWhiteSpaceChange = false;
@@ -155,13 +189,13 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
                     case e_MergeDetails::eBDeleted:
                     case e_MergeDetails::eBChanged:
                         c = bConflict ? m_pOptions->conflictColor() : m_pOptions->bColor();
-                        bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
+                        bWhiteSpaceChange = info.bWhiteSpaceAB;
                         break;
 
                     case e_MergeDetails::eCAdded:
                     case e_MergeDetails::eCDeleted:
                     case e_MergeDetails::eCChanged:
-                        bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
+                        bWhiteSpaceChange = info.bWhiteSpaceAC;
                         c = bConflict ? m_pOptions->conflictColor() : m_pOptions->cColor();
                         break;
 
@@ -187,7 +221,7 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
                         break;
                     default:
                         c = m_pOptions->conflictColor();
-                        bWhiteSpaceChange = d3l.isEqualAB() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::B));
+                        bWhiteSpaceChange = info.bWhiteSpaceAB;
                         break;
                 }
                 break;
@@ -202,7 +236,7 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
                         break;
                     default:
                         c = m_pOptions->conflictColor();
-                        bWhiteSpaceChange = d3l.isEqualAC() || (d3l.isWhiteLine(e_SrcSelector::A) && d3l.isWhiteLine(e_SrcSelector::C));
+                        bWhiteSpaceChange = info.bWhiteSpaceAC;
                         break;
                 }
                 break;
@@ -217,7 +251,7 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
                         break;
                     default:
                         c = m_pOptions->conflictColor();
-                        bWhiteSpaceChange = d3l.isEqualBC() || (d3l.isWhiteLine(e_SrcSelector::B) && d3l.isWhiteLine(e_SrcSelector::C));
+                        bWhiteSpaceChange = info.bWhiteSpaceBC;
                         break;
                 }
                 break;
@@ -228,13 +262,13 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
 
         if(!KDiff3App::isTripleDiff())
         {
-            if(!d3l.getLineA().isValid() && d3l.getLineB().isValid())
+            if(!info.bLineAValid && info.bLineBValid)
             {
                 c = m_pOptions->aColor();
                 x2 = w / 2;
                 w2 = x2;
             }
-            if(d3l.getLineA().isValid() && !d3l.getLineB().isValid())
+            if(info.bLineAValid && !info.bLineBValid)
             {
                 c = m_pOptions->bColor();
                 w2 = w / 2;
@@ -265,17 +299,20 @@ void Overview::drawColumn(QPainter& p, e_OverviewMode eOverviewMode, int x, int
             {
                 wrapLineIdx = 0;
                 ++i;
+                ++infoIt;
             }
         }
         else
         {
             ++i;
+            ++infoIt;
         }
     }
 }
 
 void Overview::paintEvent(QPaintEvent*)
 {
+    TraceScope traceScope(TraceStage::paint);
     if(m_pDiff3LineList == nullptr) return;
     int h = height() - 1;
     int w = width();
@@ -284,6 +321,8 @@ void Overview::paintEvent(QPaintEvent*)
     if(m_pixmap.size() != size() * dpr)
     {
         m_nofLines = m_pDiff3LineList->numberOfLines(m_pOptions->wordWrapOn());
+        if(m_lineInfos.size() != m_pDiff3LineList->size())
+            classifyLines();
 
         m_pixmap = QPixmap(size() * dpr);
         m_pixmap.setDevicePixelRatio(dpr);
@@ -18,8 +18,11 @@
 #include <QPixmap>
 #include <QWidget>
 
+#include <vector>
+
 class Diff3LineList;
 class Options;
+enum class e_MergeDetails;
 
 enum class e_OverviewMode
 {
@@ -50,7 +53,22 @@ class Overview : public QWidget
     void setLine(LineRef);
 
   private:
+    // What the overview needs to know of one Diff3Line, gathered once per diff.
+    struct LineInfo
+    {
+        e_MergeDetails details;
+        bool bConflict : 1;
+        bool bLineAValid : 1;
+        bool bLineBValid : 1;
+        bool bWhiteSpaceAB : 1; // Only white space differs between A and B.
+        bool bWhiteSpaceAC : 1;
+        bool bWhiteSpaceBC : 1;
+    };
+
+    void classifyLines();
+
     const Diff3LineList* m_pDiff3LineList;
+    std::vector<LineInfo> m_lineInfos;
     QSharedPointer<Options> m_pOptions;
     LineRef m_firstLine;
     int m_pageHeight;
@@ -0,0 +1,129 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "PaintBenchmark.h"
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QWidget>
+
+PaintBenchmark::PaintBenchmark(QObject* pParent):
+    QObject(pParent)
+{
+}
+
+void PaintBenchmark::watch(QWidget* pWidget, const QString& name)
+{
+    if(pWidget == nullptr)
+        return;
+
+    mNames.insert(pWidget, name);
+    pWidget->installEventFilter(this);
+}
+
+bool PaintBenchmark::eventFilter(QObject* pObject, QEvent* pEvent)
+{
+    if(pEvent->type() != QEvent::Paint || mCurrentFrame == nullptr || !mNames.contains(pObject))
+        return QObject::eventFilter(pObject, pEvent);
+
+    // Deliver the event here, so the time spent in paintEvent can be taken.
+    QElapsedTimer timer;
+    timer.start();
+    pObject->event(pEvent);
+
+    WidgetTime& time = mCurrentFrame->widgets[mNames.value(pObject)];
+    ++time.paints;
+    time.nsecs += timer.nsecsElapsed();
+    return true;
+}
+
+void PaintBenchmark::measureFrame(const QString& action, const std::function<void()>& step, const std::function<bool()>& isBusy)
+{
+    mFrames.push_back(Frame());
+    mCurrentFrame = &mFrames.back();
+    mCurrentFrame->action = action;
+
+    const qint64 layoutsBefore = sLayoutCount.load(std::memory_order_relaxed);
+    QElapsedTimer timer;
+    timer.start();
+
+    step();
+    QCoreApplication::processEvents();
+    // Word wrap and fine diffs finish through the event loop.
+    while(isBusy())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    // The update requests posted by the last of them.
+    QCoreApplication::processEvents();
+
+    mCurrentFrame->nsecs = timer.nsecsElapsed();
+    mCurrentFrame->layouts = sLayoutCount.load(std::memory_order_relaxed) - layoutsBefore;
+    mCurrentFrame = nullptr;
+}
+
+QByteArray PaintBenchmark::report() const
+{
+    QJsonArray frames;
+    // Time spent painting for each frame, per action.
+    std::map<QString, std::vector<qint64>> paintNsecs;
+    std::map<QString, qint64> layouts;
+    for(const Frame& frame: mFrames)
+    {
+        QJsonObject widgets;
+        qint64 framePaintNsecs = 0;
+        for(const auto& [name, time]: frame.widgets)
+        {
+            QJsonObject widget;
+            widget["paints"] = time.paints;
+            widget["nsecs"] = time.nsecs;
+            widgets[name] = widget;
+            framePaintNsecs += time.nsecs;
+        }
+
+        QJsonObject entry;
+        entry["action"] = frame.action;
+        entry["nsecs"] = frame.nsecs;
+        entry["paintNsecs"] = framePaintNsecs;
+        entry["layouts"] = frame.layouts;
+        entry["widgets"] = widgets;
+        frames.append(entry);
+
+        paintNsecs[frame.action].push_back(framePaintNsecs);
+        layouts[frame.action] += frame.layouts;
+    }
+
+    QJsonObject summary;
+    for(auto& [action, times]: paintNsecs)
+    {
+        std::sort(times.begin(), times.end());
+        qint64 total = 0;
+        for(const qint64 nsecs: times)
+            total += nsecs;
+
+        const qint64 nofFrames = (qint64)times.size();
+        QJsonObject entry;
+        entry["frames"] = nofFrames;
+        entry["averagePaintNsecs"] = total / nofFrames;
+        entry["medianPaintNsecs"] = times[times.size() / 2];
+        entry["maxPaintNsecs"] = times.back();
+        entry["layoutsPerFrame"] = (double)layouts[action] / nofFrames;
+        summary[action] = entry;
+    }
+
+    QJsonObject result;
+    result["frames"] = frames;
+    result["summary"] = summary;
+    return QJsonDocument(result).toJson();
+}
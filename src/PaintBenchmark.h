@@ -0,0 +1,77 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef PAINTBENCHMARK_H
+#define PAINTBENCHMARK_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+class QEvent;
+class QWidget;
+
+/*
+    Times the paint events of the diff, merge and overview windows.
+
+    A frame is one step, like scrolling by a page, together with everything the event loop does
+    until the windows are idle again. For each frame the time spent in paintEvent is kept per
+    window, as well as the number of text layouts prepared. See KDiff3App::runPaintBenchmark for
+    the steps, which is started with --paint-benchmark and best run with -platform offscreen.
+*/
+class PaintBenchmark: public QObject
+{
+    Q_OBJECT;
+
+  public:
+    explicit PaintBenchmark(QObject* pParent = nullptr);
+
+    // Paint events of pWidget are timed from now on.
+    void watch(QWidget* pWidget, const QString& name);
+    // Runs step and then the event loop until isBusy returns false.
+    void measureFrame(const QString& action, const std::function<void()>& step, const std::function<bool()>& isBusy);
+
+    // All frames and a summary for each action.
+    [[nodiscard]] QByteArray report() const;
+
+    // Called for every line layout the diff and merge windows prepare, also from word wrap threads.
+    static void countLayout() { sLayoutCount.fetch_add(1, std::memory_order_relaxed); }
+
+  protected:
+    bool eventFilter(QObject* pObject, QEvent* pEvent) override;
+
+  private:
+    struct WidgetTime
+    {
+        int paints = 0;
+        qint64 nsecs = 0;
+    };
+
+    struct Frame
+    {
+        QString action;
+        qint64 nsecs = 0; // Wall time including waiting for the event loop.
+        qint64 layouts = 0;
+        std::map<QString, WidgetTime> widgets;
+    };
+
+    static inline std::atomic<qint64> sLayoutCount{0};
+
+    QHash<QObject*, QString> mNames;
+    Frame* mCurrentFrame = nullptr;
+    std::vector<Frame> mFrames;
+};
+
+#endif
@@ -0,0 +1,69 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef PARALLELPROGRESS_H
+#define PARALLELPROGRESS_H
+
+#include <array>
+#include <atomic>
+
+#include <QtGlobal>
+
+/*
+    Progress of a task whose steps are done by several threads.
+
+    step() only adds to a counter of the calling thread, it neither locks nor signals, so it is
+    cheap enough to call once per chunk or even per line. The counters sit on cache lines of
+    their own so workers don't slow each other down. The gui thread reads the sum from a timer,
+    see ProgressProxy::trackParallel(). The total may run a little behind the workers but never
+    ahead of them.
+*/
+class ParallelProgress
+{
+  public:
+    explicit ParallelProgress(const quint64 maxNofSteps):
+        mMaxNofSteps(maxNofSteps) {}
+
+    ParallelProgress(const ParallelProgress&) = delete;
+    ParallelProgress& operator=(const ParallelProgress&) = delete;
+
+    // May be called from any thread.
+    void step(const quint64 nofSteps = 1) { mCounters[counterIdx()].value.fetch_add(nofSteps, std::memory_order_relaxed); }
+
+    [[nodiscard]] quint64 current() const
+    {
+        quint64 sum = 0;
+        for(const Counter& counter: mCounters)
+            sum += counter.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+    [[nodiscard]] quint64 maxNofSteps() const { return mMaxNofSteps; }
+
+  private:
+    // More threads than this seldom run at once, if they do some share a counter.
+    static constexpr size_t counterCount = 32;
+
+    struct alignas(64) Counter
+    {
+        std::atomic<quint64> value{0};
+    };
+
+    // Each thread keeps its index for its lifetime, a pool thread uses the same counter for every task.
+    static size_t counterIdx()
+    {
+        static std::atomic<size_t> nextIdx{0};
+        thread_local const size_t idx = nextIdx.fetch_add(1, std::memory_order_relaxed) % counterCount;
+        return idx;
+    }
+
+    std::array<Counter, counterCount> mCounters;
+    quint64 mMaxNofSteps;
+};
+
+#endif
@@ -0,0 +1,232 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "PatchWriter.h"
+
+#include "fileaccess.h"
+
+#include <algorithm>
+
+#include <QIODevice>
+
+namespace {
+// "start,length" of a hunk header, an empty range names the line before it.
+QString hunkRange(const LineType start, const LineType length)
+{
+    if(length == 1)
+        return QString::number(start + 1);
+    return QString::number(length == 0 ? start : start + 1) + ',' + QString::number(length);
+}
+} // namespace
+
+PatchWriter::PatchWriter(const DiffList& diffList, const std::shared_ptr<LineDataVector>& pldA, LineType sizeA, const std::shared_ptr<LineDataVector>& pldB, LineType sizeB,
+                         const QString& labelA, const QString& labelB, LineType contextLines, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle):
+    mPldA(pldA),
+    mPldB(pldB),
+    mLabelA(labelA),
+    mLabelB(labelB),
+    mLineFeed(eLineEndStyle == eLineEndStyleDos ? QString("\r\n") : QString("\n")),
+    // Same as MergeResultWriter.
+    mEncoder(pEncoding->makeEncoder(pEncoding->name() == "UTF-8" ? QTextCodec::IgnoreHeader : QTextCodec::DefaultConversion))
+{
+    /*
+        SourceData separates lines by line ends, a file ending with one has an empty line behind
+        it. That line isn't part of the patch. Any other last line misses its line end.
+    */
+    const auto countLines = [](const std::shared_ptr<LineDataVector>& pld, const LineType size, LineType& lines, bool& bTerminated) {
+        lines = std::min<LineType>(size, pld != nullptr ? (LineType)pld->size() : 0);
+        bTerminated = lines == 0 || (*pld)[lines - 1].size() == 0;
+        if(lines > 0 && bTerminated)
+            --lines;
+    };
+    countLines(mPldA, sizeA, mLinesA, mbTerminatedA);
+    countLines(mPldB, sizeB, mLinesB, mbTerminatedB);
+
+    buildHunks(buildRuns(diffList), std::max<LineType>(contextLines, 0));
+}
+
+bool PatchWriter::isUnterminated(const bool bFromB, const LineType line) const
+{
+    return bFromB ? !mbTerminatedB && line == mLinesB - 1 : !mbTerminatedA && line == mLinesA - 1;
+}
+
+bool PatchWriter::isSameLine(const LineType lineA, const LineType lineB) const
+{
+    return isUnterminated(false, lineA) == isUnterminated(true, lineB) && (*mPldA)[lineA].getLine() == (*mPldB)[lineB].getLine();
+}
+
+std::vector<PatchWriter::Run> PatchWriter::buildRuns(const DiffList& diffList) const
+{
+    std::vector<Run> runs;
+    const auto addRun = [&runs](const bool bEqual, const LineType a, const LineType b) {
+        if(a == 0 && b == 0)
+            return;
+        if(!runs.empty() && runs.back().bEqual == bEqual)
+        {
+            runs.back().a += a;
+            runs.back().b += b;
+            return;
+        }
+        runs.push_back({bEqual, a, b});
+    };
+    // Lines behind the end of a file are the empty one after the last line end.
+    const auto remaining = [](const LineType pos, const LineType count, const LineType lines) {
+        return std::clamp<LineType>(lines - pos, 0, count);
+    };
+
+    LineType posA = 0;
+    LineType posB = 0;
+    for(const Diff& diff: diffList)
+    {
+        for(LineType i = 0; i < diff.numberOfEquals(); ++i, ++posA, ++posB)
+        {
+            if(posA < mLinesA && posB < mLinesB && isSameLine(posA, posB))
+                addRun(true, 1, 1);
+            else
+                addRun(false, posA < mLinesA ? 1 : 0, posB < mLinesB ? 1 : 0);
+        }
+
+        const LineType diff1 = (LineType)diff.diff1();
+        const LineType diff2 = (LineType)diff.diff2();
+        addRun(false, remaining(posA, diff1, mLinesA), remaining(posB, diff2, mLinesB));
+        posA += diff1;
+        posB += diff2;
+    }
+    addRun(false, std::max<LineType>(mLinesA - posA, 0), std::max<LineType>(mLinesB - posB, 0));
+    return runs;
+}
+
+/*
+    Like diff -u: every change gets contextLines of equal lines before and after it, changes closer
+    than twice that share one hunk.
+*/
+void PatchWriter::buildHunks(const std::vector<Run>& runs, const LineType contextLines)
+{
+    LineType posA = 0;
+    LineType posB = 0;
+    size_t i = 0;
+    while(i < runs.size())
+    {
+        if(runs[i].bEqual)
+        {
+            posA += runs[i].a;
+            posB += runs[i].b;
+            ++i;
+            continue;
+        }
+
+        Hunk hunk;
+        const LineType leading = i > 0 ? std::min(contextLines, runs[i - 1].a) : 0;
+        hunk.startA = posA - leading;
+        hunk.startB = posB - leading;
+        if(leading > 0)
+            hunk.pieces.push_back({' ', posA - leading, leading});
+
+        for(;;)
+        {
+            if(runs[i].a > 0)
+                hunk.pieces.push_back({'-', posA, runs[i].a});
+            if(runs[i].b > 0)
+                hunk.pieces.push_back({'+', posB, runs[i].b});
+            posA += runs[i].a;
+            posB += runs[i].b;
+            ++i;
+            if(i == runs.size())
+                break;
+
+            const LineType equal = runs[i].a;
+            const bool bJoin = i + 1 < runs.size() && equal <= 2 * contextLines;
+            const LineType trailing = bJoin ? equal : std::min(contextLines, equal);
+            if(trailing > 0)
+                hunk.pieces.push_back({' ', posA, trailing});
+            posA += equal;
+            posB += equal;
+            ++i;
+            if(!bJoin)
+                break;
+        }
+
+        for(const Piece& piece: hunk.pieces)
+        {
+            if(piece.prefix != '+')
+                hunk.lengthA += piece.count;
+            if(piece.prefix != '-')
+                hunk.lengthB += piece.count;
+        }
+        mHunks.push_back(std::move(hunk));
+    }
+}
+
+QByteArray PatchWriter::nextChunk()
+{
+    QString text;
+    text.reserve(s_chunkSize + 1024);
+
+    while(mHunk < mHunks.size())
+    {
+        const Hunk& hunk = mHunks[mHunk];
+        if(!mbHunkStarted)
+        {
+            if(mHunk == 0)
+                text += QLatin1String("--- ") + mLabelA + mLineFeed + QLatin1String("+++ ") + mLabelB + mLineFeed;
+            text += QLatin1String("@@ -") + hunkRange(hunk.startA, hunk.lengthA) + QLatin1String(" +") + hunkRange(hunk.startB, hunk.lengthB) + QLatin1String(" @@") + mLineFeed;
+            mbHunkStarted = true;
+        }
+
+        if(mPiece == hunk.pieces.size())
+        {
+            ++mHunk;
+            mPiece = 0;
+            mbHunkStarted = false;
+            continue;
+        }
+
+        const Piece& piece = hunk.pieces[mPiece];
+        if(mLine == piece.count)
+        {
+            ++mPiece;
+            mLine = 0;
+            continue;
+        }
+
+        const bool bFromB = piece.prefix == '+';
+        const LineType line = piece.first + mLine;
+        ++mLine;
+        text += QLatin1Char(piece.prefix);
+        text += (*(bFromB ? mPldB : mPldA))[line].getLine();
+        text += mLineFeed;
+        if(isUnterminated(bFromB, line))
+            text += QLatin1String("\\ No newline at end of file") + mLineFeed;
+
+        if(text.length() >= s_chunkSize)
+        {
+            const QByteArray encoded = mEncoder->fromUnicode(text);
+            if(!encoded.isEmpty())
+                return encoded;
+            text.clear();
+        }
+    }
+
+    return text.isEmpty() ? QByteArray() : mEncoder->fromUnicode(text);
+}
+
+bool PatchWriter::write(FileAccess& file)
+{
+    return file.writeFile([this]() { return nextChunk(); });
+}
+
+bool PatchWriter::write(QIODevice& device)
+{
+    for(QByteArray chunk = nextChunk(); !chunk.isEmpty(); chunk = nextChunk())
+    {
+        if(device.write(chunk) != chunk.size())
+            return false;
+    }
+    return true;
+}
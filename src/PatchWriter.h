@@ -0,0 +1,101 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef PATCHWRITER_H
+#define PATCHWRITER_H
+
+#include "diff.h"
+#include "options.h"
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <QTextCodec>
+
+class FileAccess;
+class QIODevice;
+
+/*
+    Writes the line matching of two inputs as a unified diff, the way diff -u does, a block at a
+    time like MergeResultWriter. The text comes straight from the line data of the inputs.
+
+    Lines the line matching took as equal but whose text differs, e.g. because white space was
+    ignored, are written as changed so the patch turns A into B exactly. A missing line end at
+    the end of a file is marked as GNU patch expects it.
+*/
+class PatchWriter
+{
+  public:
+    PatchWriter(const DiffList& diffList, const std::shared_ptr<LineDataVector>& pldA, LineType sizeA, const std::shared_ptr<LineDataVector>& pldB, LineType sizeB,
+                const QString& labelA, const QString& labelB, LineType contextLines, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle);
+
+    // True if the texts are equal, the patch is empty then.
+    [[nodiscard]] bool isEmpty() const { return mHunks.empty(); }
+
+    // Returns the next block of encoded output, an empty one once everything was returned.
+    [[nodiscard]] QByteArray nextChunk();
+
+    bool write(FileAccess& file);
+    bool write(QIODevice& device);
+
+  private:
+    static constexpr QtSizeType s_chunkSize = 1 << 20; // In characters.
+
+    // Lines of A or B written with the same prefix: ' ' and '-' come from A, '+' from B.
+    struct Piece
+    {
+        char prefix;
+        LineType first;
+        LineType count;
+    };
+
+    struct Hunk
+    {
+        LineType startA = 0;
+        LineType startB = 0;
+        LineType lengthA = 0;
+        LineType lengthB = 0;
+        std::vector<Piece> pieces;
+    };
+
+    // Lines taken from A and B, equal ones are taken from both.
+    struct Run
+    {
+        bool bEqual;
+        LineType a;
+        LineType b;
+    };
+
+    [[nodiscard]] std::vector<Run> buildRuns(const DiffList& diffList) const;
+    void buildHunks(const std::vector<Run>& runs, LineType contextLines);
+    [[nodiscard]] bool isSameLine(LineType lineA, LineType lineB) const;
+    [[nodiscard]] bool isUnterminated(bool bFromB, LineType line) const;
+
+    std::shared_ptr<LineDataVector> mPldA;
+    std::shared_ptr<LineDataVector> mPldB;
+    // Lines of the files, without the empty one behind a final line end.
+    LineType mLinesA = 0;
+    LineType mLinesB = 0;
+    bool mbTerminatedA = true;
+    bool mbTerminatedB = true;
+    const QString mLabelA;
+    const QString mLabelB;
+    const QString mLineFeed;
+    std::unique_ptr<QTextEncoder> mEncoder;
+    std::vector<Hunk> mHunks;
+
+    size_t mHunk = 0;
+    size_t mPiece = 0;
+    LineType mLine = 0;
+    bool mbHunkStarted = false;
+};
+
+#endif
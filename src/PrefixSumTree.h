@@ -0,0 +1,90 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef PREFIXSUMTREE_H
+#define PREFIXSUMTREE_H
+
+#include "LineRef.h"
+
+#include <algorithm>
+#include <vector>
+
+/*
+    Fenwick tree over non negative counts, such as the wrap lines needed by each Diff3Line.
+
+    Both the sum before an entry and the entry containing a position of the sum take O(log n),
+    and so does changing a single count. Building it from all counts takes O(n).
+*/
+class PrefixSumTree
+{
+  public:
+    void assign(std::vector<LineType> values)
+    {
+        mValues = std::move(values);
+        mTree.assign(mValues.size() + 1, 0);
+        mTotal = 0;
+        for(size_t i = 1; i <= mValues.size(); ++i)
+        {
+            mTree[i] += mValues[i - 1];
+            mTotal += mValues[i - 1];
+            const size_t parent = i + (i & (~i + 1));
+            if(parent < mTree.size())
+                mTree[parent] += mTree[i];
+        }
+    }
+
+    void clear() { assign({}); }
+
+    void set(const size_t idx, const LineType value)
+    {
+        const LineType delta = value - mValues[idx];
+        mValues[idx] = value;
+        mTotal += delta;
+        for(size_t i = idx + 1; i < mTree.size(); i += i & (~i + 1))
+            mTree[i] += delta;
+    }
+
+    [[nodiscard]] size_t size() const { return mValues.size(); }
+    [[nodiscard]] LineType value(const size_t idx) const { return mValues[idx]; }
+    [[nodiscard]] LineType total() const { return mTotal; }
+
+    // Sum of the entries before idx, total() if idx is past the end.
+    [[nodiscard]] LineType prefix(size_t idx) const
+    {
+        LineType sum = 0;
+        for(size_t i = std::min(idx, mValues.size()); i > 0; i -= i & (~i + 1))
+            sum += mTree[i];
+        return sum;
+    }
+
+    // Entry whose range contains pos, entries with a count of 0 contain nothing. size() if pos >= total().
+    [[nodiscard]] size_t find(LineType pos) const
+    {
+        size_t idx = 0;
+        size_t step = 1;
+        while(step * 2 < mTree.size())
+            step *= 2;
+        for(; step > 0; step /= 2)
+        {
+            if(idx + step < mTree.size() && mTree[idx + step] <= pos)
+            {
+                idx += step;
+                pos -= mTree[idx];
+            }
+        }
+        return idx;
+    }
+
+  private:
+    std::vector<LineType> mValues;
+    std::vector<LineType> mTree; // 1-based, entry i holds the sum of the (i & -i) values up to i.
+    LineType mTotal = 0;
+};
+
+#endif
@@ -0,0 +1,375 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "Preprocessor.h"
+
+#include "TypeUtils.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringList>
+
+namespace {
+/*
+    The "s/regexp/replacement/flags" command of sed, any number of them applied one after the other.
+*/
+class SedSubstitute: public Preprocessor
+{
+  public:
+    struct Command
+    {
+        QRegularExpression regExp;
+        // Literal text and references to captured groups, group is -1 for literal text.
+        struct Part
+        {
+            QString text;
+            int group;
+        };
+        std::vector<Part> replacement;
+        bool bGlobal = false;
+    };
+
+    explicit SedSubstitute(std::vector<Command>&& commands): mCommands(std::move(commands)) {}
+
+    void processLine(const QString& line, const LineSink& out) override
+    {
+        QString s = line;
+        for(const Command& command: mCommands)
+            s = substitute(command, s);
+        out(s);
+    }
+
+  private:
+    static QString substitute(const Command& command, const QString& line)
+    {
+        QRegularExpressionMatchIterator it = command.regExp.globalMatch(line);
+        if(!it.hasNext())
+            return line;
+
+        QString result;
+        QtSizeType last = 0;
+        while(it.hasNext())
+        {
+            const QRegularExpressionMatch match = it.next();
+            result += line.mid(last, match.capturedStart() - last);
+            for(const Command::Part& part: command.replacement)
+                result += part.group < 0 ? part.text : match.captured(part.group);
+            last = match.capturedEnd();
+
+            if(!command.bGlobal)
+                break;
+        }
+        result += line.mid(last);
+        return result;
+    }
+
+    std::vector<Command> mCommands;
+};
+
+/*
+    sort without options. Compares like sort does in the current locale.
+*/
+class SortLines: public Preprocessor
+{
+  public:
+    void processLine(const QString& line, const LineSink& out) override
+    {
+        Q_UNUSED(out);
+        mLines.push_back(line);
+    }
+
+    void finish(const LineSink& out) override
+    {
+        std::stable_sort(mLines.begin(), mLines.end(), [](const QString& a, const QString& b) { return QString::localeAwareCompare(a, b) < 0; });
+        for(const QString& line: mLines)
+            out(line);
+        mLines.clear();
+    }
+
+  private:
+    std::vector<QString> mLines;
+};
+
+// Reads up to the next unescaped delimiter, pos is left after it. An escaped delimiter is taken literally.
+bool readSedPart(const QString& script, const QChar delimiter, QtSizeType& pos, QString& part)
+{
+    static const QString regExpSpecialChars = QStringLiteral(".[]*^$\\+?(){}|");
+    part.clear();
+    for(; pos < script.length(); ++pos)
+    {
+        const QChar c = script[pos];
+        if(c == delimiter)
+        {
+            ++pos;
+            return true;
+        }
+
+        if(c == '\\' && pos + 1 < script.length())
+        {
+            ++pos;
+            if(script[pos] == delimiter)
+            {
+                // Can't tell whether a special char is meant literally here without parsing the expression.
+                if(regExpSpecialChars.contains(delimiter))
+                    return false;
+                part += delimiter;
+            }
+            else
+            {
+                part += c;
+                part += script[pos];
+            }
+            continue;
+        }
+        part += c;
+    }
+    return false;
+}
+
+/*
+    Turns a sed regular expression into the perl compatible syntax QRegularExpression uses.
+    Returns false for constructs without a sure equivalent.
+*/
+bool sedToPerlRegExp(const QString& sedRegExp, const bool bExtended, QString& regExp)
+{
+    static const QString basicLiteralChars = QStringLiteral("(){}|+?");
+    regExp.clear();
+    const QtSizeType length = sedRegExp.length();
+    for(QtSizeType i = 0; i < length; ++i)
+    {
+        const QChar c = sedRegExp[i];
+        if(c == '[')
+        {
+            // Bracket expression: "]" right after the start is literal, so is a backslash.
+            regExp += c;
+            ++i;
+            if(i < length && sedRegExp[i] == '^')
+                regExp += sedRegExp[i++];
+            if(i < length && sedRegExp[i] == ']')
+            {
+                regExp += "\\]";
+                ++i;
+            }
+            for(; i < length && sedRegExp[i] != ']'; ++i)
+            {
+                if(sedRegExp[i] == '\\')
+                    regExp += "\\\\";
+                else if(sedRegExp[i] == '[' && i + 1 < length && (sedRegExp[i + 1] == ':' || sedRegExp[i + 1] == '.' || sedRegExp[i + 1] == '='))
+                {
+                    // Character class like [:digit:], copied as is.
+                    const QtSizeType end = sedRegExp.indexOf(QString(sedRegExp[i + 1]) + ']', i + 2);
+                    if(end < 0)
+                        return false;
+                    regExp += sedRegExp.mid(i, end + 2 - i);
+                    i = end + 1;
+                }
+                else
+                    regExp += sedRegExp[i];
+            }
+            if(i >= length)
+                return false;
+            regExp += ']';
+        }
+        else if(c == '\\')
+        {
+            if(++i >= length)
+                return false;
+            const QChar next = sedRegExp[i];
+            if(!bExtended && basicLiteralChars.contains(next))
+                regExp += next;
+            else if(next.isLetterOrNumber() && !next.isDigit() && !QStringLiteral("wWsSbBn").contains(next))
+                return false; // GNU extensions perl spells differently.
+            else if(QStringLiteral("<>`'").contains(next))
+                return false;
+            else
+            {
+                regExp += c;
+                regExp += next;
+            }
+        }
+        else if(!bExtended && basicLiteralChars.contains(c))
+        {
+            regExp += '\\';
+            regExp += c;
+        }
+        else if(!bExtended && c == '*' && (regExp.isEmpty() || regExp == "^"))
+            regExp += "\\*"; // A leading '*' is literal in basic expressions.
+        else
+            regExp += c;
+    }
+    return true;
+}
+
+bool parseSedReplacement(const QString& replacement, std::vector<SedSubstitute::Command::Part>& parts)
+{
+    QString literal;
+    const auto addGroup = [&parts, &literal](const int group) {
+        if(!literal.isEmpty())
+            parts.push_back({literal, -1});
+        literal.clear();
+        parts.push_back({QString(), group});
+    };
+
+    for(QtSizeType i = 0; i < replacement.length(); ++i)
+    {
+        const QChar c = replacement[i];
+        if(c == '&')
+            addGroup(0);
+        else if(c == '\\' && i + 1 < replacement.length())
+        {
+            const QChar next = replacement[++i];
+            if(next.isDigit())
+                addGroup(next.digitValue());
+            else if(next == 'n')
+                literal += '\n';
+            else if(next.isLetter())
+                return false; // Case conversions like \U aren't supported.
+            else
+                literal += next;
+        }
+        else
+            literal += c;
+    }
+    if(!literal.isEmpty())
+        parts.push_back({literal, -1});
+    return true;
+}
+
+// Parses commands like "s/a/b/g;s#c#d#", nothing but substitutions is accepted.
+bool parseSedScript(const QString& script, const bool bExtended, std::vector<SedSubstitute::Command>& commands)
+{
+    QtSizeType pos = 0;
+    const QtSizeType length = script.length();
+    while(pos < length)
+    {
+        if(script[pos].isSpace() || script[pos] == ';')
+        {
+            ++pos;
+            continue;
+        }
+        if(script[pos] != 's' || pos + 1 >= length || script[pos + 1] == '\\' || script[pos + 1] == '\n')
+            return false;
+
+        const QChar delimiter = script[pos + 1];
+        pos += 2;
+        QString sedRegExp, replacement, regExp;
+        if(!readSedPart(script, delimiter, pos, sedRegExp) || !readSedPart(script, delimiter, pos, replacement))
+            return false;
+
+        SedSubstitute::Command command;
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+        for(; pos < length && script[pos] != ';' && !script[pos].isSpace(); ++pos)
+        {
+            if(script[pos] == 'g')
+                command.bGlobal = true;
+            else if(script[pos] == 'I' || script[pos] == 'i')
+                options |= QRegularExpression::CaseInsensitiveOption;
+            else
+                return false;
+        }
+
+        if(sedRegExp.isEmpty() || !sedToPerlRegExp(sedRegExp, bExtended, regExp) || !parseSedReplacement(replacement, command.replacement))
+            return false;
+
+        command.regExp = QRegularExpression(regExp, options);
+        if(!command.regExp.isValid())
+            return false;
+        command.regExp.optimize();
+
+        commands.push_back(std::move(command));
+    }
+    return !commands.empty();
+}
+
+std::unique_ptr<Preprocessor> sedFromArguments(const QStringList& args)
+{
+    QStringList scripts;
+    bool bExtended = false;
+    bool bScriptOption = false;
+    for(QtSizeType i = 0; i < args.size(); ++i)
+    {
+        const QString& arg = args[i];
+        if(arg == "-E" || arg == "-r" || arg == "--regexp-extended")
+            bExtended = true;
+        else if(arg == "-e" && i + 1 < args.size())
+        {
+            scripts.append(args[++i]);
+            bScriptOption = true;
+        }
+        else if(arg.startsWith("--expression="))
+        {
+            scripts.append(arg.mid(QString("--expression=").length()));
+            bScriptOption = true;
+        }
+        else if(arg.startsWith('-') || bScriptOption || !scripts.isEmpty())
+            return nullptr; // Other options or input files.
+        else
+            scripts.append(arg);
+    }
+
+    std::vector<SedSubstitute::Command> commands;
+    for(const QString& script: scripts)
+    {
+        if(!parseSedScript(script, bExtended, commands))
+            return nullptr;
+    }
+    if(commands.empty())
+        return nullptr;
+
+    return std::make_unique<SedSubstitute>(std::move(commands));
+}
+} // namespace
+
+QString Preprocessor::run(const QString& text)
+{
+    QString result;
+    result.reserve(text.size());
+    const LineSink out = [&result](const QString& line) {
+        result += line;
+        result += '\n';
+    };
+
+    QtSizeType pos = 0;
+    while(pos < text.size())
+    {
+        QtSizeType lineEnd = text.indexOf('\n', pos);
+        if(lineEnd < 0)
+            lineEnd = text.size();
+        processLine(QString::fromRawData(text.constData() + pos, lineEnd - pos), out);
+        pos = lineEnd + 1;
+    }
+    finish(out);
+
+    if(!text.endsWith('\n') && result.endsWith('\n'))
+        result.chop(1);
+    return result;
+}
+
+std::unique_ptr<Preprocessor> Preprocessor::fromCommand(const QString& cmd)
+{
+    if(cmd.isEmpty())
+        return nullptr;
+
+    QString program;
+    QStringList args;
+    if(!Utils::getArguments(cmd, program, args).isEmpty())
+        return nullptr;
+
+    const QString programName = QFileInfo(program).completeBaseName();
+    if(programName == "sed")
+        return sedFromArguments(args);
+    if(programName == "sort" && args.isEmpty())
+        return std::make_unique<SortLines>();
+
+    return nullptr;
+}
@@ -0,0 +1,45 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+#include <functional>
+#include <memory>
+
+#include <QString>
+
+/*
+    In process replacement for a preprocessor command.
+
+    Running the preprocessor commands means two temp files and a process per file, which adds up
+    in a directory comparison. The commands people use most are simple sed substitutions and sort,
+    fromCommand() recognizes those and returns an object doing the same on the decoded text.
+    Anything it doesn't fully understand is left to the external command.
+*/
+class Preprocessor
+{
+  public:
+    using LineSink = std::function<void(const QString& line)>;
+
+    virtual ~Preprocessor() = default;
+
+    // Called for each input line without its line end. Output lines are passed to out.
+    virtual void processLine(const QString& line, const LineSink& out) = 0;
+    // Called after the last line, for preprocessors that need to see all lines first.
+    virtual void finish(const LineSink& out) { Q_UNUSED(out); }
+
+    // Lines end at '\n'. If the last line of text has no line end the result has none either.
+    [[nodiscard]] QString run(const QString& text);
+
+    // Returns nullptr if cmd has to be run as a process.
+    [[nodiscard]] static std::unique_ptr<Preprocessor> fromCommand(const QString& cmd);
+};
+
+#endif
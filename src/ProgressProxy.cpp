@@ -14,8 +14,10 @@
 
 #include <boost/signals2.hpp>
 
+#include <QCoreApplication>
 #include <QDialog>
 #include <QString>
+#include <QThread>
 
 namespace signals2 = boost::signals2;
 /*
@@ -41,53 +43,74 @@ signals2::signal<void(bool)> ProgressProxy::stepSig;
 signals2::signal<void(double, double)> ProgressProxy::setRangeTransformationSig;
 signals2::signal<void(double, double)> ProgressProxy::setSubRangeTransformationSig;
 
+signals2::signal<void(const std::shared_ptr<const ParallelProgress>&)> ProgressProxy::trackParallelSig;
+
 signals2::signal<bool(), find> ProgressProxy::wasCancelledSig;
 
 signals2::signal<void(const QString&, bool)> ProgressProxy::setInformationSig;
 
 ProgressProxy::ProgressProxy()
 {
-    push();
+    const QCoreApplication* pApp = QCoreApplication::instance();
+    mActive = pApp == nullptr || QThread::currentThread() == pApp->thread();
+
+    if(mActive)
+        push();
 }
 
 ProgressProxy::~ProgressProxy()
 {
-    pop(false);
+    if(mActive)
+        pop(false);
 }
 
 void ProgressProxy::setInformation(const QString& info, bool bRedrawUpdate)
 {
+    if(!mActive) return;
+
     setInformationSig(info, bRedrawUpdate);
 }
 
 void ProgressProxy::setInformation(const QString& info, int current, bool bRedrawUpdate)
 {
+    if(!mActive) return;
+
     setCurrentSig(current, false);
     setInformationSig(info, bRedrawUpdate);
 }
 
 void ProgressProxy::setCurrent(quint64 current, bool bRedrawUpdate)
 {
+    if(!mActive) return;
+
     setCurrentSig(current, bRedrawUpdate);
 }
 
 void ProgressProxy::step(bool bRedrawUpdate)
 {
+    if(!mActive) return;
+
     stepSig(bRedrawUpdate);
 }
 
 void ProgressProxy::clear()
 {
+    if(!mActive) return;
+
     clearSig();
 }
 
 void ProgressProxy::setMaxNofSteps(const quint64 maxNofSteps)
 {
+    if(!mActive) return;
+
     setMaxNofStepsSig(maxNofSteps);
 }
 
 void ProgressProxy::addNofSteps(const quint64 nofSteps)
 {
+    if(!mActive) return;
+
     addNofStepsSig(nofSteps);
 }
 
@@ -98,10 +121,21 @@ bool ProgressProxy::wasCancelled()
 
 void ProgressProxy::setRangeTransformation(double dMin, double dMax)
 {
+    if(!mActive) return;
+
     setRangeTransformationSig(dMin, dMax);
 }
 
 void ProgressProxy::setSubRangeTransformation(double dMin, double dMax)
 {
+    if(!mActive) return;
+
     setSubRangeTransformationSig(dMin, dMax);
 }
+
+void ProgressProxy::trackParallel(const std::shared_ptr<const ParallelProgress>& pProgress)
+{
+    if(!mActive) return;
+
+    trackParallelSig(pProgress);
+}
@@ -11,8 +11,11 @@
 #ifndef PROGRESSPROXY_H
 #define PROGRESSPROXY_H
 
+#include "ParallelProgress.h"
 #include "combiners.h"
 
+#include <memory>
+
 #include <boost/signals2.hpp>
 
 #include <QObject>
@@ -23,6 +26,9 @@ class KJob;
 
 namespace signals2 = boost::signals2;
 // When using the ProgressProxy you need not take care of the push and pop, except when explicit.
+// A ProgressProxy created outside the GUI thread is silent. The progress stack is owned by the
+// GUI thread so worker tasks must let the code that started them report progress on their behalf,
+// either from its own loop or by handing them a ParallelProgress given to trackParallel().
 class ProgressProxy: public QObject
 {
     Q_OBJECT
@@ -40,6 +46,8 @@ class ProgressProxy: public QObject
     bool wasCancelled();
     void setRangeTransformation(double dMin, double dMax);
     void setSubRangeTransformation(double dMin, double dMax);
+    // The current level follows the steps of pProgress until it is popped. Range transformations apply as usual.
+    void trackParallel(const std::shared_ptr<const ParallelProgress>& pProgress);
 
     static signals2::signal<void()> startBackgroundTask;
     static signals2::signal<void()> endBackgroundTask;
@@ -59,9 +67,14 @@ class ProgressProxy: public QObject
     static signals2::signal<void(double, double)> setRangeTransformationSig;
     static signals2::signal<void(double, double)> setSubRangeTransformationSig;
 
+    static signals2::signal<void(const std::shared_ptr<const ParallelProgress>&)> trackParallelSig;
+
     static signals2::signal<bool(), find> wasCancelledSig;
 
     static signals2::signal<void(const QString&, bool)> setInformationSig;
+
+  private:
+    bool mActive = true;
 };
 
 #endif /* PROGRESSPROXY_H */
@@ -0,0 +1,60 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "QuickCompare.h"
+
+#include <algorithm>
+#include <memory>
+#include <string.h> // for memcmp
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+constexpr qint64 blockSize = 1024 * 1024;
+}
+
+bool QuickCompare::identicalFiles(const QStringList& fileNames)
+{
+    if(fileNames.size() < 2)
+        return false;
+
+    qint64 size = -1;
+    for(const QString& fileName: fileNames)
+    {
+        const QFileInfo fi(fileName);
+        if(!fi.isFile() || fi.size() > maxFileSize || (size >= 0 && fi.size() != size))
+            return false;
+        size = fi.size();
+    }
+
+    std::vector<std::unique_ptr<QFile>> files;
+    for(const QString& fileName: fileNames)
+    {
+        files.push_back(std::make_unique<QFile>(fileName));
+        if(!files.back()->open(QIODevice::ReadOnly))
+            return false;
+    }
+
+    QByteArray first(blockSize, '\0');
+    QByteArray other(blockSize, '\0');
+    for(qint64 pos = 0; pos < size; pos += blockSize)
+    {
+        const qint64 length = std::min(blockSize, size - pos);
+        if(files[0]->read(first.data(), length) != length)
+            return false;
+        for(size_t i = 1; i < files.size(); ++i)
+        {
+            if(files[i]->read(other.data(), length) != length || memcmp(first.constData(), other.constData(), length) != 0)
+                return false;
+        }
+    }
+    return true;
+}
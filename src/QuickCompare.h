@@ -0,0 +1,30 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef QUICKCOMPARE_H
+#define QUICKCOMPARE_H
+
+#include <QStringList>
+#include <QtGlobal>
+
+/*
+    Checks whether files are byte for byte the same without starting KDiff3, for the file manager
+    integrations. Sizes are compared first and contents only if they agree. Anything that isn't a
+    local regular file, or is larger than maxFileSize, counts as different: the file manager waits
+    for the check, and KDiff3 handles these as before.
+*/
+class QuickCompare
+{
+  public:
+    static constexpr qint64 maxFileSize = 64 * 1024 * 1024;
+
+    [[nodiscard]] static bool identicalFiles(const QStringList& fileNames);
+};
+
+#endif
@@ -0,0 +1,155 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "RemoteDirectoryLister.h"
+
+#include "defmac.h"
+#include "fileaccess.h"
+#include "IgnoreList.h"
+#include "Logging.h"
+#include "ProgressProxy.h"
+
+#include <utility>
+
+#include <KIO/Job>
+#include <KIO/JobUiDelegate>
+#include <KIO/ListJob>
+#include <KJob>
+#include <KLocalizedString>
+
+int RemoteDirectoryLister::s_maxJobs = 8;
+
+RemoteDirectoryLister::RemoteDirectoryLister(const bool bRecursive, const QString& filePattern, const QString& fileAntiPattern,
+                                             const QString& dirAntiPattern, const bool bFollowDirLinks):
+    mRecursive(bRecursive),
+    mNameFilter(filePattern, fileAntiPattern, dirAntiPattern),
+    mFollowDirLinks(bFollowDirLinks)
+{
+}
+
+RemoteDirectoryLister::~RemoteDirectoryLister()
+{
+    cancel();
+}
+
+bool RemoteDirectoryLister::list(FileAccess& dir, DirectoryList& dirList, IgnoreList& ignoreList)
+{
+    ProgressProxy pp;
+    Node root(&dir);
+
+    dirList.clear();
+    mWaiting.push_back(&root);
+    startJobs();
+
+    qint64 nofListed = 0;
+    while(!mRunning.isEmpty() || !mListed.empty())
+    {
+        // Jobs only queue what they listed, so nothing changes under filter() when it runs an event loop.
+        if(mListed.empty())
+        {
+            mLoop.exec();
+            continue;
+        }
+
+        Node* pNode = mListed.front();
+        mListed.pop_front();
+        filter(pNode, ignoreList);
+        startJobs();
+
+        ++nofListed;
+        pp.setInformation(i18nc("Status message", "Reading folders: %1 read", nofListed), false);
+        if(pp.wasCancelled())
+        {
+            cancel();
+            break;
+        }
+    }
+
+    collect(root, dirList);
+    return root.bSuccess;
+}
+
+void RemoteDirectoryLister::startJobs()
+{
+    while(!mWaiting.empty() && mRunning.size() < s_maxJobs)
+    {
+        Node* pNode = mWaiting.front();
+        mWaiting.pop_front();
+
+        qCInfo(kdiffFileAccess) << "Reading folder: " << pNode->dir->absoluteFilePath();
+        KIO::ListJob* pListJob = KIO::listDir(pNode->dir->url(), KIO::HideProgressInfo, true /*bFindHidden*/);
+        mRunning.insert(pListJob);
+
+        const auto newEntries = [pNode](KIO::Job*, const KIO::UDSEntryList& l) {
+            //This function is called for non-local urls. Don't use QUrl::fromLocalFile here as it does not handle these.
+            for(const KIO::UDSEntry& e: l)
+            {
+                FileAccess fa;
+                fa.setFromUdsEntry(e, pNode->dir);
+
+                //must be manually filtered KDE does not supply API for ignoring these.
+                if(fa.fileName() != "." && fa.fileName() != ".." && fa.isValid())
+                    pNode->entries.push_back(std::move(fa));
+            }
+        };
+        const auto listed = [this, pNode](KJob* pJob) {
+            if(pJob->error() != KJob::NoError)
+            {
+                qCDebug(kdiffFileAccess) << "RemoteDirectoryLister: pJob->error() = " << pJob->error();
+                pJob->uiDelegate()->showErrorMessage();
+            }
+            pNode->bSuccess = pJob->error() == KJob::NoError;
+
+            mRunning.remove(pJob);
+            mListed.push_back(pNode);
+            mLoop.quit();
+        };
+        chk_connect_a(pListJob, &KIO::ListJob::entries, this, newEntries);
+        chk_connect_a(pListJob, &KIO::ListJob::result, this, listed);
+    }
+}
+
+void RemoteDirectoryLister::filter(Node* pNode, IgnoreList& ignoreList)
+{
+    const QString path = pNode->dir->absoluteFilePath();
+    ignoreList.enterDir(path, pNode->entries);
+    pNode->dir->filterList(path, &pNode->entries, mNameFilter, ignoreList);
+
+    if(!mRecursive)
+        return;
+
+    // Entries are list nodes, their addresses stay valid as parents of the next level.
+    for(FileAccess& entry: pNode->entries)
+    {
+        assert(entry.isValid());
+        if(entry.isDir() && (!entry.isSymLink() || mFollowDirLinks))
+        {
+            pNode->children.push_back(std::make_unique<Node>(&entry));
+            mWaiting.push_back(pNode->children.back().get());
+        }
+    }
+}
+
+void RemoteDirectoryLister::cancel()
+{
+    // Killed quietly the jobs don't report back.
+    for(KJob* pJob: std::as_const(mRunning))
+        pJob->kill(KJob::Quietly);
+
+    mRunning.clear();
+    mWaiting.clear();
+    mListed.clear();
+}
+
+void RemoteDirectoryLister::collect(Node& node, DirectoryList& dirList)
+{
+    dirList.splice(dirList.end(), node.entries);
+    for(const std::unique_ptr<Node>& child: node.children)
+        collect(*child, dirList);
+}
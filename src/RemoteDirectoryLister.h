@@ -0,0 +1,80 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef REMOTEDIRECTORYLISTER_H
+#define REMOTEDIRECTORYLISTER_H
+
+#include "DirectoryList.h"
+#include "FileNameFilter.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QEventLoop>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class FileAccess;
+class IgnoreList;
+class KJob;
+
+/*
+    Lists KIO folders with several list jobs in flight.
+
+    Listing a folder one after another costs a round trip each, which is what a remote folder
+    comparison mostly waits for. Here every folder found is queued and up to maxJobs() of them are
+    listed at the same time. Filtering stays in the gui thread and is done as the folders arrive.
+    The result has the same order as a folder by folder listing. The entries of a listing carry
+    all file details, no separate stat is needed afterwards.
+*/
+class RemoteDirectoryLister: public QObject
+{
+  public:
+    RemoteDirectoryLister(const bool bRecursive, const QString& filePattern, const QString& fileAntiPattern,
+                          const QString& dirAntiPattern, const bool bFollowDirLinks);
+    ~RemoteDirectoryLister() override;
+
+    // Returns false if dir itself couldn't be listed. Being cancelled is not an error.
+    bool list(FileAccess& dir, DirectoryList& dirList, IgnoreList& ignoreList);
+
+    static void setMaxJobs(const int maxJobs) { s_maxJobs = std::max(maxJobs, 1); }
+    [[nodiscard]] static int maxJobs() { return s_maxJobs; }
+
+  private:
+    struct Node
+    {
+        explicit Node(FileAccess* pDir): dir(pDir) {}
+
+        FileAccess* dir;
+        DirectoryList entries;
+        std::vector<std::unique_ptr<Node>> children;
+        bool bSuccess = false;
+    };
+
+    void startJobs();
+    void filter(Node* pNode, IgnoreList& ignoreList);
+    void cancel();
+    static void collect(Node& node, DirectoryList& dirList);
+
+    static int s_maxJobs;
+
+    bool mRecursive;
+    FileNameFilter mNameFilter;
+    bool mFollowDirLinks;
+
+    std::deque<Node*> mWaiting;
+    std::deque<Node*> mListed;
+    QSet<KJob*> mRunning;
+    QEventLoop mLoop;
+};
+
+#endif
@@ -0,0 +1,135 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "RemoteHasher.h"
+
+#include "Logging.h"
+
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <KLocalizedString>
+
+namespace {
+QMutex gFailedHostsMutex;
+QSet<QString> gFailedHosts;
+
+QString hostKey(const QUrl& url)
+{
+    return url.userName() + '@' + url.host() + ':' + QString::number(url.port());
+}
+} // namespace
+
+bool RemoteHasher::canHash(const QUrl& url)
+{
+    const QString scheme = url.scheme();
+    return (scheme == QLatin1String("sftp") || scheme == QLatin1String("fish")) && !url.host().isEmpty();
+}
+
+QString RemoteHasher::shellQuote(const QString& s)
+{
+    QString quoted = s;
+    quoted.replace('\'', QStringLiteral("'\\''"));
+    return '\'' + quoted + '\'';
+}
+
+QStringList RemoteHasher::sshArguments(const QUrl& url, const QString& remoteCommand)
+{
+    QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if(runtimeDir.isEmpty())
+        runtimeDir = QDir::tempPath();
+
+    QStringList arguments = {QStringLiteral("-o"), QStringLiteral("BatchMode=yes"),
+                             QStringLiteral("-o"), QStringLiteral("ControlMaster=auto"),
+                             QStringLiteral("-o"), QStringLiteral("ControlPath=") + runtimeDir + QStringLiteral("/kdiff3-ssh-%C"),
+                             QStringLiteral("-o"), QStringLiteral("ControlPersist=60")};
+    if(url.port() > 0)
+        arguments << QStringLiteral("-p") << QString::number(url.port());
+    if(!url.userName().isEmpty())
+        arguments << QStringLiteral("-l") << url.userName();
+    arguments << QStringLiteral("--") << url.host() << remoteCommand;
+    return arguments;
+}
+
+bool RemoteHasher::parseDigest(const QByteArray& output, QByteArray& digest)
+{
+    constexpr int hexLength = 64;
+    if(output.size() < hexLength)
+        return false;
+
+    const QByteArray hex = output.left(hexLength);
+    for(const char c: hex)
+    {
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            return false;
+    }
+    // The name follows after white space.
+    if(output.size() > hexLength && output[hexLength] != ' ' && output[hexLength] != '\t' && output[hexLength] != '\n')
+        return false;
+
+    digest = QByteArray::fromHex(hex);
+    return true;
+}
+
+bool RemoteHasher::hash(const QUrl& url, QByteArray& digest, QString& errorString, const std::function<bool()>& isCancelled)
+{
+    if(!canHash(url))
+        return false;
+
+    {
+        QMutexLocker locker(&gFailedHostsMutex);
+        if(gFailedHosts.contains(hostKey(url)))
+            return false;
+    }
+
+    const QString path = shellQuote(url.path(QUrl::FullyDecoded));
+    const QString command = QStringLiteral("sha256sum -b -- %1 2>/dev/null || shasum -a 256 -b -- %1").arg(path);
+
+    QProcess process;
+    process.start(QStringLiteral("ssh"), sshArguments(url, command));
+    if(!process.waitForStarted())
+    {
+        errorString = process.errorString();
+        QMutexLocker locker(&gFailedHostsMutex);
+        gFailedHosts.insert(hostKey(url));
+        return false;
+    }
+    process.closeWriteChannel();
+
+    while(!process.waitForFinished(200))
+    {
+        if(process.state() == QProcess::NotRunning)
+            break;
+        if(isCancelled())
+        {
+            process.kill();
+            process.waitForFinished();
+            errorString = i18n("Cancelled.");
+            return false;
+        }
+    }
+
+    if(process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0 || !parseDigest(process.readAllStandardOutput(), digest))
+    {
+        errorString = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+        qCInfo(kdiffFileAccess) << "Hashing on" << url.host() << "failed, reading files instead:" << errorString;
+        // Exit code 255 is ssh itself failing, anything else may be just this file.
+        if(process.exitCode() == 255 || process.exitStatus() != QProcess::NormalExit)
+        {
+            QMutexLocker locker(&gFailedHostsMutex);
+            gFailedHosts.insert(hostKey(url));
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef REMOTEHASHER_H
+#define REMOTEHASHER_H
+
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+/*
+    SHA-256 of files on sftp and fish locations, calculated on their host over ssh.
+
+    KIO would have to download a file to compare its bytes. Running sha256sum (or shasum on
+    systems without it) on the remote host moves only the digest. ssh runs in batch mode, so this
+    needs a key or agent that works without a prompt, and all runs share one master connection.
+    A host where it fails once isn't tried again, the caller then falls back to reading the files.
+*/
+class RemoteHasher
+{
+  public:
+    // True for the protocols that reach their host over ssh.
+    [[nodiscard]] static bool canHash(const QUrl& url);
+
+    // isCancelled is polled while waiting, returning true stops the remote command.
+    static bool hash(const QUrl& url, QByteArray& digest, QString& errorString, const std::function<bool()>& isCancelled);
+
+    [[nodiscard]] static QStringList sshArguments(const QUrl& url, const QString& remoteCommand);
+    // Quoted for a POSIX shell.
+    [[nodiscard]] static QString shellQuote(const QString& s);
+    // The digest in the first line written by sha256sum or shasum.
+    [[nodiscard]] static bool parseDigest(const QByteArray& output, QByteArray& digest);
+};
+
+#endif
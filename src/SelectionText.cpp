@@ -0,0 +1,129 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "SelectionText.h"
+
+#include "diff.h"
+
+#include <algorithm>
+
+namespace {
+const QString textPlain = QStringLiteral("text/plain");
+} // namespace
+
+void SelectionText::append(const LineData& line, const QtSizeType pos, const QtSizeType length)
+{
+    const QtSizeType start = std::min(pos, line.size());
+    const QtSizeType count = length < 0 ? line.size() - start : std::min(length, line.size() - start);
+    if(count <= 0 || line.getBuffer() == nullptr)
+        return;
+
+    // Lines of one input come from one buffer, comparing the data pointer finds it again quickly.
+    const QChar* pData = line.getBuffer()->constData();
+    qint32 buffer = (qint32)mBuffers.size() - 1;
+    while(buffer >= 0 && mBuffers[buffer].constData() != pData)
+        --buffer;
+    if(buffer < 0)
+    {
+        mBuffers.push_back(*line.getBuffer());
+        buffer = (qint32)mBuffers.size() - 1;
+    }
+
+    appendPiece(buffer, line.getOffset() + start, count);
+}
+
+void SelectionText::append(const QString& text)
+{
+    if(text.isEmpty())
+        return;
+
+    const QtSizeType offset = mLiterals.size();
+    mLiterals += text;
+    appendPiece(-1, offset, text.size());
+}
+
+void SelectionText::appendLineEnd()
+{
+    // Inputs keep a '\n' after each line, taking it from there lets a run of whole lines stay one piece.
+    if(!mPieces.isEmpty() && mPieces.back().buffer >= 0)
+    {
+        const Piece& last = mPieces.back();
+        const QString& buffer = bufferOf(last);
+        const QtSizeType end = last.offset + last.length;
+        if(end < buffer.size() && buffer[end] == '\n')
+        {
+            appendPiece(last.buffer, end, 1);
+            return;
+        }
+    }
+
+    append(QStringLiteral("\n"));
+}
+
+void SelectionText::appendPiece(const qint32 buffer, const QtSizeType offset, const QtSizeType length)
+{
+    mLength += length;
+    if(!mPieces.isEmpty() && mPieces.back().buffer == buffer && mPieces.back().offset + mPieces.back().length == offset)
+    {
+        mPieces.back().length += length;
+        return;
+    }
+    mPieces.push_back({buffer, offset, length});
+}
+
+QString SelectionText::toString() const
+{
+    QString result;
+    result.reserve((QtSizeType)std::min<qint64>(mLength, limits<QtSizeType>::max()));
+    for(const Piece& piece: mPieces)
+    {
+        const QChar* pData = bufferOf(piece).constData() + piece.offset;
+#if defined(Q_OS_WIN)
+        QtSizeType start = 0;
+        for(QtSizeType i = 0; i < piece.length; ++i)
+        {
+            if(pData[i] == '\n')
+            {
+                result.append(pData + start, i - start);
+                result += QStringLiteral("\r\n");
+                start = i + 1;
+            }
+        }
+        result.append(pData + start, piece.length - start);
+#else
+        result.append(pData, piece.length);
+#endif
+    }
+    return result;
+}
+
+bool SelectionMimeData::hasFormat(const QString& mimeType) const
+{
+    return mimeType == textPlain || QMimeData::hasFormat(mimeType);
+}
+
+QStringList SelectionMimeData::formats() const
+{
+    QStringList result = QMimeData::formats();
+    if(!result.contains(textPlain))
+        result.prepend(textPlain);
+    return result;
+}
+
+#if(QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+QVariant SelectionMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+#else
+QVariant SelectionMimeData::retrieveData(const QString& mimeType, QMetaType type) const
+#endif
+{
+    if(mimeType == textPlain)
+        return mText.toString();
+
+    return QMimeData::retrieveData(mimeType, type);
+}
@@ -0,0 +1,86 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef SELECTIONTEXT_H
+#define SELECTIONTEXT_H
+
+#include "LineRef.h"
+
+#include <QMimeData>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+class LineData;
+
+/*
+    Selected text as pieces of the buffers it was taken from. The buffers are shared, not copied, so
+    describing a selection costs one piece per run of adjacent text rather than its characters, and
+    a selection of a whole input is a single piece. QString shares its data on copy, a buffer that
+    is cleared or rebuilt by a reload detaches from the copy held here and the selection stays valid.
+*/
+class SelectionText
+{
+  public:
+    // Appends the line of an input without copying its text, part from pos on when length is given.
+    void append(const LineData& line, const QtSizeType pos = 0, const QtSizeType length = -1);
+    // Text that isn't part of an input, this is copied.
+    void append(const QString& text);
+    // A '\n' that becomes "\r\n" on Windows when the text is built.
+    void appendLineEnd();
+
+    [[nodiscard]] bool isEmpty() const { return mLength == 0; }
+    // Number of characters before line ends are converted.
+    [[nodiscard]] qint64 length() const { return mLength; }
+
+    // Builds the text piece by piece into a buffer allocated once.
+    [[nodiscard]] QString toString() const;
+
+  private:
+    struct Piece
+    {
+        qint32 buffer; // Index into mBuffers, -1 for mLiterals.
+        QtSizeType offset;
+        QtSizeType length;
+    };
+
+    void appendPiece(const qint32 buffer, const QtSizeType offset, const QtSizeType length);
+    [[nodiscard]] const QString& bufferOf(const Piece& piece) const { return piece.buffer < 0 ? mLiterals : mBuffers[piece.buffer]; }
+
+    QVector<QString> mBuffers;
+    QString mLiterals;
+    QVector<Piece> mPieces;
+    qint64 mLength = 0;
+};
+
+/*
+    Clipboard data that builds its text only when a program asks for it. Copying a selection is then
+    as cheap as describing it, and the text is never built if nothing is pasted.
+*/
+class SelectionMimeData: public QMimeData
+{
+  public:
+    explicit SelectionMimeData(const SelectionText& text): mText(text) {}
+
+    [[nodiscard]] bool hasFormat(const QString& mimeType) const override;
+    [[nodiscard]] QStringList formats() const override;
+
+  protected:
+#if(QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    [[nodiscard]] QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override;
+#else
+    [[nodiscard]] QVariant retrieveData(const QString& mimeType, QMetaType type) const override;
+#endif
+
+  private:
+    SelectionText mText;
+};
+
+#endif
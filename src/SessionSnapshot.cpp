@@ -0,0 +1,382 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "SessionSnapshot.h"
+
+#include "TypeUtils.h"
+
+#include <cstring>
+#include <utility>
+
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <KLocalizedString>
+
+namespace {
+constexpr quint32 fileMagic = 0x5353444B; // "KDSS"
+constexpr quint32 fileVersion = 1;
+constexpr qint64 lineRecordSize = 16; // Offset, size, first non white character and flags.
+constexpr qint64 diffRecordSize = 12; // Equal lines and the differing lines on both sides.
+// Larger values are passed to the device in one write.
+constexpr QtSizeType flushSize = 1024 * 1024;
+
+constexpr quint32 tryHardFlag = 1 << 0;
+constexpr quint32 ignoreNumbersFlag = 1 << 1;
+
+constexpr quint32 incompleteConversionFlag = 1 << 0;
+constexpr quint32 eolTerminationFlag = 1 << 1;
+
+constexpr quint32 skipableFlag = 1 << 0;
+constexpr quint32 pureCommentFlag = 1 << 1;
+
+// Collects the small values and writes them in large pieces.
+class Writer
+{
+  public:
+    explicit Writer(QIODevice& device):
+        mDevice(device) {}
+
+    void u32(quint32 value)
+    {
+        value = qToLittleEndian(value);
+        mBuffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        if(mBuffer.size() >= flushSize)
+            flush();
+    }
+
+    void i64(const qint64 value)
+    {
+        u32((quint32)((quint64)value & 0xFFFFFFFF));
+        u32((quint32)((quint64)value >> 32));
+    }
+
+    // Length and UTF-16 units, padded to four bytes.
+    void string(const QString& s)
+    {
+        u32((quint32)s.size());
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        flush();
+        const qint64 bytes = (qint64)s.size() * 2;
+        mbOk = mbOk && mDevice.write(reinterpret_cast<const char*>(s.constData()), bytes) == bytes;
+#else
+        for(const QChar c: s)
+            u16(c.unicode());
+#endif
+        if(s.size() % 2 != 0)
+            u16(0);
+    }
+
+    bool flush()
+    {
+        if(!mBuffer.isEmpty())
+        {
+            mbOk = mbOk && mDevice.write(mBuffer) == mBuffer.size();
+            mBuffer.clear();
+        }
+        return mbOk;
+    }
+
+  private:
+    void u16(quint16 value)
+    {
+        value = qToLittleEndian(value);
+        mBuffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        if(mBuffer.size() >= flushSize)
+            flush();
+    }
+
+    QIODevice& mDevice;
+    QByteArray mBuffer;
+    bool mbOk = true;
+};
+
+// Reads from the mapped file, every read fails past its end.
+class Reader
+{
+  public:
+    Reader(const uchar* pData, const qint64 size):
+        mpData(pData), mSize(size) {}
+
+    bool u32(quint32& value)
+    {
+        if(mPos + 4 > mSize)
+            return false;
+        value = qFromLittleEndian<quint32>(mpData + mPos);
+        mPos += 4;
+        return true;
+    }
+
+    bool i64(qint64& value)
+    {
+        quint32 low = 0, high = 0;
+        if(!u32(low) || !u32(high))
+            return false;
+        value = (qint64)(((quint64)high << 32) | low);
+        return true;
+    }
+
+    bool string(QString& s)
+    {
+        quint32 length = 0;
+        if(!u32(length))
+            return false;
+        const qint64 bytes = ((qint64)length * 2 + 3) / 4 * 4;
+        if(mPos + bytes > mSize || length > (quint64)limits<QtSizeType>::max())
+            return false;
+
+        s = QString((QtSizeType)length, Qt::Uninitialized);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        memcpy(s.data(), mpData + mPos, (size_t)length * 2);
+#else
+        for(quint32 i = 0; i < length; ++i)
+            s[(QtSizeType)i] = QChar(qFromLittleEndian<quint16>(mpData + mPos + i * 2));
+#endif
+        mPos += bytes;
+        return true;
+    }
+
+    // Start of count records, nullptr if the file is too short for them.
+    const uchar* records(const quint32 count, const qint64 recordSize)
+    {
+        if(mPos + count * recordSize > mSize)
+            return nullptr;
+        const uchar* p = mpData + mPos;
+        mPos += count * recordSize;
+        return p;
+    }
+
+  private:
+    const uchar* mpData;
+    qint64 mSize;
+    qint64 mPos = 0;
+};
+
+quint32 readU32(const uchar* p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+} // namespace
+
+void SessionSnapshot::clear()
+{
+    mInputs.clear();
+    mSettings = Settings();
+    for(int i = 0; i < pairCount; ++i)
+    {
+        mLineMatching[i].clear();
+        mbHasLineMatching[i] = false;
+    }
+}
+
+void SessionSnapshot::setLineMatching(const Pair pair, const DiffList& diffList)
+{
+    mLineMatching[pair] = diffList;
+    mbHasLineMatching[pair] = true;
+}
+
+bool SessionSnapshot::load(const QString& fileName)
+{
+    clear();
+    mErrorString.clear();
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        mErrorString = file.errorString();
+        return false;
+    }
+
+    QByteArray buffer;
+    qint64 size = file.size();
+    const uchar* pData = size > 0 ? file.map(0, size) : nullptr;
+    if(pData == nullptr)
+    {
+        buffer = file.readAll();
+        size = buffer.size();
+        pData = reinterpret_cast<const uchar*>(buffer.constData());
+    }
+
+    if(!parse(pData, size))
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool SessionSnapshot::parse(const uchar* pData, const qint64 size)
+{
+    Reader reader(pData, size);
+    quint32 magic = 0, version = 0;
+    if(!reader.u32(magic) || magic != fileMagic || !reader.u32(version) || version != fileVersion)
+    {
+        mErrorString = i18n("Not a comparison snapshot or written by another version.");
+        return false;
+    }
+
+    const auto corrupt = [this]() {
+        mErrorString = i18n("The comparison snapshot is damaged.");
+        return false;
+    };
+
+    quint32 inputCount = 0, settingsFlags = 0, lineDiffAlgorithm = 0, pairMask = 0;
+    if(!reader.u32(inputCount) || !reader.u32(settingsFlags) || !reader.u32(lineDiffAlgorithm) || !reader.u32(pairMask) ||
+       inputCount < 2 || inputCount > 3)
+        return corrupt();
+
+    mSettings.lineDiffAlgorithm = (int)lineDiffAlgorithm;
+    mSettings.bTryHard = (settingsFlags & tryHardFlag) != 0;
+    mSettings.bIgnoreNumbers = (settingsFlags & ignoreNumbersFlag) != 0;
+
+    for(quint32 i = 0; i < inputCount; ++i)
+    {
+        Input input;
+        QString encodingName;
+        qint64 msecs = 0;
+        quint32 flags = 0, lineEndStyle = 0, lineCount = 0;
+        if(!reader.string(input.fileName) || !reader.string(input.aliasName) || !reader.string(encodingName) ||
+           !reader.i64(input.size) || !reader.i64(msecs) || !reader.u32(flags) || !reader.u32(lineEndStyle) || !reader.u32(lineCount) ||
+           lineEndStyle > eLineEndStyleConflict || lineCount == 0 || lineCount > (quint32)limits<LineType>::max())
+            return corrupt();
+
+        const uchar* pLines = reader.records(lineCount, lineRecordSize);
+        QSharedPointer<QString> text = QSharedPointer<QString>::create();
+        if(pLines == nullptr || !reader.string(*text))
+            return corrupt();
+
+        input.encodingName = encodingName.toLatin1();
+        input.lastModified = QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC);
+        input.decoded.eLineEndStyle = (e_LineEndStyle)lineEndStyle;
+        input.decoded.bIncompleteConversion = (flags & incompleteConversionFlag) != 0;
+        input.decoded.bHasEOLTermination = (flags & eolTerminationFlag) != 0;
+
+        input.decoded.lines = std::make_shared<LineDataVector>();
+        LineDataVector& lines = *input.decoded.lines;
+        lines.setBuffer(text);
+        lines.reserve(lineCount);
+        for(quint32 j = 0; j < lineCount; ++j)
+        {
+            const uchar* pRecord = pLines + j * lineRecordSize;
+            const quint32 offset = readU32(pRecord);
+            const quint32 lineSize = readU32(pRecord + 4);
+            const quint32 firstNonWhite = readU32(pRecord + 8);
+            const quint32 lineFlags = readU32(pRecord + 12);
+            if((qint64)offset + lineSize > text->size() || firstNonWhite > lineSize)
+                return corrupt();
+            lines.push_back(LineData(text, offset, lineSize, firstNonWhite, (lineFlags & skipableFlag) != 0, (lineFlags & pureCommentFlag) != 0));
+        }
+        mInputs.push_back(input);
+    }
+
+    // Without C there is only the pair of A and B.
+    const int pairs = inputCount == 3 ? pairCount : 1;
+    const std::pair<size_t, size_t> sides[pairCount] = {{0, 1}, {0, 2}, {1, 2}};
+    for(int pair = 0; pair < pairs; ++pair)
+    {
+        if((pairMask & (1 << pair)) == 0)
+            continue;
+
+        quint32 count = 0;
+        const uchar* pDiffs = nullptr;
+        if(!reader.u32(count) || (pDiffs = reader.records(count, diffRecordSize)) == nullptr)
+            return corrupt();
+
+        // The line matching has to cover both inputs exactly.
+        qint64 lines1 = 0, lines2 = 0;
+        DiffList& diffList = mLineMatching[pair];
+        for(quint32 j = 0; j < count; ++j)
+        {
+            const quint32 equals = readU32(pDiffs + j * diffRecordSize);
+            const quint32 diff1 = readU32(pDiffs + j * diffRecordSize + 4);
+            const quint32 diff2 = readU32(pDiffs + j * diffRecordSize + 8);
+            if(equals > (quint32)limits<LineType>::max())
+                return corrupt();
+            lines1 += (qint64)equals + diff1;
+            lines2 += (qint64)equals + diff2;
+            diffList.push_back(Diff((LineType)equals, diff1, diff2));
+        }
+        if(lines1 != (qint64)mInputs[sides[pair].first].decoded.lines->size() - 1 ||
+           lines2 != (qint64)mInputs[sides[pair].second].decoded.lines->size() - 1)
+            return corrupt();
+        mbHasLineMatching[pair] = true;
+    }
+
+    return true;
+}
+
+bool SessionSnapshot::save(const QString& fileName)
+{
+    mErrorString.clear();
+    assert(mInputs.size() == 2 || mInputs.size() == 3);
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || !write(file) || !file.commit())
+    {
+        mErrorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool SessionSnapshot::write(QIODevice& device) const
+{
+    Writer writer(device);
+    writer.u32(fileMagic);
+    writer.u32(fileVersion);
+    writer.u32((quint32)mInputs.size());
+    writer.u32((mSettings.bTryHard ? tryHardFlag : 0) | (mSettings.bIgnoreNumbers ? ignoreNumbersFlag : 0));
+    writer.u32((quint32)mSettings.lineDiffAlgorithm);
+
+    quint32 pairMask = 0;
+    for(int pair = 0; pair < pairCount; ++pair)
+    {
+        if(mbHasLineMatching[pair] && (pair == AB || mInputs.size() == 3))
+            pairMask |= 1 << pair;
+    }
+    writer.u32(pairMask);
+
+    for(const Input& input: mInputs)
+    {
+        const LineDataVector& lines = *input.decoded.lines;
+        writer.string(input.fileName);
+        writer.string(input.aliasName);
+        writer.string(QString::fromLatin1(input.encodingName));
+        writer.i64(input.size);
+        writer.i64(input.lastModified.toMSecsSinceEpoch());
+        writer.u32((input.decoded.bIncompleteConversion ? incompleteConversionFlag : 0) | (input.decoded.bHasEOLTermination ? eolTerminationFlag : 0));
+        writer.u32((quint32)input.decoded.eLineEndStyle);
+        writer.u32((quint32)lines.size());
+        for(const LineData& line: lines)
+        {
+            writer.u32((quint32)line.getOffset());
+            writer.u32((quint32)line.size());
+            writer.u32((quint32)line.getFirstNonWhiteChar());
+            writer.u32((line.isSkipable() ? skipableFlag : 0) | (line.isPureComment() ? pureCommentFlag : 0));
+        }
+        writer.string(*lines.buffer());
+    }
+
+    for(int pair = 0; pair < pairCount; ++pair)
+    {
+        if((pairMask & (1 << pair)) == 0)
+            continue;
+
+        writer.u32((quint32)mLineMatching[pair].size());
+        for(const Diff& diff: mLineMatching[pair])
+        {
+            writer.u32((quint32)diff.numberOfEquals());
+            writer.u32((quint32)diff.diff1());
+            writer.u32((quint32)diff.diff2());
+        }
+    }
+
+    return writer.flush();
+}
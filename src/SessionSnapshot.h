@@ -0,0 +1,89 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef SESSIONSNAPSHOT_H
+#define SESSIONSNAPSHOT_H
+
+#include "diff.h"
+#include "SourceData.h"
+
+#include <vector>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+class QIODevice;
+
+/*
+    Binary file of a comparison: the decoded text and line table of every input and the line
+    matching of the pairs. Reopening it neither decodes the inputs nor runs the diff, as long as
+    the files didn't change on disk since, which the recorded size and time tell.
+
+    After a header the inputs follow, each with its names, its line table of 16 bytes a line and
+    its text in UTF-16, then a DiffList for every pair that was saved. All numbers are little
+    endian and aligned to four bytes, loading maps the file.
+*/
+class SessionSnapshot
+{
+  public:
+    enum Pair
+    {
+        AB = 0,
+        AC = 1,
+        BC = 2,
+        pairCount = 3
+    };
+
+    struct Input
+    {
+        QString fileName;
+        QString aliasName;
+        QByteArray encodingName;
+        QDateTime lastModified;
+        qint64 size = 0;
+        SourceData::DecodedText decoded;
+    };
+
+    // The options the line matching was calculated with.
+    struct Settings
+    {
+        int lineDiffAlgorithm = 0;
+        bool bTryHard = false;
+        bool bIgnoreNumbers = false;
+    };
+
+    void clear();
+    bool load(const QString& fileName);
+    bool save(const QString& fileName);
+
+    [[nodiscard]] QString errorString() const { return mErrorString; }
+
+    void addInput(const Input& input) { mInputs.push_back(input); }
+    [[nodiscard]] const std::vector<Input>& inputs() const { return mInputs; }
+
+    void setSettings(const Settings& settings) { mSettings = settings; }
+    [[nodiscard]] const Settings& settings() const { return mSettings; }
+
+    void setLineMatching(const Pair pair, const DiffList& diffList);
+    // nullptr if the pair wasn't saved.
+    [[nodiscard]] const DiffList* lineMatching(const Pair pair) const { return mbHasLineMatching[pair] ? &mLineMatching[pair] : nullptr; }
+
+  private:
+    bool parse(const uchar* pData, const qint64 size);
+    bool write(QIODevice& device) const;
+
+    QString mErrorString;
+    std::vector<Input> mInputs;
+    Settings mSettings;
+    DiffList mLineMatching[pairCount];
+    bool mbHasLineMatching[pairCount] = {false, false, false};
+};
+
+#endif
@@ -20,6 +20,7 @@ Order of operation:
  1. If data was given via a string then save it to a temp file. (see setData())
  2. If the specified file is nonlocal (URL) copy it to a temp file. (TODO revisit this)
  3. If a preprocessor was specified, run the input file through it.
+    Simple sed and sort commands are run in process instead (see Preprocessor.h), also in step 7.
  4. Read the output of the preprocessor.
  5. If Uppercase was specified: Turn the read data to uppercase.
  6. Write the result to a temp file.
@@ -33,10 +34,13 @@ Optimizations: Skip unneeded steps.
 #include "SourceData.h"
 
 #include "CommentParser.h"
+#include "CompressedInput.h"
 #include "compat.h"
 #include "diff.h"
 #include "LineRef.h"
 #include "Logging.h"
+#include "Preprocessor.h"
+#include "Trace.h"
 #include "Utils.h"
 
 #include <algorithm>         // for min
@@ -51,7 +55,51 @@ Optimizations: Skip unneeded steps.
 #include <QTemporaryFile>
 #include <QTextCodec>
 #include <QTextStream>
-#include <QVector>
+
+namespace {
+// Bytes at the start of the data the encoding is guessed from. A UTF-8 guess is confirmed by the decode.
+constexpr qint64 encodingSampleSize = 64 * 1024;
+
+// 64-bit FNV-1a over UTF-16 code units, fed while the loaded data is walked once.
+class ContentHash
+{
+  public:
+    inline void add(const QChar c) { mHash = (mHash ^ c.unicode()) * 0x100000001B3ULL; }
+    inline void add(const quint32 v) { mHash = (mHash ^ v) * 0x100000001B3ULL; }
+    [[nodiscard]] inline quint64 value() const { return mHash; }
+
+  private:
+    quint64 mHash = 0xCBF29CE484222325ULL;
+};
+
+// Text split into buffers, possibly in different places for both.
+bool sameText(const std::vector<QSharedPointer<QString>>& buffers1, const std::vector<QSharedPointer<QString>>& buffers2)
+{
+    std::vector<QSharedPointer<QString>>::const_iterator it1 = buffers1.cbegin(), it2 = buffers2.cbegin();
+    QtSizeType pos1 = 0, pos2 = 0;
+    for(;;)
+    {
+        while(it1 != buffers1.cend() && (*it1 == nullptr || pos1 == (*it1)->size()))
+        {
+            ++it1;
+            pos1 = 0;
+        }
+        while(it2 != buffers2.cend() && (*it2 == nullptr || pos2 == (*it2)->size()))
+        {
+            ++it2;
+            pos2 = 0;
+        }
+        if(it1 == buffers1.cend() || it2 == buffers2.cend())
+            return it1 == buffers1.cend() && it2 == buffers2.cend();
+
+        const QtSizeType length = std::min((*it1)->size() - pos1, (*it2)->size() - pos2);
+        if(memcmp((*it1)->constData() + pos1, (*it2)->constData() + pos2, length * sizeof(QChar)) != 0)
+            return false;
+        pos1 += length;
+        pos2 += length;
+    }
+}
+} // namespace
 
 void SourceData::reset()
 {
@@ -60,6 +108,14 @@ void SourceData::reset()
     m_fileAccess = FileAccess();
     m_normalData.reset();
     m_lmppData.reset();
+    mTextHash = 0;
+    mLineMatchHash = 0;
+    mTooLarge = false;
+    mPartial = false;
+    mDecodedEncoding = nullptr;
+    mReadStamp = ReadStamp();
+    mCompressedText.clear();
+    ++mGeneration;
     if(!m_tempInputFileName.isEmpty())
     {
         m_tempFile.remove();
@@ -88,7 +144,7 @@ bool SourceData::isEmpty() const
 
 bool SourceData::hasData() const
 {
-    return m_normalData.m_pBuf != nullptr;
+    return m_normalData.data() != nullptr;
 }
 
 bool SourceData::isValid() const
@@ -122,6 +178,7 @@ void SourceData::setFileAccess(const FileAccess& fileAccess)
 
     m_fileAccess = fileAccess;
     m_aliasName = QString();
+    mReadStamp = ReadStamp();
     if(!m_tempInputFileName.isEmpty())
     {
         m_tempFile.remove();
@@ -138,6 +195,7 @@ void SourceData::setEncoding(QTextCodec* pEncoding)
 void SourceData::setData(const QString& data)
 {
     mErrors.clear();
+    mReadStamp = ReadStamp();
     // Create a temp file for preprocessing:
     if(m_tempInputFileName.isEmpty())
     {
@@ -161,7 +219,8 @@ void SourceData::setData(const QString& data)
 
 const std::shared_ptr<LineDataVector>& SourceData::getLineDataForDiff() const
 {
-    if(m_lmppData.m_pBuf == nullptr)
+    // m_lmppData is only filled if it differs from m_normalData.
+    if(m_lmppData.m_v->empty())
     {
         return m_normalData.m_v;
     }
@@ -188,12 +247,12 @@ qint64 SourceData::getSizeBytes() const
 
 const char* SourceData::getBuf() const
 {
-    return m_normalData.m_pBuf.get();
+    return m_normalData.data();
 }
 
-const QString& SourceData::getText() const
+const std::vector<QSharedPointer<QString>>& SourceData::getTextBuffers() const
 {
-    return *m_normalData.m_unicodeBuf;
+    return m_normalData.m_v->buffers();
 }
 
 bool SourceData::isText() const
@@ -218,6 +277,57 @@ bool SourceData::isBinaryEqualWith(const QSharedPointer<SourceData>& other) cons
            (getSizeBytes() == 0 || memcmp(getBuf(), other->getBuf(), getSizeBytes()) == 0);
 }
 
+// The hashes only rule out inequality quickly, equal hashes are confirmed before returning true.
+bool SourceData::isTextEqualWith(const QSharedPointer<SourceData>& other) const
+{
+    return hasData() && other->hasData() && isText() && other->isText() &&
+           mTextHash == other->mTextHash && sameText(getTextBuffers(), other->getTextBuffers());
+}
+
+bool SourceData::isLineMatchEqualWith(const QSharedPointer<SourceData>& other) const
+{
+    if(!hasData() || !other->hasData() || !isText() || !other->isText() ||
+       mLineMatchHash != other->mLineMatchHash || getSizeLines() != other->getSizeLines())
+        return false;
+
+    const LineDataVector& v1 = *getLineDataForDiff();
+    const LineDataVector& v2 = *other->getLineDataForDiff();
+    const bool bIgnoreNumbers = m_pOptions->m_bIgnoreNumbers;
+    for(LineType i = 0; i < getSizeLines(); ++i)
+    {
+        if(!LineData::lineMatchEqual(v1[i], v2[i], bIgnoreNumbers))
+            return false;
+    }
+    return true;
+}
+
+void SourceData::calcContentHashes()
+{
+    TraceScope traceScope(TraceStage::hash);
+    ContentHash textHash;
+    for(const QSharedPointer<QString>& pBuffer: getTextBuffers())
+    {
+        if(pBuffer == nullptr)
+            continue;
+        for(const QChar c: *pBuffer)
+            textHash.add(c);
+    }
+    mTextHash = textHash.value();
+
+    ContentHash lineMatchHash;
+    LineDataVector& v = *getLineDataForDiff();
+    const bool bIgnoreNumbers = m_pOptions->m_bIgnoreNumbers;
+    for(LineType i = 0; i < getSizeLines() && (size_t)i < v.size(); ++i)
+    {
+        // Lines get their fingerprints while they are split, line matching would compute them anyway.
+        LineData& lineData = v[i];
+        if(!lineData.hasFingerprints())
+            lineData.calcFingerprints();
+        lineMatchHash.add(lineData.lineMatchFingerprint(bIgnoreNumbers));
+    }
+    mLineMatchHash = lineMatchHash.value();
+}
+
 /*
     Warning: Do not call this function without re-running the comparison or
     otherwise resetting the DiffTextWindows as these store a pointer to the file
@@ -225,15 +335,60 @@ bool SourceData::isBinaryEqualWith(const QSharedPointer<SourceData>& other) cons
 */
 void SourceData::FileData::reset()
 {
+    m_pData = nullptr;
     m_pBuf.reset();
+    mMappedFile.reset(); // Also unmaps the file.
     m_v->clear();
     mDataSize = 0;
     mLineCount = 0;
     m_bIsText = false;
     m_bIncompleteConversion = false;
+    mbInvalidInput = false;
     m_eLineEndStyle = eLineEndStyleUndefined;
 }
 
+/*
+    Maps a local file instead of copying it into m_pBuf. The decoded text is what all later
+    processing uses, so the raw bytes are only touched by preprocess() and isBinaryEqualWith().
+*/
+bool SourceData::FileData::mapFile(const QString& fileName)
+{
+#ifdef Q_OS_WIN
+    // A mapped file can't be overwritten on Windows. That would break saving the merge result over an input.
+    Q_UNUSED(fileName);
+    return false;
+#else
+    // Small files are cheaper to copy than to map.
+    constexpr quint64 minMapSize = 1024 * 1024;
+    if(mDataSize < minMapSize)
+        return false;
+
+    std::unique_ptr<QFile> pFile = std::make_unique<QFile>(fileName);
+    if(!pFile->open(QIODevice::ReadOnly))
+        return false;
+
+    const uchar* pMapped = pFile->map(0, mDataSize);
+    if(pMapped == nullptr)
+        return false;
+
+    mMappedFile = std::move(pFile);
+    m_pData = reinterpret_cast<const char*>(pMapped);
+    return true;
+#endif
+}
+
+// Copy mapped data into our own buffer so the underlying file can be changed safely.
+void SourceData::FileData::detachFromMapping()
+{
+    if(!isMapped())
+        return;
+
+    m_pBuf = std::make_unique<char[]>(mDataSize + 100);
+    memcpy(m_pBuf.get(), m_pData, mDataSize);
+    m_pData = m_pBuf.get();
+    mMappedFile.reset();
+}
+
 bool SourceData::FileData::readFile(FileAccess& file)
 {
     reset();
@@ -245,7 +400,12 @@ bool SourceData::FileData::readFile(FileAccess& file)
     if(!file.isNormal())
         return true;
 
+    TraceScope traceScope(TraceStage::read);
     mDataSize = file.sizeForReading();
+    traceScope.setItems(mDataSize);
+    if(file.isLocal() && mapFile(file.absoluteFilePath()))
+        return true;
+
     m_pBuf = std::make_unique<char[]>(mDataSize + 100); // Alloc 100 byte extra: Safety hack, not nice but does no harm.
                                                         // Some extra bytes at the end of the buffer are needed by
                                                         // the diff algorithm. See also GnuDiff::diff_2_files().
@@ -257,6 +417,7 @@ bool SourceData::FileData::readFile(FileAccess& file)
     }
     else
     {
+        m_pData = m_pBuf.get();
         //null terminate buffer
         m_pBuf[mDataSize + 1] = 0;
         m_pBuf[mDataSize + 2] = 0;
@@ -279,7 +440,12 @@ bool SourceData::FileData::readFile(const QString& filename)
     if(!fa.isNormal())
         return true;
 
+    TraceScope traceScope(TraceStage::read);
     mDataSize = fa.sizeForReading();
+    traceScope.setItems(mDataSize);
+    if(fa.isLocal() && mapFile(fa.absoluteFilePath()))
+        return true;
+
     m_pBuf = std::make_unique<char[]>(mDataSize + 100); // Alloc 100 byte extra: Safety hack, not nice but does no harm.
                                                         // Some extra bytes at the end of the buffer are needed by
                                                         // the diff algorithm. See also GnuDiff::diff_2_files().
@@ -289,6 +455,8 @@ bool SourceData::FileData::readFile(const QString& filename)
         m_pBuf = nullptr;
         mDataSize = 0;
     }
+    else
+        m_pData = m_pBuf.get();
     return bSuccess;
 }
 
@@ -304,19 +472,116 @@ bool SourceData::FileData::writeFile(const QString& filename)
         return true;
     }
 
+    // The target may be the very file that is mapped. Writing it truncates the file first.
+    detachFromMapping();
+
     FileAccess fa(filename);
-    bool bSuccess = fa.writeFile(m_pBuf.get(), mDataSize);
+    bool bSuccess = fa.writeFile(m_pData, mDataSize);
     return bSuccess;
 }
 
-//Deprecated
-void SourceData::FileData::copyBufFrom(const FileData& src) //TODO: Remove me.
+void SourceData::FileData::setData(const QByteArray& data)
+{
+    reset();
+    mDataSize = data.size();
+    m_pBuf = std::make_unique<char[]>(mDataSize + 100); // Extra bytes as in readFile()
+    memcpy(m_pBuf.get(), data.constData(), mDataSize);
+    m_pData = m_pBuf.get();
+}
+
+bool SourceData::FileData::decompress(const QString& fileName, bool& bDecompressed, QString& errorString)
+{
+    bDecompressed = false;
+    const KCompressionDevice::CompressionType type = CompressedInput::type(fileName, m_pData, mDataSize);
+    if(type == KCompressionDevice::None)
+        return true;
+
+    QByteArray content;
+    if(!CompressedInput::decompress(m_pData, mDataSize, type, content, errorString))
+        return false;
+
+    // setData() releases the buffer or mapping the compressed data is in.
+    setData(content);
+    bDecompressed = true;
+    return true;
+}
+
+// Replaces the data by the output of preprocessor, which is encoded as UTF-8.
+bool SourceData::FileData::runPreprocessor(Preprocessor& preprocessor, QTextCodec* pEncoding)
+{
+    TraceScope traceScope(TraceStage::preprocess);
+    if(mDataSize > limits<QtNumberType>::max())
+        return false;
+
+    const QString text = pEncoding->toUnicode(m_pData, (QtNumberType)mDataSize);
+    setData(preprocessor.run(text).toUtf8());
+    return true;
+}
+
+/*
+    Builds the comment free text used for line matching from already decoded data.
+    Nothing is stored unless blanking out comments changed at least one line. Comments
+    are replaced by spaces so offsets, sizes and flags stay those of src.
+*/
+void SourceData::FileData::removeCommentsFrom(const FileData& src)
 {
     reset();
+    m_unicodeBuf->clear();
+
+    QScopedPointer<CommentParser> parser(new DefaultCommentParser());
+    const LineDataVector& srcLines = *src.m_v;
+    const std::vector<QSharedPointer<QString>>& srcBuffers = srcLines.buffers();
+    std::vector<QSharedPointer<QString>> buffers; // Copies of srcBuffers, made when the first line changes.
+    size_t bufferIndex = 0;
+    // Consecutive lines are mostly in the same buffer.
+    const auto findBuffer = [&srcBuffers, &bufferIndex](const LineData& line) {
+        if(srcBuffers[bufferIndex].data() != line.getBuffer())
+            bufferIndex = std::find_if(srcBuffers.cbegin(), srcBuffers.cend(), [&line](const QSharedPointer<QString>& pBuffer) { return pBuffer.data() == line.getBuffer(); }) - srcBuffers.cbegin();
+        assert(bufferIndex < srcBuffers.size());
+        return bufferIndex;
+    };
+
+    for(qint64 i = 0; i < src.lineCount(); ++i)
+    {
+        const LineData& srcLine = srcLines[i];
+        QString line = srcLine.getLine();
+        const QChar* pRaw = line.constData();
+
+        parser->processLine(line);
+        parser->removeComment(line);
+        // line only detaches from the source buffer if something was replaced.
+        if(line.constData() == pRaw)
+            continue;
+
+        if(buffers.empty())
+        {
+            // Deep copies, sharing would make every getLine() on src detach its buffer.
+            for(const QSharedPointer<QString>& pSrcBuffer: srcBuffers)
+            {
+                buffers.push_back(buffers.empty() ? m_unicodeBuf : QSharedPointer<QString>::create());
+                *buffers.back() = QString(pSrcBuffer->constData(), pSrcBuffer->size());
+            }
+        }
+        buffers[findBuffer(srcLine)]->replace(srcLine.getOffset(), srcLine.size(), line);
+    }
+
+    if(buffers.empty())
+        return;
+
+    m_v->setBuffer(buffers.front());
+    for(size_t i = 1; i < buffers.size(); ++i)
+        m_v->addBuffer(buffers[i]);
+    m_v->reserve(srcLines.size());
+    for(const LineData& srcLine: srcLines)
+        m_v->push_back(LineData(buffers[findBuffer(srcLine)], srcLine.getOffset(), srcLine.size(), srcLine.getFirstNonWhiteChar(), srcLine.isSkipable(), srcLine.isPureComment()));
+    m_v->calcFingerprints();
+
     mDataSize = src.mDataSize;
-    m_pBuf = std::make_unique<char[]>(mDataSize + 100);
-    assert(src.m_pBuf != nullptr);
-    memcpy(m_pBuf.get(), src.m_pBuf.get(), mDataSize);
+    mLineCount = src.mLineCount;
+    m_bIsText = src.m_bIsText;
+    m_bIncompleteConversion = src.m_bIncompleteConversion;
+    m_eLineEndStyle = src.m_eLineEndStyle;
+    mHasEOLTermination = src.mHasEOLTermination;
 }
 
 QTextCodec* SourceData::detectEncoding(const QString& fileName, QTextCodec* pFallbackCodec)
@@ -336,6 +601,296 @@ QTextCodec* SourceData::detectEncoding(const QString& fileName, QTextCodec* pFal
 }
 
 void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicode)
+{
+    mTextHash = 0;
+    mLineMatchHash = 0;
+    mTooLarge = false;
+    mPartial = false;
+    ++mGeneration;
+
+    // Taken first, a file that changes while it is read won't match it later.
+    const ReadStamp stamp = currentReadStamp(*m_pOptions, pEncoding, bAutoDetectUnicode);
+    mReadStamp = ReadStamp();
+
+    readAndPreprocessData(pEncoding, bAutoDetectUnicode);
+    mDecodedEncoding = m_pEncoding;
+
+    if(hasData() && isText())
+        calcContentHashes();
+
+    if(mErrors.isEmpty())
+        mReadStamp = stamp;
+}
+
+void SourceData::readAndPreprocessHead(QTextCodec* pEncoding, bool bAutoDetectUnicode, qint64 maxBytes)
+{
+    mReadLimit = maxBytes;
+    readAndPreprocess(pEncoding, bAutoDetectUnicode);
+    mReadLimit = 0;
+
+    // The head must not pass for the complete file.
+    if(mPartial)
+        mReadStamp = ReadStamp();
+}
+
+/*
+    The bytes that were read stay in memory, so trying another encoding only needs decoding and
+    the line matching data built again. Inputs that went through a preprocessor command, were read
+    only in part or changed on disk since are read again instead. Nothing changes for the encoding
+    the text already has, so the line matching of its pairs is kept, see generation().
+*/
+bool SourceData::redecode(QTextCodec* pEncoding)
+{
+    if(pEncoding == nullptr || !hasData() || mPartial || mTooLarge || m_normalData.data() == nullptr)
+        return false;
+
+    if(!m_pOptions->m_PreProcessorCmd.isEmpty() || !m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
+        return false;
+    // The raw bytes would be the compressed ones.
+    if(m_pOptions->m_bDecompressInputs && CompressedInput::typeForName(m_fileAccess.fileName()) != KCompressionDevice::None)
+        return false;
+
+    // A mapped file shows what is on disk now, the other options must also be the ones it was read with.
+    if(mReadStamp.bValid && !(currentReadStamp(*m_pOptions, mReadStamp.pEncoding, mReadStamp.bAutoDetectUnicode) == mReadStamp))
+        return false;
+
+    if(pEncoding == mDecodedEncoding)
+        return true;
+
+    mErrors.clear();
+    mTextHash = 0;
+    mLineMatchHash = 0;
+    ++mGeneration;
+    m_pEncoding = pEncoding;
+
+    m_lmppData.reset();
+    m_normalData.m_v->clear();
+    if(!m_normalData.preprocess(pEncoding, false))
+        return false;
+
+    if(m_normalData.isText() && (m_pOptions->ignoreComments() || m_pOptions->m_bIgnoreCase))
+    {
+        TraceScope traceScope(TraceStage::preprocess);
+        m_lmppData.removeCommentsFrom(m_normalData);
+    }
+    mDecodedEncoding = pEncoding;
+
+    if(isText())
+        calcContentHashes();
+
+    // Same as reading again with this encoding would give.
+    if(mReadStamp.bValid)
+    {
+        mReadStamp.pEncoding = pEncoding;
+        mReadStamp.bAutoDetectUnicode = false;
+    }
+    return true;
+}
+
+void SourceData::takeLoadedData(SourceData& other)
+{
+    m_pEncoding = other.m_pEncoding;
+    m_normalData = std::move(other.m_normalData);
+    m_lmppData = std::move(other.m_lmppData);
+    mErrors.append(other.mErrors);
+    mTextHash = other.mTextHash;
+    mLineMatchHash = other.mLineMatchHash;
+    mTooLarge = other.mTooLarge;
+    mPartial = other.mPartial;
+    mDecodedEncoding = other.mDecodedEncoding;
+    mReadStamp = other.mReadStamp;
+    ++mGeneration;
+}
+
+void SourceData::compressText()
+{
+    // Characters per piece, qCompress takes at most 2^31 bytes at a time.
+    constexpr QtSizeType pieceLength = 1024 * 1024;
+
+    for(const FileData* pFileData: {&m_normalData, &m_lmppData})
+    {
+        if(pFileData->m_v.use_count() != 1)
+            continue;
+
+        for(const QSharedPointer<QString>& pBuffer: pFileData->m_v->buffers())
+        {
+            const bool bKnown = std::any_of(mCompressedText.cbegin(), mCompressedText.cend(), [&pBuffer](const CompressedBuffer& b) { return b.pBuffer == pBuffer; });
+            if(pBuffer == nullptr || pBuffer->isEmpty() || bKnown)
+                continue;
+
+            CompressedBuffer compressed;
+            compressed.pBuffer = pBuffer;
+            compressed.length = pBuffer->length();
+            for(QtSizeType offset = 0; offset < compressed.length; offset += pieceLength)
+            {
+                const QtSizeType length = std::min(pieceLength, compressed.length - offset);
+                // Fast rather than small, UTF-16 text compresses well anyway.
+                compressed.pieces.push_back(qCompress((const uchar*)(pBuffer->constData() + offset), length * (QtSizeType)sizeof(QChar), 1));
+            }
+            *pBuffer = QString();
+            mCompressedText.push_back(std::move(compressed));
+        }
+    }
+}
+
+bool SourceData::decompressText()
+{
+    bool bSuccess = true;
+    for(CompressedBuffer& compressed: mCompressedText)
+    {
+        QString& text = *compressed.pBuffer;
+        text.resize(compressed.length);
+        QtSizeType offset = 0;
+        for(const QByteArray& piece: compressed.pieces)
+        {
+            const QByteArray raw = qUncompress(piece);
+            const QtSizeType length = raw.size() / (QtSizeType)sizeof(QChar);
+            if(raw.isEmpty() || offset + length > compressed.length)
+            {
+                bSuccess = false;
+                break;
+            }
+            memcpy((void*)(text.data() + offset), raw.constData(), length * sizeof(QChar));
+            offset += length;
+        }
+        bSuccess = bSuccess && offset == compressed.length;
+    }
+    mCompressedText.clear();
+    return bSuccess;
+}
+
+SourceData::DecodedText SourceData::decodedText() const
+{
+    DecodedText decoded;
+    decoded.lines = m_normalData.m_v;
+    decoded.eLineEndStyle = m_normalData.m_eLineEndStyle;
+    decoded.bIncompleteConversion = m_normalData.m_bIncompleteConversion;
+    decoded.bHasEOLTermination = m_normalData.mHasEOLTermination;
+    return decoded;
+}
+
+bool SourceData::getReadStamp(QDateTime& lastModified, qint64& size) const
+{
+    if(!mReadStamp.bValid)
+        return false;
+
+    lastModified = mReadStamp.lastModified;
+    size = mReadStamp.size;
+    return true;
+}
+
+/*
+    Decoding and splitting into lines is most of the work of reading a large text, restoring
+    skips both. The raw bytes are still needed for binary comparison, for a large local file they
+    only get mapped. The line matching data is built from the text as redecode() does.
+*/
+bool SourceData::restoreDecodedText(QTextCodec* pEncoding, const QDateTime& lastModified, const qint64 size, const DecodedText& decoded)
+{
+    if(pEncoding == nullptr || decoded.lines == nullptr || decoded.lines->empty() || decoded.lines->buffer() == nullptr)
+        return false;
+
+    if(!m_pOptions->m_PreProcessorCmd.isEmpty() || !m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
+        return false;
+
+    const ReadStamp stamp = currentReadStamp(*m_pOptions, pEncoding, false);
+    if(!stamp.bValid || stamp.lastModified != lastModified || stamp.size != size)
+        return false;
+
+    mErrors.clear();
+    mTextHash = 0;
+    mLineMatchHash = 0;
+    mTooLarge = false;
+    mPartial = false;
+    ++mGeneration;
+    m_pEncoding = pEncoding;
+
+    m_lmppData.reset();
+    if(!m_normalData.readFile(m_fileAccess) || m_normalData.byteCount() != (quint64)size)
+    {
+        m_normalData.reset();
+        return false;
+    }
+
+    // Copied into the vector in place, the diff windows hold on to it.
+    m_normalData.m_unicodeBuf = decoded.lines->buffer();
+    *m_normalData.m_v = *decoded.lines;
+    m_normalData.m_v->calcFingerprints();
+    m_normalData.mLineCount = (qint64)decoded.lines->size() - 1;
+    m_normalData.m_bIsText = true;
+    m_normalData.m_bIncompleteConversion = decoded.bIncompleteConversion;
+    m_normalData.m_eLineEndStyle = decoded.eLineEndStyle;
+    m_normalData.mHasEOLTermination = decoded.bHasEOLTermination;
+
+    if(m_pOptions->ignoreComments() || m_pOptions->m_bIgnoreCase)
+    {
+        TraceScope traceScope(TraceStage::preprocess);
+        m_lmppData.removeCommentsFrom(m_normalData);
+    }
+    mDecodedEncoding = pEncoding;
+
+    calcContentHashes();
+    mReadStamp = stamp;
+    return true;
+}
+
+bool SourceData::ReadStamp::operator==(const ReadStamp& other) const
+{
+    return bValid == other.bValid && lastModified == other.lastModified && size == other.size &&
+           pEncoding == other.pEncoding && bAutoDetectUnicode == other.bAutoDetectUnicode &&
+           preProcessorCmd == other.preProcessorCmd && lineMatchingPreProcessorCmd == other.lineMatchingPreProcessorCmd &&
+           pEncodingPP == other.pEncodingPP && bIgnoreComments == other.bIgnoreComments &&
+           bIgnoreCase == other.bIgnoreCase && bIgnoreNumbers == other.bIgnoreNumbers &&
+           bDecompressInputs == other.bDecompressInputs;
+}
+
+// Only local files get a valid stamp, anything else can't be checked cheaply.
+SourceData::ReadStamp SourceData::currentReadStamp(const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode) const
+{
+    ReadStamp stamp;
+    if(mFromClipBoard || !m_fileAccess.isValid() || !m_fileAccess.isLocal())
+        return stamp;
+
+    const FileAccess fileAccess(m_fileAccess.absoluteFilePath());
+    if(!fileAccess.isNormal())
+        return stamp;
+
+    stamp.bValid = true;
+    stamp.lastModified = fileAccess.lastModified();
+    stamp.size = fileAccess.size();
+    stamp.pEncoding = pEncoding;
+    stamp.bAutoDetectUnicode = bAutoDetectUnicode;
+    stamp.preProcessorCmd = options.m_PreProcessorCmd;
+    stamp.lineMatchingPreProcessorCmd = options.m_LineMatchingPreProcessorCmd;
+    stamp.pEncodingPP = options.m_pEncodingPP;
+    stamp.bIgnoreComments = options.ignoreComments();
+    stamp.bIgnoreCase = options.m_bIgnoreCase;
+    stamp.bIgnoreNumbers = options.m_bIgnoreNumbers;
+    stamp.bDecompressInputs = options.m_bDecompressInputs;
+    return stamp;
+}
+
+bool SourceData::isUpToDate(const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode) const
+{
+    return mReadStamp.bValid && hasData() && currentReadStamp(options, pEncoding, bAutoDetectUnicode) == mReadStamp;
+}
+
+bool SourceData::decompressInput(bool& bDecompressed)
+{
+    bDecompressed = false;
+    if(!m_pOptions->m_bDecompressInputs || mFromClipBoard)
+        return true;
+
+    // Remote files and their local copies are known by the original name.
+    QString errorString;
+    if(!m_normalData.decompress(m_fileAccess.fileName(), bDecompressed, errorString))
+    {
+        mErrors.append(i18n("Decompressing %1 failed: %2", m_fileAccess.prettyAbsPath(), errorString));
+        return false;
+    }
+    return true;
+}
+
+void SourceData::readAndPreprocessData(QTextCodec* pEncoding, bool bAutoDetectUnicode)
 {
     m_pEncoding = pEncoding;
     QTemporaryFile fileIn1, fileOut1;
@@ -343,6 +898,8 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
     QString fileNameOut1;
     QString fileNameIn2;
     QString fileNameOut2;
+    // Without preprocessors a remote file is read straight into memory, only they need a local file.
+    bool bReadRemote = false;
 
     // Detect the input for the preprocessing operations
     if(!mFromClipBoard)
@@ -361,6 +918,11 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
         {
             fileNameIn1 = m_fileAccess.absoluteFilePath();
         }
+        else if(m_tempInputFileName.isEmpty() && m_pOptions->m_PreProcessorCmd.isEmpty() && m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
+        {
+            fileNameIn1 = m_fileAccess.prettyAbsPath();
+            bReadRemote = true;
+        }
         else // File is not local: create a temporary local copy:
         {
             if(m_tempInputFileName.isEmpty())
@@ -371,7 +933,8 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
 
             fileNameIn1 = m_tempInputFileName;
         }
-        if(bAutoDetectUnicode)
+        // Without a preprocessor command the encoding is taken from the data once it is read.
+        if(bAutoDetectUnicode && !bReadRemote && !m_pOptions->m_PreProcessorCmd.isEmpty())
         {
             m_pEncoding = detectEncoding(fileNameIn1, pEncoding);
         }
@@ -393,11 +956,15 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
     m_normalData.reset();
     m_lmppData.reset();
 
-    FileAccess faIn(fileNameIn1);
+    // Set if the encoding is UTF-8 only because the start of the data is valid UTF-8.
+    bool bGuessedUTF8 = false;
+
+    FileAccess faIn = bReadRemote ? m_fileAccess : FileAccess(fileNameIn1);
     qint64 fileInSize = faIn.size();
 
     if(faIn.exists() && !faIn.isBrokenLink())
     {
+        const std::unique_ptr<Preprocessor> pPreprocessor = Preprocessor::fromCommand(m_pOptions->m_PreProcessorCmd);
         // Run the first preprocessor
         if(m_pOptions->m_PreProcessorCmd.isEmpty())
         {
@@ -407,6 +974,54 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
                 mErrors.append(faIn.getStatusText());
                 return;
             }
+
+            bool bDecompressed = false;
+            if(!decompressInput(bDecompressed))
+                return;
+
+            if(bAutoDetectUnicode)
+            {
+                // Only a sample, the decode below is the one pass over all of the data.
+                FileOffset skipBytes = 0;
+                QTextCodec* pCodec = detectEncoding(m_normalData.data(), std::min<qint64>(m_normalData.byteCount(), encodingSampleSize), skipBytes);
+                if(pCodec != nullptr)
+                    m_pEncoding = pCodec;
+                bGuessedUTF8 = pCodec != nullptr && skipBytes == 0 && pCodec->mibEnum() == 106;
+                pEncoding1 = pEncoding2 = m_pEncoding;
+            }
+
+            // Cut after a line end. In UTF-16 and UTF-32 a '\n' byte may be part of another character, those are read completely.
+            const int mib = pEncoding1 != nullptr ? pEncoding1->mibEnum() : 0;
+            const bool bWideEncoding = (mib >= 1013 && mib <= 1015) || (mib >= 1017 && mib <= 1019);
+            if(mReadLimit > 0 && m_normalData.byteCount() > (quint64)mReadLimit && !bWideEncoding)
+            {
+                const char* pData = m_normalData.data();
+                qint64 end = mReadLimit;
+                while(end > 0 && pData[end - 1] != '\n')
+                    --end;
+                if(end > 0)
+                {
+                    // Copied before setData() releases the buffer or mapping it points into.
+                    const QByteArray head(pData, (QtSizeType)end);
+                    m_normalData.setData(head);
+                    mPartial = true;
+                }
+            }
+        }
+        else if(pPreprocessor != nullptr)
+        {
+            if(!m_normalData.readFile(faIn))
+            {
+                mErrors.append(faIn.getStatusText());
+                return;
+            }
+
+            bool bDecompressed = false;
+            if(!decompressInput(bDecompressed))
+                return;
+
+            if(m_normalData.runPreprocessor(*pPreprocessor, pEncoding1))
+                pEncoding1 = QTextCodec::codecForName("UTF-8");
         }
         else
         {
@@ -434,6 +1049,7 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
             QString errorReason = Utils::getArguments(ppCmd, program, args);
             if(errorReason.isEmpty())
             {
+                TraceScope traceScope(TraceStage::preprocess);
                 ppProcess.start(program, args);
                 ppProcess.waitForFinished(-1);
             }
@@ -460,8 +1076,17 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
             }
         }
 
-        if(!m_normalData.preprocess(pEncoding1, false))
+        bool bPreprocessed = m_normalData.preprocess(pEncoding1, false);
+        // Text that isn't UTF-8 after all is read again with the encoding asked for.
+        if(bPreprocessed && bGuessedUTF8 && m_normalData.mbInvalidInput && pEncoding != nullptr && pEncoding != m_pEncoding)
+        {
+            qCInfo(kdiffFileAccess) << "Not UTF-8 past the start, reading again as" << pEncoding->name() << fileNameIn1;
+            m_pEncoding = pEncoding1 = pEncoding2 = pEncoding;
+            bPreprocessed = m_normalData.preprocess(pEncoding1, false);
+        }
+        if(!bPreprocessed)
         {
+            mTooLarge = true;
             mErrors.append(i18n("File %1 too large to process. Skipping.", fileNameIn1));
             return;
         }
@@ -469,10 +1094,31 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
         if(!m_normalData.isText())
             return;
 
+        const std::unique_ptr<Preprocessor> pLineMatchingPreprocessor = Preprocessor::fromCommand(m_pOptions->m_LineMatchingPreProcessorCmd);
         // LineMatching Preprocessor
-        if(!m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
+        if(pLineMatchingPreprocessor != nullptr)
+        {
+            // Works on the decoded output of the first preprocessor, the same text the command would get.
+            if(m_normalData.m_v->buffers().size() > 1)
+            {
+                mTooLarge = true;
+                mErrors.append(i18n("File %1 too large to process. Skipping.", fileNameIn1));
+                return;
+            }
+            TraceScope traceScope(TraceStage::preprocess);
+            m_lmppData.setData(pLineMatchingPreprocessor->run(*m_normalData.m_unicodeBuf).toUtf8());
+            pEncoding2 = QTextCodec::codecForName("UTF-8");
+        }
+        else if(!m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty())
         {
             QTemporaryFile tempOut2, fileInPP;
+            if(pPreprocessor != nullptr)
+            {
+                // The output of the first preprocessor only exists in memory.
+                FileAccess::createTempFile(fileOut1);
+                fileNameOut1 = fileOut1.fileName();
+                m_normalData.writeFile(fileNameOut1);
+            }
             fileNameIn2 = fileNameOut1.isEmpty() ? fileNameIn1 : fileNameOut1;
             QString fileNameInPP = fileNameIn2;
             pEncoding2 = pEncoding1;
@@ -496,6 +1142,7 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
             QString errorReason = Utils::getArguments(ppCmd, program, args);
             if(errorReason.isEmpty())
             {
+                TraceScope traceScope(TraceStage::preprocess);
                 ppProcess.start(program, args);
                 ppProcess.waitForFinished(-1);
             }
@@ -519,8 +1166,16 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
         }
         else if(m_pOptions->ignoreComments() || m_pOptions->m_bIgnoreCase)
         {
-            // We need a copy of the normal data.
-            m_lmppData.copyBufFrom(m_normalData);
+            // Only lines that actually contain comments differ from the normal data.
+            TraceScope traceScope(TraceStage::preprocess);
+            m_lmppData.removeCommentsFrom(m_normalData);
+            // Line flags came from src so there is nothing to copy back.
+            return;
+        }
+        else
+        {
+            // Without line-matching preprocessing getLineDataForDiff() uses the normal data as is.
+            return;
         }
     }
     else
@@ -531,6 +1186,7 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
 
     if(!m_lmppData.preprocess(pEncoding2, true))
     {
+        mTooLarge = true;
         mErrors.append(i18nc("Read error message. %1 = filepath", "File %1 too large to process. Skipping.", fileNameIn1));
         return;
     }
@@ -543,6 +1199,7 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
         for(qint64 i = m_lmppData.lineCount(); i < m_normalData.lineCount(); ++i)
         { // Set all empty lines to point to the end of the buffer.
             m_lmppData.m_v->push_back(LineData(m_lmppData.m_unicodeBuf, m_lmppData.m_unicodeBuf->length()));
+            m_lmppData.m_v->back().calcFingerprints();
         }
 
         m_lmppData.mLineCount = m_normalData.lineCount();
@@ -563,157 +1220,329 @@ void SourceData::readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicod
     }
 }
 
+namespace {
+/*
+    Single pass over the decoded text looking for characters that mark the data as binary and for
+    replacement characters left by the codec. The loop body is kept free of branches and early exits
+    so the compiler can vectorize it.
+*/
+void scanDecodedText(const QString& text, bool& bBinary, bool& bReplacementFound, bool& bHasCR)
+{
+    const char16_t* p = reinterpret_cast<const char16_t*>(text.constData());
+    const QtSizeType size = text.size();
+    bool binary = false, replacement = false, cr = false;
+
+    for(QtSizeType i = 0; i < size; ++i)
+    {
+        const char16_t c = p[i];
+        // Same test as QChar::isNull() || QChar::isNonCharacter()
+        binary |= (c == 0) | ((c >= 0xFDD0) & ((c <= 0xFDEF) | ((c & 0xFFFE) == 0xFFFE)));
+        replacement |= (c == QChar::ReplacementCharacter);
+        cr |= (c == '\r');
+    }
+
+    bBinary = binary;
+    bReplacementFound = replacement;
+    bHasCR = cr;
+}
+
+// Or's the bytes together in blocks, that loop vectorizes and only the result needs a branch.
+bool isAscii(const char* data, const QtSizeType size)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    constexpr QtSizeType blockSize = 4096;
+    for(QtSizeType start = 0; start < size; start += blockSize)
+    {
+        const QtSizeType end = std::min(size, start + blockSize);
+        unsigned char bits = 0;
+        for(QtSizeType i = start; i < end; ++i)
+            bits |= p[i];
+        if(bits >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+/*
+    Latin-1 and pure ASCII text don't need the conversion state machine of the codecs, every byte is
+    widened as is. Everything else goes through pEncoding. state carries a sequence cut off at the
+    end of p over to the next piece.
+*/
+QString decodeText(QTextCodec* pEncoding, const char* p, const QtNumberType size, QTextCodec::ConverterState& state)
+{
+    constexpr int latin1Mib = 4, utf8Mib = 106;
+    const int mib = pEncoding->mibEnum();
+    if(mib == latin1Mib || (mib == utf8Mib && state.remainingChars == 0 && isAscii(p, size)))
+    {
+        // As the codec does after its first piece, a U+FEFF further on is no byte order mark.
+        state.flags |= QTextCodec::IgnoreHeader;
+        return QString::fromLatin1(p, size);
+    }
+
+    return pEncoding->toUnicode(p, size, &state);
+}
+
+/*
+    Checks for valid UTF-8 without decoding. A sequence cut off at the end is accepted, data may be
+    just the start of a file. bNonAscii tells whether any complete multi-byte sequence was found.
+*/
+bool isValidUTF8(const char* data, const QtSizeType size, bool& bNonAscii)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    bNonAscii = false;
+    QtSizeType i = 0;
+    while(i < size)
+    {
+        const unsigned char c = p[i];
+        if(c < 0x80)
+        {
+            // Runs of ASCII are skipped in blocks, their or vectorizes like in isAscii().
+            constexpr QtSizeType blockSize = 16;
+            ++i;
+            while(i + blockSize <= size)
+            {
+                unsigned char bits = 0;
+                for(QtSizeType j = 0; j < blockSize; ++j)
+                    bits |= p[i + j];
+                if(bits >= 0x80)
+                    break;
+                i += blockSize;
+            }
+            while(i < size && p[i] < 0x80)
+                ++i;
+            continue;
+        }
+
+        QtSizeType length;
+        char32_t value, minValue;
+        if((c & 0xE0) == 0xC0)
+        {
+            length = 2;
+            value = c & 0x1F;
+            minValue = 0x80;
+        }
+        else if((c & 0xF0) == 0xE0)
+        {
+            length = 3;
+            value = c & 0x0F;
+            minValue = 0x800;
+        }
+        else if((c & 0xF8) == 0xF0)
+        {
+            length = 4;
+            value = c & 0x07;
+            minValue = 0x10000;
+        }
+        else
+            return false;
+
+        for(QtSizeType j = 1; j < length; ++j)
+        {
+            if(i + j >= size)
+                return true;
+            if((p[i + j] & 0xC0) != 0x80)
+                return false;
+            value = (value << 6) | (p[i + j] & 0x3F);
+        }
+        // Overlong forms, surrogates and values beyond unicode are invalid.
+        if(value < minValue || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+            return false;
+
+        bNonAscii = true;
+        i += length;
+    }
+    return true;
+}
+
+QtSizeType findLineEnd(const QChar* p, QtSizeType pos, const QtSizeType size)
+{
+    while(pos < size && p[pos] != '\n' && p[pos] != '\r')
+        ++pos;
+    return pos;
+}
+} // namespace
+
 /** Prepare the linedata vector for every input line.*/
 bool SourceData::FileData::preprocess(QTextCodec* pEncoding, bool removeComments)
 {
-    if(m_pBuf == nullptr)
+    if(m_pData == nullptr)
         return true;
 
     if(pEncoding == nullptr)
         return false;
 
-    QString line;
-    QChar curChar, prevChar = 0;
+    TraceScope traceScope(TraceStage::decode);
+    traceScope.setItems(mDataSize);
+
     LineType lines = 0;
-    QtSizeType lastOffset = 0;
     FileOffset skipBytes = 0;
     QScopedPointer<CommentParser> parser(new DefaultCommentParser());
 
-    // detect line end style
-    QVector<e_LineEndStyle> vOrigDataLineEndStyle;
     m_eLineEndStyle = eLineEndStyleUndefined;
 
-    QTextCodec* pCodec = detectEncoding(m_pBuf.get(), mDataSize, skipBytes);
+    // Only a byte order mark matters here, the encoding itself is already known.
+    QTextCodec* pCodec = detectBOM(m_pData, mDataSize, skipBytes);
     if(pCodec != pEncoding)
         skipBytes = 0;
 
-    if(mDataSize - skipBytes > limits<QtNumberType>::max())
-        return false;
-
-    const QByteArray ba = QByteArray::fromRawData(m_pBuf.get() + skipBytes, (QtSizeType)(mDataSize - skipBytes));
-    QTextStream ts(ba, QIODevice::ReadOnly); // Don't use text mode we need to see the actual line ending.
-    ts.setCodec(pEncoding);
-    ts.setAutoDetectUnicode(false);
+    /*
+        Text that fits into one buffer is decoded at once. Larger text is decoded in pieces of half a
+        buffer, a buffer takes the complete lines of a piece and the rest is carried over to the next.
+    */
+    const quint64 textBytes = mDataSize - skipBytes;
+    const quint64 pieceBytes = textBytes <= (quint64)mChunkSize ? textBytes : (quint64)mChunkSize / 2;
+    QTextCodec::ConverterState state;
 
-    m_bIncompleteConversion = false;
     m_unicodeBuf->clear();
-
-    assert(m_unicodeBuf->length() == 0);
-
+    m_v->setBuffer(m_unicodeBuf);
+    m_bIncompleteConversion = false;
+    mbInvalidInput = false;
     mHasEOLTermination = false;
-    bool skipNextRead = false;
-    while(!ts.atEnd())
+
+    QSharedPointer<QString> pBuffer = m_unicodeBuf;
+    QtSizeType lastOffset = 0;
+    bool bLastLineTerminated = false;
+    QString carry;
+    quint64 decodedBytes = 0;
+    do
     {
-        line.clear();
-        if(lines >= limits<LineType>::max() - 5)
+        const QtNumberType pieceSize = (QtNumberType)std::min(pieceBytes, textBytes - decodedBytes);
+        QString text = decodeText(pEncoding, m_pData + skipBytes + decodedBytes, pieceSize, state);
+        decodedBytes += pieceSize;
+        const bool bLastPiece = decodedBytes == textBytes;
+        if(!carry.isEmpty())
+            text.prepend(carry);
+
+        bool bBinary = false, bReplacementFound = false, bHasCR = false;
+        scanDecodedText(text, bBinary, bReplacementFound, bHasCR);
+        m_bIncompleteConversion |= bReplacementFound;
+        if(bBinary)
         {
+            m_bIncompleteConversion = false;
+            m_unicodeBuf->clear();
             m_v->clear();
-            return false;
+            m_v->setBuffer(m_unicodeBuf);
+            return true;
         }
 
-        if(!skipNextRead){
-            prevChar = curChar;
-            curChar = ts.read(1).unicode()[0];
+        carry.clear();
+        if(!bLastPiece)
+        {
+            QtSizeType cut = text.lastIndexOf('\n') + 1;
+            // A '\r' at the very end may be the first half of "\r\n".
+            if(cut == 0 && text.size() > 1)
+                cut = text.lastIndexOf('\r', -2) + 1;
+            // No line may be longer than what follows a piece in its buffer.
+            if(text.size() - cut > (QtSizeType)(mChunkSize / 2))
+            {
+                m_v->clear();
+                return false;
+            }
+            carry = text.mid(cut);
+            text.truncate(cut);
         }
+
+        /*
+            kdiff3 internally uses only unix style endings for simplicity. If the text
+            already looks like that it can be shared as is instead of built line by line.
+        */
+        const bool bShareText = !removeComments && !bHasCR;
+        if(bShareText)
+            *pBuffer = text;
         else
-            skipNextRead = false;
+            pBuffer->reserve(text.size());
 
-        QtSizeType  firstNonwhite = 0;
-        bool        foundNonWhite = false;
+        const QChar* p = text.constData();
+        const QtSizeType size = text.size();
+        QtSizeType pos = 0;
 
-        //QTextStream::readLine doesn't tell us about line endings.
-        while(curChar != '\n' && curChar != '\r')
+        while(pos < size)
         {
-            if(curChar.isNull() || curChar.isNonCharacter())
+            if(lines >= limits<LineType>::max() - 5)
             {
                 m_v->clear();
-                return true;
+                return false;
             }
 
-            if(curChar == QChar::ReplacementCharacter)
-                m_bIncompleteConversion = true;
-
-            line.append(curChar);
-            if(!curChar.isSpace() && !foundNonWhite)
+            const QtSizeType lineEnd = findLineEnd(p, pos, size);
+            const QtSizeType lineLength = lineEnd - pos;
+            //Qt6 intrudes 64bit sizes
+            if(lineLength >= limits<LineType>::max())
             {
-                firstNonwhite = line.length();
-                foundNonWhite = true;
+                m_v->clear();
+                return false;
             }
 
-            if(ts.atEnd())
-                break;
-
-            prevChar = curChar;
-            curChar = ts.read(1).unicode()[0];
-        }
+            QtSizeType firstNonwhite = pos;
+            while(firstNonwhite < lineEnd && p[firstNonwhite].isSpace())
+                ++firstNonwhite;
+            // Stored as one past the first non-white character, zero if there is none.
+            firstNonwhite = firstNonwhite < lineEnd ? firstNonwhite - pos + 1 : 0;
 
-        switch(curChar.unicode())
-        {
-            case '\n':
-                vOrigDataLineEndStyle.push_back(eLineEndStyleUnix);
-                break;
-            case '\r':
-                if((FileOffset)lastOffset < mDataSize)
+            bLastLineTerminated = lineEnd < size;
+            e_LineEndStyle lineEndStyle = eLineEndStyleUnix;
+            QtSizeType next = lineEnd + 1;
+            if(bLastLineTerminated && p[lineEnd] == '\r')
+            {
+                if(next < size && p[next] == '\n')
                 {
-                    prevChar = curChar;
-                    curChar = ts.read(1).unicode()[0];
-
-                    if(curChar == '\n')
-                    {
-                        vOrigDataLineEndStyle.push_back(eLineEndStyleDos);
-                        break;
-                    }
-                    //work around for lack of seek API in QTextStream
-                    skipNextRead = true;
+                    lineEndStyle = eLineEndStyleDos;
+                    ++next;
                 }
+                else
+                    lineEndStyle = eLineEndStyleUndefined; //old mac style ending.
+            }
+            if(bLastLineTerminated && lines == 0)
+                m_eLineEndStyle = lineEndStyle;
+
+            // Refers to text without copying unless comments have to be blanked out.
+            QString line = QString::fromRawData(p + pos, lineLength);
+            parser->processLine(line);
+            if(removeComments)
+                parser->removeComment(line);
+
+            ++lines;
+            m_v->push_back(LineData(pBuffer, lastOffset, lineLength, firstNonwhite, parser->isSkipable(), parser->isPureComment()));
+            if(!bShareText)
+            {
+                //The last line may not have an EOL mark. In that case don't add one to our buffer.
+                pBuffer->append(line);
+                if(bLastLineTerminated)
+                    pBuffer->append('\n');
+            }
 
-                //old mac style ending.
-                vOrigDataLineEndStyle.push_back(eLineEndStyleUndefined);
-                break;
-        }
-        parser->processLine(line);
-        if(removeComments)
-            parser->removeComment(line);
-        //Qt6 intrudes 64bit sizes
-        if(line.size() >= limits<LineType>::max())
-        {
-            m_v->clear();
-            return false;
+            lastOffset += lineLength + (bLastLineTerminated ? 1 : 0);
+            pos = next;
         }
 
-        ++lines;
-        m_v->push_back(LineData(m_unicodeBuf, lastOffset, line.length(), firstNonwhite, parser->isSkipable(), parser->isPureComment()));
-        //The last line may not have an EOL mark. In that case don't add one to our buffer.
-        m_unicodeBuf->append(line);
-        if(curChar == '\n' || curChar == '\r' || prevChar == '\r')
+        assert(pBuffer->length() == lastOffset);
+
+        if(!bLastPiece)
         {
-            //kdiff3 internally uses only unix style endings for simplicity.
-            m_unicodeBuf->append('\n');
+            pBuffer = QSharedPointer<QString>::create();
+            m_v->addBuffer(pBuffer);
+            lastOffset = 0;
         }
-
-        assert(m_unicodeBuf->length() != lastOffset);
-        lastOffset = m_unicodeBuf->length();
-    }
+    } while(decodedBytes < textBytes);
 
     /*
         Process trailing new line as if there were a blank non-terminated line after it.
         But do nothing to the data buffer since this is a phantom line needed for internal purposes.
     */
-    if(curChar == '\n' || curChar == '\r')
+    if(bLastLineTerminated)
     {
         mHasEOLTermination = true;
         ++lines;
 
         parser->processLine("");
-        m_v->push_back(LineData(m_unicodeBuf, lastOffset, 0, 0, parser->isSkipable(), parser->isPureComment()));
+        m_v->push_back(LineData(pBuffer, lastOffset, 0, 0, parser->isSkipable(), parser->isPureComment()));
     }
 
-    m_v->push_back(LineData(m_unicodeBuf, lastOffset));
+    m_v->push_back(LineData(pBuffer, lastOffset));
+    m_v->calcFingerprints();
 
     m_bIsText = true;
-
-    if(!vOrigDataLineEndStyle.isEmpty())
-        m_eLineEndStyle = vOrigDataLineEndStyle[0];
+    mbInvalidInput = state.invalidChars > 0;
 
     mLineCount = lines;
     return true;
@@ -771,7 +1600,7 @@ QTextCodec* SourceData::getEncodingFromTag(const QByteArray& s, const QByteArray
     return nullptr;
 }
 
-QTextCodec* SourceData::detectEncoding(const char* buf, qint64 size, FileOffset& skipBytes)
+QTextCodec* SourceData::detectBOM(const char* buf, qint64 size, FileOffset& skipBytes)
 {
     if(size >= 2)
     {
@@ -797,9 +1626,18 @@ QTextCodec* SourceData::detectEncoding(const char* buf, qint64 size, FileOffset&
         }
     }
     skipBytes = 0;
+    return nullptr;
+}
+
+QTextCodec* SourceData::detectEncoding(const char* buf, qint64 size, FileOffset& skipBytes)
+{
+    QTextCodec* pBOMCodec = detectBOM(buf, size, skipBytes);
+    if(pBOMCodec != nullptr)
+        return pBOMCodec;
+
     QByteArray s;
     /*
-        We don't need the whole file here just the header.
+        The tags are looked for in the header only, the UTF-8 check takes all of what it is given.
     */
     if(size <= 5000)
         s = QByteArray(buf, (QtSizeType)size);
@@ -836,20 +1674,14 @@ QTextCodec* SourceData::detectEncoding(const char* buf, qint64 size, FileOffset&
         }
     }
     //Attempt to detect non-bom UTF8. This is a very common encoding.
-    return detectUTF8(s);
+    return detectUTF8(QByteArray::fromRawData(buf, (QtSizeType)size));
 }
 
 QTextCodec* SourceData::detectUTF8(const QByteArray& data)
 {
-    QTextCodec* utf8 = QTextCodec::codecForName("UTF-8");
-
-    QTextCodec::ConverterState state;
-    utf8->toUnicode(data.constData(), data.size(), &state);
-
-    if(state.invalidChars == 0)
-        for (int i = 0; i < data.size()-state.remainingChars; i++)
-            if ((unsigned)data.at(i) > 127)
-                return utf8;
+    bool bNonAscii = false;
+    if(isValidUTF8(data.constData(), data.size(), bNonAscii) && bNonAscii)
+        return QTextCodec::codecForName("UTF-8");
 
     return nullptr;
 }
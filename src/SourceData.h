@@ -16,14 +16,20 @@
 #include "LineRef.h"
 #include "options.h"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include <QDateTime>
+#include <QFile>
 #include <QTextCodec>
 #include <QTemporaryFile>
 #include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 
+class Preprocessor;
+
 class SourceData
 {
   public:
@@ -32,7 +38,8 @@ class SourceData
     [[nodiscard]] LineType getSizeLines() const;
     [[nodiscard]] qint64 getSizeBytes() const;
     [[nodiscard]] const char* getBuf() const;
-    [[nodiscard]] const QString& getText() const;
+    // The decoded text, in more than one buffer if it is too large for one QString.
+    [[nodiscard]] const std::vector<QSharedPointer<QString>>& getTextBuffers() const;
     [[nodiscard]] const std::shared_ptr<LineDataVector>& getLineDataForDisplay() const;
     [[nodiscard]] const std::shared_ptr<LineDataVector>& getLineDataForDiff() const;
 
@@ -48,16 +55,60 @@ class SourceData
     [[nodiscard]] bool isFromBuffer() const;           // was it set via setData() (vs. setFileAccess() or setFilename())
     void setData(const QString& data);
     [[nodiscard]] bool isValid() const; // Either no file is specified or reading was successful
+    [[nodiscard]] bool isTooLarge() const { return mTooLarge; } // Text could not be loaded because of its size
+    // Most characters kept in one buffer of decoded text, at most 2^31 - 1. Larger text is split between lines.
+    void setChunkSize(const qint64 chars)
+    {
+        m_normalData.mChunkSize = std::min(chars, (qint64)limits<QtNumberType>::max());
+        m_lmppData.mChunkSize = m_normalData.mChunkSize;
+    }
 
     // Returns a list of error messages if anything went wrong
     void readAndPreprocess(QTextCodec* pEncoding, bool bAutoDetectUnicode);
+    // Like readAndPreprocess() but stops after the last complete line within maxBytes of a file read without a preprocessor.
+    void readAndPreprocessHead(QTextCodec* pEncoding, bool bAutoDetectUnicode, qint64 maxBytes);
+    // Only the beginning of the file was read, see readAndPreprocessHead().
+    [[nodiscard]] bool isPartial() const { return mPartial; }
+    // Decodes the bytes read before with another encoding, false if the input has to be read again instead.
+    bool redecode(QTextCodec* pEncoding);
+    // Everything decoding a text file gave that can't be derived cheaply, see SessionSnapshot.
+    struct DecodedText
+    {
+        std::shared_ptr<LineDataVector> lines; // Its buffer holds the text.
+        e_LineEndStyle eLineEndStyle = eLineEndStyleUndefined;
+        bool bIncompleteConversion = false;
+        bool bHasEOLTermination = false;
+    };
+    [[nodiscard]] DecodedText decodedText() const;
+    // Size and time of the local file when it was read, false if it can't be checked.
+    bool getReadStamp(QDateTime& lastModified, qint64& size) const;
+    // Installs text decoded before with pEncoding, false if the file changed since or needs a preprocessor command.
+    bool restoreDecodedText(QTextCodec* pEncoding, const QDateTime& lastModified, const qint64 size, const DecodedText& decoded);
+    // Takes over what other read instead of reading again, other must have been read from the same file.
+    void takeLoadedData(SourceData& other);
+    // True if reading the file again with these settings would give the same data.
+    [[nodiscard]] bool isUpToDate(const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode) const;
+    // Changes whenever different data is loaded.
+    [[nodiscard]] quint64 generation() const { return mGeneration; }
+    /*
+        Keeps the decoded text compressed in memory while nothing shows it, the line tables stay.
+        Text shared with someone else is left as it is. decompressText() must be called before the
+        lines are used again, it fails only if there isn't enough memory.
+    */
+    void compressText();
+    bool decompressText();
+    [[nodiscard]] bool isTextCompressed() const { return !mCompressedText.empty(); }
     bool saveNormalDataAs(const QString& fileName);
 
     [[nodiscard]] bool isBinaryEqualWith(const QSharedPointer<SourceData>& other) const;
+    [[nodiscard]] bool isTextEqualWith(const QSharedPointer<SourceData>& other) const;
+    // True if line matching would find every line equal, so running the diff can be skipped.
+    [[nodiscard]] bool isLineMatchEqualWith(const QSharedPointer<SourceData>& other) const;
 
     void reset();
 
     [[nodiscard]] bool isDir() const { return m_fileAccess.isDir(); }
+    [[nodiscard]] bool isLocal() const { return m_fileAccess.isLocal(); }
 
     [[nodiscard]] QTextCodec* getEncoding() const { return m_pEncoding; }
     [[nodiscard]] e_LineEndStyle getLineEndStyle() const { return m_normalData.m_eLineEndStyle; }
@@ -72,10 +123,36 @@ class SourceData
                                 const QString& fileNameOut, QTextCodec* pCodecOut);
 
     static QTextCodec* detectUTF8(const QByteArray& data);
+    static QTextCodec* detectBOM(const char* buf, qint64 size, FileOffset& skipBytes);
     static QTextCodec* detectEncoding(const char* buf, qint64 size, FileOffset& skipBytes);
     static QTextCodec* getEncodingFromTag(const QByteArray& s, const QByteArray& encodingTag);
 
     QTextCodec* detectEncoding(const QString& fileName, QTextCodec* pFallbackCodec);
+    // A local file as it was on disk when it was read and the settings used for reading it.
+    struct ReadStamp
+    {
+        bool bValid = false;
+        QDateTime lastModified;
+        qint64 size = 0;
+        QTextCodec* pEncoding = nullptr;
+        bool bAutoDetectUnicode = false;
+        QString preProcessorCmd;
+        QString lineMatchingPreProcessorCmd;
+        QTextCodec* pEncodingPP = nullptr;
+        bool bIgnoreComments = false;
+        bool bIgnoreCase = false;
+        bool bIgnoreNumbers = false;
+        bool bDecompressInputs = false;
+
+        [[nodiscard]] bool operator==(const ReadStamp& other) const;
+    };
+
+    [[nodiscard]] ReadStamp currentReadStamp(const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode) const;
+    // Shows an error and returns false if the input looked compressed but couldn't be read.
+    bool decompressInput(bool& bDecompressed);
+    void readAndPreprocessData(QTextCodec* pEncoding, bool bAutoDetectUnicode);
+    void calcContentHashes();
+
     QString m_aliasName;
     FileAccess m_fileAccess;
     QSharedPointer<Options> m_pOptions;
@@ -91,23 +168,37 @@ class SourceData
       private:
         friend SourceData;
         std::unique_ptr<char[]> m_pBuf; //TODO: Phase out needlessly wastes memory and time by keeping second copy of file data.
+        std::unique_ptr<QFile> mMappedFile; // Owns the mapping when the raw data is read straight from a local file.
+        const char* m_pData = nullptr;      // Points into m_pBuf or the mapping.
         quint64 mDataSize = 0;
         qint64 mLineCount = 0; // Number of lines in m_pBuf1 and size of m_v1, m_dv12 and m_dv13
-        QSharedPointer<QString> m_unicodeBuf=QSharedPointer<QString>::create();
+        QSharedPointer<QString> m_unicodeBuf=QSharedPointer<QString>::create(); // The first buffer of m_v.
+        qint64 mChunkSize = limits<QtNumberType>::max(); // Characters of one buffer, see preprocess().
         std::shared_ptr<LineDataVector> m_v=std::make_shared<LineDataVector>();
         bool m_bIsText = false;
         bool m_bIncompleteConversion = false;
+        bool mbInvalidInput = false; // The codec found bytes it couldn't decode, see preprocess().
         e_LineEndStyle m_eLineEndStyle = eLineEndStyleUndefined;
         bool mHasEOLTermination = false;
 
+        bool mapFile(const QString& fileName);
+        void detachFromMapping();
+
       public:
         bool readFile(FileAccess& file);
         bool readFile(const QString& filename);
         bool writeFile(const QString& filename);
+        void setData(const QByteArray& data);
+        // Replaces the data by its content if fileName and the data say it is compressed.
+        bool decompress(const QString& fileName, bool& bDecompressed, QString& errorString);
+        bool runPreprocessor(Preprocessor& preprocessor, QTextCodec* pEncoding);
 
         bool preprocess(QTextCodec* pEncoding, bool removeComments);
         void reset();
-        void copyBufFrom(const FileData& src);
+        void removeCommentsFrom(const FileData& src);
+
+        [[nodiscard]] inline const char* data() const { return m_pData; }
+        [[nodiscard]] inline bool isMapped() const { return mMappedFile != nullptr; }
 
         [[nodiscard]] bool isEmpty() const { return mDataSize == 0; }
 
@@ -120,6 +211,25 @@ class SourceData
     FileData m_normalData;
     FileData m_lmppData;
     QTextCodec* m_pEncoding = nullptr;
+
+    // Hashes of the decoded text and of the line matching data, set by readAndPreprocess().
+    quint64 mTextHash = 0;
+    quint64 mLineMatchHash = 0;
+    bool mTooLarge = false;
+    qint64 mReadLimit = 0; // Bytes readAndPreprocessData() keeps at most, 0 for all.
+    bool mPartial = false;
+    QTextCodec* mDecodedEncoding = nullptr; // Encoding of the text as it is now.
+
+    ReadStamp mReadStamp;
+    quint64 mGeneration = 0;
+
+    struct CompressedBuffer
+    {
+        QSharedPointer<QString> pBuffer; // Emptied, the LineData entries still point to it.
+        QtSizeType length = 0;
+        std::vector<QByteArray> pieces;
+    };
+    std::vector<CompressedBuffer> mCompressedText;
 };
 
 #endif // !SOURCEDATA_H
@@ -0,0 +1,100 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "SourceDataPrefetcher.h"
+
+#include "fileaccess.h"
+#include "options.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include <QMutexLocker>
+
+SourceDataPrefetcher::SourceDataPrefetcher(size_t maxEntries): mMaxEntries(maxEntries)
+{
+}
+
+SourceDataPrefetcher::~SourceDataPrefetcher()
+{
+    // Reads not started yet are dropped, their futures report a broken promise.
+    mpTasks->cancel();
+    mpTasks->wait();
+}
+
+void SourceDataPrefetcher::prefetch(const QString& fileName, const QSharedPointer<Options>& pOptions, QTextCodec* pEncoding, bool bAutoDetectUnicode)
+{
+    if(fileName.isEmpty() || mMaxEntries == 0)
+        return;
+
+    const FileAccess fileAccess(fileName);
+    if(!fileAccess.isLocal() || !fileAccess.isNormal())
+        return;
+
+    Entry entry;
+    entry.fileName = fileAccess.absoluteFilePath();
+
+    QMutexLocker locker(&mMutex);
+    if(std::any_of(mEntries.cbegin(), mEntries.cend(), [&entry](const Entry& e) { return e.fileName == entry.fileName; }))
+        return;
+
+    // Entries nobody asked for get dropped once newer ones come in. A read in progress finishes anyway.
+    if(mEntries.size() >= mMaxEntries)
+        mEntries.pop_front();
+
+    entry.pData = QSharedPointer<SourceData>::create();
+    entry.pData->setOptions(QSharedPointer<Options>::create(*pOptions));
+    entry.pData->setFilename(entry.fileName);
+
+    const auto task = std::make_shared<std::packaged_task<void()>>([pData = entry.pData, pEncoding, bAutoDetectUnicode, bCompress = pOptions->m_bCompressPrefetched]() {
+        pData->readAndPreprocess(pEncoding, bAutoDetectUnicode);
+        if(bCompress)
+            pData->compressText();
+    });
+    entry.done = task->get_future().share();
+    TaskExecutor::instance().start([task]() { (*task)(); }, TaskExecutor::Priority::background, mpTasks);
+
+    mEntries.push_back(std::move(entry));
+}
+
+QSharedPointer<SourceData> SourceDataPrefetcher::take(const QString& fileName, const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode)
+{
+    Entry entry;
+    {
+        QMutexLocker locker(&mMutex);
+        const auto it = std::find_if(mEntries.begin(), mEntries.end(), [&fileName](const Entry& e) { return e.fileName == fileName; });
+        if(it == mEntries.end())
+            return nullptr;
+
+        entry = std::move(*it);
+        mEntries.erase(it);
+    }
+
+    entry.done.wait();
+
+    // Failed reads have no valid stamp, the caller repeats them so the errors are reported as usual.
+    if(!entry.pData->isUpToDate(options, pEncoding, bAutoDetectUnicode) || !entry.pData->decompressText())
+        return nullptr;
+
+    return entry.pData;
+}
+
+bool SourceDataPrefetcher::isReady(const QString& fileName)
+{
+    QMutexLocker locker(&mMutex);
+    const auto it = std::find_if(mEntries.cbegin(), mEntries.cend(), [&fileName](const Entry& e) { return e.fileName == fileName; });
+    return it == mEntries.cend() || it->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void SourceDataPrefetcher::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.clear();
+}
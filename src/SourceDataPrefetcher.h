@@ -0,0 +1,63 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef SOURCEDATAPREFETCHER_H
+#define SOURCEDATAPREFETCHER_H
+
+#include "SourceData.h"
+#include "TaskExecutor.h"
+
+#include <future>
+#include <list>
+#include <memory>
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QTextCodec>
+
+class Options;
+
+/*
+    Reads the files of upcoming merges in the background.
+
+    While the user resolves one merge of a directory merge the files of the next ones are read and
+    decoded here. Only local files are read ahead. A prefetched file is handed out only if neither
+    the file nor the options used for reading it changed in the meantime. The reads run with
+    background priority, they never hold up the diff being shown. With
+    Options::m_bCompressPrefetched the text waits compressed until it is taken.
+*/
+class SourceDataPrefetcher
+{
+  public:
+    explicit SourceDataPrefetcher(size_t maxEntries = 6);
+    ~SourceDataPrefetcher();
+
+    void prefetch(const QString& fileName, const QSharedPointer<Options>& pOptions, QTextCodec* pEncoding, bool bAutoDetectUnicode);
+    // Waits if the file is still being read. Returns nullptr if nothing usable was prefetched.
+    [[nodiscard]] QSharedPointer<SourceData> take(const QString& fileName, const Options& options, QTextCodec* pEncoding, bool bAutoDetectUnicode);
+    // False while the file is still being read, take() would wait for it.
+    [[nodiscard]] bool isReady(const QString& fileName);
+    void clear();
+
+  private:
+    struct Entry
+    {
+        QString fileName;
+        QSharedPointer<SourceData> pData; // Read with a copy of the options taken when the read was started.
+        std::shared_future<void> done;
+    };
+
+    QMutex mMutex;
+    std::list<Entry> mEntries; // Oldest first.
+    std::shared_ptr<TaskGroup> mpTasks = std::make_shared<TaskGroup>();
+    size_t mMaxEntries;
+};
+
+#endif
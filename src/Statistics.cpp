@@ -0,0 +1,116 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "Statistics.h"
+
+#include <algorithm>
+
+#include <KLocalizedString>
+
+#include <QLocale>
+
+namespace {
+QString milliseconds(const qint64 nsecs)
+{
+    return QLocale().toString((double)nsecs / 1000000, 'f', 1);
+}
+} // namespace
+
+void Statistics::DirectoryCompare::start()
+{
+    mStartTotals = Trace::instance().totals(TraceStage::compare);
+    mTimer.start();
+    mbValid = false;
+}
+
+void Statistics::DirectoryCompare::finish()
+{
+    if(!mTimer.isValid())
+        return;
+
+    const Trace::Totals totals = Trace::instance().totals(TraceStage::compare);
+    mItems = totals.calls - mStartTotals.calls;
+    mBytes = totals.items - mStartTotals.items;
+    mNsecs = mTimer.nsecsElapsed();
+    mTimer.invalidate();
+    mbValid = true;
+}
+
+void Statistics::start()
+{
+    for(size_t i = 0; i < Trace::stageCount; ++i)
+        mStartTotals[i] = Trace::instance().totals((TraceStage)i);
+
+    mInputs.clear();
+    mPeakLineDataBytes = 0;
+    mPeakDiff3LineListBytes = 0;
+    mLineDataBytes = 0;
+    mDiff3LineListBytes = 0;
+    mFineDiffCount = 0;
+    mEvictions = 0;
+    mEvictedBytes = 0;
+}
+
+void Statistics::updateMemory(const qint64 lineDataBytes, const qint64 diff3LineListBytes)
+{
+    mPeakLineDataBytes = std::max(mPeakLineDataBytes, lineDataBytes);
+    mPeakDiff3LineListBytes = std::max(mPeakDiff3LineListBytes, diff3LineListBytes);
+    mLineDataBytes = lineDataBytes;
+    mDiff3LineListBytes = diff3LineListBytes;
+}
+
+QString Statistics::text(const DirectoryCompare* pDirectoryCompare) const
+{
+    const QLocale locale;
+    QString s;
+
+    if(!mInputs.empty())
+    {
+        s += i18n("Inputs:") + '\n';
+        for(const Input& input: mInputs)
+            s += "  " + i18nc("%1 = file name, %2 = size, %3 = number of lines", "%1: %2, %3 lines", input.name, locale.formattedDataSize(input.bytes), input.lines) + '\n';
+        s += '\n';
+    }
+
+    s += i18n("Time per stage since loading:") + '\n';
+    for(size_t i = 0; i < Trace::stageCount; ++i)
+    {
+        const Trace::Totals totals = Trace::instance().totals((TraceStage)i);
+        const qint64 calls = totals.calls - mStartTotals[i].calls;
+        if(calls == 0)
+            continue;
+
+        // Stages running on several threads can add up to more than the elapsed time.
+        s += "  " + i18nc("%1 = stage name, %2 = milliseconds, %3 = count", "%1: %2 ms in %3 calls", QString::fromLatin1(Trace::stageName((TraceStage)i)),
+                          milliseconds(totals.nsecs - mStartTotals[i].nsecs), calls) + '\n';
+    }
+    s += '\n';
+
+    s += i18n("Peak memory of the line data: %1", locale.formattedDataSize(mPeakLineDataBytes)) + '\n';
+    s += i18n("Peak memory of the aligned lines: %1", locale.formattedDataSize(mPeakDiff3LineListBytes)) + '\n';
+    s += i18n("Current memory of the line data and aligned lines: %1", locale.formattedDataSize(mLineDataBytes + mDiff3LineListBytes)) + '\n';
+    s += i18n("Fine diffs calculated: %1", mFineDiffCount) + '\n';
+    if(mEvictions > 0)
+        s += i18np("Fine diffs freed once for the memory budget: %2", "Fine diffs freed %1 times for the memory budget: %2", mEvictions, locale.formattedDataSize(mEvictedBytes)) + '\n';
+
+    if(pDirectoryCompare != nullptr && pDirectoryCompare->isValid())
+    {
+        const double seconds = (double)pDirectoryCompare->nsecs() / 1000000000;
+        s += '\n' + i18n("Last folder comparison:") + '\n';
+        s += "  " + i18n("%1 items in %2 ms", pDirectoryCompare->items(), milliseconds(pDirectoryCompare->nsecs())) + '\n';
+        if(seconds > 0)
+        {
+            s += "  " + i18n("%1 items per second", locale.toString(pDirectoryCompare->items() / seconds, 'f', 1)) + '\n';
+            s += "  " + i18n("%1 compared, %2 per second", locale.formattedDataSize(pDirectoryCompare->bytes()),
+                             locale.formattedDataSize((qint64)(pDirectoryCompare->bytes() / seconds))) + '\n';
+        }
+    }
+
+    return s;
+}
@@ -0,0 +1,89 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include "LineRef.h"
+#include "Trace.h"
+
+#include <array>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QString>
+
+/*
+    Numbers about the current comparison as shown by Diffview > Statistics.
+
+    The time per stage is taken from the Trace totals since start(), so it includes painting
+    and word wrapping after the files were loaded. Memory is estimated from the sizes of the
+    containers, the peak is the largest estimate seen by updateMemory() and the current one the
+    last.
+*/
+class Statistics
+{
+  public:
+    struct Input
+    {
+        QString name;
+        qint64 bytes = 0;
+        LineType lines = 0;
+    };
+
+    // Measures one folder comparison, from listing the items to the last result.
+    class DirectoryCompare
+    {
+      public:
+        void start();
+        void finish();
+
+        [[nodiscard]] bool isValid() const { return mbValid; }
+        [[nodiscard]] qint64 items() const { return mItems; }
+        [[nodiscard]] qint64 bytes() const { return mBytes; }
+        [[nodiscard]] qint64 nsecs() const { return mNsecs; }
+
+      private:
+        Trace::Totals mStartTotals;
+        QElapsedTimer mTimer;
+        bool mbValid = false;
+        qint64 mItems = 0;
+        qint64 mBytes = 0;
+        qint64 mNsecs = 0;
+    };
+
+    // A new comparison starts, forgets everything about the last one.
+    void start();
+
+    void setInputs(const std::vector<Input>& inputs) { mInputs = inputs; }
+    void updateMemory(const qint64 lineDataBytes, const qint64 diff3LineListBytes);
+    void setFineDiffCount(const qint64 count) { mFineDiffCount = count; }
+    // Fine diffs were freed to stay within the memory budget.
+    void addEviction(const qint64 bytes)
+    {
+        ++mEvictions;
+        mEvictedBytes += bytes;
+    }
+
+    // pDirectoryCompare may be nullptr or invalid if no folders were compared.
+    [[nodiscard]] QString text(const DirectoryCompare* pDirectoryCompare) const;
+
+  private:
+    std::array<Trace::Totals, Trace::stageCount> mStartTotals;
+    std::vector<Input> mInputs;
+    qint64 mPeakLineDataBytes = 0;
+    qint64 mPeakDiff3LineListBytes = 0;
+    qint64 mLineDataBytes = 0;
+    qint64 mDiff3LineListBytes = 0;
+    qint64 mFineDiffCount = 0;
+    qint64 mEvictions = 0;
+    qint64 mEvictedBytes = 0;
+};
+
+#endif
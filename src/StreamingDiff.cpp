@@ -0,0 +1,307 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "StreamingDiff.h"
+
+#include "diff.h"
+#include "LineDiffEngine.h"
+#include "ProgressProxy.h"
+#include "TypeUtils.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+#include <KLocalizedString>
+
+#include <QDataStream>
+#include <QFile>
+#include <QTextCodec>
+
+namespace {
+
+constexpr qint64 blockSize = 1024 * 1024;
+
+// Hands out the decoded lines of a file a few at a time, without the line end characters.
+class LineReader
+{
+  public:
+    bool open(const QString& fileName, QTextCodec* pCodec)
+    {
+        mFile.setFileName(fileName);
+        if(!mFile.open(QIODevice::ReadOnly))
+            return false;
+
+        mDecoder.reset(pCodec->makeDecoder());
+        return true;
+    }
+
+    // Appends lines until lines holds count entries or the file ends.
+    bool fill(std::deque<QString>& lines, const size_t count)
+    {
+        while(lines.size() < count && !mAtEnd)
+        {
+            const QtSizeType lineEnd = mText.indexOf('\n', mPos);
+            if(lineEnd >= 0)
+            {
+                lines.push_back(takeLine(lineEnd));
+                mPos = lineEnd + 1;
+                continue;
+            }
+
+            if(mFile.atEnd())
+            {
+                if(mPos < mText.size())
+                    lines.push_back(takeLine(mText.size()));
+                mText.clear();
+                mPos = 0;
+                mAtEnd = true;
+                break;
+            }
+
+            mText.remove(0, mPos);
+            mPos = 0;
+            const QByteArray block = mFile.read(blockSize);
+            if(block.isEmpty() && mFile.error() != QFileDevice::NoError)
+                return false;
+            mText += mDecoder->toUnicode(block);
+        }
+
+        return true;
+    }
+
+    [[nodiscard]] bool atEnd() const { return mAtEnd; }
+    [[nodiscard]] qint64 bytesRead() const { return mFile.pos(); }
+    [[nodiscard]] qint64 size() const { return mFile.size(); }
+    [[nodiscard]] QString errorString() const { return mFile.errorString(); }
+
+  private:
+    QString takeLine(const QtSizeType lineEnd) const
+    {
+        QString line = mText.mid(mPos, lineEnd - mPos);
+        if(line.endsWith('\r'))
+            line.chop(1);
+        return line;
+    }
+
+    QFile mFile;
+    std::unique_ptr<QTextDecoder> mDecoder;
+    QString mText;
+    QtSizeType mPos = 0;
+    bool mAtEnd = false;
+};
+
+// Builds the line table the diff engines expect for the first count lines.
+bool toLineData(const std::deque<QString>& lines, const size_t count, LineDataVector& lineData)
+{
+    QtSizeType totalSize = 0;
+    for(size_t i = 0; i < count; ++i)
+        totalSize += lines[i].size();
+    if(totalSize >= limits<qint32>::max())
+        return false;
+
+    const QSharedPointer<QString> buffer = QSharedPointer<QString>::create();
+    buffer->reserve(totalSize);
+    lineData.clear();
+    lineData.reserve(count);
+    lineData.setBuffer(buffer);
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        const QString& line = lines[i];
+        QtSizeType firstNonWhite = 0;
+        while(firstNonWhite < line.size() && line[firstNonWhite].isSpace())
+            ++firstNonWhite;
+        // Stored as one past the first non-white character, zero if there is none.
+        firstNonWhite = firstNonWhite < line.size() ? firstNonWhite + 1 : 0;
+
+        lineData.push_back(LineData(buffer, buffer->size(), line.size(), firstNonWhite));
+        buffer->append(line);
+    }
+
+    lineData.calcFingerprints();
+    return true;
+}
+} // namespace
+
+StreamingDiff::StreamingDiff(const QSharedPointer<Options>& pOptions, const LineType windowLines):
+    mOptions(pOptions), mWindowLines(std::max<LineType>(windowLines, 2))
+{
+}
+
+bool StreamingDiff::run(const QString& fileName1, const QString& fileName2, QTextCodec* pCodec)
+{
+    ProgressProxy pp;
+    LineReader reader1, reader2;
+
+    mHasPendingHunk = false;
+    mLineCount1 = mLineCount2 = 0;
+    mHunkCount = 0;
+    mDifferingLines1 = mDifferingLines2 = 0;
+    mErrorString.clear();
+
+    if(!reader1.open(fileName1, pCodec))
+    {
+        mErrorString = i18nc("Read error message. %1 = filepath", "Failed to read file: %1", fileName1);
+        return false;
+    }
+    if(!reader2.open(fileName2, pCodec))
+    {
+        mErrorString = i18nc("Read error message. %1 = filepath", "Failed to read file: %1", fileName2);
+        return false;
+    }
+    if(!mSpillFile.open() || !mSpillFile.resize(0) || !mSpillFile.seek(0))
+    {
+        mErrorString = i18n("Writing temporary file failed: %1", mSpillFile.errorString());
+        return false;
+    }
+
+    const std::unique_ptr<LineDiffEngine> engine = LineDiffEngine::create(DiffSettings(*mOptions).withLineDiffAlgorithm(LineDiffAlgorithm::histogram));
+    std::deque<QString> lines1, lines2;
+    LineDataVector lineData1, lineData2;
+
+    pp.setMaxNofSteps(reader1.size() + reader2.size());
+    for(;;)
+    {
+        if(!reader1.fill(lines1, mWindowLines) || !reader2.fill(lines2, mWindowLines))
+        {
+            mErrorString = reader1.errorString() + reader2.errorString();
+            return false;
+        }
+        if(lines1.empty() && lines2.empty())
+            break;
+
+        const LineType size1 = (LineType)lines1.size();
+        const LineType size2 = (LineType)lines2.size();
+        LineType end1 = size1, end2 = size2;
+
+        if(size1 > 0 && size2 > 0)
+        {
+            if(!toLineData(lines1, size1, lineData1) || !toLineData(lines2, size2, lineData2))
+            {
+                mErrorString = i18n("Lines too long to compare.");
+                return false;
+            }
+
+            DiffList diffList;
+            engine->diff(lineData1, 0, size1, lineData2, 0, size2, diffList);
+
+            // Commit up to the end of the last matching run, the rest may continue in the next window.
+            LineType pos1 = 0, pos2 = 0;
+            if(!reader1.atEnd() || !reader2.atEnd())
+            {
+                end1 = end2 = 0;
+                for(const Diff& d: diffList)
+                {
+                    pos1 += d.numberOfEquals();
+                    pos2 += d.numberOfEquals();
+                    if(d.numberOfEquals() > 0)
+                    {
+                        end1 = pos1;
+                        end2 = pos2;
+                    }
+                    pos1 += (LineType)d.diff1();
+                    pos2 += (LineType)d.diff2();
+                }
+
+                // Without a late anchor the windows would barely move, take them as they are.
+                if(2 * end1 < size1 && 2 * end2 < size2)
+                {
+                    end1 = size1;
+                    end2 = size2;
+                }
+            }
+
+            pos1 = pos2 = 0;
+            for(const Diff& d: diffList)
+            {
+                pos1 += d.numberOfEquals();
+                pos2 += d.numberOfEquals();
+                if(pos1 >= end1 && pos2 >= end2)
+                    break;
+
+                addHunk({mLineCount1 + pos1, mLineCount2 + pos2, std::min<qint64>(d.diff1(), end1 - pos1), std::min<qint64>(d.diff2(), end2 - pos2)});
+                pos1 += (LineType)d.diff1();
+                pos2 += (LineType)d.diff2();
+            }
+        }
+        else
+        {
+            addHunk({mLineCount1, mLineCount2, size1, size2});
+        }
+
+        lines1.erase(lines1.begin(), lines1.begin() + end1);
+        lines2.erase(lines2.begin(), lines2.begin() + end2);
+        mLineCount1 += end1;
+        mLineCount2 += end2;
+
+        pp.setCurrent(reader1.bytesRead() + reader2.bytesRead());
+        if(pp.wasCancelled())
+        {
+            mErrorString = i18n("Comparison was cancelled.");
+            return false;
+        }
+    }
+
+    if(mHasPendingHunk)
+        writeHunk(mPendingHunk);
+    mHasPendingHunk = false;
+    mSpillFile.flush();
+    return true;
+}
+
+void StreamingDiff::addHunk(const Hunk& hunk)
+{
+    if(hunk.count1 <= 0 && hunk.count2 <= 0)
+        return;
+
+    mDifferingLines1 += hunk.count1;
+    mDifferingLines2 += hunk.count2;
+
+    // Sections meeting at a window boundary are one change.
+    if(mHasPendingHunk && mPendingHunk.line1 + mPendingHunk.count1 == hunk.line1 && mPendingHunk.line2 + mPendingHunk.count2 == hunk.line2)
+    {
+        mPendingHunk.count1 += hunk.count1;
+        mPendingHunk.count2 += hunk.count2;
+        return;
+    }
+
+    if(mHasPendingHunk)
+        writeHunk(mPendingHunk);
+    mPendingHunk = hunk;
+    mHasPendingHunk = true;
+}
+
+void StreamingDiff::writeHunk(const Hunk& hunk)
+{
+    QDataStream out(&mSpillFile);
+    out << hunk.line1 << hunk.line2 << hunk.count1 << hunk.count2;
+    ++mHunkCount;
+}
+
+bool StreamingDiff::forEachHunk(const std::function<bool(const Hunk&)>& callback)
+{
+    if(!mSpillFile.isOpen() || !mSpillFile.seek(0))
+        return false;
+
+    QDataStream in(&mSpillFile);
+    Hunk hunk;
+    for(qint64 i = 0; i < mHunkCount; ++i)
+    {
+        in >> hunk.line1 >> hunk.line2 >> hunk.count1 >> hunk.count2;
+        if(in.status() != QDataStream::Ok)
+            return false;
+        if(!callback(hunk))
+            break;
+    }
+
+    mSpillFile.seek(mSpillFile.size());
+    return true;
+}
@@ -0,0 +1,83 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef STREAMINGDIFF_H
+#define STREAMINGDIFF_H
+
+#include "LineRef.h"
+
+#include <functional>
+
+#include <QSharedPointer>
+#include <QString>
+#include <QTemporaryFile>
+
+class Options;
+class QTextCodec;
+
+/*
+    Line comparison of two files that are too large to be loaded as a whole.
+
+    Both files are read in windows of a fixed number of lines. Every pair of windows is diffed with
+    the histogram engine and everything up to the last run of matching lines is committed. The
+    lines after that run are carried over into the next window, so a change spanning a window
+    boundary is still found as one section. Only the differing sections are kept, and those are
+    spilled to a temporary file. Memory use therefore depends on the window size, not the file size.
+*/
+class StreamingDiff
+{
+  public:
+    // A differing section. A count of zero means the lines were only inserted on the other side.
+    struct Hunk
+    {
+        qint64 line1 = 0;
+        qint64 line2 = 0;
+        qint64 count1 = 0;
+        qint64 count2 = 0;
+    };
+
+    explicit StreamingDiff(const QSharedPointer<Options>& pOptions, const LineType windowLines = 50000);
+
+    // Returns false if a file could not be read or the user cancelled, see errorString().
+    bool run(const QString& fileName1, const QString& fileName2, QTextCodec* pCodec);
+
+    // Calls callback for every differing section in file order until it returns false.
+    bool forEachHunk(const std::function<bool(const Hunk&)>& callback);
+
+    [[nodiscard]] inline qint64 lineCount1() const { return mLineCount1; }
+    [[nodiscard]] inline qint64 lineCount2() const { return mLineCount2; }
+    [[nodiscard]] inline qint64 hunkCount() const { return mHunkCount; }
+    [[nodiscard]] inline qint64 differingLines1() const { return mDifferingLines1; }
+    [[nodiscard]] inline qint64 differingLines2() const { return mDifferingLines2; }
+    [[nodiscard]] inline bool isEqual() const { return mHunkCount == 0; }
+
+    [[nodiscard]] inline const QString& errorString() const { return mErrorString; }
+
+  private:
+    void addHunk(const Hunk& hunk);
+    void writeHunk(const Hunk& hunk);
+
+    QSharedPointer<Options> mOptions;
+    LineType mWindowLines;
+
+    QTemporaryFile mSpillFile;
+    Hunk mPendingHunk;
+    bool mHasPendingHunk = false;
+
+    qint64 mLineCount1 = 0;
+    qint64 mLineCount2 = 0;
+    qint64 mHunkCount = 0;
+    qint64 mDifferingLines1 = 0;
+    qint64 mDifferingLines2 = 0;
+
+    QString mErrorString;
+};
+
+#endif
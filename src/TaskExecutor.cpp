@@ -0,0 +1,82 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "TaskExecutor.h"
+
+#include <algorithm>
+
+#include <QDeadlineTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+void TaskGroup::cancel()
+{
+    QMutexLocker locker(&mMutex);
+    ++mGeneration;
+}
+
+bool TaskGroup::wait(const int msecs)
+{
+    const QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer::Forever : msecs);
+    QMutexLocker locker(&mMutex);
+    while(mPending > 0)
+    {
+        if(!mIdle.wait(&mMutex, deadline))
+            return mPending == 0;
+    }
+    return true;
+}
+
+TaskExecutor::TaskExecutor()
+{
+    setMaxThreadCount(0);
+}
+
+TaskExecutor& TaskExecutor::instance()
+{
+    static TaskExecutor executor;
+    return executor;
+}
+
+void TaskExecutor::start(const std::function<void()>& task, const Priority priority, const std::shared_ptr<TaskGroup>& pGroup)
+{
+    if(pGroup == nullptr)
+    {
+        mPool.start(QRunnable::create(task), (int)priority);
+        return;
+    }
+
+    quint64 generation = 0;
+    {
+        QMutexLocker locker(&pGroup->mMutex);
+        ++pGroup->mPending;
+        generation = pGroup->mGeneration;
+    }
+
+    mPool.start(QRunnable::create([task, pGroup, generation]() {
+        bool bCancelled = false;
+        {
+            QMutexLocker locker(&pGroup->mMutex);
+            bCancelled = pGroup->mGeneration != generation;
+        }
+        if(!bCancelled)
+            task();
+
+        QMutexLocker locker(&pGroup->mMutex);
+        if(--pGroup->mPending == 0)
+            pGroup->mIdle.wakeAll();
+    }),
+                (int)priority);
+}
+
+void TaskExecutor::setMaxThreadCount(const int threads)
+{
+    mPool.setMaxThreadCount(threads > 0 ? threads : std::max(QThread::idealThreadCount(), 1));
+}
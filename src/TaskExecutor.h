@@ -0,0 +1,71 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef TASKEXECUTOR_H
+#define TASKEXECUTOR_H
+
+#include <functional>
+#include <memory>
+
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/*
+    Tasks of one owner that can be dropped together. cancel() skips the tasks that haven't
+    started yet, running ones finish. A group can be used again after cancel().
+*/
+class TaskGroup
+{
+  public:
+    void cancel();
+    // Blocks until no task of the group is queued or running. False if msecs passed before that.
+    bool wait(const int msecs = -1);
+
+  private:
+    friend class TaskExecutor;
+
+    QMutex mMutex;
+    QWaitCondition mIdle;
+    qint64 mPending = 0;
+    quint64 mGeneration = 0; // Counts the calls of cancel().
+};
+
+/*
+    The worker threads doing the CPU work of all parts of the program. A queued task with a higher
+    priority starts before one with a lower priority, so reading ahead never delays the diff of the
+    files being shown. Tasks don't wait for each other, work split over several tasks is claimed by
+    whoever gets to it first, the caller included. Only threads mostly waiting for disks or the
+    network have pools of their own.
+*/
+class TaskExecutor
+{
+  public:
+    enum class Priority
+    {
+        background = 0, // Reading ahead and refining results already shown.
+        visible = 1,    // Rows of the folder tree.
+        interactive = 2 // The diff being waited for, the viewport.
+    };
+
+    static TaskExecutor& instance();
+
+    void start(const std::function<void()>& task, const Priority priority, const std::shared_ptr<TaskGroup>& pGroup = nullptr);
+
+    [[nodiscard]] int maxThreadCount() const { return mPool.maxThreadCount(); }
+    // 0 uses one thread per core. Set with --cs "WorkerThreads=n".
+    void setMaxThreadCount(const int threads);
+
+  private:
+    TaskExecutor();
+
+    QThreadPool mPool;
+};
+
+#endif
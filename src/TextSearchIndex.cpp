@@ -0,0 +1,79 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "TextSearchIndex.h"
+
+#include "diff.h"
+
+
+const std::vector<TextSearchIndex::Hit>& TextSearchIndex::hits(const LineDataVector& lines, const QString& s, bool bCaseSensitive)
+{
+    if(mbValid && mbCaseSensitive == bCaseSensitive && mSearchString == s)
+        return mHits;
+
+    mHits.clear();
+    mSearchString = s;
+    mbCaseSensitive = bCaseSensitive;
+    mbValid = true;
+
+    if(s.isEmpty() || lines.empty())
+        return mHits;
+
+    const Qt::CaseSensitivity cs = bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QString* pBuffer = lines.front().getBuffer();
+    bool bContiguous = pBuffer != nullptr;
+    for(size_t i = 1; bContiguous && i < lines.size(); ++i)
+        bContiguous = lines[i].getBuffer() == pBuffer && lines[i].getOffset() >= lines[i - 1].getOffset() + lines[i - 1].size();
+
+    if(bContiguous)
+        searchBuffer(lines, cs);
+    else
+        searchLines(lines, cs);
+
+    return mHits;
+}
+
+void TextSearchIndex::clear()
+{
+    mbValid = false;
+    mSearchString.clear();
+    mHits.clear();
+    mHits.shrink_to_fit();
+}
+
+void TextSearchIndex::searchBuffer(const LineDataVector& lines, Qt::CaseSensitivity cs)
+{
+    const QString& buffer = *lines.front().getBuffer();
+    const QtSizeType end = lines.back().getOffset() + lines.back().size();
+    const QtSizeType length = mSearchString.length();
+
+    LineDataVector::const_iterator lineIt = lines.cbegin();
+    QtSizeType pos = buffer.indexOf(mSearchString, lines.front().getOffset(), cs);
+    while(pos >= 0 && pos + length <= end)
+    {
+        // Hits come in order, so the line only ever moves forward.
+        while(lineIt->getOffset() + lineIt->size() < pos + length)
+            ++lineIt;
+
+        if(pos >= lineIt->getOffset())
+            mHits.push_back({(LineType)(lineIt - lines.cbegin()), pos - lineIt->getOffset()});
+
+        pos = buffer.indexOf(mSearchString, pos + 1, cs);
+    }
+}
+
+void TextSearchIndex::searchLines(const LineDataVector& lines, Qt::CaseSensitivity cs)
+{
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        const QString line = lines[i].getLine();
+        for(QtSizeType pos = line.indexOf(mSearchString, 0, cs); pos >= 0; pos = line.indexOf(mSearchString, pos + 1, cs))
+            mHits.push_back({(LineType)i, pos});
+    }
+}
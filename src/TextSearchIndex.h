@@ -0,0 +1,53 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef TEXTSEARCHINDEX_H
+#define TEXTSEARCHINDEX_H
+
+#include "LineRef.h"
+#include "TypeUtils.h"
+
+#include <vector>
+
+#include <QString>
+
+class LineDataVector;
+
+/*
+    Finds every occurrence of a string in the lines of one input.
+
+    The lines are views into a single unicode buffer, so that buffer is searched in one go instead
+    of line by line. The hits are kept until a different string is searched or clear() is called,
+    so repeated "find next" only has to look up the next hit. clear() must be called whenever the
+    lines change.
+*/
+class TextSearchIndex
+{
+  public:
+    struct Hit
+    {
+        LineType line; // Index into the LineDataVector.
+        QtSizeType pos;
+    };
+
+    // Hits sorted by line and position. Matches may overlap, but never span a line end.
+    [[nodiscard]] const std::vector<Hit>& hits(const LineDataVector& lines, const QString& s, bool bCaseSensitive);
+    void clear();
+
+  private:
+    void searchBuffer(const LineDataVector& lines, Qt::CaseSensitivity cs);
+    void searchLines(const LineDataVector& lines, Qt::CaseSensitivity cs);
+
+    QString mSearchString;
+    bool mbCaseSensitive = true;
+    bool mbValid = false;
+    std::vector<Hit> mHits;
+};
+
+#endif
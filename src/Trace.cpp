@@ -0,0 +1,161 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+
+namespace {
+// Enough for a large directory merge, beyond that only the totals are kept.
+constexpr size_t maxEvents = 1000000;
+
+// Small numbers read better in the trace viewers than native thread handles.
+int currentThreadId()
+{
+    static std::atomic<int> nextId{1};
+    thread_local const int id = nextId.fetch_add(1);
+    return id;
+}
+} // namespace
+
+Trace::Trace()
+{
+    mClock.start();
+    mFileName = qEnvironmentVariable("KDIFF3_TRACE");
+    mbRecording = !mFileName.isEmpty();
+}
+
+Trace::~Trace()
+{
+    if(mbRecording)
+        write(mFileName);
+}
+
+Trace& Trace::instance()
+{
+    static Trace trace;
+    return trace;
+}
+
+const char* Trace::stageName(const TraceStage stage)
+{
+    switch(stage)
+    {
+        case TraceStage::read:
+            return "read";
+        case TraceStage::decode:
+            return "decode";
+        case TraceStage::preprocess:
+            return "preprocess";
+        case TraceStage::hash:
+            return "hash";
+        case TraceStage::diff:
+            return "diff";
+        case TraceStage::align:
+            return "align";
+        case TraceStage::fineDiff:
+            return "fineDiff";
+        case TraceStage::wordWrap:
+            return "wordWrap";
+        case TraceStage::paint:
+            return "paint";
+        case TraceStage::directoryList:
+            return "directoryList";
+        case TraceStage::compare:
+            return "compare";
+    }
+    return "";
+}
+
+void Trace::add(const TraceStage stage, const qint64 beginNsecs, const qint64 nsecs, const qint64 items)
+{
+    AtomicTotals& totals = mTotals[(size_t)stage];
+    totals.calls.fetch_add(1, std::memory_order_relaxed);
+    totals.nsecs.fetch_add(nsecs, std::memory_order_relaxed);
+    totals.items.fetch_add(items, std::memory_order_relaxed);
+
+    if(!mbRecording)
+        return;
+
+    const int threadId = currentThreadId();
+    QMutexLocker locker(&mMutex);
+    if(mEvents.size() < maxEvents)
+        mEvents.push_back({stage, threadId, beginNsecs, nsecs, items});
+    else
+        ++mDroppedEvents;
+}
+
+Trace::Totals Trace::totals(const TraceStage stage) const
+{
+    const AtomicTotals& totals = mTotals[(size_t)stage];
+    Totals result;
+    result.calls = totals.calls.load(std::memory_order_relaxed);
+    result.nsecs = totals.nsecs.load(std::memory_order_relaxed);
+    result.items = totals.items.load(std::memory_order_relaxed);
+    return result;
+}
+
+QByteArray Trace::toJson() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    qint64 droppedEvents = 0;
+    {
+        QMutexLocker locker(&mMutex);
+        droppedEvents = mDroppedEvents;
+        for(const Event& event: mEvents)
+        {
+            QJsonObject args;
+            args["items"] = event.items;
+
+            // Complete events, timestamps are in microseconds.
+            QJsonObject entry;
+            entry["name"] = QString::fromLatin1(stageName(event.stage));
+            entry["ph"] = QStringLiteral("X");
+            entry["ts"] = (double)event.beginNsecs / 1000;
+            entry["dur"] = (double)event.nsecs / 1000;
+            entry["pid"] = pid;
+            entry["tid"] = event.threadId;
+            entry["args"] = args;
+            events.append(entry);
+        }
+    }
+
+    QJsonObject stages;
+    for(size_t i = 0; i < stageCount; ++i)
+    {
+        const Totals stageTotals = totals((TraceStage)i);
+        QJsonObject entry;
+        entry["calls"] = stageTotals.calls;
+        entry["nsecs"] = stageTotals.nsecs;
+        entry["items"] = stageTotals.items;
+        stages[QString::fromLatin1(stageName((TraceStage)i))] = entry;
+    }
+
+    QJsonObject otherData;
+    otherData["stages"] = stages;
+    otherData["droppedEvents"] = droppedEvents;
+
+    QJsonObject result;
+    result["traceEvents"] = events;
+    result["displayTimeUnit"] = QStringLiteral("ms");
+    result["otherData"] = otherData;
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+bool Trace::write(const QString& fileName) const
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(toJson()) >= 0;
+}
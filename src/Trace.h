@@ -0,0 +1,126 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+enum class TraceStage
+{
+    read,
+    decode,
+    preprocess,
+    hash,
+    diff,
+    align,
+    fineDiff,
+    wordWrap,
+    paint,
+    directoryList,
+    compare
+};
+
+/*
+    Time spent in the stages of loading, comparing and showing files.
+
+    Every TraceScope adds its duration and item count to the totals of its stage. If the
+    environment variable KDIFF3_TRACE names a file, each scope is also kept as an event and
+    written to that file in the Chrome trace event format when kdiff3 quits, which
+    chrome://tracing and ui.perfetto.dev can open. Scopes may be used from any thread.
+*/
+class Trace
+{
+  public:
+    static constexpr size_t stageCount = (size_t)TraceStage::compare + 1;
+
+    struct Totals
+    {
+        qint64 calls = 0;
+        qint64 nsecs = 0;
+        qint64 items = 0; // Bytes, lines or files, depending on the stage.
+    };
+
+    static Trace& instance();
+
+    [[nodiscard]] static const char* stageName(const TraceStage stage);
+    [[nodiscard]] bool isRecording() const { return mbRecording; }
+
+    // Nanoseconds since the trace was started, the time base of all events.
+    [[nodiscard]] qint64 now() const { return mClock.nsecsElapsed(); }
+    void add(const TraceStage stage, const qint64 beginNsecs, const qint64 nsecs, const qint64 items);
+
+    [[nodiscard]] Totals totals(const TraceStage stage) const;
+    [[nodiscard]] QByteArray toJson() const;
+    bool write(const QString& fileName) const;
+
+  private:
+    struct Event
+    {
+        TraceStage stage;
+        int threadId;
+        qint64 beginNsecs;
+        qint64 nsecs;
+        qint64 items;
+    };
+
+    struct AtomicTotals
+    {
+        std::atomic<qint64> calls{0};
+        std::atomic<qint64> nsecs{0};
+        std::atomic<qint64> items{0};
+    };
+
+    Trace();
+    ~Trace();
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    QElapsedTimer mClock;
+    std::array<AtomicTotals, stageCount> mTotals;
+
+    QString mFileName;
+    bool mbRecording = false;
+    mutable QMutex mMutex; // Guards the events.
+    std::vector<Event> mEvents;
+    qint64 mDroppedEvents = 0;
+};
+
+/*
+    Adds the time from construction to destruction to a stage.
+
+        TraceScope scope(TraceStage::diff);
+*/
+class TraceScope
+{
+  public:
+    explicit TraceScope(const TraceStage stage):
+        mStage(stage), mBegin(Trace::instance().now()) {}
+    ~TraceScope() { Trace::instance().add(mStage, mBegin, Trace::instance().now() - mBegin, mItems); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    // Number of bytes, lines or files handled, becomes an argument of the event.
+    void setItems(const qint64 items) { mItems = items; }
+
+  private:
+    TraceStage mStage;
+    qint64 mBegin;
+    qint64 mItems = 0;
+};
+
+#endif
@@ -15,7 +15,6 @@
 
 #include <QString>
 #include <QStringList>
-#include <QHash>
 #include <QRegularExpression>
 
 /* Split the command line into arguments.
@@ -94,28 +93,6 @@ QString Utils::getArguments(QString cmd, QString& program, QStringList& args)
     return QString();
 }
 
-bool Utils::wildcardMultiMatch(const QString& wildcard, const QString& testString, bool bCaseSensitive)
-{
-    static QHash<QString, QRegularExpression> s_patternMap;
-
-    const QStringList regExpList = wildcard.split(QChar(';'));
-
-    for(const QString& regExp : regExpList)
-    {
-        QHash<QString, QRegularExpression>::iterator patIt = s_patternMap.find(regExp);
-        if(patIt == s_patternMap.end())
-        {
-            QRegularExpression pattern(QRegularExpression::wildcardToRegularExpression(regExp), bCaseSensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
-            patIt = s_patternMap.insert(regExp, pattern);
-        }
-
-        if(patIt.value().match(testString).hasMatch())
-            return true;
-    }
-
-    return false;
-}
-
 //TODO: Only used by calcTokenPos.
 bool Utils::isCTokenChar(QChar c)
 {
@@ -25,7 +25,6 @@ class Utils{
         If QUrl::isLocal however it returns false we get an empty string back.
       */
       static QString urlToString(const QUrl &url);
-      static bool wildcardMultiMatch(const QString& wildcard, const QString& testString, bool bCaseSensitive);
       static QString getArguments(QString cmd, QString& program, QStringList& args);
       inline static bool isEndOfLine(QChar c) { return c == '\n'; } //interally all line endings are converted to '\n'
 
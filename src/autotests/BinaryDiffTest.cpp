@@ -0,0 +1,120 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QTest>
+#include <QtGlobal>
+
+#include "../BinaryDiff.h"
+
+#include <cstring>
+#include <vector>
+
+class BinaryDiffTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static QByteArray randomBytes(const int size, const quint32 seed)
+    {
+        QRandomGenerator random(seed);
+        QByteArray data(size, '\0');
+        for(int i = 0; i < size; ++i)
+            data[i] = (char)random.bounded(256);
+        return data;
+    }
+
+    // The blocks must cover both inputs in order and equal blocks must really be equal.
+    static bool covers(const BinaryDiff& diff, const QByteArray& data1, const QByteArray& data2)
+    {
+        qint64 offset1 = 0, offset2 = 0;
+        for(const BinaryDiff::Block& block: diff.blocks())
+        {
+            if(block.offset1 != offset1 || block.offset2 != offset2)
+                return false;
+            if(block.bEqual && (block.size1 != block.size2 || memcmp(data1.constData() + offset1, data2.constData() + offset2, (size_t)block.size1) != 0))
+                return false;
+            offset1 += block.size1;
+            offset2 += block.size2;
+        }
+        return offset1 == data1.size() && offset2 == data2.size();
+    }
+
+    static bool run(BinaryDiff& diff, const QByteArray& data1, const QByteArray& data2)
+    {
+        return diff.run(data1.constData(), data1.size(), data2.constData(), data2.size());
+    }
+
+  private Q_SLOTS:
+    void equalInputs()
+    {
+        const QByteArray data = randomBytes(10000, 1);
+        BinaryDiff diff;
+        QVERIFY(run(diff, data, data));
+        QVERIFY(diff.isEqual());
+        QCOMPARE(diff.blocks().size(), size_t(1));
+        QVERIFY(covers(diff, data, data));
+
+        BinaryDiff emptyDiff;
+        QVERIFY(run(emptyDiff, QByteArray(), QByteArray()));
+        QVERIFY(emptyDiff.isEqual());
+        QVERIFY(emptyDiff.blocks().empty());
+    }
+
+    void insertion()
+    {
+        const QByteArray data1 = randomBytes(100000, 2);
+        QByteArray data2 = data1;
+        data2.insert(50000, QByteArray("inserted"));
+
+        BinaryDiff diff;
+        QVERIFY(run(diff, data1, data2));
+        QVERIFY(covers(diff, data1, data2));
+        QCOMPARE(diff.differingBytes1(), qint64(0));
+        QCOMPARE(diff.differingBytes2(), qint64(8));
+    }
+
+    // Changes away from the ends need the rolling hash to find the equal run between them.
+    void changesInTheMiddle()
+    {
+        const QByteArray data1 = randomBytes(200000, 3);
+        QByteArray data2 = data1;
+        data2.replace(1000, 100, randomBytes(300, 4));
+        data2.remove(150000, 5000);
+
+        BinaryDiff diff;
+        QVERIFY(run(diff, data1, data2));
+        QVERIFY(covers(diff, data1, data2));
+        QVERIFY(diff.differingBytes1() <= 100 + 5000);
+        QVERIFY(diff.differingBytes2() <= 300);
+
+        std::vector<BinaryDiff::Block> equalBlocks;
+        for(const BinaryDiff::Block& block: diff.blocks())
+        {
+            if(block.bEqual)
+                equalBlocks.push_back(block);
+        }
+        QCOMPARE(equalBlocks.size(), size_t(3));
+    }
+
+    void unrelatedInputs()
+    {
+        const QByteArray data1 = randomBytes(5000, 5);
+        const QByteArray data2 = randomBytes(7000, 6);
+
+        BinaryDiff diff;
+        QVERIFY(run(diff, data1, data2));
+        QVERIFY(covers(diff, data1, data2));
+        QVERIFY(!diff.isEqual());
+    }
+};
+
+QTEST_MAIN(BinaryDiffTest);
+
+#include "BinaryDiffTest.moc"
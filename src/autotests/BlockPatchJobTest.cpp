@@ -0,0 +1,49 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../BlockPatchJob.h"
+
+#include <QByteArray>
+#include <QTest>
+
+class BlockPatchJobTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void equalDataHasNoRanges()
+    {
+        const QByteArray data(3 * BlockPatchJob::blockSize + 17, 'a');
+        QVERIFY(BlockPatchJob::differingBlocks(data.constData(), data.constData(), data.size()).empty());
+    }
+
+    void findsChangedBlocks()
+    {
+        const qint64 blockSize = BlockPatchJob::blockSize;
+        const QByteArray source(5 * blockSize + 100, 'a');
+        QByteArray dest = source;
+        // One byte in the first block, two neighbouring blocks and the short last one.
+        dest[10] = 'b';
+        dest[(int)(2 * blockSize + 5)] = 'b';
+        dest[(int)(3 * blockSize + 5)] = 'b';
+        dest[(int)(5 * blockSize + 99)] = 'b';
+
+        const std::vector<BlockPatchJob::Range> ranges = BlockPatchJob::differingBlocks(source.constData(), dest.constData(), source.size());
+        QCOMPARE(ranges.size(), (size_t)3);
+        QCOMPARE(ranges[0].offset, (qint64)0);
+        QCOMPARE(ranges[0].size, blockSize);
+        QCOMPARE(ranges[1].offset, 2 * blockSize);
+        QCOMPARE(ranges[1].size, 2 * blockSize);
+        QCOMPARE(ranges[2].offset, 5 * blockSize);
+        QCOMPARE(ranges[2].size, (qint64)100);
+    }
+};
+
+QTEST_MAIN(BlockPatchJobTest);
+
+#include "BlockPatchJobTest.moc"
@@ -0,0 +1,100 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../CompressedInput.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class CompressedInputTest: public QObject
+{
+    Q_OBJECT
+  private:
+    QTemporaryDir mDir;
+
+    static QByteArray compress(const QByteArray& content, const KCompressionDevice::CompressionType type)
+    {
+        QByteArray result;
+        {
+            QBuffer* pBuffer = new QBuffer(&result);
+            KCompressionDevice device(pBuffer, true, type);
+            if(!device.open(QIODevice::WriteOnly) || device.write(content) != content.size())
+                return QByteArray();
+        }
+        return result;
+    }
+
+    QString writeFile(const QString& name, const QByteArray& content)
+    {
+        const QString fileName = mDir.filePath(name);
+        QFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly) || file.write(content) != content.size())
+            return QString();
+        return fileName;
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+    }
+
+    void type()
+    {
+        const QByteArray gzip = compress("text\n", KCompressionDevice::GZip);
+        QVERIFY(!gzip.isEmpty());
+        QCOMPARE(CompressedInput::type(QStringLiteral("a.txt.gz"), gzip.constData(), gzip.size()), KCompressionDevice::GZip);
+        // Neither a name nor magic bytes are enough on their own.
+        QCOMPARE(CompressedInput::type(QStringLiteral("a.txt"), gzip.constData(), gzip.size()), KCompressionDevice::None);
+        QCOMPARE(CompressedInput::type(QStringLiteral("a.txt.gz"), "text\n", 5), KCompressionDevice::None);
+        QCOMPARE(CompressedInput::type(QStringLiteral("a.bz2"), "BZ", 2), KCompressionDevice::None);
+    }
+
+    void decompress()
+    {
+        QByteArray content;
+        for(int i = 0; i < 100000; ++i)
+            content += "line " + QByteArray::number(i) + '\n';
+
+        const QByteArray gzip = compress(content, KCompressionDevice::GZip);
+        QByteArray out;
+        QString errorString;
+        QVERIFY(CompressedInput::decompress(gzip.constData(), gzip.size(), KCompressionDevice::GZip, out, errorString));
+        QCOMPARE(out, content);
+
+        // Cut short.
+        QVERIFY(!CompressedInput::decompress(gzip.constData(), gzip.size() / 2, KCompressionDevice::GZip, out, errorString));
+        QVERIFY(!errorString.isEmpty());
+    }
+
+    void isEqual()
+    {
+        const QByteArray content = QByteArray(3 * 1024 * 1024, 'x') + "end\n";
+        const QString gzipName = writeFile(QStringLiteral("a.gz"), compress(content, KCompressionDevice::GZip));
+        const QString bzip2Name = writeFile(QStringLiteral("b.bz2"), compress(content, KCompressionDevice::BZip2));
+        const QString otherName = writeFile(QStringLiteral("c.gz"), compress(content + "more\n", KCompressionDevice::GZip));
+        QVERIFY(!gzipName.isEmpty() && !bzip2Name.isEmpty() && !otherName.isEmpty());
+
+        bool bEqual = false;
+        QString errorString;
+        QVERIFY(CompressedInput::isEqual(gzipName, bzip2Name, bEqual, errorString));
+        QVERIFY(bEqual);
+        QVERIFY(CompressedInput::isEqual(gzipName, otherName, bEqual, errorString));
+        QVERIFY(!bEqual);
+
+        const QString plainName = writeFile(QStringLiteral("d.gz"), content);
+        QVERIFY(!CompressedInput::isEqual(gzipName, plainName, bEqual, errorString));
+    }
+};
+
+QTEST_GUILESS_MAIN(CompressedInputTest);
+
+#include "CompressedInputTest.moc"
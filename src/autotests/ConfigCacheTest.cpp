@@ -0,0 +1,103 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../ConfigCache.h"
+
+#include <QColor>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+class ConfigCacheTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void readThroughCache()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString cacheFile = dir.filePath(QStringLiteral("cache"));
+
+        KSharedConfigPtr config = KSharedConfig::openConfig(dir.filePath(QStringLiteral("testrc")), KConfig::SimpleConfig);
+        KConfigGroup group = config->group(QStringLiteral("Options"));
+        group.writeEntry("Number", 5);
+        group.writeEntry("List", QStringList({QStringLiteral("a"), QStringLiteral("b;c")}));
+        group.writeEntry("Color", QColor(1, 2, 3));
+        QVERIFY(config->sync());
+
+        {
+            ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+            QCOMPARE(cache.readEntry(QStringLiteral("Number"), 0), 5);
+            QCOMPARE(cache.readEntry(QStringLiteral("List"), QStringList()), QStringList({QStringLiteral("a"), QStringLiteral("b;c")}));
+            QCOMPARE(cache.readEntry(QStringLiteral("Missing"), 7), 7);
+            QVERIFY(cache.save());
+        }
+        QVERIFY(QFile::exists(cacheFile));
+
+        // Not synced, so the cache still matches the file and its values are used.
+        group.writeEntry("Number", 12345);
+        {
+            ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+            QCOMPARE(cache.readEntry(QStringLiteral("Number"), 0), 5);
+            QCOMPARE(cache.readEntry(QStringLiteral("Missing"), 8), 8);
+            // Unknown names are taken from the config.
+            QCOMPARE(cache.readEntry(QStringLiteral("Color"), QColor()), QColor(1, 2, 3));
+        }
+
+        QVERIFY(config->sync());
+        ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+        QCOMPARE(cache.readEntry(QStringLiteral("Number"), 0), 12345);
+    }
+
+    void writtenValues()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString cacheFile = dir.filePath(QStringLiteral("cache"));
+
+        KSharedConfigPtr config = KSharedConfig::openConfig(dir.filePath(QStringLiteral("testrc")), KConfig::SimpleConfig);
+        {
+            ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+            cache.writeEntry(QStringLiteral("Flag"), true);
+            cache.writeEntry(QStringLiteral("Name"), "UTF-8");
+            QVERIFY(cache.save());
+        }
+
+        ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+        QCOMPARE(cache.readEntry(QStringLiteral("Flag"), false), true);
+        QCOMPARE(cache.readEntry(QStringLiteral("Name"), "latin1"), QStringLiteral("UTF-8"));
+    }
+
+    void damagedFile()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString cacheFile = dir.filePath(QStringLiteral("cache"));
+
+        QFile file(cacheFile);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a cache");
+        file.close();
+
+        KSharedConfigPtr config = KSharedConfig::openConfig(dir.filePath(QStringLiteral("testrc")), KConfig::SimpleConfig);
+        config->group(QStringLiteral("Options")).writeEntry("Number", 3);
+        QVERIFY(config->sync());
+
+        ConfigCache cache(config, QStringLiteral("Options"), cacheFile);
+        QCOMPARE(cache.readEntry(QStringLiteral("Number"), 0), 3);
+    }
+};
+
+QTEST_GUILESS_MAIN(ConfigCacheTest);
+
+#include "ConfigCacheTest.moc"
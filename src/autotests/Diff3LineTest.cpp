@@ -13,6 +13,8 @@
 #include <QTest>
 #include <QObject>
 
+Q_DECLARE_METATYPE(DiffList);
+
 class Diff3LineTest: public QObject
 {
     Q_OBJECT;
@@ -78,6 +80,32 @@ class Diff3LineTest: public QObject
         QVERIFY(!entry->isEqualBC());
         ++entry;
     }
+
+    void calcDiffUsingABAndACTest_data()
+    {
+        QTest::addColumn<DiffList>("diffListAB");
+        QTest::addColumn<DiffList>("diffListAC");
+
+        QTest::newRow("Changes in B and C") << DiffList({{0, 1, 1}, {3, 0, 0}}) << DiffList({{2, 0, 1}, {1, 1, 0}});
+        QTest::newRow("Changed runs of different length") << DiffList({{1, 2, 0}, {1, 0, 3}}) << DiffList({{0, 1, 2}, {3, 0, 0}});
+        QTest::newRow("Lines added at the end") << DiffList({{2, 0, 0}}) << DiffList({{2, 0, 2}});
+        QTest::newRow("Nothing in common") << DiffList({{0, 3, 1}}) << DiffList({{0, 3, 2}});
+    }
+
+    void calcDiffUsingABAndACTest()
+    {
+        QFETCH(DiffList, diffListAB);
+        QFETCH(DiffList, diffListAC);
+
+        Diff3LineList expected;
+        expected.calcDiff3LineListUsingAB(&diffListAB);
+        expected.calcDiff3LineListUsingAC(&diffListAC);
+
+        Diff3LineList diff3List;
+        diff3List.calcDiff3LineListUsingABAndAC(&diffListAB, &diffListAC);
+
+        QVERIFY(diff3List == expected);
+    }
 };
 
 QTEST_MAIN(Diff3LineTest);
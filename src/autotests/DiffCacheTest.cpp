@@ -0,0 +1,102 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../DiffCache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class DiffCacheTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static LineDataVector makeLines(const QString& text)
+    {
+        QSharedPointer<QString> buffer = QSharedPointer<QString>::create(text);
+        LineDataVector lines;
+        lines.setBuffer(buffer);
+
+        QtSizeType offset = 0;
+        for(const QString& line: text.split('\n'))
+        {
+            lines.push_back(LineData(buffer, offset, line.length()));
+            offset += line.length() + 1;
+        }
+        return lines;
+    }
+
+  private Q_SLOTS:
+    void testStoredAcrossInstances()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        const LineDataVector v1 = makeLines("a\nb\nc");
+        const LineDataVector v2 = makeLines("a\nx\nc\nd");
+        const DiffSettings settings;
+        const QByteArray key = DiffCache::key(v1, 3, v2, 4, settings);
+
+        DiffList diffList;
+        diffList.push_back(Diff(1, 1, 1));
+        diffList.push_back(Diff(1, 0, 1));
+        {
+            DiffCache cache(dir.filePath("diffs"));
+            DiffList found;
+            QVERIFY(!cache.find(key, 3, 4, found));
+            cache.insert(key, diffList);
+        }
+
+        DiffCache cache(dir.filePath("diffs"));
+        DiffList found;
+        QVERIFY(cache.find(key, 3, 4, found));
+        QVERIFY(found == diffList);
+
+        // A result that doesn't fit the inputs is never returned.
+        QVERIFY(!cache.find(key, 3, 5, found));
+    }
+
+    void testKey()
+    {
+        const LineDataVector v1 = makeLines("a\nb");
+        const LineDataVector v2 = makeLines("a\nc");
+        const LineDataVector v3 = makeLines("ab\n");
+        const DiffSettings settings;
+        const QByteArray key = DiffCache::key(v1, 2, v2, 2, settings);
+
+        QVERIFY(key == DiffCache::key(makeLines("a\nb"), 2, makeLines("a\nc"), 2, settings));
+        QVERIFY(key != DiffCache::key(v2, 2, v1, 2, settings));
+        QVERIFY(DiffCache::key(v1, 2, v2, 2, settings) != DiffCache::key(v3, 2, v2, 2, settings));
+
+        QVERIFY(key != DiffCache::key(v1, 2, v2, 2, settings.withLineDiffAlgorithm(LineDiffAlgorithm::histogram)));
+    }
+
+    void testDamagedEntry()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        const LineDataVector v = makeLines("a");
+        const QByteArray key = DiffCache::key(v, 1, v, 1, DiffSettings());
+        QVERIFY(QDir().mkpath(dir.filePath("diffs")));
+        QFile file(dir.filePath("diffs/" + QString::fromLatin1(key.toHex())));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a cache entry");
+        file.close();
+
+        DiffCache cache(dir.filePath("diffs"));
+        DiffList found;
+        QVERIFY(!cache.find(key, 1, 1, found));
+    }
+};
+
+QTEST_MAIN(DiffCacheTest);
+
+#include "DiffCacheTest.moc"
@@ -10,11 +10,15 @@
 
 #include "../diff.h"
 #include "../fileaccess.h"
+#include "../MergeEditLine.h"
 
 #include "SourceDataMoc.h"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include <QRandomGenerator>
 #include <QTextCodec>
 #include <QString>
 #include <QTest>
@@ -159,7 +163,7 @@ class DiffTest: public QObject
         QVERIFY(simData2.hasData());
 
         manualDiffList.runDiff(simData.getLineDataForDiff(), simData.getSizeLines(), simData2.getLineDataForDiff(), simData2.getSizeLines(), diffList, e_SrcSelector::A, e_SrcSelector::B,
-                               simData.options());
+                               DiffSettings(*simData.options()));
         /*
             Verify DiffList generated by runDiff.
         */
@@ -181,6 +185,226 @@ class DiffTest: public QObject
         QVERIFY(diff3List == expectedDiff3);
     }
 
+    void testLineDiffEngines_data()
+    {
+        QTest::addColumn<int>("algorithm");
+
+        QTest::newRow("gnudiff") << (int)LineDiffAlgorithm::gnuDiff;
+        QTest::newRow("histogram") << (int)LineDiffAlgorithm::histogram;
+        QTest::newRow("patience") << (int)LineDiffAlgorithm::patience;
+    }
+
+    // All engines must agree on simple input and ignore white space the same way.
+    void testLineDiffEngines()
+    {
+        QFETCH(int, algorithm);
+        SourceDataMoc simData, simData2;
+        DiffList diffList, expectedDiffList;
+
+        simData.setData(u8"a\nb\nc\nd\ne\n");
+        simData2.setData(u8"a\nx\nc\n d\nq\ne\n");
+
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        DiffContext context(DiffSettings(*simData.options()).withLineDiffAlgorithm((LineDiffAlgorithm)algorithm));
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), context);
+
+        expectedDiffList = {{1, 1, 1}, {2, 0, 1}, {2, 0, 0}};
+        QVERIFY(expectedDiffList == diffList);
+    }
+
+    // Lines from a small set match in many places, so the split runs deep enough to go parallel.
+    void testParallelGnuDiff()
+    {
+        QRandomGenerator random(42);
+        QString text1, text2;
+        for(int i = 0; i < 20000; ++i)
+        {
+            const QString line = QString::number(random.bounded(50)) + '\n';
+            text1 += line;
+            const int choice = random.bounded(10);
+            if(choice == 0)
+                text2 += QString::number(random.bounded(50)) + '\n';
+            else if(choice > 1)
+                text2 += line;
+        }
+
+        SourceDataMoc simData, simData2;
+        simData.setData(text1);
+        simData2.setData(text2);
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        const DiffSettings settings = DiffSettings(*simData.options()).withLineDiffAlgorithm(LineDiffAlgorithm::gnuDiff);
+        DiffContext sequentialContext(settings.withParallelDiff(false));
+        DiffContext parallelContext(settings.withParallelDiff(true));
+        DiffList sequentialDiffList, parallelDiffList;
+        sequentialDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), sequentialContext);
+        parallelDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), parallelContext);
+
+        QVERIFY(sequentialDiffList.size() > 1);
+        QVERIFY(sequentialDiffList == parallelDiffList);
+    }
+
+    // An expired deadline still gives a result covering all lines, marked as approximate.
+    void testDeadlineDiff()
+    {
+        QRandomGenerator random(7);
+        QString text1, text2;
+        for(int i = 0; i < 5000; ++i)
+        {
+            text1 += QString::number(random.bounded(50)) + '\n';
+            text2 += QString::number(random.bounded(50)) + '\n';
+        }
+
+        SourceDataMoc simData, simData2;
+        simData.setData(text1);
+        simData2.setData(text2);
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        const DiffSettings settings = DiffSettings(*simData.options()).withLineDiffAlgorithm(LineDiffAlgorithm::gnuDiff);
+        DiffContext completeContext(settings);
+        DiffContext quickContext(settings.withDeadline(QDeadlineTimer(0)));
+        DiffList completeDiffList, quickDiffList;
+        completeDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), completeContext);
+        quickDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), quickContext);
+
+        QVERIFY(!completeContext.isApproximate());
+        QVERIFY(quickContext.isApproximate());
+
+        quint64 lines1 = 0, lines2 = 0;
+        for(const Diff& diff: quickDiffList)
+        {
+            lines1 += diff.numberOfEquals() + diff.diff1();
+            lines2 += diff.numberOfEquals() + diff.diff2();
+        }
+        QCOMPARE(lines1, (quint64)simData.getSizeLines());
+        QCOMPARE(lines2, (quint64)simData2.getSizeLines());
+    }
+
+    // Big enough to be cut into segments at the unique lines, the changes between them are sparse.
+    void testSegmentedDiff()
+    {
+        QString text1, text2;
+        for(int i = 0; i < 60000; ++i)
+        {
+            const QString line = QStringLiteral("line %1\n").arg(i);
+            text1 += line;
+            if(i % 997 == 0)
+                text2 += QStringLiteral("changed\n");
+            else
+                text2 += line;
+            if(i % 1499 == 0)
+                text2 += QStringLiteral("inserted\n");
+        }
+
+        SourceDataMoc simData, simData2;
+        simData.setData(text1);
+        simData2.setData(text2);
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        const DiffSettings settings = DiffSettings(*simData.options()).withLineDiffAlgorithm(LineDiffAlgorithm::gnuDiff);
+        DiffContext wholeContext(settings.withParallelDiff(false));
+        DiffContext segmentedContext(settings.withParallelDiff(true));
+        DiffList wholeDiffList, segmentedDiffList;
+        wholeDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), wholeContext);
+        segmentedDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), segmentedContext);
+
+        QVERIFY(wholeDiffList.size() > 1);
+        QVERIFY(wholeDiffList == segmentedDiffList);
+    }
+
+    void testContentEquality()
+    {
+        SourceDataMoc simData;
+
+        simData.setData(u8"a b\nc\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        // Only differs in white space, which line matching always ignores.
+        const QSharedPointer<SourceData> pData2 = QSharedPointer<SourceDataMoc>::create();
+        pData2->setData(u8"a b\nc\n");
+        pData2->setOptions(simData.options());
+        pData2->readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.isTextEqualWith(pData2));
+        QVERIFY(simData.isLineMatchEqualWith(pData2));
+
+        pData2->setData(u8"a  b\n\tc\n");
+        pData2->readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(!simData.isTextEqualWith(pData2));
+        QVERIFY(simData.isLineMatchEqualWith(pData2));
+
+        pData2->setData(u8"a b\nd\n");
+        pData2->readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(!simData.isTextEqualWith(pData2));
+        QVERIFY(!simData.isLineMatchEqualWith(pData2));
+    }
+
+    void testLineFingerprints()
+    {
+        SourceDataMoc simData;
+
+        simData.setData(u8"a b\na\tb\nabc\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        const std::shared_ptr<LineDataVector>& lineData = simData.getLineDataForDiff();
+        QVERIFY(lineData->size() >= 3);
+
+        QVERIFY(LineData::equal((*lineData)[0], (*lineData)[1]));
+        QVERIFY(!LineData::equal((*lineData)[0], (*lineData)[2]));
+        QVERIFY((*lineData)[0].rawEqual((*lineData)[0]));
+        QVERIFY(!(*lineData)[0].rawEqual((*lineData)[1]));
+    }
+
+    void testLineMatchFingerprints()
+    {
+        SourceDataMoc simData;
+
+        simData.setData(u8"a 1.5b\na -2 b\nab\nAb\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        const LineDataVector& lines = *simData.getLineDataForDiff();
+        QVERIFY(lines.size() >= 4);
+
+        QVERIFY(LineData::lineMatchEqual(lines[0], lines[1], true));
+        QCOMPARE(lines[0].lineMatchFingerprint(true), lines[1].lineMatchFingerprint(true));
+        QVERIFY(LineData::lineMatchEqual(lines[0], lines[2], true));
+        QVERIFY(!LineData::lineMatchEqual(lines[0], lines[1], false));
+        QVERIFY(!LineData::lineMatchEqual(lines[2], lines[3], true));
+
+        // Lines without fingerprints get the same value.
+        const LineData copy(simData.getTextBuffers().front(), lines[1].getOffset(), lines[1].size(), lines[1].getFirstNonWhiteChar());
+        QVERIFY(!copy.hasFingerprints());
+        QCOMPARE(copy.lineMatchFingerprint(true), lines[0].lineMatchFingerprint(true));
+        QCOMPARE(copy.lineMatchFingerprint(false), lines[1].lineMatchFingerprint(false));
+    }
+
+    void testLineWidth()
+    {
+        SourceDataMoc simData;
+
+        simData.setData(u8"a b\na\tb\nabc\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        const std::shared_ptr<LineDataVector>& lineData = simData.getLineDataForDiff();
+        QVERIFY(lineData->size() >= 3);
+
+        QCOMPARE((*lineData)[0].width(4), (int)(*lineData)[0].size());
+        QCOMPARE((*lineData)[1].width(4), (int)(*lineData)[1].size() + 2);
+        QCOMPARE((*lineData)[1].width(4), LineData::width((*lineData)[1].getLine(), 4));
+        // The tab stretches to the next stop after 'a'.
+        QCOMPARE(lineData->maxWidth(4), (int)(*lineData)[1].size() + 2);
+        QCOMPARE(lineData->maxWidth(8), (int)(*lineData)[1].size() + 6);
+        QCOMPARE(lineData->maxWidth(4), (int)(*lineData)[1].size() + 2);
+    }
+
     void testWhiteLineComment()
     {
         SourceDataMoc simData;
@@ -219,6 +443,186 @@ class DiffTest: public QObject
         QVERIFY(!(*lineData)[4].isSkipable());
    }
 
+    void testDiff3LineVectorWhiteLines()
+    {
+        SourceDataMoc simData, simData2;
+        simData.setData(u8"a\n\n// c\nd\n");
+        simData2.setData(u8"a\nx\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        DiffContext context(DiffSettings(*simData.options()));
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), context);
+
+        Diff3LineList separate;
+        separate.calcDiff3LineListUsingAB(&diffList);
+        Diff3LineList fused = separate;
+
+        Diff3LineVector separateVector, fusedVector;
+        separate.calcWhiteDiff3Lines(simData.getLineDataForDiff(), simData2.getLineDataForDiff(), nullptr, true);
+        separate.calcDiff3LineVector(separateVector);
+        fused.calcDiff3LineVector(fusedVector, simData.getLineDataForDiff(), simData2.getLineDataForDiff(), nullptr, true);
+
+        QCOMPARE(fusedVector.size(), separateVector.size());
+        QVERIFY(std::equal(fused.cbegin(), fused.cend(), separate.cbegin()));
+        for(QtSizeType i = 0; i < fusedVector.size(); ++i)
+            QCOMPARE(fusedVector[i], &*std::next(fused.begin(), i));
+        // The empty line and the comment are white, without C every row is.
+        QVERIFY(std::any_of(fused.cbegin(), fused.cend(), [](const Diff3Line& d3l) { return d3l.isWhiteLine(e_SrcSelector::A); }));
+        QVERIFY(std::all_of(fused.cbegin(), fused.cend(), [](const Diff3Line& d3l) { return d3l.isWhiteLine(e_SrcSelector::C); }));
+    }
+
+    void testConflictKinds()
+    {
+        SourceDataMoc simData, simData2;
+        simData.setData(u8"int a = 1;\nsame\n// old\nsame2\nfoo();\n");
+        simData2.setData(u8"int a = 22;\nsame\n// new\nsame2\nbar();\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        DiffContext context(DiffSettings(*simData.options()));
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), context);
+        Diff3LineList diff3LineList;
+        diff3LineList.calcDiff3LineListUsingAB(&diffList);
+        diff3LineList.calcWhiteDiff3Lines(simData.getLineDataForDiff(), simData2.getLineDataForDiff(), nullptr, false);
+
+        MergeBlockList mergeBlockList;
+        mergeBlockList.buildFromDiff3(diff3LineList, false, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay());
+        std::vector<e_ConflictKind> kinds;
+        for(const MergeBlock& mb: mergeBlockList.list())
+        {
+            if(mb.isConflict())
+                kinds.push_back(mb.conflictKind());
+        }
+        QCOMPARE(kinds, std::vector<e_ConflictKind>({e_ConflictKind::numbers, e_ConflictKind::comment, e_ConflictKind::text}));
+
+        // Without the lines only white space is told apart.
+        MergeBlockList plainList;
+        plainList.buildFromDiff3(diff3LineList, false);
+        for(const MergeBlock& mb: plainList.list())
+            QVERIFY(!mb.isConflict() || mb.conflictKind() == e_ConflictKind::text);
+
+        QCOMPARE(MergeBlock::combinedConflictKind(e_ConflictKind::whiteSpace, e_ConflictKind::comment), e_ConflictKind::comment);
+        QCOMPARE(MergeBlock::combinedConflictKind(e_ConflictKind::comment, e_ConflictKind::numbers), e_ConflictKind::text);
+    }
+
+    void testMyersFineDiff()
+    {
+        DiffList diffList, expectedDiffList;
+
+        diffList.calcMyersDiff("abcdef", "abXdef", 1000);
+        expectedDiffList = {{2, 1, 1}, {3, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+
+        diffList.calcMyersDiff("abc", "abc", 1000);
+        expectedDiffList = {{3, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+
+        diffList.calcMyersDiff("abc", "abcd", 1000);
+        expectedDiffList = {{3, 0, 1}};
+        QVERIFY(diffList == expectedDiffList);
+
+        // Too many edits, the changed middle is reported as one block.
+        diffList.calcMyersDiff("<abcdef>", "<ghijkl>", 4);
+        expectedDiffList = {{1, 6, 6}, {1, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+    }
+
+    void testFineDiffArena()
+    {
+        FineDiffArena arena;
+        const DiffList first = {{2, 1, 1}, {3, 0, 0}};
+        const DiffList second = {{0, 4, 2}};
+
+        const FineDiff fineDiff1 = arena.store(first);
+        const FineDiff fineDiff2 = arena.store(second);
+
+        QVERIFY(arena.store(DiffList()).isNull());
+        QVERIFY(fineDiff1 != fineDiff2);
+        QVERIFY(std::equal(fineDiff1.begin(), fineDiff1.end(), first.cbegin(), first.cend()));
+        QVERIFY(std::equal(fineDiff2.begin(), fineDiff2.end(), second.cbegin(), second.cend()));
+
+        // Longer than a block and after it the earlier runs must stay where they are.
+        DiffList longList;
+        for(int i = 0; i < 10000; ++i)
+            longList.push_back(Diff(1, 1, 0));
+        const FineDiff fineDiff3 = arena.store(longList);
+        QVERIFY(fineDiff3.size() == longList.size());
+        QVERIFY(std::equal(fineDiff3.begin(), fineDiff3.end(), longList.cbegin(), longList.cend()));
+        QVERIFY(std::equal(fineDiff1.begin(), fineDiff1.end(), first.cbegin(), first.cend()));
+    }
+
+    // Freed fine diffs are calculated again on first use and come out the same.
+    void testEvictFineDiffs()
+    {
+        SourceDataMoc simData, simData2;
+        simData.setData(u8"a\nbcd\n");
+        simData2.setData(u8"a\nbXd\n");
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        simData2.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        QVERIFY(simData.hasData() && simData2.hasData());
+
+        DiffContext context(DiffSettings(*simData.options()));
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.getSizeLines(), simData2.getLineDataForDiff(), 0, simData2.getSizeLines(), context);
+
+        Diff3LineList diff3List;
+        diff3List.calcDiff3LineListUsingAB(&diffList);
+        Diff3Line::m_pDiffBufferInfo->init(&diff3List, simData.getLineDataForDiff(), simData2.getLineDataForDiff(), nullptr);
+        Diff3Line::m_pDiffBufferInfo->setDisplayData(simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), nullptr);
+        diff3List.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlags());
+        QCOMPARE(diff3List.fineDiffCount(), (size_t)1);
+
+        const FineDiff before = diff3List.back().getFineDiff(e_SrcSelector::A);
+        const DiffList expected(before.begin(), before.end());
+        QVERIFY(!expected.empty());
+
+        QVERIFY(diff3List.evictFineDiffs() > 0);
+        QCOMPARE(diff3List.fineDiffCount(), (size_t)0);
+        QVERIFY(diff3List.front().getFineDiff(e_SrcSelector::A).isNull());
+
+        const FineDiff after = diff3List.back().getFineDiff(e_SrcSelector::A);
+        QVERIFY(std::equal(after.begin(), after.end(), expected.cbegin(), expected.cend()));
+        QCOMPARE(diff3List.fineDiffCount(), (size_t)1);
+
+        Diff3Line::m_pDiffBufferInfo->init(nullptr, nullptr, nullptr, nullptr);
+        Diff3Line::m_pDiffBufferInfo->setDisplayData(nullptr, nullptr, nullptr);
+    }
+
+    void benchmarkFineDiff_data()
+    {
+        QTest::addColumn<bool>("bMyers");
+
+        QTest::newRow("classic") << false;
+        QTest::newRow("myers") << true;
+    }
+
+    // A long single line with scattered edits, as found in minified sources.
+    void benchmarkFineDiff()
+    {
+        QFETCH(bool, bMyers);
+        QString line1, line2;
+
+        for(int i = 0; i < 2000; ++i)
+        {
+            line1 += QStringLiteral("{\"key%1\":%2},").arg(i).arg(i * 7);
+            line2 += QStringLiteral("{\"key%1\":%2},").arg(i).arg(i % 50 == 0 ? i * 3 : i * 7);
+        }
+
+        DiffList diffList;
+        QBENCHMARK
+        {
+            if(bMyers)
+                diffList.calcMyersDiff(line1, line2, 1000);
+            else
+                diffList.calcDiff(line1, line2, 500);
+        }
+        QVERIFY(!diffList.empty());
+    }
+
 };
 
 QTEST_MAIN(DiffTest);
@@ -0,0 +1,263 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../DirectoryInfo.h"
+#include "../FileComparisonQueue.h"
+#include "../MergeFileInfos.h"
+#include "../options.h"
+#include "../TypeUtils.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+
+/*
+    Times the steps of a directory comparison on generated folder trees.
+
+    A, B and C get the same tree. B and C change some of the files and some files exist in one
+    tree only. Every folder has a .gitignore and a .cvsignore with files matching them. The shape
+    of the trees is taken from the environment:
+        KDIFF3_BENCHMARK_DEPTH     levels of subfolders (3)
+        KDIFF3_BENCHMARK_FANOUT    subfolders per folder (4)
+        KDIFF3_BENCHMARK_FILES     files per folder (10)
+        KDIFF3_BENCHMARK_FILESIZE  bytes per file (4096)
+        KDIFF3_BENCHMARK_CHANGED   percentage of changed files (10)
+*/
+class DirectoryBenchmark: public QObject
+{
+    Q_OBJECT;
+  private:
+    QTemporaryDir mDir;
+    QSharedPointer<Options> mOptions = QSharedPointer<Options>::create();
+    QSharedPointer<DirectoryInfo> mDirInfo; // Listed once, for the steps after listing.
+
+    int mDepth = 3;
+    int mFanOut = 4;
+    int mFilesPerDir = 10;
+    int mFileSize = 4096;
+    int mChangedPercentage = 10;
+
+    static int setting(const char* name, const int defaultValue)
+    {
+        const int value = qEnvironmentVariableIntValue(name);
+        return value > 0 ? value : defaultValue;
+    }
+
+    static void writeFile(const QString& fileName, const QByteArray& data)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write(data) == data.size());
+    }
+
+    void createTree(const QString& subPath, const int depth, QRandomGenerator& random)
+    {
+        QDir root(mDir.path());
+        for(const QString& tree: {"A", "B", "C"})
+        {
+            QVERIFY(root.mkpath(tree + '/' + subPath));
+            writeFile(root.filePath(tree + '/' + subPath + "/.gitignore"), "*.tmp\nbuild/\n");
+            writeFile(root.filePath(tree + '/' + subPath + "/.cvsignore"), "*.log\n");
+            writeFile(root.filePath(tree + '/' + subPath + "/ignored.tmp"), "");
+            writeFile(root.filePath(tree + '/' + subPath + "/ignored.log"), "");
+        }
+
+        for(int i = 0; i < mFilesPerDir; ++i)
+        {
+            QByteArray data;
+            data.reserve(mFileSize);
+            for(int line = 0; data.size() < mFileSize; ++line)
+                data += QStringLiteral("%1: line %2 of file %3\n").arg(subPath).arg(line).arg(i).toUtf8();
+            data.truncate(mFileSize);
+
+            const QString fileName = QStringLiteral("%1/file%2.txt").arg(subPath).arg(i);
+            const int choice = random.bounded(100);
+            // One in twenty files is missing in B or C.
+            const bool bInB = choice % 20 != 1;
+            const bool bInC = choice % 20 != 2;
+
+            writeFile(root.filePath("A/" + fileName), data);
+            if(bInB)
+                writeFile(root.filePath("B/" + fileName), choice < mChangedPercentage && choice % 2 == 0 ? "changed\n" + data : data);
+            if(bInC)
+                writeFile(root.filePath("C/" + fileName), choice < mChangedPercentage && choice % 2 == 1 ? data + "changed\n" : data);
+        }
+
+        if(depth == 0)
+            return;
+
+        for(int i = 0; i < mFanOut; ++i)
+            createTree(QStringLiteral("%1/dir%2").arg(subPath).arg(i), depth - 1, random);
+    }
+
+    [[nodiscard]] QSharedPointer<DirectoryInfo> listDirs() const
+    {
+        const QSharedPointer<DirectoryInfo> dirInfo = QSharedPointer<DirectoryInfo>::create(FileAccess(mDir.filePath("A")), FileAccess(mDir.filePath("B")), FileAccess(mDir.filePath("C")), FileAccess());
+        bool bSuccessA = false, bSuccessB = false, bSuccessC = false;
+        if(!dirInfo->listDirsConcurrently(mOptions, bSuccessA, bSuccessB, bSuccessC) || !bSuccessA || !bSuccessB || !bSuccessC)
+            return nullptr;
+
+        return dirInfo;
+    }
+
+    // Compares all items on the thread pool and applies the results like the directory merge does.
+    void compareConcurrently(t_fileMergeMap& fileMergeMap, const QSharedPointer<const Options>& pOptions)
+    {
+        std::vector<MergeFileInfos*> items;
+        for(auto& entry: fileMergeMap)
+            items.push_back(&entry.second);
+
+        FileComparisonQueue queue(pOptions);
+        queue.start(std::move(items));
+        queue.waitForDone(-1);
+
+        QStringList errors;
+        for(const FileComparisonQueue::Result& result: queue.takeResults())
+        {
+            result.pMFI->diffStatus() = result.diffStatus;
+            result.pMFI->setComparisonResult(result.equality, result.bError, result.status, errors);
+        }
+        QVERIFY(errors.isEmpty());
+    }
+
+    // Links the items like DirectoryMergeWindow does before showing them.
+    static void buildTree(t_fileMergeMap& fileMergeMap, MergeFileInfos& root)
+    {
+        for(auto& entry: fileMergeMap)
+        {
+            const QtSizeType pos = entry.first.lastIndexOf('/');
+            const auto parentIt = pos == -1 ? fileMergeMap.end() : fileMergeMap.find(entry.first.left(pos));
+            MergeFileInfos& dirMfi = parentIt != fileMergeMap.end() ? parentIt->second : root;
+            dirMfi.addChild(&entry.second);
+            entry.second.setParent(&dirMfi);
+        }
+    }
+
+    static void verifyOrder(const MergeFileInfos& mfi, const Qt::SortOrder order)
+    {
+        const QList<MergeFileInfos*>& children = mfi.children();
+        QVERIFY(std::is_sorted(children.begin(), children.end(), MfiCompare(order)));
+        for(const MergeFileInfos* pChild: children)
+            verifyOrder(*pChild, order);
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+        mDepth = setting("KDIFF3_BENCHMARK_DEPTH", mDepth);
+        mFanOut = setting("KDIFF3_BENCHMARK_FANOUT", mFanOut);
+        mFilesPerDir = setting("KDIFF3_BENCHMARK_FILES", mFilesPerDir);
+        mFileSize = setting("KDIFF3_BENCHMARK_FILESIZE", mFileSize);
+        mChangedPercentage = setting("KDIFF3_BENCHMARK_CHANGED", mChangedPercentage);
+
+        // A fixed seed, so runs can be compared.
+        QRandomGenerator random(42);
+        createTree("root", mDepth, random);
+
+        mOptions->m_bDmUseCvsIgnore = true;
+        mOptions->m_bDmCaseSensitiveFilenameComparison = true;
+
+        mDirInfo = listDirs();
+        QVERIFY(mDirInfo != nullptr);
+        // MergeFileInfos looks the roots up there.
+        gDirInfo = mDirInfo;
+
+        QVERIFY(!mDirInfo->getDirListA().empty());
+        for(const FileAccess& fa: mDirInfo->getDirListA())
+            QVERIFY(!fa.fileName().endsWith(".tmp") && !fa.fileName().endsWith(".log"));
+    }
+
+    // DirectoryInfo::listDirsConcurrently, which lists local trees instead of listDirA/B/C.
+    void benchmarkListDirs()
+    {
+        QBENCHMARK
+        {
+            QVERIFY(listDirs() != nullptr);
+        }
+    }
+
+    void benchmarkBuildMergeMap()
+    {
+        QBENCHMARK
+        {
+            t_fileMergeMap fileMergeMap;
+            buildMergeMap(*mDirInfo, true, fileMergeMap);
+        }
+    }
+
+    // Sorting the tree again, like clicking the column header does.
+    void benchmarkSort()
+    {
+        t_fileMergeMap fileMergeMap;
+        buildMergeMap(*mDirInfo, true, fileMergeMap);
+        MergeFileInfos root;
+        buildTree(fileMergeMap, root);
+
+        Qt::SortOrder order = Qt::AscendingOrder;
+        QBENCHMARK
+        {
+            order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+            root.sort(order);
+        }
+        verifyOrder(root, order);
+    }
+
+    // One item after the other, like compareFilesAndCalcAges is run for a changed file.
+    void benchmarkCompareFilesAndCalcAges()
+    {
+        t_fileMergeMap fileMergeMap;
+        buildMergeMap(*mDirInfo, true, fileMergeMap);
+
+        QBENCHMARK
+        {
+            QStringList errors;
+            for(auto& entry: fileMergeMap)
+            {
+                entry.second.resetComparison();
+                entry.second.compareFilesAndCalcAges(errors, mOptions);
+            }
+            QVERIFY(errors.isEmpty());
+        }
+    }
+
+    void benchmarkCompareConcurrently()
+    {
+        t_fileMergeMap fileMergeMap;
+        buildMergeMap(*mDirInfo, true, fileMergeMap);
+
+        QBENCHMARK
+        {
+            compareConcurrently(fileMergeMap, mOptions);
+        }
+    }
+
+    void benchmarkFullAnalysis()
+    {
+        t_fileMergeMap fileMergeMap;
+        buildMergeMap(*mDirInfo, true, fileMergeMap);
+
+        const QSharedPointer<Options> pOptions = QSharedPointer<Options>::create(*mOptions);
+        pOptions->m_bDmFullAnalysis = true;
+        QBENCHMARK
+        {
+            compareConcurrently(fileMergeMap, pOptions);
+        }
+    }
+};
+
+QTEST_MAIN(DirectoryBenchmark);
+
+#include "DirectoryBenchmark.moc"
@@ -0,0 +1,156 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../CompositeIgnoreList.h"
+#include "../DirectoryScanner.h"
+#include "../fileaccess.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTest>
+
+class DirectoryScannerTest: public QObject
+{
+    Q_OBJECT;
+  private:
+    QTemporaryDir mDir;
+
+    static QStringList names(const DirectoryList& dirList)
+    {
+        QStringList result;
+        for(const FileAccess& fa: dirList)
+            result.append(fa.fileName());
+        return result;
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+
+        QDir root(mDir.path());
+        QVERIFY(root.mkpath("sub1/deep"));
+        QVERIFY(root.mkpath("sub2"));
+        for(const QString& file: {"a.txt", "b.cpp", "sub1/c.txt", "sub1/deep/d.txt", "sub2/e.txt"})
+        {
+            QFile f(root.filePath(file));
+            QVERIFY(f.open(QIODevice::WriteOnly));
+        }
+    }
+
+    void testRecursiveOrder()
+    {
+        FileAccess root(mDir.path());
+        DirectoryList dirList;
+        CompositeIgnoreList ignoreList;
+
+        DirectoryScanner scanner(true, false, "*", "*.cpp", "", false);
+        scanner.addRoot(root, dirList, ignoreList);
+        QVERIFY(scanner.scan());
+        QVERIFY(scanner.succeeded(0));
+
+        // Same order as listing one folder after another: entries first, then each subfolder.
+        QCOMPARE(names(dirList), QStringList({"sub1", "sub2", "a.txt", "deep", "c.txt", "d.txt", "e.txt"}));
+    }
+
+    void testSeveralRoots()
+    {
+        FileAccess root1(mDir.path());
+        FileAccess root2(mDir.filePath("sub1"));
+        DirectoryList dirList1, dirList2;
+        CompositeIgnoreList ignoreList1, ignoreList2;
+
+        DirectoryScanner scanner(false, false, "*", "", "deep", false);
+        scanner.addRoot(root1, dirList1, ignoreList1);
+        scanner.addRoot(root2, dirList2, ignoreList2);
+        QVERIFY(scanner.scan());
+
+        QCOMPARE(names(dirList1), QStringList({"sub1", "sub2", "a.txt", "b.cpp"}));
+        QCOMPARE(names(dirList2), QStringList({"c.txt"}));
+    }
+
+    void testFollowedLinks()
+    {
+#ifndef Q_OS_LINUX
+        QSKIP("Folders are identified by the Linux listing only.");
+#endif
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QDir root(dir.path());
+        QVERIFY(root.mkpath("vendor/lib"));
+        QVERIFY(root.mkpath("app"));
+        QFile f(root.filePath("vendor/lib/x.h"));
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.close();
+        QVERIFY(QFile::link("../vendor", root.filePath("app/vendor")));
+        // Leads back to the root.
+        QVERIFY(QFile::link("..", root.filePath("app/up")));
+
+        FileAccess rootDir(dir.path());
+        DirectoryList dirList;
+        CompositeIgnoreList ignoreList;
+        DirectoryScanner scanner(true, false, "*", "", "", true);
+        scanner.addRoot(rootDir, dirList, ignoreList);
+        QVERIFY(scanner.scan());
+
+        QStringList paths;
+        for(const FileAccess& fa: dirList)
+            paths.append(fa.fileRelPath());
+        QCOMPARE(paths, QStringList({"app", "vendor", "app/up", "app/vendor", "app/vendor/lib", "app/vendor/lib/x.h",
+                                     "vendor/lib", "vendor/lib/x.h"}));
+    }
+
+    // What the listing captured has to match a fresh look at each entry.
+    void testEntryData()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QFile f(dir.filePath("data.txt"));
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        QCOMPARE(f.write("12345"), (qint64)5);
+        f.close();
+        QVERIFY(QFile::link("data.txt", dir.filePath("link")));
+        QVERIFY(QFile::link("missing", dir.filePath("broken")));
+        QVERIFY(QDir(dir.path()).mkpath(".hidden"));
+
+        FileAccess root(dir.path());
+        DirectoryList dirList;
+        CompositeIgnoreList ignoreList;
+        DirectoryScanner scanner(false, true, "*", "", "", false);
+        scanner.addRoot(root, dirList, ignoreList);
+        QVERIFY(scanner.scan());
+
+        QCOMPARE(names(dirList), QStringList({".hidden", "broken", "data.txt", "link"}));
+        for(const FileAccess& listed: dirList)
+        {
+            const FileAccess fresh(listed.absoluteFilePath());
+            QCOMPARE(listed.isFile(), fresh.isFile());
+            QCOMPARE(listed.isDir(), fresh.isDir());
+            QCOMPARE(listed.isSymLink(), fresh.isSymLink());
+            QCOMPARE(listed.isBrokenLink(), fresh.isBrokenLink());
+            QCOMPARE(listed.exists(), fresh.exists());
+            QCOMPARE(listed.isHidden(), fresh.isHidden());
+            QCOMPARE(listed.readLink(), fresh.readLink());
+            QCOMPARE(listed.isReadable(), fresh.isReadable());
+            QCOMPARE(listed.isNormal(), fresh.isNormal());
+            if(!listed.isBrokenLink())
+            {
+                QCOMPARE(listed.size(), fresh.size());
+                QCOMPARE(listed.lastModified(), fresh.lastModified());
+            }
+        }
+    }
+};
+
+QTEST_MAIN(DirectoryScannerTest);
+
+#include "DirectoryScannerTest.moc"
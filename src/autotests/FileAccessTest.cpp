@@ -8,9 +8,14 @@
  */
 // clang-format on
 
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
 #include <QTest>
 #include <QtGlobal>
 
+#include <vector>
+
 #include "../fileaccess.h"
 #include "FileAccessJobHandlerMoc.h"
 
@@ -168,6 +173,45 @@ class FileAccessTest: public QObject
         QVERIFY(!fileData.isDir());
         QVERIFY(fileData.isFile());
     }
+
+    void writeWithBackup()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.filePath(QStringLiteral("file.txt"));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("old\n");
+        file.close();
+
+        const auto chunks = [](std::vector<QByteArray> list) {
+            return [list]() mutable {
+                if(list.empty())
+                    return QByteArray();
+                const QByteArray chunk = list.front();
+                list.erase(list.begin());
+                return chunk;
+            };
+        };
+
+        FileAccess fileData(fileName, true);
+        QVERIFY(fileData.writeFile(chunks({"new ", "content\n"}), QStringLiteral(".orig")));
+
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArray("new content\n"));
+        file.close();
+        QFile backup(fileName + QStringLiteral(".orig"));
+        QVERIFY(backup.open(QIODevice::ReadOnly));
+        QCOMPARE(backup.readAll(), QByteArray("old\n"));
+        backup.close();
+
+        // An older backup is replaced.
+        FileAccess again(fileName, true);
+        QVERIFY(again.writeFile(chunks({"third\n"}), QStringLiteral(".orig")));
+        QVERIFY(backup.open(QIODevice::ReadOnly));
+        QCOMPARE(backup.readAll(), QByteArray("new content\n"));
+    }
 };
 
 QTEST_APPLESS_MAIN(FileAccessTest);
@@ -0,0 +1,74 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../FileHashCache.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class FileHashCacheTest: public QObject
+{
+    Q_OBJECT;
+  private Q_SLOTS:
+    void testStoredAcrossInstances()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        const QString filePath = dir.filePath("file.txt");
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("content");
+        file.close();
+
+        FileHashCache::Stamp stamp;
+        QVERIFY(FileHashCache::stamp(filePath, stamp));
+        QCOMPARE(stamp.size, (qint64)7);
+
+        {
+            FileHashCache cache(dir.filePath("cache"));
+            QByteArray hash;
+            QVERIFY(!cache.find(filePath, stamp, hash));
+            cache.insert(filePath, stamp, "hash");
+            QVERIFY(cache.save());
+        }
+
+        FileHashCache cache(dir.filePath("cache"));
+        QByteArray hash;
+        QVERIFY(cache.find(filePath, stamp, hash));
+        QCOMPARE(hash, QByteArray("hash"));
+
+        // Any change of the stamp invalidates the entry.
+        FileHashCache::Stamp changed = stamp;
+        ++changed.modified;
+        QVERIFY(!cache.find(filePath, changed, hash));
+        QVERIFY(!cache.find(filePath, stamp, hash));
+    }
+
+    void testDamagedFile()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QFile file(dir.filePath("cache"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a cache");
+        file.close();
+
+        FileHashCache cache(dir.filePath("cache"));
+        QByteArray hash;
+        QVERIFY(!cache.find(dir.filePath("cache"), FileHashCache::Stamp(), hash));
+    }
+};
+
+QTEST_MAIN(FileHashCacheTest);
+
+#include "FileHashCacheTest.moc"
@@ -65,6 +65,26 @@ class GitIgnoreListTest : public QObject
             QVERIFY(testObject.matches(testSubDir, "foo", true) == true);
             QVERIFY(testObject.matches(otherTestDir, "foo", true) == false);
         }
+        // A nested .gitignore adds to the patterns of the folders above, but not to its siblings
+        {
+            const QString testSubDir("dir/sub");
+            const QString testSiblingDir("dir/sibling");
+            const QString testPrefixDir("dir/sub2");
+            DirectoryList emptyList;
+            GitIgnoreListStub testObject;
+            testObject.m_fileContents = QString("foo");
+            testObject.enterDir(testDir, directoryList);
+            testObject.m_fileContents = QString("*.o");
+            testObject.enterDir(testSubDir, directoryList);
+            testObject.enterDir(testSiblingDir, emptyList);
+            QVERIFY(testObject.matches(testSubDir, "foo", true) == true);
+            QVERIFY(testObject.matches(testSubDir, "main.o", true) == true);
+            QVERIFY(testObject.matches(testSubDir + "/deeper", "main.o", true) == true);
+            QVERIFY(testObject.matches(testDir, "main.o", true) == false);
+            QVERIFY(testObject.matches(testSiblingDir, "foo", true) == true);
+            QVERIFY(testObject.matches(testSiblingDir, "main.o", true) == false);
+            QVERIFY(testObject.matches(testPrefixDir, "main.o", true) == false);
+        }
     }
 };
 
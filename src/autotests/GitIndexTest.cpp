@@ -0,0 +1,162 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../GitIndex.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <tuple>
+
+class GitIndexTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static void append32(QByteArray& data, const quint32 value)
+    {
+        data.append((char)(value >> 24)).append((char)(value >> 16)).append((char)(value >> 8)).append((char)value);
+    }
+
+    static void append16(QByteArray& data, const quint32 value)
+    {
+        data.append((char)(value >> 8)).append((char)value);
+    }
+
+    // An entry without its name, mtime is given in seconds.
+    static QByteArray entryHead(const quint32 mtime, const quint32 mode, const char idByte, const quint32 flags)
+    {
+        QByteArray data;
+        for(const quint32 value: {mtime, 0u, mtime, 0u, 1u, 42u, mode, 1000u, 1000u, 5u})
+            append32(data, value);
+        data.append(QByteArray(20, idByte));
+        append16(data, flags);
+        return data;
+    }
+
+    static QByteArray header(const quint32 version, const quint32 count)
+    {
+        QByteArray data("DIRC");
+        append32(data, version);
+        append32(data, count);
+        return data;
+    }
+
+    static bool runGit(const QString& dir, const QStringList& arguments, QByteArray* pOutput = nullptr)
+    {
+        QProcess git;
+        git.setWorkingDirectory(dir);
+        git.start(QStringLiteral("git"), arguments);
+        if(!git.waitForFinished() || git.exitCode() != 0)
+            return false;
+        if(pOutput != nullptr)
+            *pOutput = git.readAllStandardOutput().trimmed();
+        return true;
+    }
+
+  private Q_SLOTS:
+    void version2()
+    {
+        QByteArray data = header(2, 3);
+        for(const auto& [name, mtime, mode, idByte, flags]: {std::make_tuple(QByteArray("a.txt"), 100u, 0100644u, 'a', 0u),
+                                                            std::make_tuple(QByteArray("dir/link"), 100u, 0120000u, 'b', 0u),
+                                                            std::make_tuple(QByteArray("dir/new.txt"), 200u, 0100644u, 'c', 0u)})
+        {
+            QByteArray entry = entryHead(mtime, mode, idByte, flags | (quint32)name.size());
+            entry.append(name);
+            entry.append(QByteArray(8 - entry.size() % 8, '\0'));
+            data.append(entry);
+        }
+
+        GitIndex index;
+        QVERIFY(index.load(data, 20, 200, 0));
+        QCOMPARE(index.count(), (qint64)3);
+
+        const GitIndex::Entry* pEntry = index.find("a.txt");
+        QVERIFY(pEntry != nullptr);
+        QVERIFY(pEntry->bTrusted);
+        QCOMPARE(pEntry->id, QByteArray(20, 'a'));
+        QCOMPARE(pEntry->inode, 42u);
+        QCOMPARE(pEntry->size, 5u);
+        // Not a regular file.
+        QVERIFY(index.find("dir/link") != nullptr && !index.find("dir/link")->bTrusted);
+        // Changed in the second the index was written.
+        QVERIFY(index.find("dir/new.txt") != nullptr && !index.find("dir/new.txt")->bTrusted);
+        QVERIFY(index.find("missing") == nullptr);
+
+        QVERIFY(!index.load(data.left(data.size() - 9), 20, 200, 0));
+        QVERIFY(!index.load("DIRX" + data.mid(4), 20, 200, 0));
+    }
+
+    void version4()
+    {
+        QByteArray data = header(4, 3);
+        QByteArray entry = entryHead(100, 0100644, 'a', 9);
+        entry.append('\0').append("src/a.cpp").append('\0');
+        data.append(entry);
+        // Shares "src/" with the previous name.
+        entry = entryHead(100, 0100644, 'b', 0xFFF);
+        entry.append((char)5).append("b.cpp").append('\0');
+        data.append(entry);
+        // A conflict, stage 2.
+        entry = entryHead(100, 0100644, 'c', 0x2000 | 5);
+        entry.append((char)9).append("c.cpp").append('\0');
+        data.append(entry);
+
+        GitIndex index;
+        QVERIFY(index.load(data, 20, 200, 0));
+        QVERIFY(index.find("src/a.cpp") != nullptr);
+        QVERIFY(index.find("src/b.cpp") != nullptr);
+        QCOMPARE(index.find("src/b.cpp")->id, QByteArray(20, 'b'));
+        QVERIFY(index.find("c.cpp") == nullptr);
+    }
+
+    void liveRepository()
+    {
+#ifdef Q_OS_WIN
+        QSKIP("Work tree files are only looked up on POSIX systems.");
+#endif
+        if(QStandardPaths::findExecutable(QStringLiteral("git")).isEmpty())
+            QSKIP("git is not installed.");
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(runGit(dir.path(), {QStringLiteral("init"), QStringLiteral("-q")}));
+
+        const QString fileName = dir.filePath(QStringLiteral("file.txt"));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("content\n");
+        file.close();
+        // Older than the index, so the entry isn't racy.
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(-60), QFileDevice::FileModificationTime));
+        file.close();
+        QVERIFY(runGit(dir.path(), {QStringLiteral("add"), QStringLiteral("file.txt")}));
+
+        QByteArray expected;
+        QVERIFY(runGit(dir.path(), {QStringLiteral("hash-object"), QStringLiteral("file.txt")}, &expected));
+
+        QByteArray id;
+        QVERIFY(GitIndex::objectId(fileName, id));
+        QCOMPARE(id.toHex(), expected);
+
+        QVERIFY(file.open(QIODevice::Append));
+        file.write("changed\n");
+        file.close();
+        QVERIFY(!GitIndex::objectId(fileName, id));
+    }
+};
+
+QTEST_APPLESS_MAIN(GitIndexTest);
+
+#include "GitIndexTest.moc"
@@ -0,0 +1,100 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../GitObjectReader.h"
+
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+class GitObjectReaderTest: public QObject
+{
+    Q_OBJECT
+  private:
+    QTemporaryDir mDir;
+    QString mOldCurrent;
+
+    static bool runGit(const QStringList& arguments)
+    {
+        QProcess git;
+        git.start(QStringLiteral("git"), arguments);
+        return git.waitForFinished() && git.exitCode() == 0;
+    }
+
+    static void writeFile(const QString& name, const QByteArray& content)
+    {
+        QFile file(name);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(content), (qint64)content.size());
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        if(QStandardPaths::findExecutable(QStringLiteral("git")).isEmpty())
+            QSKIP("git is not installed.");
+
+        QVERIFY(mDir.isValid());
+        mOldCurrent = QDir::currentPath();
+        QVERIFY(QDir::setCurrent(mDir.path()));
+
+        QVERIFY(runGit({QStringLiteral("init"), QStringLiteral("-q")}));
+        QVERIFY(QDir().mkpath(QStringLiteral("src")));
+        writeFile(QStringLiteral("src/a.txt"), "first\n");
+        QVERIFY(runGit({QStringLiteral("add"), QStringLiteral("src/a.txt")}));
+        QVERIFY(runGit({QStringLiteral("-c"), QStringLiteral("user.name=Test"), QStringLiteral("-c"), QStringLiteral("user.email=test@example.org"),
+                        QStringLiteral("commit"), QStringLiteral("-q"), QStringLiteral("-m"), QStringLiteral("first")}));
+        // The work tree differs from the commit.
+        writeFile(QStringLiteral("src/a.txt"), "second\n");
+    }
+
+    void cleanupTestCase()
+    {
+        if(!mOldCurrent.isEmpty())
+            QDir::setCurrent(mOldCurrent);
+    }
+
+    void names()
+    {
+        QVERIFY(GitObjectReader::isObjectName(QStringLiteral("HEAD:src/a.txt")));
+        // Trees and missing paths are not files.
+        QVERIFY(!GitObjectReader::isObjectName(QStringLiteral("HEAD:src")));
+        QVERIFY(!GitObjectReader::isObjectName(QStringLiteral("HEAD:missing")));
+        QVERIFY(!GitObjectReader::isObjectName(QStringLiteral("src/a.txt")));
+        QVERIFY(!GitObjectReader::isObjectName(QStringLiteral("C:/src/a.txt")));
+        QVERIFY(!GitObjectReader::isObjectName(QStringLiteral("sftp://host/HEAD:src/a.txt")));
+
+        const QUrl url = GitObjectReader::toUrl(QStringLiteral("HEAD:src/a.txt"));
+        QCOMPARE(url.scheme(), QStringLiteral("git"));
+        QCOMPARE(GitObjectReader::objectName(url), QStringLiteral("HEAD:src/a.txt"));
+        QCOMPARE(GitObjectReader::objectName(QUrl(url.toString())), QStringLiteral("HEAD:src/a.txt"));
+    }
+
+    void readBlob()
+    {
+        GitObjectReader::clearCache();
+        QByteArray data;
+        QString errorString;
+        QVERIFY(GitObjectReader::readBlob(QStringLiteral("HEAD:src/a.txt"), data, errorString));
+        QCOMPARE(data, QByteArray("first\n"));
+        // From the cache the second time.
+        QVERIFY(GitObjectReader::readBlob(QStringLiteral("HEAD:src/a.txt"), data, errorString));
+        QCOMPARE(data, QByteArray("first\n"));
+
+        QVERIFY(!GitObjectReader::readBlob(QStringLiteral("HEAD:missing"), data, errorString));
+        QVERIFY(!errorString.isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(GitObjectReaderTest);
+
+#include "GitObjectReaderTest.moc"
@@ -0,0 +1,116 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../FileNameFilter.h"
+#include "../GlobMatcher.h"
+
+class GlobMatcherTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void literals()
+    {
+        GlobMatcher matcher;
+        QVERIFY(matcher.isEmpty());
+        matcher.addPattern("core");
+        matcher.addPattern("*.o");
+        matcher.addPattern("build*");
+        matcher.compile();
+        QVERIFY(!matcher.isEmpty());
+
+        QVERIFY(matcher.matches("core", true));
+        QVERIFY(!matcher.matches("cores", true));
+        QVERIFY(!matcher.matches("Core", true));
+        QVERIFY(matcher.matches("Core", false));
+
+        QVERIFY(matcher.matches("main.o", true));
+        QVERIFY(matcher.matches(".o", true));
+        QVERIFY(!matcher.matches("main.O", true));
+        QVERIFY(matcher.matches("main.O", false));
+        QVERIFY(!matcher.matches("main.obj", true));
+
+        QVERIFY(matcher.matches("build", true));
+        QVERIFY(matcher.matches("build-debug", true));
+        QVERIFY(matcher.matches("BUILD-debug", false));
+        QVERIFY(!matcher.matches("rebuild", false));
+    }
+
+    void globs()
+    {
+        GlobMatcher matcher;
+        matcher.addPattern("*.*");
+        matcher.addPattern("?x");
+        matcher.addPattern("[ab]c");
+        matcher.compile();
+
+        QVERIFY(matcher.matches("k.K", true));
+        QVERIFY(!matcher.matches("asd", true));
+        QVERIFY(matcher.matches("ax", true));
+        QVERIFY(!matcher.matches("aax", true));
+        QVERIFY(matcher.matches("bc", true));
+        QVERIFY(!matcher.matches("cc", true));
+        QVERIFY(!matcher.matches("BC", true));
+        QVERIFY(matcher.matches("BC", false));
+    }
+
+    void invalidPattern()
+    {
+        GlobMatcher matcher;
+        // Unbalanced brackets are rejected or taken literally depending on the Qt version.
+        matcher.addPattern("[a");
+        QVERIFY(matcher.addPattern("*.cpp"));
+        QVERIFY(matcher.addPattern("a?c"));
+        matcher.compile();
+
+        // The invalid pattern must not spoil the others.
+        QVERIFY(matcher.matches("file.cpp", true));
+        QVERIFY(matcher.matches("abc", true));
+    }
+
+    void clear()
+    {
+        GlobMatcher matcher;
+        matcher.addPattern("foo");
+        matcher.addPattern("f?o");
+        matcher.compile();
+        QVERIFY(matcher.matches("foo", true));
+
+        matcher.clear();
+        matcher.compile();
+        QVERIFY(matcher.isEmpty());
+        QVERIFY(!matcher.matches("foo", true));
+        QVERIFY(!matcher.matches("fxo", true));
+    }
+
+    void nameFilter()
+    {
+        const FileNameFilter filter("*", "*.orig;*.o;;*.b?k", "CVS;.git");
+        QVERIFY(filter.isFileShown("main.cpp", true));
+        QVERIFY(filter.isFileShown(".hidden", true));
+        QVERIFY(!filter.isFileShown("main.o", true));
+        QVERIFY(filter.isFileShown("main.O", true));
+        QVERIFY(!filter.isFileShown("main.O", false));
+        QVERIFY(!filter.isFileShown("main.bak", true));
+        QVERIFY(filter.isDirShown("src", true));
+        QVERIFY(!filter.isDirShown(".git", true));
+        QVERIFY(!filter.isDirShown("cvs", false));
+
+        const FileNameFilter sources("*.cpp;*.h", "", "");
+        QVERIFY(sources.isFileShown("main.cpp", true));
+        QVERIFY(!sources.isFileShown("README", true));
+        QVERIFY(sources.isDirShown("CVS", true));
+    }
+};
+
+QTEST_MAIN(GlobMatcherTest);
+
+#include "GlobMatcherTest.moc"
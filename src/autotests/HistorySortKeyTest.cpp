@@ -0,0 +1,74 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QRegularExpression>
+#include <QTest>
+#include <QtGlobal>
+
+#include "../HistorySortKey.h"
+
+class HistorySortKeyTest: public QObject
+{
+    Q_OBJECT
+  private:
+    // The default from the options dialog.
+    const QString historyEntryStart = "\\s*\\\\main\\\\(\\S+)\\s+"
+                                      "([0-9]+) "
+                                      "(Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) "
+                                      "([0-9][0-9][0-9][0-9]) "
+                                      "([0-9][0-9]:[0-9][0-9]:[0-9][0-9])\\s+(.*)";
+
+  private Q_SLOTS:
+    void parenthesesGroups()
+    {
+        QStringList groups;
+        QVERIFY(findParenthesesGroups(historyEntryStart, groups));
+        QVERIFY(groups.size() == 6);
+        QCOMPARE(groups[2], QString("Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec"));
+
+        QVERIFY(findParenthesesGroups("a\\(b(c)", groups));
+        QCOMPARE(groups, QStringList{"c"});
+
+        QVERIFY(!findParenthesesGroups("(a", groups));
+        QVERIFY(!findParenthesesGroups("a)", groups));
+    }
+
+    void sortKey()
+    {
+        QStringList groups;
+        QVERIFY(findParenthesesGroups(historyEntryStart, groups));
+        const HistorySortKey sortKey("4,3,2,5,1,6", groups);
+        const QRegularExpression entryStart(historyEntryStart);
+
+        QRegularExpressionMatch match = entryStart.match("** \\main\\rolle_fsp_dev_008\\1   17 Aug 2001 10:45:44   rolle");
+        QVERIFY(match.hasMatch());
+        QCOMPARE(sortKey.calc(match), QString("2001 70 1700 10:45:44 rolle_fsp_dev_008\\1 rolle "));
+
+        // The same key object is reused for every entry.
+        match = entryStart.match("\\main\\1 3 Jan 1999 01:02:03 me");
+        QVERIFY(match.hasMatch());
+        QCOMPARE(sortKey.calc(match), QString("1999 00 3000 01:02:03 1000 me "));
+    }
+
+    void invalidKeyOrder()
+    {
+        const QStringList groups{"a|b"};
+        // Empty, negative, out of range and non numeric entries are skipped, "0" is the whole match.
+        const HistorySortKey sortKey(",-1,2,x,1,0", groups);
+        const QRegularExpression entryStart("(a|b)c");
+
+        const QRegularExpressionMatch match = entryStart.match("bc");
+        QVERIFY(match.hasMatch());
+        QCOMPARE(sortKey.calc(match), QString("10 bc "));
+    }
+};
+
+QTEST_MAIN(HistorySortKeyTest);
+
+#include "HistorySortKeyTest.moc"
@@ -0,0 +1,95 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../LocalFileCopy.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+class LocalFileCopyTest: public QObject
+{
+    Q_OBJECT;
+  private:
+    QTemporaryDir mDir;
+
+    bool writeFile(const QString& name, const QByteArray& data)
+    {
+        QFile file(mDir.filePath(name));
+        return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+    }
+
+    QByteArray readFile(const QString& name)
+    {
+        QFile file(mDir.filePath(name));
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+    }
+
+    void testCopy()
+    {
+        // Larger than one read buffer, so the fallback has to loop.
+        QByteArray data;
+        for(int i = 0; i < 300000; ++i)
+            data.append(QByteArray::number(i % 10));
+        data.append(QByteArray(data).repeated(4));
+        QVERIFY(writeFile("src.bin", data));
+
+        QString errorString;
+        QVERIFY(LocalFileCopy::copy(mDir.filePath("src.bin"), mDir.filePath("dest.bin"), errorString));
+        QCOMPARE(readFile("dest.bin"), data);
+    }
+
+    void testReplacesDestination()
+    {
+        QVERIFY(writeFile("short.txt", "new"));
+        QVERIFY(writeFile("long.txt", "old content that is longer"));
+
+        QString errorString;
+        QVERIFY(LocalFileCopy::copy(mDir.filePath("short.txt"), mDir.filePath("long.txt"), errorString));
+        QCOMPARE(readFile("long.txt"), QByteArray("new"));
+    }
+
+    void testKeepsModificationTime()
+    {
+        QVERIFY(writeFile("dated.txt", "x"));
+        const QDateTime modified = QDateTime::currentDateTime().addDays(-10);
+        {
+            QFile file(mDir.filePath("dated.txt"));
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            QVERIFY(file.setFileTime(modified, QFileDevice::FileModificationTime));
+        }
+
+        QString errorString;
+        QVERIFY(LocalFileCopy::copy(mDir.filePath("dated.txt"), mDir.filePath("dated-copy.txt"), errorString));
+        QCOMPARE(QFileInfo(mDir.filePath("dated-copy.txt")).lastModified().toSecsSinceEpoch(), modified.toSecsSinceEpoch());
+    }
+
+    void testMissingSource()
+    {
+        QString errorString;
+        QVERIFY(!LocalFileCopy::copy(mDir.filePath("missing.txt"), mDir.filePath("never.txt"), errorString));
+        QVERIFY(!errorString.isEmpty());
+        QVERIFY(!QFileInfo::exists(mDir.filePath("never.txt")));
+    }
+};
+
+QTEST_MAIN(LocalFileCopyTest);
+
+#include "LocalFileCopyTest.moc"
@@ -0,0 +1,72 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../LruCache.h"
+
+#include <memory>
+
+class LruCacheTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void findAndInsert()
+    {
+        LruCache<int, QString> cache(2);
+        QVERIFY(cache.find(1) == nullptr);
+
+        cache.insert(1, QStringLiteral("one"));
+        cache.insert(2, QStringLiteral("two"));
+        QCOMPARE(cache.size(), size_t(2));
+        QVERIFY(cache.find(1) != nullptr);
+        QCOMPARE(*cache.find(1), QStringLiteral("one"));
+
+        // Replacing keeps the size.
+        cache.insert(2, QStringLiteral("zwei"));
+        QCOMPARE(cache.size(), size_t(2));
+        QCOMPARE(*cache.find(2), QStringLiteral("zwei"));
+    }
+
+    void evictsLeastRecentlyUsed()
+    {
+        LruCache<int, QString> cache(2);
+        cache.insert(1, QStringLiteral("one"));
+        cache.insert(2, QStringLiteral("two"));
+
+        // The lookup makes 1 the most recently used, so 2 goes.
+        QVERIFY(cache.find(1) != nullptr);
+        cache.insert(3, QStringLiteral("three"));
+        QCOMPARE(cache.size(), size_t(2));
+        QVERIFY(cache.find(1) != nullptr);
+        QVERIFY(cache.find(2) == nullptr);
+        QVERIFY(cache.find(3) != nullptr);
+
+        cache.clear();
+        QCOMPARE(cache.size(), size_t(0));
+        QVERIFY(cache.find(1) == nullptr);
+    }
+
+    void moveOnlyValues()
+    {
+        LruCache<int, std::unique_ptr<int>> cache(1);
+        cache.insert(1, std::make_unique<int>(42));
+        QVERIFY(cache.find(1) != nullptr);
+        QCOMPARE(**cache.find(1), 42);
+
+        cache.insert(2, std::make_unique<int>(7));
+        QVERIFY(cache.find(1) == nullptr);
+        QCOMPARE(**cache.find(2), 7);
+    }
+};
+
+QTEST_MAIN(LruCacheTest);
+
+#include "LruCacheTest.moc"
@@ -55,6 +55,27 @@ class ManualDiffHelpListTest: public QObject
         QVERIFY(list.size() == 3);
         QVERIFY(list == expected);
     }
+
+    void testSegmentCacheMatchesBounds()
+    {
+        ManualDiffSegmentCache cache;
+        DiffList segment;
+        segment.push_back(Diff(3, 1, 2));
+
+        cache.insert(10, 4, 20, 5, segment);
+
+        DiffList found;
+        QVERIFY(cache.find(10, 4, 20, 5, found));
+        QVERIFY(found.size() == 1);
+        QVERIFY(found.front().numberOfEquals() == 3 && found.front().diff1() == 1u && found.front().diff2() == 2u);
+
+        QVERIFY(!cache.find(10, 4, 20, 6, found));
+        QVERIFY(!cache.find(11, 4, 20, 5, found));
+
+        cache.clear();
+        QVERIFY(cache.empty());
+        QVERIFY(!cache.find(10, 4, 20, 5, found));
+    }
 };
 
 QTEST_MAIN(ManualDiffHelpListTest);
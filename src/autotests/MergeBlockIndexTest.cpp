@@ -0,0 +1,159 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../diff.h"
+#include "../MergeBlockIndex.h"
+#include "../MergeEditLine.h"
+
+#include <vector>
+
+class MergeBlockIndexTest: public QObject
+{
+    Q_OBJECT
+  private:
+    Diff3LineList mDiff3LineList;
+    MergeBlockList mMergeBlockList;
+    std::vector<MergeBlockListImp::const_iterator> mBlocks;
+
+    // Every other delta is skipped, like the overview modes do for some of them.
+    static bool skipDelta(const MergeBlockListImp::const_iterator i) { return i->getIndex() % 2 == 1; }
+
+    [[nodiscard]] bool isKind(const MergeBlockIndex::Kind kind, const MergeBlockListImp::const_iterator i) const
+    {
+        switch(kind)
+        {
+            case MergeBlockIndex::Kind::delta:
+                return i->isDelta() && !skipDelta(i);
+            case MergeBlockIndex::Kind::conflict:
+                return i->isConflict();
+            case MergeBlockIndex::Kind::unsolvedConflict:
+                break;
+        }
+        return i->list().cbegin()->isConflict();
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        // Alternating equal and differing lines of a two way comparison.
+        DiffList diffList = {{2, 1, 1}, {3, 2, 0}, {1, 0, 1}, {4, 1, 2}, {2, 0, 0}};
+        mDiff3LineList.calcDiff3LineListUsingAB(&diffList);
+        mMergeBlockList.buildFromDiff3(mDiff3LineList, false);
+        for(auto i = mMergeBlockList.list().cbegin(); i != mMergeBlockList.list().cend(); ++i)
+            mBlocks.push_back(i);
+        QVERIFY(mBlocks.size() > 4);
+    }
+
+    void findsLikeAScan()
+    {
+        MergeBlockIndex index;
+        QVERIFY(!index.isValid());
+        index.build(mMergeBlockList.list(), &MergeBlockIndexTest::skipDelta, false);
+        QVERIFY(index.isValid());
+        QCOMPARE(index.size(), mBlocks.size());
+
+        for(const MergeBlockIndex::Kind kind: {MergeBlockIndex::Kind::delta, MergeBlockIndex::Kind::conflict, MergeBlockIndex::Kind::unsolvedConflict})
+        {
+            size_t count = 0;
+            for(size_t i = 0; i < mBlocks.size(); ++i)
+            {
+                QCOMPARE(index.ordinal(mBlocks[i]), i);
+                QVERIFY(index.block(i) == mBlocks[i]);
+                if(isKind(kind, mBlocks[i]))
+                    ++count;
+
+                size_t next = i + 1;
+                while(next < mBlocks.size() && !isKind(kind, mBlocks[next]))
+                    ++next;
+                QCOMPARE(index.next(kind, i), next);
+
+                size_t previous = i;
+                while(previous > 0 && !isKind(kind, mBlocks[previous - 1]))
+                    --previous;
+                QCOMPARE(index.previous(kind, i), previous > 0 ? previous - 1 : mBlocks.size());
+            }
+            QCOMPARE(index.count(kind), count);
+            // From the end every block of the kind is above.
+            QCOMPARE(index.ordinal(mMergeBlockList.list().cend()), mBlocks.size());
+            QCOMPARE(index.next(kind, mBlocks.size()), mBlocks.size());
+        }
+    }
+
+    void findsLines()
+    {
+        MergeBlockIndex index;
+        index.build(mMergeBlockList.list(), &MergeBlockIndexTest::skipDelta, false);
+
+        LineType line = 0;
+        for(size_t i = 0; i < mBlocks.size(); ++i)
+        {
+            QCOMPARE(index.firstLine(i), line);
+            for(LineType j = 0; j < mBlocks[i]->lineCount(); ++j)
+                QCOMPARE(index.ordinalOfLine(line + j), i);
+            line += mBlocks[i]->lineCount();
+
+            for(LineType j = 0; j < mBlocks[i]->sourceRangeLength(); ++j)
+                QCOMPARE(index.ordinalOfDiff3Line(mBlocks[i]->getIndex() + j), i);
+        }
+        QCOMPARE(index.firstLine(mBlocks.size()), line);
+        QCOMPARE(index.ordinalOfLine(line), mBlocks.size());
+        QCOMPARE(index.ordinalOfDiff3Line(SafeInt<LineType>(mDiff3LineList.size())), mBlocks.size());
+    }
+
+    void insertText()
+    {
+        MergeBlockList blocks = mMergeBlockList;
+        MergeBlockIndex index;
+        index.build(blocks.list(), &MergeBlockIndexTest::skipDelta, false);
+
+        const size_t ordinal = 1;
+        MergeBlock& mb = *std::next(blocks.list().begin(), ordinal);
+        const LineType lineCount = mb.lineCount();
+        MergeEditLineList::iterator melIt = mb.list().begin();
+        QtSizeType x = 2;
+        QCOMPARE(mb.insertText(melIt, QStringLiteral("abcd"), x, QStringLiteral("1\r\n2\r3\n4")), 3);
+        QCOMPARE(mb.lineCount(), lineCount + 3);
+        QCOMPARE(x, 1);
+        QVERIFY(melIt == mb.list().begin() + 3);
+        const QStringList expected = {QStringLiteral("ab1"), QStringLiteral("2"), QStringLiteral("3"), QStringLiteral("4cd")};
+        for(int i = 0; i < expected.size(); ++i)
+            QCOMPARE(mb.list()[i].getString(nullptr, nullptr, nullptr), expected[i]);
+
+        // Moving the following lines gives what building the index again does.
+        index.invalidate();
+        index.insertLines(ordinal, 3);
+        QVERIFY(index.isValid());
+        MergeBlockIndex rebuilt;
+        rebuilt.build(blocks.list(), &MergeBlockIndexTest::skipDelta, false);
+        for(size_t i = 0; i <= rebuilt.size(); ++i)
+            QCOMPARE(index.firstLine(i), rebuilt.firstLine(i));
+
+        // Without a line break the text stays in the line.
+        x = 1;
+        QCOMPARE(mb.insertText(melIt, QStringLiteral("4cd"), x, QStringLiteral("xy")), 0);
+        QCOMPARE(melIt->getString(nullptr, nullptr, nullptr), QStringLiteral("4xycd"));
+        QCOMPARE(x, 3);
+    }
+
+    void invalidate()
+    {
+        MergeBlockIndex index;
+        index.build(mMergeBlockList.list(), &MergeBlockIndexTest::skipDelta, true);
+        QVERIFY(index.skipsWhiteSpaceConflicts());
+        index.invalidate();
+        QVERIFY(!index.isValid());
+    }
+};
+
+QTEST_MAIN(MergeBlockIndexTest);
+
+#include "MergeBlockIndexTest.moc"
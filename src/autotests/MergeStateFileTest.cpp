@@ -0,0 +1,145 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../MergeStateFile.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <vector>
+
+class MergeStateFileTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static std::vector<MergeStateFile::Entry> sampleEntries()
+    {
+        std::vector<MergeStateFile::Entry> entries;
+        for(const QString& subPath: {QStringLiteral("src"), QStringLiteral("src/main.cpp"), QStringLiteral("src/sub/ünïcode.h"), QStringLiteral("README")})
+        {
+            MergeStateFile::Entry entry;
+            entry.subPath = subPath;
+            entry.flags = MergeStateFile::existsInA | MergeStateFile::existsInB | (subPath == QStringLiteral("src") ? MergeStateFile::dirA | MergeStateFile::dirB : 0);
+            entry.operation = subPath == QStringLiteral("README") ? eMergeABCToDest : eMergeABToDest;
+            // The last status has to fit as well.
+            entry.opStatus = subPath == QStringLiteral("README") ? eOpStatusConflicts : eOpStatusToDo;
+            entry.ageA = eNew;
+            entry.ageB = eOld;
+            entries.push_back(entry);
+        }
+        return entries;
+    }
+
+    static void compareEntries(const MergeStateFile& state, const std::vector<MergeStateFile::Entry>& entries)
+    {
+        QCOMPARE(state.size(), entries.size());
+        for(const MergeStateFile::Entry& entry: entries)
+        {
+            const MergeStateFile::Entry* pLoaded = state.find(entry.subPath);
+            QVERIFY(pLoaded != nullptr);
+            QCOMPARE(pLoaded->subPath, entry.subPath);
+            QVERIFY(pLoaded->hasSameState(entry));
+        }
+    }
+
+  private Q_SLOTS:
+    void roundTrip()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("state"));
+        const std::vector<MergeStateFile::Entry> entries = sampleEntries();
+
+        MergeStateFile saved;
+        QVERIFY(saved.save(fileName, entries));
+        QCOMPARE(saved.fileName(), fileName);
+
+        MergeStateFile loaded;
+        QVERIFY(loaded.load(fileName));
+        compareEntries(loaded, entries);
+        // Folders that only appear in paths have no entry.
+        QVERIFY(loaded.find(QStringLiteral("src/sub")) == nullptr);
+    }
+
+    void appendsChanges()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("state"));
+        std::vector<MergeStateFile::Entry> entries = sampleEntries();
+
+        MergeStateFile state;
+        QVERIFY(state.save(fileName, entries));
+        const qint64 savedSize = QFileInfo(fileName).size();
+
+        // Nothing changed, nothing is written.
+        QVERIFY(state.update(entries));
+        QCOMPARE(QFileInfo(fileName).size(), savedSize);
+
+        entries[1].opStatus = eOpStatusDone;
+        entries[1].flags |= MergeStateFile::operationComplete;
+        MergeStateFile::Entry added;
+        added.subPath = QStringLiteral("src/sub/new.h");
+        added.flags = MergeStateFile::existsInB;
+        added.operation = eCopyBToDest;
+        entries.push_back(added);
+        QVERIFY(state.update(entries));
+        // A chunk header, the new name padded to four bytes and two entries.
+        QCOMPARE(QFileInfo(fileName).size(), savedSize + 16 + 8 + 12 + 16);
+
+        MergeStateFile loaded;
+        QVERIFY(loaded.load(fileName));
+        compareEntries(loaded, entries);
+    }
+
+    void ignoresCutChunk()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("state"));
+        std::vector<MergeStateFile::Entry> entries = sampleEntries();
+
+        MergeStateFile state;
+        QVERIFY(state.save(fileName, entries));
+        const qint64 savedSize = QFileInfo(fileName).size();
+        const std::vector<MergeStateFile::Entry> saved = entries;
+        entries[0].operation = eNoOperation;
+        QVERIFY(state.update(entries));
+
+        QFile file(fileName);
+        QVERIFY(file.resize(QFileInfo(fileName).size() - 4));
+
+        MergeStateFile loaded;
+        QVERIFY(loaded.load(fileName));
+        compareEntries(loaded, saved);
+
+        QVERIFY(file.resize(savedSize - 4));
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.size(), (size_t)0);
+    }
+
+    void rejectsOtherFiles()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("state"));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("{\nSubPath=src\n}\n");
+        file.close();
+
+        MergeStateFile state;
+        QVERIFY(!state.load(fileName));
+        QVERIFY(!state.errorString().isEmpty());
+        QVERIFY(state.fileName().isEmpty());
+        QVERIFY(!state.load(dir.filePath(QStringLiteral("missing"))));
+    }
+};
+
+QTEST_MAIN(MergeStateFileTest);
+
+#include "MergeStateFileTest.moc"
@@ -0,0 +1,63 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QFontDatabase>
+#include <QTest>
+#include <QtGlobal>
+
+#include "../MonospaceText.h"
+
+class MonospaceTextTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void isSimple()
+    {
+        QVERIFY(MonospaceText::isSimple(QStringLiteral("int main()\t{ return 0; }¶")));
+        QVERIFY(MonospaceText::isSimple(QStringLiteral("Grüße")));
+        // Combining marks, right to left and wide characters need shaping.
+        QVERIFY(!MonospaceText::isSimple(QStringLiteral("é")));
+        QVERIFY(!MonospaceText::isSimple(QStringLiteral("שלום")));
+        QVERIFY(!MonospaceText::isSimple(QStringLiteral("漢字")));
+        QVERIFY(!MonospaceText::isSimple(QStringLiteral("a\u0001b")));
+    }
+
+    void runs()
+    {
+        QVector<QTextLayout::FormatRange> formats;
+        QTextLayout::FormatRange range;
+        range.start = 2;
+        range.length = 3;
+        range.format.setForeground(QColor(Qt::red));
+        range.format.setBackground(QColor(Qt::yellow));
+        formats.push_back(range);
+
+        const QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+        const MonospaceText text(QStringLiteral("a\tbcde"), formats, QColor(Qt::black), 4, font);
+
+        // The tab reaches to the stop at column 4, characters outside of formats keep the default color.
+        QCOMPARE(text.columns(), 8);
+        QCOMPARE(text.runs().size(), (size_t)3);
+        QCOMPARE(text.runs()[0].text, QStringLiteral("a   "));
+        QCOMPARE(text.runs()[0].column, 0);
+        QCOMPARE(text.runs()[0].columns, 4);
+        QVERIFY(!text.runs()[0].background.isValid());
+        QCOMPARE(text.runs()[1].text, QStringLiteral("bcd"));
+        QCOMPARE(text.runs()[1].column, 4);
+        QCOMPARE(text.runs()[1].foreground, QColor(Qt::red));
+        QCOMPARE(text.runs()[1].background, QColor(Qt::yellow));
+        QCOMPARE(text.runs()[2].text, QStringLiteral("e"));
+        QCOMPARE(text.runs()[2].column, 7);
+        QCOMPARE(text.runs()[2].foreground, QColor(Qt::black));
+    }
+};
+
+QTEST_MAIN(MonospaceTextTest);
+
+#include "MonospaceTextTest.moc"
@@ -0,0 +1,63 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QThread>
+#include <QtGlobal>
+
+#include "../ParallelProgress.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+class ParallelProgressTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void singleThread()
+    {
+        ParallelProgress progress(10);
+        QCOMPARE(progress.maxNofSteps(), quint64(10));
+        QCOMPARE(progress.current(), quint64(0));
+
+        progress.step();
+        progress.step(3);
+        QCOMPARE(progress.current(), quint64(4));
+    }
+
+    void sumsAllThreads()
+    {
+        constexpr int nofThreads = 8;
+        constexpr quint64 stepsPerThread = 100000;
+        ParallelProgress progress(nofThreads * stepsPerThread);
+
+        std::vector<std::unique_ptr<QThread>> threads;
+        for(int i = 0; i < nofThreads; ++i)
+        {
+            threads.emplace_back(QThread::create([&progress]() {
+                for(quint64 j = 0; j < stepsPerThread; ++j)
+                    progress.step();
+            }));
+            threads.back()->start();
+        }
+
+        // Reading while the workers count must not go beyond what they did.
+        while(std::any_of(threads.cbegin(), threads.cend(), [](const std::unique_ptr<QThread>& pThread) { return pThread->isRunning(); }))
+            QVERIFY(progress.current() <= progress.maxNofSteps());
+
+        for(const std::unique_ptr<QThread>& pThread: threads)
+            QVERIFY(pThread->wait());
+        QCOMPARE(progress.current(), progress.maxNofSteps());
+    }
+};
+
+QTEST_MAIN(ParallelProgressTest);
+
+#include "ParallelProgressTest.moc"
@@ -0,0 +1,86 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../PatchWriter.h"
+
+#include "SourceDataMoc.h"
+
+#include <QBuffer>
+#include <QString>
+#include <QTest>
+#include <QTextCodec>
+
+class PatchWriterTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static QString patch(const QString& textA, const QString& textB, const LineType contextLines)
+    {
+        SourceDataMoc sdA, sdB;
+        sdA.setData(textA);
+        sdB.setData(textB);
+        sdA.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+        sdB.readAndPreprocess(QTextCodec::codecForName("UTF-8"), true);
+
+        DiffList diffList;
+        DiffContext context(DiffSettings(*sdA.options()));
+        diffList.runDiff(sdA.getLineDataForDiff(), 0, sdA.getSizeLines(), sdB.getLineDataForDiff(), 0, sdB.getSizeLines(), context);
+
+        PatchWriter writer(diffList, sdA.getLineDataForDisplay(), sdA.getSizeLines(), sdB.getLineDataForDisplay(), sdB.getSizeLines(),
+                           QStringLiteral("a.txt"), QStringLiteral("b.txt"), contextLines, QTextCodec::codecForName("UTF-8"), eLineEndStyleUnix);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        if(!writer.write(buffer))
+            return QString();
+        return QString::fromUtf8(buffer.data());
+    }
+
+  private Q_SLOTS:
+    void equal()
+    {
+        QCOMPARE(patch(QStringLiteral("a\nb\n"), QStringLiteral("a\nb\n"), 3), QString());
+    }
+
+    void change()
+    {
+        QCOMPARE(patch(QStringLiteral("a\nb\nc\nd\ne\n"), QStringLiteral("a\nx\nc\nd\ne\n"), 1),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,3 +1,3 @@\n a\n-b\n+x\n c\n"));
+        QCOMPARE(patch(QStringLiteral("a\nb\n"), QStringLiteral("a\n"), 3), QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,2 +1 @@\n a\n-b\n"));
+        // An empty range names the line before it.
+        QCOMPARE(patch(QStringLiteral("a\nb\n"), QStringLiteral("a\nx\nb\n"), 0), QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,0 +2 @@\n+x\n"));
+    }
+
+    // Changes separated by no more than twice the context share a hunk.
+    void joinHunks()
+    {
+        QCOMPARE(patch(QStringLiteral("1\n2\n3\n4\n5\n6\n7\n"), QStringLiteral("1\nX\n3\n4\nY\n6\n7\n"), 1),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,6 +1,6 @@\n 1\n-2\n+X\n 3\n 4\n-5\n+Y\n 6\n"));
+        QCOMPARE(patch(QStringLiteral("1\n2\n3\n4\n5\n6\n7\n"), QStringLiteral("1\nX\n3\n4\nY\n6\n7\n"), 0),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -2 +2 @@\n-2\n+X\n@@ -5 +5 @@\n-5\n+Y\n"));
+    }
+
+    // Lines the line matching takes as equal apart from white space still differ in the patch.
+    void ignoredWhiteSpace()
+    {
+        QCOMPARE(patch(QStringLiteral("a\nb\nc\nd\ne\n"), QStringLiteral("a\nx\nc\n d\nq\ne\n"), 0),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -2 +2 @@\n-b\n+x\n@@ -4 +4,2 @@\n-d\n+ d\n+q\n"));
+    }
+
+    void missingLineEnd()
+    {
+        QCOMPARE(patch(QStringLiteral("a\nb"), QStringLiteral("a\nb\n"), 3),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+b\n"));
+        QCOMPARE(patch(QStringLiteral("a\nb"), QStringLiteral("a\nc"), 3),
+                 QStringLiteral("--- a.txt\n+++ b.txt\n@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n"));
+    }
+};
+
+QTEST_GUILESS_MAIN(PatchWriterTest);
+
+#include "PatchWriterTest.moc"
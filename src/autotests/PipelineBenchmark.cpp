@@ -0,0 +1,248 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../diff.h"
+#include "../fileaccess.h"
+#include "../LineDiffEngine.h"
+#include "../MergeEditLine.h"
+#include "../MergeResultWriter.h"
+
+#include "SourceDataMoc.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTextCodec>
+
+/*
+    Times the steps between reading three files and saving their merge.
+
+    The inputs are built like generate_testdata_from_permutations.py builds them, only much longer:
+    every line of a base text is kept, changed or removed in each contributor. The number of lines
+    is taken from KDIFF3_BENCHMARK_LINES. If KDIFF3_BENCHMARK_JSON names a file, the average time
+    of each step is written there at the end, so runs can be compared by a script.
+*/
+class PipelineBenchmark: public QObject
+{
+    Q_OBJECT;
+  private:
+    QTemporaryDir mDir;
+    QString mFileA, mFileB, mFileC;
+    SourceDataMoc mSdA, mSdB, mSdC;
+    DiffList mDiffList12, mDiffList13;
+    ManualDiffHelpList mManualDiffHelpList; // Stays empty.
+    Diff3LineList mAligned; // Before calcDiff3LineListTrim().
+    Diff3LineList mTrimmed;
+    qint64 mNofLines = 50000;
+    QJsonArray mResults;
+
+    // Runs fn in a QBENCHMARK loop and keeps the average time per run for the JSON report.
+    template<class Function>
+    void measure(const Function& fn)
+    {
+        qint64 nsecs = 0;
+        qint64 runs = 0;
+        QBENCHMARK
+        {
+            QElapsedTimer timer;
+            timer.start();
+            fn();
+            nsecs += timer.nsecsElapsed();
+            ++runs;
+        }
+
+        QJsonObject result;
+        result["name"] = QString::fromLatin1(QTest::currentTestFunction());
+        result["lines"] = mNofLines;
+        result["runs"] = runs;
+        result["nsecsPerRun"] = runs > 0 ? nsecs / runs : 0;
+        mResults.append(result);
+    }
+
+    static void writeFile(const QString& fileName, const QStringList& lines)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for(const QString& line: lines)
+            file.write(line.toUtf8() + '\n');
+    }
+
+    static void read(SourceData& sd, const QString& fileName)
+    {
+        sd.setFilename(fileName);
+        sd.readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(sd.isValid() && sd.isText());
+    }
+
+    [[nodiscard]] Diff3LineList align() const
+    {
+        Diff3LineList diff3LineList;
+        diff3LineList.calcDiff3LineListUsingABAndAC(&mDiffList12, &mDiffList13);
+        return diff3LineList;
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+        const qint64 nofLines = qEnvironmentVariableIntValue("KDIFF3_BENCHMARK_LINES");
+        if(nofLines > 0)
+            mNofLines = nofLines;
+
+        // The same choices as in generate_testdata_from_permutations.py, with a fixed seed to get comparable runs.
+        QRandomGenerator random(42);
+        QStringList base, contrib1, contrib2;
+        for(qint64 i = 0; i < mNofLines; ++i)
+        {
+            const QString line = QStringLiteral("    value%1 = compute(%2, \"%3\");").arg(i).arg(i % 97).arg(i % 13);
+            const int choice = random.bounded(100);
+            if(choice < 85)
+            {
+                base << line;
+                contrib1 << line;
+                contrib2 << line;
+            }
+            else if(choice < 90)
+            {
+                base << line;
+                contrib1 << "xxx" + line;
+                contrib2 << line;
+            }
+            else if(choice < 94)
+            {
+                base << line;
+                contrib1 << line;
+                contrib2 << "yyy" + line;
+            }
+            else if(choice < 97)
+            {
+                // Conflict
+                base << line;
+                contrib1 << "xxx" + line;
+                contrib2 << "yyy" + line;
+            }
+            else if(choice < 98)
+                base << line;
+            else if(choice < 99)
+                contrib1 << line;
+            else
+                contrib2 << line;
+        }
+
+        mFileA = mDir.filePath("base.txt");
+        mFileB = mDir.filePath("contrib1.txt");
+        mFileC = mDir.filePath("contrib2.txt");
+        writeFile(mFileA, base);
+        writeFile(mFileB, contrib1);
+        writeFile(mFileC, contrib2);
+
+        read(mSdA, mFileA);
+        read(mSdB, mFileB);
+        read(mSdC, mFileC);
+
+        DiffContext context{DiffSettings()};
+        mDiffList12.runDiff(mSdA.getLineDataForDiff(), 0, mSdA.getSizeLines(), mSdB.getLineDataForDiff(), 0, mSdB.getSizeLines(), context);
+        mDiffList13.runDiff(mSdA.getLineDataForDiff(), 0, mSdA.getSizeLines(), mSdC.getLineDataForDiff(), 0, mSdC.getSizeLines(), context);
+
+        mAligned = align();
+        mTrimmed = mAligned;
+        mTrimmed.calcDiff3LineListTrim(mSdA.getLineDataForDiff(), mSdB.getLineDataForDiff(), mSdC.getLineDataForDiff(), &mManualDiffHelpList);
+        mTrimmed.calcWhiteDiff3Lines(mSdA.getLineDataForDiff(), mSdB.getLineDataForDiff(), mSdC.getLineDataForDiff(), false);
+    }
+
+    void cleanupTestCase()
+    {
+        const QString fileName = qEnvironmentVariable("KDIFF3_BENCHMARK_JSON");
+        if(fileName.isEmpty())
+            return;
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QJsonDocument(mResults).toJson());
+    }
+
+    void benchmarkReadAndPreprocess()
+    {
+        measure([this]() {
+            SourceDataMoc sd;
+            read(sd, mFileA);
+        });
+    }
+
+    void benchmarkRunDiff()
+    {
+        measure([this]() {
+            DiffList diffList;
+            DiffContext context{DiffSettings()};
+            diffList.runDiff(mSdA.getLineDataForDiff(), 0, mSdA.getSizeLines(), mSdB.getLineDataForDiff(), 0, mSdB.getSizeLines(), context);
+        });
+    }
+
+    void benchmarkAlignment()
+    {
+        measure([this]() { Q_UNUSED(align()); });
+    }
+
+    // Includes copying the aligned list, as the trimming changes it.
+    void benchmarkCalcDiff3LineListTrim()
+    {
+        measure([this]() {
+            Diff3LineList diff3LineList = mAligned;
+            diff3LineList.calcDiff3LineListTrim(mSdA.getLineDataForDiff(), mSdB.getLineDataForDiff(), mSdC.getLineDataForDiff(), &mManualDiffHelpList);
+        });
+    }
+
+    // The three passes KDiff3App::mainInit runs, including a copy of the list.
+    void benchmarkFineDiff()
+    {
+        measure([this]() {
+            Diff3LineList diff3LineList = mTrimmed;
+            diff3LineList.fineDiff(e_SrcSelector::A, mSdA.getLineDataForDisplay(), mSdB.getLineDataForDisplay(), IgnoreFlag::none);
+            diff3LineList.fineDiff(e_SrcSelector::B, mSdB.getLineDataForDisplay(), mSdC.getLineDataForDisplay(), IgnoreFlag::none);
+            diff3LineList.fineDiff(e_SrcSelector::C, mSdC.getLineDataForDisplay(), mSdA.getLineDataForDisplay(), IgnoreFlag::none);
+        });
+    }
+
+    // What an automatic MergeResultWindow::merge does before showing the result.
+    void benchmarkMerge()
+    {
+        measure([this]() {
+            MergeBlockList mergeBlockList;
+            mergeBlockList.buildFromDiff3(mTrimmed, true);
+            for(MergeBlock& mb: mergeBlockList.list())
+                mb.removeEmptySource();
+        });
+    }
+
+    void benchmarkSave()
+    {
+        MergeBlockList mergeBlockList;
+        mergeBlockList.buildFromDiff3(mTrimmed, true);
+        for(MergeBlock& mb: mergeBlockList.list())
+            mb.removeEmptySource();
+
+        const QString fileName = mDir.filePath("result.txt");
+        measure([&]() {
+            FileAccess file(fileName, true);
+            MergeResultWriter writer(mergeBlockList, QTextCodec::codecForName("UTF-8"), eLineEndStyleUnix,
+                                     mSdA.getLineDataForDisplay(), mSdB.getLineDataForDisplay(), mSdC.getLineDataForDisplay());
+            QVERIFY(writer.write(file));
+        });
+    }
+};
+
+QTEST_MAIN(PipelineBenchmark);
+
+#include "PipelineBenchmark.moc"
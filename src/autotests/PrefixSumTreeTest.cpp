@@ -0,0 +1,84 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QRandomGenerator>
+#include <QTest>
+#include <QtGlobal>
+
+#include "../PrefixSumTree.h"
+
+#include <vector>
+
+class PrefixSumTreeTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void prefixAndFind()
+    {
+        PrefixSumTree tree;
+        tree.assign({1, 3, 0, 2});
+
+        QCOMPARE(tree.total(), 6);
+        QCOMPARE(tree.prefix(0), 0);
+        QCOMPARE(tree.prefix(2), 4);
+        QCOMPARE(tree.prefix(3), 4);
+        QCOMPARE(tree.prefix(10), 6);
+
+        QCOMPARE(tree.find(0), (size_t)0);
+        QCOMPARE(tree.find(1), (size_t)1);
+        QCOMPARE(tree.find(3), (size_t)1);
+        // The entry with a count of 0 contains no position.
+        QCOMPARE(tree.find(4), (size_t)3);
+        QCOMPARE(tree.find(6), (size_t)4);
+
+        tree.set(2, 5);
+        QCOMPARE(tree.total(), 11);
+        QCOMPARE(tree.prefix(3), 9);
+        QCOMPARE(tree.find(4), (size_t)2);
+        QCOMPARE(tree.find(9), (size_t)3);
+    }
+
+    void matchesLinearSums()
+    {
+        QRandomGenerator random(7);
+        for(int n = 0; n < 70; ++n)
+        {
+            std::vector<LineType> values(n);
+            for(LineType& value: values)
+                value = (LineType)random.bounded(4);
+
+            PrefixSumTree tree;
+            tree.assign(values);
+            for(int round = 0; round < 10; ++round)
+            {
+                if(n > 0)
+                {
+                    const int idx = (int)random.bounded(n);
+                    values[idx] = (LineType)random.bounded(4);
+                    tree.set(idx, values[idx]);
+                }
+
+                LineType sum = 0;
+                for(int i = 0; i < n; ++i)
+                {
+                    QCOMPARE(tree.prefix(i), sum);
+                    for(LineType pos = sum; pos < sum + values[i]; ++pos)
+                        QCOMPARE(tree.find(pos), (size_t)i);
+                    sum += values[i];
+                }
+                QCOMPARE(tree.total(), sum);
+                QCOMPARE(tree.find(sum), (size_t)n);
+            }
+        }
+    }
+};
+
+QTEST_MAIN(PrefixSumTreeTest);
+
+#include "PrefixSumTreeTest.moc"
@@ -0,0 +1,73 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../Preprocessor.h"
+
+class PreprocessorTest: public QObject
+{
+    Q_OBJECT
+  private:
+    static QString run(const QString& cmd, const QString& text)
+    {
+        const std::unique_ptr<Preprocessor> pPreprocessor = Preprocessor::fromCommand(cmd);
+        if(pPreprocessor == nullptr)
+            return QString("<external>");
+        return pPreprocessor->run(text);
+    }
+
+  private Q_SLOTS:
+    void externalCommands()
+    {
+        QVERIFY(Preprocessor::fromCommand("") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("grep x") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sort -r") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed -n p") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed 's/a/b/' file") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed 's/a/b/2'") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed 's/a/\\U&/'") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed 's/\\<word\\>/x/'") == nullptr);
+        QVERIFY(Preprocessor::fromCommand("sed 's/a/b/;d'") == nullptr);
+    }
+
+    void sedBasic()
+    {
+        QCOMPARE(run("sed 's/\\$Id[^$]*\\$/$Id$/'", "a $Id: foo 1.2 $ b\nnone\n"), QString("a $Id$ b\nnone\n"));
+        QCOMPARE(run("sed -e 's/\\([a-z]*\\)=\\([0-9]*\\)/\\2=\\1/g'", "x=1 y=2\n"), QString("1=x 2=y\n"));
+        // Unescaped +, ? and parentheses are literal in basic expressions.
+        QCOMPARE(run("sed 's/a+(b)?/c/'", "a+(b)? aab\n"), QString("c aab\n"));
+        QCOMPARE(run("sed 's/[0-9][0-9]*/<&>/g'", "a12b3\n"), QString("a<12>b<3>\n"));
+        QCOMPARE(run("sed 's/[[:digit:]]/#/g'", "a1b2\n"), QString("a#b#\n"));
+        QCOMPARE(run("sed 's/b/x/'", "abcb\nb\n"), QString("axcb\nx\n"));
+    }
+
+    void sedOptions()
+    {
+        QCOMPARE(run("sed -E 's/a+/x/g'", "caab ab\n"), QString("cxb xb\n"));
+        QCOMPARE(run("sed 's/abc/x/I'", "ABC\n"), QString("x\n"));
+        QCOMPARE(run("sed 's#a\\#b#x#'", "a#b\n"), QString("x\n"));
+        QCOMPARE(run("sed 's/a/b/;s/b/c/'", "a\n"), QString("c\n"));
+        QCOMPARE(run("sed -e s/a/b/ -e s/b/c/", "a\n"), QString("c\n"));
+        // No line end is added to the last line.
+        QCOMPARE(run("sed s/a/b/", "a\na"), QString("b\nb"));
+    }
+
+    void sort()
+    {
+        QCOMPARE(run("sort", "b\na\nc\n"), QString("a\nb\nc\n"));
+        QCOMPARE(run("sort", "b\na"), QString("a\nb"));
+        QCOMPARE(run("sort", ""), QString(""));
+    }
+};
+
+QTEST_MAIN(PreprocessorTest);
+
+#include "PreprocessorTest.moc"
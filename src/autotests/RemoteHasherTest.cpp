@@ -0,0 +1,56 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../RemoteHasher.h"
+
+#include <QTest>
+
+class RemoteHasherTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void protocols()
+    {
+        QVERIFY(RemoteHasher::canHash(QUrl(QStringLiteral("sftp://host/file"))));
+        QVERIFY(RemoteHasher::canHash(QUrl(QStringLiteral("fish://user@host/file"))));
+        QVERIFY(!RemoteHasher::canHash(QUrl(QStringLiteral("smb://host/share/file"))));
+        QVERIFY(!RemoteHasher::canHash(QUrl::fromLocalFile(QStringLiteral("/tmp/file"))));
+    }
+
+    void quoting()
+    {
+        QCOMPARE(RemoteHasher::shellQuote(QStringLiteral("a b")), QStringLiteral("'a b'"));
+        QCOMPARE(RemoteHasher::shellQuote(QStringLiteral("it's$(x)")), QStringLiteral("'it'\\''s$(x)'"));
+    }
+
+    void arguments()
+    {
+        const QStringList arguments = RemoteHasher::sshArguments(QUrl(QStringLiteral("sftp://me@host:2222/file")), QStringLiteral("cmd"));
+        QVERIFY(arguments.contains(QStringLiteral("BatchMode=yes")));
+        QCOMPARE(arguments.mid(arguments.indexOf(QStringLiteral("-p")), 2), QStringList({QStringLiteral("-p"), QStringLiteral("2222")}));
+        QCOMPARE(arguments.mid(arguments.indexOf(QStringLiteral("-l")), 2), QStringList({QStringLiteral("-l"), QStringLiteral("me")}));
+        // The host can't be taken for an option.
+        QCOMPARE(arguments.mid(arguments.size() - 3), QStringList({QStringLiteral("--"), QStringLiteral("host"), QStringLiteral("cmd")}));
+    }
+
+    void digests()
+    {
+        const QByteArray hex = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+        QByteArray digest;
+        QVERIFY(RemoteHasher::parseDigest(hex + " *file\n", digest));
+        QCOMPARE(digest, QByteArray::fromHex(hex));
+        QVERIFY(!RemoteHasher::parseDigest("sha256sum: file: No such file or directory\n", digest));
+        QVERIFY(!RemoteHasher::parseDigest(hex.left(60), digest));
+        QVERIFY(!RemoteHasher::parseDigest(hex + "00 *file\n", digest));
+    }
+};
+
+QTEST_MAIN(RemoteHasherTest);
+
+#include "RemoteHasherTest.moc"
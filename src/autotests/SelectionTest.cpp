@@ -0,0 +1,61 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../selection.h"
+#include "../TypeUtils.h"
+
+class SelectionTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void spanInLine()
+    {
+        Selection selection;
+        QVERIFY(selection.spanInLine(0).isEmpty());
+
+        // Selected backwards, from column 2 of line 5 up to column 4 of line 3.
+        selection.start(5, 2);
+        selection.end(3, 4);
+        QCOMPARE((LineType)selection.beginLine(), 3);
+        QVERIFY(selection.spanInLine(2).isEmpty());
+        QCOMPARE(selection.spanInLine(3).begin, 4);
+        QCOMPARE(selection.spanInLine(3).end, limits<QtSizeType>::max());
+        QCOMPARE(selection.spanInLine(4).begin, 0);
+        QCOMPARE(selection.spanInLine(5).begin, 0);
+        QCOMPARE(selection.spanInLine(5).end, 2);
+        QVERIFY(selection.spanInLine(6).isEmpty());
+
+        for(LineType line = 2; line <= 6; ++line)
+        {
+            for(QtSizeType pos = 0; pos < 8; ++pos)
+                QCOMPARE(selection.within(line, pos), selection.spanInLine(line).contains(pos));
+        }
+
+        // Within one line the ends are ordered as well.
+        selection.start(1, 6);
+        selection.end(1, 3);
+        QCOMPARE(selection.spanInLine(1).begin, 3);
+        QCOMPARE(selection.spanInLine(1).end, 6);
+        QCOMPARE(selection.firstPosInLine(1), 3);
+        QCOMPARE(selection.lastPosInLine(1), 6);
+        QVERIFY(selection.lineWithin(1));
+        QVERIFY(!selection.lineWithin(2));
+
+        selection.reset();
+        QVERIFY(!selection.lineWithin(1));
+        QVERIFY(!selection.within(1, 4));
+    }
+};
+
+QTEST_MAIN(SelectionTest);
+
+#include "SelectionTest.moc"
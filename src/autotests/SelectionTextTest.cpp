@@ -0,0 +1,83 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QSharedPointer>
+#include <QTest>
+#include <QtGlobal>
+
+#include "../diff.h"
+#include "../SelectionText.h"
+
+class SelectionTextTest: public QObject
+{
+    Q_OBJECT
+  private:
+    QSharedPointer<QString> mBuffer = QSharedPointer<QString>::create(QStringLiteral("one\ntwo\nthree\n"));
+    LineData mOne{mBuffer, 0, 3};
+    LineData mTwo{mBuffer, 4, 3};
+    LineData mThree{mBuffer, 8, 5};
+
+    static QString lineEnds(QString text)
+    {
+#if defined(Q_OS_WIN)
+        text.replace(QStringLiteral("\n"), QStringLiteral("\r\n"));
+#endif
+        return text;
+    }
+
+  private Q_SLOTS:
+    void buildsText()
+    {
+        SelectionText text;
+        QVERIFY(text.isEmpty());
+
+        text.append(mOne, 1);
+        text.appendLineEnd();
+        text.append(mTwo);
+        text.appendLineEnd();
+        text.append(QStringLiteral("<Merge Conflict>"));
+        text.appendLineEnd();
+        text.append(mThree, 0, 2);
+
+        QVERIFY(!text.isEmpty());
+        QCOMPARE(text.toString(), lineEnds(QStringLiteral("ne\ntwo\n<Merge Conflict>\nth")));
+        QCOMPARE(text.length(), (qint64)26);
+    }
+
+    void ignoresEmptyParts()
+    {
+        SelectionText text;
+        text.append(mOne, 3);
+        text.append(mTwo, 1, 0);
+        text.append(QString());
+        QVERIFY(text.isEmpty());
+    }
+
+    void outlivesTheBuffer()
+    {
+        SelectionText text;
+        text.append(mOne);
+        text.appendLineEnd();
+        text.append(mTwo);
+
+        // A reload replaces the text in place.
+        const QString expected = lineEnds(QStringLiteral("one\ntwo"));
+        *mBuffer = QStringLiteral("changed");
+        QCOMPARE(text.toString(), expected);
+
+        SelectionMimeData mimeData(text);
+        QVERIFY(mimeData.hasText());
+        QVERIFY(mimeData.formats().contains(QStringLiteral("text/plain")));
+        QCOMPARE(mimeData.text(), expected);
+    }
+};
+
+QTEST_MAIN(SelectionTextTest);
+
+#include "SelectionTextTest.moc"
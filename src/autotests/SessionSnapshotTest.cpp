@@ -0,0 +1,136 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../SessionSnapshot.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+class SessionSnapshotTest: public QObject
+{
+    Q_OBJECT
+  private:
+    // Lines the way SourceData splits them: the terminated last line is followed by an empty one and the end.
+    static SessionSnapshot::Input input(const QString& fileName, const QString& text)
+    {
+        SessionSnapshot::Input input;
+        input.fileName = fileName;
+        input.encodingName = "UTF-8";
+        input.lastModified = QDateTime::fromMSecsSinceEpoch(1600000000123, Qt::UTC);
+        input.size = text.toUtf8().size();
+        input.decoded.eLineEndStyle = eLineEndStyleUnix;
+        input.decoded.bHasEOLTermination = true;
+
+        const QSharedPointer<QString> buffer = QSharedPointer<QString>::create(text);
+        input.decoded.lines = std::make_shared<LineDataVector>();
+        input.decoded.lines->setBuffer(buffer);
+        QtSizeType offset = 0;
+        for(const QString& line: text.split('\n'))
+        {
+            input.decoded.lines->push_back(LineData(buffer, offset, line.size(), line.isEmpty() ? 0 : 1, false, line.startsWith(QStringLiteral("//"))));
+            offset += line.size() + 1;
+        }
+        input.decoded.lines->push_back(LineData(buffer, text.size()));
+        return input;
+    }
+
+    static void compareLines(const LineDataVector& loaded, const LineDataVector& saved)
+    {
+        QCOMPARE(loaded.size(), saved.size());
+        QCOMPARE(*loaded.buffer(), *saved.buffer());
+        for(size_t i = 0; i < saved.size(); ++i)
+        {
+            QCOMPARE(loaded[i].getLine(), saved[i].getLine());
+            QCOMPARE(loaded[i].getOffset(), saved[i].getOffset());
+            QCOMPARE(loaded[i].getFirstNonWhiteChar(), saved[i].getFirstNonWhiteChar());
+            QCOMPARE(loaded[i].isPureComment(), saved[i].isPureComment());
+            QVERIFY(loaded[i].getBuffer() == loaded.buffer().data());
+        }
+    }
+
+  private Q_SLOTS:
+    void roundTrip()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("snapshot"));
+
+        SessionSnapshot saved;
+        saved.addInput(input(QStringLiteral("/a.cpp"), QStringLiteral("// ä\nint a;\n")));
+        saved.addInput(input(QStringLiteral("/b.cpp"), QStringLiteral("// ä\nint b;\nint c;\n")));
+        saved.setSettings({1, true, false});
+        // Line counts are 3 and 4, the empty line after the last terminated line included.
+        const DiffList diffList = {{1, 1, 2}, {1, 0, 0}};
+        saved.setLineMatching(SessionSnapshot::AB, diffList);
+        QVERIFY(saved.save(fileName));
+
+        SessionSnapshot loaded;
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.inputs().size(), (size_t)2);
+        for(size_t i = 0; i < 2; ++i)
+        {
+            const SessionSnapshot::Input& in = loaded.inputs()[i];
+            const SessionSnapshot::Input& out = saved.inputs()[i];
+            QCOMPARE(in.fileName, out.fileName);
+            QCOMPARE(in.encodingName, out.encodingName);
+            QCOMPARE(in.lastModified, out.lastModified);
+            QCOMPARE(in.size, out.size);
+            QCOMPARE(in.decoded.eLineEndStyle, out.decoded.eLineEndStyle);
+            QCOMPARE(in.decoded.bHasEOLTermination, out.decoded.bHasEOLTermination);
+            compareLines(*in.decoded.lines, *out.decoded.lines);
+        }
+
+        QCOMPARE(loaded.settings().lineDiffAlgorithm, 1);
+        QVERIFY(loaded.settings().bTryHard);
+        QVERIFY(!loaded.settings().bIgnoreNumbers);
+        QVERIFY(loaded.lineMatching(SessionSnapshot::AB) != nullptr);
+        QCOMPARE(loaded.lineMatching(SessionSnapshot::AB)->size(), diffList.size());
+        QCOMPARE(loaded.lineMatching(SessionSnapshot::AB)->front().diff2(), (quint64)2);
+        QVERIFY(loaded.lineMatching(SessionSnapshot::AC) == nullptr);
+    }
+
+    void rejectsDamage()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath(QStringLiteral("snapshot"));
+
+        SessionSnapshot saved;
+        saved.addInput(input(QStringLiteral("/a"), QStringLiteral("a\n")));
+        saved.addInput(input(QStringLiteral("/b"), QStringLiteral("b\n")));
+        // Doesn't cover the lines of both inputs.
+        saved.setLineMatching(SessionSnapshot::AB, DiffList{{1, 0, 0}});
+        QVERIFY(saved.save(fileName));
+
+        SessionSnapshot loaded;
+        QVERIFY(!loaded.load(fileName));
+        QVERIFY(!loaded.errorString().isEmpty());
+        QVERIFY(loaded.inputs().empty());
+
+        saved.setLineMatching(SessionSnapshot::AB, DiffList{{1, 1, 1}});
+        QVERIFY(saved.save(fileName));
+        QVERIFY(loaded.load(fileName));
+
+        QFile file(fileName);
+        QVERIFY(file.resize(QFileInfo(fileName).size() - 4));
+        QVERIFY(!loaded.load(fileName));
+
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a snapshot");
+        file.close();
+        QVERIFY(!loaded.load(fileName));
+        QVERIFY(!loaded.load(dir.filePath(QStringLiteral("missing"))));
+    }
+};
+
+QTEST_MAIN(SessionSnapshotTest);
+
+#include "SessionSnapshotTest.moc"
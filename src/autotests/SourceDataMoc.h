@@ -19,6 +19,8 @@ class SourceDataMoc: public SourceData
     QSharedPointer<Options> defualtOptions = QSharedPointer<Options>::create();
 
   public:
+    using SourceData::detectUTF8;
+
     SourceDataMoc()
     {
         setOptions(defualtOptions);
@@ -0,0 +1,90 @@
+// clang-format off
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+// clang-format on
+
+#include "../options.h"
+#include "../StreamingDiff.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QTemporaryFile>
+#include <QTextCodec>
+#include <QString>
+#include <QTest>
+
+class StreamingDiffTest: public QObject
+{
+    Q_OBJECT;
+  private:
+    QSharedPointer<Options> mOptions = QSharedPointer<Options>::create();
+
+    // Lines l0 ... l29, lines in changed are replaced.
+    static bool writeLines(QTemporaryFile& file, const std::vector<int>& changed = {})
+    {
+        if(!file.open())
+            return false;
+
+        for(int i = 0; i < 30; ++i)
+        {
+            const bool bChanged = std::find(changed.begin(), changed.end(), i) != changed.end();
+            file.write(QString(bChanged ? "x%1\n" : "l%1\n").arg(i).toUtf8());
+        }
+        file.close();
+        return true;
+    }
+
+    static std::vector<StreamingDiff::Hunk> hunks(StreamingDiff& streamingDiff)
+    {
+        std::vector<StreamingDiff::Hunk> result;
+        streamingDiff.forEachHunk([&result](const StreamingDiff::Hunk& hunk) {
+            result.push_back(hunk);
+            return true;
+        });
+        return result;
+    }
+
+  private Q_SLOTS:
+    void testEqualFiles()
+    {
+        QTemporaryFile file1, file2;
+        QVERIFY(writeLines(file1) && writeLines(file2));
+
+        StreamingDiff streamingDiff(mOptions, 8);
+        QVERIFY(streamingDiff.run(file1.fileName(), file2.fileName(), QTextCodec::codecForName("UTF-8")));
+        QVERIFY(streamingDiff.isEqual());
+        QCOMPARE(streamingDiff.lineCount1(), (qint64)30);
+        QCOMPARE(streamingDiff.lineCount2(), (qint64)30);
+    }
+
+    void testChangeAcrossWindows()
+    {
+        QTemporaryFile file1, file2;
+        QVERIFY(writeLines(file1) && writeLines(file2, {6, 7, 8, 9, 25}));
+
+        StreamingDiff streamingDiff(mOptions, 8);
+        QVERIFY(streamingDiff.run(file1.fileName(), file2.fileName(), QTextCodec::codecForName("UTF-8")));
+        QCOMPARE(streamingDiff.hunkCount(), (qint64)2);
+        QCOMPARE(streamingDiff.differingLines1(), (qint64)5);
+        QCOMPARE(streamingDiff.differingLines2(), (qint64)5);
+
+        const std::vector<StreamingDiff::Hunk> result = hunks(streamingDiff);
+        QCOMPARE(result.size(), (size_t)2);
+        QCOMPARE(result[0].line1, (qint64)6);
+        QCOMPARE(result[0].line2, (qint64)6);
+        QCOMPARE(result[0].count1, (qint64)4);
+        QCOMPARE(result[0].count2, (qint64)4);
+        QCOMPARE(result[1].line1, (qint64)25);
+        QCOMPARE(result[1].count1, (qint64)1);
+    }
+};
+
+QTEST_MAIN(StreamingDiffTest);
+
+#include "StreamingDiffTest.moc"
@@ -0,0 +1,96 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves <reeves.87@gmail.com>
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include "../TaskExecutor.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QTest>
+
+class TaskExecutorTest: public QObject
+{
+    Q_OBJECT
+  private Q_SLOTS:
+    void cleanup()
+    {
+        TaskExecutor::instance().setMaxThreadCount(0);
+    }
+
+    void threadCount()
+    {
+        TaskExecutor::instance().setMaxThreadCount(3);
+        QCOMPARE(TaskExecutor::instance().maxThreadCount(), 3);
+        TaskExecutor::instance().setMaxThreadCount(0);
+        QVERIFY(TaskExecutor::instance().maxThreadCount() >= 1);
+    }
+
+    void priority()
+    {
+        TaskExecutor& executor = TaskExecutor::instance();
+        executor.setMaxThreadCount(1);
+
+        // Keeps the only thread busy until all tasks are queued.
+        QSemaphore blocker;
+        const std::shared_ptr<TaskGroup> pGroup = std::make_shared<TaskGroup>();
+        executor.start([&blocker]() { blocker.acquire(); }, TaskExecutor::Priority::interactive, pGroup);
+
+        QMutex mutex;
+        std::vector<int> order;
+        const auto record = [&mutex, &order](int i) {
+            return [&mutex, &order, i]() {
+                QMutexLocker locker(&mutex);
+                order.push_back(i);
+            };
+        };
+        executor.start(record(0), TaskExecutor::Priority::background, pGroup);
+        executor.start(record(1), TaskExecutor::Priority::visible, pGroup);
+        executor.start(record(2), TaskExecutor::Priority::interactive, pGroup);
+
+        blocker.release();
+        QVERIFY(pGroup->wait(10000));
+        QCOMPARE(order, std::vector<int>({2, 1, 0}));
+    }
+
+    void cancel()
+    {
+        TaskExecutor& executor = TaskExecutor::instance();
+        executor.setMaxThreadCount(1);
+
+        QSemaphore blocker;
+        const std::shared_ptr<TaskGroup> pGroup = std::make_shared<TaskGroup>();
+        const std::shared_ptr<TaskGroup> pOther = std::make_shared<TaskGroup>();
+        std::atomic<int> runs{0};
+        executor.start([&blocker]() { blocker.acquire(); }, TaskExecutor::Priority::interactive, pOther);
+        for(int i = 0; i < 5; ++i)
+            executor.start([&runs]() { ++runs; }, TaskExecutor::Priority::background, pGroup);
+        executor.start([&runs]() { runs += 100; }, TaskExecutor::Priority::background, pOther);
+
+        QVERIFY(!pGroup->wait(0));
+        pGroup->cancel();
+        blocker.release();
+        QVERIFY(pGroup->wait(10000));
+        QVERIFY(pOther->wait(10000));
+        // Only the other group's task ran.
+        QCOMPARE(runs.load(), 100);
+
+        // Tasks started after cancel() run again.
+        executor.start([&runs]() { ++runs; }, TaskExecutor::Priority::background, pGroup);
+        QVERIFY(pGroup->wait(10000));
+        QCOMPARE(runs.load(), 101);
+    }
+};
+
+QTEST_GUILESS_MAIN(TaskExecutorTest);
+
+#include "TaskExecutorTest.moc"
@@ -0,0 +1,86 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2021 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+#include <QTest>
+#include <QtGlobal>
+
+#include "../diff.h"
+#include "../TextSearchIndex.h"
+
+class TextSearchIndexTest: public QObject
+{
+    Q_OBJECT
+  private:
+    // Splits text at '\n' into lines viewing one shared buffer, the way SourceData sets them up.
+    static LineDataVector makeLines(const QString& text)
+    {
+        QSharedPointer<QString> buffer = QSharedPointer<QString>::create(text);
+        LineDataVector lines;
+        lines.setBuffer(buffer);
+
+        QtSizeType offset = 0;
+        for(const QString& line: text.split('\n'))
+        {
+            lines.push_back(LineData(buffer, offset, line.length()));
+            offset += line.length() + 1;
+        }
+        return lines;
+    }
+
+  private Q_SLOTS:
+    void findsAllHits()
+    {
+        const LineDataVector lines = makeLines("foo bar foo\nbar\nxfoo\n");
+        TextSearchIndex index;
+
+        const std::vector<TextSearchIndex::Hit>& hits = index.hits(lines, "foo", true);
+        QCOMPARE(hits.size(), size_t(3));
+        QCOMPARE(hits[0].line, 0);
+        QCOMPARE(hits[0].pos, QtSizeType(0));
+        QCOMPARE(hits[1].line, 0);
+        QCOMPARE(hits[1].pos, QtSizeType(8));
+        QCOMPARE(hits[2].line, 2);
+        QCOMPARE(hits[2].pos, QtSizeType(1));
+    }
+
+    void caseAndOverlap()
+    {
+        const LineDataVector lines = makeLines("aaa\nAaA");
+        TextSearchIndex index;
+
+        QCOMPARE(index.hits(lines, "aa", true).size(), size_t(2));
+        // Switching case sensitivity must not return the cached hits.
+        QCOMPARE(index.hits(lines, "aa", false).size(), size_t(4));
+    }
+
+    void noHitAcrossLines()
+    {
+        const LineDataVector lines = makeLines("ab\ncd");
+        TextSearchIndex index;
+
+        QVERIFY(index.hits(lines, "b\nc", true).empty());
+        QVERIFY(index.hits(lines, "bc", true).empty());
+        QCOMPARE(index.hits(lines, "c", true).size(), size_t(1));
+    }
+
+    void clear()
+    {
+        LineDataVector lines = makeLines("one\ntwo");
+        TextSearchIndex index;
+        QCOMPARE(index.hits(lines, "two", true).size(), size_t(1));
+
+        lines = makeLines("two\ntwo");
+        index.clear();
+        QCOMPARE(index.hits(lines, "two", true).size(), size_t(2));
+    }
+};
+
+QTEST_MAIN(TextSearchIndexTest);
+
+#include "TextSearchIndexTest.moc"
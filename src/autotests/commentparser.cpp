@@ -310,6 +310,45 @@ class CommentParserTest : public QObject
         QVERIFY(!test.isPureComment());
     }
 
+    void plainLines()
+    {
+        DefaultCommentParser test;
+
+        test.processLine("// comment");
+        QVERIFY(test.isSkipable());
+        QVERIFY(test.isPureComment());
+
+        //white space only keeps the state of the line before
+        test.processLine("   ");
+        QVERIFY(!test.inComment());
+        QVERIFY(test.isSkipable());
+        QVERIFY(!test.isPureComment());
+
+        test.processLine("int i;");
+        QVERIFY(!test.inComment());
+        QVERIFY(!test.isSkipable());
+        QVERIFY(!test.isPureComment());
+
+        test.processLine("i = 1; /* start");
+        QVERIFY(test.inComment());
+        QVERIFY(!test.isSkipable());
+
+        test.processLine("\tplain text");
+        QVERIFY(test.inComment());
+        QVERIFY(test.isSkipable());
+        QVERIFY(test.isPureComment());
+
+        test.processLine("end */");
+        QVERIFY(!test.inComment());
+        QVERIFY(test.isSkipable());
+        QVERIFY(test.isPureComment());
+
+        test.processLine("  i = 2;");
+        QVERIFY(!test.inComment());
+        QVERIFY(!test.isSkipable());
+        QVERIFY(!test.isPureComment());
+    }
+
     void removeComment()
     {
         DefaultCommentParser test;
@@ -89,6 +89,185 @@ class DataReadTest: public QObject
         QCOMPARE(simData.getSizeBytes(), file.size());
     }
 
+    void testDetectUTF8()
+    {
+        QVERIFY(SourceDataMoc::detectUTF8("plain ascii\n") == nullptr);
+        QVERIFY(SourceDataMoc::detectUTF8("h\xC3\xA9llo") != nullptr);
+        // A sequence cut off at the end of the sample is not an error.
+        QVERIFY(SourceDataMoc::detectUTF8("h\xC3\xA9llo\xE2\x82") != nullptr);
+        QVERIFY(SourceDataMoc::detectUTF8("hello\xE2\x82") == nullptr);
+
+        QVERIFY(SourceDataMoc::detectUTF8("\xC3\x28") == nullptr);
+        QVERIFY(SourceDataMoc::detectUTF8("caf\xE9 ok") == nullptr);
+        // Overlong form and surrogate
+        QVERIFY(SourceDataMoc::detectUTF8("\xC0\xAF") == nullptr);
+        QVERIFY(SourceDataMoc::detectUTF8("\xED\xA0\x80") == nullptr);
+    }
+
+    void testSampledDetection()
+    {
+        QTemporaryFile testFile;
+        SourceDataMoc simData;
+        const QByteArray filler = QByteArray(100 * 1024, 'x') + '\n';
+
+        // UTF-8 first seen after the head of the old sample.
+        testFile.open();
+        testFile.write(QByteArray(1024, 'x') + "\nh\xC3\xA9llo\n");
+        testFile.close();
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess(QTextCodec::codecForName("ISO-8859-1"), true);
+        QVERIFY(simData.getErrors().isEmpty());
+        QCOMPARE(simData.getEncoding()->mibEnum(), 106);
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getLine(), QString::fromUtf8(u8"h\u00E9llo"));
+
+        // Latin-1 past the sample, the UTF-8 guess is dropped by the decode.
+        testFile.resize(0);
+        testFile.open();
+        testFile.write("h\xC3\xA9llo\n" + filler + "caf\xE9\n");
+        testFile.close();
+        simData.reset();
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess(QTextCodec::codecForName("ISO-8859-1"), true);
+        QVERIFY(simData.getErrors().isEmpty());
+        QCOMPARE(simData.getEncoding()->mibEnum(), 4);
+        QVERIFY(!simData.isIncompleteConversion());
+        QCOMPARE((*simData.getLineDataForDisplay())[2].getLine(), QString::fromUtf8(u8"caf\u00E9"));
+    }
+
+    void testDecode()
+    {
+        QTemporaryFile testFile;
+        SourceDataMoc simData;
+
+        testFile.open();
+        testFile.write("caf\xE9\nplain\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess(QTextCodec::codecForName("ISO-8859-1"), false);
+        QVERIFY(simData.getErrors().isEmpty());
+        QVERIFY(!simData.isIncompleteConversion());
+        QCOMPARE((*simData.getLineDataForDisplay())[0].getLine(), QString::fromUtf8(u8"caf\u00E9"));
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getLine(), QString("plain"));
+
+        testFile.resize(0);
+        testFile.open();
+        testFile.write("only ascii\n");
+        testFile.close();
+
+        simData.reset();
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(simData.getErrors().isEmpty());
+        QVERIFY(!simData.isIncompleteConversion());
+        QCOMPARE((*simData.getLineDataForDisplay())[0].getLine(), QString("only ascii"));
+    }
+
+    void testRedecode()
+    {
+        QTemporaryFile testFile;
+        SourceDataMoc simData;
+
+        testFile.open();
+        testFile.write("caf\xC3\xA9\nplain\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess(QTextCodec::codecForName("ISO-8859-1"), false);
+        QCOMPARE((*simData.getLineDataForDisplay())[0].getLine(), QString::fromUtf8(u8"caf\u00C3\u00A9"));
+
+        // The same encoding leaves the data as it is.
+        const quint64 generation = simData.generation();
+        QVERIFY(simData.redecode(QTextCodec::codecForName("ISO-8859-1")));
+        QCOMPARE(simData.generation(), generation);
+
+        QVERIFY(simData.redecode(QTextCodec::codecForName("UTF-8")));
+        QVERIFY(simData.generation() != generation);
+        QVERIFY(simData.getErrors().isEmpty());
+        QCOMPARE(simData.getEncoding(), QTextCodec::codecForName("UTF-8"));
+        QCOMPARE(simData.getSizeLines(), 3);
+        QCOMPARE((*simData.getLineDataForDisplay())[0].getLine(), QString::fromUtf8(u8"caf\u00E9"));
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getLine(), QString("plain"));
+
+        // Nothing was read yet.
+        SourceDataMoc emptyData;
+        QVERIFY(!emptyData.redecode(QTextCodec::codecForName("UTF-8")));
+    }
+
+    // Text larger than a buffer is split between lines and reads the same as in one buffer.
+    void testChunkedText()
+    {
+        QTemporaryFile testFile;
+        QByteArray data;
+        for(int i = 0; i < 20; ++i)
+            data += "line " + QByteArray::number(i) + " caf\xC3\xA9\r\n";
+        testFile.open();
+        testFile.write(data);
+        testFile.close();
+
+        QSharedPointer<SourceDataMoc> wholeData = QSharedPointer<SourceDataMoc>::create();
+        wholeData->setFilename(testFile.fileName());
+        wholeData->readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(wholeData->getErrors().isEmpty());
+        QCOMPARE(wholeData->getTextBuffers().size(), (size_t)1);
+
+        // Pieces of 32 bytes cut into the UTF-8 sequences and the "\r\n" pairs.
+        QSharedPointer<SourceDataMoc> chunkedData = QSharedPointer<SourceDataMoc>::create();
+        chunkedData->setChunkSize(64);
+        chunkedData->setFilename(testFile.fileName());
+        chunkedData->readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(chunkedData->getErrors().isEmpty());
+        QVERIFY(chunkedData->getTextBuffers().size() > 1);
+        QVERIFY(!chunkedData->isIncompleteConversion());
+        QCOMPARE(chunkedData->getSizeLines(), 21);
+
+        const LineDataVector& lines = *chunkedData->getLineDataForDisplay();
+        for(int i = 0; i < 20; ++i)
+            QCOMPARE(lines[i].getLine(), QString::fromUtf8("line " + QByteArray::number(i) + " caf\xC3\xA9"));
+        QVERIFY(lines.front().getBuffer() != lines[19].getBuffer());
+        QVERIFY(chunkedData->isTextEqualWith(wholeData));
+        QVERIFY(wholeData->isTextEqualWith(chunkedData));
+
+        // A line longer than half a buffer doesn't fit.
+        testFile.resize(0);
+        testFile.open();
+        testFile.write(QByteArray(100, 'x') + '\n');
+        testFile.close();
+        chunkedData->reset();
+        chunkedData->setFilename(testFile.fileName());
+        chunkedData->readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(chunkedData->isTooLarge());
+    }
+
+    void testCompressText()
+    {
+        QTemporaryFile testFile;
+        QByteArray data;
+        for(int i = 0; i < 1000; ++i)
+            data += "line " + QByteArray::number(i) + '\n';
+        testFile.open();
+        testFile.write(data);
+        testFile.close();
+
+        QSharedPointer<SourceDataMoc> sourceData = QSharedPointer<SourceDataMoc>::create();
+        sourceData->setChunkSize(2000);
+        sourceData->setFilename(testFile.fileName());
+        sourceData->readAndPreprocess(QTextCodec::codecForName("UTF-8"), false);
+        QVERIFY(sourceData->getErrors().isEmpty());
+        QVERIFY(sourceData->getTextBuffers().size() > 1);
+
+        sourceData->compressText();
+        QVERIFY(sourceData->isTextCompressed());
+        for(const QSharedPointer<QString>& pBuffer: sourceData->getTextBuffers())
+            QVERIFY(pBuffer->isEmpty());
+
+        QVERIFY(sourceData->decompressText());
+        QVERIFY(!sourceData->isTextCompressed());
+        const LineDataVector& lines = *sourceData->getLineDataForDisplay();
+        for(int i = 0; i < 1000; ++i)
+            QCOMPARE(lines[i].getLine(), QString("line " + QString::number(i)));
+    }
+
     void testEOLStyle()
     {
         QTemporaryFile testFile;
@@ -11,18 +11,22 @@
 #include "diff.h"
 #include <QtGlobal>
 
-#include "gnudiff_diff.h"
 #include "Logging.h"
 #include "options.h"
 #include "ProgressProxy.h"
+#include "TaskExecutor.h"
+#include "Trace.h"
 #include "Utils.h"
 
 #include <algorithm>           // for min
+#include <atomic>
 #include <cstdlib>
 #include <ctype.h>
 #include <exception>
 #include <memory>
+#include <unordered_map>
 #include <utility>             // for swap
+#include <vector>
 
 #ifndef AUTOTEST
 #include <KLocalizedString>
@@ -30,6 +34,7 @@
 #endif
 
 #include <QRegularExpression>
+#include <QSemaphore>
 #include <QSharedPointer>
 #include <QTextStream>
 
@@ -39,10 +44,18 @@ QSharedPointer<DiffBufferInfo> Diff3Line::m_pDiffBufferInfo = QSharedPointer<Dif
 
 int LineData::width(int tabSize) const
 {
-    const QString pLine = getLine();
+    // Most lines have no tab, their width is their size.
+    if(bHasFingerprints && !bContainsTab)
+        return mSize;
+
+    return width(getLine(), tabSize);
+}
+
+int LineData::width(const QString& pLine, int tabSize)
+{
     int w = 0;
     int j = 0;
-    for(QtSizeType i = 0; i < size(); ++i)
+    for(QtSizeType i = 0; i < pLine.size(); ++i)
     {
         if(pLine[i] == '\t')
         {
@@ -59,6 +72,86 @@ int LineData::width(int tabSize) const
     return w;
 }
 
+// 32-bit FNV-1a, computed once per line so most unequal lines are told apart by one compare.
+namespace {
+// Characters line matching skips, numbers only if they are ignored.
+inline bool isIgnoredForLineMatching(const QChar c, const bool bIgnoreNumbers)
+{
+    return isspace(c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'));
+}
+} // namespace
+
+void LineData::calcFingerprints()
+{
+    quint32 raw = 0x811C9DC5U;
+    quint32 whiteSpaceFree = 0x811C9DC5U;
+    quint32 numberFree = 0x811C9DC5U;
+    bool bTab = false;
+    const QChar* p = mBuffer->constData() + mOffset;
+
+    for(qint32 i = 0; i < mSize; ++i)
+    {
+        const char16_t c = p[i].unicode();
+        raw = (raw ^ c) * 0x01000193U;
+        if(!isspace(c))
+        {
+            whiteSpaceFree = (whiteSpaceFree ^ c) * 0x01000193U;
+            if(!isIgnoredForLineMatching(p[i], true))
+                numberFree = (numberFree ^ c) * 0x01000193U;
+        }
+        else if(c == '\t')
+            bTab = true;
+    }
+
+    mRawFingerprint = raw;
+    mWhiteSpaceFreeFingerprint = whiteSpaceFree;
+    mNumberFreeFingerprint = numberFree;
+    bContainsTab = bTab;
+    bHasFingerprints = true;
+}
+
+int LineDataVector::maxWidth(const int tabSize) const
+{
+    if(tabSize != mMaxWidthTabSize || size() < mMaxWidthLines)
+    {
+        mMaxWidth = 0;
+        mMaxWidthTabSize = tabSize;
+        mMaxWidthLines = 0;
+    }
+
+    for(; mMaxWidthLines < size(); ++mMaxWidthLines)
+        mMaxWidth = std::max(mMaxWidth, (*this)[mMaxWidthLines].width(tabSize));
+    return mMaxWidth;
+}
+
+quint32 LineData::calcLineMatchFingerprint(const bool bIgnoreNumbers) const
+{
+    LineData copy = *this;
+    copy.calcFingerprints();
+    return copy.lineMatchFingerprint(bIgnoreNumbers);
+}
+
+bool LineData::lineMatchEqual(const LineData& l1, const LineData& l2, const bool bIgnoreNumbers)
+{
+    if(l1.bHasFingerprints && l2.bHasFingerprints && l1.lineMatchFingerprint(bIgnoreNumbers) != l2.lineMatchFingerprint(bIgnoreNumbers))
+        return false;
+
+    const QChar* p1 = l1.mBuffer->constData() + l1.mOffset;
+    const QChar* p2 = l2.mBuffer->constData() + l2.mOffset;
+    const QChar* const p1End = p1 + l1.mSize;
+    const QChar* const p2End = p2 + l2.mSize;
+    for(;; ++p1, ++p2)
+    {
+        while(p1 != p1End && isIgnoredForLineMatching(*p1, bIgnoreNumbers)) ++p1;
+        while(p2 != p2End && isIgnoredForLineMatching(*p2, bIgnoreNumbers)) ++p2;
+
+        if(p1 == p1End || p2 == p2End)
+            return p1 == p1End && p2 == p2End;
+        if(*p1 != *p2)
+            return false;
+    }
+}
+
 /*
     Implement support for g_bIgnoreWhiteSpace
 */
@@ -70,6 +163,8 @@ bool LineData::equal(const LineData& l1, const LineData& l2)
     {
         if(l1.size() != l2.size())
             return false;
+        if(l1.bHasFingerprints && l2.bHasFingerprints && l1.mWhiteSpaceFreeFingerprint != l2.mWhiteSpaceFreeFingerprint)
+            return false;
         // Ignore white space diff
         const QString line1 = l1.getLine(), line2 = l2.getLine();
         QString::const_iterator p1 = line1.begin();
@@ -90,14 +185,14 @@ bool LineData::equal(const LineData& l1, const LineData& l2)
     }
     else
     {
-        const QString line1 = l1.getLine(), line2 = l2.getLine();
-        return (l1.size() == l2.size() && QString::compare(line1, line2) == 0);
+        return l1.rawEqual(l2);
     }
 }
 
 // First step
 void Diff3LineList::calcDiff3LineListUsingAB(const DiffList* pDiffListAB)
 {
+    TraceScope traceScope(TraceStage::align);
     // First make d3ll for AB (from pDiffListAB)
 
     LineRef lineA = 0;
@@ -166,6 +261,7 @@ void Diff3LineList::calcDiff3LineListUsingAB(const DiffList* pDiffListAB)
 // Second step
 void Diff3LineList::calcDiff3LineListUsingAC(const DiffList* pDiffListAC)
 {
+    TraceScope traceScope(TraceStage::align);
     ////////////////
     // Now insert data from C using pDiffListAC
 
@@ -223,9 +319,110 @@ void Diff3LineList::calcDiff3LineListUsingAC(const DiffList* pDiffListAC)
     }
 }
 
+/*
+    First and second step in one sweep. The rows for A <-> B are produced in order and the lines
+    of C are added while they are written, so nothing is searched for or inserted into the middle
+    of the list afterwards. The result is the same as calcDiff3LineListUsingAB() followed by
+    calcDiff3LineListUsingAC(), debugAlignmentCheck() compares the two.
+*/
+void Diff3LineList::calcDiff3LineListUsingABAndAC(const DiffList* pDiffListAB, const DiffList* pDiffListAC)
+{
+    TraceScope traceScope(TraceStage::align);
+    DiffList::const_iterator iAB = pDiffListAB->cbegin();
+    Diff restAB = iAB != pDiffListAB->cend() ? *iAB : Diff();
+    LineRef lineA = 0;
+    LineRef lineB = 0;
+
+    // Next row calcDiff3LineListUsingAB() would create.
+    const auto nextRowAB = [&](Diff3Line& d3l) -> bool {
+        while(restAB.isEmpty())
+        {
+            if(iAB == pDiffListAB->cend() || ++iAB == pDiffListAB->cend())
+                return false;
+            restAB = *iAB;
+        }
+
+        d3l = Diff3Line();
+        if(restAB.numberOfEquals() > 0)
+        {
+            d3l.bAEqB = true;
+            d3l.setLineA(lineA++);
+            d3l.setLineB(lineB++);
+            restAB.adjustNumberOfEquals(-1);
+        }
+        else if(restAB.diff1() > 0 && restAB.diff2() > 0)
+        {
+            d3l.setLineA(lineA++);
+            d3l.setLineB(lineB++);
+            restAB.adjustDiff1(-1);
+            restAB.adjustDiff2(-1);
+        }
+        else if(restAB.diff1() > 0)
+        {
+            d3l.setLineA(lineA++);
+            restAB.adjustDiff1(-1);
+        }
+        else
+        {
+            d3l.setLineB(lineB++);
+            restAB.adjustDiff2(-1);
+        }
+        return true;
+    };
+
+    LineRef lineAC = 0;
+    LineRef lineC = 0;
+    for(const Diff& d: *pDiffListAC)
+    {
+        assert(d.diff1() <= limits<LineType>::max() && d.diff2() <= limits<LineType>::max());
+
+        for(qint32 i = 0; i < d.numberOfEquals(); ++i)
+        {
+            // Rows before the one with the corresponding lineA stay as they are.
+            Diff3Line d3l;
+            bool bFound = false;
+            while(nextRowAB(d3l))
+            {
+                if(d3l.getLineA() == lineAC)
+                {
+                    bFound = true;
+                    break;
+                }
+                push_back(d3l);
+            }
+            assert(bFound);
+            if(!bFound)
+                d3l = Diff3Line();
+
+            d3l.setLineC(lineC);
+            d3l.bAEqC = true;
+            d3l.bBEqC = d3l.isEqualAB();
+            push_back(d3l);
+
+            ++lineAC;
+            ++lineC;
+        }
+
+        // Lines of A without a match in C keep their rows, the ones of C get rows of their own.
+        lineAC += (LineRef)d.diff1();
+        for(quint64 i = 0; i < d.diff2(); ++i)
+        {
+            Diff3Line d3l;
+            d3l.setLineC(lineC);
+            push_back(d3l);
+            ++lineC;
+        }
+    }
+
+    Diff3Line d3l;
+    while(nextRowAB(d3l))
+        push_back(d3l);
+}
+
 // Third step
 void Diff3LineList::calcDiff3LineListUsingBC(const DiffList* pDiffListBC)
 {
+    TraceScope traceScope(TraceStage::align);
     ////////////////
     // Now improve the position of data from C using pDiffListBC
     // If a line from C equals a line from A then it is in the
@@ -579,11 +776,195 @@ int ManualDiffHelpEntry::calcManualDiffFirstDiff3LineIdx(const Diff3LineVector&
     return -1;
 }
 
+DiffContext::DiffContext(const DiffSettings& settings):
+    mSettings(settings), mEngine(LineDiffEngine::create(settings))
+{
+}
+
+DiffContext::~DiffContext() = default;
+
+namespace {
+// Inputs with fewer lines than this together are diffed in one piece.
+constexpr LineType segmentedDiffMinLines = 100000;
+// A segment ends at the first anchor after this many lines of both inputs together.
+constexpr LineType segmentMinLines = 16384;
+
+struct DiffSegment
+{
+    LineType begin1;
+    LineType size1;
+    LineType begin2;
+    LineType size2;
+};
+
+/*
+    Cuts both ranges at lines occurring exactly once in each of them that are equal apart from
+    white space, using those that are in the same order on both sides, as patience diff does. Each
+    segment starts with such an anchor, except the first one, and can be diffed on its own. Lines
+    are told apart by their fingerprints, so a collision only costs an anchor.
+*/
+std::vector<DiffSegment> findDiffSegments(const LineDataVector& v1, const size_t index1, const LineType size1,
+                                          const LineDataVector& v2, const size_t index2, const LineType size2)
+{
+    struct Slot
+    {
+        qint32 count1 = 0;
+        qint32 count2 = 0;
+        LineType pos2 = 0;
+    };
+
+    std::unordered_map<quint32, Slot> slots;
+    slots.reserve(size1);
+    for(LineType i = 0; i < size1; ++i)
+        ++slots[v1[index1 + i].whiteSpaceFreeFingerprint()].count1;
+    for(LineType j = 0; j < size2; ++j)
+    {
+        const auto it = slots.find(v2[index2 + j].whiteSpaceFreeFingerprint());
+        if(it != slots.end())
+        {
+            ++it->second.count2;
+            it->second.pos2 = j;
+        }
+    }
+
+    std::vector<std::pair<LineType, LineType>> unique;
+    for(LineType i = 0; i < size1; ++i)
+    {
+        const Slot& slot = slots[v1[index1 + i].whiteSpaceFreeFingerprint()];
+        if(slot.count1 == 1 && slot.count2 == 1 && LineData::equal(v1[index1 + i], v2[index2 + slot.pos2]))
+            unique.emplace_back(i, slot.pos2);
+    }
+
+    // Longest increasing subsequence of the positions in v2, by patience sorting.
+    std::vector<size_t> tails;
+    std::vector<size_t> previous(unique.size());
+    for(size_t k = 0; k < unique.size(); ++k)
+    {
+        const auto pile = std::lower_bound(tails.begin(), tails.end(), unique[k].second,
+                                           [&unique](const size_t t, const LineType pos2) { return unique[t].second < pos2; });
+        previous[k] = pile == tails.begin() ? k : *(pile - 1);
+        if(pile == tails.end())
+            tails.push_back(k);
+        else
+            *pile = k;
+    }
+
+    std::vector<std::pair<LineType, LineType>> anchors;
+    if(!tails.empty())
+    {
+        for(size_t k = tails.back();; k = previous[k])
+        {
+            anchors.push_back(unique[k]);
+            if(previous[k] == k)
+                break;
+        }
+        std::reverse(anchors.begin(), anchors.end());
+    }
+
+    std::vector<DiffSegment> segments;
+    LineType begin1 = 0, begin2 = 0;
+    for(const auto& anchor: anchors)
+    {
+        if((anchor.first - begin1) + (anchor.second - begin2) >= segmentMinLines)
+        {
+            segments.push_back({begin1, anchor.first - begin1, begin2, anchor.second - begin2});
+            begin1 = anchor.first;
+            begin2 = anchor.second;
+        }
+    }
+    segments.push_back({begin1, size1 - begin1, begin2, size2 - begin2});
+    return segments;
+}
+
+/*
+    Diffs the segments on the global thread pool and appends the results to diffList in order.
+    The calling thread takes segments as well, so this finishes even if the pool is busy. Pool
+    threads starting after the last segment was taken just return. Returns whether any segment
+    was cut short by the deadline.
+*/
+bool diffSegments(const std::shared_ptr<LineDataVector>& p1, const size_t index1, const std::shared_ptr<LineDataVector>& p2, const size_t index2,
+                  std::vector<DiffSegment>&& segments, const DiffSettings& settings, ProgressProxy& pp, DiffList& diffList)
+{
+    struct Batch
+    {
+        std::shared_ptr<LineDataVector> p1;
+        std::shared_ptr<LineDataVector> p2;
+        size_t index1;
+        size_t index2;
+        DiffSettings settings;
+        std::vector<DiffSegment> segments;
+        std::vector<DiffList> results;
+        std::atomic<size_t> next{0};
+        QSemaphore finished;
+        std::shared_ptr<ParallelProgress> pProgress;
+        std::atomic<bool> bApproximate{false};
+    };
+
+    const std::shared_ptr<Batch> pBatch = std::make_shared<Batch>();
+    pBatch->p1 = p1;
+    pBatch->p2 = p2;
+    pBatch->index1 = index1;
+    pBatch->index2 = index2;
+    pBatch->settings = settings;
+    pBatch->segments = std::move(segments);
+    pBatch->results.resize(pBatch->segments.size());
+    pBatch->pProgress = std::make_shared<ParallelProgress>(pBatch->segments.size());
+    pp.trackParallel(pBatch->pProgress);
+
+    const auto run = [](Batch& batch) {
+        // Engines keep state while diffing, every thread needs its own.
+        std::unique_ptr<LineDiffEngine> pEngine;
+        for(;;)
+        {
+            const size_t idx = batch.next.fetch_add(1);
+            if(idx >= batch.segments.size())
+                return;
+
+            const DiffSegment& segment = batch.segments[idx];
+            DiffList& result = batch.results[idx];
+            if(segment.size1 == 0 || segment.size2 == 0)
+            {
+                result.push_back(Diff(0, segment.size1, segment.size2));
+            }
+            else
+            {
+                if(pEngine == nullptr)
+                    pEngine = LineDiffEngine::create(batch.settings);
+                pEngine->diff(*batch.p1, batch.index1 + segment.begin1, segment.size1, *batch.p2, batch.index2 + segment.begin2, segment.size2, result);
+                if(pEngine->isApproximate())
+                    batch.bApproximate = true;
+            }
+            batch.pProgress->step();
+            batch.finished.release();
+        }
+    };
+
+    const size_t nofThreads = std::min<size_t>(std::max(TaskExecutor::instance().maxThreadCount(), 1), pBatch->segments.size());
+    for(size_t i = 1; i < nofThreads; ++i)
+        TaskExecutor::instance().start([pBatch, run]() { run(*pBatch); }, TaskExecutor::Priority::interactive);
+    run(*pBatch);
+    pBatch->finished.acquire((int)pBatch->segments.size());
+
+    for(DiffList& result: pBatch->results)
+    {
+        // A segment ending in equal lines continues in the equal lines starting the next one.
+        if(!diffList.empty() && diffList.back().diff1() == 0 && diffList.back().diff2() == 0)
+        {
+            result.front().adjustNumberOfEquals(diffList.back().numberOfEquals());
+            diffList.pop_back();
+        }
+        diffList.splice(diffList.end(), result);
+    }
+    return pBatch->bApproximate;
+}
+} // namespace
+
 void DiffList::runDiff(const std::shared_ptr<LineDataVector> &p1, const size_t index1, LineRef size1, const std::shared_ptr<LineDataVector> &p2, const size_t index2, LineRef size2,
-                    const QSharedPointer<Options> &pOptions)
+                    DiffContext& context)
 {
+    TraceScope traceScope(TraceStage::diff);
+    traceScope.setItems((LineType)size1 + (LineType)size2);
     ProgressProxy pp;
-    static GnuDiff gnuDiff; // All values are initialized with zeros.
 
     pp.setCurrent(0);
 
@@ -601,69 +982,34 @@ void DiffList::runDiff(const std::shared_ptr<LineDataVector> &p1, const size_t i
     {
         assert((size_t)size1 < p1->size() && (size_t)size2 < p2->size());
 
-        GnuDiff::comparison comparisonInput;
-        memset(&comparisonInput, 0, sizeof(comparisonInput));
-        comparisonInput.parent = nullptr;
-        comparisonInput.file[0].buffer = (*p1)[index1].getBuffer()->unicode() + (*p1)[index1].getOffset();                                         //ptr to buffer
-        comparisonInput.file[0].buffered = ((*p1)[index1 + size1 - 1].getOffset() + (*p1)[index1 + size1 - 1].size() - (*p1)[index1].getOffset()); // size of buffer
-        comparisonInput.file[1].buffer = (*p2)[index2].getBuffer()->unicode() + (*p2)[index2].getOffset();                                         //ptr to buffer
-        comparisonInput.file[1].buffered = ((*p2)[index2 + size2 - 1].getOffset() + (*p2)[index2 + size2 - 1].size() - (*p2)[index2].getOffset()); // size of buffer
-
-        gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
-        gnuDiff.bIgnoreWhiteSpace = true;
-        gnuDiff.bIgnoreNumbers = pOptions->m_bIgnoreNumbers;
-        gnuDiff.minimal = pOptions->m_bTryHard;
-        gnuDiff.ignore_case = false;
-        GnuDiff::change* script = gnuDiff.diff_2_files(&comparisonInput);
-
-        LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
-        LineRef currentLine1 = 0;
-        LineRef currentLine2 = 0;
-        GnuDiff::change* p = nullptr;
-        for(GnuDiff::change* e = script; e; e = p)
-        {
-            Diff d((LineType)(e->line0 - currentLine1), e->deleted, e->inserted);
-            assert(d.numberOfEquals() == e->line1 - currentLine2);
-
-            currentLine1 += LineRef((quint64)d.numberOfEquals() + d.diff1());
-            currentLine2 += LineRef((quint64)d.numberOfEquals() + d.diff2());
-            assert(currentLine1 <= size1 && currentLine2 <= size2);
-            push_back(d);
-
-            p = e->link;
-            free(e);
-        }
-
-        if(empty())
+        /*
+            Huge inputs are cut at lines both have exactly once. GnuDiff costs grow faster than the
+            size of the input, so the segments together are quicker even on one thread. Ignoring
+            numbers changes which lines GnuDiff takes as equal, the fingerprints don't know that.
+        */
+        const DiffSettings& settings = context.settings();
+        std::vector<DiffSegment> segments;
+        if(settings.lineDiffAlgorithm() == LineDiffAlgorithm::gnuDiff && settings.parallelDiff() && !settings.ignoreNumbers() &&
+           (LineType)size1 + (LineType)size2 >= segmentedDiffMinLines && (*p1)[index1].hasFingerprints() && (*p2)[index2].hasFingerprints())
+            segments = findDiffSegments(*p1, index1, size1, *p2, index2, size2);
+
+        bool bApproximate;
+        if(segments.size() > 1)
         {
-            qint32 numofEquals = std::min(size1, size2);
-            Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
-
-            push_back(d);
+            bApproximate = diffSegments(p1, index1, p2, index2, std::move(segments), settings, pp, *this);
         }
         else
         {
-            front().adjustNumberOfEquals(equalLinesAtStart);
-            currentLine1 += equalLinesAtStart;
-            currentLine2 += equalLinesAtStart;
-
-            LineType nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
-            if(nofEquals == 0)
-            {
-                back().adjustDiff1(size1 - currentLine1);
-                back().adjustDiff2(size2 - currentLine2);
-            }
-            else
-            {
-                Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
-                push_back(d);
-            }
+            context.engine().diff(*p1, index1, size1, *p2, index2, size2, *this);
+            bApproximate = context.engine().isApproximate();
         }
+        if(bApproximate)
+            context.markApproximate();
     }
 
     verify(size1, size2);
 
-    pp.setCurrent(1);
+    pp.clear();
 }
 
 // Verify difflist
@@ -689,13 +1035,51 @@ void DiffList::verify(const LineRef size1, const LineRef size2)
 
 void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
                                  e_SrcSelector winIdx1, e_SrcSelector winIdx2,
-                                 const QSharedPointer<Options>& pOptions)
+                                 const DiffSettings& settings)
+{
+    DiffContext context(settings);
+    runDiff(p1, size1, p2, size2, diffList, winIdx1, winIdx2, context);
+}
+
+bool ManualDiffSegmentCache::find(const LineType begin1, const LineType size1, const LineType begin2, const LineType size2, DiffList& diffList) const
+{
+    const auto it = mSegments.find(Key(begin1, size1, begin2, size2));
+    if(it == mSegments.end())
+        return false;
+
+    diffList = it->second;
+    return true;
+}
+
+void ManualDiffSegmentCache::insert(const LineType begin1, const LineType size1, const LineType begin2, const LineType size2, const DiffList& diffList)
+{
+    mSegments[Key(begin1, size1, begin2, size2)] = diffList;
+}
+
+void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
+                                 e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                                 DiffContext& context, ManualDiffSegmentCache* pSegmentCache) const
 {
     diffList.clear();
     DiffList diffList2;
 
-    int l1begin = 0;
-    int l2begin = 0;
+    LineType l1begin = 0;
+    LineType l2begin = 0;
+
+    // Only the ranges of this run are kept, so ranges replaced by a new alignment don't pile up.
+    ManualDiffSegmentCache usedSegments;
+    const auto diffSegment = [&](const LineType l1end, const LineType l2end) {
+        const LineType segmentSize1 = l1end - l1begin;
+        const LineType segmentSize2 = l2end - l2begin;
+        if(pSegmentCache == nullptr || !pSegmentCache->find(l1begin, segmentSize1, l2begin, segmentSize2, diffList2))
+            diffList2.runDiff(p1, l1begin, segmentSize1, p2, l2begin, segmentSize2, context);
+        if(pSegmentCache != nullptr)
+            usedSegments.insert(l1begin, segmentSize1, l2begin, segmentSize2, diffList2);
+
+        diffList.splice(diffList.end(), diffList2);
+        l1begin = l1end;
+        l2begin = l2end;
+    };
 
     for(const ManualDiffHelpEntry& mdhe: *this)
     {
@@ -704,10 +1088,7 @@ void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, Line
 
         if(l1end.isValid() && l2end.isValid())
         {
-            diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin, pOptions);
-            diffList.splice(diffList.end(), diffList2);
-            l1begin = l1end;
-            l2begin = l2end;
+            diffSegment(l1end, l2end);
 
             l1end = mdhe.getLine2(winIdx1);
             l2end = mdhe.getLine2(winIdx2);
@@ -716,15 +1097,14 @@ void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, Line
             {
                 ++l1end; // point to line after last selected line
                 ++l2end;
-                diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin, pOptions);
-                diffList.splice(diffList.end(), diffList2);
-                l1begin = l1end;
-                l2begin = l2end;
+                diffSegment(l1end, l2end);
             }
         }
     }
-    diffList2.runDiff(p1, l1begin, size1 - l1begin, p2, l2begin, size2 - l2begin, pOptions);
-    diffList.splice(diffList.end(), diffList2);
+    diffSegment(size1, size2);
+
+    if(pSegmentCache != nullptr)
+        *pSegmentCache = std::move(usedSegments);
 }
 
 void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHelpList)
@@ -734,10 +1114,12 @@ void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHe
 
     // If a line appears unaligned in comparison to the manual alignment, correct this.
 
+    // Where the search for the lines of the next entry starts, see below.
+    Diff3LineList::iterator searchStart = begin();
     ManualDiffHelpList::iterator iMDHL;
     for(iMDHL = pManualDiffHelpList->begin(); iMDHL != pManualDiffHelpList->end(); ++iMDHL)
     {
-        Diff3LineList::iterator i3 = begin();
+        Diff3LineList::iterator i3 = searchStart;
         e_SrcSelector missingWinIdx = e_SrcSelector::None;
         int alignedSum = (!iMDHL->getLine1(e_SrcSelector::A).isValid() ? 0 : 1) + (!iMDHL->getLine1(e_SrcSelector::B).isValid() ? 0 : 1) + (!iMDHL->getLine1(e_SrcSelector::C).isValid() ? 0 : 1);
         if(alignedSum == 2)
@@ -882,6 +1264,17 @@ void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHe
                             }
                         } // for(), searching for wi3
                     }
+
+                    // The entries are sorted. Once all lines of this entry are aligned, the lines of the next
+                    // entries can only come after them and the search doesn't need to start from the top again.
+                    bool bAllAligned = true;
+                    for(e_SrcSelector w = e_SrcSelector::A; w != e_SrcSelector::Invalid; w = nextSelector(w))
+                    {
+                        if(iMDHL->firstLine(w).isValid() && iDest->getLineInFile(w) != iMDHL->firstLine(w))
+                            bAllAligned = false;
+                    }
+                    if(bAllAligned)
+                        searchStart = iDest;
                     break;
                 }
             } // for(), searching for wi2
@@ -893,6 +1286,7 @@ void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHe
 void Diff3LineList::calcDiff3LineListTrim(
     const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC, ManualDiffHelpList* pManualDiffHelpList)
 {
+    TraceScope traceScope(TraceStage::align);
     const Diff3Line d3l_empty;
     remove(d3l_empty);
 
@@ -1179,15 +1573,147 @@ void DiffBufferInfo::init(Diff3LineList* pD3ll,
     mLineDataC = pldC;
 }
 
+void DiffBufferInfo::setDisplayData(const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC)
+{
+    mDisplayDataA = pldA;
+    mDisplayDataB = pldB;
+    mDisplayDataC = pldC;
+}
+
+namespace {
+// Missing lines count as white too.
+inline bool isWhiteLine(const LineDataVector* pld, const LineRef line, const bool bIgnoreComments)
+{
+    if(!line.isValid())
+        return true;
+
+    const LineData& lineData = (*pld)[line];
+    return lineData.whiteLine() || (bIgnoreComments && lineData.isPureComment());
+}
+} // namespace
+
+void Diff3LineList::setWhiteLines(Diff3Line& diff3Line, const LineDataVector* pldA, const LineDataVector* pldB, const LineDataVector* pldC, const bool bIgnoreComments)
+{
+    diff3Line.bWhiteLineA = isWhiteLine(pldA, diff3Line.getLineA(), bIgnoreComments);
+    diff3Line.bWhiteLineB = isWhiteLine(pldB, diff3Line.getLineB(), bIgnoreComments);
+    diff3Line.bWhiteLineC = isWhiteLine(pldC, diff3Line.getLineC(), bIgnoreComments);
+}
+
 void Diff3LineList::calcWhiteDiff3Lines(
     const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC, const bool bIgnoreComments)
 {
     for(Diff3Line& diff3Line: *this)
+        setWhiteLines(diff3Line, pldA.get(), pldB.get(), pldC.get(), bIgnoreComments);
+}
+
+/*
+    Myers' O(ND) difference algorithm on characters. The common prefix and suffix are stripped first
+    so the cost only depends on the size of the changed region. Once more than maxEditCost edits
+    would be needed the changed region is reported as one block, this keeps very long lines such
+    as minified sources from stalling the fine diff. Builds DiffList from scratch.
+*/
+void DiffList::calcMyersDiff(const QString& line1, const QString& line2, const qint32 maxEditCost)
+{
+    clear();
+
+    const QChar* a = line1.constData();
+    const QChar* b = line2.constData();
+    qint32 n = SafeInt<qint32>(line1.size());
+    qint32 m = SafeInt<qint32>(line2.size());
+
+    const qint32 prefix = (qint32)(std::mismatch(a, a + std::min(n, m), b).first - a);
+    a += prefix;
+    b += prefix;
+    n -= prefix;
+    m -= prefix;
+
+    qint32 suffix = 0;
+    while(suffix < n && suffix < m && a[n - 1 - suffix] == b[m - 1 - suffix])
+        ++suffix;
+    n -= suffix;
+    m -= suffix;
+
+    const qint32 maxD = std::min(n + m, std::max(maxEditCost, 0));
+    const qint32 offset = maxD + 1;
+    std::vector<qint32> v(2 * (size_t)maxD + 3, 0);
+    // trace[d] holds the furthest reaching x of each diagonal k in [-d, d] before step d.
+    std::vector<std::vector<qint32>> trace;
+    bool bFound = false;
+
+    for(qint32 d = 0; d <= maxD && !bFound; ++d)
     {
-        diff3Line.bWhiteLineA = (!diff3Line.getLineA().isValid() || (*pldA)[diff3Line.getLineA()].whiteLine() || (bIgnoreComments && (*pldA)[diff3Line.getLineA()].isPureComment()));
-        diff3Line.bWhiteLineB = (!diff3Line.getLineB().isValid() || (*pldB)[diff3Line.getLineB()].whiteLine() || (bIgnoreComments && (*pldB)[diff3Line.getLineB()].isPureComment()));
-        diff3Line.bWhiteLineC = (!diff3Line.getLineC().isValid() || (*pldC)[diff3Line.getLineC()].whiteLine() || (bIgnoreComments && (*pldC)[diff3Line.getLineC()].isPureComment()));
+        trace.emplace_back(v.cbegin() + (offset - d), v.cbegin() + (offset + d + 1));
+        for(qint32 k = -d; k <= d; k += 2)
+        {
+            qint32 x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            qint32 y = x - k;
+
+            while(x < n && y < m && a[x] == b[y])
+            {
+                ++x;
+                ++y;
+            }
+
+            v[offset + k] = x;
+            if(x >= n && y >= m)
+            {
+                bFound = true;
+                break;
+            }
+        }
     }
+
+    if(!bFound)
+    {
+        push_back(Diff(prefix, n, m));
+        if(suffix > 0)
+            push_back(Diff(suffix, 0, 0));
+        return;
+    }
+
+    // Walk back from the end. Each step d > 0 is one edit followed by a run of equal characters.
+    std::vector<std::pair<bool, qint32>> edits; // (is deletion from line1, equal characters after it)
+    edits.reserve(trace.size());
+    qint32 x = n;
+    qint32 y = m;
+    for(qint32 d = (qint32)trace.size() - 1; d > 0; --d)
+    {
+        const std::vector<qint32>& vd = trace[d];
+        const qint32 k = x - y;
+        const qint32 prevK = (k == -d || (k != d && vd[k - 1 + d] < vd[k + 1 + d])) ? k + 1 : k - 1;
+        const qint32 prevX = vd[prevK + d];
+        const qint32 prevY = prevX - prevK;
+        const bool bDeletion = prevK == k - 1;
+
+        edits.emplace_back(bDeletion, x - (bDeletion ? prevX + 1 : prevX));
+        x = prevX;
+        y = prevY;
+    }
+    assert(x == y);
+
+    Diff current(prefix + x, 0, 0);
+    for(auto it = edits.crbegin(); it != edits.crend(); ++it)
+    {
+        if(it->first)
+            current.adjustDiff1(1);
+        else
+            current.adjustDiff2(1);
+
+        if(it->second > 0)
+        {
+            push_back(current);
+            current = Diff(it->second, 0, 0);
+        }
+    }
+
+    if(current.diff1() > 0 || current.diff2() > 0)
+    {
+        push_back(current);
+        current = Diff(0, 0, 0);
+    }
+    current.adjustNumberOfEquals(suffix);
+    if(!current.isEmpty() || empty())
+        push_back(current);
 }
 
 // My own diff-invention:
@@ -1395,11 +1921,47 @@ void DiffList::optimize()
     }
 }
 
-bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags)
+FineDiff FineDiffArena::store(const DiffList& diffList)
+{
+    ++mCount;
+    const size_t count = diffList.size();
+    if(count == 0)
+        return FineDiff();
+
+    if(mUsed + count > blockSize)
+    {
+        // A fine diff never spans blocks, long ones get a block of their own.
+        mBlocks.push_back(std::make_unique<Diff[]>(std::max(count, blockSize)));
+        mBytes += std::max(count, blockSize) * sizeof(Diff);
+        mUsed = 0;
+    }
+
+    Diff* pBegin = mBlocks.back().get() + mUsed;
+    std::copy(diffList.cbegin(), diffList.cend(), pBegin);
+    mUsed += count;
+    return FineDiff(pBegin, pBegin + count);
+}
+
+static FineDiff calcLineFineDiff(const QString& line1, const QString& line2, FineDiffArena& arena)
+{
+    constexpr int maxSearchLength = 500;
+    constexpr qint32 maxEditCost = 1000;
+    DiffList diffList;
+    if(Diff3Line::m_pDiffBufferInfo->fineDiffAlgorithm() == FineDiffAlgorithm::myers)
+        diffList.calcMyersDiff(line1, line2, maxEditCost);
+    else
+        diffList.calcDiff(line1, line2, maxSearchLength);
+
+    // Optimize the diff list.
+    diffList.optimize();
+    return arena.store(diffList);
+}
+
+bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags,
+                         FineDiffArena& arena, const bool bDeferred)
 {
     LineRef k1 = 0;
     LineRef k2 = 0;
-    int maxSearchLength = 500;
     bool bTextsTotalEqual = inBTextsTotalEqual;
     bool bIgnoreComments = eIgnoreFlags & IgnoreFlag::ignoreComments;
     bool bIgnoreWhiteSpace = eIgnoreFlags & IgnoreFlag::ignoreWhiteSpace;
@@ -1429,15 +1991,13 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
         assert(((unsigned long)k1) <= (*v1).size() && (*v1)[k1].getBuffer() != nullptr);
         assert(((unsigned long)k2) <= (*v2).size() && (*v2)[k2].getBuffer() != nullptr);
 
-        if((*v1)[k1].size() != (*v2)[k2].size() || QString::compare((*v1)[k1].getLine(), (*v2)[k2].getLine()) != 0)
+        if(!(*v1)[k1].rawEqual((*v2)[k2]))
         {
             bTextsTotalEqual = false;
-            auto pDiffList = std::make_shared<DiffList>();
-            pDiffList->calcDiff((*v1)[k1].getLine(), (*v2)[k2].getLine(), maxSearchLength);
-
-            // Optimize the diff list.
-            pDiffList->optimize();
-            setFineDiff(selector, pDiffList);
+            if(bDeferred)
+                setFineDiffPending(selector, true);
+            else
+                setFineDiff(selector, calcLineFineDiff((*v1)[k1].getLine(), (*v2)[k2].getLine(), arena));
         }
         /*
             Override default euality for white lines and comments.
@@ -1462,9 +2022,67 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
     return bTextsTotalEqual;
 }
 
+FineDiff Diff3Line::getFineDiff(const e_SrcSelector selector) const
+{
+    assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+
+    bool& bPending = selector == e_SrcSelector::A ? bFineDiffPendingAB : selector == e_SrcSelector::B ? bFineDiffPendingBC : bFineDiffPendingCA;
+    FineDiff& fineDiff = selector == e_SrcSelector::A ? fineAB : selector == e_SrcSelector::B ? fineBC : fineCA;
+
+    if(!bPending)
+        return fineDiff;
+
+    bPending = false;
+    // Same pairing as in fineDiff(): A is A<->B, B is B<->C and C is C<->A.
+    const e_SrcSelector other = selector == e_SrcSelector::A ? e_SrcSelector::B : selector == e_SrcSelector::B ? e_SrcSelector::C : e_SrcSelector::A;
+    const LineRef k1 = getLineIndex(selector);
+    const LineRef k2 = getLineIndex(other);
+    const std::shared_ptr<LineDataVector> v1 = m_pDiffBufferInfo->getDisplayData(selector);
+    const std::shared_ptr<LineDataVector> v2 = m_pDiffBufferInfo->getDisplayData(other);
+
+    const Diff3LineList* pDiff3LineList = m_pDiffBufferInfo->getDiff3LineList();
+
+    // The source data may have been reset since the lines were compared.
+    if(v1 == nullptr || v2 == nullptr || pDiff3LineList == nullptr || !k1.isValid() || !k2.isValid() ||
+       (size_t)k1 >= v1->size() || (size_t)k2 >= v2->size())
+        return fineDiff;
+
+    fineDiff = calcLineFineDiff((*v1)[k1].getLine(), (*v2)[k2].getLine(), pDiff3LineList->fineDiffArena(selector));
+    return fineDiff;
+}
+
+void Diff3Line::calcPendingFineDiffs() const
+{
+    if(bFineDiffPendingAB) getFineDiff(e_SrcSelector::A);
+    if(bFineDiffPendingBC) getFineDiff(e_SrcSelector::B);
+    if(bFineDiffPendingCA) getFineDiff(e_SrcSelector::C);
+}
+
 void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
-                            std::shared_ptr<const DiffList>& pFineDiff1, std::shared_ptr<const DiffList>& pFineDiff2, // return values
+                            FineDiff& fineDiff1, FineDiff& fineDiff2, // return values
                             ChangeFlags& changed, ChangeFlags& changed2) const
+{
+    getChangeFlags(winIdx, isTriple, lineIdx, changed, changed2);
+
+    if(winIdx == e_SrcSelector::A)
+    {
+        fineDiff1 = getFineDiff(e_SrcSelector::A);
+        fineDiff2 = getFineDiff(e_SrcSelector::C);
+    }
+    else if(winIdx == e_SrcSelector::B)
+    {
+        fineDiff1 = getFineDiff(e_SrcSelector::B);
+        fineDiff2 = getFineDiff(e_SrcSelector::A);
+    }
+    else if(winIdx == e_SrcSelector::C)
+    {
+        fineDiff1 = getFineDiff(e_SrcSelector::C);
+        fineDiff2 = getFineDiff(e_SrcSelector::B);
+    }
+}
+
+void Diff3Line::getChangeFlags(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
+                               ChangeFlags& changed, ChangeFlags& changed2) const
 {
     changed = NoChange;
     changed2 = NoChange;
@@ -1476,9 +2094,6 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     if(winIdx == e_SrcSelector::A)
     {
         lineIdx = getLineA();
-        pFineDiff1 = pFineAB;
-        pFineDiff2 = pFineCA;
-
         changed = ((!getLineB().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? BChanged : NoChange);
         changed2 = (bAEqualB ? NoChange : AChanged) | (bAEqualC || !isTriple ? NoChange : BChanged);
@@ -1486,8 +2101,6 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::B)
     {
         lineIdx = getLineB();
-        pFineDiff1 = pFineBC;
-        pFineDiff2 = pFineAB;
         changed = ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? AChanged : NoChange) |
                    ((!getLineA().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bBEqualC || !isTriple ? NoChange : AChanged) | (bAEqualB ? NoChange : BChanged);
@@ -1495,31 +2108,127 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::C)
     {
         lineIdx = getLineC();
-        pFineDiff1 = pFineCA;
-        pFineDiff2 = pFineBC;
         changed = ((!getLineA().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineB().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bAEqualC ? NoChange : AChanged) | (bBEqualC ? NoChange : BChanged);
     }
 }
 
-bool Diff3LineList::fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags)
+/*
+    With bDeferred set only the cheap equality checks are done here. The character level diff of
+    differing lines is left to Diff3Line::getFineDiff, see calcPendingFineDiffs.
+*/
+bool Diff3LineList::fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags,
+                             const bool bDeferred)
 {
+    TraceScope traceScope(TraceStage::fineDiff);
+    traceScope.setItems((qint64)size());
     // Finetuning: Diff each line with deltas
     ProgressProxy pp;
     bool bTextsTotalEqual = true;
     size_t listSize = size();
     pp.setMaxNofSteps(listSize);
 
+    FineDiffArena& arena = fineDiffArena(selector);
     for(Diff3Line &diff: *this)
     {
-        bTextsTotalEqual = diff.fineDiff(bTextsTotalEqual, selector, v1, v2, eIgnoreFlags);
+        bTextsTotalEqual = diff.fineDiff(bTextsTotalEqual, selector, v1, v2, eIgnoreFlags, arena, bDeferred);
         pp.step();
     }
     return bTextsTotalEqual;
 }
 
+FineDiffArena& Diff3LineList::fineDiffArena(const e_SrcSelector selector) const
+{
+    assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+    std::shared_ptr<FineDiffArena>& pArena = mFineDiffArenas[selector == e_SrcSelector::A ? 0 : selector == e_SrcSelector::B ? 1 : 2];
+    if(pArena == nullptr)
+        pArena = std::make_shared<FineDiffArena>();
+    return *pArena;
+}
+
+size_t Diff3LineList::fineDiffCount() const
+{
+    size_t count = 0;
+    for(const std::shared_ptr<FineDiffArena>& pArena: mFineDiffArenas)
+    {
+        if(pArena != nullptr)
+            count += pArena->count();
+    }
+    return count;
+}
+
+qint64 Diff3LineList::memoryUsage() const
+{
+    // Each list node holds two pointers next to the Diff3Line.
+    qint64 bytes = (qint64)(size() * (sizeof(Diff3Line) + 2 * sizeof(void*)));
+    for(const std::shared_ptr<FineDiffArena>& pArena: mFineDiffArenas)
+    {
+        if(pArena != nullptr)
+            bytes += (qint64)pArena->byteCount();
+    }
+    return bytes;
+}
+
+qint64 Diff3LineList::evictFineDiffs()
+{
+    qint64 bytes = 0;
+    for(const std::shared_ptr<FineDiffArena>& pArena: mFineDiffArenas)
+    {
+        if(pArena != nullptr)
+            bytes += (qint64)pArena->byteCount();
+    }
+
+    for(Diff3Line& d3l: *this)
+    {
+        for(const e_SrcSelector selector: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
+        {
+            const FineDiff& fineDiff = selector == e_SrcSelector::A ? d3l.fineAB : selector == e_SrcSelector::B ? d3l.fineBC : d3l.fineCA;
+            if(!fineDiff.isNull())
+            {
+                d3l.setFineDiff(selector, FineDiff());
+                d3l.setFineDiffPending(selector, true);
+            }
+        }
+    }
+    // Copies of the list keep the old arenas alive for their own lines.
+    mFineDiffArenas = {};
+    return bytes;
+}
+
+// Calculates deferred fine diffs of up to maxLines entries starting at from. Returns where to continue.
+Diff3LineList::const_iterator Diff3LineList::calcPendingFineDiffs(const_iterator from, const size_t maxLines) const
+{
+    TraceScope traceScope(TraceStage::fineDiff);
+    for(size_t i = 0; i < maxLines && from != cend(); ++i, ++from)
+        from->calcPendingFineDiffs();
+
+    return from;
+}
+
 // Convert the list to a vector of pointers
+LineType Diff3LineVector::recalcWordWrap(bool resetDisplayCount)
+{
+    std::vector<LineType> linesNeeded;
+    linesNeeded.reserve(SafeInt<size_t>(size()));
+    for(Diff3Line* d3l: *this)
+    {
+        if(resetDisplayCount)
+            d3l->setLinesNeeded(1);
+        linesNeeded.push_back(d3l->linesNeededForDisplay());
+    }
+
+    mWrapLines.assign(std::move(linesNeeded));
+    return mWrapLines.total();
+}
+
+void Diff3LineVector::setLinesNeeded(const LineType d3lIdx, const qint32 lines)
+{
+    (*this)[d3lIdx]->setLinesNeeded(lines);
+    if((size_t)d3lIdx < mWrapLines.size())
+        mWrapLines.set((size_t)d3lIdx, lines);
+}
+
 void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv)
 {
     d3lv.resize(SafeInt<QtSizeType>(size()));
@@ -1527,11 +2236,49 @@ void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv)
     QtSizeType j = 0;
     for(i = begin(); i != end(); ++i, ++j)
     {
-        d3lv[j] = std::make_shared<Diff3Line>(*i);
+        d3lv[j] = &(*i);
     }
     assert(j == d3lv.size());
 }
 
+/*
+    The white line flags depend on the final position of every line, after trimming and the B <-> C
+    alignment moved them. Setting them while the row pointers are collected saves another walk over
+    the list, whose nodes are scattered over the heap.
+*/
+void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv,
+    const std::shared_ptr<LineDataVector>& pldA, const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC, const bool bIgnoreComments)
+{
+    d3lv.resize(SafeInt<QtSizeType>(size()));
+    QtSizeType j = 0;
+    for(Diff3Line& diff3Line: *this)
+    {
+        setWhiteLines(diff3Line, pldA.get(), pldB.get(), pldC.get(), bIgnoreComments);
+        d3lv[j++] = &diff3Line;
+    }
+    assert(j == d3lv.size());
+}
+
+// Compares with the result of the separate first and second step.
+void Diff3LineList::debugAlignmentCheck(const DiffList* pDiffListAB, const DiffList* pDiffListAC) const
+{
+    Diff3LineList expected;
+    expected.calcDiff3LineListUsingAB(pDiffListAB);
+    expected.calcDiff3LineListUsingAC(pDiffListAC);
+
+    if(expected.size() == size() && std::equal(expected.cbegin(), expected.cend(), cbegin()))
+        return;
+
+    #ifndef AUTOTEST
+    KMessageBox::error(nullptr, i18n("Data loss error:\n"
+                                     "If it is reproducible please contact the author.\n"),
+                       i18n("Severe Internal Error"));
+    #endif
+
+    qCCritical(kdiffMain) << "Severe Internal Error." << " Three way alignment differs from the stepwise result.\n";
+    ::exit(-1);
+}
+
 // Just make sure that all input lines are in the output too, exactly once.
 void Diff3LineList::debugLineCheck(const LineType size, const e_SrcSelector srcSelector) const
 {
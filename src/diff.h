@@ -12,12 +12,17 @@
 #define DIFF_H
 
 #include "common.h"
+#include "LineDiffEngine.h"
 #include "LineRef.h"
 #include "Logging.h"
+#include "PrefixSumTree.h"
 #include "TypeUtils.h"
 
+#include <array>
 #include <list>
+#include <map>
 #include <memory>
+#include <tuple>
 #include <vector>
 
 #include <QSharedPointer>
@@ -26,11 +31,10 @@
 #include <QVector>
 
 class LineData;
+class LineDataVector;
 
 class Options;
 
-using LineDataVector=std::vector<LineData>;
-
 //e_SrcSelector must be sequential integers with no gaps between Min and Max.
 enum class e_SrcSelector
 {
@@ -143,48 +147,145 @@ class Diff
     }
 };
 
+/*
+    Per-comparison state for DiffList::runDiff.
+    Owns its own line diff engine so a context may be reused for consecutive diffs but must
+    not be shared between threads. Create one context for each diff that runs concurrently.
+*/
+class DiffContext
+{
+  public:
+    explicit DiffContext(const DiffSettings& settings);
+    ~DiffContext();
+
+    DiffContext(const DiffContext&) = delete;
+    DiffContext& operator=(const DiffContext&) = delete;
+
+    [[nodiscard]] inline LineDiffEngine& engine() { return *mEngine; }
+    [[nodiscard]] inline const DiffSettings& settings() const { return mSettings; }
+
+    // Set by DiffList::runDiff once a result was cut short by the deadline of the settings.
+    [[nodiscard]] inline bool isApproximate() const { return mbApproximate; }
+    inline void markApproximate() { mbApproximate = true; }
+
+  private:
+    const DiffSettings mSettings;
+    std::unique_ptr<LineDiffEngine> mEngine;
+    bool mbApproximate = false;
+};
+
+// Character level diff used for the fine diff of two lines.
+enum class FineDiffAlgorithm
+{
+    classic = 0, // DiffList::calcDiff
+    myers = 1,   // DiffList::calcMyersDiff
+};
+
 class DiffList: public std::list<Diff>
 {
   public:
     using std::list<Diff>::list;
     void calcDiff(const QString& line1, const QString& line2, const int maxSearchRange);
-    void runDiff(const std::shared_ptr<LineDataVector> &p1, const size_t index1, LineRef size1, const std::shared_ptr<LineDataVector> &p2, const size_t index2, LineRef size2, const QSharedPointer<Options>& pOptions);
+    void calcMyersDiff(const QString& line1, const QString& line2, const qint32 maxEditCost);
+    void runDiff(const std::shared_ptr<LineDataVector> &p1, const size_t index1, LineRef size1, const std::shared_ptr<LineDataVector> &p2, const size_t index2, LineRef size2, DiffContext& context);
     void verify(const LineRef size1, const LineRef size2);
     void optimize();
 };
 
+/*
+    The character level differences of a pair of lines, stored in a FineDiffArena. A null FineDiff
+    means the lines are equal or one of them doesn't exist. Two FineDiffs are the same if they
+    refer to the same place in the arena.
+*/
+class FineDiff
+{
+  public:
+    FineDiff() = default;
+    FineDiff(const Diff* pBegin, const Diff* pEnd): mBegin(pBegin), mEnd(pEnd) {}
+
+    [[nodiscard]] bool isNull() const { return mBegin == nullptr; }
+    [[nodiscard]] const Diff* begin() const { return mBegin; }
+    [[nodiscard]] const Diff* end() const { return mEnd; }
+    [[nodiscard]] size_t size() const { return mEnd - mBegin; }
+
+    bool operator==(const FineDiff& other) const { return mBegin == other.mBegin && mEnd == other.mEnd; }
+    bool operator!=(const FineDiff& other) const { return !(*this == other); }
+
+  private:
+    const Diff* mBegin = nullptr;
+    const Diff* mEnd = nullptr;
+};
+
+/*
+    Keeps the fine diffs of one comparison in large blocks that are freed all at once, so a line
+    needs no allocations of its own for them. Runs never move once stored. Not thread safe, every
+    thread calculating fine diffs needs its own arena.
+*/
+class FineDiffArena
+{
+  public:
+    [[nodiscard]] FineDiff store(const DiffList& diffList);
+
+    // Number of fine diffs stored and the memory taken by all blocks.
+    [[nodiscard]] size_t count() const { return mCount; }
+    [[nodiscard]] size_t byteCount() const { return mBytes; }
+
+  private:
+    static constexpr size_t blockSize = 4096;
+
+    std::vector<std::unique_ptr<Diff[]>> mBlocks;
+    size_t mUsed = blockSize; // Runs used in the last block.
+    size_t mCount = 0;
+    size_t mBytes = 0;
+};
+
+/*
+    A LineData is a view of one line in the unicode buffer of a SourceData. It only stores a plain
+    pointer to that buffer, the owning LineDataVector keeps the buffer alive. Offsets and sizes are 32 bits
+    as they are within one buffer, SourceData splits larger text over several.
+*/
 class LineData
 {
   private:
-    QSharedPointer<QString> mBuffer;
-    QtSizeType mFirstNonWhiteChar = 0;
+    const QString* mBuffer = nullptr;
     //This tracks the offset with-in our unicode buffer not the file offset
-    QtSizeType mOffset = 0;
-    QtSizeType mSize = 0;
+    qint32 mOffset = 0;
+    qint32 mSize = 0;
+    qint32 mFirstNonWhiteChar = 0;
+    // Hashes of the line as is, with white space removed and also without numbers, see calcFingerprints().
+    quint32 mRawFingerprint = 0;
+    quint32 mWhiteSpaceFreeFingerprint = 0;
+    quint32 mNumberFreeFingerprint = 0;
     bool bContainsPureComment = false;
     bool bSkipable = false;//TODO: Move me
+    bool bHasFingerprints = false;
+    bool bContainsTab = false; // Valid if bHasFingerprints.
 
   public:
     inline LineData(const QSharedPointer<QString>& buffer, const QtSizeType inOffset, QtSizeType inSize = 0, QtSizeType inFirstNonWhiteChar = 0, bool inIsSkipable = false, const bool inIsPureComment = false)
     {
-        mBuffer = buffer;
-        mOffset = inOffset;
-        mSize = inSize;
+        assert(inOffset <= limits<qint32>::max() && inSize <= limits<qint32>::max());
+
+        mBuffer = buffer.data();
+        mOffset = (qint32)inOffset;
+        mSize = (qint32)inSize;
         bContainsPureComment = inIsPureComment;
         bSkipable = inIsSkipable;
-        mFirstNonWhiteChar = inFirstNonWhiteChar;
+        mFirstNonWhiteChar = (qint32)inFirstNonWhiteChar;
     }
     [[nodiscard]] inline QtSizeType size() const { return mSize; }
     [[nodiscard]] inline QtSizeType getFirstNonWhiteChar() const { return mFirstNonWhiteChar; }
 
     /*
         QString::fromRawData allows us to create a light weight QString backed by the buffer memmory.
+        constData() keeps this from detaching a buffer that is shared with another QString.
     */
-    [[nodiscard]] inline const QString getLine() const { return QString::fromRawData(mBuffer->data() + mOffset, mSize); }
-    [[nodiscard]] inline const QSharedPointer<QString>& getBuffer() const { return mBuffer; }
+    [[nodiscard]] inline const QString getLine() const { return QString::fromRawData(mBuffer->constData() + mOffset, mSize); }
+    [[nodiscard]] inline const QString* getBuffer() const { return mBuffer; }
 
     [[nodiscard]] inline QtSizeType getOffset() const { return mOffset; }
     [[nodiscard]] int width(int tabSize) const; // Calcs width considering tabs.
+    [[nodiscard]] static int width(const QString& line, int tabSize);
 
     [[nodiscard]] inline bool whiteLine() const { return mFirstNonWhiteChar == 0; }
 
@@ -194,7 +295,85 @@ class LineData
     [[nodiscard]] inline bool isSkipable() const { return bSkipable; }
     inline void setSkipable(const bool inSkipable) { bSkipable = inSkipable; }
 
+    // Must be called again if the text of the line changes.
+    void calcFingerprints();
+    [[nodiscard]] inline bool hasFingerprints() const { return bHasFingerprints; }
+    // Equal for lines that are equal apart from white space, valid if hasFingerprints().
+    [[nodiscard]] inline quint32 whiteSpaceFreeFingerprint() const { return mWhiteSpaceFreeFingerprint; }
+    /*
+        Hash of the line as line matching sees it: without white space and, if bIgnoreNumbers, without
+        digits, '-' and '.'. Calculated on the fly for lines without fingerprints. GnuDiff and the other
+        line diff engines use it instead of normalizing every line again.
+    */
+    [[nodiscard]] inline quint32 lineMatchFingerprint(const bool bIgnoreNumbers) const
+    {
+        if(!bHasFingerprints)
+            return calcLineMatchFingerprint(bIgnoreNumbers);
+        return bIgnoreNumbers ? mNumberFreeFingerprint : mWhiteSpaceFreeFingerprint;
+    }
+    // True if line matching treats both lines as equal, the same rule as GnuDiff::lines_differ.
+    [[nodiscard]] static bool lineMatchEqual(const LineData& l1, const LineData& l2, const bool bIgnoreNumbers);
+
+    // Exact comparison. Different fingerprints settle it without looking at the text.
+    [[nodiscard]] inline bool rawEqual(const LineData& other) const
+    {
+        if(mSize != other.mSize || (bHasFingerprints && other.bHasFingerprints && mRawFingerprint != other.mRawFingerprint))
+            return false;
+        return QString::compare(getLine(), other.getLine()) == 0;
+    }
+
     [[nodiscard]] static bool equal(const LineData& l1, const LineData& l2);
+
+  private:
+    [[nodiscard]] quint32 calcLineMatchFingerprint(const bool bIgnoreNumbers) const;
+};
+
+/*
+    Line table of one input. Owns the unicode buffer its LineData entries point into, so the
+    lines stay valid for as long as someone holds on to the vector.
+*/
+class LineDataVector: public std::vector<LineData>
+{
+  public:
+    using std::vector<LineData>::vector;
+
+    inline void setBuffer(const QSharedPointer<QString>& buffer) { mBuffers = {buffer}; }
+    /*
+        Text too large for one QString is kept in several buffers, each holding complete lines.
+        Every LineData refers to one of them, a range of lines may span two.
+    */
+    inline void addBuffer(const QSharedPointer<QString>& buffer) { mBuffers.push_back(buffer); }
+    [[nodiscard]] inline QSharedPointer<QString> buffer() const { return mBuffers.empty() ? QSharedPointer<QString>() : mBuffers.front(); }
+    [[nodiscard]] inline const std::vector<QSharedPointer<QString>>& buffers() const { return mBuffers; }
+    // Memory of the line table and the unicode buffers it points into.
+    [[nodiscard]] qint64 memoryUsage() const
+    {
+        qint64 bytes = (qint64)(capacity() * sizeof(LineData));
+        for(const QSharedPointer<QString>& pBuffer: mBuffers)
+        {
+            if(pBuffer != nullptr)
+                bytes += (qint64)pBuffer->capacity() * (qint64)sizeof(QChar);
+        }
+        return bytes;
+    }
+
+    void calcFingerprints()
+    {
+        for(LineData& lineData: *this)
+            lineData.calcFingerprints();
+    }
+
+    /*
+        Width of the widest line in columns. Kept for the last tab size asked for and only extended
+        over lines added since, so asking again is cheap.
+    */
+    [[nodiscard]] int maxWidth(int tabSize) const;
+
+  private:
+    std::vector<QSharedPointer<QString>> mBuffers;
+    mutable int mMaxWidth = 0;
+    mutable int mMaxWidthTabSize = 0;
+    mutable size_t mMaxWidthLines = 0; // Lines included in mMaxWidth.
 };
 
 class ManualDiffHelpList; // A list of corresponding ranges
@@ -202,7 +381,27 @@ class ManualDiffHelpList; // A list of corresponding ranges
 class Diff3Line;
 class Diff3LineList;
 
-using Diff3LineVector = QVector<std::shared_ptr<Diff3Line>>;
+/*
+    Random access view of a Diff3LineList. The entries point into the list nodes, which never
+    move, so the view shares per line state such as the word wrap line count with the list.
+    With word wrap it also indexes the first wrap line of every Diff3Line.
+*/
+class Diff3LineVector: public QVector<Diff3Line*>
+{
+  public:
+    // Indexes the wrap lines of all Diff3Lines, optionally setting each to 1 first. Returns the number of wrap lines.
+    LineType recalcWordWrap(bool resetDisplayCount);
+    // For a single line that was wrapped again, keeps the index valid in O(log n).
+    void setLinesNeeded(const LineType d3lIdx, const qint32 lines);
+
+    // O(log n), see recalcWordWrap().
+    [[nodiscard]] LineType firstWrapLine(const LineType d3lIdx) const { return mWrapLines.prefix((size_t)d3lIdx); }
+    [[nodiscard]] LineType diff3LineOfWrapLine(const LineType wrapLine) const { return (LineType)mWrapLines.find(wrapLine); }
+    [[nodiscard]] LineType numberOfWrapLines() const { return mWrapLines.total(); }
+
+  private:
+    PrefixSumTree mWrapLines;
+};
 
 class DiffBufferInfo
 {
@@ -210,11 +409,22 @@ class DiffBufferInfo
     std::shared_ptr<LineDataVector> mLineDataA;
     std::shared_ptr<LineDataVector> mLineDataB;
     std::shared_ptr<LineDataVector> mLineDataC;
+    std::shared_ptr<LineDataVector> mDisplayDataA;
+    std::shared_ptr<LineDataVector> mDisplayDataB;
+    std::shared_ptr<LineDataVector> mDisplayDataC;
     const Diff3LineList* m_pDiff3LineList = nullptr;
+    FineDiffAlgorithm mFineDiffAlgorithm = FineDiffAlgorithm::classic;
 
   public:
     void init(Diff3LineList* d3ll,
               const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC);
+    // The fine diff is done on the display data, so deferred fine diffs need these too.
+    void setDisplayData(const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC);
+
+    [[nodiscard]] const Diff3LineList* getDiff3LineList() const { return m_pDiff3LineList; }
+
+    void setFineDiffAlgorithm(const FineDiffAlgorithm algorithm) { mFineDiffAlgorithm = algorithm; }
+    [[nodiscard]] inline FineDiffAlgorithm fineDiffAlgorithm() const { return mFineDiffAlgorithm; }
 
     [[nodiscard]] inline std::shared_ptr<LineDataVector> getLineData(e_SrcSelector srcIndex) const
     {
@@ -230,6 +440,21 @@ class DiffBufferInfo
                 return nullptr;
         }
     }
+
+    [[nodiscard]] inline std::shared_ptr<LineDataVector> getDisplayData(e_SrcSelector srcIndex) const
+    {
+        switch(srcIndex)
+        {
+            case e_SrcSelector::A:
+                return mDisplayDataA;
+            case e_SrcSelector::B:
+                return mDisplayDataB;
+            case e_SrcSelector::C:
+                return mDisplayDataC;
+            default:
+                return nullptr;
+        }
+    }
 };
 
 enum class IgnoreFlag
@@ -258,18 +483,23 @@ class Diff3Line
     bool bWhiteLineB = false;
     bool bWhiteLineC = false;
 
-    std::shared_ptr<const DiffList> pFineAB; // These are NULL only if completely equal or if either source doesn't exist.
-    std::shared_ptr<const DiffList> pFineBC;
-    std::shared_ptr<const DiffList> pFineCA;
+    // These are null only if completely equal or if either source doesn't exist.
+    // Mutable because deferred fine diffs are filled in on first use, see getFineDiff().
+    mutable FineDiff fineAB;
+    mutable FineDiff fineBC;
+    mutable FineDiff fineCA;
 
-    qint32 mLinesNeededForDisplay = 1;    // Due to wordwrap
-    qint32 mSumLinesNeededForDisplay = 0; // For fast conversion to m_diff3WrapLineVector
+    mutable bool bFineDiffPendingAB = false; // Lines differ but the fine diff was not calculated yet.
+    mutable bool bFineDiffPendingBC = false;
+    mutable bool bFineDiffPendingCA = false;
+
+    qint32 mLinesNeededForDisplay = 1; // Due to wordwrap, see Diff3LineVector::recalcWordWrap() for the sums.
   public:
     static QSharedPointer<DiffBufferInfo> m_pDiffBufferInfo; // Needed by this class and only this but inited directly from KDiff3App::mainInit
 
-    [[nodiscard]] inline bool hasFineDiffAB() const { return pFineAB != nullptr; }
-    [[nodiscard]] inline bool hasFineDiffBC() const { return pFineBC != nullptr; }
-    [[nodiscard]] inline bool hasFineDiffCA() const { return pFineCA != nullptr; }
+    [[nodiscard]] inline bool hasFineDiffAB() const { return bFineDiffPendingAB || !fineAB.isNull(); }
+    [[nodiscard]] inline bool hasFineDiffBC() const { return bFineDiffPendingBC || !fineBC.isNull(); }
+    [[nodiscard]] inline bool hasFineDiffCA() const { return bFineDiffPendingCA || !fineCA.isNull(); }
 
     [[nodiscard]] inline LineRef getLineIndex(e_SrcSelector src) const
     {
@@ -348,31 +578,53 @@ class Diff3Line
         return LineRef();
     }
 
-    [[nodiscard]] inline qint32 sumLinesNeededForDisplay() const { return mSumLinesNeededForDisplay; }
-
     [[nodiscard]] inline qint32 linesNeededForDisplay() const { return mLinesNeededForDisplay; }
 
     void setLinesNeeded(const qint32 lines) { mLinesNeededForDisplay = lines; }
-    [[nodiscard]] bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags);
+    [[nodiscard]] bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags,
+                                FineDiffArena& arena, const bool bDeferred = false);
+    // Returns the fine diff for selector, calculating it first if it was deferred.
+    FineDiff getFineDiff(const e_SrcSelector selector) const;
+    void calcPendingFineDiffs() const;
     void getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
-                     std::shared_ptr<const DiffList>& pFineDiff1, std::shared_ptr<const DiffList>& pFineDiff2, // return values
+                     FineDiff& fineDiff1, FineDiff& fineDiff2, // return values
                      ChangeFlags& changed, ChangeFlags& changed2) const;
+    // The line level part of getLineInfo(). Doesn't touch the fine diffs, so it may run on any thread.
+    void getChangeFlags(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
+                        ChangeFlags& changed, ChangeFlags& changed2) const;
 
   private:
-    void setFineDiff(const e_SrcSelector selector, const std::shared_ptr<DiffList>& pDiffList)
+    void setFineDiff(const e_SrcSelector selector, const FineDiff& fineDiff)
+    {
+        assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+        if(selector == e_SrcSelector::A)
+        {
+            fineAB = fineDiff;
+        }
+        else if(selector == e_SrcSelector::B)
+        {
+            fineBC = fineDiff;
+        }
+        else if(selector == e_SrcSelector::C)
+        {
+            fineCA = fineDiff;
+        }
+    }
+
+    void setFineDiffPending(const e_SrcSelector selector, const bool bPending)
     {
         assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
         if(selector == e_SrcSelector::A)
         {
-            pFineAB = pDiffList;
+            bFineDiffPendingAB = bPending;
         }
         else if(selector == e_SrcSelector::B)
         {
-            pFineBC = pDiffList;
+            bFineDiffPendingBC = bPending;
         }
         else if(selector == e_SrcSelector::C)
         {
-            pFineCA = pDiffList;
+            bFineDiffPendingCA = bPending;
         }
     }
 };
@@ -384,36 +636,46 @@ class Diff3LineList: public std::list<Diff3Line>
   public:
     using std::list<Diff3Line>::list;
 
+    // Also frees the fine diffs of all lines.
+    void clear()
+    {
+        std::list<Diff3Line>::clear();
+        mFineDiffArenas = {};
+    }
+
+    // Where the fine diffs for selector are kept, one arena per selector as they are calculated concurrently.
+    [[nodiscard]] FineDiffArena& fineDiffArena(const e_SrcSelector selector) const;
+    // Fine diffs calculated so far and the approximate memory of the list including them.
+    [[nodiscard]] size_t fineDiffCount() const;
+    [[nodiscard]] qint64 memoryUsage() const;
+    /*
+        Frees all fine diffs, lines that had one calculate it again on first use. Returns the bytes
+        freed. FineDiffs copied out of the lines before become invalid.
+    */
+    qint64 evictFineDiffs();
+
     void findHistoryRange(const QRegularExpression& historyStart, bool bThreeFiles, HistoryRange& range) const;
-    bool fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags);
+    bool fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags,
+                  const bool bDeferred = false);
+    [[nodiscard]] const_iterator calcPendingFineDiffs(const_iterator from, const size_t maxLines) const;
     void calcDiff3LineVector(Diff3LineVector& d3lv);
+    // Same as calcWhiteDiff3Lines() followed by calcDiff3LineVector(), in one sweep.
+    void calcDiff3LineVector(Diff3LineVector& d3lv, const std::shared_ptr<LineDataVector>& pldA, const std::shared_ptr<LineDataVector>& pldB, const std::shared_ptr<LineDataVector>& pldC,
+                             const bool bIgnoreComments);
     void calcWhiteDiff3Lines(const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC, const bool bIgnoreComments);
 
     void calcDiff3LineListUsingAB(const DiffList* pDiffListAB);
     void calcDiff3LineListUsingAC(const DiffList* pDiffListAC);
     void calcDiff3LineListUsingBC(const DiffList* pDiffListBC);
+    // Same as calcDiff3LineListUsingAB() followed by calcDiff3LineListUsingAC().
+    void calcDiff3LineListUsingABAndAC(const DiffList* pDiffListAB, const DiffList* pDiffListAC);
 
     void correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHelpList);
 
     void calcDiff3LineListTrim(const std::shared_ptr<LineDataVector> &pldA, const std::shared_ptr<LineDataVector> &pldB, const std::shared_ptr<LineDataVector> &pldC, ManualDiffHelpList* pManualDiffHelpList);
 
-    LineType recalcWordWrap(bool resetDisplayCount)
-    {
-        LineType sumOfLines = 0;
-
-        for(Diff3Line& d3l: *this)
-        {
-            if(resetDisplayCount)
-                d3l.mLinesNeededForDisplay = 1;
-
-            d3l.mSumLinesNeededForDisplay = sumOfLines;
-            sumOfLines += d3l.linesNeededForDisplay();
-        }
-
-        return sumOfLines;
-    }
-
     void debugLineCheck(const LineType size, const e_SrcSelector srcSelector) const;
+    void debugAlignmentCheck(const DiffList* pDiffListAB, const DiffList* pDiffListAC) const;
 
     void dump();
 
@@ -437,6 +699,12 @@ class Diff3LineList: public std::list<Diff3Line>
             return SafeInt<LineType>(size());
         }
     }
+
+  private:
+    static void setWhiteLines(Diff3Line& diff3Line, const LineDataVector* pldA, const LineDataVector* pldB, const LineDataVector* pldC, const bool bIgnoreComments);
+
+    // Shared by copies of the list as their lines refer to the same fine diffs.
+    mutable std::array<std::shared_ptr<FineDiffArena>, 3> mFineDiffArenas;
 };
 
 struct HistoryRange
@@ -449,7 +717,7 @@ struct HistoryRange
 
 struct Diff3WrapLine
 {
-    std::shared_ptr<Diff3Line> pD3L = nullptr;
+    Diff3Line* pD3L = nullptr;
     int diff3LineIndex = 0;
     int wrapLineOffset = 0;
     int wrapLineLength = 0;
@@ -593,6 +861,25 @@ class ManualDiffHelpEntry
 };
 
 // A list of corresponding ranges
+/*
+    Line matching of the ranges between manual alignments from the previous run. Adding an
+    alignment only changes the ranges next to it, the others are taken from here. A range is
+    identified by its bounds alone so the owner has to clear the cache when the inputs change.
+*/
+class ManualDiffSegmentCache
+{
+  public:
+    void clear() { mSegments.clear(); }
+    [[nodiscard]] bool empty() const { return mSegments.empty(); }
+
+    bool find(const LineType begin1, const LineType size1, const LineType begin2, const LineType size2, DiffList& diffList) const;
+    void insert(const LineType begin1, const LineType size1, const LineType begin2, const LineType size2, const DiffList& diffList);
+
+  private:
+    using Key = std::tuple<LineType, LineType, LineType, LineType>;
+    std::map<Key, DiffList> mSegments;
+};
+
 class ManualDiffHelpList: public std::list<ManualDiffHelpEntry>
 {
   public:
@@ -603,7 +890,10 @@ class ManualDiffHelpList: public std::list<ManualDiffHelpEntry>
 
     void runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
                  e_SrcSelector winIdx1, e_SrcSelector winIdx2,
-                 const QSharedPointer<Options>& pOptions);
+                 const DiffSettings& settings);
+    void runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
+                 e_SrcSelector winIdx1, e_SrcSelector winIdx2,
+                 DiffContext& context, ManualDiffSegmentCache* pSegmentCache = nullptr) const;
 };
 
 /** Returns the number of equivalent spaces at position outPos.
@@ -626,6 +916,4 @@ enum e_CoordType
     eWrapCoords
 };
 
-QString calcHistorySortKey(const QString& keyOrder, QRegularExpressionMatch& matchedRegExpr, const QStringList& parenthesesGroupList);
-bool findParenthesesGroups(const QString& s, QStringList& sl);
 #endif
@@ -14,17 +14,24 @@
 #include "FileNameLineEdit.h"
 #include "kdiff3.h"
 #include "LineRef.h"
+#include "LruCache.h"
 #include "Logging.h"
 #include "merger.h"
+#include "MonospaceText.h"
 #include "options.h"
+#include "PaintBenchmark.h"
 #include "progress.h"
 #include "RLPainter.h"
 #include "selection.h"
 #include "SourceData.h"
+#include "TaskExecutor.h"
+#include "TextSearchIndex.h"
+#include "Trace.h"
 #include "TypeUtils.h"
 #include "Utils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <memory>
@@ -38,6 +45,7 @@
 #include <QDir>
 #include <QDragEnterEvent>
 #include <QFileDialog>
+#include <QFontInfo>
 #include <QLabel>
 #include <QLayout>
 #include <QLineEdit>
@@ -45,49 +53,97 @@
 #include <QMimeData>
 #include <QPainter>
 #include <QPushButton>
-#include <QRunnable>
 #include <QScrollBar>
 #include <QStatusBar>
 #include <QTextCodec>
 #include <QTextLayout>
-#include <QThreadPool>
 #include <QtMath>
 #include <QToolTip>
 #include <QUrl>
 
 QScrollBar* DiffTextWindow::mVScrollBar = nullptr;
-QList<RecalcWordWrapRunnable*> DiffTextWindow::s_runnables; //Used in startRunables and recalWordWrap
+namespace {
+/*
+    Runs the word wrap chunks of all windows on the global thread pool.
 
-class RecalcWordWrapRunnable: public QRunnable
+    The chunks are queued by DiffTextWindow::recalcWordWrap() and every pool thread takes the next
+    one until none are left, so a thread that got short lines just takes more. Chunks showing the
+    current position come first: their results are cached even if a resize cancels the batch.
+    Each batch is shared by its threads, a new one may start while the last thread of the
+    previous one is still returning.
+*/
+class WordWrapScheduler
 {
-  private:
-    static QAtomicInt s_runnableCount;
-    DiffTextWindow* m_pDTW;
-    int m_visibleTextWidth;
-    QtSizeType m_cacheIdx;
-
   public:
-    static QAtomicInt s_maxNofRunnables;
-    RecalcWordWrapRunnable(DiffTextWindow* p, int visibleTextWidth, QtSizeType cacheIdx):
-        m_pDTW(p), m_visibleTextWidth(visibleTextWidth), m_cacheIdx(cacheIdx)
+    void add(DiffTextWindow* pWindow, int visibleTextWidth, QtSizeType cacheIdx, bool bVisible)
+    {
+        (bVisible ? mVisibleChunks : mOtherChunks).push_back({pWindow, visibleTextWidth, cacheIdx});
+    }
+
+    bool start()
     {
-        setAutoDelete(true);
-        s_runnableCount.fetchAndAddOrdered(1);
+        if(mVisibleChunks.empty() && mOtherChunks.empty())
+            return false;
+
+        const std::shared_ptr<Batch> pBatch = std::make_shared<Batch>();
+        pBatch->chunks = std::move(mVisibleChunks);
+        pBatch->chunks.insert(pBatch->chunks.end(), mOtherChunks.begin(), mOtherChunks.end());
+        mVisibleChunks.clear();
+        mOtherChunks.clear();
+
+        pBatch->pProgress = std::make_shared<ParallelProgress>(pBatch->chunks.size());
+
+        g_pProgressDialog->setStayHidden(true);
+        ProgressProxy::startBackgroundTask();
+        g_pProgressDialog->trackParallel(pBatch->pProgress);
+
+        const size_t nofThreads = std::min<size_t>(std::max(TaskExecutor::instance().maxThreadCount(), 1), pBatch->chunks.size());
+        for(size_t i = 0; i < nofThreads; ++i)
+            TaskExecutor::instance().start([pBatch]() { run(*pBatch); }, TaskExecutor::Priority::interactive);
+        return true;
     }
-    void run() override
+
+  private:
+    struct Chunk
+    {
+        DiffTextWindow* pWindow;
+        int visibleTextWidth;
+        QtSizeType cacheIdx;
+    };
+
+    struct Batch
+    {
+        std::vector<Chunk> chunks;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::shared_ptr<ParallelProgress> pProgress;
+    };
+
+    static void run(Batch& batch)
     {
-        m_pDTW->recalcWordWrapHelper(0, m_visibleTextWidth, m_cacheIdx);
-        int newValue = s_runnableCount.fetchAndAddOrdered(-1) - 1;
-        g_pProgressDialog->setCurrent(s_maxNofRunnables - s_runnableCount.loadRelaxed());
-        if(newValue == 0)
+        for(;;)
         {
-            Q_EMIT m_pDTW->finishRecalcWordWrap(m_visibleTextWidth);
+            const size_t idx = batch.next.fetch_add(1);
+            if(idx >= batch.chunks.size())
+                return;
+
+            // A cancelled helper returns at once, the batch still has to count down to finish.
+            const Chunk& chunk = batch.chunks[idx];
+            chunk.pWindow->recalcWordWrapHelper(0, chunk.visibleTextWidth, chunk.cacheIdx);
+
+            batch.pProgress->step();
+            const size_t done = batch.done.fetch_add(1) + 1;
+            if(done == batch.chunks.size())
+                Q_EMIT chunk.pWindow->finishRecalcWordWrap(chunk.visibleTextWidth);
         }
     }
+
+    std::vector<Chunk> mVisibleChunks;
+    std::vector<Chunk> mOtherChunks;
 };
 
-QAtomicInt RecalcWordWrapRunnable::s_runnableCount = 0;
-QAtomicInt RecalcWordWrapRunnable::s_maxNofRunnables = 0;
+WordWrapScheduler s_wordWrapScheduler;
+} // namespace
 
 class WrapLineCacheData
 {
@@ -105,6 +161,94 @@ class WrapLineCacheData
     qint32 m_textLength = 0;
 };
 
+/*
+    Identifies what writeLine() lays out for one line on screen. The fine diffs are identified by
+    their place in the arena of the comparison, init() clears the cache before that is freed.
+*/
+struct PaintedLineKey
+{
+    const LineData* pld;
+    int wrapLineOffset;
+    int wrapLineLength;
+    FineDiff lineDiff1;
+    FineDiff lineDiff2;
+    ChangeFlags whatChanged;
+    ChangeFlags whatChanged2;
+    bool bFastSelectionRange;
+
+    bool operator==(const PaintedLineKey& other) const
+    {
+        return pld == other.pld && wrapLineOffset == other.wrapLineOffset && wrapLineLength == other.wrapLineLength &&
+               lineDiff1 == other.lineDiff1 && lineDiff2 == other.lineDiff2 && whatChanged == other.whatChanged &&
+               whatChanged2 == other.whatChanged2 && bFastSelectionRange == other.bFastSelectionRange;
+    }
+};
+
+struct PaintedLineKeyHash
+{
+    size_t operator()(const PaintedLineKey& key) const
+    {
+        size_t h = std::hash<const void*>()(key.pld);
+        const auto combine = [&h](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+        combine(std::hash<int>()(key.wrapLineOffset));
+        combine(std::hash<int>()(key.wrapLineLength));
+        combine(std::hash<const void*>()(key.lineDiff1.begin()));
+        combine(std::hash<const void*>()(key.lineDiff2.begin()));
+        combine(std::hash<int>()((int)key.whatChanged | ((int)key.whatChanged2 << 8) | ((int)key.bFastSelectionRange << 16)));
+        return h;
+    }
+};
+
+// A shaped line with its colors, drawn again as long as nothing in its key changes.
+struct PaintedLine
+{
+    std::unique_ptr<QTextLayout> layout;
+    std::unique_ptr<MonospaceText> monospace; // Instead of the layout if the text doesn't need shaping.
+    QVector<QTextLayout::FormatRange> formats;
+    QColor penColor; // Color of the last character, used for the change marker.
+    int textX = 0;   // Position of the first laid out character of a clipped line.
+};
+
+// Everything besides the key that changes how a line looks. A change drops the cache.
+struct PaintSettings
+{
+    QFont font;
+    int tabSize = 0;
+    bool bShowWhiteSpaceCharacters = false;
+    bool bShowWhiteSpace = false;
+    bool bRightToLeft = false;
+    QColor foreground;
+    QColor background;
+    QColor diffBackground;
+    QColor currentRangeBackground;
+    QColor currentRangeDiffBackground;
+    QColor diff1;
+    QColor diff2;
+    QColor diffBoth;
+
+    bool operator==(const PaintSettings& o) const
+    {
+        return font == o.font && tabSize == o.tabSize && bShowWhiteSpaceCharacters == o.bShowWhiteSpaceCharacters &&
+               bShowWhiteSpace == o.bShowWhiteSpace && bRightToLeft == o.bRightToLeft && foreground == o.foreground &&
+               background == o.background && diffBackground == o.diffBackground && currentRangeBackground == o.currentRangeBackground &&
+               currentRangeDiffBackground == o.currentRangeDiffBackground && diff1 == o.diff1 && diff2 == o.diff2 && diffBoth == o.diffBoth;
+    }
+    bool operator!=(const PaintSettings& o) const { return !(*this == o); }
+};
+
+/*
+    The wrapped lines of one Diff3Line, kept across recalcs.
+    A line that fitted on one line in some width still fits in any wider one, so most lines are
+    only laid out again when the window gets narrower than they are.
+*/
+class WrapLayoutCacheEntry
+{
+  public:
+    int width = -1;           // Width lines were computed for, -1 if never.
+    int singleLineWidth = -1; // Natural width if the text fitted on one line, else -1.
+    QVector<WrapLineCacheData> lines;
+};
+
 class DiffTextWindowData
 {
   public:
@@ -123,7 +267,7 @@ class DiffTextWindowData
 
     void writeLine(
         RLPainter& p, const LineData* pld,
-        const std::shared_ptr<const DiffList>& pLineDiff1, const std::shared_ptr<const DiffList>& pLineDiff2, const LineRef& line,
+        const FineDiff& lineDiff1, const FineDiff& lineDiff2, const LineRef& line,
         const ChangeFlags whatChanged, const ChangeFlags whatChanged2, const LineRef& srcLineIdx,
         int wrapLineOffset, int wrapLineLength, bool bWrapLine, const QRect& invalidRect);
 
@@ -134,7 +278,23 @@ class DiffTextWindowData
     [[nodiscard]] int leftInfoWidth() const { return 4 + m_lineNumberWidth; } // Number of information columns on left side
     int convertLineOnScreenToLineInSource(int lineOnScreen, e_CoordType coordType, bool bFirstLine);
 
-    void prepareTextLayout(QTextLayout& textLayout, int visibleTextWidth = -1);
+    void prepareTextLayout(QTextLayout& textLayout, int visibleTextWidth = -1, int textX = 0);
+    void positionTextLayout(QTextLayout& textLayout, int visibleTextWidth = -1, int textX = 0);
+
+    /*
+        Unwrapped lines longer than clippedLineLength are only laid out around the visible columns,
+        shaping all of a line of some MB takes far too long for painting. The columns are estimated
+        from the width of '0', so the range extends a chunk past the window on both sides.
+        Returns false if the whole line is laid out.
+    */
+    bool clipRange(const QtSizeType lineLength, QtSizeType& start, QtSizeType& length) const;
+    // Width of the text, estimated from the number of characters without a layout for lines that get clipped.
+    int textWidth(QTextLayout& textLayout, const QString& s);
+    // All columns are as wide as '0', so the width of the text follows from the line table.
+    [[nodiscard]] bool hasFixedPitchFont() const { return QFontInfo(m_pDiffTextWindow->font()).fixedPitch(); }
+
+    void prepareWrapLayoutCache();
+    const QVector<WrapLineCacheData>& wrappedLines(QTextLayout& textLayout, LineType d3lIdx, int visibleTextWidth);
 
     [[nodiscard]] bool isThreeWay() const { return KDiff3App::isTripleDiff(); };
     const QString& getFileName() { return m_filename; }
@@ -160,6 +320,20 @@ class DiffTextWindowData
     const ManualDiffHelpList* m_pManualDiffHelpList = nullptr;
     QList<QVector<WrapLineCacheData>> m_wrapLineCacheList;
 
+    // Indexed by Diff3Line, only valid for the font and options below.
+    std::vector<WrapLayoutCacheEntry> m_wrapLayoutCache;
+    QFont m_wrapLayoutFont;
+    int m_wrapLayoutTabSize = 0;
+    bool m_bWrapLayoutShowWhiteSpace = false;
+
+    // Enough for a few screens of lines, scrolling back and forth doesn't shape them again.
+    LruCache<PaintedLineKey, PaintedLine, PaintedLineKeyHash> m_paintedLines{1024};
+    PaintSettings m_paintSettings;
+
+    // Hits of the last find and the Diff3Line showing each line of m_pLineData, built on first use.
+    TextSearchIndex m_searchIndex;
+    std::vector<LineType> m_d3lIdxOfLine;
+
     QSharedPointer<Options> m_pOptions;
     QColor m_cThis;
     QColor m_cDiff1;
@@ -174,6 +348,9 @@ class DiffTextWindowData
     int m_oldFirstLine = -1;
     int m_horizScrollOffset = 0;
     int m_lineNumberWidth = 0;
+    static constexpr QtSizeType clippedLineLength = 4096;
+    // Clipped ranges start and end on multiples of this, so scrolling reuses the cached layout for a while.
+    static constexpr QtSizeType clipChunkLength = 1024;
     QAtomicInt m_maxTextWidth = -1;
 
     Selection m_selection;
@@ -283,6 +460,10 @@ void DiffTextWindow::init(
     d->m_fastSelectorNofLines = 0;
     d->m_lineNumberWidth = 0;
     d->m_maxTextWidth = -1;
+    d->m_wrapLayoutCache.clear();
+    d->m_paintedLines.clear();
+    d->m_searchIndex.clear();
+    d->m_d3lIdxOfLine.clear();
 
     d->m_pTextCodec = pTextCodec;
     d->m_eLineEndStyle = eLineEndStyle;
@@ -312,6 +493,7 @@ void DiffTextWindow::setupConnections(const KDiff3App* app)
 
     connections.push_back(KDiff3App::allowCopy.connect(boost::bind(&DiffTextWindow::canCopy, this)));
     connections.push_back(KDiff3App::getSelection.connect(boost::bind(&DiffTextWindow::getSelection, this)));
+    connections.push_back(KDiff3App::getSelectionText.connect(boost::bind(&DiffTextWindow::getSelectionText, this)));
 }
 
 void DiffTextWindow::reset()
@@ -321,6 +503,8 @@ void DiffTextWindow::reset()
     d->mDiff3LineVector = nullptr;
     d->m_filename = "";
     d->m_diff3WrapLineVector.clear();
+    d->m_searchIndex.clear();
+    d->m_d3lIdxOfLine.clear();
 }
 
 void DiffTextWindow::slotRefresh()
@@ -340,16 +524,22 @@ void DiffTextWindow::slotSelectAll()
     }
 }
 
+// Cheap enough for every availability update, unlike building the selected text.
+bool DiffTextWindow::canCopy()
+{
+    return hasFocus() && !d->m_selection.isEmpty();
+}
+
 void DiffTextWindow::slotCopy()
 {
     if(!hasFocus())
         return;
 
-    const QString curSelection = getSelection();
+    const SelectionText curSelection = getSelectionText();
 
     if(!curSelection.isEmpty())
     {
-        QApplication::clipboard()->setText(curSelection, QClipboard::Clipboard);
+        QApplication::clipboard()->setMimeData(new SelectionMimeData(curSelection), QClipboard::Clipboard);
     }
 }
 
@@ -410,31 +600,6 @@ void DiffTextWindow::dropEvent(QDropEvent* dropEvent)
     }
 }
 
-void DiffTextWindow::printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, const LineType linesPerPage, const QColor& fgColor)
-{
-    QRect clipRect = view;
-    clipRect.setTop(0);
-    painter.setClipRect(clipRect);
-    painter.translate(view.left(), 0);
-    QFontMetrics fm = painter.fontMetrics();
-    {
-        int lineHeight = fm.height() + fm.ascent();
-        const QRectF headerRect(0, 5, view.width(), 3 * (lineHeight));
-        QTextOption options;
-        options.setWrapMode(QTextOption::WordWrap);
-        // TODO: transition to Qt::LayoutDirectionAuto
-        options.setTextDirection(Qt::LeftToRight);
-        static_cast<QPainter&>(painter).drawText(headerRect, headerText, options);
-
-        painter.setPen(fgColor);
-        painter.drawLine(0, view.top() - 2, view.width(), view.top() - 2);
-    }
-
-    painter.translate(0, view.top());
-    print(painter, view, line, linesPerPage);
-    painter.resetTransform();
-}
-
 void DiffTextWindow::setFirstLine(QtNumberType firstLine)
 {
     int fontHeight = fontMetrics().lineSpacing();
@@ -487,17 +652,19 @@ int DiffTextWindow::getMaxTextWidth() const
     {
         return getVisibleTextAreaWidth();
     }
+    else if(d->hasFixedPitchFont())
+    {
+        return d->m_pLineData == nullptr ? 0 : d->m_pLineData->maxWidth(d->m_pOptions->m_tabSize) * Utils::getHorizontalAdvance(fontMetrics(), '0');
+    }
     else if(d->m_maxTextWidth.loadRelaxed() < 0)
     {
         d->m_maxTextWidth = 0;
         QTextLayout textLayout(QString(), font(), this);
         for(int i = 0; i < d->m_size; ++i)
         {
-            textLayout.clearLayout();
-            textLayout.setText(d->getString(i));
-            d->prepareTextLayout(textLayout);
-            if(textLayout.maximumWidth() > d->m_maxTextWidth.loadRelaxed())
-                d->m_maxTextWidth = qCeil(textLayout.maximumWidth());
+            const int width = d->textWidth(textLayout, d->getString(i));
+            if(width > d->m_maxTextWidth.loadRelaxed())
+                d->m_maxTextWidth = width;
         }
     }
     return d->m_maxTextWidth.loadRelaxed();
@@ -519,7 +686,7 @@ LineType DiffTextWindow::convertLineToDiff3LineIdx(LineRef line)
 LineRef DiffTextWindow::convertDiff3LineIdxToLine(LineType d3lIdx)
 {
     if(d->m_bWordWrap && d->getDiff3LineVector() != nullptr && d->getDiff3LineVector()->size() > 0)
-        return (*d->getDiff3LineVector())[std::min((QtSizeType)d3lIdx, d->getDiff3LineVector()->size() - 1)]->sumLinesNeededForDisplay();
+        return d->getDiff3LineVector()->firstWrapLine(std::min((QtSizeType)d3lIdx, d->getDiff3LineVector()->size() - 1));
     else
         return d3lIdx;
 }
@@ -573,7 +740,7 @@ void DiffTextWindow::showStatusLine(const LineRef lineFromPos)
 
     if(d->getDiff3LineVector() != nullptr && d3lIdx >= 0 && d3lIdx < (int)d->getDiff3LineVector()->size())
     {
-        std::shared_ptr<const Diff3Line> pD3l = (*d->getDiff3LineVector())[d3lIdx];
+        const Diff3Line* pD3l = (*d->getDiff3LineVector())[d3lIdx];
         if(pD3l != nullptr)
         {
             LineRef actualLine = pD3l->getLineInFile(d->m_winIdx);
@@ -843,9 +1010,13 @@ void DiffTextWindow::convertToLinePos(int x, int y, LineRef& line, QtNumberType&
     if(line.isValid() && (!d->getOptions()->wordWrapOn() || line < d->m_diff3WrapLineVector.count()))
     {
         QString s = d->getLineString(line);
+        QtSizeType clipStart = 0;
+        QtSizeType clipLength = 0;
+        if(d->clipRange(s.length(), clipStart, clipLength))
+            s = s.mid(clipStart, clipLength);
         QTextLayout textLayout(s, font(), this);
-        d->prepareTextLayout(textLayout);
-        pos = textLayout.lineAt(0).xToCursor(x - textLayout.position().x());
+        d->prepareTextLayout(textLayout, -1, (int)clipStart * Utils::getHorizontalAdvance(fm, '0'));
+        pos = (QtNumberType)clipStart + textLayout.lineAt(0).xToCursor(x - textLayout.position().x());
     }
     else
         pos = -1;
@@ -904,8 +1075,50 @@ class FormatRangeHelper
     }
 };
 
-void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleTextWidth)
+void DiffTextWindowData::prepareWrapLayoutCache()
+{
+    const QFont& currentFont = m_pDiffTextWindow->font();
+    if(m_wrapLayoutFont != currentFont || m_wrapLayoutTabSize != m_pOptions->m_tabSize ||
+       m_bWrapLayoutShowWhiteSpace != m_pOptions->m_bShowWhiteSpaceCharacters)
+    {
+        m_wrapLayoutCache.clear();
+        m_wrapLayoutFont = currentFont;
+        m_wrapLayoutTabSize = m_pOptions->m_tabSize;
+        m_bWrapLayoutShowWhiteSpace = m_pOptions->m_bShowWhiteSpaceCharacters;
+    }
+
+    // Sized here in the gui thread, the runnables each fill their own range of entries.
+    m_wrapLayoutCache.resize(mDiff3LineVector->size());
+}
+
+const QVector<WrapLineCacheData>& DiffTextWindowData::wrappedLines(QTextLayout& textLayout, LineType d3lIdx, int visibleTextWidth)
+{
+    WrapLayoutCacheEntry& entry = m_wrapLayoutCache[d3lIdx];
+    if(entry.width >= 0 && (entry.width == visibleTextWidth || (entry.singleLineWidth >= 0 && entry.singleLineWidth <= visibleTextWidth)))
+    {
+        entry.width = visibleTextWidth;
+        return entry.lines;
+    }
+
+    textLayout.clearLayout();
+    textLayout.setText(getString(d3lIdx));
+    prepareTextLayout(textLayout, visibleTextWidth);
+
+    entry.lines.clear();
+    for(QtNumberType l = 0; l < textLayout.lineCount(); ++l)
+    {
+        const QTextLine line = textLayout.lineAt(l);
+        entry.lines.push_back(WrapLineCacheData(d3lIdx, line.textStart(), line.textLength()));
+    }
+    entry.singleLineWidth = textLayout.lineCount() == 1 ? qCeil(textLayout.lineAt(0).naturalTextWidth()) : -1;
+    // A negative width means no wrapping at all, that isn't worth keeping.
+    entry.width = std::max(visibleTextWidth, -1);
+    return entry.lines;
+}
+
+void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleTextWidth, int textX)
 {
+    PaintBenchmark::countLayout();
     QTextOption textOption;
 
     textOption.setTabStopDistance(QFontMetricsF(m_pDiffTextWindow->font()).horizontalAdvance(' ') * m_pOptions->m_tabSize);
@@ -937,13 +1150,6 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleT
 
     int leading = m_pDiffTextWindow->fontMetrics().leading();
     int height = 0;
-    //TODO: Fix after line number area is converted to a QWidget.
-    int fontWidth = Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0');
-    int xOffset = leftInfoWidth() * fontWidth - m_horizScrollOffset;
-    int textWidth = visibleTextWidth;
-    if(textWidth < 0)
-        textWidth = m_pDiffTextWindow->width() - xOffset;
-
     int indentation = 0;
     while(true)
     {
@@ -966,12 +1172,52 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleT
     }
 
     textLayout.endLayout();
+    positionTextLayout(textLayout, visibleTextWidth, textX);
+}
+
+void DiffTextWindowData::positionTextLayout(QTextLayout& textLayout, int visibleTextWidth, int textX)
+{
+    //TODO: Fix after line number area is converted to a QWidget.
+    int fontWidth = Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0');
+    int xOffset = leftInfoWidth() * fontWidth - m_horizScrollOffset + textX;
+    int textWidth = visibleTextWidth;
+    if(textWidth < 0)
+        textWidth = m_pDiffTextWindow->width() - xOffset;
+
     if(m_pOptions->m_bRightToLeftLanguage)
         textLayout.setPosition(QPointF(textWidth - textLayout.maximumWidth(), 0));
     else
         textLayout.setPosition(QPointF(xOffset, 0));
 }
 
+bool DiffTextWindowData::clipRange(const QtSizeType lineLength, QtSizeType& start, QtSizeType& length) const
+{
+    if(m_bWordWrap || m_pOptions->m_bRightToLeftLanguage || lineLength <= clippedLineLength)
+        return false;
+
+    const int fontWidth = Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0');
+    const QtSizeType firstColumn = m_horizScrollOffset / fontWidth;
+    const QtSizeType visibleColumns = m_pDiffTextWindow->width() / fontWidth + 1;
+    const QtSizeType end = std::min(lineLength, ((firstColumn + visibleColumns) / clipChunkLength + 2) * clipChunkLength);
+    start = std::min(end, std::max<QtSizeType>(0, (firstColumn / clipChunkLength - 1) * clipChunkLength));
+    length = end - start;
+    return true;
+}
+
+int DiffTextWindowData::textWidth(QTextLayout& textLayout, const QString& s)
+{
+    if(s.length() > clippedLineLength)
+    {
+        const qint64 columns = s.length() + (qint64)s.count(QLatin1Char('\t')) * (m_pOptions->m_tabSize - 1);
+        return (int)std::min<qint64>(columns * Utils::getHorizontalAdvance(m_pDiffTextWindow->fontMetrics(), '0'), limits<int>::max());
+    }
+
+    textLayout.clearLayout();
+    textLayout.setText(s);
+    prepareTextLayout(textLayout);
+    return qCeil(textLayout.maximumWidth());
+}
+
 /*
     Don't try to use invalid rect to block drawing of lines based on there apparent horizontal dementions.
     This does not always work for very long lines being scrolled horizontally. (Causes blanking of diff text area)
@@ -979,8 +1225,8 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, int visibleT
 void DiffTextWindowData::writeLine(
     RLPainter& p,
     const LineData* pld,
-    const std::shared_ptr<const DiffList>& pLineDiff1,
-    const std::shared_ptr<const DiffList>& pLineDiff2,
+    const FineDiff& lineDiff1,
+    const FineDiff& lineDiff2,
     const LineRef& line,
     const ChangeFlags whatChanged,
     const ChangeFlags whatChanged2,
@@ -1017,8 +1263,8 @@ void DiffTextWindowData::writeLine(
         return;
 
     ChangeFlags changed = whatChanged;
-    if(pLineDiff1 != nullptr) changed |= AChanged;
-    if(pLineDiff2 != nullptr) changed |= BChanged;
+    if(!lineDiff1.isNull()) changed |= AChanged;
+    if(!lineDiff2.isNull()) changed |= BChanged;
 
     QColor penColor = m_pOptions->foregroundColor();
     p.setPen(penColor);
@@ -1037,92 +1283,128 @@ void DiffTextWindowData::writeLine(
 
     if(pld != nullptr)
     {
-        // First calculate the "changed" information for each character.
-        QtSizeType i = 0;
-        QString lineString = pld->getLine();
-        if(!lineString.isEmpty())
+        // Selected lines change with every mouse move and set bSelectionContainsData, they aren't cached.
+        const bool bCacheable = !m_selection.lineWithin(line);
+        // Characters laid out, a clipped line is keyed by its range like a wrapped one.
+        QtSizeType textStart = wrapLineOffset;
+        QtSizeType textEnd = m_bWordWrap ? wrapLineOffset + wrapLineLength : pld->size();
+        QtSizeType clipLength = 0;
+        const bool bClipped = clipRange(pld->size(), textStart, clipLength);
+        if(bClipped)
+            textEnd = textStart + clipLength;
+
+        const PaintedLineKey key{pld, (int)textStart, bClipped ? (int)clipLength : m_bWordWrap ? wrapLineLength : -1, lineDiff1, lineDiff2, whatChanged, whatChanged2, bFastSelectionRange};
+        PaintedLine* pPainted = bCacheable ? m_paintedLines.find(key) : nullptr;
+        PaintedLine uncached;
+        if(pPainted == nullptr)
         {
-            switch(lineString[lineString.length() - 1].unicode())
+            // First calculate the "changed" information for each character.
+            QtSizeType i = 0;
+            QString lineString = pld->getLine().mid(textStart, textEnd - textStart);
+            if(!lineString.isEmpty() && textEnd == pld->size())
             {
-                case '\n':
-                    lineString[lineString.length() - 1] = 0x00B6;
-                    break; // "Pilcrow", "paragraph mark"
-                case '\r':
-                    lineString[lineString.length() - 1] = 0x00A4;
-                    break; // Currency sign ;0x2761 "curved stem paragraph sign ornament"
-                           //case '\0b' : lineString[lineString.length()-1] = 0x2756; break; // some other nice looking character
+                switch(lineString[lineString.length() - 1].unicode())
+                {
+                    case '\n':
+                        lineString[lineString.length() - 1] = 0x00B6;
+                        break; // "Pilcrow", "paragraph mark"
+                    case '\r':
+                        lineString[lineString.length() - 1] = 0x00A4;
+                        break; // Currency sign ;0x2761 "curved stem paragraph sign ornament"
+                               //case '\0b' : lineString[lineString.length()-1] = 0x2756; break; // some other nice looking character
+                }
             }
-        }
-        QVector<ChangeFlags> charChanged(pld->size());
-        Merger merger(pLineDiff1, pLineDiff2);
-        while(!merger.isEndReached() && i < pld->size())
-        {
-            if(i < pld->size())
+            QVector<ChangeFlags> charChanged(textEnd - textStart);
+            Merger merger(lineDiff1, lineDiff2);
+            merger.skip(textStart);
+            while(!merger.isEndReached() && i < charChanged.size())
             {
                 charChanged[i] = merger.whatChanged();
                 ++i;
+                merger.next();
             }
-            merger.next();
-        }
 
-        int outPos = 0;
+            // Selections are in columns of the wrapped line, but of the whole line if it is clipped.
+            int outPos = bClipped ? (int)textStart : 0;
+            const Selection::Span selected = m_selection.spanInLine(line);
 
-        QtSizeType lineLength = m_bWordWrap ? wrapLineOffset + wrapLineLength : lineString.length();
+            FormatRangeHelper frh;
 
-        FormatRangeHelper frh;
+            for(i = textStart; i < textEnd; ++i)
+            {
+                penColor = m_pOptions->foregroundColor();
+                ChangeFlags cchanged = charChanged[i - textStart] | whatChanged;
 
-        for(i = wrapLineOffset; i < lineLength; ++i)
-        {
-            penColor = m_pOptions->foregroundColor();
-            ChangeFlags cchanged = charChanged[i] | whatChanged;
+                if(cchanged == BChanged)
+                {
+                    penColor = m_cDiff2;
+                }
+                else if(cchanged == AChanged)
+                {
+                    penColor = m_cDiff1;
+                }
+                else if(cchanged == Both)
+                {
+                    penColor = m_cDiffBoth;
+                }
 
-            if(cchanged == BChanged)
-            {
-                penColor = m_cDiff2;
-            }
-            else if(cchanged == AChanged)
-            {
-                penColor = m_cDiff1;
-            }
-            else if(cchanged == Both)
-            {
-                penColor = m_cDiffBoth;
-            }
+                if(penColor != m_pOptions->foregroundColor() && whatChanged2 == NoChange && !m_pOptions->m_bShowWhiteSpace)
+                {
+                    // The user doesn't want to see highlighted white space.
+                    penColor = m_pOptions->foregroundColor();
+                }
 
-            if(penColor != m_pOptions->foregroundColor() && whatChanged2 == NoChange && !m_pOptions->m_bShowWhiteSpace)
-            {
-                // The user doesn't want to see highlighted white space.
-                penColor = m_pOptions->foregroundColor();
-            }
+                frh.setBackground(bgColor);
+                if(!selected.contains(outPos))
+                {
+                    if(penColor != m_pOptions->foregroundColor())
+                    {
+                        frh.setBackground(diffBgColor);
+                        // Setting italic font here doesn't work: Changing the font only when drawing is too late
+                    }
 
-            frh.setBackground(bgColor);
-            if(!m_selection.within(line, outPos))
-            {
-                if(penColor != m_pOptions->foregroundColor())
+                    frh.setPen(penColor);
+                    frh.next();
+                    frh.setFont(normalFont);
+                }
+                else
                 {
-                    frh.setBackground(diffBgColor);
-                    // Setting italic font here doesn't work: Changing the font only when drawing is too late
+                    frh.setBackground(m_pDiffTextWindow->palette().highlight().color());
+                    frh.setPen(m_pDiffTextWindow->palette().highlightedText().color());
+                    frh.next();
+
+                    m_selection.bSelectionContainsData = true;
                 }
 
-                frh.setPen(penColor);
-                frh.next();
-                frh.setFont(normalFont);
+                ++outPos;
+            } // end for
+
+            uncached.textX = bClipped ? (int)textStart * fontWidth : 0;
+            uncached.formats = frh;
+            uncached.penColor = penColor;
+            // Shown white space and right to left text are left to QTextLayout.
+            if(hasFixedPitchFont() && !m_pOptions->m_bShowWhiteSpaceCharacters && !m_pOptions->m_bRightToLeftLanguage && MonospaceText::isSimple(lineString))
+            {
+                uncached.monospace = std::make_unique<MonospaceText>(lineString, uncached.formats, m_pOptions->foregroundColor(), m_pOptions->m_tabSize, m_pDiffTextWindow->font());
             }
             else
             {
-                frh.setBackground(m_pDiffTextWindow->palette().highlight().color());
-                frh.setPen(m_pDiffTextWindow->palette().highlightedText().color());
-                frh.next();
-
-                m_selection.bSelectionContainsData = true;
+                uncached.layout = std::make_unique<QTextLayout>(lineString, m_pDiffTextWindow->font(), m_pDiffTextWindow);
+                prepareTextLayout(*uncached.layout, -1, uncached.textX);
             }
+            pPainted = bCacheable ? &m_paintedLines.insert(key, std::move(uncached)) : &uncached;
+        }
+        else if(pPainted->layout != nullptr)
+        {
+            // Only the horizontal position can differ from when the line was cached.
+            positionTextLayout(*pPainted->layout, -1, pPainted->textX);
+        }
 
-            ++outPos;
-        } // end for
-
-        QTextLayout textLayout(lineString.mid(wrapLineOffset, lineLength - wrapLineOffset), m_pDiffTextWindow->font(), m_pDiffTextWindow);
-        prepareTextLayout(textLayout);
-        textLayout.draw(&p, QPoint(0, yOffset), frh /*, const QRectF & clip = QRectF() */);
+        penColor = pPainted->penColor;
+        if(pPainted->monospace != nullptr)
+            pPainted->monospace->draw(p, leftInfoWidth() * fontWidth - m_horizScrollOffset + pPainted->textX, yOffset);
+        else
+            pPainted->layout->draw(&p, QPoint(0, yOffset), pPainted->formats);
     }
 
     p.fillRect(0, yOffset, leftInfoWidth() * fontWidth, fontHeight, m_pOptions->backgroundColor());
@@ -1185,6 +1467,7 @@ void DiffTextWindowData::writeLine(
 
 void DiffTextWindow::paintEvent(QPaintEvent* e)
 {
+    TraceScope traceScope(TraceStage::paint);
     QRect invalidRect = e->rect();
     if(invalidRect.isEmpty())
         return;
@@ -1197,16 +1480,27 @@ void DiffTextWindow::paintEvent(QPaintEvent* e)
     }
 
     bool bOldSelectionContainsData = d->m_selection.bSelectionContainsData;
-    d->m_selection.bSelectionContainsData = false;
+    // After a scroll only the exposed lines are drawn, the others keep what they found of the selection.
+    const bool bFullPaint = invalidRect.contains(rect());
+    if(bFullPaint)
+        d->m_selection.bSelectionContainsData = false;
 
+    const int fontHeight = fontMetrics().lineSpacing();
+    LineRef beginLine = d->m_firstLine;
     LineRef endLine = std::min(d->m_firstLine + getNofVisibleLines() + 2, getNofLines());
+    if(!bFullPaint)
+    {
+        // One extra line on each side, characters may exceed their line a little.
+        beginLine = std::max((LineType)d->m_firstLine, d->m_firstLine + invalidRect.top() / fontHeight - 1);
+        endLine = std::min((LineType)endLine, d->m_firstLine + invalidRect.bottom() / fontHeight + 2);
+    }
     //TODO: Drop RLPainter. How?
     RLPainter p(this, d->getOptions()->m_bRightToLeftLanguage, width(), Utils::getHorizontalAdvance(fontMetrics(), '0'));
 
     p.setFont(font());
     p.QPainter::fillRect(invalidRect, d->getOptions()->backgroundColor());
 
-    d->draw(p, invalidRect, d->m_firstLine, endLine);
+    d->draw(p, invalidRect, beginLine, endLine);
     p.end();
 
     d->m_oldFirstLine = d->m_firstLine;
@@ -1216,21 +1510,6 @@ void DiffTextWindow::paintEvent(QPaintEvent* e)
         Q_EMIT newSelection();
 }
 
-void DiffTextWindow::print(RLPainter& p, const QRect&, int firstLine, const LineType nofLinesPerPage)
-{
-    if(d->getDiff3LineVector() == nullptr || !updatesEnabled() ||
-       (d->m_diff3WrapLineVector.empty() && d->m_bWordWrap))
-        return;
-    resetSelection();
-    int oldFirstLine = d->m_firstLine;
-    d->m_firstLine = firstLine;
-    QRect invalidRect = QRect(0, 0, 1000000000, 1000000000);
-    d->getOptions()->beginPrint();
-    d->draw(p, invalidRect, firstLine, std::min(firstLine + nofLinesPerPage, getNofLines()));
-    d->getOptions()->endPrint();
-    d->m_firstLine = oldFirstLine;
-}
-
 void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, const int beginLine, const LineRef& endLine)
 {
     if(m_pLineData == nullptr || m_pLineData->empty()) return;
@@ -1257,13 +1536,33 @@ void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, const int
     }
     m_cDiffBoth = m_pOptions->conflictColor(); // Conflict color
 
+    PaintSettings settings;
+    settings.font = m_pDiffTextWindow->font();
+    settings.tabSize = m_pOptions->m_tabSize;
+    settings.bShowWhiteSpaceCharacters = m_pOptions->m_bShowWhiteSpaceCharacters;
+    settings.bShowWhiteSpace = m_pOptions->m_bShowWhiteSpace;
+    settings.bRightToLeft = m_pOptions->m_bRightToLeftLanguage;
+    settings.foreground = m_pOptions->foregroundColor();
+    settings.background = m_pOptions->backgroundColor();
+    settings.diffBackground = m_pOptions->diffBackgroundColor();
+    settings.currentRangeBackground = m_pOptions->getCurrentRangeBgColor();
+    settings.currentRangeDiffBackground = m_pOptions->getCurrentRangeDiffBgColor();
+    settings.diff1 = m_cDiff1;
+    settings.diff2 = m_cDiff2;
+    settings.diffBoth = m_cDiffBoth;
+    if(settings != m_paintSettings)
+    {
+        m_paintedLines.clear();
+        m_paintSettings = settings;
+    }
+
     p.setPen(m_cThis);
 
     for(int line = beginLine; line < endLine; ++line)
     {
         int wrapLineOffset = 0;
         int wrapLineLength = 0;
-        std::shared_ptr<const Diff3Line> d3l = nullptr;
+        const Diff3Line* d3l = nullptr;
         bool bWrapLine = false;
         if(m_bWordWrap)
         {
@@ -1277,19 +1576,19 @@ void DiffTextWindowData::draw(RLPainter& p, const QRect& invalidRect, const int
         {
             d3l = (*mDiff3LineVector)[line];
         }
-        std::shared_ptr<const DiffList> pFineDiff1;
-        std::shared_ptr<const DiffList> pFineDiff2;
+        FineDiff fineDiff1;
+        FineDiff fineDiff2;
         ChangeFlags changed = NoChange;
         ChangeFlags changed2 = NoChange;
 
         LineRef srcLineIdx;
-        d3l->getLineInfo(m_winIdx, KDiff3App::isTripleDiff(), srcLineIdx, pFineDiff1, pFineDiff2, changed, changed2);
+        d3l->getLineInfo(m_winIdx, KDiff3App::isTripleDiff(), srcLineIdx, fineDiff1, fineDiff2, changed, changed2);
 
         writeLine(
             p,                                                             // QPainter
             !srcLineIdx.isValid() ? nullptr : &(*m_pLineData)[srcLineIdx], // Text in this line
-            pFineDiff1,
-            pFineDiff2,
+            fineDiff1,
+            fineDiff2,
             line, // Line on the screen
             changed,
             changed2,
@@ -1308,7 +1607,7 @@ QString DiffTextWindowData::getString(LineType d3lIdx)
     if(m_pLineData == nullptr || m_pLineData->empty() || d3lIdx < 0 || d3lIdx >= mDiff3LineVector->size())
         return QString();
 
-    std::shared_ptr<const Diff3Line> d3l = (*mDiff3LineVector)[d3lIdx];
+    const Diff3Line* d3l = (*mDiff3LineVector)[d3lIdx];
     const LineRef lineIdx = d3l->getLineIndex(m_winIdx);
 
     if(!lineIdx.isValid())
@@ -1367,10 +1666,14 @@ int DiffTextWindow::getVisibleTextAreaWidth() const
 
 QString DiffTextWindow::getSelection() const
 {
-    if(d->m_pLineData == nullptr)
-        return QString();
+    return getSelectionText().toString();
+}
 
-    QString selectionString;
+SelectionText DiffTextWindow::getSelectionText() const
+{
+    SelectionText selectionText;
+    if(d->m_pLineData == nullptr)
+        return selectionText;
 
     int line = 0;
     int lineIdx = 0;
@@ -1379,7 +1682,7 @@ QString DiffTextWindow::getSelection() const
     int vectorSize = d->m_bWordWrap ? d->m_diff3WrapLineVector.size() : d->getDiff3LineVector()->size();
     for(it = 0; it < vectorSize; ++it)
     {
-        std::shared_ptr<const Diff3Line> d3l = d->m_bWordWrap ? d->m_diff3WrapLineVector[it].pD3L : (*d->getDiff3LineVector())[it];
+        const Diff3Line* d3l = d->m_bWordWrap ? d->m_diff3WrapLineVector[it].pD3L : (*d->getDiff3LineVector())[it];
 
         assert(d->m_winIdx >= e_SrcSelector::A && d->m_winIdx <= e_SrcSelector::C);
 
@@ -1398,70 +1701,90 @@ QString DiffTextWindow::getSelection() const
 
         if(lineIdx != -1)
         {
-            QtSizeType size = (*d->m_pLineData)[lineIdx].size();
-            QString lineString = (*d->m_pLineData)[lineIdx].getLine();
+            const LineData& lineData = (*d->m_pLineData)[lineIdx];
+            QtSizeType size = lineData.size();
+            QtSizeType offset = 0;
 
             if(d->m_bWordWrap)
             {
                 size = d->m_diff3WrapLineVector[it].wrapLineLength;
-                lineString = lineString.mid(d->m_diff3WrapLineVector[it].wrapLineOffset, size);
+                offset = d->m_diff3WrapLineVector[it].wrapLineOffset;
             }
 
-            for(QtSizeType i = 0; i < size; ++i)
-            {
-                if(d->m_selection.within(line, i))
-                {
-                    selectionString += lineString[i];
-                }
-            }
+            const Selection::Span selected = d->m_selection.spanInLine(line);
+            const QtSizeType selectedEnd = std::min(size, selected.end);
+            if(selected.begin < selectedEnd)
+                selectionText.append(lineData, offset + selected.begin, selectedEnd - selected.begin);
 
-            if(d->m_selection.within(line, size) &&
+            if(selected.contains(size) &&
                (!d->m_bWordWrap || it + 1 >= vectorSize || d3l != d->m_diff3WrapLineVector[it + 1].pD3L))
             {
-#if defined(Q_OS_WIN)
-                selectionString += '\r';
-#endif
-                selectionString += '\n';
+                selectionText.appendLineEnd();
             }
         }
 
         ++line;
     }
 
-    return selectionString;
+    return selectionText;
 }
 
+/*
+    Searches the whole input once and remembers the hits, see TextSearchIndex. Each Diff3LineVector
+    keeps the lines of an input in order, so the hits sorted by line are sorted by Diff3Line too and
+    the next one is found by binary search.
+*/
 bool DiffTextWindow::findString(const QString& s, LineRef& d3vLine, QtSizeType& posInLine, bool bDirDown, bool bCaseSensitive)
 {
-    LineRef it = d3vLine;
-    QtSizeType endIt = bDirDown ? d->getDiff3LineVector()->size() : -1;
-    quint32 step = bDirDown ? 1 : -1;
-    QtSizeType startPos = posInLine;
+    const Diff3LineVector* pDiff3LineVector = d->getDiff3LineVector();
+    if(d->m_pLineData == nullptr || d->m_pLineData->empty() || pDiff3LineVector == nullptr)
+        return false;
 
-    for(; it != endIt; it += step)
+    if(d->m_d3lIdxOfLine.empty())
     {
-        QString line = d->getString(it);
-        if(!line.isEmpty())
+        d->m_d3lIdxOfLine.assign(d->m_pLineData->size(), LineRef::invalid);
+        for(QtSizeType d3lIdx = 0; d3lIdx < pDiff3LineVector->size(); ++d3lIdx)
         {
-            QtSizeType pos = line.indexOf(s, startPos, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            //TODO: Provide error message when failsafe is triggered.
-            if(Q_UNLIKELY(pos > limits<int>::max()))
-            {
-                qCWarning(kdiffMain) << "Skip possiable match line offset to large.";
-                continue;
-            }
+            const LineRef line = (*pDiff3LineVector)[d3lIdx]->getLineIndex(d->m_winIdx);
+            if(line.isValid() && (size_t)line < d->m_d3lIdxOfLine.size())
+                d->m_d3lIdxOfLine[line] = (LineType)d3lIdx;
+        }
+    }
 
-            if(pos != -1)
-            {
-                d3vLine = it;
-                posInLine = pos;
-                return true;
-            }
+    const std::vector<TextSearchIndex::Hit>& hits = d->m_searchIndex.hits(*d->m_pLineData, s, bCaseSensitive);
+    const std::vector<LineType>& d3lIdxOfLine = d->m_d3lIdxOfLine;
+    const auto hitBefore = [&d3lIdxOfLine](const TextSearchIndex::Hit& hit, const std::pair<LineType, QtSizeType>& target) {
+        const LineType d3lIdx = d3lIdxOfLine[hit.line];
+        return d3lIdx < target.first || (d3lIdx == target.first && hit.pos < target.second);
+    };
+
+    std::vector<TextSearchIndex::Hit>::const_iterator it;
+    if(bDirDown)
+    {
+        it = std::lower_bound(hits.cbegin(), hits.cend(), std::make_pair((LineType)d3vLine, posInLine), hitBefore);
+    }
+    else
+    {
+        // A hit at or after posInLine in the current line, otherwise the first hit of the nearest line above.
+        it = std::lower_bound(hits.cbegin(), hits.cend(), std::make_pair((LineType)d3vLine, posInLine), hitBefore);
+        if(it == hits.cend() || d3lIdxOfLine[it->line] != d3vLine)
+        {
+            it = std::lower_bound(hits.cbegin(), hits.cend(), std::make_pair((LineType)d3vLine, (QtSizeType)0), hitBefore);
+            if(it == hits.cbegin())
+                return false;
 
-            startPos = 0;
+            const LineType line = (it - 1)->line;
+            while(it != hits.cbegin() && (it - 1)->line == line)
+                --it;
         }
     }
-    return false;
+
+    if(it == hits.cend() || d3lIdxOfLine[it->line] == LineRef::invalid)
+        return false;
+
+    d3vLine = d3lIdxOfLine[it->line];
+    posInLine = it->pos;
+    return true;
 }
 
 void DiffTextWindow::convertD3LCoordsToLineCoords(LineType d3LIdx, int d3LPos, LineRef& line, int& pos)
@@ -1512,7 +1835,7 @@ void DiffTextWindow::setSelection(LineRef firstLine, QtSizeType startPos, LineRe
     {
         lastLine = getNofLines() - 1;
 
-        std::shared_ptr<const Diff3Line> d3l = (*d->getDiff3LineVector())[convertLineToDiff3LineIdx(lastLine)];
+        const Diff3Line* d3l = (*d->getDiff3LineVector())[convertLineToDiff3LineIdx(lastLine)];
         LineRef line;
         if(d->m_winIdx == e_SrcSelector::A) line = d3l->getLineA();
         if(d->m_winIdx == e_SrcSelector::B) line = d3l->getLineB();
@@ -1573,7 +1896,7 @@ int DiffTextWindowData::convertLineOnScreenToLineInSource(int lineOnScreen, e_Co
         if(coordType == eD3LLineCoords) return d3lIdx;
         while(!line.isValid() && d3lIdx < mDiff3LineVector->size() && d3lIdx >= 0)
         {
-            std::shared_ptr<const Diff3Line> d3l = (*mDiff3LineVector)[d3lIdx];
+            const Diff3Line* d3l = (*mDiff3LineVector)[d3lIdx];
             if(m_winIdx == e_SrcSelector::A) line = d3l->getLineA();
             if(m_winIdx == e_SrcSelector::B) line = d3l->getLineB();
             if(m_winIdx == e_SrcSelector::C) line = d3l->getLineC();
@@ -1619,26 +1942,7 @@ void DiffTextWindow::convertSelectionToD3LCoords()
 
 bool DiffTextWindow::startRunnables()
 {
-    if(s_runnables.count() == 0)
-    {
-        return false;
-    }
-    else
-    {
-        g_pProgressDialog->setStayHidden(true);
-        ProgressProxy::startBackgroundTask();
-        g_pProgressDialog->setMaxNofSteps(s_runnables.count());
-        RecalcWordWrapRunnable::s_maxNofRunnables = s_runnables.count();
-        g_pProgressDialog->setCurrent(0);
-
-        for(int i = 0; i < s_runnables.count(); ++i)
-        {
-            QThreadPool::globalInstance()->start(s_runnables[i]);
-        }
-
-        s_runnables.clear();
-        return true;
-    }
+    return s_wordWrapScheduler.start();
 }
 
 void DiffTextWindow::recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSize, int visibleTextWidth)
@@ -1650,6 +1954,13 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSiz
         return;
     }
 
+    // Taken before the wrap lines are cleared below.
+    const LineType firstVisibleD3LIdx = convertLineToDiff3LineIdx(d->m_firstLine);
+    const LineType endVisibleD3LIdx = firstVisibleD3LIdx + getNofVisibleLines() + 1;
+    const auto isVisibleChunk = [firstVisibleD3LIdx, endVisibleD3LIdx](QtSizeType firstD3LIdx) {
+        return firstD3LIdx < endVisibleD3LIdx && firstD3LIdx + s_linesPerRunnable > firstVisibleD3LIdx;
+    };
+
     d->m_bWordWrap = bWordWrap;
 
     if(bWordWrap)
@@ -1662,11 +1973,12 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSiz
         if(wrapLineVectorSize == 0)
         {
             d->m_wrapLineCacheList.clear();
+            d->prepareWrapLayoutCache();
             setUpdatesEnabled(false);
             for(QtSizeType i = 0, j = 0; i < d->getDiff3LineVector()->size(); i += s_linesPerRunnable, ++j)
             {
                 d->m_wrapLineCacheList.append(QVector<WrapLineCacheData>());
-                s_runnables.push_back(new RecalcWordWrapRunnable(this, visibleTextWidth, j));
+                s_wordWrapScheduler.add(this, visibleTextWidth, j, isVisibleChunk(i));
             }
         }
         else
@@ -1684,7 +1996,7 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSiz
             setUpdatesEnabled(false);
             for(int i = 0, j = 0; i < d->getDiff3LineVector()->size(); i += s_linesPerRunnable, ++j)
             {
-                s_runnables.push_back(new RecalcWordWrapRunnable(this, visibleTextWidth, j));
+                s_wordWrapScheduler.add(this, visibleTextWidth, j, isVisibleChunk(i));
             }
         }
         else
@@ -1696,6 +2008,7 @@ void DiffTextWindow::recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSiz
 
 void DiffTextWindow::recalcWordWrapHelper(QtSizeType wrapLineVectorSize, int visibleTextWidth, QtSizeType cacheListIdx)
 {
+    TraceScope traceScope(TraceStage::wordWrap);
     if(d->m_bWordWrap)
     {
         if(g_pProgressDialog->wasCancelled())
@@ -1721,16 +2034,9 @@ void DiffTextWindow::recalcWordWrapHelper(QtSizeType wrapLineVectorSize, int vis
             LineType linesNeeded = 0;
             if(wrapLineVectorSize == 0)
             {
-                QString s = d->getString(i);
-                textLayout.clearLayout();
-                textLayout.setText(s);
-                d->prepareTextLayout(textLayout, visibleTextWidth);
-                linesNeeded = textLayout.lineCount();
-                for(QtNumberType l = 0; l < linesNeeded; ++l)
-                {
-                    QTextLine line = textLayout.lineAt(l);
-                    wrapLineCache.push_back(WrapLineCacheData(i, line.textStart(), line.textLength()));
-                }
+                const QVector<WrapLineCacheData>& lines = d->wrappedLines(textLayout, i, visibleTextWidth);
+                linesNeeded = lines.count();
+                wrapLineCache.append(lines);
             }
             else if(wrapLineVectorSize > 0 && cacheListIdx2 < d->m_wrapLineCacheList.count())
             {
@@ -1803,7 +2109,7 @@ void DiffTextWindow::recalcWordWrapHelper(QtSizeType wrapLineVectorSize, int vis
             Q_EMIT firstLineChanged(d->m_firstLine);
         }
     }
-    else // no word wrap, just calc the maximum text width
+    else if(!d->hasFixedPitchFont()) // no word wrap, just calc the maximum text width
     {
         if(g_pProgressDialog->wasCancelled())
             return;
@@ -1818,11 +2124,7 @@ void DiffTextWindow::recalcWordWrapHelper(QtSizeType wrapLineVectorSize, int vis
         {
             if(g_pProgressDialog->wasCancelled())
                 return;
-            textLayout.clearLayout();
-            textLayout.setText(d->getString(i));
-            d->prepareTextLayout(textLayout);
-            if(textLayout.maximumWidth() > maxTextWidth)
-                maxTextWidth = qCeil(textLayout.maximumWidth());
+            maxTextWidth = std::max(maxTextWidth, d->textWidth(textLayout, d->getString(i)));
         }
 
         for(int prevMaxTextWidth = d->m_maxTextWidth.fetchAndStoreOrdered(maxTextWidth);
@@ -1978,7 +2280,7 @@ LineRef DiffTextWindow::calcTopLineInFile(const LineRef firstLine)
     LineRef currentLine;
     for(QtSizeType i = convertLineToDiff3LineIdx(firstLine); i < d->getDiff3LineVector()->size(); ++i)
     {
-        std::shared_ptr<const Diff3Line> d3l = (*d->getDiff3LineVector())[i];
+        const Diff3Line* d3l = (*d->getDiff3LineVector())[i];
         currentLine = d3l->getLineInFile(d->m_winIdx);
         if(currentLine.isValid()) break;
     }
@@ -2067,8 +2369,9 @@ void DiffTextWindowFrame::slotBrowseButtonClicked()
 
 void DiffTextWindowFrame::slotEncodingChanged(QTextCodec* c)
 {
-    Q_EMIT encodingChanged(c); //relay signal from encoding label
+    // Set first, the reload triggered by the signal decodes with it.
     d->mSourceData->setEncoding(c);
+    Q_EMIT encodingChanged(c); //relay signal from encoding label
 }
 
 EncodingLabel::EncodingLabel(const QString& text, const QSharedPointer<SourceData>& pSD, const QSharedPointer<Options>& pOptions):
@@ -15,6 +15,7 @@
 #include "diff.h"
 
 #include "LineRef.h"
+#include "SelectionText.h"
 #include "TypeUtils.h"
 
 #include <QLabel>
@@ -29,14 +30,12 @@
 #include <memory>
 
 class QMenu;
-class RecalcWordWrapRunnable;
 class QScrollBar;
 class QStatusBar;
 class Options;
 class DiffTextWindowData;
 class DiffTextWindowFrame;
 class EncodingLabel;
-class RLPainter;
 class SourceData;
 
 class KDiff3App;
@@ -65,6 +64,7 @@ class DiffTextWindow : public QWidget
     void convertToLinePos(int x, int y, LineRef& line, QtNumberType& pos);
 
     [[nodiscard]] QString getSelection() const;
+    [[nodiscard]] SelectionText getSelectionText() const;
     [[nodiscard]] int getFirstLine() const;
     LineRef calcTopLineInFile(const LineRef firstLine);
 
@@ -89,9 +89,6 @@ class DiffTextWindow : public QWidget
     void recalcWordWrap(bool bWordWrap, QtSizeType wrapLineVectorSize, int visibleTextWidth);
     void recalcWordWrapHelper(QtSizeType wrapLineVectorSize, int visibleTextWidth, QtSizeType cacheListIdx);
 
-    void printWindow(RLPainter& painter, const QRect& view, const QString& headerText, int line, const LineType linesPerPage, const QColor& fgColor);
-    void print(RLPainter& painter, const QRect& r, int firstLine, const LineType nofLinesPerPage);
-
     static bool startRunnables();
 
     [[nodiscard]] bool isThreeWay() const;
@@ -153,8 +150,8 @@ class DiffTextWindow : public QWidget
     void timerEvent(QTimerEvent*) override;
 
   private:
-    static QList<RecalcWordWrapRunnable*> s_runnables;
-    static constexpr int s_linesPerRunnable = 2000;
+    // Small enough that the pool threads stay busy until the end and a cancel is noticed quickly.
+    static constexpr int s_linesPerRunnable = 500;
 
     /*
       This list exists solely to auto disconnect boost signals.
@@ -166,7 +163,7 @@ class DiffTextWindow : public QWidget
 
     void showStatusLine(const LineRef lineFromPos);
 
-    bool canCopy() { return hasFocus() && !getSelection().isEmpty(); }
+    bool canCopy();
 };
 
 class DiffTextWindowFrameData;
@@ -14,18 +14,30 @@
 #include "CompositeIgnoreList.h"
 #include "defmac.h"
 #include "DirectoryInfo.h"
+#include "DirectoryScanner.h"
+#include "DirectoryWatcher.h"
+#include "FileComparisonQueue.h"
+#include "FileHashCache.h"
+#include "FileNameFilter.h"
 #include "guiutils.h"
 #include "kdiff3.h"
 #include "Logging.h"
 #include "MergeFileInfos.h"
+#include "MergeOperationQueue.h"
+#include "MergeStateFile.h"
 #include "options.h"
 #include "PixMapUtils.h"
 #include "progress.h"
+#include "TaskExecutor.h"
 #include "TypeUtils.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <QAction>
 #include <QApplication>
@@ -33,15 +45,21 @@
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLayout>
 #include <QMenu>
 #include <QPainter>
+#include <QSemaphore>
 #include <QSplitter>
 #include <QStyledItemDelegate>
 #include <QTextEdit>
 #include <QTextStream>
+#include <QTimer>
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -119,8 +137,6 @@ enum Columns
     s_WhiteCol = 9     // Number of white deltas (for 2 input files)
 };
 
-static Qt::CaseSensitivity s_eCaseSensitivity = Qt::CaseSensitive;
-
 class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemModel
 {
     friend class DirMergeItem;
@@ -132,9 +148,19 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
         mWindow = pDMW;
         m_pStatusInfo = new StatusInfo(mWindow);
         m_pStatusInfo->hide();
+
+        chk_connect_a(&m_dirWatcher, &DirectoryWatcher::changed, this, &DirectoryMergeWindowPrivate::slotWatchedPathsChanged);
+
+        m_backgroundTimer.setInterval(100);
+        chk_connect_a(&m_backgroundTimer, &QTimer::timeout, this, &DirectoryMergeWindowPrivate::slotBackgroundProgress);
+        if(g_pProgressDialog != nullptr)
+            chk_connect_a(g_pProgressDialog, &ProgressDialog::aborted, this, &DirectoryMergeWindowPrivate::slotBackgroundAborted);
     }
     ~DirectoryMergeWindowPrivate() override
     {
+        // Workers must be gone before the items they read.
+        m_pScanner.reset();
+        m_pComparison.reset();
         delete m_pRoot;
     }
 
@@ -190,7 +216,9 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
         if(MergeFileInfos* pMFI = getMFI(mi))
         {
             pMFI->setOpStatus(eOpStatus);
-            Q_EMIT dataChanged(mi, mi);
+            // A signal per item would make the view look up every item's row, bulk updates repaint once.
+            if(!m_bScanning && !m_bBulkUpdate)
+                Q_EMIT dataChanged(mi, mi);
         }
     }
 
@@ -219,19 +247,49 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
 
     [[nodiscard]] MergeFileInfos* rootMFI() const { return m_pRoot; }
 
-    void calcDirStatus(bool bThreeDirs, const QModelIndex& mi,
+    void calcDirStatus(bool bThreeDirs, const MergeFileInfos* pMFI,
                        int& nofFiles, int& nofDirs, int& nofEqualFiles, int& nofManualMerges);
 
     void mergeContinue(bool bStart, bool bVerbose);
 
+    bool finishListing(bool bListDirSuccessA, bool bListDirSuccessB, bool bListDirSuccessC);
+    void buildTree();
     void prepareListView(ProgressProxy& pp);
+    void compareFilesConcurrently(ProgressProxy& pp, QStringList& errors);
+    void finishComparison(const QStringList& errors);
+    void finishInit(bool bContinue);
+
+    bool startBackgroundScan();
+    void cancelBackgroundScan();
+    void slotBackgroundScanFinished();
+    void slotBackgroundProgress();
+    void slotBackgroundAborted();
+    void finishBackgroundComparison();
+    // Everything the suggested operations depend on besides the items.
+    struct SuggestionSettings
+    {
+        bool bCheckC = false;
+        bool bCopyNewer = false;
+        bool bOtherDest = false;
+    };
+    [[nodiscard]] SuggestionSettings suggestionSettings() const;
+    [[nodiscard]] static e_MergeOperation suggestedOperation(const MergeFileInfos& mfi, e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings);
+    [[nodiscard]] static e_MergeOperation cachedSuggestedOperation(MergeFileInfos& mfi, e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings);
+    static void applySuggestedOperation(MergeFileInfos* pMFI, e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings, bool bRecursive);
     void calcSuggestedOperation(const QModelIndex& mi, e_MergeOperation eDefaultMergeOp);
+    // For all items, like calcSuggestedOperation() for every top level item.
+    void calcSuggestedOperations(e_MergeOperation eDefaultMergeOp);
     void setAllMergeOperations(e_MergeOperation eDefaultOperation);
 
     bool canContinue();
     QModelIndex treeIterator(QModelIndex mi, bool bVisitChildren = true, bool bFindInvisible = false);
     void prepareMergeStart(const QModelIndex& miBegin, const QModelIndex& miEnd, bool bVerbose);
     bool executeMergeOperation(const MergeFileInfos& mfi, bool& bSingleFileMerge);
+    [[nodiscard]] bool canRunConcurrently(const MergeFileInfos& mfi) const;
+    [[nodiscard]] std::vector<MergeOperationQueue::Step> operationSteps(const MergeFileInfos& mfi) const;
+    void runOperationsConcurrently();
+    // Merges the files of all merge items with the headless engine, see slotAutoMergeFiles().
+    void autoMergeFiles();
 
     void scanDirectory(const QString& dirName, DirectoryList& dirList);
     void scanLocalDirectory(const QString& dirName, DirectoryList& dirList);
@@ -246,62 +304,33 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
     bool renameFLD(const QString& srcName, const QString& destName);
     bool mergeFLD(const QString& nameA, const QString& nameB, const QString& nameC,
                   const QString& nameDest, bool& bSingleFileMerge);
+    void prefetchNextMerges();
 
     void buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo);
 
-  private:
-    class FileKey
-    {
-      private:
-        const FileAccess* m_pFA;
-
-      public:
-        explicit FileKey(const FileAccess& fa):
-            m_pFA(&fa) {}
-
-        quint32 getParents(const FileAccess* pFA, const FileAccess* v[], quint32 maxSize) const
-        {
-            quint32 s = 0;
-            for(s = 0; pFA->parent() != nullptr; pFA = pFA->parent(), ++s)
-            {
-                if(s == maxSize)
-                    break;
-                v[s] = pFA;
-            }
-            return s;
-        }
-
-        // This is essentially the same as
-        // int r = filePath().compare( fa.filePath() )
-        // if ( r<0 ) return true;
-        // if ( r==0 ) return m_col < fa.m_col;
-        // return false;
-        bool operator<(const FileKey& fk) const
-        {
-            const FileAccess* v1[100];
-            const FileAccess* v2[100];
-            quint32 v1Size = getParents(m_pFA, v1, 100);
-            quint32 v2Size = getParents(fk.m_pFA, v2, 100);
-
-            for(quint32 i = 0; i < v1Size && i < v2Size; ++i)
-            {
-                int r = v1[v1Size - i - 1]->fileName().compare(v2[v2Size - i - 1]->fileName(), s_eCaseSensitivity);
-                if(r < 0)
-                    return true;
-                else if(r > 0)
-                    return false;
-            }
+    // e_VisibilityCategory flags of the checked "Show ..." actions.
+    [[nodiscard]] quint8 shownCategories() const;
+    void calcVisibilityMasks(MergeFileInfos* pParent, const FileNameFilter& nameFilter);
+    void applyShownCategories(const QModelIndex& parentIndex, MergeFileInfos* pParent, quint8 shown, quint8 changed, bool bAll);
+    // After toggling a "Show ..." action, only items depending on the toggled categories are visited.
+    void updateShownCategories();
 
-            return v1Size < v2Size;
-        }
-    };
+    [[nodiscard]] e_MergeOperation defaultMergeOperation() const;
 
-    typedef QMap<FileKey, MergeFileInfos> t_fileMergeMap;
+    void startWatching();
+    void slotWatchedPathsChanged(const QStringList& paths);
 
+  private:
     MergeFileInfos* m_pRoot = new MergeFileInfos();
 
     t_fileMergeMap m_fileMergeMap;
 
+    DirectoryWatcher m_dirWatcher;
+    // Items by relative path, only filled while the folders are watched.
+    QHash<QString, MergeFileInfos*> m_itemsBySubPath;
+    // Outcome of operations that already ran concurrently, taken by executeMergeOperation().
+    QHash<const MergeFileInfos*, MergeOperationQueue::Result> m_concurrentResults;
+
   public:
     DirectoryMergeWindow* mWindow;
     QSharedPointer<Options> m_pOptions = nullptr;
@@ -318,6 +347,10 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
     bool m_bUnfoldSubdirs = false;
     bool m_bSkipDirStatus = false;
     bool m_bScanning = false; // true while in init()
+    bool m_bBulkUpdate = false; // true while many items change at once
+    bool m_bVisibilityMasksValid = false; // false after the tree or the comparison changed
+    quint8 m_shownCategories = 0;
+    MergeStateFile m_mergeState; // Last saved or loaded, saving to the same file again appends what changed.
 
     DirectoryMergeInfo* m_pDirectoryMergeInfo = nullptr;
     StatusInfo* m_pStatusInfo = nullptr;
@@ -331,6 +364,7 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
     QModelIndex m_selection3Index;
 
     QPointer<QAction> m_pDirStartOperation;
+    QPointer<QAction> m_pDirAutoMerge;
     QPointer<QAction> m_pDirRunOperationForCurrentItem;
     QPointer<QAction> m_pDirCompareCurrent;
     QPointer<QAction> m_pDirMergeCurrent;
@@ -374,6 +408,23 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
 
     QPointer<QAction> m_pDirSaveMergeState;
     QPointer<QAction> m_pDirLoadMergeState;
+
+    bool m_bReload = false;
+    /*
+        Local folders are read and compared in the background, see startBackgroundScan().
+        A finished scan is queued back to this thread, the generation drops one that was replaced
+        meanwhile.
+    */
+    std::unique_ptr<DirectoryScanner> m_pScanner;
+    std::unique_ptr<FileComparisonQueue> m_pComparison;
+    std::unique_ptr<ProgressProxy> m_pBackgroundProgress;
+    QTimer m_backgroundTimer;
+    quint64 m_backgroundGeneration = 0;
+    bool m_bBackgroundCancelled = false;
+    QStringList m_backgroundErrors;
+    qint64 m_nofCompared = 0;
+    qint64 m_nofToCompare = 0;
+    Statistics::DirectoryCompare m_compareStatistics; // Of the last comparison, for the statistics view.
 };
 
 QVariant DirectoryMergeWindow::DirectoryMergeWindowPrivate::data(const QModelIndex& index, int role) const
@@ -486,6 +537,8 @@ QVariant DirectoryMergeWindow::DirectoryMergeWindowPrivate::data(const QModelInd
                         return i18nc("Status column message", "In progress...");
                     case eOpStatusToDo:
                         return i18nc("Status column message", "To do.");
+                    case eOpStatusConflicts:
+                        return i18nc("Status column message", "Conflicts left.");
                 }
             }
         }
@@ -679,6 +732,11 @@ bool DirectoryMergeWindow::isScanning()
     return d->m_bScanning;
 }
 
+void DirectoryMergeWindow::cancelScan()
+{
+    d->cancelBackgroundScan();
+}
+
 int DirectoryMergeWindow::totalColumnWidth()
 {
     int w = 0;
@@ -707,10 +765,9 @@ void DirectoryMergeWindow::reload()
     updateFileVisibilities();
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcDirStatus(bool bThreeDirs, const QModelIndex& mi,
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcDirStatus(bool bThreeDirs, const MergeFileInfos* pMFI,
                                                                       int& nofFiles, int& nofDirs, int& nofEqualFiles, int& nofManualMerges)
 {
-    const MergeFileInfos* pMFI = getMFI(mi);
     if(pMFI->hasDir())
     {
         ++nofDirs;
@@ -728,8 +785,9 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcDirStatus(bool bThre
                 ++nofManualMerges;
         }
     }
-    for(int childIdx = 0; childIdx < rowCount(mi); ++childIdx)
-        calcDirStatus(bThreeDirs, index(childIdx, 0, mi), nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
+    // The items are walked directly, creating model indexes for all of them costs more than counting.
+    for(const MergeFileInfos* pChild: pMFI->children())
+        calcDirStatus(bThreeDirs, pChild, nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
 }
 
 bool DirectoryMergeWindow::init(
@@ -741,51 +799,13 @@ bool DirectoryMergeWindow::init(
 
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::buildMergeMap(const QSharedPointer<DirectoryInfo>& dirInfo)
 {
-    if(dirInfo->dirA().isValid())
-    {
-        for(FileAccess& fileRecord: dirInfo->getDirListA())
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(fileRecord)];
-
-            mfi.setFileInfoA(&fileRecord);
-        }
-    }
-
-    if(dirInfo->dirB().isValid())
-    {
-        for(FileAccess& fileRecord: dirInfo->getDirListB())
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(fileRecord)];
-
-            mfi.setFileInfoB(&(fileRecord));
-        }
-    }
-
-    if(dirInfo->dirC().isValid())
-    {
-        for(FileAccess& fileRecord: dirInfo->getDirListC())
-        {
-            MergeFileInfos& mfi = m_fileMergeMap[FileKey(fileRecord)];
-
-            mfi.setFileInfoC(&(fileRecord));
-        }
-    }
+    ::buildMergeMap(*dirInfo, m_bCaseSensitive, m_fileMergeMap);
 }
 
 bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     bool bDirectoryMerge,
     bool bReload)
 {
-    if(m_pOptions->m_bDmFullAnalysis)
-    {
-        QStringList errors;
-        // A full analysis uses the same resources that a normal text-diff/merge uses.
-        // So make sure that the user saves his data first.
-        if(!m_app.canContinue())
-            return false;
-        Q_EMIT mWindow->startDiffMerge(errors, "", "", "", "", "", "", "", nullptr); // hide main window
-    }
-
     mWindow->show();
     mWindow->setUpdatesEnabled(true);
 
@@ -807,6 +827,11 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
         //}
     }
 
+    cancelBackgroundScan();
+    m_dirWatcher.stop();
+    m_itemsBySubPath.clear();
+    m_concurrentResults.clear();
+
     ProgressProxy pp;
     m_bFollowDirLinks = m_pOptions->m_bDmFollowDirLinks;
     m_bFollowFileLinks = m_pOptions->m_bDmFollowFileLinks;
@@ -814,6 +839,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     m_bRealMergeStarted = false;
     m_bError = false;
     m_bDirectoryMerge = bDirectoryMerge;
+    m_bReload = bReload;
     m_selection1Index = QModelIndex();
     m_selection2Index = QModelIndex();
     m_selection3Index = QModelIndex();
@@ -824,6 +850,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     beginResetModel();
     m_pRoot->clear();
     m_mergeItemList.clear();
+    m_bVisibilityMasksValid = false;
     endResetModel();
 
     m_currentIndexForOperation = m_mergeItemList.end();
@@ -883,7 +910,6 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     m_bSyncMode = m_pOptions->m_bDmSyncMode && gDirInfo->allowSyncMode();
 
     m_fileMergeMap.clear();
-    s_eCaseSensitivity = m_bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
     // calc how many directories will be read:
     double nofScans = (dirA.isValid() ? 1 : 0) + (dirB.isValid() ? 1 : 0) + (dirC.isValid() ? 1 : 0);
     int currentScan = 0;
@@ -902,63 +928,86 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     bool bListDirSuccessB = true;
     bool bListDirSuccessC = true;
 
-    if(dirA.isValid())
+    // Local folders are read and compared in the background, the window stays usable meanwhile.
+    if(!m_pOptions->m_bDmFullAnalysis && startBackgroundScan())
+        return true;
+
+    // Local folders are all read at once, otherwise one after another.
+    if(!gDirInfo->listDirsConcurrently(m_pOptions, bListDirSuccessA, bListDirSuccessB, bListDirSuccessC))
     {
-        pp.setInformation(i18nc("Status message", "Reading Folder A"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
+        if(dirA.isValid())
+        {
+            pp.setInformation(i18nc("Status message", "Reading Folder A"));
+            pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
+            ++currentScan;
 
-        bListDirSuccessA = gDirInfo->listDirA(m_pOptions);
-    }
+            bListDirSuccessA = gDirInfo->listDirA(m_pOptions);
+        }
 
-    if(dirB.isValid())
-    {
-        pp.setInformation(i18nc("Status message", "Reading Folder B"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
+        if(dirB.isValid())
+        {
+            pp.setInformation(i18nc("Status message", "Reading Folder B"));
+            pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
+            ++currentScan;
 
-        bListDirSuccessB = gDirInfo->listDirB(m_pOptions);
-    }
+            bListDirSuccessB = gDirInfo->listDirB(m_pOptions);
+        }
 
-    e_MergeOperation eDefaultMergeOp;
-    if(dirC.isValid())
-    {
-        pp.setInformation(i18nc("Status message", "Reading Folder C"));
-        pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
-        ++currentScan;
+        if(dirC.isValid())
+        {
+            pp.setInformation(i18nc("Status message", "Reading Folder C"));
+            pp.setSubRangeTransformation(currentScan / nofScans, (currentScan + 1) / nofScans);
+            ++currentScan;
 
-        bListDirSuccessC = gDirInfo->listDirC(m_pOptions);
+            bListDirSuccessC = gDirInfo->listDirC(m_pOptions);
+        }
+    }
 
-        eDefaultMergeOp = eMergeABCToDest;
+    if(finishListing(bListDirSuccessA, bListDirSuccessB, bListDirSuccessC))
+    {
+        prepareListView(pp);
+        finishInit(true);
     }
     else
-        eDefaultMergeOp = m_bSyncMode ? eMergeToAB : eMergeABToDest;
+    {
+        finishInit(false);
+    }
+
+    return true;
+}
 
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishListing(bool bListDirSuccessA, bool bListDirSuccessB, bool bListDirSuccessC)
+{
     buildMergeMap(gDirInfo);
 
     bool bContinue = true;
     if(!bListDirSuccessA || !bListDirSuccessB || !bListDirSuccessC)
     {
         QString s = i18nc("Warning text", "Some subfolders were not readable in");
-        if(!bListDirSuccessA) s += "\nA: " + dirA.prettyAbsPath();
-        if(!bListDirSuccessB) s += "\nB: " + dirB.prettyAbsPath();
-        if(!bListDirSuccessC) s += "\nC: " + dirC.prettyAbsPath();
+        if(!bListDirSuccessA) s += "\nA: " + gDirInfo->dirA().prettyAbsPath();
+        if(!bListDirSuccessB) s += "\nB: " + gDirInfo->dirB().prettyAbsPath();
+        if(!bListDirSuccessC) s += "\nC: " + gDirInfo->dirC().prettyAbsPath();
         s += '\n';
         s += i18nc("Warning text", "Check the permissions of the subfolders.");
         bContinue = KMessageBox::Continue == KMessageBox::warningContinueCancel(mWindow, s);
     }
+    return bContinue;
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishInit(bool bContinue)
+{
+    const FileAccess& dirC = gDirInfo->dirC();
 
     if(bContinue)
     {
-        prepareListView(pp);
-
         mWindow->updateFileVisibilities();
 
-        for(int childIdx = 0; childIdx < rowCount(); ++childIdx)
-        {
-            QModelIndex mi = index(childIdx, 0, QModelIndex());
-            calcSuggestedOperation(mi, eDefaultMergeOp);
-        }
+        calcSuggestedOperations(defaultMergeOperation());
+        // setOpStatus() stays quiet while scanning.
+        if(rowCount() > 0)
+            Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, columnCount(QModelIndex()) - 1, QModelIndex()));
+
+        startWatching();
     }
 
     mWindow->sortByColumn(0, Qt::AscendingOrder);
@@ -977,9 +1026,8 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
         int nofEqualFiles = 0;
         int nofManualMerges = 0;
         //TODO
-        for(int childIdx = 0; childIdx < rowCount(); ++childIdx)
-            calcDirStatus(dirC.isValid(), index(childIdx, 0, QModelIndex()),
-                          nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
+        for(const MergeFileInfos* pMFI: m_pRoot->children())
+            calcDirStatus(dirC.isValid(), pMFI, nofFiles, nofDirs, nofEqualFiles, nofManualMerges);
 
         QString s;
         s = i18n("Folder Comparison Status\n\n"
@@ -1000,7 +1048,7 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
         //}
     }
 
-    if(bReload)
+    if(m_bReload)
     {
         // Remember expanded items
         //TODO
@@ -1024,8 +1072,11 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::init(
     {
         m_pDirUnfoldAll->trigger();
     }
+}
 
-    return true;
+const Statistics::DirectoryCompare& DirectoryMergeWindow::compareStatistics() const
+{
+    return d->m_compareStatistics;
 }
 
 QString DirectoryMergeWindow::getDirNameA() const
@@ -1262,10 +1313,10 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::setAllMergeOperations(e_
                                                           KStandardGuiItem::cont(),
                                                           KStandardGuiItem::cancel()))
     {
-        for(int i = 0; i < rowCount(); ++i)
-        {
-            calcSuggestedOperation(index(i, 0, QModelIndex()), eDefaultOperation);
-        }
+        calcSuggestedOperations(eDefaultOperation);
+
+        if(rowCount() > 0)
+            Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, columnCount(QModelIndex()) - 1, QModelIndex()));
     }
 }
 
@@ -1315,68 +1366,176 @@ QModelIndex DirectoryMergeWindow::DirectoryMergeWindowPrivate::treeIterator(QMod
     return mi;
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(ProgressProxy& pp)
+e_MergeOperation DirectoryMergeWindow::DirectoryMergeWindowPrivate::defaultMergeOperation() const
 {
-    QStringList errors;
-    //TODO   clear();
-    PixMapUtils::initPixmaps(m_pOptions->newestFileColor(), m_pOptions->oldestFileColor(),
-                             m_pOptions->midAgeFileColor(), m_pOptions->missingFileColor());
+    if(gDirInfo->dirC().isValid())
+        return eMergeABCToDest;
 
-    mWindow->setRootIsDecorated(true);
+    return m_bSyncMode ? eMergeToAB : eMergeABToDest;
+}
 
-    int nrOfFiles = m_fileMergeMap.size();
-    int currentIdx = 1;
-    QElapsedTimer t;
-    t.start();
-    pp.setMaxNofSteps(nrOfFiles);
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::startWatching()
+{
+    // The full analysis opens every file in the diff view, that is nothing to repeat in the background.
+    if(!m_pOptions->m_bDmWatchFolders || m_pOptions->m_bDmFullAnalysis)
+        return;
 
-    for(MergeFileInfos& mfi: m_fileMergeMap)
+    QStringList dirs;
+    for(const FileAccess* pDir: {&gDirInfo->dirA(), &gDirInfo->dirB(), &gDirInfo->dirC()})
     {
-        const QString& fileName = mfi.subPath();
+        if(!pDir->isValid())
+            continue;
+        if(!pDir->isLocal())
+            return;
+        dirs.append(pDir->absoluteFilePath());
+    }
 
-        pp.setInformation(
-            i18n("Processing %1 / %2\n%3", currentIdx, nrOfFiles, fileName), currentIdx, false);
-        if(pp.wasCancelled()) break;
-        ++currentIdx;
+    m_itemsBySubPath.reserve(m_fileMergeMap.size());
+    for(auto& entry: m_fileMergeMap)
+        m_itemsBySubPath.insert(entry.second.subPath(), &entry.second);
 
-        // The comparisons and calculations for each file take place here.
-        if(!mfi.compareFilesAndCalcAges(errors, m_pOptions, mWindow) && errors.size() >= 30)
-            break;
+    m_dirWatcher.watch(dirs);
+}
 
-        // Get dirname from fileName: Search for "/" from end:
-        int pos = fileName.lastIndexOf('/');
-        QString dirPart;
-        QString filePart;
-        if(pos == -1)
-        {
-            // Top dir
-            filePart = fileName;
-        }
-        else
+/*
+    Compares the changed files again and updates only their items.
+
+    Files that were added or removed would change the structure of the tree. That needs a new
+    scan, so the user is only told about them.
+*/
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::slotWatchedPathsChanged(const QStringList& paths)
+{
+    // Never change items underneath a running merge.
+    if(m_bScanning || m_bRealMergeStarted || m_bSimulatedMergeStarted)
+        return;
+
+    const FileAccess* dirs[] = {&gDirInfo->dirA(), &gDirInfo->dirB(), &gDirInfo->dirC()};
+    std::vector<MergeFileInfos*> changedItems;
+    bool bStructureChanged = false;
+    const FileNameFilter nameFilter(m_pOptions->m_DmFilePattern, m_pOptions->m_DmFileAntiPattern, m_pOptions->m_DmDirAntiPattern);
+
+    for(const QString& path: paths)
+    {
+        for(quint32 side = 0; side < 3; ++side)
         {
-            dirPart = fileName.left(pos);
-            filePart = fileName.mid(pos + 1);
+            const FileAccess& dir = *dirs[side];
+            if(!dir.isValid())
+                continue;
+
+            const QString dirPath = dir.absoluteFilePath() + '/';
+            if(!path.startsWith(dirPath))
+                continue;
+
+            const QFileInfo fi(path);
+            MergeFileInfos* pMFI = m_itemsBySubPath.value(path.mid(dirPath.length()));
+            FileAccess* pFA = nullptr;
+            if(pMFI != nullptr)
+                pFA = side == 0 ? pMFI->getFileInfoA() : side == 1 ? pMFI->getFileInfoB() : pMFI->getFileInfoC();
+
+            if(pFA == nullptr)
+            {
+                // Something new appeared. Files hidden by the patterns don't matter.
+                const QString fileName = fi.fileName();
+                if(fi.isDir())
+                    bStructureChanged = bStructureChanged || nameFilter.isDirShown(fileName, m_bCaseSensitive);
+                else if(fi.exists())
+                    bStructureChanged = bStructureChanged || nameFilter.isFileShown(fileName, m_bCaseSensitive);
+                break;
+            }
+
+            if(!fi.exists() || fi.isDir() != pFA->isDir() || fi.isSymLink() != pFA->isSymLink())
+            {
+                bStructureChanged = true;
+                break;
+            }
+
+            // A changed folder is reported together with the changed files inside it.
+            if(!pFA->isDir())
+            {
+                pFA->setFile(pFA->parent(), fi);
+                if(std::find(changedItems.cbegin(), changedItems.cend(), pMFI) == changedItems.cend())
+                    changedItems.push_back(pMFI);
+            }
+            break;
         }
+    }
 
-        if(dirPart.isEmpty()) // Top level
+    if(!changedItems.empty())
+    {
+        QStringList errors;
+        for(MergeFileInfos* pMFI: changedItems)
         {
-            m_pRoot->addChild(&mfi); // new DirMergeItem( this, filePart, &mfi );
-            mfi.setParent(m_pRoot);
+            pMFI->resetComparison();
+            pMFI->compareFilesAndCalcAges(errors, m_pOptions);
+            pMFI->updateAge();
         }
-        else
+
+        // Recalculates the equality of the parent folders.
+        mWindow->updateFileVisibilities();
+
+        const e_MergeOperation eDefaultMergeOp = defaultMergeOperation();
+        for(MergeFileInfos* pMFI: changedItems)
         {
-            const FileAccess* pFA = mfi.getFileInfoA() ? mfi.getFileInfoA() : mfi.getFileInfoB() ? mfi.getFileInfoB() :
-                                                                                                   mfi.getFileInfoC();
-            MergeFileInfos& dirMfi = pFA->parent() ? m_fileMergeMap[FileKey(*pFA->parent())] : *m_pRoot; // parent
+            const QModelIndex mi = createIndex(pMFI->parent()->children().indexOf(pMFI), 0, pMFI);
+            calcSuggestedOperation(mi, eDefaultMergeOp);
 
-            dirMfi.addChild(&mfi); // new DirMergeItem( dirMfi.m_pDMI, filePart, &mfi );
-            mfi.setParent(&dirMfi);
-            //   // Equality for parent dirs is set in updateFileVisibilities()
+            for(QModelIndex changed = mi; changed.isValid(); changed = changed.parent())
+                Q_EMIT dataChanged(changed.sibling(changed.row(), 0), changed.sibling(changed.row(), columnCount(changed.parent()) - 1));
         }
 
-        mfi.updateAge();
+        if(!errors.isEmpty())
+            Q_EMIT mWindow->statusBarMessage(errors.first());
+    }
+
+    if(bStructureChanged)
+        Q_EMIT mWindow->statusBarMessage(i18n("Files were added or removed. Rescan to show them."));
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::buildTree()
+{
+    //TODO   clear();
+    PixMapUtils::initPixmaps(m_pOptions->newestFileColor(), m_pOptions->oldestFileColor(),
+                             m_pOptions->midAgeFileColor(), m_pOptions->missingFileColor());
+
+    mWindow->setRootIsDecorated(true);
+
+    // Build the tree first, so it is shown while the files are compared.
+    for(auto& entry: m_fileMergeMap)
+    {
+        const QString& key = entry.first;
+        MergeFileInfos& mfi = entry.second;
+
+        // The folder's key is everything before the last "/".
+        const QtSizeType pos = key.lastIndexOf('/');
+        const auto parentIt = pos == -1 ? m_fileMergeMap.end() : m_fileMergeMap.find(key.left(pos));
+        MergeFileInfos& dirMfi = parentIt != m_fileMergeMap.end() ? parentIt->second : *m_pRoot;
+
+        dirMfi.addChild(&mfi);
+        mfi.setParent(&dirMfi);
+        // Equality for parent dirs is set in updateFileVisibilities()
     }
+    // The hash has no order, the view shouldn't show the tree like that even briefly.
+    m_pRoot->sort(Qt::AscendingOrder);
+
+    beginResetModel();
+    endResetModel();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(ProgressProxy& pp)
+{
+    QStringList errors;
+
+    buildTree();
 
+    compareFilesConcurrently(pp, errors);
+    if(!m_pOptions->m_bDmFullAnalysis && m_pOptions->m_bDmUseHashCache)
+        FileHashCache::instance().save();
+
+    finishComparison(errors);
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishComparison(const QStringList& errors)
+{
     if(errors.size() > 0)
     {
         if(errors.size() < 15)
@@ -1395,17 +1554,259 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView(Progress
     endResetModel();
 }
 
-void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(const QModelIndex& mi, e_MergeOperation eDefaultMergeOp)
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::compareFilesConcurrently(ProgressProxy& pp, QStringList& errors)
 {
-    const MergeFileInfos* pMFI = getMFI(mi);
-    if(pMFI == nullptr)
+    const QSharedPointer<const Options> pOptions = m_pOptions;
+    std::vector<MergeFileInfos*> localItems;
+    std::vector<MergeFileInfos*> remoteItems;
+    for(auto& entry: m_fileMergeMap)
+    {
+        MergeFileInfos& mfi = entry.second;
+        if(mfi.isLocal())
+            localItems.push_back(&mfi);
+        else
+            remoteItems.push_back(&mfi);
+    }
+
+    // The full analysis runs its fine diffs on the workers, they only read the algorithm.
+    if(pOptions->m_bDmFullAnalysis)
+        Diff3Line::m_pDiffBufferInfo->setFineDiffAlgorithm((FineDiffAlgorithm)pOptions->m_fineDiffAlgorithm);
+
+    m_compareStatistics.start();
+    FileComparisonQueue queue(pOptions);
+    queue.start(std::move(localItems));
+
+    const qint64 nrOfFiles = m_fileMergeMap.size();
+    qint64 nrOfDone = 0;
+    QString lastName;
+    pp.setMaxNofSteps(nrOfFiles);
+
+    // Items are only changed here, workers only read them.
+    const auto publish = [&](const FileComparisonQueue::Result& result) {
+        if(pOptions->m_bDmFullAnalysis)
+            result.pMFI->diffStatus() = result.diffStatus;
+        if(!result.pMFI->setComparisonResult(result.equality, result.bError, result.status, errors) && errors.size() >= 30)
+            queue.cancel();
+        result.pMFI->updateAge();
+        m_bVisibilityMasksValid = false;
+        lastName = result.pMFI->subPath();
+        ++nrOfDone;
+    };
+
+    size_t remoteIdx = 0;
+    bool bFinished = false;
+    while(!bFinished)
+    {
+        // KIO only works in this thread, so remote files are compared here one by one meanwhile.
+        if(remoteIdx < remoteItems.size() && !queue.isCancelled())
+        {
+            publish(FileComparisonQueue::compare(remoteItems[remoteIdx++], pOptions));
+        }
+        else
+        {
+            bFinished = queue.waitForDone(100);
+        }
+
+        const std::vector<FileComparisonQueue::Result> finished = queue.takeResults();
+        for(const FileComparisonQueue::Result& result: finished)
+            publish(result);
+
+        // Without anything to compare left the view only has to be repainted once at the end.
+        if(!finished.empty() && !bFinished && rowCount() > 0)
+            Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, columnCount(QModelIndex()) - 1, QModelIndex()));
+
+        pp.setInformation(i18n("Processing %1 / %2\n%3", nrOfDone, nrOfFiles, lastName), nrOfDone, false);
+        if(pp.wasCancelled())
+            queue.cancel();
+    }
+    m_compareStatistics.finish();
+}
+
+/*
+    Reads and compares local folders without blocking the gui thread.
+
+    The scanner reports back through a queued call once all folders are read. The comparison is
+    polled by m_backgroundTimer, which also shows the progress in the status bar. Only the gui
+    thread touches the merge items, the workers just read them. Returns false if the folders have
+    to be read the old way, i.e. when one of them is remote.
+*/
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::startBackgroundScan()
+{
+    m_pScanner = gDirInfo->createScanner(m_pOptions);
+    if(m_pScanner == nullptr)
+        return false;
+
+    m_bBackgroundCancelled = false;
+    m_backgroundErrors.clear();
+    m_nofCompared = m_nofToCompare = 0;
+
+    g_pProgressDialog->setStayHidden(true);
+    m_pBackgroundProgress = std::make_unique<ProgressProxy>();
+    m_pBackgroundProgress->setInformation(i18nc("Status message", "Reading folders"), false);
+
+    const quint64 generation = ++m_backgroundGeneration;
+    m_pScanner->start(this, [this, generation]() {
+        // A scan replaced by a newer one may still have been queued.
+        if(generation == m_backgroundGeneration)
+            slotBackgroundScanFinished();
+    });
+    m_backgroundTimer.start();
+    Q_EMIT mWindow->updateAvailabilities();
+    return true;
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::cancelBackgroundScan()
+{
+    if(m_pBackgroundProgress == nullptr)
+        return;
+
+    ++m_backgroundGeneration;
+    m_backgroundTimer.stop();
+    // Waits for the workers, they may still be reading the folder lists or the items.
+    m_pScanner.reset();
+    m_pComparison.reset();
+    m_pBackgroundProgress.reset();
+    g_pProgressDialog->setStayHidden(false);
+    m_bScanning = false;
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::slotBackgroundAborted()
+{
+    m_bBackgroundCancelled = true;
+    if(m_pScanner != nullptr)
+        m_pScanner->cancel();
+    if(m_pComparison != nullptr)
+        m_pComparison->cancel();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::slotBackgroundScanFinished()
+{
+    m_backgroundTimer.stop();
+
+    bool bListDirSuccessA = true;
+    bool bListDirSuccessB = true;
+    bool bListDirSuccessC = true;
+    m_pScanner->collectResults();
+    gDirInfo->getScanResults(*m_pScanner, bListDirSuccessA, bListDirSuccessB, bListDirSuccessC);
+    m_pScanner.reset();
+
+    const quint64 generation = m_backgroundGeneration;
+    const bool bContinue = finishListing(bListDirSuccessA, bListDirSuccessB, bListDirSuccessC);
+    // The warning runs an event loop, a new scan may have been started from there.
+    if(generation != m_backgroundGeneration)
+        return;
+
+    if(!bContinue)
+    {
+        m_pBackgroundProgress.reset();
+        g_pProgressDialog->setStayHidden(false);
+        finishInit(false);
+        Q_EMIT mWindow->updateAvailabilities();
+        return;
+    }
+
+    buildTree();
+
+    std::vector<MergeFileInfos*> items;
+    items.reserve(m_fileMergeMap.size());
+    for(auto& entry: m_fileMergeMap)
+        items.push_back(&entry.second);
+
+    m_nofToCompare = items.size();
+    m_pComparison = std::make_unique<FileComparisonQueue>(m_pOptions);
+    // A cancelled scan still lists the folders read so far, those are shown uncompared.
+    if(m_bBackgroundCancelled)
+        m_pComparison->cancel();
+    m_compareStatistics.start();
+    m_pComparison->start(std::move(items));
+
+    m_pBackgroundProgress->setMaxNofSteps(m_nofToCompare);
+    m_backgroundTimer.start();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::slotBackgroundProgress()
+{
+    // Showing the progress processes events, this must not be called again meanwhile.
+    m_backgroundTimer.stop();
+
+    if(m_pScanner != nullptr)
+    {
+        m_pBackgroundProgress->setInformation(i18nc("Status message", "Reading folders: %1 read", m_pScanner->dirsRead()), false);
+        if(m_pScanner != nullptr || m_pComparison != nullptr)
+            m_backgroundTimer.start();
+        return;
+    }
+
+    if(m_pComparison == nullptr)
+        return;
+
+    // Checked first, so no result arriving after the last takeResults() is lost.
+    const bool bDone = m_pComparison->waitForDone(0);
+    const std::vector<FileComparisonQueue::Result> results = m_pComparison->takeResults();
+    QString lastName;
+    for(const FileComparisonQueue::Result& result: results)
+    {
+        if(!result.pMFI->setComparisonResult(result.equality, result.bError, result.status, m_backgroundErrors) && m_backgroundErrors.size() >= 30)
+            m_pComparison->cancel();
+        result.pMFI->updateAge();
+        m_bVisibilityMasksValid = false;
+        lastName = result.pMFI->subPath();
+        ++m_nofCompared;
+    }
+
+    if(!bDone)
+    {
+        if(!results.empty())
+        {
+            m_pBackgroundProgress->setInformation(i18n("Processing %1 / %2\n%3", m_nofCompared, m_nofToCompare, lastName), m_nofCompared, false);
+            if(rowCount() > 0)
+                Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, columnCount(QModelIndex()) - 1, QModelIndex()));
+        }
+        if(m_pComparison != nullptr)
+            m_backgroundTimer.start();
         return;
+    }
+
+    finishBackgroundComparison();
+}
 
-    bool bCheckC = pMFI->isThreeWay();
-    bool bCopyNewer = m_pOptions->m_bDmCopyNewer;
-    bool bOtherDest = !((gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirA().absoluteFilePath()) ||
-                        (gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirB().absoluteFilePath()) ||
-                        (bCheckC && gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirC().absoluteFilePath()));
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::finishBackgroundComparison()
+{
+    // The message boxes below run an event loop, the timer must not fire into them.
+    m_backgroundTimer.stop();
+    m_compareStatistics.finish();
+    m_pComparison.reset();
+    m_pBackgroundProgress.reset();
+    g_pProgressDialog->setStayHidden(false);
+
+    if(m_pOptions->m_bDmUseHashCache)
+        FileHashCache::instance().save();
+
+    const QStringList errors = std::move(m_backgroundErrors);
+    m_backgroundErrors.clear();
+    finishComparison(errors);
+    finishInit(true);
+    Q_EMIT mWindow->updateAvailabilities();
+}
+
+DirectoryMergeWindow::DirectoryMergeWindowPrivate::SuggestionSettings DirectoryMergeWindow::DirectoryMergeWindowPrivate::suggestionSettings() const
+{
+    SuggestionSettings settings;
+    settings.bCheckC = isDirThreeWay();
+    settings.bCopyNewer = m_pOptions->m_bDmCopyNewer;
+    settings.bOtherDest = !((gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirA().absoluteFilePath()) ||
+                            (gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirB().absoluteFilePath()) ||
+                            (settings.bCheckC && gDirInfo->destDir().absoluteFilePath() == gDirInfo->dirC().absoluteFilePath()));
+    return settings;
+}
+
+e_MergeOperation DirectoryMergeWindow::DirectoryMergeWindowPrivate::suggestedOperation(const MergeFileInfos& mfi, e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings)
+{
+    const MergeFileInfos* pMFI = &mfi;
+    const bool bCheckC = settings.bCheckC;
+    const bool bCopyNewer = settings.bCopyNewer;
+    const bool bOtherDest = settings.bOtherDest;
+    e_MergeOperation eMergeOp = eNoOperation;
 
     //Crash and burn in debug mode these states are never valid.
     //The checks are duplicated here so they show in the assert text.
@@ -1415,12 +1816,12 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(c
     //Check for two bugged states that are recoverable. This should never happen!
     if(Q_UNLIKELY(eDefaultMergeOp == eMergeABCToDest && !bCheckC))
     {
-        qCWarning(kdiffMain) << "Invalid State detected in DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation";
+        qCWarning(kdiffMain) << "Invalid State detected in DirectoryMergeWindow::DirectoryMergeWindowPrivate::suggestedOperation";
         eDefaultMergeOp = eMergeABToDest;
     }
     if(Q_UNLIKELY(eDefaultMergeOp == eMergeToAB && bCheckC))
     {
-        qCWarning(kdiffMain) << "Invalid State detected in DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation";
+        qCWarning(kdiffMain) << "Invalid State detected in DirectoryMergeWindow::DirectoryMergeWindowPrivate::suggestedOperation";
         eDefaultMergeOp = eMergeABCToDest;
     }
 
@@ -1431,106 +1832,106 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(c
         {
             if(pMFI->isEqualAB())
             {
-                setMergeOperation(mi, bOtherDest ? eCopyBToDest : eNoOperation);
+                eMergeOp = bOtherDest ? eCopyBToDest : eNoOperation;
             }
             else if(pMFI->existsInA() && pMFI->existsInB())
             {
                 //TODO: verify conditions here
                 if(!bCopyNewer || pMFI->isDirA())
-                    setMergeOperation(mi, eDefaultMergeOp);
+                    eMergeOp = eDefaultMergeOp;
                 else if(bCopyNewer && pMFI->conflictingAges())
                 {
-                    setMergeOperation(mi, eConflictingAges);
+                    eMergeOp = eConflictingAges;
                 }
                 else
                 {
                     if(pMFI->getAgeA() == eNew)
-                        setMergeOperation(mi, eDefaultMergeOp == eMergeToAB ? eCopyAToB : eCopyAToDest);
+                        eMergeOp = eDefaultMergeOp == eMergeToAB ? eCopyAToB : eCopyAToDest;
                     else
-                        setMergeOperation(mi, eDefaultMergeOp == eMergeToAB ? eCopyBToA : eCopyBToDest);
+                        eMergeOp = eDefaultMergeOp == eMergeToAB ? eCopyBToA : eCopyBToDest;
                 }
             }
             else if(!pMFI->existsInA() && pMFI->existsInB())
             {
                 if(eDefaultMergeOp == eMergeABToDest)
-                    setMergeOperation(mi, eCopyBToDest);
+                    eMergeOp = eCopyBToDest;
                 else if(eDefaultMergeOp == eMergeToB)
-                    setMergeOperation(mi, eNoOperation);
+                    eMergeOp = eNoOperation;
                 else
-                    setMergeOperation(mi, eCopyBToA);
+                    eMergeOp = eCopyBToA;
             }
             else if(pMFI->existsInA() && !pMFI->existsInB())
             {
                 if(eDefaultMergeOp == eMergeABToDest)
-                    setMergeOperation(mi, eCopyAToDest);
+                    eMergeOp = eCopyAToDest;
                 else if(eDefaultMergeOp == eMergeToA)
-                    setMergeOperation(mi, eNoOperation);
+                    eMergeOp = eNoOperation;
                 else
-                    setMergeOperation(mi, eCopyAToB);
+                    eMergeOp = eCopyAToB;
             }
             else //if ( !pMFI->existsInA() && !pMFI->existsInB() )
             {
-                setMergeOperation(mi, eNoOperation);
+                eMergeOp = eNoOperation;
             }
         }
         else
         {
             if(pMFI->isEqualAB() && pMFI->isEqualAC())
             {
-                setMergeOperation(mi, bOtherDest ? eCopyCToDest : eNoOperation);
+                eMergeOp = bOtherDest ? eCopyCToDest : eNoOperation;
             }
             else if(pMFI->existsInA() && pMFI->existsInB() && pMFI->existsInC())
             {
                 if(pMFI->isEqualAB() || pMFI->isEqualBC())
-                    setMergeOperation(mi, eCopyCToDest);
+                    eMergeOp = eCopyCToDest;
                 else if(pMFI->isEqualAC())
-                    setMergeOperation(mi, eCopyBToDest);
+                    eMergeOp = eCopyBToDest;
                 else
-                    setMergeOperation(mi, eMergeABCToDest);
+                    eMergeOp = eMergeABCToDest;
             }
             else if(pMFI->existsInA() && pMFI->existsInB() && !pMFI->existsInC())
             {
                 if(pMFI->isEqualAB())
-                    setMergeOperation(mi, eDeleteFromDest);
+                    eMergeOp = eDeleteFromDest;
                 else
-                    setMergeOperation(mi, eChangedAndDeleted);
+                    eMergeOp = eChangedAndDeleted;
             }
             else if(pMFI->existsInA() && !pMFI->existsInB() && pMFI->existsInC())
             {
                 if(pMFI->isEqualAC())
-                    setMergeOperation(mi, eDeleteFromDest);
+                    eMergeOp = eDeleteFromDest;
                 else
-                    setMergeOperation(mi, eChangedAndDeleted);
+                    eMergeOp = eChangedAndDeleted;
             }
             else if(!pMFI->existsInA() && pMFI->existsInB() && pMFI->existsInC())
             {
                 if(pMFI->isEqualBC())
-                    setMergeOperation(mi, eCopyCToDest);
+                    eMergeOp = eCopyCToDest;
                 else
-                    setMergeOperation(mi, eMergeABCToDest);
+                    eMergeOp = eMergeABCToDest;
             }
             else if(!pMFI->existsInA() && !pMFI->existsInB() && pMFI->existsInC())
             {
-                setMergeOperation(mi, eCopyCToDest);
+                eMergeOp = eCopyCToDest;
             }
             else if(!pMFI->existsInA() && pMFI->existsInB() && !pMFI->existsInC())
             {
-                setMergeOperation(mi, eCopyBToDest);
+                eMergeOp = eCopyBToDest;
             }
             else if(pMFI->existsInA() && !pMFI->existsInB() && !pMFI->existsInC())
             {
-                setMergeOperation(mi, eDeleteFromDest);
+                eMergeOp = eDeleteFromDest;
             }
             else //if ( !pMFI->existsInA() && !pMFI->existsInB() && !pMFI->existsInC() )
             {
-                setMergeOperation(mi, eNoOperation);
+                eMergeOp = eNoOperation;
             }
         }
 
         // Now check if file/dir-types fit.
         if(pMFI->conflictingFileTypes())
         {
-            setMergeOperation(mi, eConflictingFileTypes);
+            eMergeOp = eConflictingFileTypes;
         }
     }
     else
@@ -1588,8 +1989,124 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(c
                 assert(false);
                 break;
         }
-        setMergeOperation(mi, eMO);
+        eMergeOp = eMO;
+    }
+    return eMergeOp;
+}
+
+
+/*
+    Items are only looked at again if anything this depends on changed, the key covers it all. Each
+    item is written by a single thread.
+*/
+e_MergeOperation DirectoryMergeWindow::DirectoryMergeWindowPrivate::cachedSuggestedOperation(MergeFileInfos& mfi, const e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings)
+{
+    quint32 key = 1;
+    for(const bool bFlag: {settings.bCheckC, settings.bCopyNewer, settings.bOtherDest, mfi.existsInA(), mfi.existsInB(), mfi.existsInC(),
+                           mfi.isEqualAB(), mfi.isEqualAC(), mfi.isEqualBC(), mfi.isDirA(), mfi.getAgeA() == eNew, mfi.conflictingAges(),
+                           mfi.conflictingFileTypes()})
+        key = (key << 1) | (bFlag ? 1 : 0);
+    key = (key << 5) | (quint32)eDefaultMergeOp;
+
+    if(mfi.suggestionKey() != key)
+        mfi.setSuggestion(key, suggestedOperation(mfi, eDefaultMergeOp, settings));
+    return mfi.suggestedOperation();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperation(const QModelIndex& mi, e_MergeOperation eDefaultMergeOp)
+{
+    MergeFileInfos* pMFI = getMFI(mi);
+    if(pMFI == nullptr)
+        return;
+
+    setMergeOperation(mi, cachedSuggestedOperation(*pMFI, eDefaultMergeOp, suggestionSettings()));
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::applySuggestedOperation(MergeFileInfos* pMFI, const e_MergeOperation eDefaultMergeOp, const SuggestionSettings& settings, const bool bRecursive)
+{
+    const e_MergeOperation eMergeOp = cachedSuggestedOperation(*pMFI, eDefaultMergeOp, settings);
+    // Like setMergeOperation() for bulk updates, only items whose operation changes are touched.
+    if(eMergeOp != pMFI->getOperation())
+    {
+        pMFI->startOperation();
+        pMFI->setOpStatus(eOpStatusNone);
+        pMFI->setOperation(eMergeOp);
+    }
+
+    if(bRecursive)
+    {
+        const e_MergeOperation eChildrenMergeOp = eMergeOp == eConflictingFileTypes ? eMergeABCToDest : eMergeOp;
+        for(MergeFileInfos* pChild: pMFI->children())
+            applySuggestedOperation(pChild, eChildrenMergeOp, settings, true);
+    }
+}
+
+/*
+    What's suggested for an item only depends on its folder's operation, so subtrees are independent
+    and run on the global thread pool. Big folders are split up first until there are enough
+    subtrees for all threads. No signals are sent meanwhile, callers update the view afterwards.
+*/
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcSuggestedOperations(const e_MergeOperation eDefaultMergeOp)
+{
+    struct Subtree
+    {
+        MergeFileInfos* pMFI;
+        e_MergeOperation eDefaultMergeOp;
+    };
+    struct Batch
+    {
+        std::vector<Subtree> subtrees;
+        SuggestionSettings settings;
+        std::atomic<size_t> next{0};
+        QSemaphore finished;
+    };
+
+    const std::shared_ptr<Batch> pBatch = std::make_shared<Batch>();
+    pBatch->settings = suggestionSettings();
+    for(MergeFileInfos* pMFI: m_pRoot->children())
+        pBatch->subtrees.push_back({pMFI, eDefaultMergeOp});
+
+    const size_t maxThreads = (size_t)std::max(TaskExecutor::instance().maxThreadCount(), 1);
+    bool bSplit = true;
+    while(bSplit && pBatch->subtrees.size() < 4 * maxThreads)
+    {
+        bSplit = false;
+        std::vector<Subtree> subtrees;
+        for(const Subtree& subtree: pBatch->subtrees)
+        {
+            if(subtree.pMFI->children().isEmpty())
+            {
+                subtrees.push_back(subtree);
+                continue;
+            }
+
+            applySuggestedOperation(subtree.pMFI, subtree.eDefaultMergeOp, pBatch->settings, false);
+            const e_MergeOperation eMergeOp = subtree.pMFI->getOperation();
+            const e_MergeOperation eChildrenMergeOp = eMergeOp == eConflictingFileTypes ? eMergeABCToDest : eMergeOp;
+            for(MergeFileInfos* pChild: subtree.pMFI->children())
+                subtrees.push_back({pChild, eChildrenMergeOp});
+            bSplit = true;
+        }
+        pBatch->subtrees = std::move(subtrees);
     }
+
+    const auto run = [](Batch& batch) {
+        for(;;)
+        {
+            const size_t idx = batch.next.fetch_add(1);
+            if(idx >= batch.subtrees.size())
+                return;
+
+            applySuggestedOperation(batch.subtrees[idx].pMFI, batch.subtrees[idx].eDefaultMergeOp, batch.settings, true);
+            batch.finished.release();
+        }
+    };
+
+    const size_t nofThreads = std::min(maxThreads, pBatch->subtrees.size());
+    for(size_t i = 1; i < nofThreads; ++i)
+        TaskExecutor::instance().start([pBatch, run]() { run(*pBatch); }, TaskExecutor::Priority::visible);
+    run(*pBatch);
+    pBatch->finished.acquire((int)pBatch->subtrees.size());
 }
 
 void DirectoryMergeWindow::onDoubleClick(const QModelIndex& mi)
@@ -2019,6 +2536,25 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::canContinue()
 
 bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeMergeOperation(const MergeFileInfos& mfi, bool& bSingleFileMerge)
 {
+    if(!m_bSimulatedMergeStarted && canRunConcurrently(mfi))
+    {
+        if(!m_concurrentResults.contains(&mfi))
+            runOperationsConcurrently();
+
+        const auto it = m_concurrentResults.find(&mfi);
+        // Not there if it wasn't started, it then runs on its own below.
+        if(it != m_concurrentResults.end())
+        {
+            bSingleFileMerge = false;
+            for(const QString& message: it->messages)
+                m_pStatusInfo->addText(message);
+
+            const bool bSuccess = it->bSuccess;
+            m_concurrentResults.erase(it);
+            return bSuccess;
+        }
+    }
+
     bool bCreateBackups = m_pOptions->m_bDmCreateBakFiles;
     // First decide destname
     QString destName;
@@ -2102,6 +2638,130 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::executeMergeOperation(co
     return bSuccess;
 }
 
+bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::canRunConcurrently(const MergeFileInfos& mfi) const
+{
+    switch(mfi.getOperation())
+    {
+        case eCopyAToB:
+        case eCopyBToA:
+        case eCopyAToDest:
+        case eCopyBToDest:
+        case eCopyCToDest:
+        case eDeleteA:
+        case eDeleteB:
+        case eDeleteAB:
+        case eDeleteFromDest:
+            return true;
+        case eMergeToA:
+        case eMergeToB:
+        case eMergeToAB:
+        case eMergeABToDest:
+        case eMergeABCToDest:
+            // Merging folders only creates the destination, files need the user.
+            return mfi.isDirA();
+        default:
+            return false;
+    }
+}
+
+// What executeMergeOperation() would do for mfi, as steps for MergeOperationQueue.
+std::vector<MergeOperationQueue::Step> DirectoryMergeWindow::DirectoryMergeWindowPrivate::operationSteps(const MergeFileInfos& mfi) const
+{
+    typedef MergeOperationQueue::Step Step;
+
+    switch(mfi.getOperation())
+    {
+        case eCopyAToB:
+            return {{Step::copy, mfi.fullNameA(), mfi.fullNameB(), mfi.isDirA(), mfi.isLinkA()}};
+        case eCopyBToA:
+            return {{Step::copy, mfi.fullNameB(), mfi.fullNameA(), mfi.isDirB(), mfi.isLinkB()}};
+        case eCopyAToDest:
+            return {{Step::copy, mfi.fullNameA(), mfi.fullNameDest(), mfi.isDirA(), mfi.isLinkA()}};
+        case eCopyBToDest:
+            return {{Step::copy, mfi.fullNameB(), mfi.fullNameDest(), mfi.isDirB(), mfi.isLinkB()}};
+        case eCopyCToDest:
+            return {{Step::copy, mfi.fullNameC(), mfi.fullNameDest(), mfi.isDirC(), mfi.isLinkC()}};
+        case eDeleteA:
+            return {{Step::remove, QString(), mfi.fullNameA()}};
+        case eDeleteB:
+            return {{Step::remove, QString(), mfi.fullNameB()}};
+        case eDeleteAB:
+            return {{Step::remove, QString(), mfi.fullNameA()}, {Step::remove, QString(), mfi.fullNameB()}};
+        case eDeleteFromDest:
+            return {{Step::remove, QString(), mfi.fullNameDest()}};
+        case eMergeToA:
+            return {{Step::makeDir, QString(), mfi.fullNameA()}};
+        case eMergeToB:
+        case eMergeToAB:
+            return {{Step::makeDir, QString(), mfi.fullNameB()}};
+        case eMergeABToDest:
+        case eMergeABCToDest:
+            return {{Step::makeDir, QString(), mfi.fullNameDest()}};
+        default:
+            return {};
+    }
+}
+
+/*
+    Runs the operations following the current one at once, up to the next file that has to be
+    merged by hand. Folders are created before what goes into them and removed after their
+    content. The results are kept until the merge loop reaches the items.
+*/
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::runOperationsConcurrently()
+{
+    MergeOperationQueue queue(m_pOptions->m_bDmCreateBakFiles, m_bFollowDirLinks, m_bFollowFileLinks, m_pOptions->m_dmMaxRemoteJobs, m_pOptions->m_bDmDeltaTransfer);
+    QHash<const MergeFileInfos*, size_t> taskIds;
+    std::vector<const MergeFileInfos*> items;
+
+    for(auto it = m_currentIndexForOperation; it != m_mergeItemList.end(); ++it)
+    {
+        const MergeFileInfos* pMFI = getMFI(*it);
+        if(pMFI == nullptr || !pMFI->isOperationRunning() || pMFI->getOperation() == eNoOperation || m_concurrentResults.contains(pMFI))
+            continue;
+        if(!canRunConcurrently(*pMFI))
+            break;
+
+        const size_t id = queue.addTask(operationSteps(*pMFI));
+        taskIds.insert(pMFI, id);
+        items.push_back(pMFI);
+
+        // The closest ancestor in the list is enough, the ones above it are ordered through it.
+        for(const MergeFileInfos* pParent = pMFI->parent(); pParent != nullptr; pParent = pParent->parent())
+        {
+            const auto parentIt = taskIds.constFind(pParent);
+            if(parentIt == taskIds.constEnd())
+                continue;
+
+            const e_MergeOperation eParentOp = pParent->getOperation();
+            const bool bParentDeleted = eParentOp == eDeleteA || eParentOp == eDeleteB || eParentOp == eDeleteAB || eParentOp == eDeleteFromDest;
+            // A backup renames the whole folder, the items inside then have nothing left to do.
+            if(bParentDeleted && !m_pOptions->m_bDmCreateBakFiles)
+                queue.addDependency(id, *parentIt);
+            else
+                queue.addDependency(*parentIt, id);
+            break;
+        }
+    }
+
+    // A single operation is just as fast on its own.
+    if(items.size() < 2)
+        return;
+
+    ProgressProxy pp;
+    pp.setMaxNofSteps(items.size());
+    queue.run([&pp](size_t nofDone) {
+        pp.setCurrent(nofDone, false);
+        return !pp.wasCancelled();
+    });
+
+    for(const MergeFileInfos* pMFI: items)
+    {
+        const size_t id = taskIds.value(pMFI);
+        if(queue.isFinished(id))
+            m_concurrentResults.insert(pMFI, queue.result(id));
+    }
+}
+
 // Check if the merge can start, and prepare the m_mergeItemList which then contains all
 // items that must be merged.
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const QModelIndex& miBegin, const QModelIndex& miEnd, bool bVerbose)
@@ -2130,6 +2790,7 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareMergeStart(const
     }
 
     m_mergeItemList.clear();
+    m_concurrentResults.clear();
     if(!miBegin.isValid())
         return;
 
@@ -2230,6 +2891,118 @@ void DirectoryMergeWindow::mergeCurrentFile()
     Q_EMIT updateAvailabilities();
 }
 
+/*
+    Runs the merge of every file marked for merging on the worker threads, the way batch mode
+    does. Results without conflicts are written to the destination right away, files with
+    conflicts are left untouched and marked, so that only they need the interactive merge.
+*/
+void DirectoryMergeWindow::slotAutoMergeFiles()
+{
+    if(!d->canContinue()) return;
+
+    if(d->m_bRealMergeStarted || d->m_bSimulatedMergeStarted)
+    {
+        KMessageBox::error(this, i18n("This operation is currently not possible because folder merge is currently running."), i18n("Operation Not Possible"));
+        return;
+    }
+
+    d->autoMergeFiles();
+    Q_EMIT updateAvailabilities();
+}
+
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::autoMergeFiles()
+{
+    std::vector<QModelIndex> items;
+    for(QModelIndex mi = index(0, 0, QModelIndex()); mi.isValid(); mi = treeIterator(mi, true, true))
+    {
+        MergeFileInfos* pMFI = getMFI(mi);
+        // Remote files go through the interactive merge, which knows how to fetch and store them.
+        if(pMFI == nullptr || pMFI->getOperation() != eMergeABCToDest || !pMFI->isOperationRunning() || pMFI->hasDir() ||
+           !pMFI->existsInA() || !pMFI->existsInB() || !pMFI->existsInC() || !pMFI->isLocal() || !FileAccess(pMFI->fullNameDest()).isLocal())
+            continue;
+        items.push_back(mi);
+    }
+
+    if(items.empty())
+    {
+        KMessageBox::information(mWindow, i18n("There are no files to merge."));
+        return;
+    }
+
+    m_pStatusInfo->hide();
+    m_pStatusInfo->clear();
+
+    const QSharedPointer<Options> pOptions = m_pOptions;
+    std::vector<QJsonObject> results(items.size());
+    std::atomic<size_t> nofDone(0);
+    const std::shared_ptr<TaskGroup> pGroup = std::make_shared<TaskGroup>();
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        const MergeFileInfos* pMFI = getMFI(items[i]);
+        const BatchMerger::Job job{pMFI->getFileInfoA()->absoluteFilePath(), pMFI->getFileInfoB()->absoluteFilePath(),
+                                   pMFI->getFileInfoC()->absoluteFilePath(), pMFI->fullNameDest(), QString()};
+        QJsonObject* pResult = &results[i];
+        TaskExecutor::instance().start([job, pOptions, pResult, &nofDone]() {
+            QDir().mkpath(QFileInfo(job.output).absolutePath());
+            *pResult = BatchMerger::merge(job, pOptions);
+            ++nofDone;
+        }, TaskExecutor::Priority::interactive, pGroup);
+    }
+
+    ProgressProxy pp;
+    pp.setMaxNofSteps(items.size());
+    while(!pGroup->wait(100))
+    {
+        pp.setCurrent(nofDone.load(), false);
+        if(pp.wasCancelled())
+            pGroup->cancel();
+    }
+
+    int nofMerged = 0;
+    int nofConflicts = 0;
+    int nofErrors = 0;
+    m_bBulkUpdate = true;
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        MergeFileInfos* pMFI = getMFI(items[i]);
+        const QString status = results[i]["status"].toString();
+        // Skipped after a cancel.
+        if(status.isEmpty())
+            continue;
+
+        if(status == u8"merged")
+        {
+            ++nofMerged;
+            setOpStatus(items[i], eOpStatusDone);
+            pMFI->endOperation();
+        }
+        else if(status == u8"conflicts")
+        {
+            ++nofConflicts;
+            setOpStatus(items[i], eOpStatusConflicts);
+        }
+        else
+        {
+            ++nofErrors;
+            setOpStatus(items[i], eOpStatusError);
+            m_pStatusInfo->addText(i18n("Error: merge( %1 -> %2 ) failed:", pMFI->subPath(), pMFI->fullNameDest()));
+            const QJsonArray errors = results[i]["errors"].toArray();
+            for(const QJsonValue& error: errors)
+                m_pStatusInfo->addText(error.toString());
+        }
+    }
+    m_bBulkUpdate = false;
+    Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount() - 1, columnCount(QModelIndex()) - 1, QModelIndex()));
+
+    if(nofErrors > 0)
+    {
+        m_pStatusInfo->setWindowTitle(i18n("Merge Error"));
+        m_pStatusInfo->exec();
+    }
+
+    KMessageBox::information(mWindow, i18n("Merged files: %1\nFiles with conflicts left: %2\nFailed files: %3", nofMerged, nofConflicts, nofErrors));
+}
+
 // When bStart is true then m_currentIndexForOperation must still be processed.
 // When bVerbose is true then a messagebox will tell when the merge is complete.
 void DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeContinue(bool bStart, bool bVerbose)
@@ -2533,10 +3306,45 @@ bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::mergeFLD(const QString&
     mWindow->scrollTo(*m_currentIndexForOperation, EnsureVisible);
 
     Q_EMIT mWindow->startDiffMerge(errors, nameA, nameB, nameC, nameDest, "", "", "", nullptr);
+    prefetchNextMerges();
 
     return false;
 }
 
+// Lets the files of the next manual merges be read while the user works on this one.
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prefetchNextMerges()
+{
+    constexpr int nofPrefetchedMerges = 2;
+
+    int nofMerges = 0;
+    for(auto it = std::next(m_currentIndexForOperation); it != m_mergeItemList.end() && nofMerges < nofPrefetchedMerges; ++it)
+    {
+        const MergeFileInfos* pMFI = getMFI(*it);
+        if(pMFI == nullptr || !pMFI->isOperationRunning() || pMFI->isDirA())
+            continue;
+
+        switch(pMFI->getOperation())
+        {
+            case eMergeABToDest:
+            case eMergeToA:
+            case eMergeToAB:
+            case eMergeToB:
+                Q_EMIT mWindow->prefetchDiffMerge(pMFI->fullNameA(), pMFI->fullNameB(), QString(""));
+                ++nofMerges;
+                break;
+            case eMergeABCToDest:
+                Q_EMIT mWindow->prefetchDiffMerge(
+                    pMFI->existsInA() ? pMFI->fullNameA() : QString(""),
+                    pMFI->existsInB() ? pMFI->fullNameB() : QString(""),
+                    pMFI->existsInC() ? pMFI->fullNameC() : QString(""));
+                ++nofMerges;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
 bool DirectoryMergeWindow::DirectoryMergeWindowPrivate::copyFLD(const QString& srcName, const QString& destName)
 {
     bool bSuccess = false;
@@ -2845,6 +3653,31 @@ void DirectoryMergeInfo::setInfo(
         m_pInfoList->resizeColumnToContents(i);
 }
 
+namespace {
+MergeStateFile::Entry mergeStateEntry(const MergeFileInfos& mfi)
+{
+    MergeStateFile::Entry entry;
+    entry.subPath = mfi.subPath();
+    const std::pair<bool, MergeStateFile::Flag> flags[] = {
+        {mfi.existsInA(), MergeStateFile::existsInA}, {mfi.existsInB(), MergeStateFile::existsInB}, {mfi.existsInC(), MergeStateFile::existsInC},
+        {mfi.isEqualAB(), MergeStateFile::equalAB}, {mfi.isEqualAC(), MergeStateFile::equalAC}, {mfi.isEqualBC(), MergeStateFile::equalBC},
+        {mfi.isDirA(), MergeStateFile::dirA}, {mfi.isDirB(), MergeStateFile::dirB}, {mfi.isDirC(), MergeStateFile::dirC},
+        {mfi.isLinkA(), MergeStateFile::linkA}, {mfi.isLinkB(), MergeStateFile::linkB}, {mfi.isLinkC(), MergeStateFile::linkC},
+        {!mfi.isOperationRunning(), MergeStateFile::operationComplete}, {mfi.conflictingAges(), MergeStateFile::conflictingAges}};
+    for(const std::pair<bool, MergeStateFile::Flag>& flag: flags)
+    {
+        if(flag.first)
+            entry.flags |= flag.second;
+    }
+    entry.operation = mfi.getOperation();
+    entry.opStatus = mfi.getOpStatus();
+    entry.ageA = mfi.getAgeA();
+    entry.ageB = mfi.getAgeB();
+    entry.ageC = mfi.getAgeC();
+    return entry;
+}
+} // namespace
+
 void DirectoryMergeWindow::slotSaveMergeState()
 {
     //slotStatusMsg(i18n("Saving Directory Merge State ..."));
@@ -2852,97 +3685,190 @@ void DirectoryMergeWindow::slotSaveMergeState()
     QString dirMergeStateFilename = QFileDialog::getSaveFileName(this, i18n("Save Folder Merge State As..."), QDir::currentPath());
     if(!dirMergeStateFilename.isEmpty())
     {
-        QFile file(dirMergeStateFilename);
-        bool bSuccess = file.open(QIODevice::WriteOnly);
-        if(bSuccess)
+        std::vector<MergeStateFile::Entry> entries;
+        entries.reserve(d->m_fileMergeMap.size());
+        QModelIndex mi(d->index(0, 0, QModelIndex()));
+        while(mi.isValid())
         {
-            QTextStream ts(&file);
-
-            QModelIndex mi(d->index(0, 0, QModelIndex()));
-            while(mi.isValid())
-            {
-                MergeFileInfos* pMFI = d->getMFI(mi);
-                ts << *pMFI;
-                mi = d->treeIterator(mi, true, true);
-            }
+            entries.push_back(mergeStateEntry(*d->getMFI(mi)));
+            mi = d->treeIterator(mi, true, true);
         }
+
+        // Saving again to the same file only appends the items that changed since.
+        const bool bSuccess = dirMergeStateFilename == d->m_mergeState.fileName() ? d->m_mergeState.update(entries) : d->m_mergeState.save(dirMergeStateFilename, entries);
+        if(!bSuccess)
+            KMessageBox::error(this, i18n("Saving the folder merge state to %1 failed.\n%2", dirMergeStateFilename, d->m_mergeState.errorString()));
     }
 
     //slotStatusMsg(i18n("Ready."));
 }
 
+/*
+    Restores the operations and their status for the items that are still what they were when the
+    state was saved. Items that now exist in other places or changed from file to folder keep what
+    the scan suggested.
+*/
 void DirectoryMergeWindow::slotLoadMergeState()
 {
+    QString dirMergeStateFilename = QFileDialog::getOpenFileName(this, i18n("Load Folder Merge State"), QDir::currentPath());
+    if(dirMergeStateFilename.isEmpty())
+        return;
+
+    if(!d->m_mergeState.load(dirMergeStateFilename))
+    {
+        KMessageBox::error(this, i18n("Loading the folder merge state from %1 failed.\n%2", dirMergeStateFilename, d->m_mergeState.errorString()));
+        return;
+    }
+
+    constexpr quint32 kindFlags = MergeStateFile::existsInA | MergeStateFile::existsInB | MergeStateFile::existsInC |
+                                  MergeStateFile::dirA | MergeStateFile::dirB | MergeStateFile::dirC |
+                                  MergeStateFile::linkA | MergeStateFile::linkB | MergeStateFile::linkC;
+
+    d->m_bBulkUpdate = true;
+    QModelIndex mi(d->index(0, 0, QModelIndex()));
+    while(mi.isValid())
+    {
+        MergeFileInfos* pMFI = d->getMFI(mi);
+        const MergeStateFile::Entry* pEntry = d->m_mergeState.find(pMFI->subPath());
+        if(pEntry != nullptr && (pEntry->flags & kindFlags) == (mergeStateEntry(*pMFI).flags & kindFlags))
+        {
+            d->setMergeOperation(mi, pEntry->operation, false);
+            d->setOpStatus(mi, pEntry->opStatus);
+            if(pEntry->flags & MergeStateFile::operationComplete)
+                pMFI->endOperation();
+        }
+        mi = d->treeIterator(mi, true, true);
+    }
+    d->m_bBulkUpdate = false;
+
+    if(d->rowCount() > 0)
+        Q_EMIT d->dataChanged(d->index(0, 0, QModelIndex()), d->index(d->rowCount() - 1, d->columnCount(QModelIndex()) - 1, QModelIndex()));
+}
+
+quint8 DirectoryMergeWindow::DirectoryMergeWindowPrivate::shownCategories() const
+{
+    quint8 shown = 0;
+    if(m_pDirShowIdenticalFiles->isChecked())
+        shown |= eShowIdentical;
+    if(m_pDirShowDifferentFiles->isChecked())
+        shown |= eShowDifferent;
+    if(m_pDirShowFilesOnlyInA->isChecked())
+        shown |= eShowOnlyInA;
+    if(m_pDirShowFilesOnlyInB->isChecked())
+        shown |= eShowOnlyInB;
+    if(m_pDirShowFilesOnlyInC->isChecked())
+        shown |= eShowOnlyInC;
+    return shown;
 }
 
-void DirectoryMergeWindow::updateFileVisibilities()
+/*
+    Items below come first, a folder collects their masks. Every item that differs on its own and is
+    shown makes all folders above it differ as well, so a folder's unequal masks hold the categories
+    of all such items below it.
+*/
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::calcVisibilityMasks(MergeFileInfos* pParent, const FileNameFilter& nameFilter)
 {
-    bool bShowIdentical = d->m_pDirShowIdenticalFiles->isChecked();
-    bool bShowDifferent = d->m_pDirShowDifferentFiles->isChecked();
-    bool bShowOnlyInA = d->m_pDirShowFilesOnlyInA->isChecked();
-    bool bShowOnlyInB = d->m_pDirShowFilesOnlyInB->isChecked();
-    bool bShowOnlyInC = d->m_pDirShowFilesOnlyInC->isChecked();
-    bool bThreeDirs = d->isDirThreeWay();
-    d->m_selection1Index = QModelIndex();
-    d->m_selection2Index = QModelIndex();
-    d->m_selection3Index = QModelIndex();
+    MergeFileInfos::VisibilityMasks& parentMasks = pParent->visibilityMasks();
+    parentMasks.below = 0;
+    parentMasks.unequalAB = 0;
+    parentMasks.unequalAC = 0;
+    parentMasks.unequalBC = 0;
 
-    // in first run set all dirs to equal and determine if they are not equal.
-    // on second run don't change the equal-status anymore; it is needed to
-    // set the visibility (when bShowIdentical is false).
-    for(int loop = 0; loop < 2; ++loop)
+    const bool bThreeDirs = isDirThreeWay();
+    for(MergeFileInfos* pMFI: pParent->children())
     {
-        QModelIndex mi = d->rowCount() > 0 ? d->index(0, 0, QModelIndex()) : QModelIndex();
-        while(mi.isValid())
-        {
-            MergeFileInfos* pMFI = d->getMFI(mi);
-            bool bDir = pMFI->hasDir();
-            if(loop == 0 && bDir)
-            { //Treat all links and directories to equal by default.
-                pMFI->updateDirectoryOrLink();
-            }
+        const bool bDir = pMFI->hasDir();
+        // Treat all links and directories to equal by default.
+        if(bDir)
+            pMFI->updateDirectoryOrLink();
+        calcVisibilityMasks(pMFI, nameFilter);
+
+        MergeFileInfos::VisibilityMasks& masks = pMFI->visibilityMasks();
+        const QString fileName = pMFI->fileName();
+        masks.bNameShown = (bDir && nameFilter.isDirShown(fileName, m_bCaseSensitive)) || nameFilter.isFileShown(fileName, m_bCaseSensitive);
+        masks.own = masks.bNameShown ? pMFI->visibilityCategories() : 0;
+        masks.bOwnEqualAB = pMFI->isEqualAB();
+        masks.bOwnEqualAC = pMFI->isEqualAC();
+        masks.bOwnEqualBC = pMFI->isEqualBC();
+
+        const bool bEqual = bThreeDirs ? pMFI->isEqualAB() && pMFI->isEqualAC() : pMFI->isEqualAB();
+        const quint8 own = bEqual ? 0 : masks.own;
+        parentMasks.unequalAB |= masks.unequalAB | (masks.bOwnEqualAB ? 0 : own);
+        parentMasks.unequalAC |= masks.unequalAC | (masks.bOwnEqualAC ? 0 : own);
+        parentMasks.unequalBC |= masks.unequalBC | (masks.bOwnEqualBC ? 0 : own);
+        parentMasks.below |= pMFI->dependsOnCategories();
+    }
+}
 
-            bool bVisible =
-                (bShowIdentical && pMFI->existsEveryWhere() && pMFI->isEqualAB() && (pMFI->isEqualAC() || !bThreeDirs)) ||
-                ((bShowDifferent || bDir) && pMFI->existsCount() >= 2 && (!pMFI->isEqualAB() || !(pMFI->isEqualAC() || !bThreeDirs))) ||
-                (bShowOnlyInA && pMFI->onlyInA()) || (bShowOnlyInB && pMFI->onlyInB()) || (bShowOnlyInC && pMFI->onlyInC());
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::applyShownCategories(const QModelIndex& parentIndex, MergeFileInfos* pParent, const quint8 shown, const quint8 changed, const bool bAll)
+{
+    const QList<MergeFileInfos*>& children = pParent->children();
+    for(int row = 0; row < children.count(); ++row)
+    {
+        MergeFileInfos* pMFI = children[row];
+        if(!bAll && (pMFI->dependsOnCategories() & changed) == 0)
+            continue;
 
-            QString fileName = pMFI->fileName();
-            bVisible = bVisible && ((bDir && !Utils::wildcardMultiMatch(d->m_pOptions->m_DmDirAntiPattern, fileName, d->m_bCaseSensitive)) || (Utils::wildcardMultiMatch(d->m_pOptions->m_DmFilePattern, fileName, d->m_bCaseSensitive) && !Utils::wildcardMultiMatch(d->m_pOptions->m_DmFileAntiPattern, fileName, d->m_bCaseSensitive)));
+        pMFI->applyShownCategories(shown);
+        const bool bVisible = pMFI->isShownFor(shown);
+        // Every call schedules a new layout of the view, so only call it for actual changes.
+        if(mWindow->isRowHidden(row, parentIndex) == bVisible)
+            mWindow->setRowHidden(row, parentIndex, !bVisible);
 
-            if(loop != 0)
-                setRowHidden(mi.row(), mi.parent(), !bVisible);
+        if(!pMFI->children().isEmpty())
+            applyShownCategories(index(row, 0, parentIndex), pMFI, shown, changed, bAll);
+    }
+}
 
-            bool bEqual = bThreeDirs ? pMFI->isEqualAB() && pMFI->isEqualAC() : pMFI->isEqualAB();
-            if(!bEqual && bVisible && loop == 0) // Set all parents to "not equal"
-            {
-                pMFI->updateParents();
-            }
-            mi = d->treeIterator(mi, true, true);
-        }
+void DirectoryMergeWindow::DirectoryMergeWindowPrivate::updateShownCategories()
+{
+    if(!m_bVisibilityMasksValid)
+    {
+        mWindow->updateFileVisibilities();
+        return;
     }
+
+    m_selection1Index = QModelIndex();
+    m_selection2Index = QModelIndex();
+    m_selection3Index = QModelIndex();
+
+    const quint8 shown = shownCategories();
+    applyShownCategories(QModelIndex(), m_pRoot, shown, shown ^ m_shownCategories, false);
+    m_shownCategories = shown;
+}
+
+void DirectoryMergeWindow::updateFileVisibilities()
+{
+    d->m_selection1Index = QModelIndex();
+    d->m_selection2Index = QModelIndex();
+    d->m_selection3Index = QModelIndex();
+
+    d->calcVisibilityMasks(d->rootMFI(), FileNameFilter(d->m_pOptions->m_DmFilePattern, d->m_pOptions->m_DmFileAntiPattern, d->m_pOptions->m_DmDirAntiPattern));
+    d->m_bVisibilityMasksValid = true;
+    d->m_shownCategories = d->shownCategories();
+    d->applyShownCategories(QModelIndex(), d->rootMFI(), d->m_shownCategories, 0, true);
 }
 
 void DirectoryMergeWindow::slotShowIdenticalFiles()
 {
     d->m_pOptions->m_bDmShowIdenticalFiles = d->m_pDirShowIdenticalFiles->isChecked();
-    updateFileVisibilities();
+    d->updateShownCategories();
 }
 void DirectoryMergeWindow::slotShowDifferentFiles()
 {
-    updateFileVisibilities();
+    d->updateShownCategories();
 }
 void DirectoryMergeWindow::slotShowFilesOnlyInA()
 {
-    updateFileVisibilities();
+    d->updateShownCategories();
 }
 void DirectoryMergeWindow::slotShowFilesOnlyInB()
 {
-    updateFileVisibilities();
+    d->updateShownCategories();
 }
 void DirectoryMergeWindow::slotShowFilesOnlyInC()
 {
-    updateFileVisibilities();
+    d->updateShownCategories();
 }
 
 void DirectoryMergeWindow::slotSynchronizeDirectories() {}
@@ -2957,6 +3883,7 @@ void DirectoryMergeWindow::initDirectoryMergeActions(KDiff3App* pKDiff3App, KAct
 #include "xpm/startmerge.xpm"
 
     d->m_pDirStartOperation = GuiUtils::createAction<QAction>(i18n("Start/Continue Folder Merge"), QKeySequence(Qt::Key_F7), this, &DirectoryMergeWindow::slotRunOperationForAllItems, ac, "dir_start_operation");
+    d->m_pDirAutoMerge = GuiUtils::createAction<QAction>(i18n("Merge Files Without Conflicts"), this, &DirectoryMergeWindow::slotAutoMergeFiles, ac, "dir_auto_merge");
     d->m_pDirRunOperationForCurrentItem = GuiUtils::createAction<QAction>(i18n("Run Operation for Current Item"), QKeySequence(Qt::Key_F6), this, &DirectoryMergeWindow::slotRunOperationForCurrentItem, ac, "dir_run_operation_for_current_item");
     d->m_pDirCompareCurrent = GuiUtils::createAction<QAction>(i18n("Compare Selected File"), this, &DirectoryMergeWindow::compareCurrentFile, ac, "dir_compare_current");
     d->m_pDirMergeCurrent = GuiUtils::createAction<QAction>(i18n("Merge Current File"), QIcon(QPixmap(startmerge)), i18n("Merge\nFile"), pKDiff3App, &KDiff3App::slotMergeCurrentFile, ac, "merge_current");
@@ -3006,6 +3933,7 @@ void DirectoryMergeWindow::initDirectoryMergeActions(KDiff3App* pKDiff3App, KAct
 void DirectoryMergeWindow::setupConnections(const KDiff3App* app)
 {
     chk_connect_a(this, &DirectoryMergeWindow::startDiffMerge, app, &KDiff3App::slotFileOpen2);
+    chk_connect_a(this, &DirectoryMergeWindow::prefetchDiffMerge, app, &KDiff3App::slotPrefetchDiffMerge);
     chk_connect_a(selectionModel(), &QItemSelectionModel::selectionChanged, app, &KDiff3App::slotUpdateAvailabilities);
     chk_connect_a(selectionModel(), &QItemSelectionModel::currentChanged, app, &KDiff3App::slotUpdateAvailabilities);
     chk_connect_a(this, static_cast<void (DirectoryMergeWindow::*)(void)>(&DirectoryMergeWindow::updateAvailabilities), app, &KDiff3App::slotUpdateAvailabilities);
@@ -3016,8 +3944,10 @@ void DirectoryMergeWindow::setupConnections(const KDiff3App* app)
 void DirectoryMergeWindow::updateAvailabilities(bool bMergeEditorVisible, bool bDirCompare, bool bDiffWindowVisible,
                                                 KToggleAction* chooseA, KToggleAction* chooseB, KToggleAction* chooseC)
 {
-    d->m_pDirStartOperation->setEnabled(bDirCompare);
-    d->m_pDirRunOperationForCurrentItem->setEnabled(bDirCompare);
+    // Merging needs the comparison, which may still be running in the background.
+    d->m_pDirStartOperation->setEnabled(bDirCompare && !d->m_bScanning);
+    d->m_pDirAutoMerge->setEnabled(bDirCompare && !d->m_bScanning && d->isDirThreeWay());
+    d->m_pDirRunOperationForCurrentItem->setEnabled(bDirCompare && !d->m_bScanning);
     d->m_pDirFoldAll->setEnabled(bDirCompare);
     d->m_pDirUnfoldAll->setEnabled(bDirCompare);
 
@@ -13,6 +13,7 @@
 
 #include "common.h"
 #include "fileaccess.h"
+#include "Statistics.h"
 
 #include <QEvent>
 #include <QTreeWidget>
@@ -48,6 +49,8 @@ class DirectoryMergeWindow : public QTreeView
    int totalColumnWidth();
    bool isSyncMode();
    bool isScanning();
+   // Stops reading and comparing in the background, the folder lists may be replaced afterwards.
+   void cancelScan();
    void initDirectoryMergeActions(KDiff3App* pKDiff3App, KActionCollection* ac);
 
    void setupConnections(const KDiff3App* app);
@@ -65,12 +68,14 @@ class DirectoryMergeWindow : public QTreeView
    [[nodiscard]] QString getDirNameB() const;
    [[nodiscard]] QString getDirNameC() const;
    [[nodiscard]] QString getDirNameDest() const;
+   [[nodiscard]] const Statistics::DirectoryCompare& compareStatistics() const;
 
  public Q_SLOTS:
    void reload();
    void mergeCurrentFile();
    void compareCurrentFile();
    void slotRunOperationForAllItems();
+   void slotAutoMergeFiles();
    void slotRunOperationForCurrentItem();
    void mergeResultSaved(const QString& fileName);
    void slotChooseAEverywhere();
@@ -116,6 +121,8 @@ class DirectoryMergeWindow : public QTreeView
 
 Q_SIGNALS:
    void startDiffMerge(QStringList &errors, const QString& fn1, const QString& fn2, const QString& fn3, const QString& ofn, const QString&, const QString&, const QString&, TotalDiffStatus*);
+   // The files of a manual merge that comes up soon, they may be read in advance.
+   void prefetchDiffMerge(const QString& fn1, const QString& fn2, const QString& fn3);
    void updateAvailabilities();
    void statusBarMessage(const QString& msg);
 protected Q_SLOTS:
@@ -16,6 +16,8 @@
 #include "DefaultFileAccessJobHandler.h"
 #endif
 #include "FileAccessJobHandler.h"
+#include "FileNameFilter.h"
+#include "GitObjectReader.h"
 #include "IgnoreList.h"
 #include "Logging.h"
 #include "ProgressProxy.h"
@@ -23,6 +25,7 @@
 
 #include <algorithm>                      // for min
 #include <cstdlib>
+#include <cstring>
 #include <sys/stat.h>
 
 #ifndef Q_OS_WIN
@@ -32,17 +35,15 @@
 
 #include <QDir>
 #include <QFile>
+#include <QSaveFile>
 #include <QTemporaryFile>
 #include <QtMath>
 
-#ifndef AUTOTEST
-FileAccess::FileAccess()
-{
-    mJobHandler.reset(new DefaultFileAccessJobHandler(this));
-}
-#else
+/*
+    Directory listings hold one FileAccess per entry. The job handler and the file objects are
+    only created when an entry is actually read or written.
+*/
 FileAccess::FileAccess() = default;
-#endif
 
 FileAccess::~FileAccess() = default;
 
@@ -57,10 +58,12 @@ FileAccess::FileAccess(const FileAccess& b):
     mDisplayName{b.mDisplayName},
     m_localCopy{b.m_localCopy},
     mPhysicalPath{b.mPhysicalPath},
+    mObjectData{b.mObjectData},
     tmpFile{b.tmpFile},
     realFile{b.realFile},
     m_size{b.m_size},
     m_modificationTime{b.m_modificationTime},
+    m_bBrokenLink{b.m_bBrokenLink},
     m_bSymLink{b.m_bSymLink},
     m_bFile{b.m_bFile},
     m_bDir{b.m_bDir},
@@ -68,7 +71,8 @@ FileAccess::FileAccess(const FileAccess& b):
     m_bWritable{b.m_bWritable},
     m_bReadable{b.m_bReadable},
     m_bExecutable{b.m_bExecutable},
-    m_bHidden{b.m_bHidden}
+    m_bHidden{b.m_bHidden},
+    mbNormalLink{b.mbNormalLink}
 {
     mJobHandler.reset(b.mJobHandler ? b.mJobHandler->copy(this) : nullptr);
 }
@@ -83,10 +87,12 @@ FileAccess::FileAccess(FileAccess&& b) noexcept:
     mDisplayName{b.mDisplayName},
     m_localCopy{b.m_localCopy},
     mPhysicalPath{b.mPhysicalPath},
+    mObjectData{b.mObjectData},
     tmpFile{b.tmpFile},
     realFile{b.realFile},
     m_size{b.m_size},
     m_modificationTime{b.m_modificationTime},
+    m_bBrokenLink{b.m_bBrokenLink},
     m_bSymLink{b.m_bSymLink},
     m_bFile{b.m_bFile},
     m_bDir{b.m_bDir},
@@ -94,7 +100,8 @@ FileAccess::FileAccess(FileAccess&& b) noexcept:
     m_bWritable{b.m_bWritable},
     m_bReadable{b.m_bReadable},
     m_bExecutable{b.m_bExecutable},
-    m_bHidden{b.m_bHidden}
+    m_bHidden{b.m_bHidden},
+    mbNormalLink{b.mbNormalLink}
 {
     mJobHandler.reset(b.mJobHandler.take());
     if(mJobHandler) mJobHandler->setFileAccess(this);
@@ -111,10 +118,12 @@ FileAccess::FileAccess(FileAccess&& b) noexcept:
     b.mDisplayName = QString();
     b.m_localCopy = QString();
     b.mPhysicalPath = QString();
+    b.mObjectData = QByteArray();
     b.tmpFile = nullptr;
     b.realFile = nullptr;
     b.m_size = 0;
     b.m_modificationTime = QDateTime::fromMSecsSinceEpoch(0);
+    b.m_bBrokenLink = false;
     b.m_bSymLink = false;
     b.m_bFile = false;
     b.m_bDir = false;
@@ -123,6 +132,7 @@ FileAccess::FileAccess(FileAccess&& b) noexcept:
     b.m_bReadable = false;
     b.m_bExecutable = false;
     b.m_bHidden = false;
+    b.mbNormalLink.reset();
 }
 
 FileAccess& FileAccess::operator=(const FileAccess& b)
@@ -143,10 +153,12 @@ FileAccess& FileAccess::operator=(const FileAccess& b)
     mDisplayName = b.mDisplayName;
     m_localCopy = b.m_localCopy;
     mPhysicalPath = b.mPhysicalPath;
+    mObjectData = b.mObjectData;
     tmpFile = b.tmpFile;
     realFile = b.realFile;
     m_size = b.m_size;
     m_modificationTime = b.m_modificationTime;
+    m_bBrokenLink = b.m_bBrokenLink;
     m_bSymLink = b.m_bSymLink;
     m_bFile = b.m_bFile;
     m_bDir = b.m_bDir;
@@ -155,6 +167,7 @@ FileAccess& FileAccess::operator=(const FileAccess& b)
     m_bReadable = b.m_bReadable;
     m_bExecutable = b.m_bExecutable;
     m_bHidden = b.m_bHidden;
+    mbNormalLink = b.mbNormalLink;
     return *this;
 }
 
@@ -175,10 +188,12 @@ FileAccess& FileAccess::operator=(FileAccess&& b) noexcept
     mDisplayName = b.mDisplayName;
     m_localCopy = b.m_localCopy;
     mPhysicalPath = b.mPhysicalPath;
+    mObjectData = b.mObjectData;
     tmpFile = b.tmpFile;
     realFile = b.realFile;
     m_size = b.m_size;
     m_modificationTime = b.m_modificationTime;
+    m_bBrokenLink = b.m_bBrokenLink;
     m_bSymLink = b.m_bSymLink;
     m_bFile = b.m_bFile;
     m_bDir = b.m_bDir;
@@ -187,6 +202,7 @@ FileAccess& FileAccess::operator=(FileAccess&& b) noexcept
     m_bReadable = b.m_bReadable;
     m_bExecutable = b.m_bExecutable;
     m_bHidden = b.m_bHidden;
+    mbNormalLink = b.mbNormalLink;
 
     b.m_pParent = nullptr;
     b.m_url = QUrl();
@@ -199,10 +215,12 @@ FileAccess& FileAccess::operator=(FileAccess&& b) noexcept
     b.mDisplayName = QString();
     b.m_localCopy = QString();
     b.mPhysicalPath = QString();
+    b.mObjectData = QByteArray();
     b.tmpFile = nullptr;
     b.realFile = nullptr;
     b.m_size = 0;
     b.m_modificationTime = QDateTime::fromMSecsSinceEpoch(0);
+    b.m_bBrokenLink = false;
     b.m_bSymLink = false;
     b.m_bFile = false;
     b.m_bDir = false;
@@ -211,6 +229,7 @@ FileAccess& FileAccess::operator=(FileAccess&& b) noexcept
     b.m_bReadable = false;
     b.m_bExecutable = false;
     b.m_bHidden = false;
+    b.mbNormalLink.reset();
     return *this;
 }
 
@@ -236,16 +255,21 @@ void FileAccess::reset()
     m_bFile = false;
     m_bDir = false;
     m_bSymLink = false;
+    m_bBrokenLink = false;
     m_bWritable = false;
+    m_bReadable = false;
+    m_bExecutable = false;
     m_bHidden = false;
     m_size = 0;
+    mbNormalLink.reset();
     m_modificationTime = QDateTime::fromMSecsSinceEpoch(0);
 
     mDisplayName.clear();
     mPhysicalPath.clear();
+    mObjectData.clear();
     m_linkTarget.clear();
     //Cleanup temp file if any.
-    tmpFile = QSharedPointer<QTemporaryFile>::create();
+    tmpFile.clear();
     realFile.clear();
 
     m_pParent = nullptr;
@@ -258,9 +282,6 @@ void FileAccess::reset()
 void FileAccess::setFile(FileAccess* pParent, const QFileInfo& fi)
 {
     assert(pParent != this);
-#ifndef AUTOTEST
-    if(mJobHandler == nullptr) mJobHandler.reset(new DefaultFileAccessJobHandler(this));
-#endif
     reset();
 
     m_fileInfo = fi;
@@ -270,11 +291,47 @@ void FileAccess::setFile(FileAccess* pParent, const QFileInfo& fi)
     loadData();
 }
 
+void FileAccess::setFile(FileAccess* pParent, const EntryInfo& info)
+{
+    assert(pParent != this && pParent != nullptr);
+    reset();
+
+    // Only string operations from here on, the listing has done the stat.
+    m_fileInfo = QFileInfo(QDir(pParent->absoluteFilePath()), info.name);
+    m_fileInfo.setCaching(true);
+    m_url = QUrl::fromLocalFile(m_fileInfo.absoluteFilePath());
+    m_pParent = pParent;
+    m_baseDir = pParent->m_baseDir;
+
+    m_name = info.name;
+    m_linkTarget = info.linkTarget;
+    m_size = info.size;
+    m_modificationTime = info.modificationTime.isValid() ? info.modificationTime : QDateTime::fromMSecsSinceEpoch(0);
+    m_bFile = info.bFile;
+    m_bDir = info.bDir;
+    m_bSymLink = info.bSymLink;
+    m_bBrokenLink = info.bBrokenLink;
+    m_bExists = true;
+    m_bReadable = info.bReadable;
+    m_bWritable = info.bWritable;
+    m_bExecutable = info.bExecutable;
+    m_bHidden = info.name.startsWith('.');
+
+    m_bValidData = true;
+}
+
 void FileAccess::setFile(const QString& name, bool bWantToWrite)
 {
     if(name.isEmpty())
         return;
 
+    // "rev:path" would otherwise be taken for an url with an unknown scheme.
+    if(GitObjectReader::isObjectName(name))
+    {
+        setFile(GitObjectReader::toUrl(name), bWantToWrite);
+        return;
+    }
+
     QUrl url = QUrl::fromUserInput(name, QString(), QUrl::AssumeLocalFile);
     setFile(url, bWantToWrite);
 }
@@ -284,9 +341,6 @@ void FileAccess::setFile(const QUrl& url, bool bWantToWrite)
     if(url.isEmpty())
         return;
 
-#ifndef AUTOTEST
-    if(mJobHandler == nullptr) mJobHandler.reset(new DefaultFileAccessJobHandler(this));
-#endif
     reset();
     assert(parent() == nullptr || url != parent()->url());
 
@@ -303,11 +357,15 @@ void FileAccess::setFile(const QUrl& url, bool bWantToWrite)
 
         loadData();
     }
+    else if(isGitObject())
+    {
+        loadGitObject();
+    }
     else
     {
         m_name = m_url.fileName();
 
-        if(mJobHandler->stat(bWantToWrite))
+        if(jobHandler().stat(bWantToWrite))
             m_bValidData = true; // After running stat() the variables are initialised
                                  // and valid even if the file doesn't exist and the stat
                                  // query failed.
@@ -329,7 +387,8 @@ void FileAccess::loadData()
 
     m_bFile = m_fileInfo.isFile();
     m_bDir = m_fileInfo.isDir();
-    m_bExists = m_fileInfo.exists();
+    // git uses /dev/null as a placeholder meaning does not exist
+    m_bExists = m_fileInfo.exists() && m_fileInfo.absoluteFilePath() != QLatin1String("/dev/null");
     m_size = m_fileInfo.size();
     m_modificationTime = m_fileInfo.lastModified();
     m_bHidden = m_fileInfo.isHidden();
@@ -346,20 +405,21 @@ void FileAccess::loadData()
 
     if(isLocal() && m_bSymLink)
     {
-        m_linkTarget = m_fileInfo.symLinkTarget();
-
 #ifndef Q_OS_WIN
         // Unfortunately Qt5 symLinkTarget/readLink always returns an absolute path, even if the link is relative
         std::unique_ptr<char[]> s = std::make_unique<char[]>(PATH_MAX + 1);
-        size_t len = readlink(QFile::encodeName(absoluteFilePath()).constData(), s.get(), PATH_MAX);
+        const ssize_t len = readlink(QFile::encodeName(absoluteFilePath()).constData(), s.get(), PATH_MAX);
         if(len > 0)
         {
             s[len] = '\0';
             m_linkTarget = QFile::decodeName(s.get());
         }
+        else
 #endif
+            m_linkTarget = m_fileInfo.symLinkTarget();
 
-        m_bBrokenLink = !QFileInfo::exists(m_linkTarget);
+        // QFileInfo follows the link, its stat of the target is already cached.
+        m_bBrokenLink = !m_fileInfo.exists();
         //We want to know if the link itself exists
         if(!m_bExists)
             m_bExists = true;
@@ -368,10 +428,51 @@ void FileAccess::loadData()
             m_modificationTime = QDateTime::fromMSecsSinceEpoch(0);
     }
 
-    realFile = QSharedPointer<QFile>::create(absoluteFilePath());
     m_bValidData = true;
 }
 
+void FileAccess::loadGitObject()
+{
+    const QString objectName = GitObjectReader::objectName(m_url);
+    m_name = objectName.mid(std::max(objectName.lastIndexOf('/'), objectName.indexOf(':')) + 1);
+
+    QString errorString;
+    m_bExists = GitObjectReader::readBlob(objectName, mObjectData, errorString);
+    m_bFile = m_bExists;
+    m_bReadable = m_bExists;
+    m_size = mObjectData.size();
+    if(!m_bExists)
+        setStatusText(errorString);
+
+    m_bValidData = true;
+}
+
+FileAccessJobHandler& FileAccess::jobHandler()
+{
+#ifndef AUTOTEST
+    if(mJobHandler == nullptr) mJobHandler.reset(new DefaultFileAccessJobHandler(this));
+#endif
+    assert(mJobHandler != nullptr);
+    return *mJobHandler;
+}
+
+QFile& FileAccess::localFile()
+{
+    if(realFile == nullptr) realFile = QSharedPointer<QFile>::create(absoluteFilePath());
+    return *realFile;
+}
+
+QTemporaryFile& FileAccess::tempFile()
+{
+    if(tmpFile == nullptr) tmpFile = QSharedPointer<QTemporaryFile>::create();
+    return *tmpFile;
+}
+
+bool FileAccess::hasOpenFile() const
+{
+    return (realFile != nullptr && realFile->isOpen()) || (tmpFile != nullptr && tmpFile->isOpen());
+}
+
 void FileAccess::addPath(const QString& txt, bool reinit)
 {
     if(!isLocal())
@@ -589,19 +690,23 @@ bool FileAccess::isNormal() const
             return false;
         }
 
-        FileAccess target(m_linkTarget);
+        if(mbNormalLink.has_value())
+            return *mbNormalLink;
+
+        // Relative targets start from the folder of the link.
+        FileAccess target(QDir::isRelativePath(m_linkTarget) ? m_fileInfo.absoluteDir().filePath(m_linkTarget) : m_linkTarget);
 
         mVisited = true;
         ++mDepth;
         /*
             Catch local links to special files. '/dev' has many of these.
         */
-        bool result = target.isSymLink() || target.isNormal();
+        mbNormalLink = target.isSymLink() || target.isNormal();
         // mVisited has done its job and should be reset here.
         mVisited = false;
         --mDepth;
 
-        return result;
+        return *mbNormalLink;
     }
 
     mVisited = false;
@@ -610,45 +715,33 @@ bool FileAccess::isNormal() const
     return !exists() || isFile() || isDir() || isSymLink();
 }
 
+/*
+    Local or not, these are the values read when the entry was set up. Asking the file system
+    again would mean a stat for each call, a round trip on network mounts.
+*/
 bool FileAccess::isFile() const
 {
-    if(!isLocal())
-        return m_bFile;
-    else
-        return m_fileInfo.isFile();
+    return m_bFile;
 }
 
 bool FileAccess::isDir() const
 {
-    if(!isLocal())
-        return m_bDir;
-    else
-        return m_fileInfo.isDir();
+    return m_bDir;
 }
 
 bool FileAccess::isSymLink() const
 {
-    if(!isLocal())
-        return m_bSymLink;
-    else
-        return m_fileInfo.isSymLink();
+    return m_bSymLink;
 }
 
 bool FileAccess::exists() const
 {
-    if(!isLocal())
-        return m_bExists;
-    else
-        return (m_fileInfo.exists() || isSymLink()) && // QFileInfo.exists returns false for broken links,
-               absoluteFilePath() != "/dev/null";      // git uses /dev/null as a placeholder meaning does not exist
+    return m_bExists;
 }
 
 qint64 FileAccess::size() const
 {
-    if(!isLocal())
-        return m_size;
-    else
-        return m_fileInfo.size();
+    return m_size;
 }
 
 const QUrl& FileAccess::url() const
@@ -660,6 +753,11 @@ const QUrl& FileAccess::url() const
     FileAccess::isLocal() should return whether or not the m_url contains what KDiff3 considers
     a local i.e. non-KIO path. This is not the necessarily same as what QUrl::isLocalFile thinks.
 */
+bool FileAccess::isGitObject() const
+{
+    return m_url.scheme() == QLatin1String(GitObjectReader::scheme);
+}
+
 bool FileAccess::isLocal() const
 {
     return m_url.isLocalFile() || !m_url.isValid() || m_url.scheme().isEmpty();
@@ -667,37 +765,22 @@ bool FileAccess::isLocal() const
 
 bool FileAccess::isReadable() const
 {
-    //This can be very slow in some network setups so use cached value
-    if(!isLocal())
-        return m_bReadable;
-    else
-        return m_fileInfo.isReadable();
+    return m_bReadable;
 }
 
 bool FileAccess::isWritable() const
 {
-    //This can be very slow in some network setups so use cached value
-    if(!isLocal())
-        return m_bWritable;
-    else
-        return m_fileInfo.isWritable();
+    return m_bWritable;
 }
 
 bool FileAccess::isExecutable() const
 {
-    //This can be very slow in some network setups so use cached value
-    if(!isLocal())
-        return m_bExecutable;
-    else
-        return m_fileInfo.isExecutable();
+    return m_bExecutable;
 }
 
 bool FileAccess::isHidden() const
 {
-    if(!(isLocal()))
-        return m_bHidden;
-    else
-        return m_fileInfo.isHidden();
+    return m_bHidden;
 }
 
 const QString& FileAccess::readLink() const
@@ -803,7 +886,16 @@ bool FileAccess::readFile(void* pDestBuffer, qint64 maxLength)
     if(!isNormal())
         return true;
 
-    if(isLocal() || !m_localCopy.isEmpty())
+    if(isGitObject())
+    {
+        // Everything is in memory already.
+        success = m_bExists && maxLength <= mObjectData.size();
+        if(success)
+            memcpy(pDestBuffer, mObjectData.constData(), (size_t)maxLength);
+        else
+            setStatusText(i18n("Failed to read file: %1", prettyAbsPath()));
+    }
+    else if(isLocal() || !m_localCopy.isEmpty())
     {
         if(open(QIODevice::ReadOnly))//krazy:exclude=syscalls
         {
@@ -813,20 +905,27 @@ bool FileAccess::readFile(void* pDestBuffer, qint64 maxLength)
     }
     else
     {
-        success = mJobHandler->get(pDestBuffer, maxLength);
+        success = jobHandler().get(pDestBuffer, maxLength);
     }
 
     close();
-    assert(!realFile->isOpen() && !tmpFile->isOpen());
+    assert(!hasOpenFile());
     return success;
 }
 
 bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
 {
     ProgressProxy pp;
+    if(isGitObject())
+    {
+        setStatusText(i18n("%1 is part of a git revision and can't be written.", prettyAbsPath()));
+        return false;
+    }
+
     if(isLocal())
     {
-        if(realFile->open(QIODevice::WriteOnly))
+        QFile& file = localFile();
+        if(file.open(QIODevice::WriteOnly))
         {
             const qint64 maxChunkSize = 100000;
             pp.setMaxNofSteps(length / maxChunkSize + 1);
@@ -834,10 +933,10 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
             while(i < length)
             {
                 qint64 nextLength = std::min(length - i, maxChunkSize);
-                qint64 reallyWritten = realFile->write((char*)pSrcBuffer + i, nextLength);
+                qint64 reallyWritten = file.write((char*)pSrcBuffer + i, nextLength);
                 if(reallyWritten != nextLength)
                 {
-                    realFile->close();
+                    file.close();
                     return false;
                 }
                 i += reallyWritten;
@@ -845,7 +944,7 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
                 pp.step();
                 if(pp.wasCancelled())
                 {
-                    realFile->close();
+                    file.close();
                     return false;
                 }
             }
@@ -853,35 +952,119 @@ bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
             if(isExecutable()) // value is true if the old file was executable
             {
                 // Preserve attributes
-                realFile->setPermissions(realFile->permissions() | QFile::ExeUser);
+                file.setPermissions(file.permissions() | QFile::ExeUser);
             }
 
-            realFile->close();
+            file.close();
             return true;
         }
     }
     else
     {
-        bool success = mJobHandler->put(pSrcBuffer, length, true /*overwrite*/);
+        bool success = jobHandler().put(pSrcBuffer, length, true /*overwrite*/);
         close();
 
-        assert(!realFile->isOpen() && !tmpFile->isOpen());
+        assert(!hasOpenFile());
 
         return success;
     }
     close();
-    assert(!realFile->isOpen() && !tmpFile->isOpen());
+    assert(!hasOpenFile());
     return false;
 }
 
+/*
+    Local files get each block as soon as it is produced. They go to a temporary file next to the
+    destination that replaces it only once everything was written, a failed save leaves the old
+    file alone. Where the file system allows, the backup is a hard link to the old file, so the old
+    content is neither copied nor moved aside first.
+
+    KIO::put wants the whole file in one buffer, so the blocks are collected first for anything
+    else. The backup is a rename on the server, the new content is transferred once.
+*/
+bool FileAccess::writeFile(const std::function<QByteArray()>& nextChunk, const QString& bakExtension)
+{
+    const bool bBackup = !bakExtension.isEmpty() && exists();
+    if(!isLocal())
+    {
+        if(bBackup && !createBackup(bakExtension))
+            return false;
+
+        QByteArray data;
+        for(QByteArray chunk = nextChunk(); !chunk.isEmpty(); chunk = nextChunk())
+            data.append(chunk);
+        return writeFile(data.constData(), data.size());
+    }
+
+    if(isGitObject())
+    {
+        setStatusText(i18n("%1 is part of a git revision and can't be written.", prettyAbsPath()));
+        return false;
+    }
+
+    if(bBackup && !linkBackup(bakExtension) && !createBackup(bakExtension))
+        return false;
+
+    ProgressProxy pp;
+    QSaveFile file(absoluteFilePath());
+    // Without write access to the folder the file is written in place.
+    file.setDirectWriteFallback(true);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        setStatusText(file.errorString());
+        return false;
+    }
+
+    for(QByteArray chunk = nextChunk(); !chunk.isEmpty(); chunk = nextChunk())
+    {
+        if(file.write(chunk) != chunk.size() || pp.wasCancelled())
+        {
+            file.cancelWriting();
+            return false;
+        }
+    }
+
+    if(isExecutable()) // value is true if the old file was executable
+    {
+        // Preserve attributes
+        file.setPermissions(file.permissions() | QFile::ExeUser);
+    }
+
+    // Flushed to disk before it takes the place of the old file.
+    if(!file.commit())
+    {
+        setStatusText(file.errorString());
+        return false;
+    }
+    return true;
+}
+
+// Keeps the old content under the backup name as a second link to the same data.
+bool FileAccess::linkBackup(const QString& bakExtension)
+{
+#ifndef Q_OS_WIN
+    const QString bakName = absoluteFilePath() + bakExtension;
+    FileAccess bakFile(bakName, true /*bWantToWrite*/);
+    if(bakFile.exists() && !bakFile.removeFile())
+    {
+        setStatusText(i18n("While trying to make a backup, deleting an older backup failed.\nFilename: %1", bakName));
+        return false;
+    }
+    return ::link(QFile::encodeName(absoluteFilePath()).constData(), QFile::encodeName(bakName).constData()) == 0;
+#else
+    Q_UNUSED(bakExtension);
+    return false;
+#endif
+}
+
 bool FileAccess::copyFile(const QString& dest)
 {
-    return mJobHandler->copyFile(dest); // Handles local and remote copying.
+    return jobHandler().copyFile(dest); // Handles local and remote copying.
 }
 
 bool FileAccess::rename(const FileAccess& dest)
 {
-    return mJobHandler->rename(dest);
+    return jobHandler().rename(dest);
 }
 
 bool FileAccess::removeFile()
@@ -892,7 +1075,7 @@ bool FileAccess::removeFile()
     }
     else
     {
-        return mJobHandler->removeFile(url());
+        return jobHandler().removeFile(url());
     }
 }
 
@@ -900,8 +1083,7 @@ bool FileAccess::listDir(DirectoryList* pDirList, bool bRecursive, bool bFindHid
                          const QString& filePattern, const QString& fileAntiPattern, const QString& dirAntiPattern,
                          bool bFollowDirLinks, IgnoreList& ignoreList)
 {
-    assert(mJobHandler != nullptr);
-    return mJobHandler->listDir(pDirList, bRecursive, bFindHidden, filePattern, fileAntiPattern,
+    return jobHandler().listDir(pDirList, bRecursive, bFindHidden, filePattern, fileAntiPattern,
                       dirAntiPattern, bFollowDirLinks, ignoreList);
 }
 
@@ -928,16 +1110,18 @@ bool FileAccess::open(const QFile::OpenMode flags)
         return result;
     }
 
-    if(m_localCopy.isEmpty() && realFile != nullptr)
+    if(m_localCopy.isEmpty() && isLocal())
     {
-        bool r = realFile->open(flags);
+        QFile& file = localFile();
+        bool r = file.open(flags);
 
-        setStatusText(i18n("Opening %1 failed. %2", absoluteFilePath(), realFile->errorString()));
+        setStatusText(i18n("Opening %1 failed. %2", absoluteFilePath(), file.errorString()));
         return r;
     }
 
-    bool r = tmpFile->open();
-    setStatusText(i18n("Opening %1 failed. %2", tmpFile->fileName(), tmpFile->errorString()));
+    QTemporaryFile& file = tempFile();
+    bool r = file.open();
+    setStatusText(i18n("Opening %1 failed. %2", file.fileName(), file.errorString()));
     return r;
 }
 
@@ -951,20 +1135,22 @@ qint64 FileAccess::read(char* data, const qint64 maxlen)
     }
 
     qint64 len = 0;
-    if(m_localCopy.isEmpty() && realFile != nullptr)
+    if(m_localCopy.isEmpty() && isLocal())
     {
-        len = realFile->read(data, maxlen);
+        QFile& file = localFile();
+        len = file.read(data, maxlen);
         if(len != maxlen)
         {
-            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), realFile->errorString()));
+            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), file.errorString()));
         }
     }
     else
     {
-        len = tmpFile->read(data, maxlen);
+        QTemporaryFile& file = tempFile();
+        len = file.read(data, maxlen);
         if(len != maxlen)
         {
-            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), tmpFile->errorString()));
+            setStatusText(i18n("Error reading from %1. %2", absoluteFilePath(), file.errorString()));
         }
     }
 
@@ -973,12 +1159,11 @@ qint64 FileAccess::read(char* data, const qint64 maxlen)
 
 void FileAccess::close()
 {
-    if(m_localCopy.isEmpty() && realFile != nullptr)
-    {
+    if(realFile != nullptr)
         realFile->close();
-    }
 
-    tmpFile->close();
+    if(tmpFile != nullptr)
+        tmpFile->close();
 }
 
 bool FileAccess::createLocalCopy()
@@ -986,12 +1171,21 @@ bool FileAccess::createLocalCopy()
     if(isLocal() || !m_localCopy.isEmpty() || !mPhysicalPath.isEmpty())
         return true;
 
-    tmpFile->setAutoRemove(true);
-    tmpFile->open();
-    tmpFile->close();
-    m_localCopy = tmpFile->fileName();
+    QTemporaryFile& file = tempFile();
+    file.setAutoRemove(true);
+    file.open();
+    // Only preprocessor commands need a file.
+    if(isGitObject())
+    {
+        const bool bSuccess = file.write(mObjectData) == mObjectData.size();
+        file.close();
+        m_localCopy = file.fileName();
+        return bSuccess;
+    }
+    file.close();
+    m_localCopy = file.fileName();
 
-    return copyFile(tmpFile->fileName());
+    return copyFile(file.fileName());
 }
 
 //static tempfile Generator
@@ -1037,7 +1231,7 @@ qint64 FileAccess::sizeForReading()
         // Size couldn't be determined. Copy the file to a local temp place.
         if(createLocalCopy())
         {
-            const QString localCopy = tmpFile->fileName();
+            const QString localCopy = tempFile().fileName();
             const QFileInfo fi(localCopy);
 
             m_size = fi.size();
@@ -1114,8 +1308,7 @@ void FileAccess::doError()
     m_bExists = false;
 }
 
-void FileAccess::filterList(const QString& dir, DirectoryList* pDirList, const QString& filePattern,
-                            const QString& fileAntiPattern, const QString& dirAntiPattern,
+void FileAccess::filterList(const QString& dir, DirectoryList* pDirList, const FileNameFilter& nameFilter,
                             const IgnoreList& ignoreList)
 {
     //TODO: Ask os for this information don't hard code it.
@@ -1133,10 +1326,8 @@ void FileAccess::filterList(const QString& dir, DirectoryList* pDirList, const Q
         ++i2;
         const QString& fileName = i->fileName();
 
-        if((i->isFile() &&
-            (!Utils::wildcardMultiMatch(filePattern, fileName, bCaseSensitive) ||
-             Utils::wildcardMultiMatch(fileAntiPattern, fileName, bCaseSensitive))) ||
-           (i->isDir() && Utils::wildcardMultiMatch(dirAntiPattern, fileName, bCaseSensitive)) ||
+        if((i->isFile() && !nameFilter.isFileShown(fileName, bCaseSensitive)) ||
+           (i->isDir() && !nameFilter.isDirShown(fileName, bCaseSensitive)) ||
            (ignoreList.matches(dir, fileName, bCaseSensitive)))
         {
             // Remove it
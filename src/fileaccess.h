@@ -13,6 +13,8 @@
 
 #include "DirectoryList.h"
 
+#include <functional>
+#include <optional>
 #include <type_traits>
 
 #include <QDateTime>
@@ -29,8 +31,10 @@
 #endif
 
 class FileAccessJobHandler;
+class FileNameFilter;
 class DefaultFileAccessJobHandler;
 class IgnoreList;
+class RemoteDirectoryLister;
 /*
   Defining a function as virtual in FileAccess is intended to allow testing sub classes to be written
   more easily. This way the test can use a moc class that emulates the needed conditions with no
@@ -39,6 +43,24 @@ class IgnoreList;
 class FileAccess
 {
   public:
+    // Everything a listing reads about an entry of a local folder.
+    struct EntryInfo
+    {
+        QString name;
+        QString linkTarget;
+        qint64 size = 0;
+        QDateTime modificationTime;
+        bool bFile = false; // For links these describe the target.
+        bool bDir = false;
+        bool bSymLink = false;
+        bool bBrokenLink = false;
+        bool bReadable = false;
+        bool bWritable = false;
+        bool bExecutable = false;
+        quint64 device = 0; // Both 0 when not known.
+        quint64 inode = 0;
+    };
+
     FileAccess();
 
     FileAccess(const FileAccess&);
@@ -52,6 +74,8 @@ class FileAccess
     void setFile(const QString& name, bool bWantToWrite = false);
     void setFile(const QUrl& url, bool bWantToWrite = false);
     void setFile(FileAccess* pParent, const QFileInfo& fi);
+    // Doesn't access the file system, info must be complete.
+    void setFile(FileAccess* pParent, const EntryInfo& info);
 
     virtual void loadData();
 
@@ -93,6 +117,9 @@ class FileAccess
         return QFileInfo(url.path()).absoluteFilePath();
     }
 
+    // A file of a git revision, see GitObjectReader. Served from memory, it can't be written.
+    [[nodiscard]] bool isGitObject() const;
+
     //Workaround for QUrl::isLocalFile behavior that does not fit KDiff3's expectations.
     [[nodiscard]] bool isLocal() const;
     [[nodiscard]] static bool isLocal(const QUrl& url)
@@ -102,6 +129,11 @@ class FileAccess
 
     virtual bool readFile(void* pDestBuffer, qint64 maxLength);
     virtual bool writeFile(const void* pSrcBuffer, qint64 length);
+    /*
+        Writes the blocks returned by nextChunk until it returns an empty one. Replaces an existing
+        file only when everything was written, which is kept as a backup if bakExtension isn't empty.
+    */
+    bool writeFile(const std::function<QByteArray()>& nextChunk, const QString& bakExtension = QString());
     bool listDir(DirectoryList* pDirList, bool bRecursive, bool bFindHidden,
                  const QString& filePattern, const QString& fileAntiPattern,
                  const QString& dirAntiPattern, bool bFollowDirLinks, IgnoreList& ignoreList);
@@ -127,8 +159,7 @@ class FileAccess
     [[nodiscard]] FileAccess* parent() const; // !=0 for listDir-results, but only valid if the parent was not yet destroyed.
 
     void doError();
-    void filterList(const QString& dir, DirectoryList* pDirList, const QString& filePattern,
-                    const QString& fileAntiPattern, const QString& dirAntiPattern,
+    void filterList(const QString& dir, DirectoryList* pDirList, const FileNameFilter& nameFilter,
                     const IgnoreList& ignoreList);
 
     [[nodiscard]] QDir getBaseDirectory() const { return m_baseDir; }
@@ -144,6 +175,7 @@ class FileAccess
   protected:
 #ifndef AUTOTEST
     friend DefaultFileAccessJobHandler;
+    friend RemoteDirectoryLister;
     void setFromUdsEntry(const KIO::UDSEntry& e, FileAccess* parent);
 #endif
     void setStatusText(const QString& s);
@@ -151,6 +183,13 @@ class FileAccess
     void reset();
 
     bool interruptableReadFile(void* pDestBuffer, qint64 maxLength);
+    bool linkBackup(const QString& bakExtension);
+
+    // Created on first use, most entries of a listing are never read.
+    FileAccessJobHandler& jobHandler();
+    QFile& localFile();
+    QTemporaryFile& tempFile();
+    [[nodiscard]] bool hasOpenFile() const;
 
     QScopedPointer<FileAccessJobHandler> mJobHandler;
     FileAccess* m_pParent = nullptr;
@@ -165,7 +204,8 @@ class FileAccess
     QString mDisplayName;
     QString m_localCopy;
     QString mPhysicalPath;
-    QSharedPointer<QTemporaryFile> tmpFile = QSharedPointer<QTemporaryFile>::create();
+    QByteArray mObjectData;
+    QSharedPointer<QTemporaryFile> tmpFile;
     QSharedPointer<QFile> realFile = nullptr;
 
     qint64 m_size = 0;
@@ -183,6 +223,8 @@ class FileAccess
     QString m_statusText; // Might contain an error string, when the last operation didn't succeed.
 
   private:
+    void loadGitObject();
+
     /*
     These two variables are used to prevent infinate/long running loops when a symlinks true target
     must be found. isNormal is right now the only place this is needed.
@@ -191,6 +233,8 @@ class FileAccess
     */
     mutable bool mVisited = false;
     mutable quint32 mDepth = 0;
+    // Following a local link takes a stat per step, isNormal does it once.
+    mutable std::optional<bool> mbNormalLink;
 };
 /*
  FileAccess objects should be copy and move assignable.
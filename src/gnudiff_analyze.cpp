@@ -31,23 +31,19 @@
 
 #include "gnudiff_diff.h"
 
+#include "TaskExecutor.h"
+
 #include <algorithm>       // for max, min
+#include <atomic>
+#include <memory>
 #include <stdlib.h>
+#include <vector>
 
-
-static GNULineRef *xvec, *yvec;  /* Vectors being compared. */
-static GNULineRef *fdiag;        /* Vector, indexed by diagonal, containing
-                   1 + the X coordinate of the point furthest
-                   along the given diagonal in the forward
-                   search of the edit matrix. */
-static GNULineRef *bdiag;        /* Vector, indexed by diagonal, containing
-                   the X coordinate of the point furthest
-                   along the given diagonal in the backward
-                   search of the edit matrix. */
-static GNULineRef too_expensive; /* Edit scripts longer than this are too
-                   expensive to compute.  */
+#include <QSemaphore>
 
 #define SNAKE_LIMIT 20 /* Snakes bigger than this are considered `big'.  */
+#define PARALLEL_LIMIT 4096 /* Halves with fewer lines than this in both files together are not handed to other threads.  */
+#define DEADLINE_TOO_EXPENSIVE 256 /* Once the deadline passed, edit scripts longer than this are too expensive.  */
 
 struct partition {
     GNULineRef xmid, ymid; /* Midpoints of this partition.  */
@@ -55,6 +51,29 @@ struct partition {
     bool hi_minimal;       /* Likewise for high half.  */
 };
 
+namespace {
+/* Diagonal vectors for a subproblem that runs on another thread.  */
+struct DiagScratch {
+    explicit DiagScratch(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim)
+        : diags((xlim - xoff) + (ylim - yoff) + 3), buffer((size_t)(2 * diags))
+    {
+        fd = buffer.data() + (ylim - xoff) + 1;
+        bd = fd + diags;
+    }
+
+    GNULineRef diags;
+    std::vector<GNULineRef> buffer;
+    GNULineRef *fd;
+    GNULineRef *bd;
+};
+
+/* The upper half of a split, done by whichever thread claims it first.  */
+struct ForkedHalf {
+    std::atomic<bool> claimed{false};
+    QSemaphore done;
+};
+} // namespace
+
 /* Find the midpoint of the shortest edit script for a specified
    portion of the two files.
 
@@ -87,10 +106,8 @@ struct partition {
    It cannot cause incorrect diff output.  */
 
 GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal,
-                         partition *part) const
+                         partition *part, GNULineRef *const fd, GNULineRef *const bd) const
 {
-    GNULineRef *const fd = fdiag;        /* Give the compiler a chance. */
-    GNULineRef *const bd = bdiag;        /* Additional help for the compiler. */
     GNULineRef const *const xv = xvec;   /* Still more help for the compiler. */
     GNULineRef const *const yv = yvec;   /* And more and more . . . */
     GNULineRef const dmin = xoff - ylim; /* Minimum valid diagonal. */
@@ -111,6 +128,10 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
         GNULineRef d; /* Active diagonal. */
         bool big_snake = false;
 
+        /* Reading the clock costs more than a step, so only look every few.  */
+        if((c & 63) == 0 && !deadline_passed.load(std::memory_order_relaxed) && deadline.hasExpired())
+            deadline_passed.store(true, std::memory_order_relaxed);
+
         /* Extend the top-down search by an edit step in each diagonal. */
         fmin > dmin ? fd[--fmin - 1] = -1 : ++fmin;
         fmax < dmax ? fd[++fmax + 1] = -1 : --fmax;
@@ -165,7 +186,7 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
             }
         }
 
-        if(find_minimal)
+        if(find_minimal && !deadline_passed.load(std::memory_order_relaxed))
             continue;
 
         /* Heuristic: check occasionally for a diagonal that has made
@@ -176,7 +197,7 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
      With this heuristic, for files with a constant small density
      of changes, the algorithm is linear in the file size.  */
 
-        if(200 < c && big_snake && speed_large_files)
+        if(200 < c && big_snake && (speed_large_files || deadline_passed.load(std::memory_order_relaxed)))
         {
             GNULineRef best;
 
@@ -249,7 +270,7 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
 
         /* Heuristic: if we've gone well beyond the call of duty,
      give up and report halfway between our best results so far.  */
-        if(c >= too_expensive)
+        if(c >= too_expensive || (c >= DEADLINE_TOO_EXPENSIVE && deadline_passed.load(std::memory_order_relaxed)))
         {
             GNULineRef fxybest, fxbest;
             GNULineRef bxybest, bxbest;
@@ -318,9 +339,19 @@ GNULineRef GnuDiff::diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
    All line numbers are origin-0 and discarded lines are not counted.
 
    If FIND_MINIMAL, find a minimal difference no matter how
-   expensive it is.  */
+   expensive it is.
+
+   FD and BD are the diagonal vectors for `diag', they must hold every
+   diagonal from XOFF - YLIM - 1 to XLIM - YOFF + 1.
 
-void GnuDiff::compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal)
+   In parallel mode the upper half of a large split is offered to the
+   global thread pool while this thread works on the lower half.  A pool
+   thread that takes it brings vectors of its own, as the halves overlap
+   in diagonals.  If no thread took it by then, this thread does it
+   itself, so waiting only ever happens for work that is running.  */
+
+void GnuDiff::compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal,
+                         GNULineRef *fd, GNULineRef *bd)
 {
     GNULineRef *const xv = xvec; /* Help the compiler.  */
     GNULineRef *const yv = yvec;
@@ -346,7 +377,7 @@ void GnuDiff::compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
 
         /* Find a point of correspondence in the middle of the files.  */
 
-        c = diag(xoff, xlim, yoff, ylim, find_minimal, &part);
+        c = diag(xoff, xlim, yoff, ylim, find_minimal, &part, fd, bd);
 
         /* This should be impossible, because it implies that
          one of the two subsequences is empty,
@@ -354,8 +385,30 @@ void GnuDiff::compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNUL
         assert(c != 1);
 
         /* Use the partitions to split this problem into subproblems.  */
-        compareseq(xoff, part.xmid, yoff, part.ymid, part.lo_minimal);
-        compareseq(part.xmid, xlim, part.ymid, ylim, part.hi_minimal);
+        if(parallel && (part.xmid - xoff) + (part.ymid - yoff) >= PARALLEL_LIMIT && (xlim - part.xmid) + (ylim - part.ymid) >= PARALLEL_LIMIT)
+        {
+            /* A task left in the queue only touches PHIGH once this call returned.  */
+            const std::shared_ptr<ForkedHalf> pHigh = std::make_shared<ForkedHalf>();
+            TaskExecutor::instance().start([this, pHigh, part, xlim, ylim]() {
+                if(pHigh->claimed.exchange(true))
+                    return;
+
+                DiagScratch scratch(part.xmid, xlim, part.ymid, ylim);
+                compareseq(part.xmid, xlim, part.ymid, ylim, part.hi_minimal, scratch.fd, scratch.bd);
+                pHigh->done.release();
+            }, TaskExecutor::Priority::interactive);
+
+            compareseq(xoff, part.xmid, yoff, part.ymid, part.lo_minimal, fd, bd);
+            if(!pHigh->claimed.exchange(true))
+                compareseq(part.xmid, xlim, part.ymid, ylim, part.hi_minimal, fd, bd);
+            else
+                pHigh->done.acquire();
+        }
+        else
+        {
+            compareseq(xoff, part.xmid, yoff, part.ymid, part.lo_minimal, fd, bd);
+            compareseq(part.xmid, xlim, part.ymid, ylim, part.hi_minimal, fd, bd);
+        }
     }
 }
 
@@ -674,74 +727,18 @@ void GnuDiff::shift_boundaries(file_data filevec[])
     }
 }
 
-/* Cons an additional entry onto the front of an edit script OLD.
-   LINE0 and LINE1 are the first affected lines in the two files (origin 0).
-   DELETED is the number of lines deleted here from file 0.
-   INSERTED is the number of lines inserted here in file 1.
-
-   If DELETED is 0 then LINE0 is the number of the line before
-   which the insertion was done; vice versa for INSERTED and LINE1.  */
-
-GnuDiff::change *GnuDiff::add_change(GNULineRef line0, GNULineRef line1, GNULineRef deleted, GNULineRef inserted, change *old)
-{
-    change *newChange = (change *)xmalloc(sizeof(*newChange));
-
-    newChange->line0 = line0;
-    newChange->line1 = line1;
-    newChange->inserted = inserted;
-    newChange->deleted = deleted;
-    newChange->link = old;
-    return newChange;
-}
-
-/* Scan the tables of which lines are inserted and deleted,
-   producing an edit script in reverse order.  */
-
-GnuDiff::change *GnuDiff::build_reverse_script(file_data const filevec[])
-{
-    change *script = nullptr;
-    bool *changed0 = filevec[0].changed;
-    bool *changed1 = filevec[1].changed;
-    GNULineRef len0 = filevec[0].buffered_lines;
-    GNULineRef len1 = filevec[1].buffered_lines;
-
-    /* Note that changedN[len0] does exist, and is 0.  */
-
-    GNULineRef i0 = 0, i1 = 0;
-
-    while(i0 < len0 || i1 < len1)
-    {
-        if(changed0[i0] | changed1[i1])
-        {
-            GNULineRef line0 = i0, line1 = i1;
-
-            /* Find # lines changed here in each file.  */
-            while(changed0[i0]) ++i0;
-            while(changed1[i1]) ++i1;
-
-            /* Record this change.  */
-            script = add_change(line0, line1, i0 - line0, i1 - line1, script);
-        }
-
-        /* We have reached lines in the two files that match each other.  */
-        i0++, i1++;
-    }
-
-    return script;
-}
-
 /* Scan the tables of which lines are inserted and deleted,
    producing an edit script in forward order.  */
 
-GnuDiff::change *GnuDiff::build_script(file_data const filevec[])
+void GnuDiff::build_script(file_data const filevec[], std::vector<change> &script)
 {
-    change *script = nullptr;
     bool *changed0 = filevec[0].changed;
     bool *changed1 = filevec[1].changed;
     GNULineRef i0 = filevec[0].buffered_lines, i1 = filevec[1].buffered_lines;
 
     /* Note that changedN[-1] does exist, and is 0.  */
 
+    script.clear();
     while(i0 >= 0 || i1 >= 0)
     {
         if(changed0[i0 - 1] | changed1[i1 - 1])
@@ -753,22 +750,27 @@ GnuDiff::change *GnuDiff::build_script(file_data const filevec[])
             while(changed1[i1 - 1]) --i1;
 
             /* Record this change.  */
-            script = add_change(i0, i1, line0 - i0, line1 - i1, script);
+            change newChange;
+            newChange.line0 = i0;
+            newChange.line1 = i1;
+            newChange.deleted = line0 - i0;
+            newChange.inserted = line1 - i1;
+            script.push_back(newChange);
         }
 
         /* We have reached lines in the two files that match each other.  */
         i0--, i1--;
     }
 
-    return script;
+    /* The scan went backwards.  */
+    std::reverse(script.begin(), script.end());
 }
 
 /* Report the differences of two files.  */
-GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
+void GnuDiff::diff_2_files(comparison *cmp, std::vector<change> &script)
 {
     GNULineRef diags;
     int f;
-    change *script;
 
     read_files(cmp->file, files_can_be_treated_as_binary);
 
@@ -779,7 +781,9 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
      Allocate an extra element, always 0, at each end of each vector.  */
 
         size_t s = cmp->file[0].buffered_lines + cmp->file[1].buffered_lines + 4;
-        bool *flag_space = (bool *)zalloc(s * sizeof(*flag_space));
+        size_t flags_capacity;
+        bool *flag_space = (bool *)take_scratch(SCRATCH_FLAGS, s * sizeof(*flag_space), &flags_capacity);
+        memset(flag_space, 0, s * sizeof(*flag_space));
         cmp->file[0].changed = flag_space + 1;
         cmp->file[1].changed = flag_space + cmp->file[0].buffered_lines + 3;
 
@@ -795,7 +799,8 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         xvec = cmp->file[0].undiscarded;
         yvec = cmp->file[1].undiscarded;
         diags = (cmp->file[0].nondiscarded_lines + cmp->file[1].nondiscarded_lines + 3);
-        fdiag = (GNULineRef *)xmalloc(diags * (2 * sizeof(*fdiag)));
+        size_t diags_capacity;
+        fdiag = (GNULineRef *)take_scratch(SCRATCH_DIAGS, diags * (2 * sizeof(*fdiag)), &diags_capacity);
         bdiag = fdiag + diags;
         fdiag += cmp->file[1].nondiscarded_lines + 1;
         bdiag += cmp->file[1].nondiscarded_lines + 1;
@@ -806,28 +811,31 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         for(; diags != 0; diags >>= 2)
             too_expensive <<= 1;
         too_expensive = std::max((GNULineRef)256, too_expensive);
+        deadline_passed.store(deadline.hasExpired(), std::memory_order_relaxed);
 
         files[0] = cmp->file[0];
         files[1] = cmp->file[1];
 
         compareseq(0, cmp->file[0].nondiscarded_lines,
-                   0, cmp->file[1].nondiscarded_lines, minimal);
+                   0, cmp->file[1].nondiscarded_lines, minimal, fdiag, bdiag);
 
-        free(fdiag - (cmp->file[1].nondiscarded_lines + 1));
+        give_scratch(SCRATCH_DIAGS, fdiag - (cmp->file[1].nondiscarded_lines + 1), diags_capacity);
+        fdiag = bdiag = nullptr;
+        xvec = yvec = nullptr;
 
         /* Modify the results slightly to make them prettier
      in cases where that can validly be done.  */
 
         shift_boundaries(cmp->file);
 
-        /* Get the results of comparison in the form of a chain
+        /* Get the results of comparison in the form of a vector
          of `change's -- an edit script.  */
 
-        script = build_script(cmp->file);
+        build_script(cmp->file, script);
 
         free(cmp->file[0].undiscarded);
 
-        free(flag_space);
+        give_scratch(SCRATCH_FLAGS, flag_space, flags_capacity);
 
         for(f = 0; f < 2; ++f)
         {
@@ -835,6 +843,4 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
             free(cmp->file[f].linbuf + cmp->file[f].linbuf_base);
         }
     }
-
-    return script;
 }
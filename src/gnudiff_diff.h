@@ -26,14 +26,17 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <atomic>
 #include <ctype.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <type_traits>
+#include <vector>
 
 #include <stdio.h>
 
+#include <QDeadlineTimer>
 #include <QString>
 
 /* The integer type of a line number. */
@@ -42,17 +45,19 @@ typedef qint64 GNULineRef;
 static_assert(std::is_signed<GNULineRef>::value, "GNULineRef must be signed.");
 static_assert(sizeof(GNULineRef) >= sizeof(size_t), "GNULineRef must be able to receive size_t values.");
 
+class LineData;
+
 class GnuDiff
 {
   public:
     /* Variables for command line options */
 
     /* Nonzero if output cannot be generated for identical files.  */
-    bool no_diff_means_no_output;
+    bool no_diff_means_no_output = false;
 
     /* Number of lines of context to show in each set of diffs.
    This is zero when context is not to be shown.  */
-    GNULineRef context;
+    GNULineRef context = 0;
 
     /* The significance of white space during comparisons.  */
     enum
@@ -68,28 +73,41 @@ class GnuDiff
 
         /* Ignore all horizontal white space (-w).  */
         IGNORE_ALL_SPACE
-    } ignore_white_space;
+    } ignore_white_space = IGNORE_NO_WHITE_SPACE;
 
     /* Ignore changes that affect only numbers. (J. Eibl)  */
-    bool bIgnoreNumbers;
-    bool bIgnoreWhiteSpace;
+    bool bIgnoreNumbers = false;
+    bool bIgnoreWhiteSpace = false;
 
     /* Files can be compared byte-by-byte, as if they were binary.
    This depends on various options.  */
-    bool files_can_be_treated_as_binary;
+    bool files_can_be_treated_as_binary = false;
 
     /* Ignore differences in case of letters (-i).  */
-    bool ignore_case;
+    bool ignore_case = false;
 
     /* Use heuristics for better speed with large files with a small
    density of changes.  */
-    bool speed_large_files;
+    bool speed_large_files = false;
 
     /* Don't discard lines.  This makes things slower (sometimes much
    slower) but will find a guaranteed minimal set of changes.  */
-    bool minimal;
+    bool minimal = false;
+
+    /* Let the threads of the global thread pool take over halves of large
+   subproblems.  The result does not depend on it.  */
+    bool parallel = false;
+
+    /* Once this has expired, drop MINIMAL, use the heuristics of
+   SPEED_LARGE_FILES and the smallest TOO_EXPENSIVE for what is left.  The
+   result is still a valid script, only perhaps a longer one.  */
+    QDeadlineTimer deadline{QDeadlineTimer::Forever};
 
-    /* The result of comparison is an "edit script": a chain of `struct change'.
+    /* Whether the last diff_2_files ran into the deadline.  */
+    [[nodiscard]] bool deadlinePassed() const { return deadline_passed.load(std::memory_order_relaxed); }
+
+    /* The result of comparison is an "edit script": a vector of `struct change'
+   in forward order.
    Each `struct change' represents one place where some lines are deleted
    and some are inserted.
 
@@ -101,12 +119,10 @@ class GnuDiff
    which the insertion was done; vice versa for INSERTED and LINE1.  */
 
     struct change {
-        change *link; /* Previous or next edit command  */
         GNULineRef inserted; /* # lines of file 1 changed here.  */
         GNULineRef deleted;  /* # lines of file 0 changed here.  */
         GNULineRef line0;    /* Line number of 1st deleted line.  */
         GNULineRef line1;    /* Line number of 1st inserted line.  */
-        bool ignore;         /* Flag used in context.c.  */
     };
 
     /* Structures that describe the input files.  */
@@ -124,6 +140,11 @@ class GnuDiff
         /* Number of valid bytes now in the buffer.  */
         size_t buffered;
 
+        /* KDiff3: the lines in buffer, or null. With IGNORE_ALL_SPACE and without ignore_case
+       their line matching fingerprints are used as hashes instead of hashing each line again.  */
+        const LineData *lines;
+        GNULineRef line_count;
+
         /* Array of pointers to lines in the file.  */
         const QChar **linbuf;
 
@@ -186,7 +207,8 @@ class GnuDiff
     /* Declare various functions.  */
 
     /* analyze.c */
-    change *diff_2_files(comparison *);
+    /* SCRIPT is cleared first, its capacity is kept for the next comparison.  */
+    void diff_2_files(comparison *, std::vector<change> &script);
     /* io.c */
     bool read_files(file_data[], bool);
 
@@ -195,14 +217,66 @@ class GnuDiff
     void *zalloc(size_t);
 
   private:
+    /*
+        Everything below used to be file static in the original GNU sources.
+        Keeping it here makes each GnuDiff instance independent so that
+        several comparisons can run at the same time on different instances.
+    */
+
+    /* The type of a hash value.  */
+    typedef size_t hash_value;
+    static_assert(std::is_unsigned<hash_value>::value, "hash_value must be unsigned.");
+
+    /* Lines are put into equivalence classes of lines that match in lines_differ.
+   Each equivalence class is represented by one of these structures,
+   but only while the classes are being computed.
+   Afterward, each class is represented by a number.  */
+    struct equivclass {
+        GNULineRef next;   /* Next item in this bucket.  */
+        hash_value hash;   /* Hash of lines in this class.  */
+        const QChar *line; /* A line that fits this class.  */
+        size_t length;     /* That line's length, not counting its newline.  */
+    };
+
+    /* Hash-table: array of buckets, each being a chain of equivalence classes.
+   buckets[-1] is reserved for incomplete lines.  */
+    GNULineRef *buckets = nullptr;
+
+    /* Number of buckets in the hash table array, not counting buckets[-1].  */
+    size_t nbuckets = 0;
+
+    /* Array in which the equivalence classes are allocated.
+   The bucket-chains go through the elements in this array.
+   The number of an equivalence class is its index in this array.  */
+    equivclass *equivs_table = nullptr;
+
+    /* Index of first free element in the array `equivs_table'.  */
+    GNULineRef equivs_index = 0;
+
+    /* Number of elements allocated in the array `equivs_table'.  */
+    GNULineRef equivs_alloc = 0;
+
+    GNULineRef *xvec = nullptr, *yvec = nullptr; /* Vectors being compared. */
+    GNULineRef *fdiag = nullptr;                 /* Vector, indexed by diagonal, containing
+                   1 + the X coordinate of the point furthest
+                   along the given diagonal in the forward
+                   search of the edit matrix. */
+    GNULineRef *bdiag = nullptr;                 /* Vector, indexed by diagonal, containing
+                   the X coordinate of the point furthest
+                   along the given diagonal in the backward
+                   search of the edit matrix. */
+    GNULineRef too_expensive = 0;                /* Edit scripts longer than this are too
+                   expensive to compute.  */
+    mutable std::atomic<bool> deadline_passed{false}; /* Set by diag once the deadline expired.  */
+
     // gnudiff_analyze.cpp
-    GNULineRef diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal, struct partition *part) const;
-    void compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal);
+    GNULineRef diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal, struct partition *part,
+                    GNULineRef *fd, GNULineRef *bd) const;
+    void compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal,
+                    GNULineRef *fd, GNULineRef *bd);
     void discard_confusing_lines(file_data filevec[]);
     void shift_boundaries(file_data filevec[]);
-    change *add_change(GNULineRef line0, GNULineRef line1, GNULineRef deleted, GNULineRef inserted, change *old);
-    change *build_reverse_script(file_data const filevec[]);
-    change *build_script(file_data const filevec[]);
+    void build_script(file_data const filevec[], std::vector<change> &script);
 
     // gnudiff_io.cpp
     GNULineRef guess_lines(GNULineRef n, size_t s, size_t t);
@@ -213,6 +287,23 @@ class GnuDiff
     void *xmalloc(size_t n);
     void *xrealloc(void *p, size_t n);
     void xalloc_die();
+
+    /* Tables that every comparison needs.  Each thread keeps the last block of
+   each kind, a folder analysis runs thousands of small comparisons that would
+   otherwise allocate and free the same tables each time.  */
+    enum scratch_kind {
+        SCRATCH_EQUIVS,
+        SCRATCH_BUCKETS,
+        SCRATCH_FLAGS,
+        SCRATCH_DIAGS,
+        SCRATCH_KINDS
+    };
+    /* Returns at least N bytes of undefined content, *CAPACITY is set to the real size.  */
+    void *take_scratch(scratch_kind kind, size_t n, size_t *capacity);
+    /* Gives back a block returned by take_scratch, possibly reallocated meanwhile.  */
+    void give_scratch(scratch_kind kind, void *p, size_t capacity);
+    struct scratch_block;
+    static scratch_block &scratch(scratch_kind kind);
 }; // class GnuDiff
 
 #endif
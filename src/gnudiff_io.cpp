@@ -15,10 +15,12 @@
 
 #include "gnudiff_diff.h"
 
+#include "diff.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <stdlib.h>
-#include <type_traits>
+#include <string.h>
 
 /* Rotate an unsigned value to the left.  */
 #define ROL(v, n) ((v) << (n) | (v) >> (sizeof(v) * CHAR_BIT - (n)))
@@ -26,38 +28,66 @@
 /* Given a hash value and a new character, return a new hash value.  */
 #define HASH(h, c) ((c) + ROL(h, 7))
 
-/* The type of a hash value.  */
-typedef size_t hash_value;
-static_assert(std::is_unsigned<hash_value>::value, "hash_value must be signed.");
+namespace {
+/*
+    Line hashing kernels. Each one hashes the line starting at p and returns its end, the
+    newline or bufend. Hash values only have to agree within one comparison so the kernels are
+    free to hash differently. One is picked per file instead of testing the options per character.
+*/
+typedef const QChar *(*HashLineKernel)(const QChar *p, const QChar *bufend, size_t &h);
 
-/* Lines are put into equivalence classes of lines that match in lines_differ.
-   Each equivalence class is represented by one of these structures,
-   but only while the classes are being computed.
-   Afterward, each class is represented by a number.  */
-struct equivclass {
-    GNULineRef next;   /* Next item in this bucket.  */
-    hash_value hash;   /* Hash of lines in this class.  */
-    const QChar *line; /* A line that fits this class.  */
-    size_t length;     /* That line's length, not counting its newline.  */
-};
+/* All characters count: find the newline first, then hash four UTF-16 units per step.  */
+const QChar *hashLineExact(const QChar *p, const QChar *bufend, size_t &h)
+{
+    const QChar *const lineEnd = std::find(p, bufend, QChar('\n'));
+    const size_t length = lineEnd - p;
+    const char *bytes = reinterpret_cast<const char *>(p);
 
-/* Hash-table: array of buckets, each being a chain of equivalence classes.
-   buckets[-1] is reserved for incomplete lines.  */
-static GNULineRef *buckets;
+    quint64 hash = 0x9E3779B97F4A7C15ULL ^ length;
+    size_t i = 0;
+    for(; i + 4 <= length; i += 4)
+    {
+        quint64 block;
+        memcpy(&block, bytes + i * sizeof(QChar), sizeof(block));
+        hash = (hash ^ block) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    for(; i < length; ++i)
+        hash = (hash ^ p[i].unicode()) * 0xC4CEB9FE1A85EC53ULL;
 
-/* Number of buckets in the hash table array, not counting buckets[-1].  */
-static size_t nbuckets;
+    h = (size_t)(hash ^ (hash >> 29));
+    return lineEnd;
+}
 
-/* Array in which the equivalence classes are allocated.
-   The bucket-chains go through the elements in this array.
-   The number of an equivalence class is its index in this array.  */
-static equivclass *equivs;
+template <bool bIgnoreCase, bool bIgnoreAllSpace, bool bIgnoreNumbers>
+const QChar *hashLineFiltered(const QChar *p, const QChar *bufend, size_t &h)
+{
+    QChar c;
+    h = 0;
+    while(p < bufend && !Utils::isEndOfLine(c = *p))
+    {
+        if(!bIgnoreAllSpace || !(isspace(c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
+            h = HASH(h, bIgnoreCase ? c.toLower().unicode() : c.unicode());
+        ++p;
+    }
+    return p;
+}
 
-/* Index of first free element in the array `equivs'.  */
-static GNULineRef equivs_index;
+HashLineKernel selectHashLineKernel(const bool bIgnoreCase, const bool bIgnoreAllSpace, const bool bIgnoreNumbers)
+{
+    // Numbers are only ignored together with white space, like before.
+    if(bIgnoreCase)
+    {
+        if(!bIgnoreAllSpace)
+            return hashLineFiltered<true, false, false>;
+        return bIgnoreNumbers ? hashLineFiltered<true, true, true> : hashLineFiltered<true, true, false>;
+    }
 
-/* Number of elements allocated in the array `equivs'.  */
-static GNULineRef equivs_alloc;
+    if(!bIgnoreAllSpace)
+        return hashLineExact;
+    return bIgnoreNumbers ? hashLineFiltered<false, true, true> : hashLineFiltered<false, true, false>;
+}
+} // namespace
 
 /* Check for binary files and compare them for exact identity.  */
 
@@ -128,7 +158,6 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
 {
     hash_value h;
     const QChar *p = current->prefix_end;
-    QChar c;
     GNULineRef i, *bucket;
     size_t length;
 
@@ -138,7 +167,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
     GNULineRef line = 0;
     GNULineRef linbuf_base = current->linbuf_base;
     GNULineRef *cureqs = (GNULineRef *)xmalloc(alloc_lines * sizeof(*cureqs));
-    equivclass *eqs = equivs;
+    equivclass *eqs = equivs_table;
     GNULineRef eqs_index = equivs_index;
     GNULineRef eqs_alloc = equivs_alloc;
     const QChar *suffix_begin = current->suffix_begin;
@@ -147,57 +176,35 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
         ignore_white_space != IGNORE_NO_WHITE_SPACE || bIgnoreNumbers;
     bool same_length_diff_contents_compare_anyway =
         diff_length_compare_anyway | ignore_case;
+    const HashLineKernel hashLine = selectHashLineKernel(ignore_case, ignore_white_space == IGNORE_ALL_SPACE, bIgnoreNumbers);
+    // The fingerprints were made with the same rule as hashLineFiltered<false, true, bIgnoreNumbers>.
+    const LineData *fingerprintLines = !ignore_case && ignore_white_space == IGNORE_ALL_SPACE ? current->lines : nullptr;
+    const GNULineRef firstLine = current->prefix_lines;
 
     while(p < suffix_begin)
     {
         const QChar *ip = p;
+        const GNULineRef lineIndex = firstLine + line;
 
-        h = 0;
-
-        /* Hash this line until we find a newline or bufend is reached.  */
-        if(ignore_case)
-            switch(ignore_white_space)
-            {
-                case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        if(!(isspace(c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
-                            h = HASH(h, c.toLower().unicode());
-                        ++p;
-                    }
-                    break;
-
-                default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        h = HASH(h, c.toLower().unicode());
-                        ++p;
-                    }
-                    break;
-            }
+        if(fingerprintLines != nullptr && lineIndex < current->line_count)
+        {
+            p = std::find(p, bufend, QChar('\n'));
+            length = p - ip;
+            const LineData &lineData = fingerprintLines[lineIndex];
+            assert((size_t)lineData.size() == length);
+            if((size_t)lineData.size() == length && lineData.getBuffer()->constData() + lineData.getOffset() == ip)
+                h = lineData.lineMatchFingerprint(bIgnoreNumbers);
+            else
+                hashLine(ip, bufend, h);
+        }
         else
-            switch(ignore_white_space)
-            {
-                case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        if(!(isspace(c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == '-' || c == '.'))))
-                            h = HASH(h, c.unicode());
-                        ++p;
-                    }
-                    break;
-
-                default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        h = HASH(h, c.unicode());
-                        ++p;
-                    }
-                    break;
-            }
+        {
+            /* Hash this line until we find a newline or bufend is reached.  */
+            p = hashLine(p, bufend, h);
+            length = p - ip;
+        }
 
         bucket = &buckets[h % nbuckets];
-        length = p - ip;
         ++p;
 
         for(i = *bucket;; i = eqs[i].next)
@@ -297,7 +304,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
     current->valid_lines = line;
     current->alloc_lines = alloc_lines;
     current->equivs = cureqs;
-    equivs = eqs;
+    equivs_table = eqs;
     equivs_alloc = eqs_alloc;
     equivs_index = eqs_index;
 }
@@ -510,9 +517,11 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
     find_identical_ends(filevec);
 
     equivs_alloc = filevec[0].alloc_lines + filevec[1].alloc_lines + 1;
-    if((GNULineRef)(GNULINEREF_MAX / sizeof(*equivs)) <= equivs_alloc)
+    if((GNULineRef)(GNULINEREF_MAX / sizeof(*equivs_table)) <= equivs_alloc)
         xalloc_die();
-    equivs = (equivclass *)xmalloc(equivs_alloc * sizeof(*equivs));
+    size_t capacity;
+    equivs_table = (equivclass *)take_scratch(SCRATCH_EQUIVS, equivs_alloc * sizeof(*equivs_table), &capacity);
+    equivs_alloc = capacity / sizeof(*equivs_table);
     /* Equivalence class 0 is permanently safe for lines that were not
      hashed.  Real equivalence classes start at 1.  */
     equivs_index = 1;
@@ -525,7 +534,9 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
     nbuckets = ((GNULineRef)1 << i) - prime_offset[i];
     if(GNULINEREF_MAX / sizeof(*buckets) <= nbuckets)
         xalloc_die();
-    buckets = (GNULineRef *)zalloc((nbuckets + 1) * sizeof(*buckets));
+    size_t buckets_capacity;
+    buckets = (GNULineRef *)take_scratch(SCRATCH_BUCKETS, (nbuckets + 1) * sizeof(*buckets), &buckets_capacity);
+    memset(buckets, 0, (nbuckets + 1) * sizeof(*buckets));
     buckets++;
 
     for(i = 0; i < 2; ++i)
@@ -533,8 +544,11 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
 
     filevec[0].equiv_max = filevec[1].equiv_max = equivs_index;
 
-    free(equivs);
-    free(buckets - 1);
+    /* find_and_hash_each_line may have grown the table.  */
+    give_scratch(SCRATCH_EQUIVS, equivs_table, equivs_alloc * sizeof(*equivs_table));
+    give_scratch(SCRATCH_BUCKETS, buckets - 1, buckets_capacity);
+    equivs_table = nullptr;
+    buckets = nullptr;
 
     return false;
 }
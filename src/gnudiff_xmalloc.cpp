@@ -22,6 +22,20 @@
 #endif
 
 #include "gnudiff_diff.h"
+
+#include <array>
+
+/* Blocks larger than this are freed instead of kept, one huge comparison
+   should not hold on to its memory.  */
+static constexpr size_t maxKeptScratch = 4 * 1024 * 1024;
+
+struct GnuDiff::scratch_block {
+    void *p = nullptr;
+    size_t capacity = 0;
+
+    ~scratch_block() { free(p); }
+};
+
 /* If non NULL, call this function when memory is exhausted. */
 void (*xalloc_fail_func)() = nullptr;
 
@@ -70,3 +84,44 @@ GnuDiff::zalloc(size_t size)
     memset(p, 0, size);
     return p;
 }
+
+GnuDiff::scratch_block &
+GnuDiff::scratch(scratch_kind kind)
+{
+    static thread_local std::array<scratch_block, SCRATCH_KINDS> blocks;
+    return blocks[kind];
+}
+
+void *
+GnuDiff::take_scratch(scratch_kind kind, size_t n, size_t *capacity)
+{
+    scratch_block &block = scratch(kind);
+    void *p = block.p;
+    *capacity = block.capacity;
+    block.p = nullptr;
+    block.capacity = 0;
+
+    if(*capacity < n)
+    {
+        /* The old content is of no use, so don't let realloc copy it.  */
+        free(p);
+        p = xmalloc(n);
+        *capacity = n;
+    }
+    return p;
+}
+
+void
+GnuDiff::give_scratch(scratch_kind kind, void *p, size_t capacity)
+{
+    if(capacity > maxKeptScratch)
+    {
+        free(p);
+        return;
+    }
+
+    scratch_block &block = scratch(kind);
+    free(block.p);
+    block.p = p;
+    block.capacity = capacity;
+}
@@ -21,10 +21,10 @@
 #include "mergeresultwindow.h"
 #include "optiondialog.h"
 #include "progress.h"
-#include "RLPainter.h"
 #include "smalldialogs.h"
 #include "Utils.h"
 // Standard c/c++ includes
+#include <atomic>
 #include <memory>
 #ifndef Q_OS_WIN
 #include <unistd.h>
@@ -45,12 +45,11 @@
 #include <QLineEdit>
 #include <QMenu>
 #include <QMenuBar>
-#include <QPaintDevice>
-#include <QPainter>
 #include <QPointer>
 #include <QPrintDialog>
 #include <QPrinter>
 #include <QPushButton>
+#include <QScopedValueRollback>
 #include <QShortcut>
 #include <QSplitter>
 #include <QStatusBar>
@@ -70,6 +69,7 @@
 bool KDiff3App::m_bTripleDiff = false;
 
 boost::signals2::signal<QString(), FirstNonEmpty<QString>> KDiff3App::getSelection;
+boost::signals2::signal<SelectionText(), FirstNonEmpty<SelectionText>> KDiff3App::getSelectionText;
 boost::signals2::signal<bool(), or> KDiff3App::allowCopy;
 boost::signals2::signal<bool(), or> KDiff3App::allowCut;
 
@@ -148,13 +148,12 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Shell* pKDiff3
     }
 
     // All default values must be set before calling readOptions().
-    m_pOptionDialog = new OptionDialog(m_pKDiff3Shell != nullptr, this);
-    chk_connect_a(m_pOptionDialog, &OptionDialog::applyDone, this, &KDiff3App::slotRefresh);
+    // The option dialog itself is only built when it is first shown, see slotConfigure.
+    m_pOptions = QSharedPointer<Options>::create();
+    m_pOptions->init();
+    m_pOptions->initSettings();
 
-    // This is just a convenience variable to make code that accesses options more readable
-    m_pOptions = m_pOptionDialog->getOptions();
-
-    m_pOptionDialog->readOptions(KSharedConfig::openConfig());
+    m_pOptions->readOptions(KSharedConfig::openConfig());
 
     // Option handling: Only when pParent==0 (no parent)
     int argCount = KDiff3Shell::getParser()->optionNames().count() + KDiff3Shell::getParser()->positionalArguments().count();
@@ -165,12 +164,12 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Shell* pKDiff3
         QString title;
         if(KDiff3Shell::getParser()->isSet("confighelp"))
         {
-            s = m_pOptionDialog->calcOptionHelp();
+            s = m_pOptions->calcOptionHelp();
             title = i18n("Current Configuration:");
         }
         else
         {
-            s = m_pOptionDialog->parseOptions(KDiff3Shell::getParser()->values("cs"));
+            s = m_pOptions->parseOptions(KDiff3Shell::getParser()->values("cs"));
             title = i18n("Config Option Error:");
         }
         if(!s.isEmpty())
@@ -235,6 +234,8 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Shell* pKDiff3
             m_bAutoMode = false;
         }
 
+        m_paintBenchmarkFilename = KDiff3Shell::getParser()->value("paint-benchmark");
+
         if(m_outputFilename.isEmpty() && KDiff3Shell::getParser()->isSet("merge"))
         {
             m_outputFilename = "unnamed.txt";
@@ -358,6 +359,17 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Shell* pKDiff3
     chk_connect_q(this, &KDiff3App::sigRecalcWordWrap, this, &KDiff3App::slotRecalcWordWrap);
     chk_connect_a(this, &KDiff3App::finishDrop, this, &KDiff3App::slotFinishDrop);
 
+    mFineDiffTimer.setSingleShot(true);
+    chk_connect_a(&mFineDiffTimer, &QTimer::timeout, this, &KDiff3App::slotCalcPendingFineDiffs);
+    mProgressiveLoadTimer.setInterval(200);
+    chk_connect_a(&mProgressiveLoadTimer, &QTimer::timeout, this, &KDiff3App::slotCheckProgressiveLoad);
+    mResizeWordWrapTimer.setSingleShot(true);
+    mResizeWordWrapTimer.setInterval(50);
+    chk_connect_a(&mResizeWordWrapTimer, &QTimer::timeout, this, &KDiff3App::postRecalcWordWrap);
+    mAvailabilitiesTimer.setSingleShot(true);
+    mAvailabilitiesTimer.setInterval(0);
+    chk_connect_a(&mAvailabilitiesTimer, &QTimer::timeout, this, &KDiff3App::recalcAvailabilities);
+
     connections.push_back(allowCut.connect(boost::bind(&KDiff3App::canCut, this)));
     connections.push_back(allowCopy.connect(boost::bind(&KDiff3App::canCopy, this)));
 
@@ -526,7 +538,7 @@ void KDiff3App::completeInit(const QString& fn1, const QString& fn2, const QStri
             }
             if(bSuccess)
             {
-                QMetaObject::invokeMethod(qApp, &QApplication::quit, Qt::QueuedConnection);
+                QMetaObject::invokeMethod(this, [this]() { quit(0); }, Qt::QueuedConnection);
             }
         }
     }
@@ -582,6 +594,9 @@ KDiff3App::~KDiff3App()
 {
     // Prevent spurious focus change signals from Qt from being picked up by KDiff3App during destruction.
     QObject::disconnect(qApp, &QApplication::focusChanged, this, &KDiff3App::slotFocusChanged);
+    // A running refinement reports back to this object.
+    mpDiffRefinements->cancel();
+    mpDiffRefinements->wait();
 };
 
 /**
@@ -599,6 +614,11 @@ void KDiff3App::initActions(KActionCollection* ac)
     fileOpen->setStatusTip(i18n("Opens documents for comparison..."));
 
     fileReload = GuiUtils::createAction<QAction>(i18n("Reload"), QKeySequence(QKeySequence::Refresh), this, &KDiff3App::slotReload, ac, u8"file_reload");
+    fileSaveSnapshot = GuiUtils::createAction<QAction>(i18n("Save Comparison Snapshot..."), this, &KDiff3App::slotSaveSnapshot, ac, u8"file_save_snapshot");
+    fileSaveSnapshot->setStatusTip(i18n("Saves the loaded inputs and their line matching so the comparison opens again at once"));
+    fileOpenSnapshot = GuiUtils::createAction<QAction>(i18n("Open Comparison Snapshot..."), this, &KDiff3App::slotOpenSnapshot, ac, u8"file_open_snapshot");
+    fileWritePatch = GuiUtils::createAction<QAction>(i18n("Write Patch..."), this, &KDiff3App::slotWritePatch, ac, u8"file_write_patch");
+    fileWritePatch->setStatusTip(i18n("Writes the differences of A and B as unified diff, or the merge of three files with conflict markers"));
 
     fileSave = KStandardAction::save(this, &KDiff3App::slotFileSave, ac);
     fileSave->setStatusTip(i18n("Saves the merge result. All conflicts must be solved!"));
@@ -607,6 +627,8 @@ void KDiff3App::initActions(KActionCollection* ac)
 #ifndef QT_NO_PRINTER
     filePrint = KStandardAction::print(this, &KDiff3App::slotFilePrint, ac);
     filePrint->setStatusTip(i18n("Print the differences"));
+    fileExportPdf = GuiUtils::createAction<QAction>(i18n("Export to PDF..."), this, &KDiff3App::slotFileExportPdf, ac, u8"file_export_pdf");
+    fileExportPdf->setStatusTip(i18n("Writes the differences to a PDF file, laid out like the printed pages"));
 #endif
     fileQuit = KStandardAction::quit(this, &KDiff3App::slotFileQuit, ac);
     fileQuit->setStatusTip(i18n("Quits the application"));
@@ -706,6 +728,8 @@ void KDiff3App::initActions(KActionCollection* ac)
     overviewModeAC = GuiUtils::createAction<KToggleAction>(i18n("A vs. C Overview"), this, &KDiff3App::slotOverviewAC, ac, "diff_overview_ac");
     overviewModeBC = GuiUtils::createAction<KToggleAction>(i18n("B vs. C Overview"), this, &KDiff3App::slotOverviewBC, ac, "diff_overview_bc");
     wordWrap = GuiUtils::createAction<KToggleAction>(i18n("Word Wrap Diff Windows"), this, &KDiff3App::slotWordWrapToggled, ac, "diff_wordwrap");
+    mShowStatistics = GuiUtils::createAction<QAction>(i18n("Statistics..."), this, &KDiff3App::slotShowStatistics, ac, "diff_statistics");
+    mShowBinaryComparison = GuiUtils::createAction<QAction>(i18n("Binary Comparison..."), this, &KDiff3App::slotShowBinaryComparison, ac, "diff_binary_comparison");
     addManualDiffHelp = GuiUtils::createAction<QAction>(i18n("Add Manual Diff Alignment"), QKeySequence(Qt::CTRL + Qt::Key_Y), this, &KDiff3App::slotAddManualDiffHelp, ac, "diff_add_manual_diff_help");
     clearManualDiffHelpList = GuiUtils::createAction<QAction>(i18n("Clear All Manual Diff Alignments"), QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_Y), this, &KDiff3App::slotClearManualDiffHelpList, ac, "diff_clear_manual_diff_help_list");
 
@@ -772,7 +796,7 @@ void KDiff3App::saveOptions(KSharedConfigPtr config)
     if(!m_bAutoMode)
     {
         saveWindow(config);
-        m_pOptionDialog->saveOptions(std::move(config));
+        m_pOptions->saveOptions(std::move(config));
     }
 }
 
@@ -904,216 +928,110 @@ void KDiff3App::slotFilePrint()
     //printDialog.setMinMax(0,0);
     printDialog->setFromTo(0, 0);
 
-    int currentFirstLine = m_pDiffTextWindow1->getFirstLine();
-    int currentFirstD3LIdx = m_pDiffTextWindow1->convertLineToDiff3LineIdx(currentFirstLine);
-
     // do some printer initialization
     printer.setFullPage(false);
 
     // initialize the printer using the print dialog
-    if(printDialog->exec() == QDialog::Accepted)
+    if(printDialog->exec() != QDialog::Accepted)
     {
-        slotStatusMsg(i18n("Printing..."));
-        //TODO: Drop RLPainter. How?
-        // create a painter to paint on the printer object
-        RLPainter painter(&printer, m_pOptions->m_bRightToLeftLanguage, width(), Utils::getHorizontalAdvance(fontMetrics(), 'W'));
-
-        QPaintDevice* pPaintDevice = painter.device();
-        int dpiy = pPaintDevice->logicalDpiY();
-        int columnDistance = qRound((0.5 / 2.54) * dpiy); // 0.5 cm between the columns
-
-        int columns = m_bTripleDiff ? 3 : 2;
-        int columnWidth = (pPaintDevice->width() - (columns - 1) * columnDistance) / columns;
-
-        QFont f = m_pOptions->defaultFont();
-        f.setPointSizeF(f.pointSizeF() - 1); // Print with slightly smaller font.
-        painter.setFont(f);
-        QFontMetrics fm = painter.fontMetrics();
-
-        QString topLineText = i18n("Top line");
-
-        //int headerWidth = fm.width( m_sd1->getAliasName() + ", "+topLineText+": 01234567" );
-        int headerLines = Utils::getHorizontalAdvance(fm, m_sd1->getAliasName() + ", " + topLineText + ": 01234567") / columnWidth + 1;
-
-        int headerMargin = headerLines * fm.height() + 3; // Text + one horizontal line
-        int footerMargin = fm.height() + 3;
-
-        QRect view(0, headerMargin, pPaintDevice->width(), pPaintDevice->height() - (headerMargin + footerMargin));
-        QRect view1(0 * (columnWidth + columnDistance), view.top(), columnWidth, view.height());
-        QRect view2(1 * (columnWidth + columnDistance), view.top(), columnWidth, view.height());
-        QRect view3(2 * (columnWidth + columnDistance), view.top(), columnWidth, view.height());
-
-        LineType linesPerPage = view.height() / fm.lineSpacing();
-
-        m_pEventLoopForPrinting = QPointer<QEventLoop>(new QEventLoop());
-        if(m_pOptions->wordWrapOn())
-        {
-            // For printing the lines are wrapped differently (this invalidates the first line)
-            recalcWordWrap(columnWidth);
-            m_pEventLoopForPrinting->exec();
-        }
-
-        LineType totalNofLines = std::max(m_pDiffTextWindow1->getNofLines(), m_pDiffTextWindow2->getNofLines());
-
-        if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
-            totalNofLines = std::max(totalNofLines, m_pDiffTextWindow3->getNofLines());
-
-        QList<quint32> pageList; // = printer.pageList();
-
-        bool bPrintCurrentPage = false;
-        bool bFirstPrintedPage = false;
-
-        bool bPrintSelection = false;
-        quint32 totalNofPages = (totalNofLines + linesPerPage - 1) / linesPerPage;
-        LineRef line;
-        LineRef selectionEndLine;
-
-        if(printer.printRange() == QPrinter::AllPages)
-        {
-            pageList.clear();
-            for(quint32 i = 0; i < totalNofPages; ++i)
-            {
-                pageList.push_back(i + 1);
-            }
-        }
-        else if(printer.printRange() == QPrinter::PageRange)
-        {
-            pageList.clear();
-
-            quint32 from = printer.fromPage(), to = printer.toPage();
-            /*
-                Per Qt docs QPrinter::fromPage and QPrinter::toPage return 0 to indicate they are not set.
-                Account for this and other invalid settings the user may try.
-            */
-            if(from == 0) from = 1;
-            if(from > totalNofPages) from = totalNofPages;
-            if(to == 0 || to > totalNofPages) to = totalNofPages;
-            if(from > to) to = from;
-
-            for(quint32 i = from; i <= to; ++i)
-            {
-                pageList.push_back(i);
-            }
-        }
-        else if(printer.printRange() == QPrinter::CurrentPage)
-        {
-            bPrintCurrentPage = true;
-            totalNofPages = 1;
-        }
-        else if(printer.printRange() == QPrinter::Selection)
-        {
-            bPrintSelection = true;
-            if(firstSelectionD3LIdx.isValid())
-            {
-                line = m_pDiffTextWindow1->convertDiff3LineIdxToLine(firstSelectionD3LIdx);
-                selectionEndLine = m_pDiffTextWindow1->convertDiff3LineIdxToLine(lastSelectionD3LIdx + 1);
-                totalNofPages = (selectionEndLine - line + linesPerPage - 1) / linesPerPage;
-            }
-        }
-
-        int page = 1;
-
-        ProgressProxy pp;
-        pp.setMaxNofSteps(totalNofPages);
-        QList<quint32>::iterator pageListIt = pageList.begin();
-        for(;;)
-        {
-            pp.setInformation(i18nc("Status message", "Printing page %1 of %2", page, totalNofPages), false);
-            pp.setCurrent(page - 1);
-            if(pp.wasCancelled())
-            {
-                printer.abort();
-                break;
-            }
-            if(!bPrintSelection)
-            {
-                if(pageListIt == pageList.end())
-                    break;
-                page = *pageListIt;
-                line = (page - 1) * linesPerPage;
-
-                if(bPrintCurrentPage)
-                {
-                    // Detect the first visible line in the window.
-                    line = m_pDiffTextWindow1->convertDiff3LineIdxToLine(currentFirstD3LIdx);
-                }
-            }
-            else
-            {
-                if(line >= selectionEndLine)
-                {
-                    break;
-                }
-                else
-                {
-                    if(selectionEndLine - line < linesPerPage)
-                        linesPerPage = selectionEndLine - line;
-                }
-            }
-            if(line.isValid() && line < totalNofLines)
-            {
-                if(bFirstPrintedPage)
-                    printer.newPage();
-
-                painter.setClipping(true);
-
-                painter.setPen(m_pOptions->aColor());
-                QString headerText1 = m_sd1->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow1->calcTopLineInFile(line) + 1);
-                m_pDiffTextWindow1->printWindow(painter, view1, headerText1, line, linesPerPage, m_pOptions->foregroundColor());
+        slotStatusMsg(i18n("Printing aborted."));
+        return;
+    }
 
-                painter.setPen(m_pOptions->bColor());
-                QString headerText2 = m_sd2->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow2->calcTopLineInFile(line) + 1);
-                m_pDiffTextWindow2->printWindow(painter, view2, headerText2, line, linesPerPage, m_pOptions->foregroundColor());
+    DiffPrinter::Range range;
+    range.endD3L = (LineType)mDiff3LineVector.size();
+    if(printer.printRange() == QPrinter::PageRange)
+    {
+        range.fromPage = printer.fromPage();
+        range.toPage = printer.toPage();
+    }
+    else if(printer.printRange() == QPrinter::CurrentPage)
+    {
+        // Starts with the first visible line in the window.
+        range.firstD3L = m_pDiffTextWindow1->convertLineToDiff3LineIdx(m_pDiffTextWindow1->getFirstLine());
+        range.bCurrentPage = true;
+    }
+    else if(printer.printRange() == QPrinter::Selection && firstSelectionD3LIdx.isValid())
+    {
+        range.firstD3L = firstSelectionD3LIdx;
+        range.endD3L = lastSelectionD3LIdx + 1;
+        range.bSelection = true;
+    }
 
-                if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
-                {
-                    painter.setPen(m_pOptions->cColor());
-                    QString headerText3 = m_sd3->getAliasName() + ", " + topLineText + ": " + QString::number(m_pDiffTextWindow3->calcTopLineInFile(line) + 1);
-                    m_pDiffTextWindow3->printWindow(painter, view3, headerText3, line, linesPerPage, m_pOptions->foregroundColor());
-                }
-                painter.setClipping(false);
-
-                painter.setPen(m_pOptions->foregroundColor());
-                painter.drawLine(0, view.bottom() + 3, view.width(), view.bottom() + 3);
-                QString s = bPrintCurrentPage ? QString("")
-                                              : QString::number(page) + '/' + QString::number(totalNofPages);
-                if(bPrintSelection) s += i18n(" (Selection)");
-                painter.drawText((view.right() - Utils::getHorizontalAdvance(painter.fontMetrics(), s)) / 2,
-                                 view.bottom() + painter.fontMetrics().ascent() + 5, s);
-
-                bFirstPrintedPage = true;
-                if(bPrintCurrentPage) break;
-            }
+    slotStatusMsg(i18n("Printing..."));
+    if(printComparison(printer, range))
+        slotStatusMsg(i18n("Printing completed."));
+    else
+        slotStatusMsg(i18n("Printing aborted."));
+#endif
+}
 
-            if(bPrintSelection)
-            {
-                line += linesPerPage;
-                ++page;
-            }
-            else
-            {
-                ++pageListIt;
-            }
-        }
+void KDiff3App::slotFileExportPdf()
+{
+    if(m_pDiffTextWindow1 == nullptr || m_pDiffTextWindow2 == nullptr)
+        return;
+#ifdef QT_NO_PRINTER
+    slotStatusMsg(i18n("Printing not implemented."));
+#else
+    const QString fileName = QFileDialog::getSaveFileName(this, i18n("Export to PDF"), QString(), i18n("PDF Files (*.pdf)"));
+    if(fileName.isEmpty())
+        return;
 
-        painter.end();
+    QPrinter printer(QPrinter::HighResolution);
+    printer.setOutputFormat(QPrinter::PdfFormat);
+    printer.setOutputFileName(fileName);
 
-        if(m_pOptions->wordWrapOn())
-        {
-            recalcWordWrap();
-            m_pEventLoopForPrinting->exec();
-            DiffTextWindow::mVScrollBar->setValue(m_pDiffTextWindow1->convertDiff3LineIdxToLine(currentFirstD3LIdx));
-        }
-        m_pEventLoopForPrinting.clear();
+    DiffPrinter::Range range;
+    range.endD3L = (LineType)mDiff3LineVector.size();
 
-        slotStatusMsg(i18n("Printing completed."));
+    slotStatusMsg(i18n("Exporting..."));
+    if(printComparison(printer, range))
+        slotStatusMsg(i18n("Exported to %1.", fileName));
+    else if(printer.printerState() == QPrinter::Error)
+    {
+        slotStatusMsg(QString());
+        KMessageBox::error(this, i18n("Writing %1 failed.", fileName));
     }
     else
+        slotStatusMsg(i18n("Exporting aborted."));
+#endif
+}
+
+#ifndef QT_NO_PRINTER
+/*
+    The pages are drawn by a worker while the progress dialog keeps the window responsive. The
+    diff windows are left alone, their lines get wrapped for the print columns by DiffPrinter.
+*/
+bool KDiff3App::printComparison(QPrinter& printer, const DiffPrinter::Range& range)
+{
+    std::vector<DiffPrinter::Input> inputs{{e_SrcSelector::A, m_sd1->getAliasName(), m_sd1->getLineDataForDisplay()},
+                                           {e_SrcSelector::B, m_sd2->getAliasName(), m_sd2->getLineDataForDisplay()}};
+    if(m_bTripleDiff && m_pDiffTextWindow3 != nullptr)
+        inputs.push_back({e_SrcSelector::C, m_sd3->getAliasName(), m_sd3->getLineDataForDisplay()});
+
+    // The line matching mustn't be replaced below the worker, see finishDiffRefinement().
+    const QScopedValueRollback<bool> printing(mbPrinting, true);
+    DiffPrinter diffPrinter(m_pOptions, mDiff3LineVector, m_bTripleDiff, inputs);
+    std::atomic<bool> bCancel(false);
+    bool bCompleted = false;
+    const std::shared_ptr<TaskGroup> pGroup = std::make_shared<TaskGroup>();
+    TaskExecutor::instance().start([&diffPrinter, &printer, &range, &bCancel, &bCompleted]() {
+        bCompleted = diffPrinter.print(printer, range, bCancel);
+    }, TaskExecutor::Priority::interactive, pGroup);
+
+    ProgressProxy pp;
+    pp.setMaxNofSteps((quint64)std::max<LineType>(1, range.endD3L - range.firstD3L));
+    while(!pGroup->wait(100))
     {
-        slotStatusMsg(i18n("Printing aborted."));
+        if(diffPrinter.currentPage() > 0)
+            pp.setInformation(i18nc("Status message", "Printing page %1 of %2", diffPrinter.currentPage(), diffPrinter.nofPages()), false);
+        pp.setCurrent((quint64)diffPrinter.linesDone(), false);
+        if(pp.wasCancelled())
+            bCancel = true;
     }
-#endif
+    return bCompleted;
 }
+#endif
 
 void KDiff3App::slotFileQuit()
 {
@@ -1122,7 +1040,15 @@ void KDiff3App::slotFileQuit()
     if(!queryClose())
         return; // Don't quit
 
-    QApplication::exit(isFileSaved() || isDirComparison() ? 0 : 1);
+    quit(isFileSaved() || isDirComparison() ? 0 : 1);
+}
+
+void KDiff3App::quit(const int exitCode)
+{
+    if(m_pKDiff3Shell != nullptr)
+        m_pKDiff3Shell->finish(exitCode);
+    else
+        QApplication::exit(exitCode);
 }
 
 void KDiff3App::slotViewToolBar()
@@ -13,8 +13,13 @@
 
 #include "diff.h"
 #include "defmac.h"
+#include "DiffPrinter.h"
 #include "combiners.h"
+#include "SelectionText.h"
 #include "SourceData.h"
+#include "SourceDataPrefetcher.h"
+#include "Statistics.h"
+#include "TaskExecutor.h"
 #include "TypeUtils.h"
 
 #include <boost/signals2.hpp>
@@ -22,11 +27,11 @@
 // include files for Qt
 #include <QAction>
 #include <QApplication>
-#include <QEventLoop>
 #include <QPointer>
 #include <QScrollBar>
 #include <QSharedPointer>
 #include <QSplitter>
+#include <QTimer>
 
 // include files for KDE
 #include <KConfigGroup>
@@ -48,6 +53,8 @@ class DiffTextWindowFrame;
 class MergeResultWindow;
 class WindowTitleWidget;
 
+class QDialog;
+class QPrinter;
 class QStatusBar;
 class QMenu;
 
@@ -109,12 +116,40 @@ enum class InitFlag
     useCurrentEncoding = 2,
     autoSolve = 4,
     initGUI = 8,
+    keepUnchangedFiles = 16, // With loadFiles only read inputs that changed on disk.
     defaultFlags = loadFiles | autoSolve | initGUI
 };
 
 Q_DECLARE_FLAGS(InitFlags, InitFlag);
 Q_DECLARE_OPERATORS_FOR_FLAGS(InitFlags);
 
+/*
+    What the line matching of a pair of inputs was calculated from. As long as none of it
+    changes the DiffList doesn't need to be calculated again.
+*/
+struct DiffListOrigin
+{
+    bool bValid = false; // False if manual alignments were involved
+    quint64 generationX = 0;
+    quint64 generationY = 0;
+    int lineDiffAlgorithm = 0;
+    bool bTryHard = false;
+    bool bIgnoreNumbers = false;
+    bool bApproximate = false; // Cut short by the time budget, see KDiff3App::startDiffRefinement
+
+    [[nodiscard]] bool operator==(const DiffListOrigin& other) const
+    {
+        return bValid == other.bValid && hasSameInputs(other);
+    }
+
+    // Whether the data and options are the same, manual alignments aside.
+    [[nodiscard]] bool hasSameInputs(const DiffListOrigin& other) const
+    {
+        return generationX == other.generationX && generationY == other.generationY &&
+               lineDiffAlgorithm == other.lineDiffAlgorithm && bTryHard == other.bTryHard && bIgnoreNumbers == other.bIgnoreNumbers;
+    }
+};
+
 class KDiff3App: public QMainWindow
 {
     Q_OBJECT
@@ -158,6 +193,7 @@ class KDiff3App: public QMainWindow
     [[nodiscard]] KActionCollection* actionCollection() const;
 
     static boost::signals2::signal<QString (), FirstNonEmpty<QString>> getSelection;
+    static boost::signals2::signal<SelectionText (), FirstNonEmpty<SelectionText>> getSelectionText;
     static boost::signals2::signal<bool (), or> allowCopy;
     static boost::signals2::signal<bool (), or> allowCut;
 
@@ -204,6 +240,7 @@ public Q_SLOTS:
     void slotFileOpen();
     void slotFileOpen2(QStringList &errors, const QString& fn1, const QString& fn2, const QString& fn3, const QString& ofn,
                        const QString& an1, const QString& an2, const QString& an3, TotalDiffStatus* pTotalDiffStatus);
+    void slotPrefetchDiffMerge(const QString& fn1, const QString& fn2, const QString& fn3);
 
     void slotFileNameChanged(const QString& fileName, e_SrcSelector winIdx);
 
@@ -213,6 +250,7 @@ public Q_SLOTS:
     void slotFileSaveAs();
 
     void slotFilePrint();
+    void slotFileExportPdf();
 
     /** closes all open windows by calling close() on each memberList item until the list is empty, then quits the application.
      * If queryClose() returns false because the user canceled the saveModified() dialog, the closing breaks.
@@ -244,6 +282,7 @@ public Q_SLOTS:
     void resizeDiffTextWindowHeight(int newHeight);
     void slotRecalcWordWrap();
     void postRecalcWordWrap();
+    void slotResizeWidthChanged();
     void slotFinishRecalcWordWrap(int visibleTextWidth);
 
     void showPopupMenu(const QPoint& point);
@@ -255,6 +294,7 @@ public Q_SLOTS:
     void slotDirShowBoth();
     void slotDirViewToggle();
 
+    // Deferred, several requests in one pass of the event loop cause a single update.
     void slotUpdateAvailabilities();
     void slotEditSelectAll();
     void slotEditFind();
@@ -284,12 +324,19 @@ public Q_SLOTS:
     void slotClipboardChanged();
     void slotOutputModified(bool);
     void slotFinishMainInit();
+    void slotCalcPendingFineDiffs();
+    void slotCheckProgressiveLoad();
     void slotMergeCurrentFile();
     void slotReload();
+    void slotSaveSnapshot();
+    void slotWritePatch();
+    void slotOpenSnapshot();
     void slotShowWhiteSpaceToggled();
     void slotShowLineNumbersToggled();
     void slotAutoAdvanceToggled();
     void slotWordWrapToggled();
+    void slotShowStatistics();
+    void slotShowBinaryComparison();
     void slotShowWindowAToggled();
     void slotShowWindowBToggled();
     void slotShowWindowCToggled();
@@ -326,8 +373,37 @@ public Q_SLOTS:
     void initView();
 
   private:
+    // Scrolls, resizes and toggles word wrap for --paint-benchmark, then writes the report and quits.
+    void runPaintBenchmark();
+    // Takes the sizes of the current comparison for the statistics view.
+    void updateStatistics();
+    [[nodiscard]] qint64 lineDataMemoryUsage() const;
+    // Frees the fine diffs when the comparison takes more than the memory budget. Returns true if it did.
+    bool checkMemoryBudget();
+
+    // The complete line matching of a pair that ran out of the time budget, see startDiffRefinement.
+    struct DiffRefinement
+    {
+        DiffList* pDiffList;
+        DiffListOrigin* pOrigin;
+        DiffListOrigin origin;
+        std::shared_ptr<LineDataVector> p1;
+        std::shared_ptr<LineDataVector> p2;
+        LineType size1;
+        LineType size2;
+        DiffList result;
+    };
+    void startDiffRefinement();
+    void recalcAvailabilities();
+    // True if the inputs are large enough to show their beginning first, see slotCheckProgressiveLoad.
+    [[nodiscard]] bool useProgressiveLoad() const;
+    void finishDiffRefinement(const std::shared_ptr<std::vector<DiffRefinement>>& pRefinements);
+    // Returns false if printing failed or was cancelled.
+    bool printComparison(QPrinter& printer, const DiffPrinter::Range& range);
+
     void mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFlags = InitFlag::defaultFlags);
     void mainWindowEnable(bool bEnable);
+    void quit(const int exitCode);
     void wheelEvent(QWheelEvent* pWheelEvent) override;
     void keyPressEvent(QKeyEvent* event) override;
     void resizeEvent(QResizeEvent*) override;
@@ -352,8 +428,12 @@ public Q_SLOTS:
     QPointer<QAction> fileSave;
     QPointer<QAction> fileSaveAs;
     QPointer<QAction> filePrint;
+    QPointer<QAction> fileExportPdf;
     QPointer<QAction> fileQuit;
     QPointer<QAction> fileReload;
+    QPointer<QAction> fileSaveSnapshot;
+    QPointer<QAction> fileOpenSnapshot;
+    QPointer<QAction> fileWritePatch;
     QPointer<QAction> editUndo;
     QPointer<QAction> editCut;
     QPointer<QAction> editCopy;
@@ -383,6 +463,8 @@ public Q_SLOTS:
     KToggleAction* chooseC = nullptr;
     KToggleAction* autoAdvance = nullptr;
     KToggleAction* wordWrap = nullptr;
+    QAction* mShowStatistics = nullptr;
+    QAction* mShowBinaryComparison = nullptr;
     QPointer<QAction> splitDiff;
     QPointer<QAction> joinDiffs;
     QPointer<QAction> addManualDiffHelp;
@@ -441,17 +523,41 @@ public Q_SLOTS:
     QSharedPointer<SourceData> m_sd1 = QSharedPointer<SourceData>::create();
     QSharedPointer<SourceData> m_sd2 = QSharedPointer<SourceData>::create();
     QSharedPointer<SourceData> m_sd3 = QSharedPointer<SourceData>::create();
+    SourceDataPrefetcher mPrefetcher; // Reads the files of the next merges of a directory merge.
 
     QString m_outputFilename;
     bool m_bDefaultFilename = true;
+    QString m_paintBenchmarkFilename; // Report file given with --paint-benchmark.
+    Statistics mStatistics;
+    QPointer<QDialog> mBinaryDiffDialog; // Shows the buffers of m_sd1 and m_sd2, closed before they are reloaded.
 
     DiffList m_diffList12;
     DiffList m_diffList23;
     DiffList m_diffList13;
+    DiffListOrigin mDiffOrigin12;
+    DiffListOrigin mDiffOrigin23;
+    DiffListOrigin mDiffOrigin13;
+    ManualDiffSegmentCache mDiffSegments12;
+    ManualDiffSegmentCache mDiffSegments23;
+    ManualDiffSegmentCache mDiffSegments13;
     Diff3LineList m_diff3LineList;
     Diff3LineVector mDiff3LineVector;
     ManualDiffHelpList m_manualDiffHelpList;
 
+    // Fills in deferred fine diffs while the application is idle.
+    QTimer mFineDiffTimer;
+    QTimer mResizeWordWrapTimer; // Collects the width changes of all windows into one recalc.
+    QTimer mAvailabilitiesTimer; // Collects the cursor, focus and selection changes into one update of the actions.
+    Diff3LineList::const_iterator mNextPendingFineDiff;
+    // Calculate the complete line matching after a quick one was shown.
+    std::shared_ptr<TaskGroup> mpDiffRefinements = std::make_shared<TaskGroup>();
+    bool mbMainInitRunning = false;
+    bool mbPrinting = false; // A worker reads mDiff3LineVector, see printComparison().
+    // Polls the background reads of the complete inputs while only their beginning is shown.
+    QTimer mProgressiveLoadTimer;
+    int mProgressiveScrollPos = -1; // Kept across the reload of the complete inputs.
+    bool mbLoadingCompleteInputs = false;
+
     QtNumberType m_neededLines = 0;
     int m_DTWHeight = 0;
     bool m_bOutputModified = false;
@@ -471,7 +577,6 @@ public Q_SLOTS:
     bool m_bRecalcWordWrapPosted = false;
 
     int m_firstD3LIdx = 0; // only needed during recalcWordWrap
-    QPointer<QEventLoop> m_pEventLoopForPrinting;
 
     bool mRunnablesStarted = false;
 
@@ -84,12 +84,29 @@ void KDiff3Shell::closeEvent(QCloseEvent* e)
         e->accept();
         bool bFileSaved = m_widget->isFileSaved();
         bool bDirCompare = m_widget->isDirComparison();
-        QApplication::exit(bFileSaved || bDirCompare ? 0 : 1);
+        finish(bFileSaved || bDirCompare ? 0 : 1);
     }
     else
         e->ignore();
 }
 
+void KDiff3Shell::finish(const int exitCode)
+{
+    if(!mServed)
+    {
+        QApplication::exit(exitCode);
+        return;
+    }
+
+    if(mFinished)
+        return;
+
+    mFinished = true;
+    hide();
+    Q_EMIT finished(exitCode);
+    deleteLater();
+}
+
 void KDiff3Shell::optionsShowToolbar()
 {
     // this is all very cut and paste code for showing/hiding the
@@ -47,6 +47,16 @@ class KDiff3Shell: public KXmlGuiWindow
     bool queryExit();
     void closeEvent(QCloseEvent* e) override;
 
+    // Set for windows opened by InstanceServer, those must not end the application.
+    inline void setServed(const bool bServed) { mServed = bServed; }
+    // Ends the application, or only this window if it is served.
+    void finish(const int exitCode);
+
+  Q_SIGNALS:
+    void finished(int exitCode);
+
+  public:
+
     static inline std::unique_ptr<QCommandLineParser>& getParser()
     {
         static std::unique_ptr<QCommandLineParser> parser = std::make_unique<QCommandLineParser>();
@@ -67,6 +77,8 @@ class KDiff3Shell: public KXmlGuiWindow
     KToggleAction* m_toolbarAction;
     KToggleAction* m_statusbarAction;
     bool m_bUnderConstruction;
+    bool mServed = false;
+    bool mFinished = false;
 };
 
 #endif // _KDIFF3_H_
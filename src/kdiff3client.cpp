@@ -0,0 +1,69 @@
+// clang-format off
+/*
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2002-2011 Joachim Eibl, joachim.eibl at gmx.de
+ * SPDX-FileCopyrightText: 2018-2020 Michael Reeves reeves.87@gmail.com
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+// clang-format on
+
+/*
+    Hands its command line to a kdiff3 started with --server and waits until that window is closed.
+    Starts a normal kdiff3 when no server is running. Kept free of KF and widget libraries so it
+    loads fast, which is the whole point of it.
+*/
+
+#include "InstanceProtocol.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QStringList>
+
+namespace {
+
+int runStandalone(const QStringList& arguments)
+{
+    QString program = QStandardPaths::findExecutable(QStringLiteral("kdiff3"), {QCoreApplication::applicationDirPath()});
+    if(program.isEmpty())
+        program = QStandardPaths::findExecutable(QStringLiteral("kdiff3"));
+    if(program.isEmpty())
+        return 2;
+
+    return QProcess::execute(program, arguments.mid(1));
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = QCoreApplication::arguments();
+
+    QLocalSocket socket;
+    socket.connectToServer(InstanceProtocol::socketName());
+    if(!socket.waitForConnected(1000))
+        return runStandalone(arguments);
+
+    QDataStream stream(&socket);
+    stream.setVersion(InstanceProtocol::streamVersion);
+    stream << InstanceProtocol::magic << QDir::currentPath() << arguments;
+    socket.flush();
+
+    // The answer only comes once the user closes the window.
+    qint32 exitCode = 0;
+    for(;;)
+    {
+        stream.startTransaction();
+        stream >> exitCode;
+        if(stream.commitTransaction())
+            return exitCode;
+
+        if(socket.state() != QLocalSocket::ConnectedState && socket.bytesAvailable() == 0)
+            return 2;
+        socket.waitForReadyRead(-1);
+    }
+}
@@ -8,12 +8,19 @@
 */
 // clang-format on
 
+#include "BatchMerger.h"
+#include "InstanceServer.h"
 #include "kdiff3_shell.h"
+#include "options.h"
+#include "TaskExecutor.h"
 #include "UTF8BOMCodec.h"
 #include "version.h"
 
+#include <algorithm>
+
 #include <stdio.h>  // for fileno, stderr
 #include <stdlib.h> // for exit
+#include <string.h> // for strcmp
 
 #ifndef Q_OS_WIN
 #include <unistd.h>
@@ -23,11 +30,13 @@
 #include <KCrash/KCrash>
 #include <KLocalizedString>
 #include <KMessageBox>
+#include <KSharedConfig>
 
 #include <QApplication>
 #include <QCommandLineOption>
 #include <QCommandLineParser>
 #include <QFile>
+#include <QGuiApplication>
 #include <QPointer>
 #include <QStandardPaths>
 #include <QStringList>
@@ -79,6 +88,95 @@ void initialiseCmdLineArgs(QCommandLineParser* cmdLineParser)
     }
 }
 
+/*
+    --batch merges without building the main window, so no display is needed. Options still holds
+    fonts, which need a QGuiApplication, so the offscreen platform is used unless one was chosen.
+*/
+int runBatch(int argc, char* argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    KLocalizedString::setApplicationDomain("kdiff3");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18n("Merge files without GUI and report the remaining conflicts as JSON."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(u8"batch", i18n("Merge without GUI.")));
+    parser.addOption(QCommandLineOption(u8"jobs", i18n("Read more jobs from a file, one per line: A, B, C, output and patch separated by tabs. Use - for stdin."), u8"file"));
+    parser.addOption(QCommandLineOption(u8"report", i18n("Write the JSON report to this file instead of stdout."), u8"file"));
+    parser.addOption(QCommandLineOption(u8"patch", i18n("Write a unified diff of two files or the merge of three with conflict markers. Use - for stdout together with --report. "
+                                                        "The context is set with --cs \"PatchContextLines=n\"."), u8"file"));
+    parser.addOption(QCommandLineOption({u8"b", u8"base"}, i18n("Explicit base file. For compatibility with certain tools."), u8"file"));
+    parser.addOption(QCommandLineOption({u8"o", u8"output"}, i18n("Output file. E.g.: -o newfile.txt"), u8"file"));
+    parser.addOption(QCommandLineOption(u8"out", i18n("Output file, again. (For compatibility with certain tools.)"), u8"file"));
+    parser.addOption(QCommandLineOption(u8"cs", i18n("Override a config setting. Use once for every setting. E.g.: --cs \"AutoAdvance=1\""), u8"string"));
+    parser.addOption(QCommandLineOption(u8"config", i18n("Use a different config file."), u8"file"));
+    parser.addPositionalArgument(u8"[File1]", i18n("file1 to open (base, if not specified via --base)"));
+    parser.addPositionalArgument(u8"[File2]", i18n("file2 to open"));
+    parser.addPositionalArgument(u8"[File3]", i18n("file3 to open"));
+    parser.process(app);
+
+    QTextStream errorStream(stderr, QIODevice::WriteOnly);
+
+    const QSharedPointer<Options> pOptions = QSharedPointer<Options>::create();
+    pOptions->initBatch();
+    pOptions->readOptions(parser.isSet(u8"config") ? KSharedConfig::openConfig(parser.value(u8"config")) : KSharedConfig::openConfig());
+    const QString optionErrors = pOptions->parseOptions(parser.values(u8"cs"));
+    if(!optionErrors.isEmpty())
+        errorStream << optionErrors;
+    TaskExecutor::instance().setMaxThreadCount(pOptions->m_workerThreads);
+
+    std::vector<BatchMerger::Job> jobs;
+    QStringList files = parser.positionalArguments();
+    if(parser.isSet(u8"base"))
+        files.prepend(parser.value(u8"base"));
+    if(files.size() > 3)
+    {
+        errorStream << i18n("Too many input files.") << '\n';
+        return 2;
+    }
+    if(files.size() >= 2)
+        jobs.push_back({files[0], files[1], files.value(2), parser.isSet(u8"output") ? parser.value(u8"output") : parser.value(u8"out"), parser.value(u8"patch")});
+
+    if(parser.isSet(u8"jobs"))
+    {
+        const QString jobFileName = parser.value(u8"jobs");
+        QFile jobFile(jobFileName);
+        const bool bOpened = jobFileName == u8"-" ? jobFile.open(stdin, QIODevice::ReadOnly) : jobFile.open(QIODevice::ReadOnly);
+
+        QString error;
+        if(!bOpened)
+            error = i18nc("Read error message. %1 = filepath", "Failed to read file: %1", jobFileName);
+        if(!bOpened || !BatchMerger::readJobs(jobFile, jobs, error))
+        {
+            errorStream << error << '\n';
+            return 2;
+        }
+    }
+
+    const bool bPatchToStdout = std::any_of(jobs.cbegin(), jobs.cend(), [](const BatchMerger::Job& job) { return job.patch == u8"-"; });
+    if(bPatchToStdout && !parser.isSet(u8"report"))
+    {
+        errorStream << i18n("A patch written to stdout needs --report for the report.") << '\n';
+        return 2;
+    }
+
+    BatchMerger batchMerger(pOptions);
+    const int exitCode = batchMerger.run(jobs);
+
+    QFile reportFile(parser.value(u8"report"));
+    const bool bReportOpened = parser.isSet(u8"report") ? reportFile.open(QIODevice::WriteOnly) : reportFile.open(stdout, QIODevice::WriteOnly);
+    if(!bReportOpened || reportFile.write(batchMerger.report()) < 0)
+    {
+        errorStream << i18n("Error while writing the report.") << '\n';
+        return 2;
+    }
+
+    return exitCode;
+}
+
 int main(int argc, char* argv[])
 {
     constexpr QLatin1String appName("kdiff3", sizeof("kdiff3") - 1);
@@ -90,6 +188,12 @@ int main(int argc, char* argv[])
     const UTF8BOMCodec *textCodec = new UTF8BOMCodec();
     Q_UNUSED(textCodec);
 
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--batch") == 0)
+            return runBatch(argc, argv);
+    }
+
     //Syncronize qt HDPI behavoir on all versions/platforms
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
@@ -137,6 +241,9 @@ int main(int argc, char* argv[])
     cmdLineParser->addOption(QCommandLineOption(u8"noauto", i18n("Ignored.")));
     cmdLineParser->addOption(QCommandLineOption(u8"auto", i18n("Ignored.")));
 #endif
+    // Handled by runBatch() before getting here, listed for --help.
+    cmdLineParser->addOption(QCommandLineOption(u8"batch", i18n("Merge without GUI and write a JSON conflict report. See: kdiff3 --batch --help")));
+    cmdLineParser->addOption(QCommandLineOption(u8"server", i18n("Stay resident and open the windows requested by kdiff3-client.")));
     cmdLineParser->addOption(QCommandLineOption(u8"L1", i18n("Visible name replacement for input file 1 (base)."), u8"alias1"));
     cmdLineParser->addOption(QCommandLineOption(u8"L2", i18n("Visible name replacement for input file 2."), u8"alias2"));
     cmdLineParser->addOption(QCommandLineOption(u8"L3", i18n("Visible name replacement for input file 3."), u8"alias3"));
@@ -144,6 +251,7 @@ int main(int argc, char* argv[])
     cmdLineParser->addOption(QCommandLineOption(u8"cs", i18n("Override a config setting. Use once for every setting. E.g.: --cs \"AutoAdvance=1\""), u8"string"));
     cmdLineParser->addOption(QCommandLineOption(u8"confighelp", i18n("Show list of config settings and current values.")));
     cmdLineParser->addOption(QCommandLineOption(u8"config", i18n("Use a different config file."), u8"file"));
+    cmdLineParser->addOption(QCommandLineOption(u8"paint-benchmark", i18n("Time the painting while scrolling, resizing and toggling word wrap, write the frames to this file as JSON and quit. Use with -platform offscreen."), u8"file"));
 
     // other command options
     cmdLineParser->addPositionalArgument(u8"[File1]", i18n("file1 to open (base, if not specified via --base)"));
@@ -192,6 +300,19 @@ int main(int argc, char* argv[])
 
     aboutData.processCommandLine(cmdLineParser);
 
+    if(cmdLineParser->isSet(QStringLiteral("server")))
+    {
+        // Windows come and go, the server stays until it is killed.
+        app.setQuitOnLastWindowClosed(false);
+        InstanceServer server;
+        if(!server.listen())
+        {
+            QTextStream(stderr) << i18n("Could not start the server: %1", server.errorString()) << Qt::endl;
+            return 1;
+        }
+        return QApplication::exec();
+    }
+
     /*
       Do not attempt to call show here that will be done later.
       This variable exists solely to insure the KDiff3Shell is deleted on exit.
@@ -10,33 +10,30 @@
 
 #include "merger.h"
 
-#include <list>
-#include <memory>
+#include <algorithm>
 
-Merger::Merger(const std::shared_ptr<const DiffList>& pDiffList1, const std::shared_ptr<const DiffList>& pDiffList2):
-    md1(pDiffList1, 0), md2(pDiffList2, 1)
+Merger::Merger(const FineDiff& diffList1, const FineDiff& diffList2):
+    md1(diffList1, 0), md2(diffList2, 1)
 {
 }
 
-Merger::MergeData::MergeData(const std::shared_ptr<const DiffList>& p, int i)
+Merger::MergeData::MergeData(const FineDiff& p, int i)
 {
     idx = i;
-    pDiffList = p;
-    if(p != nullptr)
-    {
-        it = p->begin();
+    diffList = p;
+    it = p.begin();
+    if(!p.isNull())
         update();
-    }
 }
 
 bool Merger::MergeData::eq() const
 {
-    return pDiffList == nullptr || d.numberOfEquals() > 0;
+    return diffList.isNull() || d.numberOfEquals() > 0;
 }
 
 bool Merger::MergeData::isEnd() const
 {
-    return (pDiffList == nullptr || (it == pDiffList->end() && d.numberOfEquals() == 0 &&
+    return (diffList.isNull() || (it == diffList.end() && d.numberOfEquals() == 0 &&
                                      (idx == 0 ? d.diff1() == 0 : d.diff2() == 0)));
 }
 
@@ -49,19 +46,47 @@ void Merger::MergeData::update()
     else if(idx == 1 && d.diff2() > 0)
         d.adjustDiff2(-1);
 
-    while(d.numberOfEquals() == 0 && ((idx == 0 && d.diff1() == 0) || (idx == 1 && d.diff2() == 0)) && pDiffList != nullptr && it != pDiffList->end())
+    while(d.numberOfEquals() == 0 && ((idx == 0 && d.diff1() == 0) || (idx == 1 && d.diff2() == 0)) && !diffList.isNull() && it != diffList.end())
     {
         d = *it;
         ++it;
     }
 }
 
+void Merger::MergeData::skip(qint64 n)
+{
+    while(n > 0 && !isEnd())
+    {
+        // All but the last step of the run only count down, update() then moves on to the next run.
+        const qint64 run = d.numberOfEquals() > 0 ? d.numberOfEquals() : (qint64)(idx == 0 ? d.diff1() : d.diff2());
+        const qint64 steps = std::min(run, n) - 1;
+        if(steps > 0)
+        {
+            if(d.numberOfEquals() > 0)
+                d.adjustNumberOfEquals(-steps);
+            else if(idx == 0)
+                d.adjustDiff1(-steps);
+            else
+                d.adjustDiff2(-steps);
+            n -= steps;
+        }
+        update();
+        --n;
+    }
+}
+
 void Merger::next()
 {
     md1.update();
     md2.update();
 }
 
+void Merger::skip(const qint64 n)
+{
+    md1.skip(n);
+    md2.skip(n);
+}
+
 ChangeFlags Merger::whatChanged()
 {
     ChangeFlags changed = ChangeFlag::NoChange;
@@ -13,16 +13,17 @@
 
 #include "diff.h"
 
-#include <memory>
-
 class Merger
 {
   public:
-    Merger(const std::shared_ptr<const DiffList>& pDiffList1, const std::shared_ptr<const DiffList>& pDiffList2);
+    Merger(const FineDiff& diffList1, const FineDiff& diffList2);
 
     /** Go one step. */
     void next();
 
+    /** Go n steps, a run of equal or changed characters at a time. */
+    void skip(qint64 n);
+
     /** Information about what changed. Can be used for coloring.
        The return value is 0 if nothing changed here,
        bit 1 is set if a difference from pDiffList1 was detected,
@@ -37,15 +38,16 @@ class Merger
     class MergeData
     {
       private:
-        DiffList::const_iterator it;
-        std::shared_ptr<const DiffList> pDiffList;
+        const Diff* it;
+        FineDiff diffList;
         Diff d;
         int idx;
 
       public:
-        MergeData(const std::shared_ptr<const DiffList>& p, int i);
+        MergeData(const FineDiff& p, int i);
         [[nodiscard]] bool eq() const;
         void update();
+        void skip(qint64 n);
         [[nodiscard]] bool isEnd() const;
     };
 
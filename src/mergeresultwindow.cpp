@@ -14,12 +14,20 @@
 #include "defmac.h"
 #include "guiutils.h"
 #include "kdiff3.h"
+#include "MergeResultWriter.h"
+#include "MonospaceText.h"
 #include "options.h"
+#include "PaintBenchmark.h"
 #include "RLPainter.h"
+#include "Trace.h"
 #include "TypeUtils.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <memory>
+#include <optional>
 
 #include <QAction>
 #include <QApplication>
@@ -31,6 +39,7 @@
 #include <QEvent>
 #include <QFile>
 #include <QFocusEvent>
+#include <QFontInfo>
 #include <QHBoxLayout>
 #include <QInputEvent>
 #include <QKeyEvent>
@@ -89,6 +98,11 @@ MergeResultWindow::MergeResultWindow(
     chk_connect_a(&m_cursorTimer, &QTimer::timeout, this, &MergeResultWindow::slotCursorUpdate);
     m_cursorTimer.setSingleShot(true);
     m_cursorTimer.start(500 /*ms*/);
+    chk_connect_a(&mEditMatchTimer, &QTimer::timeout, this, &MergeResultWindow::slotUpdateEditMatches);
+    mEditMatchTimer.setSingleShot(true);
+    mAvailabilitiesTimer.setSingleShot(true);
+    mAvailabilitiesTimer.setInterval(0);
+    chk_connect_a(&mAvailabilitiesTimer, &QTimer::timeout, this, &MergeResultWindow::recalcAvailabilities);
     m_selection.reset();
 
     setMinimumSize(QSize(20, 20));
@@ -129,6 +143,10 @@ void MergeResultWindow::init(
 
     m_maxTextWidth = -1;
 
+    // Both refer to the previous Diff3LineList.
+    m_mergeBlockList.list().clear();
+    m_builtMergeBlockList.list().clear();
+    invalidateBlockIndex();
     merge(bAutoSolve, e_SrcSelector::Invalid);
     update();
     updateSourceMask();
@@ -213,6 +231,7 @@ void MergeResultWindow::setupConnections(const KDiff3App* app)
     connections.push_back(KDiff3App::allowCut.connect(boost::bind(&MergeResultWindow::canCut, this)));
     connections.push_back(KDiff3App::allowCopy.connect(boost::bind(&MergeResultWindow::canCopy, this)));
     connections.push_back(KDiff3App::getSelection.connect(boost::bind(&MergeResultWindow::getSelection, this)));
+    connections.push_back(KDiff3App::getSelectionText.connect(boost::bind(&MergeResultWindow::getSelectionText, this)));
 }
 
 void MergeResultWindow::slotResize()
@@ -223,12 +242,16 @@ void MergeResultWindow::slotResize()
 
 void MergeResultWindow::slotCut()
 {
-    const QString curSelection = getSelection();
-    assert(!curSelection.isEmpty() && hasFocus());
+    const SelectionText curSelection = getSelectionText();
+    assert(hasFocus());
+    if(curSelection.isEmpty())
+        return;
+
     deleteSelection();
     update();
 
-    QApplication::clipboard()->setText(curSelection, QClipboard::Clipboard);
+    // Lines taken from the inputs stay valid, deleting only changes the merge result.
+    QApplication::clipboard()->setMimeData(new SelectionMimeData(curSelection), QClipboard::Clipboard);
 }
 
 void MergeResultWindow::slotCopy()
@@ -236,11 +259,11 @@ void MergeResultWindow::slotCopy()
     if(!hasFocus())
         return;
 
-    const QString curSelection = getSelection();
+    const SelectionText curSelection = getSelectionText();
 
     if(!curSelection.isEmpty())
     {
-        QApplication::clipboard()->setText(curSelection, QClipboard::Clipboard);
+        QApplication::clipboard()->setMimeData(new SelectionMimeData(curSelection), QClipboard::Clipboard);
     }
 }
 
@@ -272,6 +295,12 @@ void MergeResultWindow::slotRefresh()
 }
 
 void MergeResultWindow::slotUpdateAvailabilities()
+{
+    if(!mAvailabilitiesTimer.isActive())
+        mAvailabilitiesTimer.start();
+}
+
+void MergeResultWindow::recalcAvailabilities()
 {
     const QWidget* frame = qobject_cast<QWidget*>(parent());
     assert(frame != nullptr);
@@ -300,6 +329,8 @@ void MergeResultWindow::slotStatusMessageChanged(const QString& s)
 void MergeResultWindow::reset()
 {
     m_mergeBlockList.list().clear();
+    m_builtMergeBlockList.list().clear();
+    invalidateBlockIndex();
 
     m_pDiff3LineList = nullptr;
     m_pTotalDiffStatus = nullptr;
@@ -330,10 +361,14 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
                 return;
         }
 
-        m_mergeBlockList.list().clear();
+        // Building the blocks is only needed once per diff. Starting from a copy of them only
+        // touches the blocks that were changed since, which keeps re-merging a large file fast.
+        if(m_builtMergeBlockList.list().empty())
+            m_builtMergeBlockList.buildFromDiff3(*m_pDiff3LineList, lIsThreeWay, m_pldA, m_pldB, m_pldC);
 
-        m_mergeBlockList.buildFromDiff3(*m_pDiff3LineList, lIsThreeWay);
+        m_mergeBlockList.assignChanged(m_builtMergeBlockList);
     }
+    invalidateBlockIndex();
 
     bool bSolveWhiteSpaceConflicts = false;
     if(bAutoSolve) // when true, then the other params are not used and we can change them here. (see all invocations of merge())
@@ -415,8 +450,34 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
 
 void MergeResultWindow::setFirstLine(QtNumberType firstLine)
 {
-    m_firstLine = std::max(0, firstLine);
-    update();
+    const LineRef newFirstLine = std::max(0, firstLine);
+    if(newFirstLine == m_firstLine)
+    {
+        update();
+        return;
+    }
+
+    const int deltaY = fontMetrics().lineSpacing() * (m_firstLine - newFirstLine);
+    const qreal pixmapDeltaY = deltaY * m_pixmap.devicePixelRatio();
+    m_firstLine = newFirstLine;
+
+    /*
+        Move what is already painted instead of rendering every line again. Only the lines
+        scrolled into view get painted. With fractional scaling a line doesn't start on a whole
+        pixel and the copy would be off, so redraw everything then.
+    */
+    if(m_pixmap.isNull() || m_pixmap.size() != size() * devicePixelRatioF() ||
+       std::abs(deltaY) >= height() || pixmapDeltaY != std::round(pixmapDeltaY))
+    {
+        update();
+        return;
+    }
+
+    m_pixmap.scroll(0, (int)pixmapDeltaY, m_pixmap.rect());
+
+    const QRect exposed = deltaY > 0 ? QRect(0, 0, width(), deltaY) : QRect(0, height() + deltaY, width(), -deltaY);
+    m_pixmapDirtyRect = m_pixmapDirtyRect.translated(0, deltaY).intersected(rect()) | exposed;
+    scroll(0, deltaY);
 }
 
 void MergeResultWindow::setHorizScrollOffset(const int horizScrollOffset)
@@ -430,28 +491,38 @@ int MergeResultWindow::getMaxTextWidth()
     if(m_maxTextWidth < 0)
     {
         m_maxTextWidth = 0;
-
         for(const MergeBlock& mb: m_mergeBlockList.list())
-        {
-            for(const MergeEditLine& mel: mb.list())
-            {
-                const QString s = mel.getString(m_pldA, m_pldB, m_pldC);
-
-                QTextLayout textLayout(s, font(), this);
-                textLayout.beginLayout();
-                textLayout.createLine();
-                textLayout.endLayout();
-                if(m_maxTextWidth < textLayout.maximumWidth())
-                {
-                    m_maxTextWidth = qCeil(textLayout.maximumWidth());
-                }
-            }
-        }
+            m_maxTextWidth = std::max(m_maxTextWidth, getMaxTextWidth(mb.list().cbegin(), mb.list().cend()));
         m_maxTextWidth += 5; // cursorwidth
     }
     return m_maxTextWidth;
 }
 
+int MergeResultWindow::getMaxTextWidth(const MergeEditLineList::const_iterator first, const MergeEditLineList::const_iterator last)
+{
+    // With a fixed pitch font the width follows from the columns, no line has to be laid out.
+    const bool bFixedPitch = QFontInfo(font()).fixedPitch();
+    const int fontWidth = Utils::getHorizontalAdvance(fontMetrics(), '0');
+
+    int maxWidth = 0;
+    for(MergeEditLineList::const_iterator melIt = first; melIt != last; ++melIt)
+    {
+        const QString s = melIt->getString(m_pldA, m_pldB, m_pldC);
+        if(bFixedPitch)
+        {
+            maxWidth = std::max(maxWidth, LineData::width(s, m_pOptions->m_tabSize) * fontWidth);
+            continue;
+        }
+
+        QTextLayout textLayout(s, font(), this);
+        textLayout.beginLayout();
+        textLayout.createLine();
+        textLayout.endLayout();
+        maxWidth = std::max(maxWidth, qCeil(textLayout.maximumWidth()));
+    }
+    return maxWidth;
+}
+
 LineType MergeResultWindow::getNofLines() const
 {
     return m_nofLines;
@@ -488,6 +559,7 @@ e_OverviewMode MergeResultWindow::getOverviewMode() const
 void MergeResultWindow::setOverviewMode(e_OverviewMode eOverviewMode)
 {
     mOverviewMode = eOverviewMode;
+    invalidateBlockIndex();
 }
 
 // Check whether we should ignore current delta when moving to next/previous delta
@@ -503,12 +575,22 @@ bool MergeResultWindow::checkOverviewIgnore(const MergeBlockListImp::const_itera
     return false;
 }
 
+const MergeBlockIndex& MergeResultWindow::blockIndex() const
+{
+    const bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
+    if(!mBlockIndex.isValid() || mBlockIndex.skipsWhiteSpaceConflicts() != bSkipWhiteConflicts)
+    {
+        mBlockIndex.build(
+            m_mergeBlockList.list(), [this](const MergeBlockListImp::const_iterator i) { return checkOverviewIgnore(i); }, bSkipWhiteConflicts);
+    }
+    return mBlockIndex;
+}
+
 // Go to prev/next delta/conflict or first/last delta.
 void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
 {
     assert(eDir == eUp || eDir == eDown);
     MergeBlockListImp::iterator i = m_currentMergeBlockIt;
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
     if(eEndPoint == eEnd)
     {
         if(eDir == eUp)
@@ -524,35 +606,20 @@ void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
                 --i; // search upwards
         }
     }
-    else if(eEndPoint == eDelta && isItAtEnd(eDir != eUp, i))
-    {
-        do
-        {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && (!i->isDelta() || checkOverviewIgnore(i) || (bSkipWhiteConflicts && i->isWhiteSpaceConflict())));
-    }
-    else if(eEndPoint == eConflict && isItAtEnd(eDir != eUp, i))
+    else if((eEndPoint == eDelta || eEndPoint == eConflict || eEndPoint == eUnsolvedConflict) && isItAtEnd(eDir != eUp, i))
     {
-        do
+        const MergeBlockIndex::Kind kind = eEndPoint == eDelta ? MergeBlockIndex::Kind::delta :
+                                           eEndPoint == eConflict ? MergeBlockIndex::Kind::conflict : MergeBlockIndex::Kind::unsolvedConflict;
+        const MergeBlockIndex& index = blockIndex();
+        const size_t current = index.ordinal(i);
+        const size_t found = eDir == eUp ? index.previous(kind, current) : index.next(kind, current);
+        if(found < index.size())
         {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && (!i->isConflict() || (bSkipWhiteConflicts && i->isWhiteSpaceConflict())));
-    }
-    else if(isItAtEnd(eDir != eUp, i) && eEndPoint == eUnsolvedConflict)
-    {
-        do
-        {
-            if(eDir == eUp)
-                --i;
-            else
-                ++i;
-        } while(isItAtEnd(eDir != eUp, i) && !i->list().begin()->isConflict());
+            // Erasing the empty range turns the const_iterator into an iterator.
+            i = m_mergeBlockList.list().erase(index.block(found), index.block(found));
+        }
+        else // Like a search from the current block that found nothing.
+            i = eDir == eUp ? m_mergeBlockList.list().begin() : m_mergeBlockList.list().end();
     }
 
     if(isVisible())
@@ -563,69 +630,26 @@ void MergeResultWindow::go(e_Direction eDir, e_EndPoint eEndPoint)
 
 bool MergeResultWindow::isDeltaAboveCurrent() const
 {
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-    if(m_mergeBlockList.list().empty()) return false;
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(i == m_mergeBlockList.list().begin()) return false;
-    do
-    {
-        --i;
-        if(i->isDelta() && !checkOverviewIgnore(i) && !(bSkipWhiteConflicts && i->isWhiteSpaceConflict())) return true;
-    } while(i != m_mergeBlockList.list().begin());
-
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.previous(MergeBlockIndex::Kind::delta, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 bool MergeResultWindow::isDeltaBelowCurrent() const
 {
-    const bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-    if(m_mergeBlockList.list().empty()) return false;
-
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(i != m_mergeBlockList.list().end())
-    {
-        ++i;
-        for(; i != m_mergeBlockList.list().end(); ++i)
-        {
-            if(i->isDelta() && !checkOverviewIgnore(i) && !(bSkipWhiteConflicts && i->isWhiteSpaceConflict())) return true;
-        }
-    }
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.next(MergeBlockIndex::Kind::delta, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 bool MergeResultWindow::isConflictAboveCurrent() const
 {
-    if(m_mergeBlockList.list().empty()) return false;
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(i == m_mergeBlockList.list().cbegin()) return false;
-
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-
-    do
-    {
-        --i;
-        if(i->isConflict() && !(bSkipWhiteConflicts && i->isWhiteSpaceConflict())) return true;
-    } while(i != m_mergeBlockList.list().cbegin());
-
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.previous(MergeBlockIndex::Kind::conflict, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 bool MergeResultWindow::isConflictBelowCurrent() const
 {
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(m_mergeBlockList.list().empty()) return false;
-
-    bool bSkipWhiteConflicts = !m_pOptions->m_bShowWhiteSpace;
-
-    if(i != m_mergeBlockList.list().cend())
-    {
-        ++i;
-        for(; i != m_mergeBlockList.list().cend(); ++i)
-        {
-            if(i->isConflict() && !(bSkipWhiteConflicts && i->isWhiteSpaceConflict())) return true;
-        }
-    }
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.next(MergeBlockIndex::Kind::conflict, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 bool MergeResultWindow::isUnsolvedConflictAtCurrent() const
@@ -637,33 +661,14 @@ bool MergeResultWindow::isUnsolvedConflictAtCurrent() const
 
 bool MergeResultWindow::isUnsolvedConflictAboveCurrent() const
 {
-    if(m_mergeBlockList.list().empty()) return false;
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(i == m_mergeBlockList.list().cbegin()) return false;
-
-    do
-    {
-        --i;
-        if(i->list().cbegin()->isConflict()) return true;
-    } while(i != m_mergeBlockList.list().cbegin());
-
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.previous(MergeBlockIndex::Kind::unsolvedConflict, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 bool MergeResultWindow::isUnsolvedConflictBelowCurrent() const
 {
-    MergeBlockListImp::const_iterator i = m_currentMergeBlockIt;
-    if(m_mergeBlockList.list().empty()) return false;
-
-    if(i != m_mergeBlockList.list().cend())
-    {
-        ++i;
-        for(; i != m_mergeBlockList.list().cend(); ++i)
-        {
-            if(i->list().cbegin()->isConflict()) return true;
-        }
-    }
-    return false;
+    const MergeBlockIndex& index = blockIndex();
+    return index.next(MergeBlockIndex::Kind::unsolvedConflict, index.ordinal(m_currentMergeBlockIt)) < index.size();
 }
 
 void MergeResultWindow::slotGoTop()
@@ -715,38 +720,19 @@ void MergeResultWindow::slotGoNextUnsolvedConflict()
     The function calculates the corresponding iterator. */
 void MergeResultWindow::slotSetFastSelectorLine(LineType line)
 {
-    MergeBlockListImp::iterator i;
-    for(i = m_mergeBlockList.list().begin(); i != m_mergeBlockList.list().end(); ++i)
-    {
-        if(line >= i->getIndex() && line < i->getIndex() + i->sourceRangeLength())
-        {
-            //if ( i->isDelta() )
-            {
-                setFastSelector(i);
-            }
-            break;
-        }
-    }
+    const MergeBlockIndex& index = blockIndex();
+    const size_t ordinal = index.ordinalOfDiff3Line(line);
+    if(ordinal < index.size())
+        setFastSelector(m_mergeBlockList.list().erase(index.block(ordinal), index.block(ordinal)));
 }
 
 int MergeResultWindow::getNumberOfUnsolvedConflicts(int* pNrOfWhiteSpaceConflicts) const
 {
-    int nrOfUnsolvedConflicts = 0;
+    const MergeBlockIndex& index = blockIndex();
     if(pNrOfWhiteSpaceConflicts != nullptr)
-        *pNrOfWhiteSpaceConflicts = 0;
+        *pNrOfWhiteSpaceConflicts = SafeInt<int>(index.unsolvedWhiteSpaceConflicts());
 
-    for(const MergeBlock& mb: m_mergeBlockList.list())
-    {
-        MergeEditLineList::const_iterator melIt = mb.list().cbegin();
-        if(melIt->isConflict())
-        {
-            ++nrOfUnsolvedConflicts;
-            if(mb.isWhiteSpaceConflict() && pNrOfWhiteSpaceConflicts != nullptr)
-                ++*pNrOfWhiteSpaceConflicts;
-        }
-    }
-
-    return nrOfUnsolvedConflicts;
+    return SafeInt<int>(index.count(MergeBlockIndex::Kind::unsolvedConflict));
 }
 
 void MergeResultWindow::showNumberOfConflicts(bool showIfNone)
@@ -786,6 +772,14 @@ void MergeResultWindow::showNumberOfConflicts(bool showIfNone)
             totalInfo += i18n("Files %1 and %2 have equal text.\n", QStringLiteral("B"), QStringLiteral("C"));
     }
 
+    const MergeBlockIndex& index = blockIndex();
+    const int nofCommentConflicts = SafeInt<int>(index.unsolvedConflicts(e_ConflictKind::comment));
+    const int nofNumberConflicts = SafeInt<int>(index.unsolvedConflicts(e_ConflictKind::numbers));
+    if(nofCommentConflicts > 0 || nofNumberConflicts > 0)
+        totalInfo += i18n("\nUnsolved conflicts differing only in comments: %1\n"
+                          "Unsolved conflicts differing only in numbers: %2",
+                          nofCommentConflicts, nofNumberConflicts);
+
     KMessageBox::information(this,
                              i18n("Total number of conflicts: %1\n"
                                   "Number of automatically solved conflicts: %2\n"
@@ -803,15 +797,8 @@ void MergeResultWindow::setFastSelector(MergeBlockListImp::iterator i)
     m_currentMergeBlockIt = i;
     Q_EMIT setFastSelectorRange(i->getIndex(), i->sourceRangeLength());
 
-    int line1 = 0;
-
-    MergeBlockListImp::const_iterator mbIt = m_mergeBlockList.list().cbegin();
-    for(; mbIt != m_mergeBlockList.list().cend(); ++mbIt)
-    {
-        if(mbIt == m_currentMergeBlockIt)
-            break;
-        line1 += mbIt->lineCount();
-    }
+    const MergeBlockIndex& index = blockIndex();
+    int line1 = index.firstLine(index.ordinal(m_currentMergeBlockIt));
 
     int nofLines = m_currentMergeBlockIt->lineCount();
     int newFirstLine = getBestFirstLine(line1, nofLines, m_firstLine, getNofVisibleLines());
@@ -947,88 +934,9 @@ void MergeResultWindow::slotUnsolve()
     showUnsolvedConflictsStatusMessage();
 }
 
-bool findParenthesesGroups(const QString& s, QStringList& sl)
-{
-    sl.clear();
-    int i = 0;
-    std::list<int> startPosStack;
-    int length = s.length();
-    for(i = 0; i < length; ++i)
-    {
-        if(s[i] == '\\' && i + 1 < length && (s[i + 1] == '\\' || s[i + 1] == '(' || s[i + 1] == ')'))
-        {
-            ++i;
-            continue;
-        }
-        if(s[i] == '(')
-        {
-            startPosStack.push_back(i);
-        }
-        else if(s[i] == ')')
-        {
-            if(startPosStack.empty())
-                return false; // Parentheses don't match
-            int startPos = startPosStack.back();
-            startPosStack.pop_back();
-            sl.push_back(s.mid(startPos + 1, i - startPos - 1));
-        }
-    }
-    return startPosStack.empty(); // false if parentheses don't match
-}
-
-QString calcHistorySortKey(const QString& keyOrder, QRegularExpressionMatch& regExprMatch, const QStringList& parenthesesGroupList)
-{
-    const QStringList keyOrderList = keyOrder.split(',');
-    QString key;
-
-    for(const QString& keyIt : keyOrderList)
-    {
-        if(keyIt.isEmpty())
-            continue;
-        bool bOk = false;
-        int groupIdx = keyIt.toInt(&bOk);
-        if(!bOk || groupIdx < 0 || groupIdx > parenthesesGroupList.size())
-            continue;
-        QString s = regExprMatch.captured(groupIdx);
-        if(groupIdx == 0)
-        {
-            key += s + ' ';
-            continue;
-        }
-
-        QString groupRegExp = parenthesesGroupList[groupIdx - 1];
-        if(groupRegExp.indexOf('|') < 0 || groupRegExp.indexOf('(') >= 0)
-        {
-            bOk = false;
-            int i = s.toInt(&bOk);
-            if(bOk && i >= 0 && i < 10000)
-            {
-                s += QString(4 - s.size(), '0'); // This should help for correct sorting of numbers.
-            }
-            key += s + ' ';
-        }
-        else
-        {
-            // Assume that the groupRegExp consists of something like "Jan|Feb|Mar|Apr"
-            // s is the string that managed to match.
-            // Now we want to know at which position it occurred. e.g. Jan=0, Feb=1, Mar=2, etc.
-            QStringList sl = groupRegExp.split('|');
-            int idx = sl.indexOf(s);
-            if(idx >= 0)
-            {
-                QString sIdx;
-                sIdx.setNum(idx);
-                assert(sIdx.size() <= 2);
-                sIdx += QString(2 - sIdx.size(), '0'); // Up to 99 words in the groupRegExp (more than 12 aren't expected)
-                key += sIdx + ' ';
-            }
-        }
-    }
-    return key;
-}
-
 void MergeResultWindow::collectHistoryInformation(
     e_SrcSelector src, const HistoryRange& historyRange,
+    const HistoryPatterns& patterns,
     HistoryMap& historyMap,
     std::list<HistoryMap::iterator>& hitList // list of iterators
 )
@@ -1039,71 +947,66 @@ void MergeResultWindow::collectHistoryInformation(
 
     historyLead = Utils::calcHistoryLead(id3l->getLineData(src).getLine());
 
-    QRegularExpression historyStart(m_pOptions->m_historyStartRegExp);
     if(id3l == historyRange.end)
         return;
     //TODO: Where is this assumption coming from?
     ++id3l; // Skip line with "$Log ... $"
-    QRegularExpression newHistoryEntry(m_pOptions->m_historyEntryStartRegExp);
     QRegularExpressionMatch match;
-    QStringList parenthesesGroups;
-    findParenthesesGroups(m_pOptions->m_historyEntryStartRegExp, parenthesesGroups);
     QString key;
     MergeEditLineList melList;
     bool bPrevLineIsEmpty = true;
-    bool bUseRegExp = !m_pOptions->m_historyEntryStartRegExp.isEmpty();
+
+    const auto addEntry = [&]() {
+        // Only insert new HistoryMapEntry if key not found; in either case p.first is a valid iterator to element key.
+        std::pair<HistoryMap::iterator, bool> p = historyMap.insert(HistoryMap::value_type(key, HistoryMapEntry()));
+        HistoryMapEntry& hme = p.first->second;
+        if(src == e_SrcSelector::A) hme.mellA = std::move(melList);
+        else if(src == e_SrcSelector::B) hme.mellB = std::move(melList);
+        else hme.mellC = std::move(melList);
+        if(p.second) // Not in list yet?
+        {
+            hitList.insert(itHitListFront, p.first);
+        }
+    };
 
     for(; id3l != historyRange.end; ++id3l)
     {
         const LineData& pld = id3l->getLineData(src);
         const QString& oriLine = pld.getLine();
         if(historyLead.isEmpty()) historyLead = Utils::calcHistoryLead(oriLine);
-        QString sLine = oriLine.mid(historyLead.length());
-        match = newHistoryEntry.match(sLine);
-        if((!bUseRegExp && !sLine.trimmed().isEmpty() && bPrevLineIsEmpty) || (bUseRegExp && match.hasMatch()))
+        const QString sLine = oriLine.mid(historyLead.length());
+        const bool bLineIsEmpty = sLine.trimmed().isEmpty();
+        bool bEntryStart;
+        if(patterns.bUseRegExp)
+        {
+            match = patterns.entryStart.match(sLine);
+            bEntryStart = match.hasMatch();
+        }
+        else
+            bEntryStart = !bLineIsEmpty && bPrevLineIsEmpty;
+
+        if(bEntryStart)
         {
             if(!key.isEmpty() && !melList.empty())
-            {
-                // Only insert new HistoryMapEntry if key not found; in either case p.first is a valid iterator to element key.
-                std::pair<HistoryMap::iterator, bool> p = historyMap.insert(HistoryMap::value_type(key, HistoryMapEntry()));
-                HistoryMapEntry& hme = p.first->second;
-                if(src == e_SrcSelector::A) hme.mellA = melList;
-                else if(src == e_SrcSelector::B) hme.mellB = melList;
-                else hme.mellC = melList;
-                if(p.second) // Not in list yet?
-                {
-                    hitList.insert(itHitListFront, p.first);
-                }
-            }
+                addEntry();
 
-            if(!bUseRegExp)
+            if(!patterns.bUseRegExp)
                 key = sLine;
             else
-                key = calcHistorySortKey(m_pOptions->m_historyEntryStartSortKeyOrder, match, parenthesesGroups);
+                key = patterns.sortKey.calc(match);
 
             melList.clear();
             melList.push_back(MergeEditLine(id3l, src));
         }
-        else if(!historyStart.match(oriLine).hasMatch())
+        else if(!patterns.historyStart.match(oriLine).hasMatch())
         {
             melList.push_back(MergeEditLine(id3l, src));
         }
 
-        bPrevLineIsEmpty = sLine.trimmed().isEmpty();
+        bPrevLineIsEmpty = bLineIsEmpty;
     }
     if(!key.isEmpty())
-    {
-        // Only insert new HistoryMapEntry if key not found; in either case p.first is a valid iterator to element key.
-        std::pair<HistoryMap::iterator, bool> p = historyMap.insert(HistoryMap::value_type(key, HistoryMapEntry()));
-        HistoryMapEntry& hme = p.first->second;
-        if(src == e_SrcSelector::A) hme.mellA = melList;
-        if(src == e_SrcSelector::B) hme.mellB = melList;
-        if(src == e_SrcSelector::C) hme.mellC = melList;
-        if(p.second) // Not in list yet?
-        {
-            hitList.insert(itHitListFront, p.first);
-        }
-    }
+        addEntry();
     // End of the history
 }
 
@@ -1160,8 +1063,18 @@ void MergeResultWindow::slotMergeHistory()
 {
     HistoryRange        historyRange;
 
+    QStringList parenthesesGroups;
+    findParenthesesGroups(m_pOptions->m_historyEntryStartRegExp, parenthesesGroups);
+    const HistoryPatterns patterns{QRegularExpression(m_pOptions->m_historyStartRegExp),
+                                   QRegularExpression(m_pOptions->m_historyEntryStartRegExp),
+                                   HistorySortKey(m_pOptions->m_historyEntryStartSortKeyOrder, parenthesesGroups),
+                                   !m_pOptions->m_historyEntryStartRegExp.isEmpty()};
+    // Both are matched against every line of the history.
+    patterns.historyStart.optimize();
+    patterns.entryStart.optimize();
+
     // Search for history start, history end in the diff3LineList
-    m_pDiff3LineList->findHistoryRange(QRegularExpression(m_pOptions->m_historyStartRegExp), m_pldC != nullptr, historyRange);
+    m_pDiff3LineList->findHistoryRange(patterns.historyStart, m_pldC != nullptr, historyRange);
     if(historyRange.start != m_pDiff3LineList->end())
     {
         // Now collect the historyMap information
@@ -1169,14 +1082,14 @@ void MergeResultWindow::slotMergeHistory()
         std::list<HistoryMap::iterator> hitList;
         if(m_pldC == nullptr)
         {
-            collectHistoryInformation(e_SrcSelector::A, historyRange, historyMap, hitList);
-            collectHistoryInformation(e_SrcSelector::B, historyRange, historyMap, hitList);
+            collectHistoryInformation(e_SrcSelector::A, historyRange, patterns, historyMap, hitList);
+            collectHistoryInformation(e_SrcSelector::B, historyRange, patterns, historyMap, hitList);
         }
         else
         {
-            collectHistoryInformation(e_SrcSelector::A, historyRange, historyMap, hitList);
-            collectHistoryInformation(e_SrcSelector::B, historyRange, historyMap, hitList);
-            collectHistoryInformation(e_SrcSelector::C, historyRange, historyMap, hitList);
+            collectHistoryInformation(e_SrcSelector::A, historyRange, patterns, historyMap, hitList);
+            collectHistoryInformation(e_SrcSelector::B, historyRange, patterns, historyMap, hitList);
+            collectHistoryInformation(e_SrcSelector::C, historyRange, patterns, historyMap, hitList);
         }
 
         Diff3LineList::const_iterator iD3LHistoryOrigEnd = historyRange.end;
@@ -1216,6 +1129,7 @@ void MergeResultWindow::slotMergeHistory()
             }
         }
 
+        invalidateBlockIndex();
         MergeBlockListImp::iterator iMBLStart = m_mergeBlockList.splitAtDiff3LineIdx(historyRange.startIdx);
         MergeBlockListImp::iterator iMBLEnd = m_mergeBlockList.splitAtDiff3LineIdx(historyRange.endIdx);
         // Now join all MergeBlocks in the history
@@ -1250,7 +1164,10 @@ void MergeResultWindow::slotMergeHistory()
                 HistoryMapEntry& hme = hmit->second;
                 MergeEditLineList& mell = hme.choice(m_pldC != nullptr);
                 if(!mell.empty())
-                    iMBLStart->list().splice(iMBLStart->list().end(), mell, mell.begin(), mell.end());
+                {
+                    iMBLStart->list().insert(iMBLStart->list().end(), std::make_move_iterator(mell.begin()), std::make_move_iterator(mell.end()));
+                    mell.clear();
+                }
             }
         }
         else
@@ -1265,7 +1182,10 @@ void MergeResultWindow::slotMergeHistory()
                 HistoryMapEntry& hme = (*hlit)->second;
                 MergeEditLineList& mell = hme.choice(m_pldC != nullptr);
                 if(!mell.empty())
-                    iMBLStart->list().splice(iMBLStart->list().end(), mell, mell.begin(), mell.end());
+                {
+                    iMBLStart->list().insert(iMBLStart->list().end(), std::make_move_iterator(mell.begin()), std::make_move_iterator(mell.end()));
+                    mell.clear();
+                }
             }
             // If the end of start is empty and the first line at the end is empty remove the last line of start
             if(!iMBLStart->list().empty() && !iMBLEnd->list().empty())
@@ -1286,9 +1206,13 @@ void MergeResultWindow::slotRegExpAutoMerge()
     if(m_pOptions->m_autoMergeRegExp.isEmpty())
         return;
 
-    QRegularExpression vcsKeywords(m_pOptions->m_autoMergeRegExp);
+    const QRegularExpression vcsKeywords(m_pOptions->m_autoMergeRegExp);
+    // The same expression is matched against every line of every conflict.
+    vcsKeywords.optimize();
+
+    MergeBlockListImp& mergeBlocks = m_mergeBlockList.list();
     MergeBlockListImp::iterator i;
-    for(i = m_mergeBlockList.list().begin(); i != m_mergeBlockList.list().end(); ++i)
+    for(i = mergeBlocks.begin(); i != mergeBlocks.end(); ++i)
     {
         if(i->isConflict())
         {
@@ -1299,10 +1223,14 @@ void MergeResultWindow::slotRegExpAutoMerge()
             {
                 MergeEditLine& mel = *i->list().begin();
                 mel.setSource(m_pldC == nullptr ? e_SrcSelector::B : e_SrcSelector::C, false);
-                m_mergeBlockList.splitAtDiff3LineIdx(i->getIndex() + 1);
+                // Split right here, searching the list for the block again made this quadratic.
+                // The rest of the conflict follows i and is checked next.
+                if(i->sourceRangeLength() > 1)
+                    m_mergeBlockList.split(i, i->getIndex() + 1);
             }
         }
     }
+    invalidateBlockIndex();
     update();
 }
 
@@ -1329,6 +1257,7 @@ bool MergeResultWindow::doRelevantChangesExist()
 
 void MergeResultWindow::slotSplitDiff(int firstD3lLineIdx, int lastD3lLineIdx)
 {
+    invalidateBlockIndex();
     if(lastD3lLineIdx >= 0)
         m_mergeBlockList.splitAtDiff3LineIdx(lastD3lLineIdx + 1);
     setFastSelector(m_mergeBlockList.splitAtDiff3LineIdx(firstD3lLineIdx));
@@ -1374,6 +1303,7 @@ void MergeResultWindow::slotJoinDiffs(int firstD3lLineIdx, int lastD3lLineIdx)
         // Insert a conflict line as placeholder
         iMBLStart->list().push_back(MergeEditLine(iMBLStart->id3l()));
     }
+    invalidateBlockIndex();
     setFastSelector(iMBLStart);
 }
 
@@ -1407,6 +1337,7 @@ void MergeResultWindow::timerEvent(QTimerEvent*)
 
 QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(LineRef line, const QString& str, QTextLayout& textLayout)
 {
+    PaintBenchmark::countLayout();
     // tabs
     QTextOption textOption;
 
@@ -1429,12 +1360,27 @@ QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(LineRe
         formats.append(formatRange);
         textLayout.setFormats(formats);
     }
-    QVector<QTextLayout::FormatRange> selectionFormat;
+    const QVector<QTextLayout::FormatRange> selectionFormat = getSelectionFormat(line);
     textLayout.beginLayout();
+    QTextLine textLine = textLayout.createLine();
+    textLine.setPosition(QPointF(0, fontMetrics().leading()));
+    textLayout.endLayout();
+    int cursorWidth = 5;
+    if(m_pOptions->m_bRightToLeftLanguage)
+        textLayout.setPosition(QPointF(width() - textLayout.maximumWidth() - getTextXOffset() + m_horizScrollOffset - cursorWidth, 0));
+    else
+        textLayout.setPosition(QPointF(getTextXOffset() - m_horizScrollOffset, 0));
+    return selectionFormat;
+}
+
+QVector<QTextLayout::FormatRange> MergeResultWindow::getSelectionFormat(LineRef line)
+{
+    QVector<QTextLayout::FormatRange> selectionFormat;
+    const Selection::Span selected = m_selection.spanInLine(line);
     if(m_selection.lineWithin(line))
     {
-        QtSizeType firstPosInText = m_selection.firstPosInLine(line);
-        QtSizeType lastPosInText = m_selection.lastPosInLine(line);
+        QtSizeType firstPosInText = selected.begin;
+        QtSizeType lastPosInText = selected.end;
 
         QtSizeType lengthInText = std::max(0, lastPosInText - firstPosInText);
         assert(lengthInText <= limits<int>::max());
@@ -1448,20 +1394,12 @@ QVector<QTextLayout::FormatRange> MergeResultWindow::getTextLayoutForLine(LineRe
         selection.format.setForeground(palette().highlightedText().color());
         selectionFormat.push_back(selection);
     }
-    QTextLine textLine = textLayout.createLine();
-    textLine.setPosition(QPointF(0, fontMetrics().leading()));
-    textLayout.endLayout();
-    int cursorWidth = 5;
-    if(m_pOptions->m_bRightToLeftLanguage)
-        textLayout.setPosition(QPointF(width() - textLayout.maximumWidth() - getTextXOffset() + m_horizScrollOffset - cursorWidth, 0));
-    else
-        textLayout.setPosition(QPointF(getTextXOffset() - m_horizScrollOffset, 0));
     return selectionFormat;
 }
 
 void MergeResultWindow::writeLine(
     RLPainter& p, int line, const QString& str,
-    e_SrcSelector srcSelect, e_MergeDetails mergeDetails, int rangeMark, bool bUserModified, bool bLineRemoved, bool bWhiteSpaceConflict)
+    e_SrcSelector srcSelect, e_MergeDetails mergeDetails, int rangeMark, bool bUserModified, e_SrcSelector matchingSrc, bool bLineRemoved, bool bWhiteSpaceConflict)
 {
     const QFontMetrics& fm = fontMetrics();
     int fontHeight = fm.lineSpacing();
@@ -1477,7 +1415,14 @@ void MergeResultWindow::writeLine(
     yOffset += topLineYOffset;
 
     QString srcName = QChar(' ');
-    if(bUserModified)
+    // A modified line that is a copy of an input line shows that input in lower case.
+    if(bUserModified && matchingSrc == e_SrcSelector::A)
+        srcName = QStringLiteral("a");
+    else if(bUserModified && matchingSrc == e_SrcSelector::B)
+        srcName = QStringLiteral("b");
+    else if(bUserModified && matchingSrc == e_SrcSelector::C)
+        srcName = QStringLiteral("c");
+    else if(bUserModified)
         srcName = QChar('m');
     else if(srcSelect == e_SrcSelector::A && mergeDetails != e_MergeDetails::eNoChange)
         srcName = QStringLiteral("A");
@@ -1500,15 +1445,26 @@ void MergeResultWindow::writeLine(
 
         p.setPen(m_pOptions->foregroundColor());
 
-        QTextLayout textLayout(str, font(), this);
-        QVector<QTextLayout::FormatRange> selectionFormat = getTextLayoutForLine(line, str, textLayout);
-        textLayout.draw(&p, QPointF(0, yOffset), selectionFormat);
+        if(QFontInfo(font()).fixedPitch() && !m_pOptions->m_bShowWhiteSpaceCharacters && !m_pOptions->m_bRightToLeftLanguage && MonospaceText::isSimple(str))
+        {
+            const MonospaceText text(str, getSelectionFormat(line), m_pOptions->foregroundColor(), m_pOptions->m_tabSize, font());
+            text.draw(p, xOffset - m_horizScrollOffset, yOffset);
 
-        if(line == m_cursorYPos)
+            if(line == m_cursorYPos)
+                m_cursorXPixelPos = LineData::width(str.left(m_cursorXPos), m_pOptions->m_tabSize) * Utils::getHorizontalAdvance(fm, '0');
+        }
+        else
         {
-            m_cursorXPixelPos = qCeil(textLayout.lineAt(0).cursorToX(m_cursorXPos));
-            if(m_pOptions->m_bRightToLeftLanguage)
-                m_cursorXPixelPos += qCeil(textLayout.position().x() - m_horizScrollOffset);
+            QTextLayout textLayout(str, font(), this);
+            QVector<QTextLayout::FormatRange> selectionFormat = getTextLayoutForLine(line, str, textLayout);
+            textLayout.draw(&p, QPointF(0, yOffset), selectionFormat);
+
+            if(line == m_cursorYPos)
+            {
+                m_cursorXPixelPos = qCeil(textLayout.lineAt(0).cursorToX(m_cursorXPos));
+                if(m_pOptions->m_bRightToLeftLanguage)
+                    m_cursorXPixelPos += qCeil(textLayout.position().x() - m_horizScrollOffset);
+            }
         }
 
         p.setClipping(false);
@@ -1580,8 +1536,9 @@ void MergeResultWindow::setPaintingAllowed(bool bPaintingAllowed)
         update();
 }
 
-void MergeResultWindow::paintEvent(QPaintEvent*)
+void MergeResultWindow::paintEvent(QPaintEvent* e)
 {
+    TraceScope traceScope(TraceStage::paint);
     if(m_pDiff3LineList == nullptr)
         return;
 
@@ -1589,29 +1546,41 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
     const QFontMetrics& fm = fontMetrics();
     int fontWidth = Utils::getHorizontalAdvance(fm, '0');
 
-    if(!m_bCursorUpdate) // Don't redraw everything for blinking cursor?
+    // Don't redraw everything for blinking cursor, unless lines were scrolled in and are still missing.
+    if(!m_bCursorUpdate || !m_pixmapDirtyRect.isEmpty())
     {
-        m_selection.bSelectionContainsData = false;
         const auto dpr = devicePixelRatioF();
+        QRect paintRect = e->rect() | m_pixmapDirtyRect;
         if(size() * dpr != m_pixmap.size())
         {
             m_pixmap = QPixmap(size() * dpr);
             m_pixmap.setDevicePixelRatio(dpr);
+            paintRect = rect();
         }
+        m_pixmapDirtyRect = QRect();
+
+        // Lines outside paintRect aren't visited, so whatever they found of the selection remains valid.
+        const bool bFullPaint = paintRect.contains(rect());
+        if(bFullPaint)
+            m_selection.bSelectionContainsData = false;
 
         RLPainter p(&m_pixmap, m_pOptions->m_bRightToLeftLanguage, width(), fontWidth);
         p.setFont(font());
-        p.QPainter::fillRect(rect(), m_pOptions->backgroundColor());
-
-        //int visibleLines = height() / fontHeight;
+        p.setClipRect(paintRect);
+        p.QPainter::fillRect(paintRect, m_pOptions->backgroundColor());
 
+        const int fontHeight = fm.lineSpacing();
+        // Neighbouring lines may draw a little into the rect, not just the lines it covers.
+        const int firstVisibleLine = bFullPaint ? (int)m_firstLine : m_firstLine + paintRect.top() / fontHeight - 1;
         int lastVisibleLine = m_firstLine + getNofVisibleLines() + 5;
+        if(!bFullPaint)
+            lastVisibleLine = std::min(lastVisibleLine, m_firstLine + paintRect.bottom() / fontHeight + 1);
         LineRef line = 0;
         MergeBlockListImp::const_iterator mbIt = m_mergeBlockList.list().cbegin();
         for(; mbIt != m_mergeBlockList.list().cend(); ++mbIt)
         {
             const MergeBlock& mb = *mbIt;
-            if(line > lastVisibleLine || line + mb.lineCount() < m_firstLine)
+            if(line > lastVisibleLine || line + mb.lineCount() < firstVisibleLine)
             {
                 line += mb.lineCount();
             }
@@ -1620,7 +1589,7 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
                 MergeEditLineList::const_iterator melIt;
                 for(melIt = mb.list().cbegin(); melIt != mb.list().cend(); ++melIt)
                 {
-                    if(line >= m_firstLine && line <= lastVisibleLine)
+                    if(line >= firstVisibleLine && line <= lastVisibleLine)
                     {
                         const MergeEditLine& mel = *melIt;
                         MergeEditLineList::const_iterator melIt1 = melIt;
@@ -1635,7 +1604,7 @@ void MergeResultWindow::paintEvent(QPaintEvent*)
                         const QString s = mel.getString(m_pldA, m_pldB, m_pldC);
 
                         writeLine(p, line, s, mel.src(), mb.details(), rangeMark,
-                                  mel.isModified(), mel.isRemoved(), mb.isWhiteSpaceConflict());
+                                  mel.isModified(), mel.matchingSource(), mel.isRemoved(), mb.isWhiteSpaceConflict());
                     }
                     ++line;
                 }
@@ -1753,17 +1722,10 @@ void MergeResultWindow::mousePressEvent(QMouseEvent* e)
         m_cursorXPos = 0;
         m_cursorOldXPixelPos = 0;
         m_cursorYPos = line;
-        LineType l = 0;
-        MergeBlockListImp::iterator i = m_mergeBlockList.list().begin();
-        for(i = m_mergeBlockList.list().begin(); i != m_mergeBlockList.list().end(); ++i)
-        {
-            if(l == line)
-                break;
-
-            l += i->lineCount();
-            if(l > line)
-                break;
-        }
+        const MergeBlockIndex& index = blockIndex();
+        const size_t ordinal = index.ordinalOfLine(line);
+        // Erasing the empty range turns the const_iterator into an iterator.
+        const MergeBlockListImp::iterator i = ordinal < index.size() ? m_mergeBlockList.list().erase(index.block(ordinal), index.block(ordinal)) : m_mergeBlockList.list().end();
         m_selection.reset(); // Disable current selection
 
         m_bCursorOn = true;
@@ -2367,13 +2329,19 @@ bool MergeResultWindow::calcIteratorFromLineNr(
 
 QString MergeResultWindow::getSelection() const
 {
-    QString selectionString;
+    return getSelectionText().toString();
+}
+
+SelectionText MergeResultWindow::getSelectionText() const
+{
+    SelectionText selectionText;
 
     LineRef line = 0;
     for(const MergeBlock& mb: m_mergeBlockList.list())
     {
         for(const MergeEditLine& mel: mb.list())
         {
+            const Selection::Span selected = m_selection.spanInLine(line);
             if(m_selection.lineWithin(line))
             {
                 int outPos = 0;
@@ -2381,8 +2349,11 @@ QString MergeResultWindow::getSelection() const
                 {
                     const QString str = mel.getString(m_pldA, m_pldB, m_pldC);
 
-                    // Consider tabs
-                    for(int i = 0; i < str.length(); ++i)
+                    // Consider tabs, the selected characters are the ones whose column is in the span.
+                    const bool bWholeLine = selected.begin == 0 && selected.end == limits<QtSizeType>::max();
+                    QtSizeType first = bWholeLine ? 0 : str.length();
+                    QtSizeType last = bWholeLine ? str.length() : 0;
+                    for(int i = 0; !bWholeLine && i < str.length(); ++i)
                     {
                         int spaces = 1;
                         if(str[i] == '\t')
@@ -2390,25 +2361,32 @@ QString MergeResultWindow::getSelection() const
                             spaces = tabber(outPos, m_pOptions->m_tabSize);
                         }
 
-                        if(m_selection.within(line, outPos))
+                        if(selected.contains(outPos))
                         {
-                            selectionString += str[i];
+                            first = std::min<QtSizeType>(first, i);
+                            last = i + 1;
                         }
 
                         outPos += spaces;
                     }
+
+                    if(first < last)
+                    {
+                        const std::optional<LineData> lineData = mel.getLineData(m_pldA, m_pldB, m_pldC);
+                        if(lineData.has_value())
+                            selectionText.append(lineData.value(), first, last - first);
+                        else
+                            selectionText.append(str.mid(first, last - first));
+                    }
                 }
                 else if(mel.isConflict())
                 {
-                    selectionString += i18n("<Merge Conflict>");
+                    selectionText.append(i18n("<Merge Conflict>"));
                 }
 
-                if(m_selection.within(line, outPos))
+                if(selected.contains(outPos))
                 {
-#ifdef Q_OS_WIN
-                    selectionString += '\r';
-#endif
-                    selectionString += '\n';
+                    selectionText.appendLineEnd();
                 }
             }
 
@@ -2416,7 +2394,7 @@ QString MergeResultWindow::getSelection() const
         }
     }
 
-    return selectionString;
+    return selectionText;
 }
 
 bool MergeResultWindow::deleteSelection2(QString& s, int& x, int& y,
@@ -2487,12 +2465,11 @@ void MergeResultWindow::deleteSelection()
     for(mbIt = m_mergeBlockList.list().begin(); mbIt != m_mergeBlockList.list().end(); ++mbIt)
     {
         MergeBlock& mb = *mbIt;
-        MergeEditLineList::iterator melIt, melIt1;
+        MergeEditLineList::iterator melIt;
         for(melIt = mb.list().begin(); melIt != mb.list().end();)
         {
             const MergeEditLine& mel = *melIt;
-            melIt1 = melIt;
-            ++melIt1;
+            bool bErased = false;
 
             if(mel.isEditableText() && m_selection.lineWithin(line))
             {
@@ -2521,14 +2498,18 @@ void MergeResultWindow::deleteSelection()
                 {
                     // Remove the line
                     if(mb.lineCount() > 1)
-                        mb.list().erase(melIt);
+                    {
+                        melIt = mb.list().erase(melIt);
+                        bErased = true;
+                    }
                     else
                         melIt->setRemoved();
                 }
             }
 
             ++line;
-            melIt = melIt1;
+            if(!bErased)
+                ++melIt;
         }
     }
 
@@ -2544,55 +2525,46 @@ void MergeResultWindow::pasteClipboard(bool bFromSelection)
     //checking of m_selection if needed is done by deleteSelection no need for check here.
     deleteSelection();
 
+    // Taken before setModified() invalidates it.
+    const bool bIndexValid = mBlockIndex.isValid();
     setModified();
 
     int y = m_cursorYPos;
     MergeBlockListImp::iterator mbIt;
-    MergeEditLineList::iterator melIt, melItAfter;
+    MergeEditLineList::iterator melIt;
     if (!calcIteratorFromLineNr(y, mbIt, melIt))
     {
         return;
     }
-    melItAfter = melIt;
-    ++melItAfter;
     const QString str = melIt->getString(m_pldA, m_pldB, m_pldC);
-    int x = m_cursorXPos;
+    QtSizeType x = m_cursorXPos;
 
     if(!QApplication::clipboard()->supportsSelection())
         bFromSelection = false;
 
     const QString clipBoard = QApplication::clipboard()->text(bFromSelection ? QClipboard::Selection : QClipboard::Clipboard);
 
-    QString currentLine = str.left(x);
-    const QString endOfLine = str.mid(x);
-    QtSizeType i;
-    const QtSizeType len = clipBoard.length();
-    for(i = 0; i < len; ++i)
+    // A paste doesn't change the kind of the block, so the index only needs the lines behind it moved.
+    const size_t ordinal = bIndexValid ? mBlockIndex.ordinal(mbIt) : 0;
+    const bool bWasUnsolved = mbIt->list().cbegin()->isConflict();
+
+    const LineType nofNewLines = mbIt->insertText(melIt, str, x, clipBoard);
+    if(bIndexValid && ordinal < mBlockIndex.size() && mbIt->list().cbegin()->isConflict() == bWasUnsolved)
+        mBlockIndex.insertLines(ordinal, nofNewLines);
+
+    // Only the pasted lines can make the text wider.
+    if(m_maxTextWidth >= 0)
     {
-        QChar c = clipBoard[i];
-        if(c == '\n' || (c == '\r' && clipBoard[i + 1] != '\n'))
-        {
-            melIt->setString(currentLine);
-            MergeEditLine mel(mbIt->id3l()); // Associate every mel with an id3l, even if not really valid.
-            melIt = mbIt->list().insert(melItAfter, mel);
-            currentLine = "";
-            x = 0;
-            ++y;
-        }
-        else
+        const int width = getMaxTextWidth(melIt - nofNewLines, melIt + 1) + 5; // cursorwidth
+        if(width > m_maxTextWidth)
         {
-            if(c == '\r') continue;
-
-            currentLine += c;
-            ++x;
+            m_maxTextWidth = width;
+            Q_EMIT resizeSignal();
         }
     }
 
-    currentLine += endOfLine;
-    melIt->setString(currentLine);
-
-    m_cursorYPos = y;
-    m_cursorXPos = x;
+    m_cursorYPos = y + nofNewLines;
+    m_cursorXPos = SafeInt<QtNumberType>(x);
     m_cursorOldXPixelPos = m_cursorXPixelPos;
 
     update();
@@ -2606,6 +2578,12 @@ void MergeResultWindow::resetSelection()
 
 void MergeResultWindow::setModified(bool bModified)
 {
+    invalidateBlockIndex();
+
+    // Edits call this first, so the comparison runs after the edit is done.
+    if(bModified)
+        mEditMatchTimer.start(300 /*ms*/);
+
     if(bModified != m_bModified)
     {
         m_bModified = bModified;
@@ -2613,6 +2591,31 @@ void MergeResultWindow::setModified(bool bModified)
     }
 }
 
+// Each block remembers its state from the last run, only blocks edited since are diffed again.
+void MergeResultWindow::slotUpdateEditMatches()
+{
+    if(m_pldA == nullptr || m_pldB == nullptr)
+        return;
+
+    DiffContext context(DiffSettings(*m_pOptions));
+    bool bChanged = false;
+    for(MergeBlock& mb: m_mergeBlockList.list())
+    {
+        if(mb.updateEditMatches(m_pldA, m_pldB, m_pldC, context))
+            bChanged = true;
+    }
+
+    if(bChanged)
+        update();
+}
+
+bool MergeResultWindow::writeConflictMarkers(FileAccess& file, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle, const QString& labelA, const QString& labelB, const QString& labelC)
+{
+    MergeResultWriter writer(m_mergeBlockList, pEncoding, eLineEndStyle, m_pldA, m_pldB, m_pldC);
+    writer.setConflictMarkers(labelA, labelB, labelC);
+    return writer.write(file);
+}
+
 /// Saves and returns true when successful.
 bool MergeResultWindow::saveDocument(const QString& fileName, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle)
 {
@@ -2638,54 +2641,12 @@ bool MergeResultWindow::saveDocument(const QString& fileName, QTextCodec* pEncod
     update();
 
     FileAccess file(fileName, true /*bWantToWrite*/);
-    if(m_pOptions->m_bDmCreateBakFiles && file.exists())
-    {
-        bool bSuccess = file.createBackup(".orig");
-        if(!bSuccess)
-        {
-            KMessageBox::error(this, file.getStatusText() + i18n("\n\nCreating backup failed. File not saved."), i18n("File Save Error"));
-            return false;
-        }
-    }
-
-    QByteArray dataArray;
-    QTextStream textOutStream(&dataArray, QIODevice::WriteOnly);
-    if(pEncoding->name() == "UTF-8")
-        textOutStream.setGenerateByteOrderMark(false); // Shouldn't be necessary. Bug in Qt or docs
-    else
-        textOutStream.setGenerateByteOrderMark(true); // Only for UTF-16
-    textOutStream.setCodec(pEncoding);
-
-    // Determine the line feed for this file
-    const QString lineFeed(eLineEndStyle == eLineEndStyleDos ? QString("\r\n") : QString("\n"));
-
-    int line = 0;
-    for(const MergeBlock& mb: m_mergeBlockList.list())
-    {
-        for(const MergeEditLine& mel: mb.list())
-        {
-            if(mel.isEditableText())
-            {
-                const QString str = mel.getString(m_pldA, m_pldB, m_pldC);
-
-                if(line > 0 && !mel.isRemoved())
-                {
-                    // Put line feed between lines, but not for the first line
-                    // or between lines that have been removed (because there
-                    // isn't a line there).
-                    textOutStream << lineFeed;
-                }
-
-                textOutStream << str;
-                ++line;
-            }
-        }
-    }
-    textOutStream.flush();
-    bool bSuccess = file.writeFile(dataArray.data(), dataArray.size());
+    MergeResultWriter writer(m_mergeBlockList, pEncoding, eLineEndStyle, m_pldA, m_pldB, m_pldC);
+    bool bSuccess = writer.write(file, m_pOptions->m_bDmCreateBakFiles ? QStringLiteral(".orig") : QString());
     if(!bSuccess)
     {
-        KMessageBox::error(this, i18n("Error while writing."), i18n("File Save Error"));
+        const QString statusText = file.getStatusText();
+        KMessageBox::error(this, statusText.isEmpty() ? i18n("Error while writing.") : statusText + i18n("\n\nFile not saved."), i18n("File Save Error"));
         return false;
     }
 
@@ -2706,28 +2667,70 @@ QString MergeResultWindow::getString(int lineIdx)
     return melIt->getString(m_pldA, m_pldB, m_pldC);
 }
 
+/*
+    Walks the merge blocks once. Looking up each line by number with getString() would restart
+    from the first block for every line searched.
+*/
 bool MergeResultWindow::findString(const QString& s, LineRef& d3vLine, QtSizeType& posInLine, bool bDirDown, bool bCaseSensitive)
 {
-    int it = d3vLine;
-    int endIt = bDirDown ? getNofLines() : -1;
-    int step = bDirDown ? 1 : -1;
+    const Qt::CaseSensitivity cs = bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
     QtSizeType startPos = posInLine;
 
-    for(; it != endIt; it += step)
+    const auto findInLine = [&](const MergeEditLine& mel, LineType line) {
+        const QString str = mel.getString(m_pldA, m_pldB, m_pldC);
+        if(str.isEmpty())
+            return false;
+
+        const QtSizeType pos = str.indexOf(s, startPos, cs);
+        if(pos != -1)
+        {
+            d3vLine = line;
+            posInLine = pos;
+            return true;
+        }
+
+        startPos = 0;
+        return false;
+    };
+
+    if(bDirDown)
     {
-        QString line = getString(it);
-        if(!line.isEmpty())
+        LineType line = 0;
+        for(const MergeBlock& mb: m_mergeBlockList.list())
         {
-            QtSizeType pos = line.indexOf(s, startPos, bCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+            if(line + mb.lineCount() <= d3vLine)
+            {
+                line += mb.lineCount();
+                continue;
+            }
 
-            if(pos != -1)
+            for(const MergeEditLine& mel: mb.list())
             {
-                d3vLine = it;
-                posInLine = pos;
-                return true;
+                if(line >= d3vLine && findInLine(mel, line))
+                    return true;
+                ++line;
             }
+        }
+        return false;
+    }
 
-            startPos = 0;
+    LineType line = 0;
+    for(const MergeBlock& mb: m_mergeBlockList.list())
+        line += mb.lineCount();
+
+    for(auto mbIt = m_mergeBlockList.list().crbegin(); mbIt != m_mergeBlockList.list().crend(); ++mbIt)
+    {
+        if(line - mbIt->lineCount() > d3vLine)
+        {
+            line -= mbIt->lineCount();
+            continue;
+        }
+
+        for(auto melIt = mbIt->list().crbegin(); melIt != mbIt->list().crend(); ++melIt)
+        {
+            --line;
+            if(line <= d3vLine && findInLine(*melIt, line))
+                return true;
         }
     }
     return false;
@@ -13,10 +13,13 @@
 
 #include "diff.h"
 #include "FileNameLineEdit.h"
+#include "HistorySortKey.h"
+#include "MergeBlockIndex.h"
 #include "MergeEditLine.h"
 #include "options.h"
 #include "Overview.h"
 #include "selection.h"
+#include "SelectionText.h"
 #include "LineRef.h"
 #include "TypeUtils.h"
 
@@ -25,12 +28,14 @@
 
 #include <QLineEdit>
 #include <QPointer>
+#include <QRegularExpression>
 #include <QSharedPointer>
 #include <QStatusBar>
 #include <QTextLayout>
 #include <QTimer>
 #include <QWidget>
 
+class FileAccess;
 class QPainter;
 class RLPainter;
 class QScrollBar;
@@ -64,6 +69,8 @@ class MergeResultWindow: public QWidget
     void reset();
 
     bool saveDocument(const QString& fileName, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle);
+    // Writes the merge as it is now, unsolved conflicts with markers like diff3 -m.
+    bool writeConflictMarkers(FileAccess& file, QTextCodec* pEncoding, e_LineEndStyle eLineEndStyle, const QString& labelA, const QString& labelB, const QString& labelC);
     [[nodiscard]] int getNumberOfUnsolvedConflicts(int* pNrOfWhiteSpaceConflicts = nullptr) const;
     void choose(e_SrcSelector selector);
     void chooseGlobal(e_SrcSelector selector, bool bConflictsOnly, bool bWhiteSpaceOnly);
@@ -73,6 +80,7 @@ class MergeResultWindow: public QWidget
     [[nodiscard]] int getVisibleTextAreaWidth() const; // text area width without the border
     [[nodiscard]] int getNofVisibleLines() const;
     [[nodiscard]] QString getSelection() const;
+    [[nodiscard]] SelectionText getSelectionText() const;
     void resetSelection();
     void showNumberOfConflicts(bool showIfNone = false);
     [[nodiscard]] bool isDeltaAboveCurrent() const;
@@ -80,12 +88,15 @@ class MergeResultWindow: public QWidget
     [[nodiscard]] bool isConflictAboveCurrent() const;
     [[nodiscard]] bool isConflictBelowCurrent() const;
     [[nodiscard]] bool isUnsolvedConflictAtCurrent() const;
+    // Whether the output was edited since init().
+    [[nodiscard]] bool isModified() const { return m_bModified; }
     [[nodiscard]] bool isUnsolvedConflictAboveCurrent() const;
     [[nodiscard]] bool isUnsolvedConflictBelowCurrent() const;
     bool findString(const QString& s, LineRef& d3vLine, QtSizeType& posInLine, bool bDirDown, bool bCaseSensitive);
     void setSelection(LineType firstLine, QtSizeType startPos, LineType lastLine, QtSizeType endPos);
     [[nodiscard]] e_OverviewMode getOverviewMode() const;
 
+    // Deferred like KDiff3App::slotUpdateAvailabilities.
     void slotUpdateAvailabilities();
 
   public Q_SLOTS:
@@ -190,9 +201,17 @@ class MergeResultWindow: public QWidget
         bool staysInPlace(bool bThreeInputs, Diff3LineList::const_iterator& iHistoryEnd);
     };
     typedef std::map<QString, HistoryMapEntry> HistoryMap;
-    void collectHistoryInformation(e_SrcSelector src, const HistoryRange& historyRange, HistoryMap& historyMap, std::list<HistoryMap::iterator>& hitList);
+    // Compiled once per history merge and shared by the inputs.
+    struct HistoryPatterns {
+        QRegularExpression historyStart;
+        QRegularExpression entryStart;
+        HistorySortKey sortKey;
+        bool bUseRegExp;
+    };
+    void collectHistoryInformation(e_SrcSelector src, const HistoryRange& historyRange, const HistoryPatterns& patterns, HistoryMap& historyMap, std::list<HistoryMap::iterator>& hitList);
 
     MergeBlockList m_mergeBlockList;
+    MergeBlockList m_builtMergeBlockList; // As built from m_pDiff3LineList, before any choices were applied.
     MergeBlockListImp::iterator m_currentMergeBlockIt;
     bool isItAtEnd(bool bIncrement, const MergeBlockListImp::const_iterator i) const
     {
@@ -204,6 +223,10 @@ class MergeResultWindow: public QWidget
 
     int m_currentPos;
     bool checkOverviewIgnore(const MergeBlockListImp::const_iterator i) const;
+    // Built again on first use after the blocks changed, see invalidateBlockIndex().
+    mutable MergeBlockIndex mBlockIndex;
+    [[nodiscard]] const MergeBlockIndex& blockIndex() const;
+    void invalidateBlockIndex() { mBlockIndex.invalidate(); }
 
     enum e_Direction
     {
@@ -228,11 +251,13 @@ class MergeResultWindow: public QWidget
 
     int getTextXOffset() const;
     QVector<QTextLayout::FormatRange> getTextLayoutForLine(LineRef line, const QString& s, QTextLayout& textLayout);
+    // Highlight of the part of the line that is selected, empty if nothing is.
+    QVector<QTextLayout::FormatRange> getSelectionFormat(LineRef line);
     void myUpdate(int afterMilliSecs);
     void timerEvent(QTimerEvent*) override;
     void writeLine(
         RLPainter& p, int line, const QString& str,
-        enum e_SrcSelector srcSelect, e_MergeDetails mergeDetails, int rangeMark, bool bUserModified, bool bLineRemoved, bool bWhiteSpaceConflict
+        enum e_SrcSelector srcSelect, e_MergeDetails mergeDetails, int rangeMark, bool bUserModified, e_SrcSelector matchingSrc, bool bLineRemoved, bool bWhiteSpaceConflict
     );
     void setFastSelector(MergeBlockListImp::iterator i);
     LineRef convertToLine(QtNumberType y);
@@ -246,10 +271,12 @@ class MergeResultWindow: public QWidget
     void wheelEvent(QWheelEvent* pWheelEvent) override;
     void focusInEvent(QFocusEvent* e) override;
 
-    bool canCut() { return hasFocus() && !getSelection().isEmpty(); }
-    bool canCopy() { return hasFocus() && !getSelection().isEmpty(); }
+    // Cheap enough for every availability update, unlike building the selected text.
+    bool canCut() { return hasFocus() && !m_selection.isEmpty(); }
+    bool canCopy() { return hasFocus() && !m_selection.isEmpty(); }
 
     QPixmap m_pixmap;
+    QRect m_pixmapDirtyRect; // Scrolled into view but not yet painted into m_pixmap.
     LineRef m_firstLine = 0;
     int m_horizScrollOffset = 0;
     LineType m_nofLines = 0;
@@ -268,6 +295,9 @@ class MergeResultWindow: public QWidget
     bool m_bCursorOn = true; // blinking on and off each second
     QTimer m_cursorTimer;
     bool m_bCursorUpdate = false;
+    QTimer mEditMatchTimer; // Compares edited lines with the inputs once typing pauses.
+    QTimer mAvailabilitiesTimer;
+    void recalcAvailabilities();
     QStatusBar* m_pStatusBar;
 
     Selection m_selection;
@@ -275,6 +305,8 @@ class MergeResultWindow: public QWidget
     bool deleteSelection2(QString& str, int& x, int& y,
                           MergeBlockListImp::iterator& mbIt, MergeEditLineList::iterator& melIt);
     bool doRelevantChangesExist();
+    // Width of the longest of these lines.
+    [[nodiscard]] int getMaxTextWidth(const MergeEditLineList::const_iterator first, const MergeEditLineList::const_iterator last);
 
     /*
       This list exists solely to auto disconnect boost signals.
@@ -285,6 +317,7 @@ class MergeResultWindow: public QWidget
     void pasteClipboard(bool bFromSelection);
   private Q_SLOTS:
     void slotCursorUpdate();
+    void slotUpdateEditMatches();
 };
 
 class QLineEdit;
@@ -13,6 +13,8 @@
 #include "ui_scroller.h"
 
 #include "common.h"
+#include "ConfigValueMap.h"
+#include "diff.h"
 #include "defmac.h"
 #include "smalldialogs.h"
 #include "TypeUtils.h"
@@ -29,7 +31,6 @@
 #include <QCheckBox>
 #include <QComboBox>
 #include <QDialogButtonBox>
-#include <QFontDatabase>
 #include <QFontDialog>
 #include <QFrame>
 #include <QGridLayout>
@@ -157,6 +158,7 @@ class OptionColorButton: public KColorButton, public OptionColor
 
 class OptionLineEdit: public QComboBox, public OptionString
 {
+    Q_OBJECT
   public:
     OptionLineEdit(const QString& defaultVal, const QString& saveName, QString* pVar,
                    QWidget* pParent):
@@ -199,6 +201,14 @@ class OptionLineEdit: public QComboBox, public OptionString
         insertItems(0, m_list);
     }
 
+    // Only the entries offered, the value itself was already read.
+    void readHistory(ValueMap* config)
+    {
+        m_list = config->readEntry(m_saveName, QStringList(m_defaultVal));
+        clear();
+        insertItems(0, m_list);
+    }
+
   private:
     void insertText()
     { // Check if the text exists. If yes remove it and push it in as first element
@@ -491,8 +501,9 @@ class OptionEncodingComboBox: public QComboBox, public OptionCodec
     int m_preservedVal;
 };
 
-OptionDialog::OptionDialog(bool bShowDirMergeSettings, QWidget* parent):
-    KPageDialog(parent)
+OptionDialog::OptionDialog(bool bShowDirMergeSettings, const QSharedPointer<Options>& options, QWidget* parent):
+    KPageDialog(parent),
+    m_options(options)
 {
     setFaceType(List);
     setWindowTitle(i18n("Configure"));
@@ -501,7 +512,6 @@ OptionDialog::OptionDialog(bool bShowDirMergeSettings, QWidget* parent):
     setModal(true);
     setMinimumSize(600, 500);
 
-    m_options->init();
     setupFontPage();
     setupColorPage();
     setupEditPage();
@@ -514,9 +524,14 @@ OptionDialog::OptionDialog(bool bShowDirMergeSettings, QWidget* parent):
     setupRegionalPage();
     setupIntegrationPage();
 
+    // The settings were read before the dialog was built, only the offered entries are missing.
+    ConfigValueMap cvm(KSharedConfig::openConfig()->group(KDIFF3_CONFIG_GROUP));
+    const QList<OptionLineEdit*> lineEdits = findChildren<OptionLineEdit*>();
+    for(OptionLineEdit* pLineEdit: lineEdits)
+        pLineEdit->readHistory(&cvm);
+
     // Initialize all values in the dialog
-    resetToDefaults();
-    slotApply();
+    setState();
     chk_connect_a(button(QDialogButtonBox::Apply), &QPushButton::clicked, this, &OptionDialog::slotApply);
     chk_connect_a(button(QDialogButtonBox::Ok), &QPushButton::clicked, this, &OptionDialog::slotOk);
     chk_connect_a(button(QDialogButtonBox::RestoreDefaults), &QPushButton::clicked, this, &OptionDialog::slotDefault);
@@ -547,16 +562,12 @@ void OptionDialog::setupFontPage()
     QVBoxLayout* topLayout = new QVBoxLayout(page);
     topLayout->setContentsMargins(5, 5, 5, 5);
 
-    //requires QT 5.2 or later.
-    static const QFont defaultFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
-    static QFont defaultAppFont = QApplication::font();
-
-    OptionFontChooser* pAppFontChooser = new OptionFontChooser(defaultAppFont, "ApplicationFont", &m_options->mAppFont, page);
+    OptionFontChooser* pAppFontChooser = new OptionFontChooser(Options::defaultAppFont(), "ApplicationFont", &m_options->mAppFont, page);
 
     topLayout->addWidget(pAppFontChooser);
     pAppFontChooser->setTitle(i18n("Application font"));
 
-    OptionFontChooser* pFontChooser = new OptionFontChooser(defaultFont, "Font", &m_options->mFont, page);
+    OptionFontChooser* pFontChooser = new OptionFontChooser(Options::defaultFixedFont(), "Font", &m_options->mFont, page);
 
     topLayout->addWidget(pFontChooser);
     pFontChooser->setTitle(i18n("File view font"));
@@ -899,6 +910,122 @@ void OptionDialog::setupDiffPage()
         "(Default is off.)"));
     ++line;
 
+    OptionCheckBox* pLazyFineDiff = new OptionCheckBox(i18n("Calculate character differences on demand"), true, "LazyFineDiff", &m_options->m_bLazyFineDiff, page);
+    gbox->addWidget(pLazyFineDiff, line, 0, 1, 2);
+
+    pLazyFineDiff->setToolTip(i18nc("Tool Tip",
+        "Only compare lines that differ character by character when they are shown.\n"
+        "The remaining lines are done in the background, so big files open faster.\n"
+        "(Default is on.)"));
+    ++line;
+
+    OptionCheckBox* pStreamLargeFiles = new OptionCheckBox(i18n("Compare files too large to load piecewise"), true, "StreamLargeFiles", &m_options->m_bStreamLargeFiles, page);
+    gbox->addWidget(pStreamLargeFiles, line, 0, 1, 2);
+
+    pStreamLargeFiles->setToolTip(i18nc("Tool Tip",
+        "When two files are too large to be shown, still compare them a window of lines at a time\n"
+        "and report how many sections differ. Needs local files.\n"
+        "(Default is on.)"));
+    ++line;
+
+    OptionCheckBox* pDecompressInputs = new OptionCheckBox(i18n("Decompress compressed files"), true, "DecompressInputs", &m_options->m_bDecompressInputs, page);
+    gbox->addWidget(pDecompressInputs, line, 0, 1, 2);
+
+    pDecompressInputs->setToolTip(i18nc("Tool Tip",
+        "Files ending in .gz, .xz, .zst or .bz2 are compared by their content instead of\n"
+        "the compressed bytes. A preprocessor command still gets the file as it is.\n"
+        "(Default is on.)"));
+    ++line;
+
+    OptionCheckBox* pCacheDiffResults = new OptionCheckBox(i18n("Remember line matching of compared files"), false, "CacheDiffResults", &m_options->m_bCacheDiffResults, page);
+    gbox->addWidget(pCacheDiffResults, line, 0, 1, 2);
+
+    pCacheDiffResults->setToolTip(i18nc("Tool Tip",
+        "Store which lines match in the cache folder, so comparing the same contents\n"
+        "again with the same options doesn't have to run the diff.\n"
+        "(Default is off.)"));
+    ++line;
+
+    label = new QLabel(i18n("Character diff algorithm:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionComboBox* pFineDiffAlgorithm = new OptionComboBox((int)FineDiffAlgorithm::classic, "FineDiffAlgorithm", &m_options->m_fineDiffAlgorithm, page);
+    gbox->addWidget(pFineDiffAlgorithm, line, 1);
+
+    pFineDiffAlgorithm->insertItem((int)FineDiffAlgorithm::classic, i18nc("Character diff algorithm", "Classic"));
+    pFineDiffAlgorithm->insertItem((int)FineDiffAlgorithm::myers, i18nc("Character diff algorithm", "Myers (bounded)"));
+    label->setToolTip(i18nc("Tool Tip",
+        "Selects how differences within a line are found.\n"
+        "Myers is much faster on very long lines, such as minified sources,\n"
+        "and shows a long line as one changed block if it is too different."));
+    ++line;
+
+    label = new QLabel(i18n("Line matching algorithm:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionComboBox* pLineDiffAlgorithm = new OptionComboBox((int)LineDiffAlgorithm::gnuDiff, "LineDiffAlgorithm", &m_options->m_lineDiffAlgorithm, page);
+    gbox->addWidget(pLineDiffAlgorithm, line, 1);
+
+    pLineDiffAlgorithm->insertItem((int)LineDiffAlgorithm::gnuDiff, i18nc("Line diff algorithm", "GNU diff"));
+    pLineDiffAlgorithm->insertItem((int)LineDiffAlgorithm::histogram, i18nc("Line diff algorithm", "Histogram"));
+    pLineDiffAlgorithm->insertItem((int)LineDiffAlgorithm::patience, i18nc("Line diff algorithm", "Patience"));
+    label->setToolTip(i18nc("Tool Tip",
+        "Selects how matching lines are found.\n"
+        "Histogram is usually faster on big files with many unique lines and\n"
+        "often aligns moved blocks better. Patience favours lines that occur only once."));
+    ++line;
+
+    label = new QLabel(i18n("Time for the first line matching (ms):"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pDiffTimeBudget = new OptionIntEdit(200, "DiffTimeBudget", &m_options->m_diffTimeBudget, 0, 10000, page);
+    gbox->addWidget(pDiffTimeBudget, line, 1);
+
+    label->setToolTip(i18nc("Tool Tip",
+        "When the GNU diff takes longer than this, a quicker but less exact line matching is shown first\n"
+        "and replaced by the complete one when it is ready, unless the merge output was edited meanwhile.\n"
+        "Manual alignments always wait for the complete line matching. 0 disables this. Range: 0-10000 ms"));
+    ++line;
+
+    label = new QLabel(i18n("Show the beginning of inputs larger than (MB):"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pProgressiveLoadSize = new OptionIntEdit(64, "ProgressiveLoadSize", &m_options->m_progressiveLoadSize, 0, 100000, page);
+    gbox->addWidget(pProgressiveLoadSize, line, 1);
+
+    label->setToolTip(i18nc("Tool Tip",
+        "When comparing local files whose sizes add up to more than this, the first few megabytes of each\n"
+        "are compared and shown right away while the files are read completely in the background.\n"
+        "Not used for merges or with a preprocessor command. 0 disables this. Range: 0-100000 MB"));
+    ++line;
+
+    label = new QLabel(i18n("Memory budget per comparison (MB):"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pMemoryBudget = new OptionIntEdit(0, "MemoryBudget", &m_options->m_memoryBudget, 0, 1000000, page);
+    gbox->addWidget(pMemoryBudget, line, 1);
+
+    label->setToolTip(i18nc("Tool Tip",
+        "When the lines and their alignment take more memory than this, the character differences are freed\n"
+        "and only calculated again for the lines shown. The statistics show the memory currently used.\n"
+        "0 disables this. Range: 0-1000000 MB"));
+    ++line;
+
+    label = new QLabel(i18n("Worker threads:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pWorkerThreads = new OptionIntEdit(0, "WorkerThreads", &m_options->m_workerThreads, 0, 256, page);
+    gbox->addWidget(pWorkerThreads, line, 1);
+
+    label->setToolTip(i18nc("Tool Tip",
+        "Threads shared by the diff, the folder comparison and reading ahead.\n"
+        "The diff being shown always goes first. 0 uses one thread per core. Range: 0-256"));
+    ++line;
+
+    label = new QLabel(i18n("Context lines in patches:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionIntEdit* pPatchContextLines = new OptionIntEdit(3, "PatchContextLines", &m_options->m_patchContextLines, 0, 1000, page);
+    gbox->addWidget(pPatchContextLines, line, 1);
+
+    label->setToolTip(i18nc("Tool Tip",
+        "Unchanged lines written before and after every change by \"Write Patch...\".\n"
+        "Range: 0-1000"));
+    ++line;
+
     topLayout->addStretch(10);
 }
 
@@ -1252,6 +1379,71 @@ void OptionDialog::setupDirectoryMergePage()
 
     ++line;
 
+    OptionCheckBox* pUseHashCache = new OptionCheckBox(i18n("Remember contents of unchanged files"), false, "UseHashCache", &m_options->m_bDmUseHashCache, page);
+    gbox->addWidget(pUseHashCache, line, 0, 1, 2);
+    pUseHashCache->setToolTip(i18nc("Tool Tip",
+        "Binary comparison stores a hash of local files found equal.\n"
+        "Later comparisons use it as long as size, dates and inode of both files are unchanged.\n"
+        "Makes reloading big folders much faster."));
+    ++line;
+
+    OptionCheckBox* pWatchFolders = new OptionCheckBox(i18n("Watch folders for changes"), false, "WatchFolders", &m_options->m_bDmWatchFolders, page);
+    gbox->addWidget(pWatchFolders, line, 0, 1, 2);
+    pWatchFolders->setToolTip(i18nc("Tool Tip",
+        "Compares files of local folders again as soon as they are changed.\n"
+        "Added or removed files still need a rescan."));
+    ++line;
+
+    OptionIntEdit* pMaxRemoteJobs = new OptionIntEdit(8, "MaxRemoteJobs", &m_options->m_dmMaxRemoteJobs, 1, 64, page);
+    QLabel* pMaxRemoteJobsLabel = new QLabel(i18n("Parallel remote requests:"), page);
+    pMaxRemoteJobsLabel->setBuddy(pMaxRemoteJobs);
+    gbox->addWidget(pMaxRemoteJobsLabel, line, 0);
+    gbox->addWidget(pMaxRemoteJobs, line, 1);
+    pMaxRemoteJobsLabel->setToolTip(i18nc("Tool Tip",
+        "How many folders are listed or files are copied at the same time on remote locations.\n"
+        "Higher values help on slow networks. Range: 1-64"));
+    ++line;
+
+    OptionCheckBox* pDeltaTransfer = new OptionCheckBox(i18n("Send only changed blocks to remote files"), false, "DeltaTransfer", &m_options->m_bDmDeltaTransfer, page);
+    gbox->addWidget(pDeltaTransfer, line, 0, 1, 2);
+    pDeltaTransfer->setToolTip(i18nc("Tool Tip",
+        "When a local file replaces a remote one, the remote file is read and only the blocks that differ are written.\n"
+        "Helps with large, slightly changed files on slow uploads. Not used when backup files are made.\n"
+        "Protocols that can't write at an offset get the whole file."));
+    ++line;
+
+    OptionCheckBox* pRemoteHashing = new OptionCheckBox(i18n("Hash remote files on their host"), false, "RemoteHashing", &m_options->m_bDmRemoteHashing, page);
+    gbox->addWidget(pRemoteHashing, line, 0, 1, 2);
+    pRemoteHashing->setToolTip(i18nc("Tool Tip",
+        "Binary comparison of sftp and fish files runs sha256sum on the remote host over ssh\n"
+        "instead of downloading them. Needs ssh to log in without a password prompt,\n"
+        "otherwise the files are downloaded as before."));
+    ++line;
+
+    OptionCheckBox* pUseGitIndex = new OptionCheckBox(i18n("Use the git index of work trees"), false, "UseGitIndex", &m_options->m_bDmUseGitIndex, page);
+    gbox->addWidget(pUseGitIndex, line, 0, 1, 2);
+    pUseGitIndex->setToolTip(i18nc("Tool Tip",
+        "Files in git work trees that git has hashed and that are unchanged since\n"
+        "are compared by the object IDs stored in the index, without reading them.\n"
+        "Other files are compared as before."));
+    ++line;
+
+    OptionCheckBox* pCompareDecompressed = new OptionCheckBox(i18n("Compare compressed files by their content"), false, "CompareDecompressed", &m_options->m_bDmCompareDecompressed, page);
+    gbox->addWidget(pCompareDecompressed, line, 0, 1, 2);
+    pCompareDecompressed->setToolTip(i18nc("Tool Tip",
+        "Local files ending in .gz, .xz, .zst or .bz2 count as equal when their\n"
+        "decompressed content is, even if they were compressed differently.\n"
+        "Decompressing takes longer than comparing the files as they are."));
+    ++line;
+
+    OptionCheckBox* pCompressPrefetched = new OptionCheckBox(i18n("Compress files read ahead for the next merges"), false, "CompressPrefetched", &m_options->m_bCompressPrefetched, page);
+    gbox->addWidget(pCompressPrefetched, line, 0, 1, 2);
+    pCompressPrefetched->setToolTip(i18nc("Tool Tip",
+        "While one merge is open the files of the next ones are already read.\n"
+        "Keeps their text compressed until they are shown, which needs much less\n"
+        "memory for large files but takes a little longer to open them."));
+    ++line;
+
     // Some two Dir-options: Affects only the default actions.
     OptionCheckBox* pSyncMode = new OptionCheckBox(i18n("Synchronize folders"), false, "SyncMode", &m_options->m_bDmSyncMode, page);
 
@@ -1524,31 +1716,6 @@ void OptionDialog::setState()
     slotEncodingChanged();
 }
 
-void OptionDialog::saveOptions(KSharedConfigPtr config)
-{
-    // No i18n()-Translations here!
-    m_options->saveOptions(config);
-}
-
-void OptionDialog::readOptions(KSharedConfigPtr config)
-{
-    // No i18n()-Translations here!
-    m_options->readOptions(config);
-
-    setState();
-}
-
-const QString OptionDialog::parseOptions(const QStringList& optionList)
-{
-
-    return m_options->parseOptions(optionList);
-}
-
-QString OptionDialog::calcOptionHelp()
-{
-    return m_options->calcOptionHelp();
-}
-
 void OptionDialog::slotHistoryMergeRegExpTester()
 {
     QPointer<RegExpTester> dlg = QPointer<RegExpTester>(new RegExpTester(this, s_autoMergeRegExpToolTip, s_historyStartRegExpToolTip,
@@ -32,18 +32,12 @@ class OptionDialog: public KPageDialog
     Q_OBJECT
 
   public:
-    explicit OptionDialog(bool bShowDirMergeSettings, QWidget* parent = nullptr);
+    // Shows the settings options already read, see Options::initSettings.
+    OptionDialog(bool bShowDirMergeSettings, const QSharedPointer<Options>& options, QWidget* parent = nullptr);
     ~OptionDialog() override;
-    const QString parseOptions(const QStringList& optionList);
-    QString calcOptionHelp();
-
-    void saveOptions(KSharedConfigPtr config);
-    void readOptions(KSharedConfigPtr config);
 
     void setState(); // Must be called before calling exec();
 
-    QSharedPointer<Options> getOptions() { return m_options; }
-
   protected Q_SLOTS:
     virtual void slotDefault();
     virtual void slotOk();
@@ -67,7 +61,7 @@ class OptionDialog: public KPageDialog
     void setupIntegrationPage();
     void resetToDefaults();
 
-    QSharedPointer<Options> m_options = QSharedPointer<Options>::create();
+    QSharedPointer<Options> m_options;
     OptionCheckBox* m_pSameEncoding;
     OptionEncodingComboBox* m_pEncodingAComboBox;
     OptionCheckBox* m_pAutoDetectUnicodeA;
@@ -56,6 +56,12 @@ class Options
     static boost::signals2::signal<bool(const QString&, const QString&), find> accept;
 
     void init();
+    void initBatch();
+    void initSettings();
+
+    // Defaults shared with OptionDialog
+    [[nodiscard]] static const QFont& defaultAppFont();
+    [[nodiscard]] static const QFont& defaultFixedFont();
 
     void readOptions(const KSharedConfigPtr config);
     void saveOptions(const KSharedConfigPtr config);
@@ -187,6 +193,17 @@ class Options
     bool m_bHorizDiffWindowSplitting = true;
     bool m_bShowInfoDialogs = true;
     bool m_bDiff3AlignBC = false;
+    bool m_bLazyFineDiff = true;
+    bool m_bStreamLargeFiles = true;
+    bool m_bDecompressInputs = true; // Compare gzip, xz, zstd and bzip2 files by their content.
+    bool m_bCacheDiffResults = false;
+    int  m_diffTimeBudget = 200; // ms until a quick line matching is shown, 0 waits for the complete one.
+    int  m_progressiveLoadSize = 64; // MB of input above which the beginning is shown while the rest loads, 0 never.
+    int  m_memoryBudget = 0; // MB a comparison may use before fine diffs are freed, 0 never.
+    int  m_workerThreads = 0; // Threads of TaskExecutor, 0 is one per core.
+    int  m_patchContextLines = 3; // Equal lines around the changes of a unified diff.
+    int  m_fineDiffAlgorithm = 0;
+    int  m_lineDiffAlgorithm = 0;
 
     int  m_whiteSpace2FileMergeDefault = 0;
     int  m_whiteSpace3FileMergeDefault = 0;
@@ -229,6 +246,14 @@ class Options
     bool m_bDmTrustDate = false;
     bool m_bDmTrustDateFallbackToBinary = false;
     bool m_bDmTrustSize = false;
+    bool m_bDmUseHashCache = false;
+    bool m_bDmWatchFolders = false;
+    int m_dmMaxRemoteJobs = 8;
+    bool m_bDmDeltaTransfer = false;
+    bool m_bDmRemoteHashing = false;
+    bool m_bDmUseGitIndex = false;
+    bool m_bDmCompareDecompressed = false;
+    bool m_bCompressPrefetched = false; // Keep the text of files read for upcoming merges compressed.
     bool m_bDmCopyNewer = false;
     //bool m_bDmShowOnlyDeltas;
     bool m_bDmShowIdenticalFiles = true;
@@ -8,8 +8,11 @@
 */
 // clang-format on
 
+#include "BinaryDiff.h"
+#include "BinaryDiffView.h"
 #include "compat.h"
 #include "defmac.h"
+#include "DiffCache.h"
 #include "difftextwindow.h"
 #include "DirectoryInfo.h"
 #include "directorymergewindow.h"
@@ -18,16 +21,25 @@
 #include "kdiff3_shell.h"
 #include "Logging.h"
 #include "optiondialog.h"
+#include "PaintBenchmark.h"
+#include "PatchWriter.h"
 #include "progress.h"
+#include "SessionSnapshot.h"
+#include "TaskExecutor.h"
 #include "Utils.h"
 
 #include "mergeresultwindow.h"
 #include "smalldialogs.h"
+#include "StreamingDiff.h"
 
 #include <algorithm>
 #include <cstdio>
+#include <exception>
+#include <functional>
 #include <list>
+#include <vector>
 
+#include <QAtomicInt>
 #include <QCheckBox>
 #include <QClipboard>
 #include <QComboBox>
@@ -36,16 +48,22 @@
 #include <QDockWidget>
 #include <QEvent> // QKeyEvent, QDropEvent, QInputEvent
 #include <QFile>
+#include <QFileDialog>
+#include <QLabel>
 #include <QLayout>
 #include <QLineEdit>
 #include <QMimeData>
 #include <QPointer>
 #include <QProcess>
+#include <QPushButton>
+#include <QScopedValueRollback>
 #include <QScrollBar>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QStringList>
 #include <QTextCodec>
+#include <QTextEdit>
+#include <QTextStream>
 #include <QUrl>
 
 #include <KLocalizedString>
@@ -62,9 +80,168 @@ void addWidget(L* layout, W* widget)
     layout->addWidget(widget);
 }
 
+namespace {
+// Bytes of each input compared first when they are loaded progressively.
+constexpr qint64 progressiveHeadSize = 4 * 1024 * 1024;
+
+/*
+    Runs independent steps of mainInit with interactive priority and waits until all are done.
+    ProgressProxy is silent outside the GUI thread so progress is advanced here, one step for
+    each finished task. An exception thrown by a task is rethrown after all tasks have ended.
+*/
+void runConcurrently(ProgressProxy& pp, const std::vector<std::function<void()>>& tasks, const bool bConcurrent = true)
+{
+    if(!bConcurrent || tasks.size() < 2 || TaskExecutor::instance().maxThreadCount() < 2)
+    {
+        for(const std::function<void()>& task: tasks)
+        {
+            task();
+            pp.step();
+        }
+        return;
+    }
+
+    const std::shared_ptr<TaskGroup> pGroup = std::make_shared<TaskGroup>();
+    QAtomicInt finished = 0;
+    std::vector<std::exception_ptr> errors(tasks.size());
+
+    for(size_t i = 0; i < tasks.size(); ++i)
+    {
+        TaskExecutor::instance().start([&tasks, &errors, &finished, i]() {
+            try
+            {
+                tasks[i]();
+            }
+            catch(...)
+            {
+                errors[i] = std::current_exception();
+            }
+            finished.fetchAndAddOrdered(1);
+        }, TaskExecutor::Priority::interactive, pGroup);
+    }
+
+    size_t reported = 0;
+    do
+    {
+        for(const size_t done = finished.loadAcquire(); reported < done; ++reported)
+            pp.step();
+    } while(!pGroup->wait(50));
+
+    for(; reported < tasks.size(); ++reported)
+        pp.step();
+
+    for(const std::exception_ptr& error: errors)
+    {
+        if(error)
+            std::rethrow_exception(error);
+    }
+}
+
+/*
+    Line matching of two inputs. Inputs that are equal apart from what line matching ignores
+    get the trivial result without running the diff at all. Manual alignments could contradict
+    that result, so they always go through the diff and bypass the diff cache. Only the ranges
+    between them that weren't there in the previous run are calculated though.
+*/
+void calcLineDiff(const ManualDiffHelpList& manualDiffHelpList, const QSharedPointer<SourceData>& sdX, const QSharedPointer<SourceData>& sdY,
+                  DiffList& diffList, ManualDiffSegmentCache& segments, const e_SrcSelector winIdx1, const e_SrcSelector winIdx2, DiffContext& context)
+{
+    if(manualDiffHelpList.empty() && sdX->getSizeLines() > 0 && sdX->isLineMatchEqualWith(sdY))
+    {
+        qCInfo(kdiffMain) << "Inputs are equal for line matching, skipping diff.";
+        diffList.clear();
+        diffList.push_back(Diff(sdX->getSizeLines(), 0, 0));
+        return;
+    }
+
+    const bool bUseCache = manualDiffHelpList.empty() && context.settings().cacheDiffResults();
+    QByteArray cacheKey;
+    if(bUseCache)
+    {
+        cacheKey = DiffCache::key(*sdX->getLineDataForDiff(), sdX->getSizeLines(), *sdY->getLineDataForDiff(), sdY->getSizeLines(), context.settings());
+        if(DiffCache::instance().find(cacheKey, sdX->getSizeLines(), sdY->getSizeLines(), diffList))
+        {
+            qCInfo(kdiffMain) << "Using line matching from the diff cache.";
+            return;
+        }
+    }
+
+    manualDiffHelpList.runDiff(sdX->getLineDataForDiff(), sdX->getSizeLines(), sdY->getLineDataForDiff(), sdY->getSizeLines(), diffList, winIdx1, winIdx2, context,
+                               manualDiffHelpList.empty() ? nullptr : &segments);
+
+    // The complete result is stored once the refinement has it.
+    if(bUseCache && !context.isApproximate())
+        DiffCache::instance().insert(cacheKey, diffList);
+}
+
+/*
+    Keeps diffList if it was calculated from the same data and options before. With manual
+    alignments the ranges between them are kept in segments as long as the inputs stay the same.
+*/
+void runLineDiff(const ManualDiffHelpList& manualDiffHelpList, const QSharedPointer<SourceData>& sdX, const QSharedPointer<SourceData>& sdY,
+                 DiffList& diffList, DiffListOrigin& origin, ManualDiffSegmentCache& segments, const e_SrcSelector winIdx1, const e_SrcSelector winIdx2, DiffContext& context)
+{
+    const DiffSettings& settings = context.settings();
+    DiffListOrigin current;
+    current.bValid = manualDiffHelpList.empty();
+    current.generationX = sdX->generation();
+    current.generationY = sdY->generation();
+    current.lineDiffAlgorithm = (int)settings.lineDiffAlgorithm();
+    current.bTryHard = settings.tryHard();
+    current.bIgnoreNumbers = settings.ignoreNumbers();
+
+    if(current.bValid && current == origin)
+    {
+        qCInfo(kdiffMain) << "Inputs unchanged, keeping the line matching.";
+        return;
+    }
+
+    if(manualDiffHelpList.empty() || !current.hasSameInputs(origin))
+        segments.clear();
+
+    origin = DiffListOrigin();
+    calcLineDiff(manualDiffHelpList, sdX, sdY, diffList, segments, winIdx1, winIdx2, context);
+    current.bApproximate = context.isApproximate();
+    origin = current;
+}
+
+/*
+    Compares two inputs that were too large to load using bounded memory. The result can't be shown
+    in the diff windows so it is summarized in a message.
+*/
+QString compareLargeFiles(const QSharedPointer<Options>& pOptions, const QSharedPointer<SourceData>& sdA, const QSharedPointer<SourceData>& sdB)
+{
+    for(const QSharedPointer<SourceData>& sd: {sdA, sdB})
+    {
+        if(!sd->isLocal() || sd->isFromBuffer() || sd->isDir())
+            return i18n("Comparing large files piecewise needs local files.");
+    }
+
+    QTextCodec* pCodec = sdA->getEncoding() != nullptr ? sdA->getEncoding() : QTextCodec::codecForName("UTF-8");
+    StreamingDiff streamingDiff(pOptions);
+    if(!streamingDiff.run(sdA->getFilename(), sdB->getFilename(), pCodec))
+        return streamingDiff.errorString();
+
+    if(streamingDiff.isEqual())
+        return i18n("Compared piecewise, all %1 lines of A and B match.", streamingDiff.lineCount1());
+
+    StreamingDiff::Hunk first;
+    streamingDiff.forEachHunk([&first](const StreamingDiff::Hunk& hunk) {
+        first = hunk;
+        return false;
+    });
+
+    return i18n("Compared piecewise, %1 sections differ: %2 of %3 lines in A and %4 of %5 lines in B.\n"
+                "The first difference starts at line %6 in A and line %7 in B.",
+                streamingDiff.hunkCount(), streamingDiff.differingLines1(), streamingDiff.lineCount1(),
+                streamingDiff.differingLines2(), streamingDiff.lineCount2(), first.line1 + 1, first.line2 + 1);
+}
+} // namespace
+
 void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFlags)
 {
     ProgressProxy pp;
+    const QScopedValueRollback<bool> mainInitRunning(mbMainInitRunning, true);
     mErrors.clear();
     // When doing a full analysis in the directory-comparison, then the statistics-results
     // will be stored in the given TotalDiffStatus. Otherwise pTotalDiffStatus will
@@ -72,6 +249,7 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
     bool bLoadFiles = inFlags & InitFlag::loadFiles;
     bool bUseCurrentEncoding = inFlags & InitFlag::useCurrentEncoding;
     bool bAutoSolve = inFlags & InitFlag::autoSolve;
+    const bool bKeepUnchangedFiles = inFlags & InitFlag::keepUnchangedFiles;
 
     bool bGUI = (inFlags & InitFlag::initGUI);
 
@@ -120,11 +298,27 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
     if(m_pDiffTextWindow1) m_pDiffTextWindow1->reset();
     if(m_pDiffTextWindow2) m_pDiffTextWindow2->reset();
     if(m_pDiffTextWindow3) m_pDiffTextWindow3->reset();
+    mFineDiffTimer.stop();
     m_diff3LineList.clear();
     mDiff3LineVector.clear();
 
+    // Large local inputs are read completely in the background, meanwhile only their beginning is loaded here.
+    bool bLoadHeads = false;
+
     if(bLoadFiles)
     {
+        mProgressiveLoadTimer.stop();
+        bLoadHeads = bGUI && !bUseCurrentEncoding && !bVisibleMergeResultWindow && !mbLoadingCompleteInputs && useProgressiveLoad();
+        if(bLoadHeads)
+        {
+            mPrefetcher.prefetch(m_sd1->getFilename(), m_pOptions, m_pOptions->m_pEncodingA, m_pOptions->m_bAutoDetectUnicodeA);
+            mPrefetcher.prefetch(m_sd2->getFilename(), m_pOptions, m_pOptions->m_pEncodingB, m_pOptions->m_bAutoDetectUnicodeB);
+            mPrefetcher.prefetch(m_sd3->getFilename(), m_pOptions, m_pOptions->m_pEncodingC, m_pOptions->m_bAutoDetectUnicodeC);
+        }
+
+        if(mBinaryDiffDialog != nullptr)
+            delete mBinaryDiffDialog;
+        mStatistics.start();
         m_manualDiffHelpList.clear();
 
         if(m_sd3->isEmpty())
@@ -132,26 +326,52 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
         else
             pp.setMaxNofSteps(9); // Read 3 files, 3 comparisons, 3 finediffs
 
-        // First get all input data.
-        pp.setInformation(i18nc("Status message", "Loading A: %1", m_sd1->getFilename()));
-        qCInfo(kdiffMain) << "Loading A: " << m_sd1->getFilename();
+        // First get all input data. Local files don't involve KIO jobs so they can all be read at once.
+        const bool bReadConcurrently = m_sd1->isLocal() && m_sd2->isLocal() && (m_sd3->isEmpty() || m_sd3->isLocal());
+        QStringList loadInfo;
+        std::vector<std::function<void()>> loadTasks;
 
-        if(bUseCurrentEncoding)
-            m_sd1->readAndPreprocess(m_sd1->getEncoding(), false);
-        else
-            m_sd1->readAndPreprocess(m_pOptions->m_pEncodingA, m_pOptions->m_bAutoDetectUnicodeA);
+        const auto addLoadTask = [this, &pp, &loadInfo, &loadTasks, bUseCurrentEncoding, bKeepUnchangedFiles, bLoadHeads](const QSharedPointer<SourceData>& sd, const QString& info, QTextCodec* pEncoding, bool bAutoDetectUnicode) {
+            // Keeping the data also keeps the line matching of the pairs it is part of, see runLineDiff().
+            if(bKeepUnchangedFiles && !bUseCurrentEncoding && sd->isUpToDate(*m_pOptions, pEncoding, bAutoDetectUnicode))
+            {
+                qCInfo(kdiffMain) << "Unchanged, not reloading:" << sd->getFilename();
+                pp.step();
+                return;
+            }
 
-        pp.step();
+            loadInfo.append(info);
+            qCInfo(kdiffMain) << info;
+            loadTasks.push_back([this, sd, pEncoding, bAutoDetectUnicode, bUseCurrentEncoding, bLoadHeads]() {
+                if(bUseCurrentEncoding)
+                {
+                    // Only the input whose encoding changed is decoded again, the others keep their data.
+                    if(!sd->redecode(sd->getEncoding()))
+                        sd->readAndPreprocess(sd->getEncoding(), false);
+                    return;
+                }
+                if(bLoadHeads)
+                {
+                    sd->readAndPreprocessHead(pEncoding, bAutoDetectUnicode, progressiveHeadSize);
+                    return;
+                }
 
-        pp.setInformation(i18nc("Status message", "Loading B: %1", m_sd2->getFilename()));
-        qCInfo(kdiffMain) << "Loading B: " << m_sd2->getFilename();
+                const QSharedPointer<SourceData> pPrefetched = sd->isLocal() ? mPrefetcher.take(sd->getFilename(), *m_pOptions, pEncoding, bAutoDetectUnicode) : nullptr;
+                if(pPrefetched != nullptr)
+                    sd->takeLoadedData(*pPrefetched);
+                else
+                    sd->readAndPreprocess(pEncoding, bAutoDetectUnicode);
+            });
+        };
 
-        if(bUseCurrentEncoding)
-            m_sd2->readAndPreprocess(m_sd2->getEncoding(), false);
-        else
-            m_sd2->readAndPreprocess(m_pOptions->m_pEncodingB, m_pOptions->m_bAutoDetectUnicodeB);
+        addLoadTask(m_sd1, i18nc("Status message", "Loading A: %1", m_sd1->getFilename()), m_pOptions->m_pEncodingA, m_pOptions->m_bAutoDetectUnicodeA);
+        addLoadTask(m_sd2, i18nc("Status message", "Loading B: %1", m_sd2->getFilename()), m_pOptions->m_pEncodingB, m_pOptions->m_bAutoDetectUnicodeB);
+        if(!m_sd3->isEmpty())
+            addLoadTask(m_sd3, i18nc("Status message", "Loading C: %1", m_sd3->getFilename()), m_pOptions->m_pEncodingC, m_pOptions->m_bAutoDetectUnicodeC);
+
+        pp.setInformation(loadInfo.join('\n'));
+        runConcurrently(pp, loadTasks, bReadConcurrently);
 
-        pp.step();
         mErrors.append(m_sd1->getErrors());
         mErrors.append(m_sd2->getErrors());
     }
@@ -164,11 +384,23 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
     }
 
     pTotalDiffStatus->reset();
+    Diff3Line::m_pDiffBufferInfo->setFineDiffAlgorithm((FineDiffAlgorithm)m_pOptions->m_fineDiffAlgorithm);
+
+    if(bLoadFiles && m_sd3->isEmpty() && m_pOptions->m_bStreamLargeFiles && (m_sd1->isTooLarge() || m_sd2->isTooLarge()))
+        mErrors.append(compareLargeFiles(m_pOptions, m_sd1, m_sd2));
 
     if(mErrors.isEmpty())
     {
         try
         {
+            /*
+                With a time budget the line matching shown first may be cut short, a complete one
+                follows from startDiffRefinement. Manual alignments always get the complete one.
+            */
+            DiffSettings diffSettings(*m_pOptions);
+            if(bGUI && m_manualDiffHelpList.empty() && m_pOptions->m_diffTimeBudget > 0)
+                diffSettings = diffSettings.withDeadline(QDeadlineTimer(m_pOptions->m_diffTimeBudget));
+
             // Run the diff.
             if(m_sd3->isEmpty())
             {
@@ -178,8 +410,8 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                 {
                     pp.setInformation(i18nc("Status message", "Diff: A <-> B"));
                     qCInfo(kdiffMain) << "Diff: A <-> B";
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B,
-                                                 m_pOptionDialog->getOptions());
+                    DiffContext context(diffSettings);
+                    runLineDiff(m_manualDiffHelpList, m_sd1, m_sd2, m_diffList12, mDiffOrigin12, mDiffSegments12, e_SrcSelector::A, e_SrcSelector::B, context);
 
                     pp.step();
 
@@ -187,7 +419,11 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                     qCInfo(kdiffMain) << "Linediff: A <-> B";
                     m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
 
-                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
+                    // Identical text has no fine differences, every line is already marked equal.
+                    if(m_sd1->isTextEqualWith(m_sd2))
+                        pTotalDiffStatus->setTextEqualAB(true);
+                    else
+                        pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags, m_pOptions->m_bLazyFineDiff));
                     if(m_sd1->getSizeBytes() == 0) pTotalDiffStatus->setTextEqualAB(false);
 
                     pp.step();
@@ -200,64 +436,65 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
             }
             else
             {
-                if(bLoadFiles)
-                {
-                    pp.setInformation(i18nc("Status message", "Loading C: %1", m_sd3->getFilename()));
-                    qCInfo(kdiffMain) << "Loading C: " << m_sd3->getFilename();
-
-                    if(bUseCurrentEncoding)
-                        m_sd3->readAndPreprocess(m_sd3->getEncoding(), false);
-                    else
-                        m_sd3->readAndPreprocess(m_pOptions->m_pEncodingC, m_pOptions->m_bAutoDetectUnicodeC);
-
-                    pp.step();
-                }
-
                 pTotalDiffStatus->setBinaryEqualAB(m_sd1->isBinaryEqualWith(m_sd2));
                 pTotalDiffStatus->setBinaryEqualAC(m_sd1->isBinaryEqualWith(m_sd3));
                 pTotalDiffStatus->setBinaryEqualBC(m_sd3->isBinaryEqualWith(m_sd2));
 
-                pp.setInformation(i18nc("Status message", "Diff: A <-> B"));
-                qCInfo(kdiffMain) << "Diff: A <-> B";
-
-                if(m_sd1->isText() && m_sd2->isText())
+                // The three comparisons only read the line data and write to their own DiffList.
+                const std::vector<std::function<void()>> diffTasks = {
+                    [this, diffSettings]() {
+                        if(m_sd1->isText() && m_sd2->isText())
+                        {
+                            qCInfo(kdiffMain) << "Diff: A <-> B";
+                            DiffContext context(diffSettings);
+                            runLineDiff(m_manualDiffHelpList, m_sd1, m_sd2, m_diffList12, mDiffOrigin12, mDiffSegments12, e_SrcSelector::A, e_SrcSelector::B, context);
+                        }
+                    },
+                    [this, diffSettings]() {
+                        if(m_sd1->isText() && m_sd3->isText())
+                        {
+                            qCInfo(kdiffMain) << "Diff: A <-> C";
+                            DiffContext context(diffSettings);
+                            runLineDiff(m_manualDiffHelpList, m_sd1, m_sd3, m_diffList13, mDiffOrigin13, mDiffSegments13, e_SrcSelector::A, e_SrcSelector::C, context);
+                        }
+                    },
+                    [this, diffSettings]() {
+                        if(m_sd2->isText() && m_sd3->isText())
+                        {
+                            qCInfo(kdiffMain) << "Diff: B <-> C";
+                            DiffContext context(diffSettings);
+                            runLineDiff(m_manualDiffHelpList, m_sd2, m_sd3, m_diffList23, mDiffOrigin23, mDiffSegments23, e_SrcSelector::B, e_SrcSelector::C, context);
+                        }
+                    }};
+
+                pp.setInformation(i18nc("Status message", "Diff: A <-> B") + '\n' + i18nc("Status message", "Diff: A <-> C") + '\n' + i18nc("Status message", "Diff: B <-> C"));
+                runConcurrently(pp, diffTasks);
+
+                // Merging the results into m_diff3LineList must stay in this order.
+                if(m_sd1->isText() && m_sd2->isText() && m_sd3->isText())
                 {
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B,
-                                                 m_pOptionDialog->getOptions());
-
-                    m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
+                    m_diff3LineList.calcDiff3LineListUsingABAndAC(&m_diffList12, &m_diffList13);
+#ifndef NDEBUG
+                    m_diff3LineList.debugAlignmentCheck(&m_diffList12, &m_diffList13);
+#endif
                 }
-                pp.step();
-
-                pp.setInformation(i18nc("Status message", "Diff: A <-> C"));
-                qCInfo(kdiffMain) << "Diff: A <-> C";
+                else if(m_sd1->isText() && m_sd2->isText())
+                    m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
+                else if(m_sd1->isText() && m_sd3->isText())
+                    m_diff3LineList.calcDiff3LineListUsingAC(&m_diffList13);
 
                 if(m_sd1->isText() && m_sd3->isText())
                 {
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->getSizeLines(), m_sd3->getLineDataForDiff(), m_sd3->getSizeLines(), m_diffList13, e_SrcSelector::A, e_SrcSelector::C,
-                                                 m_pOptionDialog->getOptions());
-
-                    m_diff3LineList.calcDiff3LineListUsingAC(&m_diffList13);
                     m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
                     m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
                 }
-                pp.step();
 
-                pp.setInformation(i18nc("Status message", "Diff: B <-> C"));
-                qCInfo(kdiffMain) << "Diff: B <-> C";
-
-                if(m_sd2->isText() && m_sd3->isText())
+                if(m_sd2->isText() && m_sd3->isText() && m_pOptions->m_bDiff3AlignBC)
                 {
-                    m_manualDiffHelpList.runDiff(m_sd2->getLineDataForDiff(), m_sd2->getSizeLines(), m_sd3->getLineDataForDiff(), m_sd3->getSizeLines(), m_diffList23, e_SrcSelector::B, e_SrcSelector::C,
-                                                 m_pOptionDialog->getOptions());
-                    if(m_pOptions->m_bDiff3AlignBC)
-                    {
-                        m_diff3LineList.calcDiff3LineListUsingBC(&m_diffList23);
-                        m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
-                        m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
-                    }
+                    m_diff3LineList.calcDiff3LineListUsingBC(&m_diffList23);
+                    m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
+                    m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
                 }
-                pp.step();
 
                 if(!m_pOptions->m_bDiff3AlignBC)
                 {
@@ -266,22 +503,49 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                     m_diff3LineList.debugLineCheck(m_sd3->getSizeLines(), e_SrcSelector::C);
                 }
 
-                pp.setInformation(i18nc("Status message", "Linediff: A <-> B"));
-                qCInfo(kdiffMain) << "Linediff: A <-> B";
-                if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
-                pp.step();
-
-                pp.setInformation(i18nc("Status message", "Linediff: B <-> C"));
-                qCInfo(kdiffMain) << "Linediff: B <-> C";
-                if(m_sd2->hasData() && m_sd3->hasData() && m_sd2->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags));
-                pp.step();
+                /*
+                    Each selector only touches its own fine diff and equality flag of a Diff3Line,
+                    so the three passes can share m_diff3LineList.
+                */
+                bool bTextEqualAB = pTotalDiffStatus->isTextEqualAB();
+                bool bTextEqualBC = pTotalDiffStatus->isTextEqualBC();
+                bool bTextEqualAC = pTotalDiffStatus->isTextEqualAC();
+                const bool bLazyFineDiff = m_pOptions->m_bLazyFineDiff;
+                const std::vector<std::function<void()>> fineDiffTasks = {
+                    [this, &bTextEqualAB, eIgnoreFlags, bLazyFineDiff]() {
+                        qCInfo(kdiffMain) << "Linediff: A <-> B";
+                        if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
+                            bTextEqualAB = m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags, bLazyFineDiff);
+                    },
+                    [this, &bTextEqualBC, eIgnoreFlags, bLazyFineDiff]() {
+                        qCInfo(kdiffMain) << "Linediff: B <-> C";
+                        if(m_sd2->hasData() && m_sd3->hasData() && m_sd2->isText() && m_sd3->isText())
+                            bTextEqualBC = m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags, bLazyFineDiff);
+                    },
+                    [this, &bTextEqualAC, eIgnoreFlags, bLazyFineDiff]() {
+                        qCInfo(kdiffMain) << "Linediff: A <-> C";
+                        if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
+                            bTextEqualAC = m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags, bLazyFineDiff);
+                    }};
+
+                pp.setInformation(i18nc("Status message", "Linediff: A <-> B") + '\n' + i18nc("Status message", "Linediff: B <-> C") + '\n' + i18nc("Status message", "Linediff: A <-> C"));
+                /*
+                    B and C lines are only aligned with each other through A, so a pair of
+                    identical inputs can only skip the fine diff when all three are identical.
+                */
+                if(m_sd1->isTextEqualWith(m_sd2) && m_sd1->isTextEqualWith(m_sd3))
+                {
+                    bTextEqualAB = bTextEqualBC = bTextEqualAC = true;
+                    pp.step();
+                    pp.step();
+                    pp.step();
+                }
+                else
+                    runConcurrently(pp, fineDiffTasks);
 
-                pp.setInformation(i18nc("Status message", "Linediff: A <-> C"));
-                qCInfo(kdiffMain) << "Linediff: A <-> C";
-                if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags));
+                pTotalDiffStatus->setTextEqualAB(bTextEqualAB);
+                pTotalDiffStatus->setTextEqualBC(bTextEqualBC);
+                pTotalDiffStatus->setTextEqualAC(bTextEqualAC);
 
                 if(!m_pOptions->m_bDiff3AlignBC)
                 {
@@ -289,20 +553,6 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                     m_diff3LineList.debugLineCheck(m_sd3->getSizeLines(), e_SrcSelector::C);
                 }
 
-                pp.setInformation(i18nc("Status message", "Linediff: A <-> B"));
-                if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
-                pp.step();
-
-                pp.setInformation(i18nc("Status message", "Linediff: B <-> C"));
-                if(m_sd3->hasData() && m_sd2->hasData() && m_sd3->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags));
-                pp.step();
-
-                pp.setInformation(i18nc("Status message", "Linediff: A <-> C"));
-                if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags));
-                pp.step();
                 if(m_sd1->getSizeBytes() == 0)
                 {
                     pTotalDiffStatus->setTextEqualAB(false);
@@ -334,9 +584,11 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                                m_sd1->getLineDataForDiff(),
                                m_sd2->getLineDataForDiff(),
                                m_sd3->getLineDataForDiff());
+        Diff3Line::m_pDiffBufferInfo->setDisplayData(m_sd1->getLineDataForDisplay(),
+                                                     m_sd2->getLineDataForDisplay(),
+                                                     m_sd3->getLineDataForDisplay());
 
-        m_diff3LineList.calcWhiteDiff3Lines(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), m_pOptions->ignoreComments());
-        m_diff3LineList.calcDiff3LineVector(mDiff3LineVector);
+        m_diff3LineList.calcDiff3LineVector(mDiff3LineVector, m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), m_pOptions->ignoreComments());
     }
 
     // Calc needed lines for display
@@ -408,9 +660,295 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
             createCaption();
         }
         m_bFinishMainInit = true; // call slotFinishMainInit after finishing the word wrap
-        m_bLoadFiles = bLoadFiles;
+        // What is found equal or not text in the beginning needn't hold for the complete inputs, so nothing is reported yet.
+        m_bLoadFiles = bLoadFiles && !bLoadHeads;
         postRecalcWordWrap();
+
+        if(m_pOptions->m_bLazyFineDiff && mErrors.isEmpty())
+        {
+            mNextPendingFineDiff = m_diff3LineList.cbegin();
+            mFineDiffTimer.start(0);
+        }
+
+        if(bLoadHeads && mErrors.isEmpty())
+            mProgressiveLoadTimer.start();
+        else if(mErrors.isEmpty())
+            startDiffRefinement();
     }
+
+    updateStatistics();
+    if(bGUI && checkMemoryBudget())
+        mFineDiffTimer.stop();
+}
+
+bool KDiff3App::useProgressiveLoad() const
+{
+    if(m_pOptions->m_progressiveLoadSize <= 0 || !m_pOptions->m_PreProcessorCmd.isEmpty())
+        return false;
+
+    qint64 totalSize = 0;
+    for(const QSharedPointer<SourceData>& sd: {m_sd1, m_sd2, m_sd3})
+    {
+        if(sd->isEmpty())
+            continue;
+        // The prefetcher only reads local files.
+        if(!sd->isLocal() || sd->isFromBuffer() || sd->isDir())
+            return false;
+        totalSize += FileAccess(sd->getFilename()).size();
+    }
+
+    return totalSize > (qint64)m_pOptions->m_progressiveLoadSize * 1024 * 1024;
+}
+
+void KDiff3App::slotCheckProgressiveLoad()
+{
+    if(mbMainInitRunning)
+        return;
+
+    for(const QSharedPointer<SourceData>& sd: {m_sd1, m_sd2, m_sd3})
+    {
+        if(!sd->isEmpty() && !mPrefetcher.isReady(sd->getFilename()))
+        {
+            const QString msg = i18n("Showing the beginning of the input files, reading the rest...");
+            if(statusBar() != nullptr && statusBar()->currentMessage() != msg)
+                slotStatusMsg(msg);
+            return;
+        }
+    }
+
+    // The load tasks of mainInit take over the data read in the background.
+    mProgressiveLoadTimer.stop();
+    mProgressiveScrollPos = DiffTextWindow::mVScrollBar->value();
+    {
+        const QScopedValueRollback<bool> loadingCompleteInputs(mbLoadingCompleteInputs, true);
+        mainInit(m_totalDiffStatus);
+    }
+    slotStatusMsg(i18n("Ready."));
+}
+
+/*
+    Calculates the complete line matching of the pairs that ran out of the time budget on a thread
+    with background priority, finishDiffRefinement then shows it.
+*/
+void KDiff3App::startDiffRefinement()
+{
+    const std::shared_ptr<std::vector<DiffRefinement>> pRefinements = std::make_shared<std::vector<DiffRefinement>>();
+    const auto addRefinement = [&pRefinements](DiffList& diffList, DiffListOrigin& origin, const QSharedPointer<SourceData>& sdX, const QSharedPointer<SourceData>& sdY) {
+        if(origin.bApproximate)
+            pRefinements->push_back({&diffList, &origin, origin, sdX->getLineDataForDiff(), sdY->getLineDataForDiff(), sdX->getSizeLines(), sdY->getSizeLines(), DiffList()});
+    };
+    addRefinement(m_diffList12, mDiffOrigin12, m_sd1, m_sd2);
+    addRefinement(m_diffList13, mDiffOrigin13, m_sd1, m_sd3);
+    addRefinement(m_diffList23, mDiffOrigin23, m_sd2, m_sd3);
+    if(pRefinements->empty())
+        return;
+
+    // Waiting refinements are for older inputs. One that is already running may still fit, see finishDiffRefinement.
+    mpDiffRefinements->cancel();
+
+    const DiffSettings settings(*m_pOptions);
+    TaskExecutor::instance().start([this, pRefinements, settings]() {
+        for(DiffRefinement& refinement: *pRefinements)
+        {
+            DiffContext context(settings);
+            refinement.result.runDiff(refinement.p1, 0, refinement.size1, refinement.p2, 0, refinement.size2, context);
+            if(settings.cacheDiffResults())
+                DiffCache::instance().insert(DiffCache::key(*refinement.p1, refinement.size1, *refinement.p2, refinement.size2, settings), refinement.result);
+        }
+
+        QMetaObject::invokeMethod(
+            this, [this, pRefinements]() { finishDiffRefinement(pRefinements); }, Qt::QueuedConnection);
+    }, TaskExecutor::Priority::background, mpDiffRefinements);
+}
+
+/*
+    Replaces the quick line matching by the complete one and sets up the view again, the same as
+    adding a manual alignment does. Pairs whose inputs or options changed in the meantime are
+    skipped. An edited merge output is left alone, redoing the merge would lose the edits.
+*/
+void KDiff3App::finishDiffRefinement(const std::shared_ptr<std::vector<DiffRefinement>>& pRefinements)
+{
+    // Progress dialogs run nested event loops, don't start over below one.
+    if(mbMainInitRunning || m_bFinishMainInit || mbPrinting)
+    {
+        QTimer::singleShot(100, this, [this, pRefinements]() { finishDiffRefinement(pRefinements); });
+        return;
+    }
+
+    if(m_pMergeResultWindow == nullptr || m_pMergeResultWindow->isModified())
+        return;
+
+    bool bRefined = false;
+    for(DiffRefinement& refinement: *pRefinements)
+    {
+        if(!refinement.pOrigin->bApproximate || !(*refinement.pOrigin == refinement.origin))
+            continue;
+
+        *refinement.pDiffList = std::move(refinement.result);
+        refinement.pOrigin->bApproximate = false;
+        bRefined = true;
+    }
+
+    if(!bRefined)
+        return;
+
+    qCInfo(kdiffMain) << "Showing the complete line matching.";
+    mainInit(m_totalDiffStatus, InitFlag::autoSolve | InitFlag::initGUI); // Init without reload
+    slotRefresh();
+}
+
+void KDiff3App::updateStatistics()
+{
+    std::vector<Statistics::Input> inputs;
+    for(const QSharedPointer<SourceData>& sd: {m_sd1, m_sd2, m_sd3})
+    {
+        if(!sd->isEmpty())
+            inputs.push_back({sd->getAliasName(), sd->getSizeBytes(), sd->getSizeLines()});
+    }
+
+    mStatistics.setInputs(inputs);
+    mStatistics.updateMemory(lineDataMemoryUsage(), m_diff3LineList.memoryUsage());
+    mStatistics.setFineDiffCount((qint64)m_diff3LineList.fineDiffCount());
+}
+
+qint64 KDiff3App::lineDataMemoryUsage() const
+{
+    std::vector<const LineDataVector*> lineData;
+    qint64 lineDataBytes = 0;
+    for(const QSharedPointer<SourceData>& sd: {m_sd1, m_sd2, m_sd3})
+    {
+        if(sd->isEmpty())
+            continue;
+
+        // Without line matching preprocessing both are the same vector.
+        for(const std::shared_ptr<LineDataVector>& pLineData: {sd->getLineDataForDisplay(), sd->getLineDataForDiff()})
+        {
+            if(pLineData != nullptr && std::find(lineData.cbegin(), lineData.cend(), pLineData.get()) == lineData.cend())
+            {
+                lineData.push_back(pLineData.get());
+                lineDataBytes += pLineData->memoryUsage();
+            }
+        }
+    }
+    return lineDataBytes;
+}
+
+/*
+    Only the fine diffs are freed, they are the one part of a comparison that can be calculated
+    again line by line. The lines shown get theirs back when painted.
+*/
+bool KDiff3App::checkMemoryBudget()
+{
+    if(m_pOptions->m_memoryBudget <= 0 || m_diff3LineList.fineDiffCount() == 0)
+        return false;
+
+    const qint64 budget = (qint64)m_pOptions->m_memoryBudget * 1024 * 1024;
+    if(lineDataMemoryUsage() + m_diff3LineList.memoryUsage() <= budget)
+        return false;
+
+    // Keeps the peak before freeing.
+    updateStatistics();
+    const qint64 bytes = m_diff3LineList.evictFineDiffs();
+    mStatistics.addEviction(bytes);
+    qCInfo(kdiffMain) << "Freed" << bytes << "bytes of fine diffs to stay within the memory budget.";
+    updateStatistics();
+    return true;
+}
+
+/*
+    Compares A and B byte by byte and shows both as hex dump, see BinaryDiffView. Text inputs can
+    be looked at this way too, which shows differences the line matching ignores.
+*/
+void KDiff3App::slotShowBinaryComparison()
+{
+    if(!m_sd1->hasData() || !m_sd2->hasData())
+        return;
+
+    BinaryDiff binaryDiff;
+    {
+        ProgressProxy pp;
+        pp.setInformation(i18nc("Status message", "Binary comparison: A <-> B"));
+        if(!binaryDiff.run(m_sd1->getBuf(), m_sd1->getSizeBytes(), m_sd2->getBuf(), m_sd2->getSizeBytes()))
+            return;
+    }
+
+    if(mBinaryDiffDialog != nullptr)
+        delete mBinaryDiffDialog;
+
+    QPointer<QDialog> pDialog = QPointer<QDialog>(new QDialog(this));
+    pDialog->setAttribute(Qt::WA_DeleteOnClose);
+    pDialog->setWindowTitle(i18n("Binary Comparison"));
+    QPointer<QVBoxLayout> pVBoxLayout = new QVBoxLayout(pDialog);
+
+    qint64 nofDifferences = 0;
+    for(const BinaryDiff::Block& block: binaryDiff.blocks())
+    {
+        if(!block.bEqual)
+            ++nofDifferences;
+    }
+    QString summary = i18n("A: %1", m_sd1->getAliasName()) + '\n' + i18n("B: %1", m_sd2->getAliasName()) + '\n';
+    if(binaryDiff.isEqual())
+        summary += i18n("A and B are binary equal.");
+    else
+        summary += i18np("%2 bytes of A and %3 bytes of B differ in one place.", "%2 bytes of A and %3 bytes of B differ in %1 places.",
+                         nofDifferences, binaryDiff.differingBytes1(), binaryDiff.differingBytes2());
+    pVBoxLayout->addWidget(new QLabel(summary, pDialog));
+
+    BinaryDiffView* pView = new BinaryDiffView(m_pOptions, pDialog);
+    pView->init(m_sd1, m_sd2, binaryDiff.blocks());
+    pVBoxLayout->addWidget(pView, 1);
+
+    QPointer<QHBoxLayout> pButtonLayout = new QHBoxLayout();
+    pVBoxLayout->addLayout(pButtonLayout);
+    QPushButton* pPrevButton = new QPushButton(i18n("Previous Difference"), pDialog);
+    QPushButton* pNextButton = new QPushButton(i18n("Next Difference"), pDialog);
+    QPushButton* pCloseButton = new QPushButton(i18n("Close"), pDialog);
+    chk_connect_a(pPrevButton, &QPushButton::clicked, pView, &BinaryDiffView::slotGoPrevDifference);
+    chk_connect_a(pNextButton, &QPushButton::clicked, pView, &BinaryDiffView::slotGoNextDifference);
+    chk_connect_a(pCloseButton, &QPushButton::clicked, pDialog.data(), &QDialog::close);
+    pButtonLayout->addWidget(pPrevButton);
+    pButtonLayout->addWidget(pNextButton);
+    pButtonLayout->addStretch(1);
+    pButtonLayout->addWidget(pCloseButton);
+
+    pDialog->resize(1000, 600);
+    pDialog->show();
+    pView->setFocus();
+    mBinaryDiffDialog = pDialog;
+}
+
+void KDiff3App::slotShowStatistics()
+{
+    // Deferred fine diffs are calculated while scrolling, count those too.
+    updateStatistics();
+
+    QPointer<QDialog> pDialog = QPointer<QDialog>(new QDialog(this));
+    pDialog->setAttribute(Qt::WA_DeleteOnClose);
+    pDialog->setWindowTitle(i18n("Statistics"));
+    QPointer<QVBoxLayout> pVBoxLayout = new QVBoxLayout(pDialog);
+    QPointer<QTextEdit> pTextEdit = QPointer<QTextEdit>(new QTextEdit(pDialog));
+    pTextEdit->setPlainText(mStatistics.text(m_pDirectoryMergeWindow != nullptr ? &m_pDirectoryMergeWindow->compareStatistics() : nullptr));
+    pTextEdit->setReadOnly(true);
+    pTextEdit->setWordWrapMode(QTextOption::NoWrap);
+    pVBoxLayout->addWidget(pTextEdit);
+    pDialog->resize(600, 400);
+    pDialog->show();
+}
+
+/*
+    Deferred fine diffs are calculated on demand when painting. This fills in the rest in small
+    chunks from the event loop so it never competes with the display.
+*/
+void KDiff3App::slotCalcPendingFineDiffs()
+{
+    constexpr size_t chunkSize = 500;
+
+    mNextPendingFineDiff = m_diff3LineList.calcPendingFineDiffs(mNextPendingFineDiff, chunkSize);
+    // Over the budget the rest is left to painting, filling it in would only be freed again.
+    if(checkMemoryBudget())
+        return;
+    if(mNextPendingFineDiff != m_diff3LineList.cend())
+        mFineDiffTimer.start(0);
 }
 
 void KDiff3App::setLockPainting(bool bLock)
@@ -581,7 +1119,7 @@ void KDiff3App::initView()
     m_pDiffWindowSplitter->setOrientation(m_pOptions->m_bHorizDiffWindowSplitting ? Qt::Horizontal : Qt::Vertical);
     pDiffHLayout->addWidget(m_pDiffWindowSplitter);
 
-    m_pOverview = new Overview(m_pOptionDialog->getOptions());
+    m_pOverview = new Overview(m_pOptions);
     m_pOverview->setObjectName("Overview");
     pDiffHLayout->addWidget(m_pOverview);
 
@@ -592,11 +1130,11 @@ void KDiff3App::initView()
     chk_connect_a(this, &KDiff3App::showWhiteSpaceToggled, m_pOverview, &Overview::slotRedraw);
     chk_connect_a(this, &KDiff3App::changeOverViewMode, m_pOverview, &Overview::setOverviewMode);
 
-    m_pDiffTextWindowFrame1 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::A, m_sd1, *this);
+    m_pDiffTextWindowFrame1 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::A, m_sd1, *this);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame1);
-    m_pDiffTextWindowFrame2 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::B, m_sd2, *this);
+    m_pDiffTextWindowFrame2 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::B, m_sd2, *this);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame2);
-    m_pDiffTextWindowFrame3 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptionDialog->getOptions(), e_SrcSelector::C, m_sd3, *this);
+    m_pDiffTextWindowFrame3 = new DiffTextWindowFrame(m_pDiffWindowSplitter, m_pOptions, e_SrcSelector::C, m_sd3, *this);
     m_pDiffWindowSplitter->addWidget(m_pDiffTextWindowFrame3);
     m_pDiffTextWindow1 = m_pDiffTextWindowFrame1->getDiffTextWindow();
     m_pDiffTextWindow2 = m_pDiffTextWindowFrame2->getDiffTextWindow();
@@ -616,10 +1154,10 @@ void KDiff3App::initView()
     QVBoxLayout* pMergeVLayout = new QVBoxLayout();
     pMergeHLayout->addLayout(pMergeVLayout, 1);
 
-    m_pMergeResultWindowTitle = new WindowTitleWidget(m_pOptionDialog->getOptions());
+    m_pMergeResultWindowTitle = new WindowTitleWidget(m_pOptions);
     pMergeVLayout->addWidget(m_pMergeResultWindowTitle);
 
-    m_pMergeResultWindow = new MergeResultWindow(m_pMergeWindowFrame, m_pOptionDialog->getOptions(), statusBar());
+    m_pMergeResultWindow = new MergeResultWindow(m_pMergeWindowFrame, m_pOptions, statusBar());
     pMergeVLayout->addWidget(m_pMergeResultWindow, 1);
 
     MergeResultWindow::mVScrollBar = new QScrollBar(Qt::Vertical, m_pMergeWindowFrame);
@@ -681,10 +1219,10 @@ void KDiff3App::initView()
     chk_connect_a(m_pDirectoryMergeInfo, &DirectoryMergeInfo::gotFocus, p, &MergeResultWindow::updateSourceMask);
 
     chk_connect_a(m_pDiffTextWindow1, &DiffTextWindow::resizeHeightChangedSignal, this, &KDiff3App::resizeDiffTextWindowHeight);
-    // The following connects cause the wordwrap to be recalced thrice, just to make sure. Better than forgetting one.
-    chk_connect_a(m_pDiffTextWindow1, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::postRecalcWordWrap);
-    chk_connect_a(m_pDiffTextWindow2, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::postRecalcWordWrap);
-    chk_connect_a(m_pDiffTextWindow3, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::postRecalcWordWrap);
+    // All three windows report a width change, slotResizeWidthChanged() turns them into one recalc.
+    chk_connect_a(m_pDiffTextWindow1, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::slotResizeWidthChanged);
+    chk_connect_a(m_pDiffTextWindow2, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::slotResizeWidthChanged);
+    chk_connect_a(m_pDiffTextWindow3, &DiffTextWindow::resizeWidthChangedSignal, this, &KDiff3App::slotResizeWidthChanged);
 
     m_pDiffTextWindow1->setFocus();
     m_pMainWidget->setMinimumSize(50, 50);
@@ -724,6 +1262,12 @@ void KDiff3App::slotFinishMainInit()
             m_pMergeResultWindow->slotGoNextUnsolvedConflict();
     }
 
+    if(mProgressiveScrollPos >= 0)
+    {
+        DiffTextWindow::mVScrollBar->setValue(mProgressiveScrollPos);
+        mProgressiveScrollPos = -1;
+    }
+
     if(m_pCornerWidget)
         m_pCornerWidget->setFixedSize(DiffTextWindow::mVScrollBar->width(), m_pHScrollBar->height());
 
@@ -788,6 +1332,11 @@ void KDiff3App::slotFinishMainInit()
                                                 "Do not save the result if unsure. Continue at your own risk.\n"
                                                 "Affected input files are in %1.", files));
         }
+
+        // The line based views have nothing to show for inputs that aren't text.
+        if(!bVisibleMergeResultWindow && m_sd3->isEmpty() && m_sd1->hasData() && m_sd2->hasData() &&
+           (!m_sd1->isText() || !m_sd2->isText()) && !m_totalDiffStatus->isBinaryEqualAB())
+            slotShowBinaryComparison();
     }
 
     if(bVisibleMergeResultWindow && m_pMergeResultWindow)
@@ -798,6 +1347,65 @@ void KDiff3App::slotFinishMainInit()
     {
         m_pDiffTextWindow1->setFocus();
     }
+
+    if(!m_paintBenchmarkFilename.isEmpty())
+        QTimer::singleShot(0, this, &KDiff3App::runPaintBenchmark);
+}
+
+void KDiff3App::runPaintBenchmark()
+{
+    const QString fileName = m_paintBenchmarkFilename;
+    // Reloading must not start it again.
+    m_paintBenchmarkFilename.clear();
+
+    PaintBenchmark benchmark;
+    benchmark.watch(m_pDiffTextWindow1, QStringLiteral("DiffTextWindowA"));
+    benchmark.watch(m_pDiffTextWindow2, QStringLiteral("DiffTextWindowB"));
+    benchmark.watch(m_pDiffTextWindow3, QStringLiteral("DiffTextWindowC"));
+    benchmark.watch(m_pMergeResultWindow, QStringLiteral("MergeResultWindow"));
+    benchmark.watch(m_pOverview, QStringLiteral("Overview"));
+
+    const auto isBusy = [this]() { return m_bRecalcWordWrapPosted || mResizeWordWrapTimer.isActive() || mFineDiffTimer.isActive(); };
+    const auto scroll = [&benchmark, &isBusy](QScrollBar* pScrollBar, const QString& action) {
+        if(pScrollBar == nullptr)
+            return;
+
+        benchmark.measureFrame(action, [pScrollBar]() { pScrollBar->setValue(0); }, isBusy);
+        for(int i = 0; i < 100 && pScrollBar->value() < pScrollBar->maximum(); ++i)
+            benchmark.measureFrame(action, [pScrollBar]() { pScrollBar->triggerAction(QAbstractSlider::SliderPageStepAdd); }, isBusy);
+        for(int i = 0; i < 100 && pScrollBar->value() > 0; ++i)
+            benchmark.measureFrame(action, [pScrollBar]() { pScrollBar->triggerAction(QAbstractSlider::SliderSingleStepSub); }, isBusy);
+    };
+
+    QWidget* pWindow = window();
+    benchmark.measureFrame(QStringLiteral("resize"), [pWindow]() { pWindow->resize(1280, 800); }, isBusy);
+
+    const bool bWordWrap = wordWrap->isChecked();
+    for(int i = 0; i < 2; ++i)
+    {
+        if(i > 0)
+            benchmark.measureFrame(QStringLiteral("wordWrap"), [this]() { wordWrap->trigger(); }, isBusy);
+
+        const QString suffix = wordWrap->isChecked() ? QStringLiteral("Wrapped") : QString();
+        scroll(DiffTextWindow::mVScrollBar, QStringLiteral("scrollDiff") + suffix);
+        scroll(MergeResultWindow::mVScrollBar, QStringLiteral("scrollMerge") + suffix);
+
+        for(const QSize& size: {QSize(1024, 768), QSize(1600, 1000), QSize(800, 600), QSize(1280, 800)})
+            benchmark.measureFrame(QStringLiteral("resize") + suffix, [pWindow, size]() { pWindow->resize(size); }, isBusy);
+    }
+
+    if(wordWrap->isChecked() != bWordWrap)
+        benchmark.measureFrame(QStringLiteral("wordWrap"), [this]() { wordWrap->trigger(); }, isBusy);
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || file.write(benchmark.report()) < 0)
+    {
+        QTextStream(stderr) << i18n("Error while writing the report.") << "\n";
+        QCoreApplication::exit(1);
+        return;
+    }
+
+    QCoreApplication::exit(0);
 }
 
 void KDiff3App::resizeEvent(QResizeEvent* e)
@@ -884,7 +1492,7 @@ void KDiff3App::slotFileOpen()
                      QDir::toNativeSeparators(m_bDirCompare ? gDirInfo->dirB().prettyAbsPath() : m_sd2->isFromBuffer() ? QString("") : m_sd2->getAliasName()),
                      QDir::toNativeSeparators(m_bDirCompare ? gDirInfo->dirC().prettyAbsPath() : m_sd3->isFromBuffer() ? QString("") : m_sd3->getAliasName()),
                      m_bDirCompare ? !gDirInfo->destDir().prettyAbsPath().isEmpty() : !m_outputFilename.isEmpty(),
-                     QDir::toNativeSeparators(m_bDefaultFilename ? QString("") : m_outputFilename), m_pOptionDialog->getOptions()));
+                     QDir::toNativeSeparators(m_bDefaultFilename ? QString("") : m_outputFilename), m_pOptions));
 
         int status = d->exec();
         if(status == QDialog::Accepted)
@@ -964,6 +1572,7 @@ void KDiff3App::slotFileOpen2(QStringList& errors, const QString& fn1, const QSt
     }
 
     slotStatusMsg(i18n("Opening files..."));
+    mFineDiffTimer.stop();
     m_sd1->reset();
     m_sd2->reset();
     m_sd3->reset();
@@ -1021,6 +1630,13 @@ void KDiff3App::slotFileOpen2(QStringList& errors, const QString& fn1, const QSt
     slotStatusMsg(i18n("Ready."));
 }
 
+void KDiff3App::slotPrefetchDiffMerge(const QString& fn1, const QString& fn2, const QString& fn3)
+{
+    mPrefetcher.prefetch(fn1, m_pOptions, m_pOptions->m_pEncodingA, m_pOptions->m_bAutoDetectUnicodeA);
+    mPrefetcher.prefetch(fn2, m_pOptions, m_pOptions->m_pEncodingB, m_pOptions->m_bAutoDetectUnicodeB);
+    mPrefetcher.prefetch(fn3, m_pOptions, m_pOptions->m_pEncodingC, m_pOptions->m_bAutoDetectUnicodeC);
+}
+
 void KDiff3App::slotFileNameChanged(const QString& fileName, e_SrcSelector winIdx)
 {
     QStringList errors;
@@ -1111,7 +1727,7 @@ void KDiff3App::slotEditPaste()
 
             if(!error.isEmpty())
             {
-                KMessageBox::error(m_pOptionDialog, error);
+                KMessageBox::error(this, error);
             }
 
             if(do_init)
@@ -1321,6 +1937,12 @@ void KDiff3App::slotJoinDiffs()
 
 void KDiff3App::slotConfigure()
 {
+    if(m_pOptionDialog == nullptr)
+    {
+        m_pOptionDialog = new OptionDialog(m_pKDiff3Shell != nullptr, m_pOptions, this);
+        chk_connect_a(m_pOptionDialog, &OptionDialog::applyDone, this, &KDiff3App::slotRefresh);
+    }
+
     m_pOptionDialog->setState();
     m_pOptionDialog->setMinimumHeight(m_pOptionDialog->minimumHeight() + 40);
     m_pOptionDialog->exec();
@@ -1340,6 +1962,7 @@ void KDiff3App::slotConfigureKeys()
 void KDiff3App::slotRefresh()
 {
     QApplication::setFont(m_pOptions->appFont());
+    TaskExecutor::instance().setMaxThreadCount(m_pOptions->m_workerThreads);
 
     Q_EMIT doRefresh();
 
@@ -1375,11 +1998,11 @@ void KDiff3App::slotSelectionEnd()
 
         if(clipBoard->supportsSelection())
         {
-            QString sCurSelection = getSelection();
+            const SelectionText curSelection = getSelectionText();
 
-            if(!sCurSelection.isEmpty())
+            if(!curSelection.isEmpty())
             {
-                clipBoard->setText(sCurSelection, QClipboard::Selection);
+                clipBoard->setMimeData(new SelectionMimeData(curSelection), QClipboard::Selection);
             }
         }
     }
@@ -1393,8 +2016,8 @@ void KDiff3App::slotClipboardChanged()
     const QMimeData* mimeData = clipboard->mimeData();
     if(mimeData && mimeData->hasText())
     {
-        QString s = clipboard->text();
-        editPaste->setEnabled(!s.isEmpty());
+        // Our own selections are never empty, asking for their text would build it.
+        editPaste->setEnabled(dynamic_cast<const SelectionMimeData*>(mimeData) != nullptr || !clipboard->text().isEmpty());
     }
     else
     {
@@ -1449,6 +2072,14 @@ void KDiff3App::postRecalcWordWrap()
     }
 }
 
+void KDiff3App::slotResizeWidthChanged()
+{
+    if(m_bAutoMode) return;
+
+    // Restarted while the user drags, the lines are wrapped once the size settles.
+    mResizeWordWrapTimer.start();
+}
+
 void KDiff3App::slotRecalcWordWrap()
 {
     Q_ASSERT(!m_bAutoMode);
@@ -1482,7 +2113,7 @@ void KDiff3App::recalcWordWrap(int visibleTextWidthForPrinting)
     {
         if(m_pOptions->wordWrapOn())
         {
-            m_diff3LineList.recalcWordWrap(true);
+            mDiff3LineVector.recalcWordWrap(true);
 
             // Let every window calc how many lines will be needed.
             if(m_pDiffTextWindow1)
@@ -1558,7 +2189,7 @@ void KDiff3App::slotFinishRecalcWordWrap(int visibleTextWidthForPrinting)
     {
         if(m_pOptions->wordWrapOn())
         {
-            LineType sumOfLines = m_diff3LineList.recalcWordWrap(false);
+            LineType sumOfLines = mDiff3LineVector.recalcWordWrap(false);
 
             // Finish the word wrap
             if(m_pDiffTextWindow1)
@@ -1604,8 +2235,6 @@ void KDiff3App::slotFinishRecalcWordWrap(int visibleTextWidthForPrinting)
         m_bFinishMainInit = false;
         slotFinishMainInit();
     }
-    if(m_pEventLoopForPrinting)
-        m_pEventLoopForPrinting->quit();
 }
 
 void KDiff3App::slotShowWhiteSpaceToggled()
@@ -1653,6 +2282,8 @@ bool KDiff3App::doDirectoryCompare(const bool bCreateNewInstance)
         m_pMainWidget->hide();
         setUpdatesEnabled(true);
 
+        // A scan still running in the background reads the old lists.
+        m_pDirectoryMergeWindow->cancelScan();
         (*gDirInfo) = DirectoryInfo(f1, f2, f3, destDir);
 
         bool bSuccess = m_pDirectoryMergeWindow->init(
@@ -1662,6 +2293,7 @@ bool KDiff3App::doDirectoryCompare(const bool bCreateNewInstance)
 
         if(bSuccess)
         {
+            mFineDiffTimer.stop();
             m_sd1->reset();
             if(m_pDiffTextWindow1 != nullptr)
             {
@@ -1725,7 +2357,196 @@ void KDiff3App::slotReload()
 {
     if(!canContinue()) return;
 
-    mainInit(m_totalDiffStatus);
+    mainInit(m_totalDiffStatus, InitFlag::defaultFlags | InitFlag::keepUnchangedFiles);
+}
+
+/*
+    Saves the decoded inputs and the line matching of the pairs, see SessionSnapshot. Only local
+    text files read completely and without a preprocessor can be checked against the disk later.
+*/
+void KDiff3App::slotSaveSnapshot()
+{
+    SessionSnapshot snapshot;
+    const bool bPreprocessed = !m_pOptions->m_PreProcessorCmd.isEmpty() || !m_pOptions->m_LineMatchingPreProcessorCmd.isEmpty();
+    for(const QSharedPointer<SourceData>& sd: {m_sd1, m_sd2, m_sd3})
+    {
+        if(sd == m_sd3 && sd->isEmpty())
+            break;
+
+        SessionSnapshot::Input input;
+        if(bPreprocessed || sd->isEmpty() || !sd->isLocal() || sd->isFromBuffer() || !sd->hasData() || !sd->isText() || sd->isPartial() ||
+           sd->getEncoding() == nullptr || !sd->getReadStamp(input.lastModified, input.size))
+        {
+            KMessageBox::error(this, i18n("Only a comparison of local text files that are loaded completely and without a preprocessor can be saved as a snapshot."));
+            return;
+        }
+        // The snapshot keeps the text of an input in one string.
+        if(sd->getTextBuffers().size() > 1)
+        {
+            KMessageBox::error(this, i18n("%1 is too large to be saved in a snapshot.", sd->getAliasName()));
+            return;
+        }
+
+        input.fileName = sd->getFilename();
+        input.aliasName = sd->getAliasName();
+        input.encodingName = sd->getEncoding()->name();
+        input.decoded = sd->decodedText();
+        snapshot.addInput(input);
+    }
+
+    // Line matching that is cut short, aligned manually or stale is calculated again when opening.
+    const DiffSettings diffSettings(*m_pOptions);
+    SessionSnapshot::Settings settings;
+    settings.lineDiffAlgorithm = (int)diffSettings.lineDiffAlgorithm();
+    settings.bTryHard = diffSettings.tryHard();
+    settings.bIgnoreNumbers = diffSettings.ignoreNumbers();
+    snapshot.setSettings(settings);
+
+    const auto addLineMatching = [&snapshot, &settings](const SessionSnapshot::Pair pair, const QSharedPointer<SourceData>& sdX, const QSharedPointer<SourceData>& sdY,
+                                                        const DiffList& diffList, const DiffListOrigin& origin) {
+        DiffListOrigin current;
+        current.bValid = true;
+        current.generationX = sdX->generation();
+        current.generationY = sdY->generation();
+        current.lineDiffAlgorithm = settings.lineDiffAlgorithm;
+        current.bTryHard = settings.bTryHard;
+        current.bIgnoreNumbers = settings.bIgnoreNumbers;
+        if(origin == current && !origin.bApproximate)
+            snapshot.setLineMatching(pair, diffList);
+    };
+    addLineMatching(SessionSnapshot::AB, m_sd1, m_sd2, m_diffList12, mDiffOrigin12);
+    if(!m_sd3->isEmpty())
+    {
+        addLineMatching(SessionSnapshot::AC, m_sd1, m_sd3, m_diffList13, mDiffOrigin13);
+        addLineMatching(SessionSnapshot::BC, m_sd2, m_sd3, m_diffList23, mDiffOrigin23);
+    }
+
+    const QString fileName = QFileDialog::getSaveFileName(this, i18n("Save Comparison Snapshot"), QDir::currentPath());
+    if(fileName.isEmpty())
+        return;
+
+    slotStatusMsg(i18n("Saving snapshot..."));
+    if(!snapshot.save(fileName))
+        KMessageBox::error(this, i18n("Saving the snapshot failed.\n%1", snapshot.errorString()));
+    slotStatusMsg(i18n("Ready."));
+}
+
+/*
+    Writes a unified diff of A and B, or the merge of three inputs with conflict markers. The text
+    is streamed from the loaded inputs in the encoding and line end style chosen for the output.
+*/
+void KDiff3App::slotWritePatch()
+{
+    if(!m_sd1->isText() || !m_sd2->isText() || !m_sd1->hasData() || !m_sd2->hasData() || m_pMergeResultWindow == nullptr)
+        return;
+
+    if(mDiffOrigin12.bApproximate)
+        KMessageBox::information(this, i18n("The complete line matching isn't ready yet, the patch may have larger hunks than needed."));
+
+    const QString fileName = QFileDialog::getSaveFileUrl(this, i18n("Write Patch"), QUrl::fromLocalFile(QDir::currentPath())).url(QUrl::PreferLocalFile);
+    if(fileName.isEmpty())
+        return;
+
+    QTextCodec* pEncoding = m_pMergeResultWindowTitle->getEncoding();
+    if(pEncoding == nullptr)
+        pEncoding = m_sd2->getEncoding() != nullptr ? m_sd2->getEncoding() : QTextCodec::codecForName("UTF-8");
+    e_LineEndStyle eLineEndStyle = m_pMergeResultWindowTitle->getLineEndStyle();
+    if(eLineEndStyle == eLineEndStyleConflict || eLineEndStyle == eLineEndStyleUndefined)
+        eLineEndStyle = eLineEndStyleUnix;
+
+    slotStatusMsg(i18n("Writing patch..."));
+    FileAccess file(fileName, true /*bWantToWrite*/);
+    bool bSuccess = false;
+    if(m_sd3->isEmpty())
+    {
+        PatchWriter writer(m_diffList12, m_sd1->getLineDataForDisplay(), m_sd1->getSizeLines(), m_sd2->getLineDataForDisplay(), m_sd2->getSizeLines(),
+                           m_sd1->getAliasName(), m_sd2->getAliasName(), m_pOptions->m_patchContextLines, pEncoding, eLineEndStyle);
+        bSuccess = writer.write(file);
+    }
+    else
+        bSuccess = m_pMergeResultWindow->writeConflictMarkers(file, pEncoding, eLineEndStyle, m_sd1->getAliasName(), m_sd2->getAliasName(), m_sd3->getAliasName());
+
+    if(!bSuccess)
+    {
+        const QString statusText = file.getStatusText();
+        KMessageBox::error(this, statusText.isEmpty() ? i18n("Error while writing %1.", fileName) : statusText);
+    }
+    slotStatusMsg(i18n("Ready."));
+}
+
+/*
+    Installs the inputs and the line matching of a snapshot, so the comparison is shown after
+    building the Diff3LineList. Files that changed on disk since are read and compared as usual.
+*/
+void KDiff3App::slotOpenSnapshot()
+{
+    if(!canContinue()) return;
+
+    const QString fileName = QFileDialog::getOpenFileName(this, i18n("Open Comparison Snapshot"), QDir::currentPath());
+    if(fileName.isEmpty())
+        return;
+
+    SessionSnapshot snapshot;
+    if(!snapshot.load(fileName))
+    {
+        KMessageBox::error(this, i18n("Opening the snapshot failed.\n%1", snapshot.errorString()));
+        return;
+    }
+
+    slotStatusMsg(i18n("Opening files..."));
+    mFineDiffTimer.stop();
+    mProgressiveLoadTimer.stop();
+    m_manualDiffHelpList.clear();
+
+    const std::vector<SessionSnapshot::Input>& inputs = snapshot.inputs();
+    const QSharedPointer<SourceData> sources[] = {m_sd1, m_sd2, m_sd3};
+    bool bRestored = true;
+    for(size_t i = 0; i < 3; ++i)
+    {
+        sources[i]->reset();
+        sources[i]->setFilename(i < inputs.size() ? inputs[i].fileName : QString());
+        sources[i]->setAliasName(i < inputs.size() ? inputs[i].aliasName : QString());
+        if(i < inputs.size() && bRestored)
+        {
+            QTextCodec* pEncoding = QTextCodec::codecForName(inputs[i].encodingName);
+            bRestored = sources[i]->restoreDecodedText(pEncoding, inputs[i].lastModified, inputs[i].size, inputs[i].decoded);
+        }
+    }
+
+    m_outputFilename = "";
+    m_bDefaultFilename = true;
+
+    if(!bRestored)
+    {
+        qCInfo(kdiffMain) << "Snapshot is out of date, reading the files:" << fileName;
+        mainInit(m_totalDiffStatus);
+        slotStatusMsg(i18n("Ready."));
+        return;
+    }
+
+    // The generations are new, the line matching is kept as long as the options didn't change, see runLineDiff().
+    const SessionSnapshot::Settings& settings = snapshot.settings();
+    const auto restoreLineMatching = [&snapshot, &settings](const SessionSnapshot::Pair pair, const QSharedPointer<SourceData>& sdX, const QSharedPointer<SourceData>& sdY,
+                                                            DiffList& diffList, DiffListOrigin& origin) {
+        origin = DiffListOrigin();
+        const DiffList* pDiffList = snapshot.lineMatching(pair);
+        if(pDiffList == nullptr)
+            return;
+
+        diffList = *pDiffList;
+        origin.bValid = true;
+        origin.generationX = sdX->generation();
+        origin.generationY = sdY->generation();
+        origin.lineDiffAlgorithm = settings.lineDiffAlgorithm;
+        origin.bTryHard = settings.bTryHard;
+        origin.bIgnoreNumbers = settings.bIgnoreNumbers;
+    };
+    restoreLineMatching(SessionSnapshot::AB, m_sd1, m_sd2, m_diffList12, mDiffOrigin12);
+    restoreLineMatching(SessionSnapshot::AC, m_sd1, m_sd3, m_diffList13, mDiffOrigin13);
+    restoreLineMatching(SessionSnapshot::BC, m_sd2, m_sd3, m_diffList23, mDiffOrigin23);
+
+    mainInit(m_totalDiffStatus, InitFlag::autoSolve | InitFlag::initGUI);
+    slotStatusMsg(i18n("Ready."));
 }
 
 bool KDiff3App::canContinue()
@@ -2140,6 +2961,12 @@ void KDiff3App::slotEncodingChanged(QTextCodec*)
 }
 
 void KDiff3App::slotUpdateAvailabilities()
+{
+    if(!mAvailabilitiesTimer.isActive())
+        mAvailabilitiesTimer.start();
+}
+
+void KDiff3App::recalcAvailabilities()
 {
     if(m_pDiffTextWindow2 == nullptr || m_pDiffTextWindow1 == nullptr || m_pDiffTextWindow3 == nullptr)
         return;
@@ -2171,6 +2998,7 @@ void KDiff3App::slotUpdateAvailabilities()
           (m_pDirectoryMergeDock->isVisible() && !m_pMainWidget->isVisible() && bTextDataAvailable))));
 
     showWhiteSpaceCharacters->setEnabled(bDiffWindowVisible);
+    mShowBinaryComparison->setEnabled(bDiffWindowVisible && m_sd1->hasData() && m_sd2->hasData());
     autoAdvance->setEnabled(bMergeEditorVisible);
     mAutoSolve->setEnabled(bMergeEditorVisible && m_bTripleDiff);
     mUnsolve->setEnabled(bMergeEditorVisible);
@@ -2192,6 +3020,8 @@ void KDiff3App::slotUpdateAvailabilities()
     bool bSavable = bMergeEditorVisible && m_pMergeResultWindow->getNumberOfUnsolvedConflicts() == 0;
     fileSave->setEnabled(m_bOutputModified && bSavable);
     fileSaveAs->setEnabled(bSavable);
+    fileWritePatch->setEnabled(bDiffWindowVisible);
+    fileExportPdf->setEnabled(bDiffWindowVisible);
 
     mGoTop->setEnabled(bDiffWindowVisible && m_pMergeResultWindow != nullptr && m_pMergeResultWindow->isDeltaAboveCurrent());
     mGoBottom->setEnabled(bDiffWindowVisible && m_pMergeResultWindow != nullptr && m_pMergeResultWindow->isDeltaBelowCurrent());
@@ -12,6 +12,7 @@
 
 #include "defmac.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QApplication>
@@ -68,6 +69,13 @@ ProgressDialog::ProgressDialog(QWidget* pParent, QStatusBar* pStatusBar)
     initConnections();
 }
 
+// The dialog belongs to the first main window, a later one creates its own after this is gone.
+ProgressDialog::~ProgressDialog()
+{
+    if(g_pProgressDialog == this)
+        g_pProgressDialog = nullptr;
+}
+
 void ProgressDialog::initConnections()
 {
     connections.push_back(ProgressProxy::startBackgroundTask.connect(boost::bind(&ProgressDialog::beginBackgroundTask, this)));
@@ -88,6 +96,8 @@ void ProgressDialog::initConnections()
     connections.push_back(ProgressProxy::setRangeTransformationSig.connect(boost::bind(&ProgressDialog::setRangeTransformation, this, placeholders::_1, placeholders::_2)));
     connections.push_back(ProgressProxy::setSubRangeTransformationSig.connect(boost::bind(&ProgressDialog::setSubRangeTransformation, this, placeholders::_1, placeholders::_2)));
 
+    connections.push_back(ProgressProxy::trackParallelSig.connect(boost::bind(&ProgressDialog::trackParallel, this, placeholders::_1)));
+
     connections.push_back(ProgressProxy::wasCancelledSig.connect(boost::bind(&ProgressDialog::wasCancelled, this)));
 
     connections.push_back(ProgressProxy::setInformationSig.connect(boost::bind(
@@ -161,6 +171,8 @@ void ProgressDialog::endBackgroundTask()
         backgroundTaskCount--;
         if(backgroundTaskCount == 0)
         {
+            m_pBackgroundProgress.reset();
+            updateSampleTimer();
             hide();
         }
     }
@@ -171,6 +183,7 @@ void ProgressDialog::pop(bool bRedrawUpdate)
     if(!m_progressStack.empty())
     {
         m_progressStack.pop_back();
+        updateSampleTimer();
         if(m_progressStack.empty())
         {
             hide();
@@ -180,6 +193,51 @@ void ProgressDialog::pop(bool bRedrawUpdate)
     }
 }
 
+void ProgressDialog::trackParallel(const std::shared_ptr<const ParallelProgress>& pProgress)
+{
+    if(m_progressStack.empty())
+    {
+        m_pBackgroundProgress = pProgress;
+    }
+    else
+    {
+        ProgressLevelData& pld = m_progressStack.back();
+        pld.m_pParallelProgress = pProgress;
+        if(pProgress != nullptr)
+        {
+            pld.m_maxNofSteps = std::max<quint64>(pProgress->maxNofSteps(), 1);
+            pld.m_current = 0;
+        }
+    }
+    updateSampleTimer();
+}
+
+// The workers never wait for the gui, it picks up their counts a few times per second.
+void ProgressDialog::updateSampleTimer()
+{
+    const bool bNeeded = m_pBackgroundProgress != nullptr ||
+                         std::any_of(m_progressStack.cbegin(), m_progressStack.cend(), [](const ProgressLevelData& pld) { return pld.m_pParallelProgress != nullptr; });
+    if(bNeeded && m_sampleTimer == 0)
+    {
+        m_sampleTimer = startTimer(100);
+    }
+    else if(!bNeeded && m_sampleTimer != 0)
+    {
+        killTimer(m_sampleTimer);
+        m_sampleTimer = 0;
+    }
+}
+
+void ProgressDialog::sampleParallelProgress()
+{
+    for(ProgressLevelData& pld: m_progressStack)
+    {
+        if(pld.m_pParallelProgress != nullptr)
+            pld.m_current = std::min(pld.m_pParallelProgress->current(), pld.m_maxNofSteps.loadRelaxed());
+    }
+    recalc(false);
+}
+
 void ProgressDialog::setInformation(const QString& info, int current, bool bRedrawUpdate)
 {
     if(m_progressStack.empty())
@@ -345,8 +403,13 @@ void ProgressDialog::recalc(bool bUpdate)
             {
                 if(m_progressStack.empty())
                 {
-                    dialogUi.progressBar->setValue(0);
+                    int value = 0;
+                    if(m_pBackgroundProgress != nullptr && m_pBackgroundProgress->maxNofSteps() > 0)
+                        value = int(1000.0 * std::min(m_pBackgroundProgress->current(), m_pBackgroundProgress->maxNofSteps()) / m_pBackgroundProgress->maxNofSteps());
+                    dialogUi.progressBar->setValue(value);
                     dialogUi.subProgressBar->setValue(0);
+                    if(m_bStayHidden && m_pStatusProgressBar)
+                        m_pStatusProgressBar->setValue(value);
                 }
                 else
                 {
@@ -443,6 +506,7 @@ void ProgressDialog::reject()
 {
     cancel(eUserAbort);
     QDialog::reject();
+    Q_EMIT aborted();
 }
 
 void ProgressDialog::slotAbort()
@@ -500,6 +564,10 @@ void ProgressDialog::timerEvent(QTimerEvent* te)
         m_delayedHideTimer = 0;
         delayedHide();
     }
+    else if(te->timerId() == m_sampleTimer)
+    {
+        sampleParallelProgress();
+    }
     else if(te->timerId() == m_delayedHideStatusBarWidgetTimer)
     {
         killTimer(m_delayedHideStatusBarWidgetTimer);
@@ -34,6 +34,7 @@ class ProgressDialog: public QDialog
     Q_OBJECT
   public:
     ProgressDialog(QWidget* pParent, QStatusBar*);
+    ~ProgressDialog() override;
 
     void beginBackgroundTask();
     void endBackgroundTask();
@@ -48,6 +49,8 @@ class ProgressDialog: public QDialog
     void addNofSteps(const quint64 nofSteps);
     void push();
     void pop(bool bRedrawUpdate = true);
+    // Outside of push and pop the progress belongs to the running background task.
+    void trackParallel(const std::shared_ptr<const ParallelProgress>& pProgress);
 
     // The progressbar goes from 0 to 1 usually.
     // By supplying a subrange transformation the subCurrent-values
@@ -75,12 +78,18 @@ class ProgressDialog: public QDialog
 
     void timerEvent(QTimerEvent* event) override;
 
+  Q_SIGNALS:
+    // The user pressed cancel. Work that doesn't poll wasCancelled() can stop on this.
+    void aborted();
+
   protected:
     void reject() override;
 
   private:
     void setInformationImp(const QString& info);
     void initConnections();
+    void updateSampleTimer();
+    void sampleParallelProgress();
 
     //Treated as slot by direct call to QMetaObject::invokeMethod
   public Q_SLOTS:
@@ -100,13 +109,16 @@ class ProgressDialog: public QDialog
         double m_dRangeMin = 0;
         double m_dSubRangeMax = 1;
         double m_dSubRangeMin = 0;
+        std::shared_ptr<const ParallelProgress> m_pParallelProgress; // Replaces m_current when set.
     };
     quint64 backgroundTaskCount = 0;
     QList<ProgressLevelData> m_progressStack;
+    std::shared_ptr<const ParallelProgress> m_pBackgroundProgress;
 
     int m_progressDelayTimer = 0;
     int m_delayedHideTimer = 0;
     int m_delayedHideStatusBarWidgetTimer = 0;
+    int m_sampleTimer = 0;
     QPointer<QEventLoop> m_eventLoop;
 
     QElapsedTimer m_t1;
@@ -16,26 +16,30 @@
 #include <utility>   // for swap
 
 
-qint32 Selection::firstPosInLine(LineRef l) const
+void Selection::normalize()
 {
-    assert(firstLine.isValid());
-
-    LineRef l1 = firstLine;
-    LineRef l2 = lastLine;
-    qint32 p1 = firstPos;
-    qint32 p2 = lastPos;
-    if(l1 > l2)
+    mbValid = firstLine.isValid();
+    mBeginLine = firstLine;
+    mEndLine = lastLine;
+    mBeginPos = firstPos;
+    mEndPos = lastPos;
+    if(mBeginLine > mEndLine)
     {
-        std::swap(l1, l2);
-        std::swap(p1, p2);
+        std::swap(mBeginLine, mEndLine);
+        std::swap(mBeginPos, mEndPos);
     }
-    if(l1 == l2 && p1 > p2)
+    if(mBeginLine == mEndLine && mBeginPos > mEndPos)
     {
-        std::swap(p1, p2);
+        std::swap(mBeginPos, mEndPos);
     }
+}
+
+qint32 Selection::firstPosInLine(LineRef l) const
+{
+    assert(firstLine.isValid());
 
-    if(l == l1)
-        return p1;
+    if((LineType)l == mBeginLine)
+        return mBeginPos;
 
     return 0;
 }
@@ -44,69 +48,27 @@ qint32 Selection::lastPosInLine(LineRef l) const
 {
     assert(firstLine.isValid());
 
-    LineRef l1 = firstLine;
-    LineRef l2 = lastLine;
-    qint32 p1 = firstPos;
-    qint32 p2 = lastPos;
+    if((LineType)l == mEndLine)
+        return mEndPos;
 
-    if(l1 > l2)
-    {
-        std::swap(l1, l2);
-        std::swap(p1, p2);
-    }
-    if(l1 == l2 && p1 > p2)
-    {
-        std::swap(p1, p2);
-    }
+    return limits<qint32>::max();
+}
 
-    if(l == l2)
-        return p2;
+Selection::Span Selection::spanInLine(LineType l) const
+{
+    if(!mbValid || l < mBeginLine || l > mEndLine)
+        return Span();
 
-    return limits<qint32>::max();
+    return Span{l == mBeginLine ? mBeginPos : 0, l == mEndLine ? mEndPos : limits<QtSizeType>::max()};
 }
 
 bool Selection::within(LineRef l, qint32 p) const
 {
-    if(!firstLine.isValid())
-        return false;
-
-    LineRef l1 = firstLine;
-    LineRef l2 = lastLine;
-    int p1 = firstPos;
-    int p2 = lastPos;
-    if(l1 > l2)
-    {
-        std::swap(l1, l2);
-        std::swap(p1, p2);
-    }
-    if(l1 == l2 && p1 > p2)
-    {
-        std::swap(p1, p2);
-    }
-    if(l1 <= l && l <= l2)
-    {
-        if(l1 == l2)
-            return p >= p1 && p < p2;
-        if(l == l1)
-            return p >= p1;
-        if(l == l2)
-            return p < p2;
-        return true;
-    }
-    return false;
+    return spanInLine(l).contains(p);
 }
 
 bool Selection::lineWithin(LineRef l) const
 {
-    if(!firstLine.isValid())
-        return false;
-    LineRef l1 = firstLine;
-    LineRef l2 = lastLine;
-
-    if(l1 > l2)
-    {
-        std::swap(l1, l2);
-    }
-
-    return (l1 <= l && l <= l2);
+    const LineType line = l;
+    return mbValid && mBeginLine <= line && line <= mEndLine;
 }
@@ -28,7 +28,26 @@ private:
 
   LineRef oldFirstLine;
   LineRef oldLastLine;
+
+  // The range ordered from begin to end, updated on every change so painting needn't compare the ends.
+  bool mbValid = false;
+  LineType mBeginLine = LineRef::invalid;
+  LineType mEndLine = LineRef::invalid;
+  QtSizeType mBeginPos = 0;
+  QtSizeType mEndPos = 0;
+
+  void normalize();
 public:
+  // Selected columns of one line.
+  struct Span
+  {
+      QtSizeType begin = 0;
+      QtSizeType end = 0; // Past the last selected column.
+
+      [[nodiscard]] bool contains(const QtSizeType p) const { return p >= begin && p < end; }
+      [[nodiscard]] bool isEmpty() const { return end <= begin; }
+  };
+
 //private:
   bool bSelectionContainsData = false;
 public:
@@ -52,11 +71,13 @@ public:
       firstLine.invalidate();
       lastLine.invalidate();
       bSelectionContainsData = false;
+      normalize();
    }
    void start(LineRef l, QtSizeType p)
    {
       firstLine = l;
       firstPos = p;
+      normalize();
    }
    void end(LineRef l, QtSizeType p)
    {
@@ -64,6 +85,7 @@ public:
          oldLastLine = lastLine;
       lastLine  = l;
       lastPos  = p;
+      normalize();
       //bSelectionContainsData = (firstLine == lastLine && firstPos == lastPos);
    }
    [[nodiscard]] bool within(LineRef l, QtSizeType p) const;
@@ -71,6 +93,8 @@ public:
    [[nodiscard]] bool lineWithin( LineRef l ) const;
    [[nodiscard]] QtSizeType firstPosInLine(LineRef l) const;
    [[nodiscard]] QtSizeType lastPosInLine(LineRef l) const;
+   // Empty for lines outside the selection, the end is unbounded for all but the last line.
+   [[nodiscard]] Span spanInLine(LineType l) const;
 
    [[nodiscard]] LineRef beginLine() const
    {
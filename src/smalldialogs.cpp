@@ -11,6 +11,7 @@
 
 #include "diff.h"
 #include "FileNameLineEdit.h"
+#include "HistorySortKey.h"
 #include "kdiff3.h"
 #include "options.h"
 #include "TypeUtils.h"
@@ -541,7 +542,7 @@ void RegExpTester::slotRecalc()
     if(match.hasMatch())
     {
         m_pHistoryEntryStartMatchResult->setText(i18n("Match success."));
-        QString key = calcHistorySortKey(m_pHistorySortKeyOrderEdit->text(), match, parenthesesGroups);
+        QString key = HistorySortKey(m_pHistorySortKeyOrderEdit->text(), parenthesesGroups).calc(match);
         m_pHistorySortKeyResult->setText(key);
     }
     else